@@ -15,6 +15,7 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <libavutil/cpu.h>
 #include <libavutil/frame.h>
 #include <libavutil/mem.h>
 
@@ -166,11 +167,43 @@ struct mp_aframe *mp_aframe_from_avframe(struct AVFrame *av_frame)
 // Return a new reference to the data in frame. Returns NULL is not
 // representable (), or if input is NULL.
 // Does not copy the timestamps.
+// FFmpeg expects audio data to be aligned like its own allocations, but
+// mp_aframe_skip_samples() doesn't preserve this. Copy the data if needed.
+static bool realign_data(struct mp_aframe *frame)
+{
+    if (!mp_aframe_is_allocated(frame))
+        return true;
+
+    size_t align = av_cpu_max_align();
+    uint8_t **data = frame->av_frame->extended_data;
+    bool aligned = true;
+    for (int n = 0; n < mp_aframe_get_planes(frame); n++)
+        aligned &= (uintptr_t)data[n] % align == 0;
+    if (aligned)
+        return true;
+
+    int samples = mp_aframe_get_size(frame);
+    struct mp_aframe *tmp = mp_aframe_create();
+    mp_aframe_config_copy(tmp, frame);
+    if (!mp_aframe_alloc_data(tmp, samples) ||
+        !mp_aframe_copy_samples(tmp, 0, frame, 0, samples))
+    {
+        talloc_free(tmp);
+        return false;
+    }
+    MPSWAP(struct mp_aframe, *tmp, *frame);
+    talloc_free(tmp);
+    return true;
+}
+
 struct AVFrame *mp_aframe_to_avframe(struct mp_aframe *frame)
 {
     if (!frame)
         return NULL;
 
+    if (!realign_data(frame))
+        return NULL;
+
     if (af_to_avformat(frame->format) != frame->av_frame->format)
         return NULL;
 
@@ -449,18 +482,23 @@ void mp_aframe_skip_samples(struct mp_aframe *f, int samples)
 {
     assert(samples >= 0 && samples <= mp_aframe_get_size(f));
 
-    if (av_frame_make_writable(f->av_frame) < 0)
-        return; // go complain to ffmpeg
+    if (!samples)
+        return;
 
+    // Only advance the data pointers. Moving the remaining data would make
+    // consuming a frame in small pieces quadratic, and would force a copy if
+    // the data is shared. The data may be misaligned now, which is fixed up
+    // when passing it to FFmpeg (see realign_data()).
     int num_planes = mp_aframe_get_planes(f);
     size_t sstride = mp_aframe_get_sstride(f);
-    for (int n = 0; n < num_planes; n++) {
-        memmove(f->av_frame->extended_data[n],
-                f->av_frame->extended_data[n] + samples * sstride,
-                (f->av_frame->nb_samples - samples) * sstride);
-    }
+    AVFrame *av_frame = f->av_frame;
+    for (int n = 0; n < num_planes; n++)
+        av_frame->extended_data[n] += samples * sstride;
+    for (int n = 0; n < MPMIN(num_planes, AV_NUM_DATA_POINTERS); n++)
+        av_frame->data[n] = av_frame->extended_data[n];
+    av_frame->linesize[0] -= samples * sstride;
 
-    f->av_frame->nb_samples -= samples;
+    av_frame->nb_samples -= samples;
 
     if (f->pts != MP_NOPTS_VALUE)
         f->pts += samples / mp_aframe_get_effective_rate(f);
@@ -567,6 +605,33 @@ bool mp_aframe_set_silence(struct mp_aframe *f, int offset, int samples)
     return true;
 }
 
+// Reorder the channels of a planar frame without touching the audio data:
+// plane n becomes the previous plane src[n], and the channel map is set to
+// newmap. src must be a permutation. Only the frame's own plane pointers are
+// changed, so this works on shared data too.
+bool mp_aframe_permute_planes(struct mp_aframe *f, int *src,
+                              struct mp_chmap *newmap)
+{
+    if (!af_fmt_is_planar(mp_aframe_get_format(f)) ||
+        !mp_aframe_is_allocated(f) || !mp_aframe_set_chmap(f, newmap))
+        return false;
+
+    AVFrame *av_frame = f->av_frame;
+    int planes = mp_aframe_get_planes(f);
+    uint8_t *old[MP_NUM_CHANNELS];
+    assert(planes <= MP_NUM_CHANNELS);
+    for (int n = 0; n < planes; n++)
+        old[n] = av_frame->extended_data[n];
+    for (int n = 0; n < planes; n++) {
+        assert(src[n] >= 0 && src[n] < planes);
+        av_frame->extended_data[n] = old[src[n]];
+    }
+    for (int n = 0; n < MPMIN(planes, AV_NUM_DATA_POINTERS); n++)
+        av_frame->data[n] = av_frame->extended_data[n];
+
+    return true;
+}
+
 bool mp_aframe_reverse(struct mp_aframe *f)
 {
     int format = mp_aframe_get_format(f);
@@ -67,6 +67,8 @@ bool mp_aframe_copy_samples(struct mp_aframe *dst, int dst_offset,
                             struct mp_aframe *src, int src_offset,
                             int samples);
 bool mp_aframe_set_silence(struct mp_aframe *f, int offset, int samples);
+bool mp_aframe_permute_planes(struct mp_aframe *f, int *src,
+                              struct mp_chmap *newmap);
 
 struct mp_aframe_pool;
 struct mp_aframe_pool *mp_aframe_pool_create(void *ta_parent);
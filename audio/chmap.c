@@ -55,6 +55,14 @@ static const char *const speaker_names[MP_SPEAKER_ID_COUNT][2] = {
     [MP_SPEAKER_ID_NA]          = {"na",   "not available"},
 };
 
+// Return the short name of the speaker (like "fl"), or NULL if it has none.
+const char *mp_speaker_id_to_str(int speaker)
+{
+    if (speaker < 0 || speaker >= MP_SPEAKER_ID_COUNT)
+        return NULL;
+    return speaker_names[speaker][0];
+}
+
 // Names taken from libavutil/channel_layout.c (Not accessible by API.)
 // Channel order corresponds to lavc/waveex, except for the alsa entries.
 static const char *const std_layout_names[][2] = {
@@ -123,6 +123,8 @@ void mp_chmap_get_reorder(int src[MP_NUM_CHANNELS], const struct mp_chmap *from,
 
 int mp_chmap_diffn(const struct mp_chmap *a, const struct mp_chmap *b);
 
+const char *mp_speaker_id_to_str(int speaker);
+
 char *mp_chmap_to_str_buf(char *buf, size_t buf_size, const struct mp_chmap *src);
 #define mp_chmap_to_str(m) mp_chmap_to_str_buf((char[64]){0}, 64, (m))
 
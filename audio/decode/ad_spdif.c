@@ -22,6 +22,7 @@
 
 #include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
+#include <libavutil/intreadwrite.h>
 #include <libavutil/opt.h>
 
 #include "audio/aframe.h"
@@ -37,9 +38,31 @@
 
 #define OUTBUF_SIZE 65536
 
+// IEC 61937 burst preamble, and the data types (Pc) written directly.
+#define SYNCWORD1 0xF872
+#define SYNCWORD2 0x4E1F
+#define BURST_HEADER_SIZE 8
+
+enum {
+    IEC61937_AC3  = 0x01,
+    IEC61937_DTS1 = 0x0B,
+    IEC61937_DTS2 = 0x0C,
+    IEC61937_DTS3 = 0x0D,
+    IEC61937_EAC3 = 0x15,
+};
+
+struct burst_info {
+    int data_type;          // Pc
+    int length_code;        // Pd
+    int payload;            // bytes of the packet to send
+    int size;               // total burst size in bytes (incl. padding)
+};
+
 struct spdifContext {
     struct mp_log   *log;
     enum AVCodecID   codec_id;
+    bool             use_direct;
+    int              dtshd_rate;
     AVFormatContext *lavf_ctx;
     int              out_buffer_len;
     uint8_t          out_buffer[OUTBUF_SIZE];
@@ -156,37 +179,6 @@ static int init_filter(struct mp_filter *da, AVPacket *pkt)
     determine_codec_params(da, pkt, &profile, &c_rate);
     MP_VERBOSE(da, "In: profile=%d samplerate=%d\n", profile, c_rate);
 
-    AVFormatContext *lavf_ctx  = avformat_alloc_context();
-    if (!lavf_ctx)
-        goto fail;
-
-    spdif_ctx->lavf_ctx = lavf_ctx;
-
-    lavf_ctx->oformat = av_guess_format("spdif", NULL, NULL);
-    if (!lavf_ctx->oformat)
-        goto fail;
-
-    void *buffer = av_mallocz(OUTBUF_SIZE);
-    if (!buffer)
-        abort();
-    lavf_ctx->pb = avio_alloc_context(buffer, OUTBUF_SIZE, 1, spdif_ctx, NULL,
-                                      write_packet, NULL);
-    if (!lavf_ctx->pb) {
-        av_free(buffer);
-        goto fail;
-    }
-
-    // Request minimal buffering
-    lavf_ctx->pb->direct = 1;
-
-    AVStream *stream = avformat_new_stream(lavf_ctx, 0);
-    if (!stream)
-        goto fail;
-
-    stream->codecpar->codec_id = spdif_ctx->codec_id;
-
-    AVDictionary *format_opts = NULL;
-
     spdif_ctx->fmt = mp_aframe_create();
     talloc_steal(spdif_ctx, spdif_ctx->fmt);
 
@@ -216,8 +208,7 @@ static int init_filter(struct mp_filter *da, AVPacket *pkt)
         int dts_hd_spdif_channel_count = profile == FF_PROFILE_DTS_HD_HRA ?
                                          2 : 8;
         if (spdif_ctx->use_dts_hd && is_hd) {
-            av_dict_set_int(&format_opts, "dtshd_rate",
-                            dts_hd_spdif_channel_count * 96000, 0);
+            spdif_ctx->dtshd_rate = dts_hd_spdif_channel_count * 96000;
             sample_format               = AF_FORMAT_S_DTSHD;
             samplerate                  = 192000;
             num_channels                = dts_hd_spdif_channel_count;
@@ -255,6 +246,52 @@ static int init_filter(struct mp_filter *da, AVPacket *pkt)
 
     spdif_ctx->sstride = mp_aframe_get_sstride(spdif_ctx->fmt);
 
+    // DTS-HD, TrueHD (MAT framing), AAC and MP3 always go through libavformat.
+    spdif_ctx->use_direct = spdif_ctx->codec_id == AV_CODEC_ID_AC3 ||
+                            spdif_ctx->codec_id == AV_CODEC_ID_EAC3 ||
+                            (spdif_ctx->codec_id == AV_CODEC_ID_DTS &&
+                             !spdif_ctx->dtshd_rate);
+
+    return 0;
+}
+
+static int init_lavf(struct mp_filter *da)
+{
+    struct spdifContext *spdif_ctx = da->priv;
+
+    AVFormatContext *lavf_ctx  = avformat_alloc_context();
+    if (!lavf_ctx)
+        goto fail;
+
+    spdif_ctx->lavf_ctx = lavf_ctx;
+
+    lavf_ctx->oformat = av_guess_format("spdif", NULL, NULL);
+    if (!lavf_ctx->oformat)
+        goto fail;
+
+    void *buffer = av_mallocz(OUTBUF_SIZE);
+    if (!buffer)
+        abort();
+    lavf_ctx->pb = avio_alloc_context(buffer, OUTBUF_SIZE, 1, spdif_ctx, NULL,
+                                      write_packet, NULL);
+    if (!lavf_ctx->pb) {
+        av_free(buffer);
+        goto fail;
+    }
+
+    // Request minimal buffering
+    lavf_ctx->pb->direct = 1;
+
+    AVStream *stream = avformat_new_stream(lavf_ctx, 0);
+    if (!stream)
+        goto fail;
+
+    stream->codecpar->codec_id = spdif_ctx->codec_id;
+
+    AVDictionary *format_opts = NULL;
+    if (spdif_ctx->dtshd_rate)
+        av_dict_set_int(&format_opts, "dtshd_rate", spdif_ctx->dtshd_rate, 0);
+
     if (avformat_write_header(lavf_ctx, &format_opts) < 0) {
         MP_FATAL(da, "libavformat spdif initialization failed.\n");
         av_dict_free(&format_opts);
@@ -272,6 +309,108 @@ fail:
     return -1;
 }
 
+// Determine the IEC 61937 framing of a packet, following what libavformat's
+// spdif muxer does for the same codec. Returns false for packets that need
+// the muxer (e.g. E-AC3 frames that must be aggregated, or 14 bit DTS).
+static bool get_burst_info(struct spdifContext *spdif_ctx, uint8_t *data,
+                           int size, struct burst_info *b)
+{
+    switch (spdif_ctx->codec_id) {
+    case AV_CODEC_ID_AC3:
+        if (size < 6)
+            return false;
+        b->data_type = IEC61937_AC3 | (data[5] & 7) << 8; // bitstream mode
+        b->payload = size;
+        b->length_code = MP_ALIGN_UP(size, 2) << 3;
+        b->size = 1536 * 4;
+        break;
+    case AV_CODEC_ID_EAC3: {
+        if (size < 6)
+            return false;
+        // Frames with less than 6 audio blocks are merged by the muxer.
+        int bsid = data[5] >> 3;
+        if (bsid > 10 && (data[4] & 0xc0) != 0xc0 && (data[4] & 0x30) != 0x30)
+            return false;
+        b->data_type = IEC61937_EAC3;
+        b->payload = size;
+        b->length_code = size;
+        b->size = 24576;
+        break;
+    }
+    case AV_CODEC_ID_DTS: {
+        // 16 bit big endian core only. Extensions (DTS-HD) are dropped.
+        if (size < 10 || AV_RB32(data) != 0x7FFE8001)
+            return false;
+        int blocks = ((data[4] & 1) << 6 | data[5] >> 2) + 1;
+        int core_size = ((data[5] & 3) << 12 | data[6] << 4 | data[7] >> 4) + 1;
+        switch (blocks) {
+        case 512 >> 5:  b->data_type = IEC61937_DTS1; break;
+        case 1024 >> 5: b->data_type = IEC61937_DTS2; break;
+        case 2048 >> 5: b->data_type = IEC61937_DTS3; break;
+        default:
+            return false;
+        }
+        b->size = blocks << 7;
+        // Frames without room for the preamble are rare and left to lavf.
+        if (core_size > size || core_size > b->size - BURST_HEADER_SIZE)
+            return false;
+        b->payload = core_size;
+        b->length_code = MP_ALIGN_UP(core_size, 2) << 3;
+        break;
+    }
+    default:
+        return false;
+    }
+    return b->size % spdif_ctx->sstride == 0;
+}
+
+// Write the burst for pkt straight into a new frame, without going through
+// libavformat. Returns false if the muxer must be used instead; *out is NULL
+// on allocation failure.
+static bool write_direct(struct spdifContext *spdif_ctx, AVPacket *pkt,
+                         struct mp_aframe **out)
+{
+    struct burst_info b;
+    if (!get_burst_info(spdif_ctx, pkt->data, pkt->size, &b))
+        return false;
+
+    *out = mp_aframe_new_ref(spdif_ctx->fmt);
+    if (mp_aframe_pool_allocate(spdif_ctx->pool, *out,
+                                b.size / spdif_ctx->sstride) < 0)
+    {
+        TA_FREEP(out);
+        return true;
+    }
+    uint8_t **data = mp_aframe_get_data_rw(*out);
+    if (!data) {
+        TA_FREEP(out);
+        return true;
+    }
+
+    uint8_t *dst = data[0];
+    AV_WL16(dst + 0, SYNCWORD1);
+    AV_WL16(dst + 2, SYNCWORD2);
+    AV_WL16(dst + 4, b.data_type);
+    AV_WL16(dst + 6, b.length_code);
+    dst += BURST_HEADER_SIZE;
+
+    // The payload is sent as little endian 16 bit words.
+    uint8_t *src = pkt->data;
+    int words = b.payload / 2;
+    for (int n = 0; n < words; n++) {
+        dst[n * 2 + 0] = src[n * 2 + 1];
+        dst[n * 2 + 1] = src[n * 2 + 0];
+    }
+    int pos = words * 2;
+    if (b.payload & 1) {
+        // A final lone byte is MSB aligned.
+        dst[pos++] = 0;
+        dst[pos++] = src[b.payload - 1];
+    }
+    memset(dst + pos, 0, b.size - BURST_HEADER_SIZE - pos);
+    return true;
+}
+
 static void process(struct mp_filter *da)
 {
     struct spdifContext *spdif_ctx = da->priv;
@@ -298,10 +437,24 @@ static void process(struct mp_filter *da)
     AVPacket pkt;
     mp_set_av_packet(&pkt, mpkt, NULL);
     pkt.pts = pkt.dts = 0;
-    if (!spdif_ctx->lavf_ctx) {
+    if (!spdif_ctx->fmt) {
         if (init_filter(da, &pkt) < 0)
             goto done;
     }
+    if (spdif_ctx->use_direct) {
+        if (write_direct(spdif_ctx, &pkt, &out)) {
+            if (out)
+                mp_aframe_set_pts(out, pts);
+            goto done;
+        }
+        // The muxer may keep state across packets, so stay with it.
+        MP_VERBOSE(da, "Using libavformat for packetization.\n");
+        spdif_ctx->use_direct = false;
+    }
+    if (!spdif_ctx->lavf_ctx) {
+        if (init_lavf(da) < 0)
+            goto done;
+    }
     spdif_ctx->out_buffer_len  = 0;
     int ret = av_write_frame(spdif_ctx->lavf_ctx, &pkt);
     avio_flush(spdif_ctx->lavf_ctx->pb);
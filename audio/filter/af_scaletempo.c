@@ -36,6 +36,8 @@
 #include <limits.h>
 #include <assert.h>
 
+#include <libavutil/version.h>
+
 #include "audio/aframe.h"
 #include "audio/format.h"
 #include "common/common.h"
@@ -44,6 +46,15 @@
 #include "filters/user_filters.h"
 #include "options/m_option.h"
 
+// FFT based overlap search; libavutil/tx.h was added in FFmpeg 4.3.
+#define HAVE_SCALETEMPO_FFT \
+    (LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 51, 100))
+
+#if HAVE_SCALETEMPO_FFT
+#include <libavutil/mem.h>
+#include <libavutil/tx.h>
+#endif
+
 struct f_opts {
     float scale_nominal;
     float ms_stride;
@@ -90,6 +101,15 @@ struct priv {
     void *buf_pre_corr;
     void *table_window;
     int (*best_overlap_offset)(struct priv *s);
+#if HAVE_SCALETEMPO_FFT
+    // FFT cross-correlation, used instead of the direct search functions
+    // if that is cheaper (see init_fft()).
+    bool fft_s16;
+    int fft_len;
+    AVTXContext *fft, *ifft;
+    av_tx_fn fft_fn, ifft_fn;
+    AVComplexFloat *fft_buf[2];
+#endif
 };
 
 static bool reinit(struct mp_filter *f);
@@ -203,6 +223,133 @@ static int best_overlap_offset_s16(struct priv *s)
     return best_off * 2 * s->num_channels;
 }
 
+#if HAVE_SCALETEMPO_FFT
+
+// Same as best_overlap_offset_float/s16, but computes the correlation for all
+// offsets at once as inverse FFT of the product of the spectra. Since the
+// samples are interleaved, the correlation at frame offset off is the 1D
+// correlation at lag off * num_channels.
+static int best_overlap_offset_fft(struct priv *s)
+{
+    int nch = s->num_channels;
+    int len = s->samples_overlap - nch; // length of the correlated data
+    int num = (s->frames_search - 1) * nch + len; // searched samples
+    AVComplexFloat *a = s->fft_buf[0], *b = s->fft_buf[1];
+
+    // Both real inputs are transformed with one complex FFT: the searched
+    // data as real part, the windowed overlap as imaginary part.
+    memset(a, 0, sizeof(a[0]) * s->fft_len);
+    if (s->fft_s16) {
+        int32_t *pw = s->table_window;
+        int16_t *po = (int16_t *)s->buf_overlap + nch;
+        int16_t *ps = (int16_t *)s->buf_queue + nch;
+        for (int i = 0; i < num; i++)
+            a[i].re = ps[i];
+        for (int i = 0; i < len; i++)
+            a[i].im = (pw[i] * po[i]) >> 15;
+    } else {
+        float *pw = s->table_window;
+        float *po = (float *)s->buf_overlap + nch;
+        float *ps = (float *)s->buf_queue + nch;
+        for (int i = 0; i < num; i++)
+            a[i].re = ps[i];
+        for (int i = 0; i < len; i++)
+            a[i].im = pw[i] * po[i];
+    }
+
+    s->fft_fn(s->fft, b, a, sizeof(AVComplexFloat));
+
+    // Separate the spectra X (search) and Y (overlap) using the symmetry of
+    // real signals, and compute X * conj(Y). Constant factors (1/4 here, and
+    // fft_len from the unscaled inverse FFT) are omitted, as only the
+    // position of the maximum matters.
+    int mask = s->fft_len - 1;
+    for (int k = 0; k < s->fft_len; k++) {
+        AVComplexFloat z = b[k], zc = b[(s->fft_len - k) & mask];
+        float xr = z.re + zc.re, xi = z.im - zc.im; // 2 * X
+        float yr = z.im + zc.im, yi = zc.re - z.re; // 2 * Y
+        a[k].re = xr * yr + xi * yi;
+        a[k].im = xi * yr - xr * yi;
+    }
+
+    s->ifft_fn(s->ifft, b, a, sizeof(AVComplexFloat));
+
+    float best_corr = -FLT_MAX;
+    int best_off = 0;
+    for (int off = 0; off < s->frames_search; off++) {
+        float corr = b[off * nch].re;
+        if (corr > best_corr) {
+            best_corr = corr;
+            best_off  = off;
+        }
+    }
+
+    return best_off * (s->fft_s16 ? 2 : 4) * nch;
+}
+
+static void uninit_fft(struct priv *s)
+{
+    av_tx_uninit(&s->fft);
+    av_tx_uninit(&s->ifft);
+    av_freep(&s->fft_buf[0]);
+    av_freep(&s->fft_buf[1]);
+    s->fft_len = 0;
+}
+
+// Switch to best_overlap_offset_fft() if it needs (roughly) less arithmetic
+// than the direct search, which is the case for large search windows,
+// especially with many channels. Keeps the direct search on failure.
+static void init_fft(struct mp_filter *f, int nch, int frames_overlap,
+                     bool use_int)
+{
+    struct priv *s = f->priv;
+
+    uninit_fft(s);
+
+    int len = (frames_overlap - 1) * nch;
+    int num = (s->frames_search - 1) * nch + len;
+    int fft_len = 1;
+    int log2_len = 0;
+    while (fft_len < num) {
+        fft_len *= 2;
+        log2_len++;
+    }
+
+    // Direct: one multiply-add per sample and offset. FFT: 2 transforms,
+    // plus the rest, with a generous constant for the non-SIMD-friendly
+    // parts.
+    int64_t direct_cost = (int64_t)s->frames_search * len;
+    int64_t fft_cost = (int64_t)16 * fft_len * log2_len;
+    if (direct_cost <= fft_cost)
+        return;
+
+    float scale = 1.0;
+    if (av_tx_init(&s->fft, &s->fft_fn, AV_TX_FLOAT_FFT, 0, fft_len,
+                   &scale, 0) < 0 ||
+        av_tx_init(&s->ifft, &s->ifft_fn, AV_TX_FLOAT_FFT, 1, fft_len,
+                   &scale, 0) < 0)
+    {
+        MP_WARN(f, "Could not initialize FFT, using direct search.\n");
+        uninit_fft(s);
+        return;
+    }
+
+    s->fft_len = fft_len;
+    for (int n = 0; n < 2; n++) {
+        s->fft_buf[n] = av_malloc_array(fft_len, sizeof(AVComplexFloat));
+        if (!s->fft_buf[n]) {
+            uninit_fft(s);
+            return;
+        }
+    }
+
+    s->fft_s16 = use_int;
+    s->best_overlap_offset = best_overlap_offset_fft;
+    MP_VERBOSE(f, "Using FFT of size %d for overlap search.\n", fft_len);
+}
+
+#endif // HAVE_SCALETEMPO_FFT
+
 static void output_overlap_float(struct priv *s, void *buf_out,
                                  int bytes_off)
 {
@@ -479,6 +626,9 @@ static bool reinit(struct mp_filter *f)
             }
             s->best_overlap_offset = best_overlap_offset_float;
         }
+#if HAVE_SCALETEMPO_FFT
+        init_fft(f, nch, frames_overlap, use_int);
+#endif
     }
 
     s->bytes_per_frame = bps * nch;
@@ -551,6 +701,9 @@ static void destroy(struct mp_filter *f)
     free(s->buf_pre_corr);
     free(s->table_blend);
     free(s->table_window);
+#if HAVE_SCALETEMPO_FFT
+    uninit_fft(s);
+#endif
     TA_FREEP(&s->in);
     mp_filter_free_children(f);
 }
@@ -1,6 +1,8 @@
 #include <float.h>
 #include <math.h>
 
+#include <libavutil/cpu.h>
+
 #include "audio/chmap.h"
 #include "audio/filter/af_scaletempo2_internals.h"
 
@@ -106,75 +108,107 @@ static float multi_channel_similarity_measure(
     return similarity_measure;
 }
 
+// Dot product kernels. All variants of a build must produce bit-identical
+// results (test/scaletempo2.c checks this), so the optimized ones only differ
+// in the instruction set the same code is compiled for.
+
 #if HAVE_VECTOR
 
 typedef float v8sf __attribute__ ((vector_size (32), aligned (1)));
 
-// Dot-product of channels of two AudioBus. For each AudioBus an offset is
-// given. |dot_product[k]| is the dot-product of channel |k|. The caller should
-// allocate sufficient space for |dot_product|.
-static void multi_channel_dot_product(
-    float **a, int frame_offset_a,
-    float **b, int frame_offset_b,
-    int channels,
-    int num_frames, float *dot_product)
-{
-    assert(frame_offset_a >= 0);
-    assert(frame_offset_b >= 0);
+#define DEFINE_DOT_PRODUCT(name, attr)                                      \
+attr static float name(const float *a, const float *b, int num_frames)      \
+{                                                                           \
+    float sum = 0.0;                                                        \
+    if (num_frames >= 32) {                                                 \
+        const v8sf *va = (const v8sf *) a;                                  \
+        const v8sf *vb = (const v8sf *) b;                                  \
+        /* Initialize to product of first 32 floats */                      \
+        v8sf vsum[4] = {                                                    \
+            va[0] * vb[0],                                                  \
+            va[1] * vb[1],                                                  \
+            va[2] * vb[2],                                                  \
+            va[3] * vb[3],                                                  \
+        };                                                                  \
+        va += 4;                                                            \
+        vb += 4;                                                            \
+                                                                            \
+        /* Process `va` and `vb` across four vertical stripes */            \
+        for (int n = 1; n < num_frames / 32; n++) {                         \
+            vsum[0] += va[0] * vb[0];                                       \
+            vsum[1] += va[1] * vb[1];                                       \
+            vsum[2] += va[2] * vb[2];                                       \
+            vsum[3] += va[3] * vb[3];                                       \
+            va += 4;                                                        \
+            vb += 4;                                                        \
+        }                                                                   \
+                                                                            \
+        /* Vertical sum across `vsum` entries */                            \
+        vsum[0] += vsum[1];                                                 \
+        vsum[2] += vsum[3];                                                 \
+        vsum[0] += vsum[2];                                                 \
+                                                                            \
+        /* Horizontal sum across `vsum[0]` */                               \
+        float *vf = (float *) &vsum[0];                                     \
+        sum = vf[0] + vf[1] + vf[2] + vf[3] + vf[4] + vf[5] + vf[6] + vf[7];\
+        a = (const float *) va;                                             \
+        b = (const float *) vb;                                             \
+    }                                                                       \
+                                                                            \
+    /* Process the remainder */                                             \
+    for (int n = 0; n < num_frames % 32; n++)                               \
+        sum += *a++ * *b++;                                                 \
+    return sum;                                                             \
+}
+
+DEFINE_DOT_PRODUCT(dot_product_c, )
+
+// The generic code above only gets SSE2 on a baseline x86-64 build, which
+// splits each v8sf operation in two. AVX does them natively. FMA is
+// deliberately not enabled, because contracting the multiply-add would
+// change the results.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_DOT_PRODUCT_AVX 1
+DEFINE_DOT_PRODUCT(dot_product_avx, __attribute__((target("avx"))))
+#else
+#define HAVE_DOT_PRODUCT_AVX 0
+#endif
 
-    for (int k = 0; k < channels; ++k) {
-        const float* ch_a = a[k] + frame_offset_a;
-        const float* ch_b = b[k] + frame_offset_b;
-        float sum = 0.0;
-        if (num_frames < 32)
-            goto rest;
-
-        const v8sf *va = (const v8sf *) ch_a;
-        const v8sf *vb = (const v8sf *) ch_b;
-        v8sf vsum[4] = {
-            // Initialize to product of first 32 floats
-            va[0] * vb[0],
-            va[1] * vb[1],
-            va[2] * vb[2],
-            va[3] * vb[3],
-        };
-        va += 4;
-        vb += 4;
-
-        // Process `va` and `vb` across four vertical stripes
-        for (int n = 1; n < num_frames / 32; n++) {
-            vsum[0] += va[0] * vb[0];
-            vsum[1] += va[1] * vb[1];
-            vsum[2] += va[2] * vb[2];
-            vsum[3] += va[3] * vb[3];
-            va += 4;
-            vb += 4;
-        }
+#else // !HAVE_VECTOR
 
-        // Vertical sum across `vsum` entries
-        vsum[0] += vsum[1];
-        vsum[2] += vsum[3];
-        vsum[0] += vsum[2];
+static float dot_product_c(const float *a, const float *b, int num_frames)
+{
+    float sum = 0.0;
+    for (int n = 0; n < num_frames; n++)
+        sum += *a++ * *b++;
+    return sum;
+}
 
-        // Horizontal sum across `vsum[0]`, could probably be done better but
-        // this section is not super performance critical
-        float *vf = (float *) &vsum[0];
-        sum = vf[0] + vf[1] + vf[2] + vf[3] + vf[4] + vf[5] + vf[6] + vf[7];
-        ch_a = (const float *) va;
-        ch_b = (const float *) vb;
+#define HAVE_DOT_PRODUCT_AVX 0
 
-rest:
-        // Process the remainder
-        for (int n = 0; n < num_frames % 32; n++)
-            sum += *ch_a++ * *ch_b++;
+#endif // HAVE_VECTOR
 
-        dot_product[k] = sum;
+mp_scaletempo2_dot_fn mp_scaletempo2_get_dot_product(bool simd,
+                                                     const char **name)
+{
+    const char *dummy;
+    if (!name)
+        name = &dummy;
+#if HAVE_DOT_PRODUCT_AVX
+    if (simd && (av_get_cpu_flags() & AV_CPU_FLAG_AVX)) {
+        *name = "avx";
+        return dot_product_avx;
     }
+#endif
+    *name = "c";
+    return dot_product_c;
 }
 
-#else // !HAVE_VECTOR
-
+// Dot-product of channels of two AudioBus. For each AudioBus an offset is
+// given. |dot_product[k]| is the dot-product of channel |k|. The caller should
+// allocate sufficient space for |dot_product|.
 static void multi_channel_dot_product(
+    mp_scaletempo2_dot_fn dot,
     float **a, int frame_offset_a,
     float **b, int frame_offset_b,
     int channels,
@@ -183,18 +217,11 @@ static void multi_channel_dot_product(
     assert(frame_offset_a >= 0);
     assert(frame_offset_b >= 0);
 
-    for (int k = 0; k < channels; ++k) {
-        const float* ch_a = a[k] + frame_offset_a;
-        const float* ch_b = b[k] + frame_offset_b;
-        float sum = 0.0;
-        for (int n = 0; n < num_frames; n++)
-            sum += *ch_a++ * *ch_b++;
-        dot_product[k] = sum;
-    }
+    for (int k = 0; k < channels; ++k)
+        dot_product[k] = dot(a[k] + frame_offset_a, b[k] + frame_offset_b,
+                             num_frames);
 }
 
-#endif // HAVE_VECTOR
-
 // Fit the curve f(x) = a * x^2 + b * x + c such that
 //   f(-1) = y[0]
 //   f(0) = y[1]
@@ -222,6 +249,7 @@ static void quadratic_interpolation(
 // 1 / |decimation|. A cubic interpolation is used to have a better estimate of
 // the best match.
 static int decimated_search(
+    mp_scaletempo2_dot_fn dot,
     int decimation, struct interval exclude_interval,
     float **target_block, int target_block_frames,
     float **search_segment, int search_segment_frames,
@@ -233,7 +261,7 @@ static int decimated_search(
     float similarity[3];  // Three elements for cubic interpolation.
 
     int n = 0;
-    multi_channel_dot_product(
+    multi_channel_dot_product(dot,
         target_block, 0,
         search_segment, n,
         channels,
@@ -251,7 +279,7 @@ static int decimated_search(
         return 0;
     }
 
-    multi_channel_dot_product(
+    multi_channel_dot_product(dot,
         target_block, 0,
         search_segment, n,
         channels,
@@ -268,7 +296,7 @@ static int decimated_search(
     }
 
     for (; n < num_candidate_blocks; n += decimation) {
-        multi_channel_dot_product(
+        multi_channel_dot_product(dot,
             target_block, 0,
             search_segment, n,
             channels,
@@ -314,6 +342,7 @@ static int decimated_search(
 // |target_block|. |energy_candidate_blocks| is the energy of all blocks within
 // |search_block|.
 static int full_search(
+    mp_scaletempo2_dot_fn dot,
     int low_limit, int high_limit,
     struct interval exclude_interval,
     float **target_block, int target_block_frames,
@@ -332,8 +361,8 @@ static int full_search(
         if (in_interval(n, exclude_interval)) {
             continue;
         }
-        multi_channel_dot_product(target_block, 0, search_block, n, channels,
-            target_block_frames, dot_prod);
+        multi_channel_dot_product(dot, target_block, 0, search_block, n,
+            channels, target_block_frames, dot_prod);
 
         float similarity = multi_channel_similarity_measure(
             dot_prod, energy_target_block,
@@ -352,6 +381,7 @@ static int full_search(
 // to |target_block|. Obviously, the returned index is w.r.t. |search_block|.
 // |exclude_interval| is an interval that is excluded from the search.
 static int compute_optimal_index(
+    mp_scaletempo2_dot_fn dot,
     float **search_block, int search_block_frames,
     float **target_block, int target_block_frames,
     float *energy_candidate_blocks,
@@ -381,13 +411,13 @@ static int compute_optimal_index(
         energy_candidate_blocks);
 
     // Energy of target frame.
-    multi_channel_dot_product(
+    multi_channel_dot_product(dot,
         target_block, 0,
         target_block, 0,
         channels,
         target_block_frames, energy_target_block);
 
-    int optimal_index = decimated_search(
+    int optimal_index = decimated_search(dot,
         search_decimation, exclude_interval,
         target_block, target_block_frames,
         search_block, search_block_frames,
@@ -398,7 +428,7 @@ static int compute_optimal_index(
     int lim_low = MPMAX(0, optimal_index - search_decimation);
     int lim_high = MPMIN(num_candidate_blocks - 1,
                             optimal_index + search_decimation);
-    return full_search(
+    return full_search(dot,
         lim_low, lim_high, exclude_interval,
         target_block, target_block_frames,
         search_block, search_block_frames,
@@ -553,7 +583,7 @@ static void get_optimal_block(struct mp_scaletempo2 *p)
 
         // |optimal_index| is in frames and it is relative to the beginning of the
         // |search_block|.
-        optimal_index = compute_optimal_index(
+        optimal_index = compute_optimal_index(p->dot_product,
             p->search_block, p->search_block_size,
             p->target_block, p->ola_window_size,
             p->energy_candidate_blocks,
@@ -741,6 +771,7 @@ void mp_scaletempo2_init(struct mp_scaletempo2 *p, int channels, int rate)
     p->search_block_index = 0;
     p->num_complete_frames = 0;
     p->channels = channels;
+    p->dot_product = mp_scaletempo2_get_dot_product(true, NULL);
 
     p->samples_per_second = rate;
     p->num_candidate_blocks = (int)(p->opts->wsola_search_interval_ms
@@ -45,6 +45,10 @@ struct mp_scaletempo2_opts {
     float wsola_search_interval_ms;
 };
 
+// Dot product of two arrays of num_frames floats.
+typedef float (*mp_scaletempo2_dot_fn)(const float *a, const float *b,
+                                       int num_frames);
+
 struct mp_scaletempo2 {
     struct mp_scaletempo2_opts *opts;
     // Number of channels in audio stream.
@@ -109,6 +113,7 @@ struct mp_scaletempo2 {
     int input_buffer_size;
     int input_buffer_frames;
     float *energy_candidate_blocks;
+    mp_scaletempo2_dot_fn dot_product; // set by mp_scaletempo2_init()
 };
 
 void mp_scaletempo2_destroy(struct mp_scaletempo2 *p);
@@ -119,3 +124,8 @@ int mp_scaletempo2_fill_input_buffer(struct mp_scaletempo2 *p,
 int mp_scaletempo2_fill_buffer(struct mp_scaletempo2 *p,
     float **dest, int dest_size, float playback_rate);
 bool mp_scaletempo2_frames_available(struct mp_scaletempo2 *p);
+// Return the fastest dot product kernel supported by the CPU, or if simd is
+// false, the generic one (for cross-checking). *name is set to a short name
+// of the kernel if name is not NULL.
+mp_scaletempo2_dot_fn mp_scaletempo2_get_dot_product(bool simd,
+                                                     const char **name);
@@ -33,6 +33,7 @@
 #include <limits.h>
 #include <math.h>
 #include <string.h>
+#include <time.h>
 
 #include "config.h"
 #include "options/options.h"
@@ -40,6 +41,7 @@
 #include "options/m_option.h"
 #include "common/msg.h"
 #include "osdep/endian.h"
+#include "osdep/timer.h"
 
 #include <alsa/asoundlib.h>
 
@@ -93,6 +95,7 @@ struct priv {
     bool device_lost;
     snd_pcm_format_t alsa_fmt;
     bool can_pause;
+    bool monotonic_tstamp;  // status timestamps use CLOCK_MONOTONIC
     snd_pcm_uframes_t buffersize;
     snd_pcm_uframes_t outburst;
 
@@ -842,6 +845,17 @@ static int init_device(struct ao *ao, int mode)
             (p->alsa, alsa_swparams, boundary);
     CHECK_ALSA_ERROR("Unable to set silence size");
 
+    // Timestamp the status reports, so the delay can be corrected for the
+    // time since the device position was sampled.
+    err = snd_pcm_sw_params_set_tstamp_mode(p->alsa, alsa_swparams,
+                                            SND_PCM_TSTAMP_ENABLE);
+    CHECK_ALSA_WARN("Unable to enable timestamps");
+#if SND_LIB_VERSION >= 0x01001d
+    err = snd_pcm_sw_params_set_tstamp_type(p->alsa, alsa_swparams,
+                                            SND_PCM_TSTAMP_TYPE_MONOTONIC);
+    p->monotonic_tstamp = err >= 0;
+#endif
+
     err = snd_pcm_sw_params(p->alsa, alsa_swparams);
     CHECK_ALSA_ERROR("Unable to set sw-parameters");
 
@@ -913,6 +927,26 @@ static int init(struct ao *ao)
     return r;
 }
 
+// Map the status timestamp (CLOCK_MONOTONIC) to mp_time_us(). Returns 0 if
+// there is no usable timestamp.
+static int64_t get_status_time(snd_pcm_status_t *st)
+{
+    snd_htimestamp_t ts;
+    snd_pcm_status_get_htstamp(st, &ts);
+    if (!ts.tv_sec && !ts.tv_nsec)
+        return 0;
+
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now))
+        return 0;
+    int64_t age = (now.tv_sec - ts.tv_sec) * 1000000LL +
+                  (now.tv_nsec - ts.tv_nsec) / 1000;
+    // Reject timestamps from a different clock or from a stalled device.
+    if (age < 0 || age > 1000 * 1000)
+        return 0;
+    return mp_time_us() - age;
+}
+
 // Function for dealing with playback state. This attempts to recover the ALSA
 // state (bring it into SND_PCM_STATE_{PREPARED,RUNNING,PAUSED,UNDERRUN}). If
 // state!=NULL, fill it after recovery is attempted.
@@ -1012,6 +1046,8 @@ alsa_error:
         state->queued_samples = ao->device_buffer - state->free_samples;
         state->playing = pcmst == SND_PCM_STATE_RUNNING ||
                          pcmst == SND_PCM_STATE_PAUSED;
+        if (state_ok && pcmst == SND_PCM_STATE_RUNNING && p->monotonic_tstamp)
+            state->delay_time = get_status_time(st);
     }
 
     return state_ok;
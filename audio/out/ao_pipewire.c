@@ -42,6 +42,11 @@
 #define PW_KEY_NODE_RATE "node.rate"
 #endif
 
+// Added in Pipewire 0.3.45
+#ifndef PW_KEY_NODE_LOCK_QUANTUM
+#define PW_KEY_NODE_LOCK_QUANTUM "node.lock-quantum"
+#endif
+
 #if !PW_CHECK_VERSION(0, 3, 50)
 static inline int pw_stream_get_time_n(struct pw_stream *stream, struct pw_time *time, size_t size) {
 	return pw_stream_get_time(stream, time);
@@ -55,6 +60,7 @@ struct priv {
     struct spa_hook stream_listener;
 
     int buffer_msec;
+    bool low_latency;
     bool muted;
     float volume[2];
 };
@@ -131,6 +137,14 @@ static void on_process(void *userdata)
 
     int bytes_per_channel = buf->datas[0].maxsize / ao->channels.num;
     int nframes = bytes_per_channel / ao->sstride;
+#if PW_CHECK_VERSION(0, 3, 49)
+    // Write only as much as the graph consumes in this cycle. Filling the
+    // entire buffer would add its full size to the latency.
+    if (p->low_latency && b->requested) {
+        nframes = MPMIN(b->requested, nframes);
+        bytes_per_channel = nframes * ao->sstride;
+    }
+#endif
 
     for (int i = 0; i < buf->n_datas; i++) {
         data[i] = buf->datas[i].data;
@@ -425,6 +439,16 @@ static int init(struct ao *ao)
     pw_properties_setf(props, PW_KEY_NODE_LATENCY, "%d/%d", ao->device_buffer, ao->samplerate);
     pw_properties_setf(props, PW_KEY_NODE_RATE, "1/%d", ao->samplerate);
 
+    if (p->low_latency) {
+        // Don't let the graph raise the quantum above what we asked for.
+        pw_properties_set(props, PW_KEY_NODE_LOCK_QUANTUM, "true");
+        // Buffer no more than the device does; --audio-buffer would add to
+        // the latency.
+        ao->def_buffer = 0;
+        MP_VERBOSE(ao, "Low latency mode, requesting quantum of %d samples.\n",
+                   ao->device_buffer);
+    }
+
     enum spa_audio_format spa_format = af_fmt_to_pw(ao, ao->format);
     if (spa_format == SPA_AUDIO_FORMAT_UNKNOWN) {
         ao->format = AF_FORMAT_FLOATP;
@@ -628,6 +652,7 @@ const struct ao_driver audio_out_pipewire = {
     .options_prefix = "pipewire",
     .options = (const struct m_option[]) {
         {"buffer", OPT_INT(buffer_msec), M_RANGE(1, 2000)},
+        {"low-latency", OPT_BOOL(low_latency)},
         {0}
     },
 };
@@ -34,9 +34,29 @@
 #include "filters/f_async_queue.h"
 #include "filters/filter_internal.h"
 
+#include "osdep/atomic.h"
 #include "osdep/timer.h"
 #include "osdep/threads.h"
 
+// Single producer (playthread), single consumer (AO callback) sample ring for
+// pull AOs. Positions are absolute sample counts and never wrap.
+struct audio_ring {
+    uint8_t *planes[MP_NUM_CHANNELS];
+    int size;                   // in samples
+    atomic_ullong wpos;         // written by playthread only
+    atomic_ullong rpos;         // written by AO callback only
+    // Set by the playthread to discard everything before this position. The
+    // callback skips ahead to it on its next invocation.
+    atomic_ullong flush_pos;
+    // Set while the callback accesses the ring. If it's not set, the
+    // playthread can assume flush_pos is honored.
+    atomic_bool reading;
+};
+
+// Bit in buffer_state.cb_state. The remaining bits are a change counter, so
+// the callback can't accidentally revert a concurrent state change.
+#define CB_PLAYING 1
+
 struct buffer_state {
     // Buffer and AO
     pthread_mutex_t lock;
@@ -62,24 +82,32 @@ struct buffer_state {
     bool playing;               // logically playing audio from buffer
     bool paused;                // logically paused
 
-    int64_t end_time_us;        // absolute output time of last played sample
-
     bool initial_unblocked;
 
+    pthread_t thread;           // thread shoveling data to AO (or ring)
+    bool thread_valid;          // thread is running
+
     // "Push" AOs only (AOs with driver->write).
     bool hw_paused;             // driver->set_pause() was used successfully
     bool recover_pause;         // non-hw_paused: needs to recover delay
     struct mp_pcm_state prepause_state;
-    pthread_t thread;           // thread shoveling data to AO
-    bool thread_valid;          // thread is running
     struct mp_aframe *temp_buf;
 
+    // "Pull" AOs only (AOs without driver->write). ao_read_data() must not
+    // block, so it uses only these, and never touches the lock.
+    struct audio_ring ring;
+    atomic_uint cb_state;       // CB_PLAYING: consume from ring (written
+                                // with lock held, except for underruns)
+    mp_atomic_int64 end_time_us; // absolute output time of last played sample
+    atomic_bool cb_wakeup;      // wakeup request that couldn't lock pt_lock
+
     // --- protected by pt_lock
     bool need_wakeup;
     bool terminate;             // exit thread
 };
 
 static void *playthread(void *arg);
+static void ao_fill_ring(struct ao *ao);
 
 void ao_wakeup_playthread(struct ao *ao)
 {
@@ -90,6 +118,40 @@ void ao_wakeup_playthread(struct ao *ao)
     pthread_mutex_unlock(&p->pt_lock);
 }
 
+// Like ao_wakeup_playthread(), but never blocks. If the playthread holds
+// pt_lock, it either sees cb_wakeup before sleeping, or times out soon.
+static void wakeup_playthread_rt(struct ao *ao)
+{
+    struct buffer_state *p = ao->buffer_state;
+    atomic_store(&p->cb_wakeup, true);
+    if (pthread_mutex_trylock(&p->pt_lock) == 0) {
+        p->need_wakeup = true;
+        pthread_cond_broadcast(&p->pt_wakeup);
+        pthread_mutex_unlock(&p->pt_lock);
+    }
+}
+
+// called locked
+static void set_cb_playing(struct buffer_state *p, bool playing)
+{
+    unsigned int state = atomic_load(&p->cb_state);
+    atomic_store(&p->cb_state, ((state + 2) & ~CB_PLAYING) | playing);
+}
+
+// Number of samples in the ring not yet consumed by the callback.
+static int ring_get_queued(struct buffer_state *p)
+{
+    struct audio_ring *r = &p->ring;
+    uint64_t rpos = MPMAX(atomic_load(&r->rpos), atomic_load(&r->flush_pos));
+    return atomic_load(&r->wpos) - rpos;
+}
+
+// called locked
+static void ring_flush(struct buffer_state *p)
+{
+    atomic_store(&p->ring.flush_pos, atomic_load(&p->ring.wpos));
+}
+
 // called locked
 static void get_dev_state(struct ao *ao, struct mp_pcm_state *state)
 {
@@ -106,6 +168,15 @@ static void get_dev_state(struct ao *ao, struct mp_pcm_state *state)
         .delay = -1,
     };
     ao->driver->get_state(ao, state);
+
+    // Account for the time since the device sampled its position, instead of
+    // pretending the delay was measured right now.
+    if (state->delay_time > 0 && state->playing && state->delay > 0) {
+        int64_t age = mp_time_us() - state->delay_time;
+        if (age > 0)
+            state->delay = MPMAX(0, state->delay - age / (1000.0 * 1000.0));
+    }
+    state->delay_time = 0;
 }
 
 struct mp_async_queue *ao_get_queue(struct ao *ao)
@@ -179,25 +250,56 @@ static int read_buffer(struct ao *ao, void **data, int samples, bool *eof)
 // If this is called in paused mode, it will always return 0.
 // The caller should set out_time_us to the expected delay until the last sample
 // reaches the speakers, in microseconds, using mp_time_us() as reference.
+// This is wait-free and does not allocate, so it can be called from realtime
+// threads. The playthread keeps the ring filled.
 int ao_read_data(struct ao *ao, void **data, int samples, int64_t out_time_us)
 {
     struct buffer_state *p = ao->buffer_state;
+    struct audio_ring *r = &p->ring;
     assert(!ao->driver->write);
 
-    pthread_mutex_lock(&p->lock);
+    atomic_store(&r->reading, true);
 
-    int pos = read_buffer(ao, data, samples, &(bool){0});
+    unsigned int state = atomic_load(&p->cb_state);
+    uint64_t rpos = MPMAX(atomic_load(&r->rpos), atomic_load(&r->flush_pos));
+    int pos = 0;
 
-    if (pos > 0)
-        p->end_time_us = out_time_us;
+    if (state & CB_PLAYING) {
+        int avail = atomic_load(&r->wpos) - rpos;
+        while (pos < samples && pos < avail) {
+            int offset = rpos % r->size;
+            int copy = MPMIN(MPMIN(samples, avail) - pos, r->size - offset);
+            for (int n = 0; n < ao->num_planes; n++) {
+                memcpy((char *)data[n] + pos * ao->sstride,
+                       r->planes[n] + offset * ao->sstride, copy * ao->sstride);
+            }
+            pos += copy;
+            rpos += copy;
+        }
+    }
 
-    if (pos < samples && p->playing && !p->paused) {
-        p->playing = false;
-        // For ao_drain().
-        pthread_cond_broadcast(&p->wakeup);
+    atomic_store(&r->rpos, rpos);
+    atomic_store(&r->reading, false);
+
+    // pad with silence (underflow/paused/eof)
+    for (int n = 0; n < ao->num_planes; n++) {
+        af_fill_silence((char *)data[n] + pos * ao->sstride,
+                        (samples - pos) * ao->sstride,
+                        ao->format);
     }
 
-    pthread_mutex_unlock(&p->lock);
+    if (pos > 0)
+        atomic_store(&p->end_time_us, out_time_us);
+
+    if (pos < samples && (state & CB_PLAYING)) {
+        // Underrun or EOF. The playthread picks this up, unless the state
+        // was changed concurrently.
+        atomic_compare_exchange_strong(&p->cb_state, &state,
+                                       state & ~(unsigned int)CB_PLAYING);
+        wakeup_playthread_rt(ao);
+    } else if (ring_get_queued(p) <= r->size / 2) {
+        wakeup_playthread_rt(ao);
+    }
 
     return pos;
 }
@@ -269,9 +371,10 @@ double ao_get_delay(struct ao *ao)
         get_dev_state(ao, &state);
         driver_delay = state.delay;
     } else {
-        int64_t end = p->end_time_us;
+        int64_t end = atomic_load(&p->end_time_us);
         int64_t now = mp_time_us();
         driver_delay = MPMAX(0, (end - now) / (1000.0 * 1000.0));
+        driver_delay += ring_get_queued(p) / (double)ao->samplerate;
     }
 
     int pending = mp_async_queue_get_samples(p->queue);
@@ -310,7 +413,11 @@ void ao_reset(struct ao *ao)
     p->playing = false;
     p->recover_pause = false;
     p->hw_paused = false;
-    p->end_time_us = 0;
+    if (!ao->driver->write) {
+        set_cb_playing(p, false);
+        ring_flush(p);
+        atomic_store(&p->end_time_us, 0);
+    }
 
     pthread_mutex_unlock(&p->lock);
 
@@ -334,9 +441,14 @@ void ao_start(struct ao *ao)
 
     p->playing = true;
 
-    if (!ao->driver->write && !p->paused && !p->streaming) {
-        p->streaming = true;
-        do_start = true;
+    if (!ao->driver->write && !p->paused) {
+        // Make sure the first callback has something to play.
+        ao_fill_ring(ao);
+        set_cb_playing(p, true);
+        if (!p->streaming) {
+            p->streaming = true;
+            do_start = true;
+        }
     }
 
     pthread_mutex_unlock(&p->lock);
@@ -374,6 +486,8 @@ void ao_set_paused(struct ao *ao, bool paused)
                 p->streaming = false;
             }
         }
+        if (!ao->driver->write)
+            set_cb_playing(p, false);
         wakeup = true;
     } else if (p->playing && p->paused && !paused) {
         if (ao->driver->write) {
@@ -381,6 +495,7 @@ void ao_set_paused(struct ao *ao, bool paused)
                 ao->driver->set_pause(ao, false);
             p->hw_paused = false;
         } else {
+            set_cb_playing(p, true);
             if (!p->streaming)
                 do_start = true;
             p->streaming = true;
@@ -520,19 +635,28 @@ bool init_buffer_post(struct ao *ao)
     };
     mp_async_queue_set_config(p->queue, cfg);
 
-    if (ao->driver->write) {
-        mp_filter_graph_set_wakeup_cb(p->filter_root, wakeup_filters, ao);
+    if (!ao->driver->write) {
+        // Enough to cover a few callbacks, even if the device buffer size
+        // is unknown. It adds to the latency, so don't make it larger than
+        // the soft buffer unless the device needs it.
+        struct audio_ring *r = &p->ring;
+        r->size = MPMAX(ao->device_buffer * 2,
+                        MPMIN(ao->buffer, ao->samplerate / 10));
+        for (int n = 0; n < ao->num_planes; n++)
+            r->planes[n] = talloc_size(p, r->size * ao->sstride);
+    }
 
-        p->thread_valid = true;
-        if (pthread_create(&p->thread, NULL, playthread, ao)) {
-            p->thread_valid = false;
-            return false;
-        }
-    } else {
-        if (ao->stream_silence) {
-            ao->driver->start(ao);
-            p->streaming = true;
-        }
+    mp_filter_graph_set_wakeup_cb(p->filter_root, wakeup_filters, ao);
+
+    p->thread_valid = true;
+    if (pthread_create(&p->thread, NULL, playthread, ao)) {
+        p->thread_valid = false;
+        return false;
+    }
+
+    if (!ao->driver->write && ao->stream_silence) {
+        ao->driver->start(ao);
+        p->streaming = true;
     }
 
     if (ao->stream_silence) {
@@ -647,22 +771,68 @@ eof:
     return true;
 }
 
+// called locked
+static void ao_fill_ring(struct ao *ao)
+{
+    struct buffer_state *p = ao->buffer_state;
+    struct audio_ring *r = &p->ring;
+
+    uint64_t wpos = atomic_load(&r->wpos);
+    uint64_t rpos = atomic_load(&r->rpos);
+    // If the callback is running, it might still be reading flushed data.
+    if (!atomic_load(&r->reading))
+        rpos = MPMAX(rpos, atomic_load(&r->flush_pos));
+    int space = r->size - (int)(wpos - rpos);
+
+    while (space > 0) {
+        int offset = wpos % r->size;
+        int samples = MPMIN(space, r->size - offset);
+        void *planes[MP_NUM_CHANNELS];
+        for (int n = 0; n < ao->num_planes; n++)
+            planes[n] = r->planes[n] + offset * ao->sstride;
+        int got = read_buffer(ao, planes, samples, &(bool){0});
+        wpos += got;
+        space -= got;
+        if (got < samples)
+            break;
+    }
+
+    atomic_store(&r->wpos, wpos);
+}
+
 static void *playthread(void *arg)
 {
     struct ao *ao = arg;
     struct buffer_state *p = ao->buffer_state;
     mpthread_set_name("ao");
+    mpthread_set_class(ao->global, ao->log, "audio");
     while (1) {
         pthread_mutex_lock(&p->lock);
 
         bool retry = false;
-        if (!ao->driver->initially_blocked || p->initial_unblocked)
+        if (!ao->driver->write) {
+            // Underrun or EOF, as detected by ao_read_data().
+            if (p->playing && !p->paused &&
+                !(atomic_load(&p->cb_state) & CB_PLAYING))
+            {
+                MP_VERBOSE(ao, "audio end or underrun\n");
+                p->playing = false;
+                // For ao_drain().
+                pthread_cond_broadcast(&p->wakeup);
+            }
+            ao_fill_ring(ao);
+        } else if (!ao->driver->initially_blocked || p->initial_unblocked) {
             retry = ao_play_data(ao);
+        }
 
         // Wait until the device wants us to write more data to it.
         // Fallback to guessing.
         double timeout = INFINITY;
-        if (p->streaming && !retry && (!p->paused || ao->stream_silence)) {
+        if (!ao->driver->write) {
+            // Normally woken up by ao_read_data(), but that can fail.
+            if (p->playing && !p->paused)
+                timeout = p->ring.size / (double)ao->samplerate * 0.25;
+        } else if (p->streaming && !retry && (!p->paused || ao->stream_silence)) {
             // Wake up again if half of the audio buffer has been played.
             // Since audio could play at a faster or slower pace, wake up twice
             // as often as ideally needed.
@@ -676,6 +846,8 @@ static void *playthread(void *arg)
             pthread_mutex_unlock(&p->pt_lock);
             break;
         }
+        if (atomic_exchange(&p->cb_wakeup, false))
+            p->need_wakeup = true;
         if (!p->need_wakeup && !retry) {
             MP_STATS(ao, "start audio wait");
             struct timespec ts = mp_rel_time_to_timespec(timeout);
@@ -85,6 +85,9 @@ struct mp_pcm_state {
     int free_samples;       // number of free space in ring buffer
     int queued_samples;     // number of samples to play in ring buffer
     double delay;           // total latency in seconds (includes queued_samples)
+    int64_t delay_time;     // mp_time_us() at which the device measured delay,
+                            // if the API provides timestamps (0 if unknown);
+                            // the delay is then corrected for the time passed
     bool playing;           // set if underlying API is actually playing audio;
                             // the AO must unset it on underrun (accidental
                             // underrun and EOF are indistinguishable; the upper
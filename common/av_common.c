@@ -206,8 +206,12 @@ void mp_set_av_packet(AVPacket *dst, struct demux_packet *mpkt, AVRational *tb)
     if (mpkt && mpkt->avpacket) {
         dst->side_data = mpkt->avpacket->side_data;
         dst->side_data_elems = mpkt->avpacket->side_data_elems;
-        if (dst->data == mpkt->avpacket->data)
-            dst->buf = mpkt->avpacket->buf;
+        // Let libavcodec reference the buffer instead of copying the data,
+        // also if the packet points into the middle of it.
+        AVBufferRef *buf = mpkt->avpacket->buf;
+        if (buf && dst->data >= buf->data &&
+            dst->data + dst->size <= buf->data + buf->size)
+            dst->buf = buf;
         dst->flags |= mpkt->avpacket->flags;
     }
     if (mpkt && tb && tb->num > 0 && tb->den > 0)
@@ -102,6 +102,19 @@ void mp_rect_union(struct mp_rect *rc, const struct mp_rect *rc2)
     rc->y1 = MPMAX(rc->y1, rc2->y1);
 }
 
+// Like mp_rect_union(), but rectangles with no area count as empty, so that
+// a 0-sized rc is simply replaced by rc2.
+void mp_rect_extend(struct mp_rect *rc, const struct mp_rect *rc2)
+{
+    if (rc2->x0 >= rc2->x1 || rc2->y0 >= rc2->y1)
+        return;
+    if (rc->x0 >= rc->x1 || rc->y0 >= rc->y1) {
+        *rc = *rc2;
+        return;
+    }
+    mp_rect_union(rc, rc2);
+}
+
 // Returns whether or not a point is contained by rc
 bool mp_rect_contains(struct mp_rect *rc, int x, int y)
 {
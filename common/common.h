@@ -102,6 +102,7 @@ struct mp_rect {
 #define mp_rect_h(r) ((r).y1 - (r).y0)
 
 void mp_rect_union(struct mp_rect *rc, const struct mp_rect *src);
+void mp_rect_extend(struct mp_rect *rc, const struct mp_rect *src);
 bool mp_rect_intersection(struct mp_rect *rc, const struct mp_rect *rc2);
 bool mp_rect_contains(struct mp_rect *rc, int x, int y);
 bool mp_rect_equals(struct mp_rect *rc1, struct mp_rect *rc2);
@@ -36,6 +36,7 @@ struct encode_opts {
     char **fopts;
     char *vcodec;
     char **vopts;
+    int vthreads;
     char *acodec;
     char **aopts;
     float voffset;
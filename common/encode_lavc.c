@@ -82,6 +82,7 @@ const struct m_sub_options encode_config = {
         {"ofopts", OPT_KEYVALUELIST(fopts), .flags = M_OPT_HAVE_HELP},
         {"ovc", OPT_STRING(vcodec)},
         {"ovcopts", OPT_KEYVALUELIST(vopts), .flags = M_OPT_HAVE_HELP},
+        {"ovc-threads", OPT_INT(vthreads), M_RANGE(0, DBL_MAX)},
         {"oac", OPT_STRING(acodec)},
         {"oacopts", OPT_KEYVALUELIST(aopts), .flags = M_OPT_HAVE_HELP},
         {"ovoffset", OPT_FLOAT(voffset), M_RANGE(-1000000.0, 1000000.0),
@@ -866,6 +867,14 @@ bool encoder_init_codec_and_muxer(struct encoder_context *p,
         ? p->options->vopts
         : p->options->aopts;
 
+    // Leave the encoder's own default alone unless requested; the thread count
+    // can affect slicing and thus the output.
+    if (p->type == STREAM_VIDEO && p->options->vthreads > 0) {
+        MP_VERBOSE(p, "Requesting %d threads for encoding.\n",
+                   p->options->vthreads);
+        p->encoder->thread_count = p->options->vthreads;
+    }
+
     // Set these now, so the code below can read back parsed settings from it.
     mp_set_avopts(p->log, p->encoder, copts);
 
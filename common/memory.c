@@ -0,0 +1,137 @@
+#include <pthread.h>
+
+#include "common.h"
+#include "global.h"
+#include "memory.h"
+#include "misc/linked_list.h"
+#include "misc/node.h"
+
+struct mp_memory_base {
+    pthread_mutex_t lock;
+    int64_t budget;
+    int64_t total;
+
+    struct {
+        struct mp_memory_user *head, *tail;
+    } list;
+};
+
+struct mp_memory_user {
+    struct mp_memory_base *base;
+    const char *name;
+    int64_t bytes;
+
+    struct {
+        struct mp_memory_user *prev, *next;
+    } list;
+};
+
+static void memory_destroy(void *p)
+{
+    struct mp_memory_base *base = p;
+
+    // All users must have been destroyed before this.
+    assert(!base->list.head);
+
+    pthread_mutex_destroy(&base->lock);
+}
+
+void mp_memory_global_init(struct mpv_global *global)
+{
+    assert(!global->memory);
+    struct mp_memory_base *base = talloc_zero(global, struct mp_memory_base);
+    ta_set_destructor(base, memory_destroy);
+    pthread_mutex_init(&base->lock, NULL);
+
+    global->memory = base;
+}
+
+void mp_memory_set_budget(struct mpv_global *global, int64_t budget)
+{
+    struct mp_memory_base *base = global->memory;
+
+    pthread_mutex_lock(&base->lock);
+    base->budget = MPMAX(budget, 0);
+    pthread_mutex_unlock(&base->lock);
+}
+
+void mp_memory_query(struct mpv_global *global, struct mpv_node *out)
+{
+    struct mp_memory_base *base = global->memory;
+
+    pthread_mutex_lock(&base->lock);
+
+    node_init(out, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_int64(out, "total", base->total);
+    if (base->budget)
+        node_map_add_int64(out, "budget", base->budget);
+
+    struct mpv_node *users = node_map_add(out, "users", MPV_FORMAT_NODE_MAP);
+    for (struct mp_memory_user *u = base->list.head; u; u = u->list.next) {
+        struct mpv_node *entry = NULL;
+        for (int n = 0; n < users->u.list->num; n++) {
+            if (strcmp(users->u.list->keys[n], u->name) == 0)
+                entry = &users->u.list->values[n];
+        }
+        if (entry) {
+            entry->u.int64 += u->bytes;
+        } else {
+            node_map_add_int64(users, u->name, u->bytes);
+        }
+    }
+
+    pthread_mutex_unlock(&base->lock);
+}
+
+static void user_destroy(void *p)
+{
+    struct mp_memory_user *u = p;
+    struct mp_memory_base *base = u->base;
+
+    pthread_mutex_lock(&base->lock);
+    base->total -= u->bytes;
+    LL_REMOVE(list, &base->list, u);
+    pthread_mutex_unlock(&base->lock);
+}
+
+struct mp_memory_user *mp_memory_user_create(void *ta_parent,
+                                             struct mpv_global *global,
+                                             const char *name)
+{
+    struct mp_memory_base *base = global->memory;
+    assert(base);
+
+    struct mp_memory_user *u = talloc_zero(ta_parent, struct mp_memory_user);
+    u->base = base;
+    u->name = talloc_strdup(u, name);
+    ta_set_destructor(u, user_destroy);
+
+    pthread_mutex_lock(&base->lock);
+    LL_APPEND(list, &base->list, u);
+    pthread_mutex_unlock(&base->lock);
+
+    return u;
+}
+
+void mp_memory_report(struct mp_memory_user *u, int64_t bytes)
+{
+    struct mp_memory_base *base = u->base;
+
+    pthread_mutex_lock(&base->lock);
+    base->total += bytes - u->bytes;
+    u->bytes = bytes;
+    pthread_mutex_unlock(&base->lock);
+}
+
+int64_t mp_memory_get_allowance(struct mp_memory_user *u)
+{
+    struct mp_memory_base *base = u->base;
+    int64_t res = INT64_MAX;
+
+    pthread_mutex_lock(&base->lock);
+    if (base->budget)
+        res = MPMAX(base->budget - (base->total - u->bytes), 0);
+    pthread_mutex_unlock(&base->lock);
+
+    return res;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+struct mpv_global;
+struct mpv_node;
+struct mp_memory_user;
+
+// Process-wide accounting of the larger memory consumers (caches, pools,
+// script heaps). Each consumer reports its current size, and consumers that
+// can shrink (caches) query how much they are allowed to use under the global
+// budget (--memory-budget).
+void mp_memory_global_init(struct mpv_global *global);
+
+// Set the budget in bytes for all users together. 0 means unlimited.
+void mp_memory_set_budget(struct mpv_global *global, int64_t budget);
+
+// Return a MPV_FORMAT_NODE_MAP with "total" and "budget" (bytes, if set), and
+// a "users" sub-map with the summed size of all users of each name.
+void mp_memory_query(struct mpv_global *global, struct mpv_node *out);
+
+// Register a memory consumer. Multiple users can share a name. Freeing the
+// returned object (e.g. via the ta_parent) removes it from the accounting.
+// The functions below are thread-safe.
+struct mp_memory_user *mp_memory_user_create(void *ta_parent,
+                                             struct mpv_global *global,
+                                             const char *name);
+
+// Set the number of bytes currently used.
+void mp_memory_report(struct mp_memory_user *u, int64_t bytes);
+
+// Return how many bytes this user may use in total, which is what is left of
+// the budget after subtracting the usage of all other users (but at least 0).
+// Returns INT64_MAX if there is no budget.
+int64_t mp_memory_get_allowance(struct mp_memory_user *u);
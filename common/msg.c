@@ -27,6 +27,7 @@
 #include "mpv_talloc.h"
 
 #include "misc/bstr.h"
+#include "misc/linked_list.h"
 #include "osdep/atomic.h"
 #include "common/common.h"
 #include "common/global.h"
@@ -45,11 +46,18 @@
 
 #define TERM_BUF 100
 
+// Terminal output queued for the terminal thread is limited to this size.
+// Beyond it, messages at MSGL_V and higher are dropped, and other messages
+// block until the terminal catches up.
+#define TERM_QUEUE_MAX (256 * 1024)
+
 struct mp_log_root {
     struct mpv_global *global;
     pthread_mutex_t lock;
     pthread_mutex_t log_file_lock;
     pthread_cond_t log_file_wakeup;
+    pthread_mutex_t term_lock;
+    pthread_cond_t term_wakeup;
     // --- protected by lock
     char **msg_levels;
     bool use_terminal;  // make accesses to stderr/stdout
@@ -66,11 +74,11 @@ struct mp_log_root {
     struct mp_log_buffer *early_buffer;
     FILE *stats_file;
     bstr buffer;
-    // --- must be accessed atomically
-    /* This is incremented every time the msglevels must be reloaded.
-     * (This is perhaps better than maintaining a globally accessible and
-     * synchronized mp_log tree.) */
-    atomic_ulong reload_counter;
+    bstr term_line;     // terminal output being formatted
+    // All mp_log instances (their levels are updated on changes)
+    struct {
+        struct mp_log *head, *tail;
+    } logs;
     // --- owner thread only (caller of mp_msg_init() etc.)
     char *log_path;
     char *stats_path;
@@ -80,16 +88,27 @@ struct mp_log_root {
     struct mp_log_buffer *log_file_buffer;
     // --- protected by log_file_lock
     bool log_file_thread_active; // also termination signal for the thread
+    // --- owner thread only
+    pthread_t term_thread;
+    // --- protected by term_lock
+    bool term_thread_active;    // also termination signal for the thread
+    // Records of: 1 byte stream (1=stdout, 2=stderr), text, '\0'
+    bstr term_queue;
+    uint64_t term_dropped;
 };
 
 struct mp_log {
+    struct mp_log_level level;  // minimum log level for any outputs; must be
+                                // the first member (see mp_msg_test())
     struct mp_log_root *root;
     const char *prefix;
     const char *verbose_prefix;
+    // --- protected by root->lock
     int max_level;              // minimum log level for this instance
-    int level;                  // minimum log level for any outputs
     int terminal_level;         // minimum log level for terminal output
-    atomic_ulong reload_counter;
+    struct {
+        struct mp_log *prev, *next;
+    } list;
     char *partial;
 };
 
@@ -109,7 +128,7 @@ struct mp_log_buffer {
     int level;
 };
 
-static const struct mp_log null_log = {0};
+static const struct mp_log null_log = {.level = {ATOMIC_VAR_INIT(-1)}};
 struct mp_log *const mp_null_log = (struct mp_log *)&null_log;
 
 static bool match_mod(const char *name, const char *mod)
@@ -121,32 +140,39 @@ static bool match_mod(const char *name, const char *mod)
     return bstr_eatstart0(&b, mod) && (bstr_eatstart0(&b, "/") || !b.len);
 }
 
+// Must be called with root->lock held.
 static void update_loglevel(struct mp_log *log)
 {
     struct mp_log_root *root = log->root;
-    pthread_mutex_lock(&root->lock);
-    log->level = MSGL_STATUS + root->verbose; // default log level
+    int level = MSGL_STATUS + root->verbose; // default log level
     if (root->really_quiet)
-        log->level = -1;
+        level = -1;
     for (int n = 0; root->msg_levels && root->msg_levels[n * 2 + 0]; n++) {
         if (match_mod(log->verbose_prefix, root->msg_levels[n * 2 + 0]))
-            log->level = mp_msg_find_level(root->msg_levels[n * 2 + 1]);
+            level = mp_msg_find_level(root->msg_levels[n * 2 + 1]);
     }
-    log->terminal_level = log->level;
-    for (int n = 0; n < log->root->num_buffers; n++) {
-        int buffer_level = log->root->buffers[n]->level;
+    log->terminal_level = level;
+    for (int n = 0; n < root->num_buffers; n++) {
+        int buffer_level = root->buffers[n]->level;
         if (buffer_level == MP_LOG_BUFFER_MSGL_LOGFILE)
             buffer_level = MSGL_DEBUG;
         if (buffer_level != MP_LOG_BUFFER_MSGL_TERM)
-            log->level = MPMAX(log->level, buffer_level);
+            level = MPMAX(level, buffer_level);
     }
-    if (log->root->log_file)
-        log->level = MPMAX(log->level, MSGL_DEBUG);
-    if (log->root->stats_file)
-        log->level = MPMAX(log->level, MSGL_STATS);
-    log->level = MPMIN(log->level, log->max_level);
-    atomic_store(&log->reload_counter, atomic_load(&log->root->reload_counter));
-    pthread_mutex_unlock(&root->lock);
+    if (root->log_file)
+        level = MPMAX(level, MSGL_DEBUG);
+    if (root->stats_file)
+        level = MPMAX(level, MSGL_STATS);
+    level = MPMIN(level, log->max_level);
+    atomic_store_explicit(&log->level.level, level, memory_order_relaxed);
+}
+
+// Called with root->lock held whenever something affecting the levels
+// changes, so that mp_msg_test() never needs to check for updates.
+static void update_all_loglevels(struct mp_log_root *root)
+{
+    for (struct mp_log *log = root->logs.head; log; log = log->list.next)
+        update_loglevel(log);
 }
 
 // Set (numerically) the maximum level that should still be output for this log
@@ -157,23 +183,68 @@ void mp_msg_set_max_level(struct mp_log *log, int lev)
         return;
     pthread_mutex_lock(&log->root->lock);
     log->max_level = MPCLAMP(lev, -1, MSGL_MAX);
-    pthread_mutex_unlock(&log->root->lock);
     update_loglevel(log);
+    pthread_mutex_unlock(&log->root->lock);
 }
 
 // Get the current effective msg level.
 // Thread-safety: see mp_msg().
 int mp_msg_level(struct mp_log *log)
 {
-    struct mp_log_root *root = log->root;
-    if (!root)
-        return -1;
-    if (atomic_load_explicit(&log->reload_counter, memory_order_relaxed) !=
-        atomic_load_explicit(&root->reload_counter, memory_order_relaxed))
-    {
-        update_loglevel(log);
+    return atomic_load_explicit(&log->level.level, memory_order_relaxed);
+}
+
+static void term_printf(struct mp_log_root *root, const char *format, ...)
+    PRINTF_ATTRIBUTE(2, 3);
+
+// Append to root->term_line, which is written by term_output().
+static void term_printf(struct mp_log_root *root, const char *format, ...)
+{
+    va_list va;
+    va_start(va, format);
+    bstr_xappend_vasprintf(root, &root->term_line, format, va);
+    va_end(va);
+}
+
+// Write root->term_line to stream, and clear it. If the terminal thread is
+// running, this only queues the text, so the caller doesn't wait for the
+// terminal (unless the queue is full).
+static void term_output(struct mp_log_root *root, FILE *stream, int lev)
+{
+    bstr *line = &root->term_line;
+    if (!line->len)
+        return;
+
+    pthread_mutex_lock(&root->term_lock);
+    bool queued = false;
+    while (root->term_thread_active) {
+        if (root->term_queue.len + line->len + 2 <= TERM_QUEUE_MAX ||
+            !root->term_queue.len)
+        {
+            unsigned char type = stream == stdout ? 1 : 2;
+            bstr_xappend(NULL, &root->term_queue, (bstr){&type, 1});
+            bstr_xappend(NULL, &root->term_queue, *line);
+            // (bstr_xappend() always adds a '\0' after the data)
+            root->term_queue.len += 1;
+            pthread_cond_broadcast(&root->term_wakeup);
+            queued = true;
+            break;
+        }
+        if (lev >= MSGL_V) {
+            root->term_dropped += 1;
+            queued = true;
+            break;
+        }
+        pthread_cond_wait(&root->term_wakeup, &root->term_lock);
     }
-    return log->level;
+    pthread_mutex_unlock(&root->term_lock);
+
+    if (!queued) {
+        fprintf(stream, "%.*s", BSTR_P(*line));
+        fflush(stream);
+    }
+
+    line->len = 0;
 }
 
 // Reposition cursor and clear lines for outputting the status line. In certain
@@ -181,8 +252,6 @@ int mp_msg_level(struct mp_log *log)
 // multiple lines.
 static void prepare_status_line(struct mp_log_root *root, char *new_status)
 {
-    FILE *f = stderr;
-
     size_t new_lines = 1;
     char *tmp = new_status;
     while (1) {
@@ -200,32 +269,35 @@ static void prepare_status_line(struct mp_log_root *root, char *new_status)
     size_t clear_lines = MPMIN(MPMAX(new_lines, old_lines), root->blank_lines);
 
     // clear the status line itself
-    fprintf(f, "\r\033[K");
+    term_printf(root, "\r\033[K");
     // and clear all previous old lines
     for (size_t n = 1; n < clear_lines; n++)
-        fprintf(f, "\033[A\r\033[K");
+        term_printf(root, "\033[A\r\033[K");
     // skip "unused" blank lines, so that status is aligned to term bottom
     for (size_t n = new_lines; n < clear_lines; n++)
-        fprintf(f, "\n");
+        term_printf(root, "\n");
 
     root->status_lines = new_lines;
     root->blank_lines = MPMAX(root->blank_lines, new_lines);
+
+    term_output(root, stderr, MSGL_STATUS);
 }
 
-static void flush_status_line(struct mp_log_root *root)
+static void flush_status_line(struct mp_log_root *root, int lev)
 {
     // If there was a status line, don't overwrite it, but skip it.
     if (root->status_lines)
-        fprintf(stderr, "\n");
+        term_printf(root, "\n");
     root->status_lines = 0;
     root->blank_lines = 0;
+    term_output(root, stderr, lev);
 }
 
 void mp_msg_flush_status_line(struct mp_log *log)
 {
     if (log->root) {
         pthread_mutex_lock(&log->root->lock);
-        flush_status_line(log->root);
+        flush_status_line(log->root, MSGL_STATUS);
         pthread_mutex_unlock(&log->root->lock);
     }
 }
@@ -235,7 +307,8 @@ void mp_msg_set_term_title(struct mp_log *log, const char *title)
     if (log->root && title) {
         // Lock because printf to terminal is not necessarily atomic.
         pthread_mutex_lock(&log->root->lock);
-        fprintf(stderr, "\e]0;%s\007", title);
+        term_printf(log->root, "\e]0;%s\007", title);
+        term_output(log->root, stderr, MSGL_STATUS);
         pthread_mutex_unlock(&log->root->lock);
     }
 }
@@ -249,23 +322,24 @@ bool mp_msg_has_status_line(struct mpv_global *global)
     return r;
 }
 
-static void set_term_color(FILE *stream, int c)
+static void set_term_color(struct mp_log_root *root, int c)
 {
     if (c == -1) {
-        fprintf(stream, "\033[0m");
+        term_printf(root, "\033[0m");
     } else {
-        fprintf(stream, "\033[%d;3%dm", c >> 3, c & 7);
+        term_printf(root, "\033[%d;3%dm", c >> 3, c & 7);
     }
 }
 
 
-static void set_msg_color(FILE* stream, int lev)
+static void set_msg_color(struct mp_log_root *root, int lev)
 {
     static const int v_colors[] = {9, 1, 3, -1, -1, 2, 8, 8, 8, -1};
-    set_term_color(stream, v_colors[lev]);
+    set_term_color(root, v_colors[lev]);
 }
 
-static void pretty_print_module(FILE* stream, const char *prefix, bool use_color, int lev)
+static void pretty_print_module(struct mp_log_root *root, const char *prefix,
+                                bool use_color, int lev)
 {
     // Use random color based on the name of the module
     if (use_color) {
@@ -273,15 +347,15 @@ static void pretty_print_module(FILE* stream, const char *prefix, bool use_color
         unsigned int mod = 0;
         for (int i = 0; i < prefix_len; ++i)
             mod = mod * 33 + prefix[i];
-        set_term_color(stream, (mod + 1) % 15 + 1);
+        set_term_color(root, (mod + 1) % 15 + 1);
     }
 
-    fprintf(stream, "%10s", prefix);
+    term_printf(root, "%10s", prefix);
     if (use_color)
-        set_term_color(stream, -1);
-    fprintf(stream, ": ");
+        set_term_color(root, -1);
+    term_printf(root, ": ");
     if (use_color)
-        set_msg_color(stream, lev);
+        set_msg_color(root, lev);
 }
 
 static bool test_terminal_level(struct mp_log *log, int lev)
@@ -300,13 +374,13 @@ static void print_terminal_line(struct mp_log *log, int lev,
     FILE *stream = (root->force_stderr || lev == MSGL_STATUS) ? stderr : stdout;
 
     if (lev != MSGL_STATUS)
-        flush_status_line(root);
+        flush_status_line(root, lev);
 
     if (root->color)
-        set_msg_color(stream, lev);
+        set_msg_color(root, lev);
 
     if (root->show_time)
-        fprintf(stream, "[%10.6f] ", (mp_time_us() - MP_START_TIME) / 1e6);
+        term_printf(root, "[%10.6f] ", (mp_time_us() - MP_START_TIME) / 1e6);
 
     const char *prefix = log->prefix;
     if ((lev >= MSGL_V) || root->verbose || root->module)
@@ -314,17 +388,18 @@ static void print_terminal_line(struct mp_log *log, int lev,
 
     if (prefix) {
         if (root->module) {
-            pretty_print_module(stream, prefix, root->color, lev);
+            pretty_print_module(root, prefix, root->color, lev);
         } else {
-            fprintf(stream, "[%s] ", prefix);
+            term_printf(root, "[%s] ", prefix);
         }
     }
 
-    fprintf(stream, "%s%s", text, trail);
+    term_printf(root, "%s%s", text, trail);
 
     if (root->color)
-        set_term_color(stream, -1);
-    fflush(stream);
+        set_term_color(root, -1);
+
+    term_output(root, stream, lev);
 }
 
 static struct mp_log_buffer_entry *log_buffer_read(struct mp_log_buffer *buffer)
@@ -456,6 +531,11 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va)
 static void destroy_log(void *ptr)
 {
     struct mp_log *log = ptr;
+    if (log->root) {
+        pthread_mutex_lock(&log->root->lock);
+        LL_REMOVE(list, &log->root->logs, log);
+        pthread_mutex_unlock(&log->root->lock);
+    }
     // This is not managed via talloc itself, because mp_msg calls must be
     // thread-safe, while talloc is not thread-safe.
     talloc_free(log->partial);
@@ -475,6 +555,7 @@ struct mp_log *mp_log_new(void *talloc_ctx, struct mp_log *parent,
 {
     assert(parent);
     struct mp_log *log = talloc_zero(talloc_ctx, struct mp_log);
+    atomic_store(&log->level.level, -1);
     if (!parent->root)
         return log; // same as null_log
     talloc_set_destructor(log, destroy_log);
@@ -503,6 +584,10 @@ struct mp_log *mp_log_new(void *talloc_ctx, struct mp_log *parent,
         log->prefix = talloc_strdup(log, parent->prefix);
         log->verbose_prefix = talloc_strdup(log, parent->verbose_prefix);
     }
+    pthread_mutex_lock(&log->root->lock);
+    LL_APPEND(list, &log->root->logs, log);
+    update_loglevel(log);
+    pthread_mutex_unlock(&log->root->lock);
     return log;
 }
 
@@ -513,12 +598,13 @@ void mp_msg_init(struct mpv_global *global)
     struct mp_log_root *root = talloc_zero(NULL, struct mp_log_root);
     *root = (struct mp_log_root){
         .global = global,
-        .reload_counter = ATOMIC_VAR_INIT(1),
     };
 
     pthread_mutex_init(&root->lock, NULL);
     pthread_mutex_init(&root->log_file_lock, NULL);
     pthread_cond_init(&root->log_file_wakeup, NULL);
+    pthread_mutex_init(&root->term_lock, NULL);
+    pthread_cond_init(&root->term_wakeup, NULL);
 
     struct mp_log dummy = { .root = root };
     struct mp_log *log = mp_log_new(root, &dummy, "");
@@ -590,6 +676,85 @@ static void terminate_log_file_thread(struct mp_log_root *root)
     root->log_file = NULL;
 }
 
+static void *term_thread(void *p)
+{
+    struct mp_log_root *root = p;
+
+    mpthread_set_name("terminal");
+
+    bstr buf = {0};
+
+    pthread_mutex_lock(&root->term_lock);
+
+    while (1) {
+        if (root->term_queue.len) {
+            // Swap the buffers, so writers can continue queuing meanwhile.
+            MPSWAP(bstr, buf, root->term_queue);
+            uint64_t dropped = root->term_dropped;
+            root->term_dropped = 0;
+            pthread_mutex_unlock(&root->term_lock);
+
+            for (size_t pos = 0; pos < buf.len;) {
+                FILE *stream = buf.start[pos] == 1 ? stdout : stderr;
+                char *text = (char *)&buf.start[pos + 1];
+                fprintf(stream, "%s", text);
+                fflush(stream);
+                pos += 1 + strlen(text) + 1;
+            }
+            buf.len = 0;
+            if (dropped) {
+                fprintf(stderr, "[%"PRIu64" verbose terminal messages "
+                        "dropped]\n", dropped);
+            }
+
+            pthread_mutex_lock(&root->term_lock);
+            // Writers might be blocked if the queue was full.
+            pthread_cond_broadcast(&root->term_wakeup);
+        } else if (root->term_thread_active) {
+            pthread_cond_wait(&root->term_wakeup, &root->term_lock);
+        } else {
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&root->term_lock);
+
+    talloc_free(buf.start);
+    return NULL;
+}
+
+// Only to be called from the main thread.
+static void start_term_thread(struct mp_log_root *root)
+{
+    pthread_mutex_lock(&root->term_lock);
+    bool start = !root->term_thread_active;
+    root->term_thread_active = true;
+    pthread_mutex_unlock(&root->term_lock);
+
+    if (start && pthread_create(&root->term_thread, NULL, term_thread, root)) {
+        pthread_mutex_lock(&root->term_lock);
+        root->term_thread_active = false;
+        pthread_mutex_unlock(&root->term_lock);
+    }
+}
+
+// Only to be called from the main thread. Writes all queued output.
+static void terminate_term_thread(struct mp_log_root *root)
+{
+    bool wait_terminate = false;
+
+    pthread_mutex_lock(&root->term_lock);
+    if (root->term_thread_active) {
+        root->term_thread_active = false;
+        pthread_cond_broadcast(&root->term_wakeup);
+        wait_terminate = true;
+    }
+    pthread_mutex_unlock(&root->term_lock);
+
+    if (wait_terminate)
+        pthread_join(root->term_thread, NULL);
+}
+
 // If opt is different from *current_path, update *current_path and return true.
 // No lock must be held; passed values must be accessible without.
 static bool check_new_path(struct mpv_global *global, char *opt,
@@ -633,9 +798,14 @@ void mp_msg_update_msglevels(struct mpv_global *global, struct MPOpts *opts)
     m_option_type_msglevels.free(&root->msg_levels);
     m_option_type_msglevels.copy(NULL, &root->msg_levels, &opts->msg_levels);
 
-    atomic_fetch_add(&root->reload_counter, 1);
+    update_all_loglevels(root);
     pthread_mutex_unlock(&root->lock);
 
+    // Terminal output is written asynchronously, so that slow terminals don't
+    // stall the logging threads.
+    if (opts->use_terminal)
+        start_term_thread(root);
+
     if (check_new_path(global, opts->log_file, &root->log_path)) {
         terminate_log_file_thread(root);
         if (root->log_path) {
@@ -656,6 +826,9 @@ void mp_msg_update_msglevels(struct mpv_global *global, struct MPOpts *opts)
                        root->log_path);
             }
         }
+        pthread_mutex_lock(&root->lock);
+        update_all_loglevels(root);
+        pthread_mutex_unlock(&root->lock);
     }
 
     if (check_new_path(global, opts->dump_stats, &root->stats_path)) {
@@ -669,6 +842,7 @@ void mp_msg_update_msglevels(struct mpv_global *global, struct MPOpts *opts)
             root->stats_file = fopen(root->stats_path, "wb");
             open_error = !root->stats_file;
         }
+        update_all_loglevels(root);
         pthread_mutex_unlock(&root->lock);
 
         if (open_error) {
@@ -699,6 +873,8 @@ void mp_msg_uninit(struct mpv_global *global)
 {
     struct mp_log_root *root = global->log->root;
     terminate_log_file_thread(root);
+    terminate_term_thread(root);
+    talloc_free(root->term_queue.start);
     mp_msg_log_buffer_destroy(root->early_buffer);
     assert(root->num_buffers == 0);
     if (root->stats_file)
@@ -706,9 +882,18 @@ void mp_msg_uninit(struct mpv_global *global)
     talloc_free(root->stats_path);
     talloc_free(root->log_path);
     m_option_type_msglevels.free(&root->msg_levels);
+    // Remaining mp_log instances (including global->log) become null logs.
+    while (root->logs.head) {
+        struct mp_log *log = root->logs.head;
+        LL_REMOVE(list, &root->logs, log);
+        atomic_store(&log->level.level, -1);
+        log->root = NULL;
+    }
     pthread_mutex_destroy(&root->lock);
     pthread_mutex_destroy(&root->log_file_lock);
     pthread_cond_destroy(&root->log_file_wakeup);
+    pthread_mutex_destroy(&root->term_lock);
+    pthread_cond_destroy(&root->term_wakeup);
     talloc_free(root);
     global->log = NULL;
 }
@@ -781,7 +966,7 @@ struct mp_log_buffer *mp_msg_log_buffer_new(struct mpv_global *global,
 
     MP_TARRAY_APPEND(root, root->buffers, root->num_buffers, buffer);
 
-    atomic_fetch_add(&root->reload_counter, 1);
+    update_all_loglevels(root);
     pthread_mutex_unlock(&root->lock);
 
     return buffer;
@@ -820,7 +1005,7 @@ found:
     pthread_mutex_destroy(&buffer->lock);
     talloc_free(buffer);
 
-    atomic_fetch_add(&root->reload_counter, 1);
+    update_all_loglevels(root);
     pthread_mutex_unlock(&root->lock);
 }
 
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include "osdep/atomic.h"
 #include "osdep/compiler.h"
 
 struct mp_log;
@@ -55,26 +56,38 @@ void mp_msg_va(struct mp_log *log, int lev, const char *format, va_list va);
 
 int mp_msg_level(struct mp_log *log);
 
+// Internal, the first member of struct mp_log. It's kept up to date by msg.c,
+// so mp_msg_test() is a single atomic load.
+struct mp_log_level {
+    atomic_int level;
+};
+
 static inline bool mp_msg_test(struct mp_log *log, int lev)
 {
-    return lev <= mp_msg_level(log);
+    return lev <= atomic_load_explicit(&((struct mp_log_level *)log)->level,
+                                       memory_order_relaxed);
 }
 
+// Like mp_msg(), but the arguments are not evaluated if the message is not
+// going to be output.
+#define mp_msg_lazy(log, lev, ...) \
+    ((void)(mp_msg_test(log, lev) && (mp_msg(log, lev, __VA_ARGS__), true)))
+
 void mp_msg_set_max_level(struct mp_log *log, int lev);
 
 // Convenience macros.
-#define mp_fatal(log, ...)      mp_msg(log, MSGL_FATAL, __VA_ARGS__)
-#define mp_err(log, ...)        mp_msg(log, MSGL_ERR, __VA_ARGS__)
-#define mp_warn(log, ...)       mp_msg(log, MSGL_WARN, __VA_ARGS__)
-#define mp_info(log, ...)       mp_msg(log, MSGL_INFO, __VA_ARGS__)
-#define mp_verbose(log, ...)    mp_msg(log, MSGL_V, __VA_ARGS__)
-#define mp_dbg(log, ...)        mp_msg(log, MSGL_DEBUG, __VA_ARGS__)
-#define mp_trace(log, ...)      mp_msg(log, MSGL_TRACE, __VA_ARGS__)
+#define mp_fatal(log, ...)      mp_msg_lazy(log, MSGL_FATAL, __VA_ARGS__)
+#define mp_err(log, ...)        mp_msg_lazy(log, MSGL_ERR, __VA_ARGS__)
+#define mp_warn(log, ...)       mp_msg_lazy(log, MSGL_WARN, __VA_ARGS__)
+#define mp_info(log, ...)       mp_msg_lazy(log, MSGL_INFO, __VA_ARGS__)
+#define mp_verbose(log, ...)    mp_msg_lazy(log, MSGL_V, __VA_ARGS__)
+#define mp_dbg(log, ...)        mp_msg_lazy(log, MSGL_DEBUG, __VA_ARGS__)
+#define mp_trace(log, ...)      mp_msg_lazy(log, MSGL_TRACE, __VA_ARGS__)
 
 // Convenience macros, typically called with a pointer to a context struct
 // as first argument, which has a "struct mp_log *log;" member.
 
-#define MP_MSG(obj, lev, ...)   mp_msg((obj)->log, lev, __VA_ARGS__)
+#define MP_MSG(obj, lev, ...)   mp_msg_lazy((obj)->log, lev, __VA_ARGS__)
 
 #define MP_FATAL(obj, ...)      MP_MSG(obj, MSGL_FATAL, __VA_ARGS__)
 #define MP_ERR(obj, ...)        MP_MSG(obj, MSGL_ERR, __VA_ARGS__)
@@ -86,7 +99,7 @@ void mp_msg_set_max_level(struct mp_log *log, int lev);
 
 // This is a bit special. See TOOLS/stats-conv.py what rules text passed
 // to these functions should follow. Also see --dump-stats.
-#define mp_stats(obj, ...)      mp_msg(obj, MSGL_STATS, __VA_ARGS__)
+#define mp_stats(obj, ...)      mp_msg_lazy(obj, MSGL_STATS, __VA_ARGS__)
 #define MP_STATS(obj, ...)      MP_MSG(obj, MSGL_STATS, __VA_ARGS__)
 
 #endif /* MPLAYER_MP_MSG_H */
@@ -16,13 +16,19 @@
  */
 
 #include <assert.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdint.h>
+
 #include "config.h"
 #include "playlist.h"
 #include "common/common.h"
 #include "common/global.h"
 #include "common/msg.h"
+#include "misc/thread_tools.h"
 #include "mpv_talloc.h"
 #include "options/path.h"
+#include "osdep/threads.h"
 
 #include "demux/demux.h"
 #include "stream/stream.h"
@@ -51,13 +57,17 @@ void playlist_entry_add_params(struct playlist_entry *e,
         playlist_entry_add_param(e, params[n].name, params[n].value);
 }
 
-static void playlist_update_indexes(struct playlist *pl, int start, int end)
+// Mark the indexes of all entries starting at index start as stale.
+static void playlist_invalidate_indexes(struct playlist *pl, int start)
 {
-    start = MPMAX(start, 0);
-    end = end < 0 ? pl->num_entries : MPMIN(end, pl->num_entries);
+    pl->index_valid = MPMIN(pl->index_valid, MPMAX(start, 0));
+}
 
-    for (int n = start; n < end; n++)
+static void playlist_update_indexes(struct playlist *pl)
+{
+    for (int n = pl->index_valid; n < pl->num_entries; n++)
         pl->entries[n]->pl_index = n;
+    pl->index_valid = pl->num_entries;
 }
 
 void playlist_add(struct playlist *pl, struct playlist_entry *add)
@@ -66,6 +76,8 @@ void playlist_add(struct playlist *pl, struct playlist_entry *add)
     MP_TARRAY_APPEND(pl, pl->entries, pl->num_entries, add);
     add->pl = pl;
     add->pl_index = pl->num_entries - 1;
+    if (pl->index_valid >= add->pl_index)
+        pl->index_valid = pl->num_entries;
     add->id = ++pl->id_alloc;
     talloc_steal(pl, add);
 }
@@ -88,8 +100,9 @@ void playlist_remove(struct playlist *pl, struct playlist_entry *entry)
         pl->current_was_replaced = true;
     }
 
-    MP_TARRAY_REMOVE_AT(pl->entries, pl->num_entries, entry->pl_index);
-    playlist_update_indexes(pl, entry->pl_index, -1);
+    int index = playlist_entry_to_index(pl, entry);
+    MP_TARRAY_REMOVE_AT(pl->entries, pl->num_entries, index);
+    playlist_invalidate_indexes(pl, index);
 
     entry->pl = NULL;
     entry->pl_index = -1;
@@ -125,16 +138,14 @@ void playlist_move(struct playlist *pl, struct playlist_entry *entry,
     assert(entry && entry->pl == pl);
     assert(!at || at->pl == pl);
 
-    int index = at ? at->pl_index : pl->num_entries;
+    int index = at ? playlist_entry_to_index(pl, at) : pl->num_entries;
+    int old_index = playlist_entry_to_index(pl, entry);
     MP_TARRAY_INSERT_AT(pl, pl->entries, pl->num_entries, index, entry);
 
-    int old_index = entry->pl_index;
+    playlist_invalidate_indexes(pl, MPMIN(index, old_index));
     if (old_index >= index)
         old_index += 1;
     MP_TARRAY_REMOVE_AT(pl->entries, pl->num_entries, old_index);
-
-    playlist_update_indexes(pl, MPMIN(index - 1, old_index - 1),
-                                MPMAX(index + 1, old_index + 1));
 }
 
 void playlist_add_file(struct playlist *pl, const char *filename)
@@ -150,7 +161,7 @@ void playlist_shuffle(struct playlist *pl)
         int j = (int)((double)(pl->num_entries - n) * rand() / (RAND_MAX + 1.0));
         MPSWAP(struct playlist_entry *, pl->entries[n], pl->entries[n + j]);
     }
-    playlist_update_indexes(pl, 0, -1);
+    playlist_invalidate_indexes(pl, 0);
 }
 
 #define CMP_INT(a, b) ((a) == (b) ? 0 : ((a) > (b) ? 1 : -1))
@@ -167,9 +178,11 @@ static int cmp_unshuffle(const void *a, const void *b)
 
 void playlist_unshuffle(struct playlist *pl)
 {
+    // cmp_unshuffle() uses the current indexes.
+    playlist_update_indexes(pl);
     if (pl->num_entries)
         qsort(pl->entries, pl->num_entries, sizeof(pl->entries[0]), cmp_unshuffle);
-    playlist_update_indexes(pl, 0, -1);
+    playlist_invalidate_indexes(pl, 0);
 }
 
 // (Explicitly ignores current_was_replaced.)
@@ -203,13 +216,20 @@ struct playlist_entry *playlist_entry_get_rel(struct playlist_entry *e,
     assert(direction == -1 || direction == +1);
     if (!e->pl)
         return NULL;
-    return playlist_entry_from_index(e->pl, e->pl_index + direction);
+    return playlist_entry_from_index(e->pl,
+                    playlist_entry_to_index(e->pl, e) + direction);
 }
 
+static void loader_add_base_path(struct playlist_loader *l, bstr base_path);
+static void loader_add_redirect(struct playlist_loader *l, const char *redirect);
+static void loader_set_stream_flags(struct playlist_loader *l, int flags);
+
 void playlist_add_base_path(struct playlist *pl, bstr base_path)
 {
     if (base_path.len == 0 || bstrcmp0(base_path, ".") == 0)
         return;
+    if (pl->loader)
+        loader_add_base_path(pl->loader, base_path);
     for (int n = 0; n < pl->num_entries; n++) {
         struct playlist_entry *e = pl->entries[n];
         if (!mp_is_url(bstr0(e->filename))) {
@@ -223,6 +243,8 @@ void playlist_add_base_path(struct playlist *pl, bstr base_path)
 // Add redirected_from as new redirect entry to each item in pl.
 void playlist_add_redirect(struct playlist *pl, const char *redirected_from)
 {
+    if (pl->loader)
+        loader_add_redirect(pl->loader, redirected_from);
     for (int n = 0; n < pl->num_entries; n++) {
         struct playlist_entry *e = pl->entries[n];
         if (e->num_redirects >= 10) // arbitrary limit for sanity
@@ -235,12 +257,15 @@ void playlist_add_redirect(struct playlist *pl, const char *redirected_from)
 
 void playlist_set_stream_flags(struct playlist *pl, int flags)
 {
+    if (pl->loader)
+        loader_set_stream_flags(pl->loader, flags);
     for (int n = 0; n < pl->num_entries; n++)
         pl->entries[n]->stream_flags = flags;
 }
 
-static int64_t playlist_transfer_entries_to(struct playlist *pl, int dst_index,
-                                            struct playlist *source_pl)
+// Move all entries from source_pl to pl, inserting them at dst_index.
+int64_t playlist_insert_entries(struct playlist *pl, int dst_index,
+                                struct playlist *source_pl)
 {
     assert(pl != source_pl);
     struct playlist_entry *first = playlist_get_first(source_pl);
@@ -257,8 +282,11 @@ static int64_t playlist_transfer_entries_to(struct playlist *pl, int dst_index,
         talloc_steal(pl, e);
     }
 
-    playlist_update_indexes(pl, dst_index + count, -1);
+    // The new entries have correct indexes, the ones after them are stale.
+    if (pl->index_valid >= dst_index)
+        pl->index_valid = dst_index + count;
     source_pl->num_entries = 0;
+    source_pl->index_valid = 0;
 
     return first ? first->id : 0;
 }
@@ -273,19 +301,19 @@ int64_t playlist_transfer_entries(struct playlist *pl, struct playlist *source_p
 
     int add_at = pl->num_entries;
     if (pl->current) {
-        add_at = pl->current->pl_index + 1;
+        add_at = playlist_entry_to_index(pl, pl->current) + 1;
         if (pl->current_was_replaced)
             add_at += 1;
     }
     assert(add_at >= 0);
     assert(add_at <= pl->num_entries);
 
-    return playlist_transfer_entries_to(pl, add_at, source_pl);
+    return playlist_insert_entries(pl, add_at, source_pl);
 }
 
 int64_t playlist_append_entries(struct playlist *pl, struct playlist *source_pl)
 {
-    return playlist_transfer_entries_to(pl, pl->num_entries, source_pl);
+    return playlist_insert_entries(pl, pl->num_entries, source_pl);
 }
 
 // Return number of entries between list start and e.
@@ -294,7 +322,19 @@ int playlist_entry_to_index(struct playlist *pl, struct playlist_entry *e)
 {
     if (!e || e->pl != pl)
         return -1;
-    return e->pl_index;
+    int index = e->pl_index;
+    if (index < pl->num_entries && pl->entries[index] == e)
+        return index;
+    // The index is stale, so the entry must be after the valid range. Fix the
+    // indexes up to it, which makes repeated lookups cheap.
+    for (index = pl->index_valid; index < pl->num_entries; index++) {
+        pl->entries[index]->pl_index = index;
+        if (pl->entries[index] == e)
+            break;
+    }
+    assert(index < pl->num_entries);
+    pl->index_valid = index + 1;
+    return index;
 }
 
 int playlist_entry_count(struct playlist *pl)
@@ -309,6 +349,205 @@ struct playlist_entry *playlist_entry_from_index(struct playlist *pl, int index)
     return index >= 0 && index < pl->num_entries ? pl->entries[index] : NULL;
 }
 
+// Entry read by the loader, but not added to a playlist yet. The strings are
+// stored in playlist_loader.data, to avoid per-entry allocations.
+struct pending_entry {
+    size_t filename;    // offset into data
+    size_t title;       // offset into data, or SIZE_MAX if none
+};
+
+struct playlist_loader {
+    pthread_t thread;
+    struct mp_cancel *cancel;
+    playlist_loader_fn fn;
+    void *fn_ctx;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    void (*wakeup_cb)(void *ctx);
+    void *wakeup_ctx;
+
+    // --- Protected by lock.
+    bstr data;
+    struct pending_entry *entries;
+    int num_entries;
+    int read_pos;   // entries before this were already fetched
+    bool done;      // thread has exited
+
+    // --- Only accessed by the owner.
+    // Applied to entries when they are added to a playlist, so that they
+    // are the same as entries that were added with playlist_add().
+    char **base_paths;
+    int num_base_paths;
+    char **redirects;
+    int num_redirects;
+    int stream_flags;
+};
+
+static void *loader_thread(void *ptr)
+{
+    struct playlist_loader *l = ptr;
+    mpthread_set_name("playlist");
+
+    l->fn(l, l->fn_ctx);
+
+    pthread_mutex_lock(&l->lock);
+    l->done = true;
+    pthread_cond_broadcast(&l->wakeup);
+    if (l->wakeup_cb)
+        l->wakeup_cb(l->wakeup_ctx);
+    pthread_mutex_unlock(&l->lock);
+    return NULL;
+}
+
+static void destroy_loader(void *ptr)
+{
+    struct playlist_loader *l = ptr;
+    mp_cancel_trigger(l->cancel);
+    pthread_join(l->thread, NULL);
+    pthread_cond_destroy(&l->wakeup);
+    pthread_mutex_destroy(&l->lock);
+}
+
+// Start reading the rest of pl on a thread: fn is called with ctx on it, and
+// is supposed to add entries with playlist_loader_add(). ctx is made a talloc
+// child of the loader. The loader is set as pl->loader, and is freed with pl
+// (it can be stolen by the user). Normally, the entries should be appended to
+// the same playlist (or to where its entries were moved to) as they
+// become available. On failure, ctx is freed and false is returned.
+bool playlist_loader_start(struct playlist *pl, playlist_loader_fn fn,
+                           void *ctx)
+{
+    assert(!pl->loader);
+    struct playlist_loader *l = talloc_zero(pl, struct playlist_loader);
+    l->cancel = mp_cancel_new(l);
+    l->fn = fn;
+    l->fn_ctx = talloc_steal(l, ctx);
+    pthread_mutex_init(&l->lock, NULL);
+    pthread_cond_init(&l->wakeup, NULL);
+    if (pthread_create(&l->thread, NULL, loader_thread, l)) {
+        pthread_cond_destroy(&l->wakeup);
+        pthread_mutex_destroy(&l->lock);
+        talloc_free(l);
+        return false;
+    }
+    talloc_set_destructor(l, destroy_loader);
+    pl->loader = l;
+    return true;
+}
+
+struct mp_cancel *playlist_loader_get_cancel(struct playlist_loader *l)
+{
+    return l->cancel;
+}
+
+// Called by the loader thread only.
+void playlist_loader_add(struct playlist_loader *l, bstr filename, bstr title)
+{
+    pthread_mutex_lock(&l->lock);
+    struct pending_entry e = {.filename = l->data.len, .title = SIZE_MAX};
+    // (bstr_xappend() always adds a \0, which is kept as string terminator.)
+    bstr_xappend(l, &l->data, filename);
+    l->data.len++;
+    if (title.len) {
+        e.title = l->data.len;
+        bstr_xappend(l, &l->data, title);
+        l->data.len++;
+    }
+    MP_TARRAY_APPEND(l, l->entries, l->num_entries, e);
+    pthread_cond_broadcast(&l->wakeup);
+    // Wakeup only once per batch of entries the user didn't fetch yet.
+    if (l->wakeup_cb && l->num_entries == l->read_pos + 1)
+        l->wakeup_cb(l->wakeup_ctx);
+    pthread_mutex_unlock(&l->lock);
+}
+
+// cb is called from the loader thread, when new entries are available, or if
+// the loader is done.
+void playlist_loader_set_wakeup_cb(struct playlist_loader *l,
+                                   void (*cb)(void *ctx), void *ctx)
+{
+    pthread_mutex_lock(&l->lock);
+    l->wakeup_cb = cb;
+    l->wakeup_ctx = ctx;
+    pthread_mutex_unlock(&l->lock);
+}
+
+// Wait until at least 1 entry can be fetched. Returns false if there are no
+// entries anymore.
+bool playlist_loader_wait(struct playlist_loader *l)
+{
+    pthread_mutex_lock(&l->lock);
+    while (l->read_pos == l->num_entries && !l->done)
+        pthread_cond_wait(&l->wakeup, &l->lock);
+    bool res = l->read_pos < l->num_entries;
+    pthread_mutex_unlock(&l->lock);
+    return res;
+}
+
+// Returns true if all entries were fetched, and no new entries will be added.
+bool playlist_loader_is_done(struct playlist_loader *l)
+{
+    pthread_mutex_lock(&l->lock);
+    bool res = l->done && l->read_pos == l->num_entries;
+    pthread_mutex_unlock(&l->lock);
+    return res;
+}
+
+// Add up to max entries read so far to the end of pl. Returns the number of
+// added entries. Does not block.
+int playlist_loader_fetch(struct playlist_loader *l, struct playlist *pl,
+                          int max)
+{
+    pthread_mutex_lock(&l->lock);
+    int count = MPMIN(max, l->num_entries - l->read_pos);
+    for (int n = 0; n < count; n++) {
+        struct pending_entry *pe = &l->entries[l->read_pos++];
+        struct playlist_entry *e =
+            playlist_entry_new((char *)l->data.start + pe->filename);
+        if (pe->title != SIZE_MAX)
+            e->title = talloc_strdup(e, (char *)l->data.start + pe->title);
+        for (int i = 0; i < l->num_base_paths; i++) {
+            if (!mp_is_url(bstr0(e->filename))) {
+                char *new_file = mp_path_join(e, l->base_paths[i], e->filename);
+                talloc_free(e->filename);
+                e->filename = new_file;
+            }
+        }
+        for (int i = 0; i < l->num_redirects; i++) {
+            MP_TARRAY_APPEND(e, e->redirects, e->num_redirects,
+                             talloc_strdup(e, l->redirects[i]));
+        }
+        e->stream_flags = l->stream_flags;
+        playlist_add(pl, e);
+    }
+    // Drop the memory of fetched entries once they're all fetched.
+    if (l->read_pos == l->num_entries) {
+        l->read_pos = l->num_entries = 0;
+        l->data.len = 0;
+    }
+    pthread_mutex_unlock(&l->lock);
+    return count;
+}
+
+static void loader_add_base_path(struct playlist_loader *l, bstr base_path)
+{
+    MP_TARRAY_APPEND(l, l->base_paths, l->num_base_paths,
+                     bstrto0(l, base_path));
+}
+
+static void loader_add_redirect(struct playlist_loader *l, const char *redirect)
+{
+    if (l->num_redirects < 10)
+        MP_TARRAY_APPEND(l, l->redirects, l->num_redirects,
+                         talloc_strdup(l, redirect));
+}
+
+static void loader_set_stream_flags(struct playlist_loader *l, int flags)
+{
+    l->stream_flags = flags;
+}
+
 struct playlist *playlist_parse_file(const char *file, struct mp_cancel *cancel,
                                      struct mpv_global *global)
 {
@@ -329,6 +568,9 @@ struct playlist *playlist_parse_file(const char *file, struct mp_cancel *cancel,
     if (d && d->playlist) {
         ret = talloc_zero(NULL, struct playlist);
         playlist_transfer_entries(ret, d->playlist);
+        struct playlist_loader *loader = d->playlist->loader;
+        while (loader && playlist_loader_wait(loader))
+            playlist_loader_fetch(loader, ret, INT_MAX);
         if (d->filetype && strcmp(d->filetype, "hls") == 0) {
             mp_warn(log, "This might be a HLS stream. For correct operation, "
                          "pass it to the player\ndirectly. Don't use --playlist.\n");
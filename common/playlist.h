@@ -26,7 +26,9 @@ struct playlist_param {
 };
 
 struct playlist_entry {
-    // Invariant: (pl && pl->entries[pl_index] == this) || (!pl && pl_index < 0)
+    // Position hint; may be stale while pl->index_valid is below it. Use
+    // playlist_entry_to_index() instead of reading it directly.
+    // Invariant: (pl && pl_index >= 0) || (!pl && pl_index < 0)
     struct playlist *pl;
     int pl_index;
 
@@ -67,6 +69,10 @@ struct playlist_entry {
 struct playlist {
     struct playlist_entry **entries;
     int num_entries;
+    // entries[n]->pl_index == n for all n < index_valid. Modifications only
+    // lower this, and the indexes are recomputed lazily on lookup, so that
+    // removing or moving entries near the start doesn't touch every entry.
+    int index_valid;
 
     // This provides some sort of stable iterator. If this entry is removed from
     // the playlist, current is set to the next element (or NULL), and
@@ -75,6 +81,10 @@ struct playlist {
     bool current_was_replaced;
 
     uint64_t id_alloc;
+
+    // If set, the remaining entries are still being read by a background
+    // thread, and are going to be appended with playlist_loader_fetch().
+    struct playlist_loader *loader;
 };
 
 void playlist_entry_add_param(struct playlist_entry *e, bstr name, bstr value);
@@ -105,6 +115,8 @@ void playlist_add_redirect(struct playlist *pl, const char *redirected_from);
 void playlist_set_stream_flags(struct playlist *pl, int flags);
 int64_t playlist_transfer_entries(struct playlist *pl, struct playlist *source_pl);
 int64_t playlist_append_entries(struct playlist *pl, struct playlist *source_pl);
+int64_t playlist_insert_entries(struct playlist *pl, int dst_index,
+                                struct playlist *source_pl);
 
 int playlist_entry_to_index(struct playlist *pl, struct playlist_entry *e);
 int playlist_entry_count(struct playlist *pl);
@@ -117,4 +129,22 @@ struct playlist *playlist_parse_file(const char *file, struct mp_cancel *cancel,
 
 void playlist_entry_unref(struct playlist_entry *e);
 
+// Runs on the loader thread. Call playlist_loader_add() for each entry, and
+// return when done, or when playlist_loader_get_cancel() was triggered. ctx
+// is the parameter passed to playlist_loader_start(), and is freed together
+// with the loader.
+typedef void (*playlist_loader_fn)(struct playlist_loader *l, void *ctx);
+
+bool playlist_loader_start(struct playlist *pl, playlist_loader_fn fn,
+                           void *ctx);
+struct mp_cancel *playlist_loader_get_cancel(struct playlist_loader *l);
+void playlist_loader_add(struct playlist_loader *l, bstr filename, bstr title);
+
+void playlist_loader_set_wakeup_cb(struct playlist_loader *l,
+                                   void (*cb)(void *ctx), void *ctx);
+bool playlist_loader_wait(struct playlist_loader *l);
+int playlist_loader_fetch(struct playlist_loader *l, struct playlist *pl,
+                          int max);
+bool playlist_loader_is_done(struct playlist_loader *l);
+
 #endif
@@ -16,6 +16,7 @@
  */
 
 #include <math.h>
+#include <pthread.h>
 
 #include <libavformat/avformat.h>
 
@@ -26,6 +27,7 @@
 #include "demux/demux.h"
 #include "demux/packet.h"
 #include "demux/stheader.h"
+#include "osdep/threads.h"
 
 #include "recorder.h"
 
@@ -37,6 +39,14 @@
 // codec delay and frame reordering, and potentially lack of DTS).
 // Keyframe flags can trigger this earlier.
 #define QUEUE_MIN_PACKETS 16
+// Maximum amount of packet data queued for the muxer thread. If writing the
+// output is slower than this on average, feeding packets blocks.
+#define MUX_QUEUE_MAX_BYTES (64 * 1024 * 1024)
+
+struct mux_item {
+    struct mp_recorder_sink *rst;
+    struct demux_packet *pkt;   // owned; timestamps already rebased
+};
 
 struct mp_recorder {
     struct mpv_global *global;
@@ -57,7 +67,18 @@ struct mp_recorder {
     // of the first packet of the current segment written to the output.
     double rebase_ts;
 
+    // Owned by the muxer thread while it's running.
     AVFormatContext *mux;
+
+    // Muxer thread. All fields below are protected by mux_lock.
+    pthread_t mux_thread;
+    bool mux_thread_valid;
+    pthread_mutex_t mux_lock;
+    pthread_cond_t mux_wakeup;
+    struct mux_item *mux_queue;
+    int num_mux_queue;
+    size_t mux_queue_bytes;
+    bool mux_terminate;
 };
 
 struct mp_recorder_sink {
@@ -117,6 +138,8 @@ static int add_stream(struct mp_recorder *priv, struct sh_stream *sh)
     return 0;
 }
 
+static void *mux_thread(void *p);
+
 struct mp_recorder *mp_recorder_create(struct mpv_global *global,
                                        const char *target_file,
                                        struct sh_stream **streams,
@@ -128,6 +151,8 @@ struct mp_recorder *mp_recorder_create(struct mpv_global *global,
 
     priv->global = global;
     priv->log = mp_log_new(priv, global->log, "recorder");
+    pthread_mutex_init(&priv->mux_lock, NULL);
+    pthread_cond_init(&priv->mux_wakeup, NULL);
 
     if (!num_streams) {
         MP_ERR(priv, "No streams.\n");
@@ -201,6 +226,12 @@ struct mp_recorder *mp_recorder_create(struct mpv_global *global,
     priv->opened = true;
     priv->muxing_from_start = true;
 
+    if (pthread_create(&priv->mux_thread, NULL, mux_thread, priv)) {
+        MP_ERR(priv, "Failed to start muxer thread.\n");
+        goto error;
+    }
+    priv->mux_thread_valid = true;
+
     priv->base_ts = MP_NOPTS_VALUE;
     priv->rebase_ts = 0;
 
@@ -225,20 +256,13 @@ static void flush_packets(struct mp_recorder *priv)
     }
 }
 
-static void mux_packet(struct mp_recorder_sink *rst,
-                       struct demux_packet *pkt)
+// Called on the muxer thread only.
+static void write_packet(struct mp_recorder *priv, struct mux_item *item)
 {
-    struct mp_recorder *priv = rst->owner;
-    struct demux_packet mpkt = *pkt;
-
-    double diff = priv->rebase_ts - priv->base_ts;
-    mpkt.pts = MP_ADD_PTS(mpkt.pts, diff);
-    mpkt.dts = MP_ADD_PTS(mpkt.dts, diff);
-
-    rst->max_out_pts = MP_PTS_MAX(rst->max_out_pts, pkt->pts);
+    struct mp_recorder_sink *rst = item->rst;
 
     AVPacket avpkt;
-    mp_set_av_packet(&avpkt, &mpkt, &rst->av_stream->time_base);
+    mp_set_av_packet(&avpkt, item->pkt, &rst->av_stream->time_base);
 
     avpkt.stream_index = rst->av_stream->index;
 
@@ -253,6 +277,70 @@ static void mux_packet(struct mp_recorder_sink *rst,
 
     if (av_interleaved_write_frame(priv->mux, new_packet) < 0)
         MP_ERR(priv, "Failed writing packet.\n");
+    av_packet_free(&new_packet);
+}
+
+static void *mux_thread(void *p)
+{
+    struct mp_recorder *priv = p;
+
+    mpthread_set_name("recorder");
+
+    struct mux_item *items = NULL;
+    int num_items = 0;
+
+    pthread_mutex_lock(&priv->mux_lock);
+    while (1) {
+        if (!priv->num_mux_queue) {
+            if (priv->mux_terminate)
+                break;
+            pthread_cond_wait(&priv->mux_wakeup, &priv->mux_lock);
+            continue;
+        }
+
+        // Take the whole queue, and give it an empty array in exchange.
+        MPSWAP(struct mux_item *, items, priv->mux_queue);
+        num_items = priv->num_mux_queue;
+        priv->num_mux_queue = 0;
+        pthread_mutex_unlock(&priv->mux_lock);
+
+        size_t bytes = 0;
+        for (int n = 0; n < num_items; n++) {
+            write_packet(priv, &items[n]);
+            bytes += items[n].pkt->len;
+            talloc_free(items[n].pkt);
+        }
+
+        pthread_mutex_lock(&priv->mux_lock);
+        priv->mux_queue_bytes -= bytes;
+        pthread_cond_broadcast(&priv->mux_wakeup);
+    }
+    pthread_mutex_unlock(&priv->mux_lock);
+
+    talloc_free(items);
+    return NULL;
+}
+
+// Pass the packet to the muxer thread, which takes over ownership.
+static void mux_packet(struct mp_recorder_sink *rst,
+                       struct demux_packet *pkt)
+{
+    struct mp_recorder *priv = rst->owner;
+
+    rst->max_out_pts = MP_PTS_MAX(rst->max_out_pts, pkt->pts);
+
+    double diff = priv->rebase_ts - priv->base_ts;
+    pkt->pts = MP_ADD_PTS(pkt->pts, diff);
+    pkt->dts = MP_ADD_PTS(pkt->dts, diff);
+
+    pthread_mutex_lock(&priv->mux_lock);
+    while (priv->mux_queue_bytes >= MUX_QUEUE_MAX_BYTES)
+        pthread_cond_wait(&priv->mux_wakeup, &priv->mux_lock);
+    struct mux_item item = {rst, pkt};
+    MP_TARRAY_APPEND(priv, priv->mux_queue, priv->num_mux_queue, item);
+    priv->mux_queue_bytes += pkt->len;
+    pthread_cond_broadcast(&priv->mux_wakeup);
+    pthread_mutex_unlock(&priv->mux_lock);
 }
 
 // Write all packets available in the stream queue
@@ -262,10 +350,8 @@ static void mux_packets(struct mp_recorder_sink *rst)
     if (!priv->muxing || !rst->num_packets)
         return;
 
-    for (int n = 0; n < rst->num_packets; n++) {
+    for (int n = 0; n < rst->num_packets; n++)
         mux_packet(rst, rst->packets[n]);
-        talloc_free(rst->packets[n]);
-    }
 
     rst->num_packets = 0;
 }
@@ -315,12 +401,21 @@ static void check_restart(struct mp_recorder *priv)
 
 void mp_recorder_destroy(struct mp_recorder *priv)
 {
-    if (priv->opened) {
+    if (priv->mux_thread_valid) {
         for (int n = 0; n < priv->num_streams; n++) {
             struct mp_recorder_sink *rst = priv->streams[n];
             mux_packets(rst);
         }
 
+        // Let the thread write the remaining queued packets.
+        pthread_mutex_lock(&priv->mux_lock);
+        priv->mux_terminate = true;
+        pthread_cond_broadcast(&priv->mux_wakeup);
+        pthread_mutex_unlock(&priv->mux_lock);
+        pthread_join(priv->mux_thread, NULL);
+    }
+
+    if (priv->opened) {
         if (av_write_trailer(priv->mux) < 0)
             MP_ERR(priv, "Writing trailer failed.\n");
     }
@@ -333,6 +428,8 @@ void mp_recorder_destroy(struct mp_recorder *priv)
     }
 
     flush_packets(priv);
+    pthread_cond_destroy(&priv->mux_wakeup);
+    pthread_mutex_destroy(&priv->mux_lock);
     talloc_free(priv);
 }
 
@@ -27,6 +27,67 @@ struct stats_base {
     int num_entries;
 
     int64_t last_time;
+
+    // For the allocation rate in the ta allocation profile.
+    uint64_t alloc_last_count;
+    int64_t alloc_last_time;
+
+    // Startup timeline. Protected by lock, except startup_done.
+    atomic_bool startup_done;
+    int64_t startup_origin;
+    struct startup_event *startup_events;
+    int num_startup_events;
+    pthread_t *startup_threads;
+    int num_startup_threads;
+
+    // Trace recording (stats_trace_enable()). trace_bufs is protected by lock.
+    atomic_bool tracing;
+    pthread_key_t trace_key;
+    struct trace_buf **trace_bufs;
+    int num_trace_bufs;
+    int trace_next_tid;
+};
+
+struct startup_event {
+    char *name;
+    int thread;             // index into stats_base.startup_threads
+    int64_t start, end;     // mp_time_us(); end is -1 while a span is open
+    bool instant;
+};
+
+// Recording stops at this number of events (e.g. if no file is ever played).
+#define MAX_STARTUP_EVENTS 1000
+
+enum trace_type {
+    TRACE_BEGIN,
+    TRACE_END,
+    TRACE_INSTANT,
+};
+
+struct trace_event {
+    int64_t ts;             // mp_time_us()
+    char name[47];          // including stats_ctx.prefix, possibly truncated
+    char type;              // enum trace_type
+};
+
+// Number of events kept per thread (power of 2); older events are overwritten.
+#define TRACE_EVENTS 4096
+
+// Threads beyond this number are not traced.
+#define MAX_TRACE_THREADS 64
+
+// Ring buffer of trace events, written by a single thread without locking.
+struct trace_buf {
+    struct stats_base *stats;
+    // The owning thread exited, and the buffer can be reused by a new thread.
+    // Only accessed with stats_base.lock held.
+    bool exited;
+    int tid;
+    // Events with lower indexes than first are from a previous owner.
+    uint64_t first;
+    // Index of the next event to write. Release-stored after writing it.
+    mp_atomic_uint64 head;
+    struct trace_event events[TRACE_EVENTS];
 };
 
 struct stats_ctx {
@@ -58,7 +119,7 @@ struct stat_entry {
     double val_d;
     int64_t val_rt;
     int64_t val_th;
-    int64_t time_start_us;
+    int64_t time_start_ns;
     int64_t cpu_start_ns;
     pthread_t thread;
 };
@@ -89,18 +150,23 @@ static void stats_destroy(void *p)
     // All entries must have been destroyed before this.
     assert(!stats->list.head);
 
+    pthread_key_delete(stats->trace_key);
     pthread_mutex_destroy(&stats->lock);
 }
 
+static void trace_thread_exit(void *p);
+
 void stats_global_init(struct mpv_global *global)
 {
     assert(!global->stats);
     struct stats_base *stats = talloc_zero(global, struct stats_base);
     ta_set_destructor(stats, stats_destroy);
     pthread_mutex_init(&stats->lock, NULL);
+    pthread_key_create(&stats->trace_key, trace_thread_exit);
 
     global->stats = stats;
     stats->global = global;
+    stats->startup_origin = mp_time_us();
 }
 
 static void add_stat(struct mpv_node *list, struct stat_entry *e,
@@ -122,6 +188,99 @@ static int cmp_entry(const void *p1, const void *p2)
     return strcmp((*e1)->full_name, (*e2)->full_name);
 }
 
+// Number of per-file and per-site entries of the allocation profile.
+#define ALLOC_PROFILE_TOP 10
+
+static int cmp_alloc_stat(const void *p1, const void *p2)
+{
+    const struct ta_alloc_stat *s1 = p1, *s2 = p2;
+    return s1->live_bytes < s2->live_bytes ? 1 :
+           s1->live_bytes > s2->live_bytes ? -1 : 0;
+}
+
+static void add_alloc_stat(struct mpv_node *list, const char *name,
+                           struct ta_alloc_stat *st)
+{
+    struct mpv_node *ne = node_array_add(list, MPV_FORMAT_NODE_MAP);
+    node_map_add_string(ne, "name", name);
+    node_map_add_double(ne, "value", st->live_bytes);
+    char *size = format_file_size(st->live_bytes);
+    node_map_add_string(ne, "text", mp_tprintf(80, "%s in %zu blocks", size,
+                                               st->live_blocks));
+    talloc_free(size);
+}
+
+// Live memory by allocation site, and by source file (as rough approximation
+// of the owning subsystem), if --alloc-profile is enabled.
+static void add_alloc_profile(struct stats_base *stats, struct mpv_node *out)
+{
+    struct ta_alloc_stat *sites;
+    size_t num_sites = ta_get_alloc_profile(&sites);
+    if (!num_sites)
+        return;
+
+    void *tmp = talloc_new(NULL);
+    struct ta_alloc_stat total = {0};
+    struct ta_alloc_stat *files = NULL;
+    int num_files = 0;
+
+    for (size_t n = 0; n < num_sites; n++) {
+        struct ta_alloc_stat *st = &sites[n];
+        total.live_bytes += st->live_bytes;
+        total.live_blocks += st->live_blocks;
+        total.allocs += st->allocs;
+
+        // "dir/file.c:123" => "dir/file.c"
+        bstr file = bstr0(st->loc);
+        int colon = bstrrchr(file, ':');
+        if (colon >= 0)
+            file.len = colon;
+        struct ta_alloc_stat *fst = NULL;
+        for (int i = 0; i < num_files; i++) {
+            if (bstr_equals0(file, files[i].loc)) {
+                fst = &files[i];
+                break;
+            }
+        }
+        if (!fst) {
+            struct ta_alloc_stat new = {.loc = bstrto0(tmp, file)};
+            MP_TARRAY_APPEND(tmp, files, num_files, new);
+            fst = &files[num_files - 1];
+        }
+        fst->live_bytes += st->live_bytes;
+        fst->live_blocks += st->live_blocks;
+    }
+
+    add_alloc_stat(out, "memory/total", &total);
+
+    int64_t now = mp_time_us();
+    if (stats->alloc_last_time && now > stats->alloc_last_time) {
+        double rate = (total.allocs - stats->alloc_last_count) /
+                      ((now - stats->alloc_last_time) / 1e6);
+        struct mpv_node *ne = node_array_add(out, MPV_FORMAT_NODE_MAP);
+        node_map_add_string(ne, "name", "memory/alloc-rate");
+        node_map_add_double(ne, "value", rate);
+        node_map_add_string(ne, "text", mp_tprintf(80, "%.0f/s", rate));
+    }
+    stats->alloc_last_time = now;
+    stats->alloc_last_count = total.allocs;
+
+    qsort(files, num_files, sizeof(files[0]), cmp_alloc_stat);
+    for (int n = 0; n < MPMIN(num_files, ALLOC_PROFILE_TOP); n++) {
+        add_alloc_stat(out, talloc_asprintf(tmp, "memory/file/%s",
+                                            files[n].loc), &files[n]);
+    }
+
+    qsort(sites, num_sites, sizeof(sites[0]), cmp_alloc_stat);
+    for (int n = 0; n < MPMIN(num_sites, ALLOC_PROFILE_TOP); n++) {
+        add_alloc_stat(out, talloc_asprintf(tmp, "memory/site/%s",
+                                            sites[n].loc), &sites[n]);
+    }
+
+    talloc_free(tmp);
+    free(sites);
+}
+
 void stats_global_query(struct mpv_global *global, struct mpv_node *out)
 {
     struct stats_base *stats = global->stats;
@@ -190,7 +349,7 @@ void stats_global_query(struct mpv_global *global, struct mpv_node *out)
         case VAL_TIME: {
             double t_cpu = e->val_th / 1e6;
             add_stat(out, e, "cpu", t_cpu, mp_tprintf(80, "%.2f ms", t_cpu));
-            double t_rt = e->val_rt / 1e3;
+            double t_rt = e->val_rt / 1e6;
             add_stat(out, e, "time", t_rt, mp_tprintf(80, "%.2f ms", t_rt));
             e->val_rt = e->val_th = 0;
             break;
@@ -208,6 +367,31 @@ void stats_global_query(struct mpv_global *global, struct mpv_node *out)
         }
     }
 
+    add_alloc_profile(stats, out);
+
+    pthread_mutex_unlock(&stats->lock);
+}
+
+void stats_global_read_values(struct mpv_global *global,
+                              void (*cb)(void *cb_ctx, const char *name,
+                                         double val),
+                              void *cb_ctx)
+{
+    struct stats_base *stats = global->stats;
+    assert(stats);
+
+    pthread_mutex_lock(&stats->lock);
+
+    atomic_store(&stats->active, true);
+
+    for (struct stats_ctx *ctx = stats->list.head; ctx; ctx = ctx->list.next) {
+        for (int n = 0; n < ctx->num_entries; n++) {
+            struct stat_entry *e = ctx->entries[n];
+            if (e->type == VAL_STATIC || e->type == VAL_STATIC_SIZE)
+                cb(cb_ctx, e->full_name, e->val_d);
+        }
+    }
+
     pthread_mutex_unlock(&stats->lock);
 }
 
@@ -281,36 +465,42 @@ void stats_size_value(struct stats_ctx *ctx, const char *name, double val)
     static_value(ctx, name, val, VAL_STATIC_SIZE);
 }
 
+static void trace_add(struct stats_ctx *ctx, const char *name,
+                      enum trace_type type);
+
 void stats_time_start(struct stats_ctx *ctx, const char *name)
 {
     MP_STATS(ctx->base->global, "start %s", name);
+    trace_add(ctx, name, TRACE_BEGIN);
     if (!IS_ACTIVE(ctx))
         return;
     pthread_mutex_lock(&ctx->base->lock);
     struct stat_entry *e = find_entry(ctx, name);
     e->cpu_start_ns = get_thread_cpu_time_ns(pthread_self());
-    e->time_start_us = mp_time_us();
+    e->time_start_ns = mp_time_ns();
     pthread_mutex_unlock(&ctx->base->lock);
 }
 
 void stats_time_end(struct stats_ctx *ctx, const char *name)
 {
     MP_STATS(ctx->base->global, "end %s", name);
+    trace_add(ctx, name, TRACE_END);
     if (!IS_ACTIVE(ctx))
         return;
     pthread_mutex_lock(&ctx->base->lock);
     struct stat_entry *e = find_entry(ctx, name);
-    if (e->time_start_us) {
+    if (e->time_start_ns) {
         e->type = VAL_TIME;
-        e->val_rt += mp_time_us() - e->time_start_us;
+        e->val_rt += mp_time_ns() - e->time_start_ns;
         e->val_th += get_thread_cpu_time_ns(pthread_self()) - e->cpu_start_ns;
-        e->time_start_us = 0;
+        e->time_start_ns = 0;
     }
     pthread_mutex_unlock(&ctx->base->lock);
 }
 
 void stats_event(struct stats_ctx *ctx, const char *name)
 {
+    trace_add(ctx, name, TRACE_INSTANT);
     if (!IS_ACTIVE(ctx))
         return;
     pthread_mutex_lock(&ctx->base->lock);
@@ -339,3 +529,225 @@ void stats_unregister_thread(struct stats_ctx *ctx, const char *name)
 {
     register_thread(ctx, name, 0);
 }
+
+static int startup_thread_index(struct stats_base *stats)
+{
+    pthread_t self = pthread_self();
+    for (int n = 0; n < stats->num_startup_threads; n++) {
+        if (pthread_equal(stats->startup_threads[n], self))
+            return n;
+    }
+    MP_TARRAY_APPEND(stats, stats->startup_threads, stats->num_startup_threads,
+                     self);
+    return stats->num_startup_threads - 1;
+}
+
+static void startup_add(struct mpv_global *global, const char *name,
+                        bool instant)
+{
+    struct stats_base *stats = global->stats;
+    if (atomic_load_explicit(&stats->startup_done, memory_order_relaxed))
+        return;
+    int64_t now = mp_time_us();
+    pthread_mutex_lock(&stats->lock);
+    if (stats->num_startup_events < MAX_STARTUP_EVENTS) {
+        struct startup_event ev = {
+            .name = talloc_strdup(stats, name),
+            .thread = startup_thread_index(stats),
+            .start = now,
+            .end = instant ? now : -1,
+            .instant = instant,
+        };
+        MP_TARRAY_APPEND(stats, stats->startup_events,
+                         stats->num_startup_events, ev);
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
+
+void stats_startup_begin(struct mpv_global *global, const char *name)
+{
+    startup_add(global, name, false);
+}
+
+void stats_startup_end(struct mpv_global *global, const char *name)
+{
+    struct stats_base *stats = global->stats;
+    if (atomic_load_explicit(&stats->startup_done, memory_order_relaxed))
+        return;
+    int64_t now = mp_time_us();
+    pthread_mutex_lock(&stats->lock);
+    // Prefer a span started on the same thread (the same phase can run on
+    // several threads at once).
+    int thread = startup_thread_index(stats);
+    struct startup_event *found = NULL;
+    for (int n = stats->num_startup_events - 1; n >= 0; n--) {
+        struct startup_event *ev = &stats->startup_events[n];
+        if (ev->end < 0 && strcmp(ev->name, name) == 0) {
+            if (!found || ev->thread == thread)
+                found = ev;
+            if (ev->thread == thread)
+                break;
+        }
+    }
+    if (found)
+        found->end = now;
+    pthread_mutex_unlock(&stats->lock);
+}
+
+void stats_startup_mark(struct mpv_global *global, const char *name)
+{
+    startup_add(global, name, true);
+}
+
+bool stats_startup_finish(struct mpv_global *global)
+{
+    struct stats_base *stats = global->stats;
+    return !atomic_exchange(&stats->startup_done, true);
+}
+
+void stats_startup_query(struct mpv_global *global, struct mpv_node *out)
+{
+    struct stats_base *stats = global->stats;
+
+    node_init(out, MPV_FORMAT_NODE_ARRAY, NULL);
+
+    pthread_mutex_lock(&stats->lock);
+    for (int n = 0; n < stats->num_startup_events; n++) {
+        struct startup_event *ev = &stats->startup_events[n];
+        struct mpv_node *ne = node_array_add(out, MPV_FORMAT_NODE_MAP);
+        node_map_add_string(ne, "name", ev->name);
+        node_map_add_int64(ne, "thread", ev->thread);
+        node_map_add_double(ne, "start", (ev->start - stats->startup_origin) / 1e6);
+        if (!ev->instant && ev->end >= 0)
+            node_map_add_double(ne, "duration", (ev->end - ev->start) / 1e6);
+    }
+    pthread_mutex_unlock(&stats->lock);
+}
+
+// Called by the key destructor when a traced thread exits. (Not called for
+// threads still running when the stats_base is destroyed.)
+static void trace_thread_exit(void *p)
+{
+    struct trace_buf *buf = p;
+    struct stats_base *stats = buf->stats;
+    pthread_mutex_lock(&stats->lock);
+    buf->exited = true;
+    pthread_mutex_unlock(&stats->lock);
+}
+
+static struct trace_buf *get_trace_buf(struct stats_base *stats)
+{
+    struct trace_buf *buf = pthread_getspecific(stats->trace_key);
+    if (buf)
+        return buf;
+
+    pthread_mutex_lock(&stats->lock);
+    for (int n = 0; n < stats->num_trace_bufs; n++) {
+        if (stats->trace_bufs[n]->exited) {
+            buf = stats->trace_bufs[n];
+            break;
+        }
+    }
+    if (buf) {
+        buf->exited = false;
+        buf->first = atomic_load(&buf->head);
+        buf->tid = stats->trace_next_tid++;
+    } else if (stats->num_trace_bufs < MAX_TRACE_THREADS) {
+        buf = talloc_zero(stats, struct trace_buf);
+        buf->stats = stats;
+        buf->tid = stats->trace_next_tid++;
+        MP_TARRAY_APPEND(stats, stats->trace_bufs, stats->num_trace_bufs, buf);
+    }
+    pthread_mutex_unlock(&stats->lock);
+
+    if (buf)
+        pthread_setspecific(stats->trace_key, buf);
+    return buf;
+}
+
+static void trace_add(struct stats_ctx *ctx, const char *name,
+                      enum trace_type type)
+{
+    struct stats_base *stats = ctx->base;
+    if (!atomic_load_explicit(&stats->tracing, memory_order_relaxed))
+        return;
+    struct trace_buf *buf = get_trace_buf(stats);
+    if (!buf)
+        return;
+    uint64_t head = atomic_load_explicit(&buf->head, memory_order_relaxed);
+    struct trace_event *ev = &buf->events[head & (TRACE_EVENTS - 1)];
+    ev->ts = mp_time_us();
+    snprintf(ev->name, sizeof(ev->name), "%s/%s", ctx->prefix, name);
+    ev->type = type;
+    atomic_store_explicit(&buf->head, head + 1, memory_order_release);
+}
+
+void stats_trace_enable(struct mpv_global *global, bool enable)
+{
+    struct stats_base *stats = global->stats;
+    atomic_store(&stats->tracing, enable);
+}
+
+static void add_trace_meta(struct mpv_node *list, int tid, const char *name)
+{
+    struct mpv_node *meta = node_array_add(list, MPV_FORMAT_NODE_MAP);
+    node_map_add_string(meta, "name", "thread_name");
+    node_map_add_string(meta, "ph", "M");
+    node_map_add_int64(meta, "pid", 0);
+    node_map_add_int64(meta, "tid", tid);
+    struct mpv_node *args = node_map_add(meta, "args", MPV_FORMAT_NODE_MAP);
+    node_map_add_string(args, "name", name);
+}
+
+void stats_trace_query(struct mpv_global *global, struct mpv_node *out)
+{
+    struct stats_base *stats = global->stats;
+
+    node_init(out, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_string(out, "displayTimeUnit", "ms");
+    struct mpv_node *list = node_map_add(out, "traceEvents", MPV_FORMAT_NODE_ARRAY);
+
+    struct trace_event *copy = talloc_array(NULL, struct trace_event, TRACE_EVENTS);
+
+    pthread_mutex_lock(&stats->lock);
+    for (int n = 0; n < stats->num_trace_bufs; n++) {
+        struct trace_buf *buf = stats->trace_bufs[n];
+
+        // Copy the events while the owner may write new ones, then drop all
+        // events which could have been overwritten during copying.
+        uint64_t head = atomic_load(&buf->head);
+        uint64_t start = head > TRACE_EVENTS ? head - TRACE_EVENTS : 0;
+        start = MPMAX(start, buf->first);
+        for (uint64_t i = start; i < head; i++)
+            copy[i - start] = buf->events[i & (TRACE_EVENTS - 1)];
+        uint64_t new_head = atomic_load(&buf->head);
+        uint64_t valid = new_head >= TRACE_EVENTS ? new_head - TRACE_EVENTS + 1 : 0;
+        valid = MPMAX(valid, start);
+
+        if (valid < head)
+            add_trace_meta(list, buf->tid, mp_tprintf(20, "thread %d", buf->tid));
+
+        for (uint64_t i = valid; i < head; i++) {
+            struct trace_event *ev = &copy[i - start];
+            struct mpv_node *te = node_array_add(list, MPV_FORMAT_NODE_MAP);
+            node_map_add_string(te, "name", ev->name);
+            node_map_add_int64(te, "pid", 0);
+            node_map_add_int64(te, "tid", buf->tid);
+            node_map_add_int64(te, "ts", ev->ts - stats->startup_origin);
+            switch (ev->type) {
+            case TRACE_BEGIN:
+                node_map_add_string(te, "ph", "B");
+                break;
+            case TRACE_END:
+                node_map_add_string(te, "ph", "E");
+                break;
+            default:
+                node_map_add_string(te, "ph", "i");
+                node_map_add_string(te, "s", "t");
+            }
+        }
+    }
+    pthread_mutex_unlock(&stats->lock);
+
+    talloc_free(copy);
+}
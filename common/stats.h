@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+
 struct mpv_global;
 struct mpv_node;
 struct stats_ctx;
@@ -7,6 +9,14 @@ struct stats_ctx;
 void stats_global_init(struct mpv_global *global);
 void stats_global_query(struct mpv_global *global, struct mpv_node *out);
 
+// Call cb for each static value (stats_value(), stats_size_value()). Unlike
+// stats_global_query(), this doesn't reset any counters. Both enable the
+// collection of stats.
+void stats_global_read_values(struct mpv_global *global,
+                              void (*cb)(void *cb_ctx, const char *name,
+                                         double val),
+                              void *cb_ctx);
+
 // stats_ctx can be free'd with ta_free(), or by using the ta_parent.
 struct stats_ctx *stats_ctx_create(void *ta_parent, struct mpv_global *global,
                                    const char *prefix);
@@ -32,3 +42,30 @@ void stats_register_thread_cputime(struct stats_ctx *ctx, const char *name);
 
 // Remove reference to pthread_self().
 void stats_unregister_thread(struct stats_ctx *ctx, const char *name);
+
+// Startup timeline (for profiling the time to the first frame). Spans and
+// instant events can be recorded from any thread, until recording is stopped
+// with stats_startup_finish(). A span is closed by the most recent _begin
+// call with the same name (preferring the calling thread).
+void stats_startup_begin(struct mpv_global *global, const char *name);
+void stats_startup_end(struct mpv_global *global, const char *name);
+void stats_startup_mark(struct mpv_global *global, const char *name);
+
+// Stop recording. Returns true on the first call only.
+bool stats_startup_finish(struct mpv_global *global);
+
+// Return a MPV_FORMAT_NODE_ARRAY of MPV_FORMAT_NODE_MAP entries with "name",
+// "thread" (index, 0 is normally the main thread), "start" (seconds since
+// mpv_global creation) and "duration" (missing for instant events and spans
+// which were not ended).
+void stats_startup_query(struct mpv_global *global, struct mpv_node *out);
+
+// Record stats_time_start()/stats_time_end() spans and stats_event() instants
+// in a per-thread ring buffer (the most recent events are kept). Disabled by
+// default; disabling keeps the recorded events.
+void stats_trace_enable(struct mpv_global *global, bool enable);
+
+// Return the recorded events in the Chrome trace event format (a
+// MPV_FORMAT_NODE_MAP suitable for json_write()). Timestamps are relative to
+// mpv_global creation, like stats_startup_query().
+void stats_trace_query(struct mpv_global *global, struct mpv_node *out);
@@ -23,18 +23,20 @@
 #include "tags.h"
 #include "misc/bstr.h"
 
-void mp_tags_set_str(struct mp_tags *tags, const char *key, const char *value)
+bool mp_tags_set_str(struct mp_tags *tags, const char *key, const char *value)
 {
-    mp_tags_set_bstr(tags, bstr0(key), bstr0(value));
+    return mp_tags_set_bstr(tags, bstr0(key), bstr0(value));
 }
 
-void mp_tags_set_bstr(struct mp_tags *tags, bstr key, bstr value)
+bool mp_tags_set_bstr(struct mp_tags *tags, bstr key, bstr value)
 {
     for (int n = 0; n < tags->num_keys; n++) {
         if (bstrcasecmp0(key, tags->keys[n]) == 0) {
+            if (bstr_equals0(value, tags->values[n]))
+                return false;
             talloc_free(tags->values[n]);
             tags->values[n] = bstrto0(tags, value);
-            return;
+            return true;
         }
     }
 
@@ -43,6 +45,7 @@ void mp_tags_set_bstr(struct mp_tags *tags, bstr key, bstr value)
     tags->keys[tags->num_keys]   = bstrto0(tags, key);
     tags->values[tags->num_keys] = bstrto0(tags, value);
     tags->num_keys++;
+    return true;
 }
 
 void mp_tags_remove_str(struct mp_tags *tags, const char *key)
@@ -129,10 +132,12 @@ struct mp_tags *mp_tags_filtered(void *tparent, struct mp_tags *tags, char **lis
     return new;
 }
 
-void mp_tags_merge(struct mp_tags *tags, struct mp_tags *src)
+bool mp_tags_merge(struct mp_tags *tags, struct mp_tags *src)
 {
+    bool changed = false;
     for (int n = 0; n < src->num_keys; n++)
-        mp_tags_set_str(tags, src->keys[n], src->values[n]);
+        changed |= mp_tags_set_str(tags, src->keys[n], src->values[n]);
+    return changed;
 }
 
 void mp_tags_copy_from_av_dictionary(struct mp_tags *tags,
@@ -1,6 +1,7 @@
 #ifndef MP_TAGS_H
 #define MP_TAGS_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "misc/bstr.h"
@@ -11,8 +12,9 @@ struct mp_tags {
     int num_keys;
 };
 
-void mp_tags_set_str(struct mp_tags *tags, const char *key, const char *value);
-void mp_tags_set_bstr(struct mp_tags *tags, bstr key, bstr value);
+// Return whether the tags were changed.
+bool mp_tags_set_str(struct mp_tags *tags, const char *key, const char *value);
+bool mp_tags_set_bstr(struct mp_tags *tags, bstr key, bstr value);
 void mp_tags_remove_str(struct mp_tags *tags, const char *key);
 void mp_tags_remove_bstr(struct mp_tags *tags, bstr key);
 char *mp_tags_get_str(struct mp_tags *tags, const char *key);
@@ -21,7 +23,7 @@ void mp_tags_clear(struct mp_tags *tags);
 struct mp_tags *mp_tags_dup(void *tparent, struct mp_tags *tags);
 void mp_tags_replace(struct mp_tags *dst, struct mp_tags *src);
 struct mp_tags *mp_tags_filtered(void *tparent, struct mp_tags *tags, char **list);
-void mp_tags_merge(struct mp_tags *tags, struct mp_tags *src);
+bool mp_tags_merge(struct mp_tags *tags, struct mp_tags *src);
 struct AVDictionary;
 void mp_tags_copy_from_av_dictionary(struct mp_tags *tags,
                                      struct AVDictionary *av_dict);
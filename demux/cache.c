@@ -17,11 +17,23 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <libavutil/md5.h>
+
+#include "config.h"
+
+#if HAVE_POSIX
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#endif
+
 #include "cache.h"
 #include "common/msg.h"
 #include "common/av_common.h"
@@ -29,11 +41,15 @@
 #include "options/path.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
+#include "osdep/atomic.h"
 #include "osdep/io.h"
+#include "osdep/threads.h"
 
 struct demux_cache_opts {
     char *cache_dir;
     int unlink_files;
+    int persistent;
+    int64_t write_queue;
 };
 
 #define OPT_BASE_STRUCT struct demux_cache_opts
@@ -44,15 +60,73 @@ const struct m_sub_options demux_cache_conf = {
         {"cache-unlink-files", OPT_CHOICE(unlink_files,
             {"immediate", 2}, {"whendone", 1}, {"no", 0}),
         },
+        {"cache-persistent", OPT_FLAG(persistent)},
+        {"cache-write-queue", OPT_BYTE_SIZE(write_queue),
+            M_RANGE(0, M_MAX_MEM_BYTES)},
         {0}
     },
     .size = sizeof(struct demux_cache_opts),
     .defaults = &(const struct demux_cache_opts){
         .unlink_files = 2,
+        .write_queue = 16 * 1024 * 1024,
     },
 };
 
+struct pkt_header {
+    uint32_t data_len;
+    uint32_t av_flags;
+    uint32_t num_sd;
+};
+
+struct sd_header {
+    uint32_t av_type;
+    uint32_t len;
+};
+
+#define FILE_MAGIC "mpvdcach"
+#define FILE_VERSION 2
+
+// Only persistent cache files have a header. The packet data follows it,
+// and the index (if any) is appended after the last packet.
+struct file_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_ranges;    // number of ranges in the index
+    uint64_t index_pos;     // file position of the index, 0 if none
+    uint8_t key[16];        // MD5 of the cache key
+};
+
+struct range_header {
+    uint32_t num_queues;
+};
+
+struct queue_header {
+    uint32_t stream;
+    uint32_t flags;         // QUEUE_FLAG_*
+    uint64_t num_entries;
+};
+
+#define QUEUE_FLAG_BOF (1 << 0)
+#define QUEUE_FLAG_EOF (1 << 1)
+
+// Packet data is followed by this many zero bytes in the file, so that packets
+// can reference the file mapping directly (FFmpeg requires padded data).
+#define PKT_PADDING AV_INPUT_BUFFER_PADDING_SIZE
+
+// Minimum size of a file mapping for the mmap read path.
+#define MMAP_WINDOW_SIZE (64 * 1024 * 1024)
+
+// A read-only mapping of a file region. Packets returned by demux_cache_read()
+// reference it, so it is refcounted, and can be released from any thread.
+struct mmap_window {
+    atomic_int refcount;
+    uint8_t *ptr;
+    uint64_t offset;        // file position of ptr[0]
+    size_t size;
+};
+
 struct demux_cache {
+    struct mpv_global *global;
     struct mp_log *log;
     struct demux_cache_opts *opts;
 
@@ -61,23 +135,72 @@ struct demux_cache {
     int fd;
     int64_t file_pos;
     uint64_t file_size;
-};
 
-struct pkt_header {
-    uint32_t data_len;
-    uint32_t av_flags;
-    uint32_t num_sd;
+    // Persistent mode only.
+    bool persistent;
+    struct file_header header;
+    struct demux_cache_range *index;    // loaded index (until taken)
+    int num_index;
+
+    bool use_mmap;
+    struct mmap_window *window;         // current mapping, or NULL
+
+#if HAVE_POSIX
+    // Write-behind queue. file_size includes queued packets; all data before
+    // written_size is on disk. The fields below are protected by wq_lock.
+    bool writer_running;
+    pthread_t writer;
+    pthread_mutex_t wq_lock;
+    pthread_cond_t wq_wakeup;
+    struct write_item **wq;             // queued/in-flight packets, by pos
+    int num_wq;
+    uint64_t wq_bytes;                  // file bytes of all items in wq
+    uint64_t written_size;
+    uint64_t fail_pos;                  // data at and after this is lost
+    bool writer_terminate;
+#endif
 };
 
-struct sd_header {
-    uint32_t av_type;
-    uint32_t len;
+struct write_item {
+    uint64_t pos;                       // file position of the record
+    size_t size;                        // size of the record in the file
+    struct pkt_header hd;
+    struct sd_header *sd_hd;
+    AVPacket *pkt;                      // refcounted copy of the packet
 };
 
+#if HAVE_POSIX
+static void window_unref(struct mmap_window *w)
+{
+    if (w && atomic_fetch_add(&w->refcount, -1) == 1) {
+        munmap(w->ptr, w->size);
+        talloc_free(w);
+    }
+}
+
+static void window_buffer_free(void *opaque, uint8_t *data)
+{
+    window_unref(opaque);
+}
+#endif
+
 static void cache_destroy(void *p)
 {
     struct demux_cache *cache = p;
 
+#if HAVE_POSIX
+    if (cache->writer_running) {
+        pthread_mutex_lock(&cache->wq_lock);
+        cache->writer_terminate = true;
+        pthread_cond_broadcast(&cache->wq_wakeup);
+        pthread_mutex_unlock(&cache->wq_lock);
+        pthread_join(cache->writer, NULL);
+        pthread_mutex_destroy(&cache->wq_lock);
+        pthread_cond_destroy(&cache->wq_wakeup);
+    }
+    window_unref(cache->window);
+#endif
+
     if (cache->fd >= 0)
         close(cache->fd);
 
@@ -87,17 +210,25 @@ static void cache_destroy(void *p)
     }
 }
 
+static bool open_persistent(struct demux_cache *cache, const char *key);
+static void start_writer(struct demux_cache *cache);
+static bool flush_queue(struct demux_cache *cache);
+
 // Create a cache. This also initializes the cache file from the options. The
 // log parameter must stay valid until demux_cache is destroyed.
+// key identifies the source (see demux_cache_is_persistent()); it can be NULL
+// if the source can't be identified reliably.
 // Free with talloc_free().
 struct demux_cache *demux_cache_create(struct mpv_global *global,
-                                       struct mp_log *log)
+                                       struct mp_log *log, const char *key)
 {
     struct demux_cache *cache = talloc_zero(NULL, struct demux_cache);
     talloc_set_destructor(cache, cache_destroy);
     cache->opts = mp_get_config_group(cache, global, &demux_cache_conf);
+    cache->global = global;
     cache->log = log;
     cache->fd = -1;
+    cache->use_mmap = HAVE_POSIX;
 
     char *cache_dir = cache->opts->cache_dir;
     if (!(cache_dir && cache_dir[0])) {
@@ -105,6 +236,20 @@ struct demux_cache *demux_cache_create(struct mpv_global *global,
         goto fail;
     }
 
+    if (cache->opts->persistent && key) {
+        if (open_persistent(cache, key)) {
+            start_writer(cache);
+            return cache;
+        }
+        MP_WARN(cache, "Falling back to temporary cache file.\n");
+        if (cache->fd >= 0)
+            close(cache->fd);
+        cache->fd = -1;
+        cache->persistent = false;
+        TA_FREEP(&cache->index);
+        cache->num_index = 0;
+    }
+
     cache->filename = mp_path_join(cache, cache_dir, "mpv-cache-XXXXXX.dat");
     cache->fd = mp_mkostemps(cache->filename, 4, O_CLOEXEC);
     if (cache->fd < 0) {
@@ -120,17 +265,41 @@ struct demux_cache *demux_cache_create(struct mpv_global *global,
         }
     }
 
+    start_writer(cache);
     return cache;
 fail:
     talloc_free(cache);
     return NULL;
 }
 
+// Whether the cache file is kept and reused when the same source is opened
+// again. If true, demux_cache_take_index() may return data from a previous
+// session, and demux_cache_write_index() should be called before closing.
+bool demux_cache_is_persistent(struct demux_cache *cache)
+{
+    return cache->persistent;
+}
+
 uint64_t demux_cache_get_size(struct demux_cache *cache)
 {
     return cache->file_size;
 }
 
+// Return the number of bytes that were accepted by demux_cache_write(), but
+// were not written to the file yet.
+uint64_t demux_cache_get_queued_size(struct demux_cache *cache)
+{
+    uint64_t res = 0;
+#if HAVE_POSIX
+    if (cache->writer_running) {
+        pthread_mutex_lock(&cache->wq_lock);
+        res = cache->wq_bytes;
+        pthread_mutex_unlock(&cache->wq_lock);
+    }
+#endif
+    return res;
+}
+
 static bool do_seek(struct demux_cache *cache, uint64_t pos)
 {
     if (cache->file_pos == pos)
@@ -191,6 +360,463 @@ static bool read_raw(struct demux_cache *cache, void *ptr, size_t len)
     return true;
 }
 
+static bool write_header(struct demux_cache *cache)
+{
+    if (!do_seek(cache, 0))
+        return false;
+    return write_raw(cache, &cache->header, sizeof(cache->header));
+}
+
+// Parse the index at cache->header.index_pos into cache->index. Returns false
+// if the index is malformed.
+static bool read_index(struct demux_cache *cache)
+{
+    uint64_t data_end = cache->header.index_pos;
+
+    if (cache->header.num_ranges > MAX_SEEK_RANGES || !do_seek(cache, data_end))
+        return false;
+
+    cache->index = talloc_zero_array(cache, struct demux_cache_range,
+                                     cache->header.num_ranges);
+
+    for (uint32_t n = 0; n < cache->header.num_ranges; n++) {
+        struct range_header r_hd;
+        if (!read_raw(cache, &r_hd, sizeof(r_hd)))
+            return false;
+
+        struct demux_cache_range *range = &cache->index[n];
+        for (uint32_t i = 0; i < r_hd.num_queues; i++) {
+            struct queue_header q_hd;
+            if (!read_raw(cache, &q_hd, sizeof(q_hd)))
+                return false;
+
+            uint64_t left = cache->file_size - cache->file_pos;
+            if (q_hd.num_entries > left / sizeof(struct demux_cache_entry))
+                return false;
+
+            struct demux_cache_queue queue = {
+                .stream = q_hd.stream,
+                .is_bof = q_hd.flags & QUEUE_FLAG_BOF,
+                .is_eof = q_hd.flags & QUEUE_FLAG_EOF,
+                .num_entries = q_hd.num_entries,
+            };
+            queue.entries = talloc_array(cache->index, struct demux_cache_entry,
+                                         queue.num_entries);
+            MP_TARRAY_APPEND(cache->index, range->queues, range->num_queues,
+                             queue);
+            if (!read_raw(cache, queue.entries,
+                          queue.num_entries * sizeof(queue.entries[0])))
+                return false;
+
+            for (size_t e = 0; e < queue.num_entries; e++) {
+                if (queue.entries[e].pos < sizeof(struct file_header) ||
+                    queue.entries[e].pos >= data_end)
+                    return false;
+            }
+        }
+        cache->num_index = n + 1;
+    }
+
+    return true;
+}
+
+// Open or create the cache file belonging to key. If there is a valid index,
+// it is loaded, and new packets will be appended after the old packet data.
+static bool open_persistent(struct demux_cache *cache, const char *key)
+{
+    char *akey = talloc_asprintf(NULL, "%s\n%u", key, avcodec_version());
+    uint8_t md5[16];
+    av_md5_sum(md5, akey, strlen(akey));
+    talloc_free(akey);
+
+    char *name = talloc_strdup(NULL, "mpv-cache-");
+    for (int i = 0; i < 16; i++)
+        name = talloc_asprintf_append(name, "%02X", md5[i]);
+    name = talloc_strdup_append(name, ".dat");
+    cache->filename = mp_path_join(cache, cache->opts->cache_dir, name);
+    talloc_free(name);
+
+    cache->fd = open(cache->filename, O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+    if (cache->fd < 0) {
+        MP_ERR(cache, "Failed to open cache file '%s'.\n", cache->filename);
+        return false;
+    }
+    cache->persistent = true;
+
+    struct stat st;
+    if (fstat(cache->fd, &st) == 0)
+        cache->file_size = st.st_size;
+
+    struct file_header hd;
+    bool valid = cache->file_size >= sizeof(hd) &&
+                 do_seek(cache, 0) && read_raw(cache, &hd, sizeof(hd)) &&
+                 memcmp(hd.magic, FILE_MAGIC, sizeof(hd.magic)) == 0 &&
+                 hd.version == FILE_VERSION &&
+                 memcmp(hd.key, md5, sizeof(md5)) == 0 &&
+                 hd.index_pos >= sizeof(hd) && hd.index_pos <= cache->file_size;
+
+    if (valid) {
+        cache->header = hd;
+        if (!read_index(cache)) {
+            MP_WARN(cache, "Cache file index is broken, discarding.\n");
+            TA_FREEP(&cache->index);
+            cache->num_index = 0;
+            valid = false;
+        }
+    }
+
+    if (valid) {
+        MP_VERBOSE(cache, "Reusing cache file '%s' with %d ranges.\n",
+                   cache->filename, cache->num_index);
+        // Packet data ends where the index starts. The on-disk index stays
+        // valid until the first new packet is written.
+        cache->file_size = cache->header.index_pos;
+        return true;
+    }
+
+    MP_VERBOSE(cache, "Creating new cache file '%s'.\n", cache->filename);
+    if (ftruncate(cache->fd, 0)) {
+        MP_ERR(cache, "Failed to truncate cache file.\n");
+        return false;
+    }
+    cache->file_pos = -1;
+    cache->file_size = 0;
+    cache->header = (struct file_header){
+        .version = FILE_VERSION,
+    };
+    memcpy(cache->header.magic, FILE_MAGIC, sizeof(cache->header.magic));
+    memcpy(cache->header.key, md5, sizeof(md5));
+    return write_header(cache);
+}
+
+// Return the index loaded from a persistent cache file, and transfer its
+// ownership to ta_parent. The next call will return 0 ranges.
+int demux_cache_take_index(struct demux_cache *cache, void *ta_parent,
+                           struct demux_cache_range **out_ranges)
+{
+    *out_ranges = talloc_steal(ta_parent, cache->index);
+    int num = cache->num_index;
+    cache->index = NULL;
+    cache->num_index = 0;
+    return num;
+}
+
+// Append the given index to a persistent cache file, so it can be loaded with
+// demux_cache_take_index() when the cache file is opened again. All entries
+// must refer to packets written to this cache file.
+void demux_cache_write_index(struct demux_cache *cache,
+                             struct demux_cache_range *ranges, int num_ranges)
+{
+    if (!cache->persistent || !flush_queue(cache) ||
+        !do_seek(cache, cache->file_size))
+        return;
+
+    uint64_t index_pos = cache->file_pos;
+
+    for (int n = 0; n < num_ranges; n++) {
+        struct demux_cache_range *range = &ranges[n];
+        struct range_header r_hd = {.num_queues = range->num_queues};
+        if (!write_raw(cache, &r_hd, sizeof(r_hd)))
+            goto fail;
+
+        for (int i = 0; i < range->num_queues; i++) {
+            struct demux_cache_queue *queue = &range->queues[i];
+            struct queue_header q_hd = {
+                .stream = queue->stream,
+                .flags = (queue->is_bof ? QUEUE_FLAG_BOF : 0) |
+                         (queue->is_eof ? QUEUE_FLAG_EOF : 0),
+                .num_entries = queue->num_entries,
+            };
+            if (!write_raw(cache, &q_hd, sizeof(q_hd)))
+                goto fail;
+            if (!write_raw(cache, queue->entries,
+                           queue->num_entries * sizeof(queue->entries[0])))
+                goto fail;
+        }
+    }
+
+    cache->header.index_pos = index_pos;
+    cache->header.num_ranges = num_ranges;
+    if (!write_header(cache))
+        goto fail;
+
+    MP_VERBOSE(cache, "Wrote cache index with %d ranges.\n", num_ranges);
+    return;
+
+fail:
+    MP_ERR(cache, "Failed to write cache index.\n");
+    cache->header.index_pos = 0;
+    cache->header.num_ranges = 0;
+    write_header(cache);
+}
+
+#if HAVE_POSIX
+static void free_write_item(struct write_item *item)
+{
+    av_packet_free(&item->pkt);
+    talloc_free(item);
+}
+
+// Write the given iovecs to pos. Returns false on errors.
+static bool write_iov(struct demux_cache *cache, struct iovec *iov, int num,
+                      uint64_t pos)
+{
+    while (num > 0) {
+#if HAVE_PWRITEV
+        ssize_t res = pwritev(cache->fd, iov, MPMIN(num, IOV_MAX), pos);
+#else
+        ssize_t res = pwrite(cache->fd, iov[0].iov_base, iov[0].iov_len, pos);
+#endif
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            MP_ERR(cache, "Failed to write to cache file: %s\n",
+                   mp_strerror(errno));
+            return false;
+        }
+        if (res == 0) {
+            MP_ERR(cache, "Could not write all data.\n");
+            return false;
+        }
+        pos += res;
+        // Skip fully written iovecs, and adjust a partially written one.
+        while (num > 0 && res >= iov[0].iov_len) {
+            res -= iov[0].iov_len;
+            iov++;
+            num--;
+        }
+        if (num > 0) {
+            iov[0].iov_base = (char *)iov[0].iov_base + res;
+            iov[0].iov_len -= res;
+        }
+    }
+    return true;
+}
+
+// Maximum number of packets written by a single system call.
+#define WRITE_BATCH 64
+
+static void *writer_thread(void *p)
+{
+    struct demux_cache *cache = p;
+    mpthread_set_name("demux/cache");
+    mpthread_set_class(cache->global, cache->log, "io");
+
+    static const uint8_t padding[PKT_PADDING];
+    struct iovec *iov = NULL;
+    int num_iov = 0;
+
+    pthread_mutex_lock(&cache->wq_lock);
+    while (1) {
+        // Items are only removed by this thread, so they stay valid while
+        // the lock is released (but cache->wq itself may be reallocated).
+        int num = 0;
+        for (int n = 0; n < MPMIN(cache->num_wq, WRITE_BATCH); n++) {
+            if (n && cache->wq[n]->pos != cache->wq[n - 1]->pos +
+                                          cache->wq[n - 1]->size)
+                break;
+            num++;
+        }
+
+        if (!num) {
+            if (cache->writer_terminate)
+                break;
+            pthread_cond_wait(&cache->wq_wakeup, &cache->wq_lock);
+            continue;
+        }
+
+        struct write_item *items[WRITE_BATCH];
+        for (int n = 0; n < num; n++)
+            items[n] = cache->wq[n];
+        uint64_t pos = items[0]->pos, size = 0;
+        bool failed = pos >= cache->fail_pos;
+        pthread_mutex_unlock(&cache->wq_lock);
+
+        num_iov = 0;
+        for (int n = 0; n < num; n++) {
+            struct write_item *item = items[n];
+            struct iovec v[] = {
+                {&item->hd, sizeof(item->hd)},
+                {item->pkt->data, item->pkt->size},
+                {(void *)padding, PKT_PADDING},
+            };
+            for (int i = 0; i < MP_ARRAY_SIZE(v); i++)
+                MP_TARRAY_APPEND(NULL, iov, num_iov, v[i]);
+            for (int i = 0; i < item->hd.num_sd; i++) {
+                AVPacketSideData *sd = &item->pkt->side_data[i];
+                struct iovec v_sd[] = {
+                    {&item->sd_hd[i], sizeof(item->sd_hd[i])},
+                    {sd->data, sd->size},
+                };
+                for (int x = 0; x < MP_ARRAY_SIZE(v_sd); x++)
+                    MP_TARRAY_APPEND(NULL, iov, num_iov, v_sd[x]);
+            }
+            size += item->size;
+        }
+
+        if (!failed)
+            failed = !write_iov(cache, iov, num_iov, pos);
+
+        pthread_mutex_lock(&cache->wq_lock);
+        if (failed) {
+            cache->fail_pos = MPMIN(cache->fail_pos, pos);
+        } else {
+            cache->written_size = pos + size;
+        }
+        for (int n = 0; n < num; n++)
+            free_write_item(items[n]);
+        cache->wq_bytes -= size;
+        cache->num_wq -= num;
+        memmove(cache->wq, cache->wq + num, cache->num_wq * sizeof(cache->wq[0]));
+        pthread_cond_broadcast(&cache->wq_wakeup);
+    }
+    pthread_mutex_unlock(&cache->wq_lock);
+
+    talloc_free(iov);
+    return NULL;
+}
+
+static void start_writer(struct demux_cache *cache)
+{
+    if (!cache->opts->write_queue)
+        return;
+
+    pthread_mutex_init(&cache->wq_lock, NULL);
+    pthread_cond_init(&cache->wq_wakeup, NULL);
+    cache->written_size = cache->file_size;
+    cache->fail_pos = UINT64_MAX;
+
+    if (pthread_create(&cache->writer, NULL, writer_thread, cache)) {
+        MP_WARN(cache, "Failed to create writer thread.\n");
+        pthread_mutex_destroy(&cache->wq_lock);
+        pthread_cond_destroy(&cache->wq_wakeup);
+        return;
+    }
+    cache->writer_running = true;
+}
+
+// Wait until all queued packets were written. Returns false if writing any of
+// them failed.
+static bool flush_queue(struct demux_cache *cache)
+{
+    if (!cache->writer_running)
+        return true;
+
+    pthread_mutex_lock(&cache->wq_lock);
+    while (cache->num_wq)
+        pthread_cond_wait(&cache->wq_wakeup, &cache->wq_lock);
+    bool ok = cache->fail_pos == UINT64_MAX;
+    pthread_mutex_unlock(&cache->wq_lock);
+    return ok;
+}
+
+// Reserve file space for the packet, and let the writer thread write it.
+// Blocks only if the queue is full.
+static int64_t queue_write(struct demux_cache *cache, struct demux_packet *dp)
+{
+    AVPacket *avpkt = dp->avpacket;
+
+    struct write_item *item = talloc_ptrtype(NULL, item);
+    *item = (struct write_item){
+        .hd = {
+            .data_len  = dp->len,
+            .av_flags = avpkt->flags,
+            .num_sd = avpkt->side_data_elems,
+        },
+        .sd_hd = talloc_array(item, struct sd_header, avpkt->side_data_elems),
+        .pkt = av_packet_alloc(),
+    };
+    // (Side data is always copied; packet data is usually refcounted.)
+    if (!item->pkt || av_packet_ref(item->pkt, avpkt) < 0) {
+        free_write_item(item);
+        return -1;
+    }
+
+    item->size = sizeof(item->hd) + dp->len + PKT_PADDING;
+    for (int n = 0; n < avpkt->side_data_elems; n++) {
+        AVPacketSideData *sd = &item->pkt->side_data[n];
+
+        assert(sd->size >= 0 && sd->size <= INT32_MAX);
+        assert(sd->type >= 0 && sd->type <= INT32_MAX);
+
+        item->sd_hd[n] = (struct sd_header){
+            .av_type = sd->type,
+            .len = sd->size,
+        };
+        item->size += sizeof(item->sd_hd[n]) + sd->size;
+    }
+
+    pthread_mutex_lock(&cache->wq_lock);
+
+    while (cache->wq_bytes && cache->wq_bytes + item->size >
+                              cache->opts->write_queue &&
+           cache->fail_pos == UINT64_MAX)
+        pthread_cond_wait(&cache->wq_wakeup, &cache->wq_lock);
+
+    if (cache->fail_pos != UINT64_MAX) {
+        pthread_mutex_unlock(&cache->wq_lock);
+        free_write_item(item);
+        return -1;
+    }
+
+    item->pos = cache->file_size;
+    cache->file_size += item->size;
+    cache->wq_bytes += item->size;
+    MP_TARRAY_APPEND(NULL, cache->wq, cache->num_wq, item);
+    pthread_cond_broadcast(&cache->wq_wakeup);
+
+    pthread_mutex_unlock(&cache->wq_lock);
+
+    return item->pos;
+}
+
+// If the packet at pos was not written yet, return a copy of it. *out is set
+// to NULL if the packet is lost due to write errors. Returns false if the
+// packet is on disk.
+static bool read_queued(struct demux_cache *cache, uint64_t pos,
+                        struct demux_packet **out)
+{
+    if (!cache->writer_running)
+        return false;
+
+    bool res = false;
+    pthread_mutex_lock(&cache->wq_lock);
+    if (pos >= cache->fail_pos) {
+        MP_ERR(cache, "Packet was not written to cache file.\n");
+        *out = NULL;
+        res = true;
+    } else if (pos >= cache->written_size) {
+        // Binary search; items are sorted by position.
+        int a = 0, b = cache->num_wq;
+        while (a < b) {
+            int m = a + (b - a) / 2;
+            if (cache->wq[m]->pos < pos) {
+                a = m + 1;
+            } else {
+                b = m;
+            }
+        }
+        *out = NULL;
+        if (a < cache->num_wq && cache->wq[a]->pos == pos)
+            *out = new_demux_packet_from_avpacket(cache->wq[a]->pkt);
+        if (*out)
+            (*out)->avpacket->flags = cache->wq[a]->pkt->flags;
+        res = true;
+    }
+    pthread_mutex_unlock(&cache->wq_lock);
+    return res;
+}
+#else
+static void start_writer(struct demux_cache *cache)
+{
+}
+
+static bool flush_queue(struct demux_cache *cache)
+{
+    return true;
+}
+#endif
+
 // Serialize a packet to the cache file. Returns the packet position, which can
 // be passed to demux_cache_read() to read the packet again.
 // Returns a negative value on errors, i.e. writing the file failed.
@@ -212,6 +838,22 @@ int64_t demux_cache_write(struct demux_cache *cache, struct demux_packet *dp)
     assert(dp->avpacket->side_data_elems >= 0 &&
            dp->avpacket->side_data_elems <= INT32_MAX);
 
+    // Appending packets overwrites the index of a reused cache file, so mark
+    // it as invalid first.
+    if (cache->header.index_pos) {
+        cache->header.index_pos = 0;
+        cache->header.num_ranges = 0;
+        if (!write_header(cache) || ftruncate(cache->fd, cache->file_size)) {
+            MP_ERR(cache, "Failed to invalidate cache file index.\n");
+            return -1;
+        }
+    }
+
+#if HAVE_POSIX
+    if (cache->writer_running)
+        return queue_write(cache, dp);
+#endif
+
     if (!do_seek(cache, cache->file_size))
         return -1;
 
@@ -229,6 +871,10 @@ int64_t demux_cache_write(struct demux_cache *cache, struct demux_packet *dp)
     if (!write_raw(cache, dp->buffer, dp->len))
         goto fail;
 
+    static const uint8_t padding[PKT_PADDING];
+    if (!write_raw(cache, (void *)padding, PKT_PADDING))
+        goto fail;
+
     // The handling of FFmpeg side data requires an extra long comment to
     // explain why this code is fragile and insane.
     // FFmpeg packet side data is per-packet out of band data, that contains
@@ -249,7 +895,8 @@ int64_t demux_cache_write(struct demux_cache *cache, struct demux_packet *dp)
     // for example dump the data in a disk cache, even though we can't use the
     // data from another process or if this process is restarted (unless we're
     // absolutely sure the FFmpeg internals didn't change). The data has to be
-    // treated as a memory dump.
+    // treated as a memory dump. (Persistent cache files include the
+    // libavcodec version in the key for this reason.)
     for (int n = 0; n < dp->avpacket->side_data_elems; n++) {
         AVPacketSideData *sd = &dp->avpacket->side_data[n];
 
@@ -276,8 +923,143 @@ fail:
     return -1;
 }
 
+#if HAVE_POSIX
+// Make sure the file region [pos, pos + len) is in cache->window, and return a
+// pointer to it, or NULL if the region could not be mapped.
+static uint8_t *map_region(struct demux_cache *cache, uint64_t pos, size_t len)
+{
+    struct mmap_window *w = cache->window;
+    uint64_t file_size = cache->file_size;
+
+    if (cache->writer_running) {
+        pthread_mutex_lock(&cache->wq_lock);
+        file_size = cache->written_size;
+        pthread_mutex_unlock(&cache->wq_lock);
+    }
+
+    if (pos > file_size || len > file_size - pos)
+        return NULL;
+
+    if (w && pos >= w->offset && pos - w->offset + len <= w->size)
+        return w->ptr + (pos - w->offset);
+
+    window_unref(cache->window);
+    cache->window = NULL;
+
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    uint64_t start = pos / page * page;
+    uint64_t size = MPMAX(MMAP_WINDOW_SIZE, pos - start + len);
+    size = MPMIN(size, file_size - start);
+
+    void *ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, cache->fd, start);
+    if (ptr == MAP_FAILED) {
+        MP_WARN(cache, "Failed to map cache file, using slow path: %s\n",
+                mp_strerror(errno));
+        cache->use_mmap = false;
+        return NULL;
+    }
+
+    w = talloc_ptrtype(NULL, w);
+    *w = (struct mmap_window){
+        .ptr = ptr,
+        .offset = start,
+        .size = size,
+    };
+    atomic_store(&w->refcount, 1);
+    cache->window = w;
+
+    return w->ptr + (pos - w->offset);
+}
+
+// Read the packet at pos from the file mapping. The packet data is not copied.
+// Returns false if the mapping can't be used (then *out is not set).
+static bool read_mapped(struct demux_cache *cache, uint64_t pos,
+                        struct demux_packet **out)
+{
+    struct demux_packet *dp = NULL;
+    struct pkt_header hd;
+
+    uint8_t *ptr = map_region(cache, pos, sizeof(hd));
+    if (!ptr)
+        return false;
+    memcpy(&hd, ptr, sizeof(hd));
+    pos += sizeof(hd);
+
+    if (hd.data_len > INT_MAX - PKT_PADDING)
+        goto fail;
+
+    ptr = map_region(cache, pos, hd.data_len + PKT_PADDING);
+    if (!ptr)
+        goto fail;
+    pos += hd.data_len + PKT_PADDING;
+
+    struct mmap_window *w = cache->window;
+    AVBufferRef *buf = av_buffer_create(ptr, hd.data_len + PKT_PADDING,
+                                        window_buffer_free, w,
+                                        AV_BUFFER_FLAG_READONLY);
+    if (!buf)
+        goto fail;
+    atomic_fetch_add(&w->refcount, 1);
+
+    AVPacket pkt = {
+        .buf = buf,
+        .data = buf->data,
+        .size = hd.data_len,
+    };
+    dp = new_demux_packet_from_avpacket(&pkt);
+    av_buffer_unref(&buf);
+    if (!dp)
+        goto fail;
+
+    dp->avpacket->flags = hd.av_flags;
+
+    for (uint32_t n = 0; n < hd.num_sd; n++) {
+        struct sd_header sd_hd;
+
+        ptr = map_region(cache, pos, sizeof(sd_hd));
+        if (!ptr)
+            goto fail;
+        memcpy(&sd_hd, ptr, sizeof(sd_hd));
+        pos += sizeof(sd_hd);
+
+        if (sd_hd.len > INT_MAX)
+            goto fail;
+
+        ptr = map_region(cache, pos, sd_hd.len);
+        if (!ptr)
+            goto fail;
+        pos += sd_hd.len;
+
+        uint8_t *sd = av_packet_new_side_data(dp->avpacket, sd_hd.av_type,
+                                              sd_hd.len);
+        if (!sd)
+            goto fail;
+        memcpy(sd, ptr, sd_hd.len);
+    }
+
+    *out = dp;
+    return true;
+
+fail:
+    talloc_free(dp);
+    if (!cache->use_mmap)
+        return false; // the mapping failed, not the packet
+    MP_ERR(cache, "Could not read packet from cache file.\n");
+    *out = NULL;
+    return true;
+}
+#endif
+
 struct demux_packet *demux_cache_read(struct demux_cache *cache, uint64_t pos)
 {
+#if HAVE_POSIX
+    struct demux_packet *res;
+    if (read_queued(cache, pos, &res))
+        return res;
+    if (cache->use_mmap && read_mapped(cache, pos, &res))
+        return res;
+#endif
+
     if (!do_seek(cache, pos))
         return NULL;
 
@@ -293,7 +1075,8 @@ struct demux_packet *demux_cache_read(struct demux_cache *cache, uint64_t pos)
     if (!dp)
         goto fail;
 
-    if (!read_raw(cache, dp->buffer, dp->len))
+    // (The packet buffer is allocated with padding, so read it as well.)
+    if (!read_raw(cache, dp->buffer, dp->len + PKT_PADDING))
         goto fail;
 
     dp->avpacket->flags = hd.av_flags;
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 struct demux_packet;
@@ -8,9 +10,38 @@ struct mpv_global;
 
 struct demux_cache;
 
+// Packet metadata as stored in the index of a persistent cache file.
+struct demux_cache_entry {
+    uint64_t pos;           // as returned by demux_cache_write()
+    int64_t demux_pos;      // demux_packet.pos
+    double pts, dts, duration;
+    uint32_t keyframe;
+    uint32_t reserved;
+};
+
+// All packets of a stream within a range (in demuxing order).
+struct demux_cache_queue {
+    uint32_t stream;        // demux_packet.stream
+    bool is_bof, is_eof;
+    struct demux_cache_entry *entries;
+    size_t num_entries;
+};
+
+struct demux_cache_range {
+    struct demux_cache_queue *queues;
+    int num_queues;
+};
+
 struct demux_cache *demux_cache_create(struct mpv_global *global,
-                                       struct mp_log *log);
+                                       struct mp_log *log, const char *key);
 
 int64_t demux_cache_write(struct demux_cache *cache, struct demux_packet *pkt);
 struct demux_packet *demux_cache_read(struct demux_cache *cache, uint64_t pos);
 uint64_t demux_cache_get_size(struct demux_cache *cache);
+uint64_t demux_cache_get_queued_size(struct demux_cache *cache);
+
+bool demux_cache_is_persistent(struct demux_cache *cache);
+int demux_cache_take_index(struct demux_cache *cache, void *ta_parent,
+                           struct demux_cache_range **out_ranges);
+void demux_cache_write_index(struct demux_cache *cache,
+                             struct demux_cache_range *ranges, int num_ranges);
@@ -38,6 +38,7 @@
 #include "common/av_common.h"
 #include "common/msg.h"
 #include "common/global.h"
+#include "common/memory.h"
 #include "common/recorder.h"
 #include "common/stats.h"
 #include "misc/charset_conv.h"
@@ -84,13 +85,25 @@ static const demuxer_desc_t *const demuxer_list[] = {
     NULL
 };
 
+enum {
+    EVICT_LRU,          // oldest range first, shortest range if too many
+    EVICT_WEIGHTED,     // by size, distance to playback, and chapters
+    EVICT_REUSE,        // least often hit by recent seeks first
+};
+
 struct demux_opts {
     int enable_cache;
     int disk_cache;
+    int compress_cache;
+    int cache_eviction;
     int64_t max_bytes;
     int64_t max_bytes_bw;
     int donate_fw;
     double min_secs;
+    int readahead_adaptive;
+    double readahead_max_secs;
+    double readahead_underrun;
+    double index_step;
     int force_seekable;
     double min_secs_cache;
     int access_references;
@@ -114,7 +127,17 @@ const struct m_sub_options demux_conf = {
         {"cache", OPT_CHOICE(enable_cache,
             {"no", 0}, {"auto", -1}, {"yes", 1})},
         {"cache-on-disk", OPT_FLAG(disk_cache)},
+        {"demuxer-cache-compress", OPT_FLAG(compress_cache)},
+        {"demuxer-cache-eviction", OPT_CHOICE(cache_eviction,
+            {"lru", EVICT_LRU}, {"weighted", EVICT_WEIGHTED},
+            {"reuse", EVICT_REUSE})},
         {"demuxer-readahead-secs", OPT_DOUBLE(min_secs), M_RANGE(0, DBL_MAX)},
+        {"demuxer-readahead-adaptive", OPT_FLAG(readahead_adaptive)},
+        {"demuxer-readahead-max-secs", OPT_DOUBLE(readahead_max_secs),
+            M_RANGE(0, DBL_MAX)},
+        {"demuxer-readahead-underrun", OPT_DOUBLE(readahead_underrun),
+            M_RANGE(0.0001, 0.5)},
+        {"demuxer-index-step", OPT_DOUBLE(index_step), M_RANGE(0, DBL_MAX)},
         {"demuxer-max-bytes", OPT_BYTE_SIZE(max_bytes),
             M_RANGE(0, M_MAX_MEM_BYTES)},
         {"demuxer-max-back-bytes", OPT_BYTE_SIZE(max_bytes_bw),
@@ -149,6 +172,9 @@ const struct m_sub_options demux_conf = {
         .max_bytes_bw = 50 * 1024 * 1024,
         .donate_fw = 1,
         .min_secs = 1.0,
+        .readahead_max_secs = 60.0,
+        .readahead_underrun = 0.01,
+        .index_step = 1.0,
         .min_secs_cache = 1000.0 * 60 * 60,
         .seekable_cache = -1,
         .access_references = 1,
@@ -164,6 +190,9 @@ const struct m_sub_options demux_conf = {
     .get_sub_options = get_demux_sub_opts,
 };
 
+// Number of recent seek targets remembered for --demuxer-cache-eviction=reuse.
+#define SEEK_HISTORY_SIZE 32
+
 struct demux_internal {
     struct mp_log *log;
     struct mpv_global *global;
@@ -206,10 +235,13 @@ struct demux_internal {
     int events;
 
     struct demux_cache *cache;
+    char *cache_key;            // identifies the source for persistent caches
+    bool cache_index_restored;  // persistent cache ranges were restored
 
     bool warned_queue_overflow;
     bool eof;                   // whether we're in EOF state
     double min_secs;
+    double index_step;          // minimum distance between keyframe index entries
     size_t max_bytes;
     size_t max_bytes_bw;
     bool seekable_cache;
@@ -247,8 +279,15 @@ struct demux_internal {
     int seek_flags;             // flags for next seek (if seeking==true)
     double seek_pts;
 
+    // Ring buffer of recent seek targets, most recent at
+    // seek_history[(seek_history_pos - 1) % SEEK_HISTORY_SIZE].
+    double seek_history[SEEK_HISTORY_SIZE];
+    int seek_history_pos;
+    int num_seek_history;
+
     // (fields for debugging)
     double seeking_in_progress; // low level seek state
+    struct demux_seek_timing last_seek;
     int low_level_seeks;        // number of started low level seeks
     double demux_ts;            // last demuxed DTS or PTS
 
@@ -258,7 +297,17 @@ struct demux_internal {
     struct demux_cached_range **ranges;
     int num_ranges;
 
+    // Ranges with a valid seek range, sorted by seek_start, for lookups by
+    // find_cache_seek_range(). sorted_ends[n] is the highest seek_end of all
+    // sorted_ranges[0..n]. Rebuilt on demand if !sorted_ranges_valid.
+    struct demux_cached_range **sorted_ranges;
+    double *sorted_ends;
+    int num_sorted_ranges;
+    bool sorted_ranges_valid;
+
     size_t total_bytes;         // total sum of packet data buffered
+    struct mp_memory_user *mem; // reports total_bytes
+    int64_t mem_allowance;      // share of --memory-budget (INT64_MAX if none)
     // Range from which decoder is reading, and to which demuxer is appending.
     // This is normally never NULL. This is always ranges[num_ranges - 1].
     // This is can be NULL during initialization or deinitialization.
@@ -272,10 +321,16 @@ struct demux_internal {
     double duration;
     // Cached state.
     int64_t stream_size;
+    struct stream_segments stream_segments;
     int64_t last_speed_query;
     double speed_query_prev_sample;
     uint64_t bytes_per_second;
     int64_t next_cache_update;
+    // For --demuxer-readahead-adaptive.
+    double readahead_target;    // current readahead in seconds
+    double link_rate_mean;      // link throughput in bytes/s (smoothed)
+    double link_rate_var;       // variance of link_rate_mean
+    int64_t link_rate_read_time; // stream_read_time at the last sample
 
     // demux user state (user thread, somewhat similar to reader/decoder state)
     double last_playback_pts;   // last playback_pts from demux_update()
@@ -294,6 +349,9 @@ struct demux_internal {
     int64_t hack_unbuffered_read_bytes;  // for demux_get_bytes_read_hack()
     int64_t cache_unbuffered_read_bytes; // for demux_reader_state.bytes_per_second
     int64_t byte_level_seeks;            // for demux_reader_state.byte_level_seeks
+    int64_t stream_read_time;            // for demux_reader_state.stream_read_time
+    int64_t index_entries;               // for demux_reader_state.index_entries
+    int64_t index_bytes;                 // for demux_reader_state.index_bytes
 };
 
 struct timed_metadata {
@@ -327,10 +385,6 @@ struct demux_cached_range {
 #define QUEUE_INDEX_ENTRY(queue, idx) \
     ((queue)->index[((queue)->index0 + (idx)) & QUEUE_INDEX_SIZE_MASK(queue)])
 
-// Don't index packets whose timestamps that are within the last index entry by
-// this amount of time (it's better to seek them manually).
-#define INDEX_STEP_SIZE 1.0
-
 struct index_entry {
     double pts;
     struct demux_packet *pkt;
@@ -366,6 +420,10 @@ struct demux_queue {
     bool is_bof;            // started demuxing at beginning of file
     bool is_eof;            // received true EOF here
 
+    // For --demuxer-cache-compress (used only if range is not current_range).
+    struct demux_packet *compress_next; // next packet to compress (NULL: head)
+    bool compress_done;     // all packets were compressed (or skipped)
+
     // Complete index, though it may skip some entries to reduce density.
     struct index_entry *index;  // ring buffer
     size_t index_size;          // size of index[] (0 or a power of 2)
@@ -429,6 +487,9 @@ struct demux_stream {
     bool back_restarting;   // searching keyframe before restart pos
     // Current PTS lower bound for back demuxing.
     double back_seek_pos;
+    // Step for the next seek back, adapted to the keyframe distance (0: use
+    // --demuxer-backward-playback-step).
+    double back_seek_step;
     // pos/dts of the packet to resume demuxing from when another stream caused
     // a seek backward to get more packets. reader_head will be reset to this
     // packet as soon as it's encountered again.
@@ -461,6 +522,10 @@ static struct demux_packet *compute_keyframe_times(struct demux_packet *pkt,
                                                    double *out_kf_min,
                                                    double *out_kf_max);
 static void find_backward_restart_pos(struct demux_stream *ds);
+static void add_index_entry(struct demux_queue *queue, struct demux_packet *dp,
+                            double pts);
+static void add_missing_streams(struct demux_internal *in,
+                                struct demux_cached_range *range);
 static struct demux_packet *find_seek_target(struct demux_queue *queue,
                                              double pts, int flags);
 static void prune_old_packets(struct demux_internal *in);
@@ -604,8 +669,7 @@ static void prune_metadata(struct demux_cached_range *range)
     }
 }
 
-// Refresh range->seek_start/end. Idempotent.
-static void update_seek_ranges(struct demux_cached_range *range)
+static void refresh_seek_ranges(struct demux_cached_range *range)
 {
     range->seek_start = range->seek_end = MP_NOPTS_VALUE;
     range->is_bof = true;
@@ -695,6 +759,24 @@ broken:
     prune_metadata(range);
 }
 
+// Refresh range->seek_start/end. Idempotent.
+static void update_seek_ranges(struct demux_cached_range *range)
+{
+    double seek_start = range->seek_start;
+    double seek_end = range->seek_end;
+    bool is_bof = range->is_bof;
+    bool is_eof = range->is_eof;
+
+    refresh_seek_ranges(range);
+
+    // (A range without streams can't have a valid seek range.)
+    if (range->num_streams && (range->seek_start != seek_start ||
+                               range->seek_end != seek_end ||
+                               range->is_bof != is_bof ||
+                               range->is_eof != is_eof))
+        range->streams[0]->ds->in->sorted_ranges_valid = false;
+}
+
 // Remove queue->head from the queue.
 static void remove_head_packet(struct demux_queue *queue)
 {
@@ -710,6 +792,9 @@ static void remove_head_packet(struct demux_queue *queue)
     uint64_t end_pos = dp->next ? dp->next->cum_pos : queue->tail_cum_pos;
     queue->ds->in->total_bytes -= end_pos - dp->cum_pos;
 
+    if (queue->compress_next == dp)
+        queue->compress_next = dp->next;
+
     if (queue->num_index && queue->index[queue->index0].pkt == dp) {
         queue->index0 = (queue->index0 + 1) & QUEUE_INDEX_SIZE_MASK(queue);
         queue->num_index -= 1;
@@ -728,6 +813,7 @@ static void free_index(struct demux_queue *queue)
     struct demux_internal *in = ds->in;
 
     in->total_bytes -= queue->index_size * sizeof(queue->index[0]);
+    in->index_bytes -= queue->index_size * sizeof(queue->index[0]);
     queue->index_size = 0;
     queue->index0 = 0;
     queue->num_index = 0;
@@ -754,6 +840,8 @@ static void clear_queue(struct demux_queue *queue)
     queue->head = queue->tail = NULL;
     queue->keyframe_first = NULL;
     queue->keyframe_latest = NULL;
+    queue->compress_next = NULL;
+    queue->compress_done = false;
     queue->seek_start = queue->seek_end = queue->last_pruned = MP_NOPTS_VALUE;
 
     queue->correct_dts = queue->correct_pos = true;
@@ -778,12 +866,105 @@ static void clear_cached_range(struct demux_internal *in,
     update_seek_ranges(range);
 }
 
+static uint64_t get_range_bytes(struct demux_cached_range *range)
+{
+    uint64_t bytes = 0;
+    for (int n = 0; n < range->num_streams; n++) {
+        struct demux_queue *queue = range->streams[n];
+        if (queue->head)
+            bytes += queue->tail_cum_pos - queue->head->cum_pos;
+    }
+    return bytes;
+}
+
+// Distance of pts to the range's seek range (0 if pts is within it).
+static double get_range_distance(struct demux_cached_range *range, double pts)
+{
+    if (pts < range->seek_start)
+        return range->seek_start - pts;
+    if (pts > range->seek_end)
+        return pts - range->seek_end;
+    return 0;
+}
+
+// How much the range should be evicted before others (higher means sooner).
+// n is the index into in->ranges[]. If for_pruning is set, this is used to
+// select which range to prune packets from when the cache is full, otherwise
+// which range to drop if there are too many ranges.
+static double get_range_eviction_score(struct demux_internal *in, int n,
+                                       bool for_pruning)
+{
+    struct demux_cached_range *range = in->ranges[n];
+
+    if (in->opts->cache_eviction == EVICT_LRU) {
+        if (for_pruning)
+            return -n;
+        return -(range->seek_end - range->seek_start);
+    }
+
+    // Ranges which can't be seeked to are worthless.
+    if (range->seek_start == MP_NOPTS_VALUE)
+        return INFINITY;
+
+    double pts = in->last_playback_pts;
+    if (pts == MP_NOPTS_VALUE && in->current_range)
+        pts = in->current_range->seek_end;
+
+    if (in->opts->cache_eviction == EVICT_REUSE) {
+        // Recent seeks near the range count more than old ones. Ties are
+        // broken by the distance to the playback position.
+        double hits = 0;
+        for (int i = 0; i < in->num_seek_history; i++) {
+            int idx = (in->seek_history_pos - 1 - i + SEEK_HISTORY_SIZE) %
+                      SEEK_HISTORY_SIZE;
+            if (get_range_distance(range, in->seek_history[idx]) <= 10)
+                hits += 1.0 / (1 + i);
+        }
+        double dist = pts == MP_NOPTS_VALUE ? 0 : get_range_distance(range, pts);
+        return -hits * 1e6 + MPMIN(dist, 1e5);
+    }
+
+    // EVICT_WEIGHTED: prefer far away and large ranges, but avoid ranges
+    // containing a chapter start, which are likely to be seeked to.
+    double dist = pts == MP_NOPTS_VALUE ? 0 : get_range_distance(range, pts);
+    double score = (1 + dist) * (1 + get_range_bytes(range) / (1024.0 * 1024));
+    struct demuxer *demuxer = in->d_thread;
+    for (int i = 0; i < demuxer->num_chapters; i++) {
+        double chapter_pts = demuxer->chapters[i].pts;
+        if (chapter_pts >= range->seek_start && chapter_pts <= range->seek_end) {
+            score /= 4;
+            break;
+        }
+    }
+    return score;
+}
+
+// Return the range from which packets should be pruned if the cache is full.
+static struct demux_cached_range *find_prune_range(struct demux_internal *in)
+{
+    // The current range is pruned only if there are no others.
+    if (in->num_ranges == 1)
+        return in->ranges[0];
+
+    int best = 0;
+    double best_score = get_range_eviction_score(in, 0, true);
+    for (int n = 1; n < in->num_ranges - 1; n++) {
+        double score = get_range_eviction_score(in, n, true);
+        if (score > best_score) {
+            best = n;
+            best_score = score;
+        }
+    }
+    return in->ranges[best];
+}
+
 // Remove ranges with no data (except in->current_range). Also remove excessive
 // ranges.
 static void free_empty_cached_ranges(struct demux_internal *in)
 {
     while (1) {
         struct demux_cached_range *worst = NULL;
+        double worst_score = 0;
 
         int end = in->num_ranges - 1;
 
@@ -799,13 +980,16 @@ static void free_empty_cached_ranges(struct demux_internal *in)
             if (range->seek_start == MP_NOPTS_VALUE || !in->seekable_cache) {
                 clear_cached_range(in, range);
                 MP_TARRAY_REMOVE_AT(in->ranges, in->num_ranges, n);
+                in->sorted_ranges_valid = false;
                 for (int i = 0; i < range->num_streams; i++)
                     talloc_free(range->streams[i]);
                 talloc_free(range);
             } else {
-                if (!worst || (range->seek_end - range->seek_start <
-                               worst->seek_end - worst->seek_start))
+                double score = get_range_eviction_score(in, n, false);
+                if (!worst || score > worst_score) {
                     worst = range;
+                    worst_score = score;
+                }
             }
         }
 
@@ -844,6 +1028,7 @@ static void ds_clear_reader_state(struct demux_stream *ds,
         ds->back_restart_next = ds->in->back_demuxing;
         ds->back_restarting = ds->in->back_demuxing && ds->eager;
         ds->back_seek_pos = MP_NOPTS_VALUE;
+        ds->back_seek_step = 0;
         ds->back_resume_pos = -1;
         ds->back_resume_dts = MP_NOPTS_VALUE;
         ds->back_resuming = false;
@@ -881,6 +1066,182 @@ static void wakeup_ds(struct demux_stream *ds)
     }
 }
 
+// Append a packet that resides in the disk cache to a queue of a range that is
+// not the current range (i.e. nothing is reading from it).
+static void restore_cached_packet(struct demux_queue *queue,
+                                  struct demux_cache_entry *e)
+{
+    struct demux_stream *ds = queue->ds;
+    struct demux_internal *in = ds->in;
+
+    struct demux_packet *dp = talloc_ptrtype(NULL, dp);
+    *dp = (struct demux_packet){
+        .pts = e->pts,
+        .dts = e->dts,
+        .duration = e->duration,
+        .pos = e->demux_pos,
+        .cached_data = {.pos = e->pos},
+        .stream = ds->index,
+        .keyframe = e->keyframe,
+        .is_cached = true,
+        .start = MP_NOPTS_VALUE,
+        .end = MP_NOPTS_VALUE,
+    };
+
+    queue->correct_pos &= dp->pos >= 0 && dp->pos > queue->last_pos;
+    queue->correct_dts &= dp->dts != MP_NOPTS_VALUE && dp->dts > queue->last_dts;
+    queue->last_pos = dp->pos;
+    queue->last_dts = dp->dts;
+
+    double ts = dp->dts == MP_NOPTS_VALUE ? dp->pts : dp->dts;
+    if (ts != MP_NOPTS_VALUE && (ts > queue->last_ts || ts + 10 < queue->last_ts))
+        queue->last_ts = ts;
+
+    size_t bytes = demux_packet_estimate_total_size(dp);
+    in->total_bytes += bytes;
+    dp->cum_pos = queue->tail_cum_pos;
+    queue->tail_cum_pos += bytes;
+
+    if (queue->tail) {
+        queue->tail->next = dp;
+        queue->tail = dp;
+    } else {
+        queue->head = queue->tail = dp;
+    }
+
+    // Same as adjust_seek_range_on_packet(), minus the range updates.
+    if (dp->keyframe) {
+        if (queue->keyframe_latest) {
+            double kf_min, kf_max;
+            compute_keyframe_times(queue->keyframe_latest, &kf_min, &kf_max);
+            if (kf_min != MP_NOPTS_VALUE) {
+                add_index_entry(queue, queue->keyframe_latest, kf_min);
+                if (queue->seek_start == MP_NOPTS_VALUE)
+                    queue->seek_start = kf_min + ds->sh->seek_preroll;
+            }
+            if (kf_max != MP_NOPTS_VALUE)
+                queue->seek_end = MP_PTS_MAX(queue->seek_end, kf_max);
+        }
+        queue->keyframe_latest = dp;
+    }
+}
+
+// Turn the index loaded from a persistent cache file into cached ranges. This
+// is done when the first stream is selected, because the seek ranges are
+// defined by the selected streams only. (Queues of streams which are selected
+// later are restored as well, so they can be used once they are selected.)
+static void restore_persistent_ranges(struct demux_internal *in)
+{
+    in->cache_index_restored = true;
+
+    struct demux_cache_range *ranges;
+    int num_ranges = demux_cache_take_index(in->cache, NULL, &ranges);
+
+    for (int n = 0; n < num_ranges; n++) {
+        struct demux_cache_range *src = &ranges[n];
+
+        struct demux_cached_range *range = talloc_ptrtype(NULL, range);
+        *range = (struct demux_cached_range){
+            .seek_start = MP_NOPTS_VALUE,
+            .seek_end = MP_NOPTS_VALUE,
+        };
+        add_missing_streams(in, range);
+
+        for (int i = 0; i < src->num_queues; i++) {
+            struct demux_cache_queue *sq = &src->queues[i];
+            if (sq->stream >= range->num_streams)
+                continue;
+
+            struct demux_queue *queue = range->streams[sq->stream];
+            if (queue->head)
+                continue; // duplicate entry; ignore
+
+            for (size_t e = 0; e < sq->num_entries; e++)
+                restore_cached_packet(queue, &sq->entries[e]);
+
+            if (sq->is_eof) {
+                // Close the last keyframe range like mark_stream_eof() does.
+                if (queue->keyframe_latest) {
+                    double kf_max;
+                    compute_keyframe_times(queue->keyframe_latest, NULL, &kf_max);
+                    if (kf_max != MP_NOPTS_VALUE)
+                        queue->seek_end = MP_PTS_MAX(queue->seek_end, kf_max);
+                }
+                queue->keyframe_latest = NULL;
+            }
+            queue->is_bof = sq->is_bof;
+            queue->is_eof = sq->is_eof;
+
+            struct demux_stream *ds = queue->ds;
+            ds->global_correct_pos &= queue->correct_pos;
+            ds->global_correct_dts &= queue->correct_dts;
+        }
+
+        // Least recently used position; the current range must stay last.
+        MP_TARRAY_INSERT_AT(in, in->ranges, in->num_ranges, 0, range);
+        in->sorted_ranges_valid = false;
+    }
+
+    if (num_ranges)
+        MP_VERBOSE(in, "restored %d ranges from cache file\n", num_ranges);
+
+    talloc_free(ranges);
+}
+
+// Save the packet index of all cached ranges to a persistent cache file.
+// Ranges which contain packets that are not in the cache file are skipped.
+static void write_persistent_index(struct demux_internal *in)
+{
+    void *ta_ctx = talloc_new(NULL);
+    struct demux_cache_range *ranges = NULL;
+    int num_ranges = 0;
+
+    for (int n = 0; n < in->num_ranges; n++) {
+        struct demux_cached_range *range = in->ranges[n];
+        if (range->seek_start == MP_NOPTS_VALUE)
+            continue;
+
+        struct demux_cache_range dst = {0};
+        bool ok = true;
+
+        for (int i = 0; i < range->num_streams; i++) {
+            struct demux_queue *queue = range->streams[i];
+            if (!queue->head)
+                continue;
+
+            struct demux_cache_queue dq = {
+                .stream = i,
+                .is_bof = queue->is_bof,
+                .is_eof = queue->is_eof,
+            };
+            for (struct demux_packet *dp = queue->head; dp; dp = dp->next) {
+                if (!dp->is_cached || dp->segmented) {
+                    ok = false;
+                    break;
+                }
+                struct demux_cache_entry e = {
+                    .pos = dp->cached_data.pos,
+                    .demux_pos = dp->pos,
+                    .pts = dp->pts,
+                    .dts = dp->dts,
+                    .duration = dp->duration,
+                    .keyframe = dp->keyframe,
+                };
+                MP_TARRAY_APPEND(ta_ctx, dq.entries, dq.num_entries, e);
+            }
+            if (!ok)
+                break;
+            MP_TARRAY_APPEND(ta_ctx, dst.queues, dst.num_queues, dq);
+        }
+
+        if (ok && dst.num_queues)
+            MP_TARRAY_APPEND(ta_ctx, ranges, num_ranges, dst);
+    }
+
+    demux_cache_write_index(in->cache, ranges, num_ranges);
+    talloc_free(ta_ctx);
+}
+
 static void update_stream_selection_state(struct demux_internal *in,
                                           struct demux_stream *ds)
 {
@@ -919,6 +1280,9 @@ static void update_stream_selection_state(struct demux_internal *in,
 
     ds_clear_reader_state(ds, true);
 
+    if (ds->selected && in->cache && !in->cache_index_restored)
+        restore_persistent_ranges(in);
+
     // Make sure any stream reselection or addition is reflected in the seek
     // ranges, and also get rid of data that is not needed anymore (or
     // rather, which can't be kept consistent). This has to happen after we've
@@ -1096,6 +1460,9 @@ static void demux_shutdown(struct demux_internal *in)
 
     dumper_close(in);
 
+    if (in->cache && demux_cache_is_persistent(in->cache))
+        write_persistent_index(in);
+
     if (demuxer->desc->close)
         demuxer->desc->close(in->d_thread);
     demuxer->priv = NULL;
@@ -1351,6 +1718,36 @@ static void check_backward_seek(struct demux_internal *in)
     }
 }
 
+// Number of keyframe ranges a backward seek should read ahead of time.
+#define BACK_SEEK_RANGES 4
+
+// Size the next backward seek to the average keyframe distance seen in
+// [first_kf, last_kf], so that a seek reads a few batches of keyframe ranges,
+// instead of always --demuxer-backward-playback-step seconds. Long steps are
+// costly with short GOPs, as every backstep searches through all packets.
+static void update_back_seek_step(struct demux_stream *ds,
+                                  struct demux_packet *first_kf,
+                                  struct demux_packet *last_kf,
+                                  int num_kf, int total)
+{
+    if (num_kf < 2)
+        return;
+
+    double pts_first, pts_last;
+    compute_keyframe_times(first_kf, &pts_first, NULL);
+    compute_keyframe_times(last_kf, &pts_last, NULL);
+    if (pts_first == MP_NOPTS_VALUE || pts_last == MP_NOPTS_VALUE ||
+        pts_last <= pts_first)
+        return;
+
+    // Never exceed the configured step. With very long keyframe distances,
+    // this seeks back repeatedly by the configured step, as before.
+    double gop = (pts_last - pts_first) / (num_kf - 1);
+    double min_step = gop * (total + 1);
+    ds->back_seek_step = MPMIN(min_step * BACK_SEEK_RANGES,
+                               ds->in->opts->back_seek_size);
+}
+
 // Search for a packet to resume demuxing from.
 // The implementation of this function is quite awkward, because the packet
 // queue is a singly linked list without back links, while it needs to search
@@ -1450,10 +1847,13 @@ static void find_backward_restart_pos(struct demux_stream *ds)
     // (Normally, we'd just iterate backwards, but no back links.)
     int num_kf = 0;
     struct demux_packet *pre_1 = NULL; // idiotic "optimization" for total=1
+    struct demux_packet *first_kf = NULL;
     for (struct demux_packet *dp = first; dp != back_restart; dp = dp->next) {
         if (dp->keyframe) {
             num_kf++;
             pre_1 = dp;
+            if (!first_kf)
+                first_kf = dp;
         }
     }
 
@@ -1514,6 +1914,8 @@ static void find_backward_restart_pos(struct demux_stream *ds)
     if (seek_pts != MP_NOPTS_VALUE)
         ds->back_seek_pos = seek_pts;
 
+    update_back_seek_step(ds, first_kf, pre_1, num_kf, total);
+
     // For next backward adjust action.
     struct demux_packet *restart_pkt = NULL;
     int kf_pos = 0;
@@ -1571,7 +1973,13 @@ resume_earlier:
             in->back_any_need_recheck = true;
             pthread_cond_signal(&in->wakeup);
         } else {
-            ds->back_seek_pos -= in->opts->back_seek_size;
+            // Not enough keyframes in the range read by the last seek. Grow
+            // the step, up to the configured one.
+            double max_step = in->opts->back_seek_size;
+            double step = ds->back_seek_step > 0 ? ds->back_seek_step : max_step;
+            ds->back_seek_pos -= step;
+            if (step < max_step)
+                ds->back_seek_step = MPMIN(step * 2, max_step);
             in->need_back_seek = true;
         }
     }
@@ -1620,7 +2028,9 @@ static void add_index_entry(struct demux_queue *queue, struct demux_packet *dp,
 
     if (queue->num_index > 0) {
         struct index_entry *last = &QUEUE_INDEX_ENTRY(queue, queue->num_index - 1);
-        if (pts - last->pts < INDEX_STEP_SIZE)
+        // Don't index packets whose timestamps are within the last index
+        // entry by this amount of time (it's better to seek them manually).
+        if (pts - last->pts < in->index_step)
             return;
     }
 
@@ -1638,12 +2048,15 @@ static void add_index_entry(struct demux_queue *queue, struct demux_packet *dp,
             queue->index[n] = queue->index[n - queue->index_size];
         in->total_bytes +=
             (new_size - queue->index_size) * sizeof(queue->index[0]);
+        in->index_bytes +=
+            (new_size - queue->index_size) * sizeof(queue->index[0]);
         queue->index_size = new_size;
     }
 
     assert(queue->num_index < queue->index_size);
 
     queue->num_index += 1;
+    in->index_entries += 1;
 
     QUEUE_INDEX_ENTRY(queue, queue->num_index - 1) = (struct index_entry){
         .pts = pts,
@@ -2174,12 +2587,25 @@ static bool lazy_stream_needs_wait(struct demux_stream *ds)
             in->demux_ts <= ds->force_read_until);
 }
 
+// Report the cache size to the memory accounting, and fetch how much of the
+// --memory-budget the cache may use. Under pressure from other memory users,
+// the backward cache is pruned and forward prefetching stops.
+static void update_memory_allowance(struct demux_internal *in)
+{
+    mp_memory_report(in->mem, in->total_bytes);
+    in->mem_allowance = mp_memory_get_allowance(in->mem);
+    if (in->num_ranges && (int64_t)in->total_bytes > in->mem_allowance)
+        prune_old_packets(in);
+}
+
 // Returns true if there was "progress" (lock was released temporarily).
 static bool read_packet(struct demux_internal *in)
 {
     bool was_reading = in->reading;
     in->reading = false;
 
+    update_memory_allowance(in);
+
     if (!was_reading || in->blocked || demux_cancel_test(in->d_thread))
         return false;
 
@@ -2212,6 +2638,10 @@ static bool read_packet(struct demux_internal *in)
 
     MP_TRACE(in, "bytes=%zd, read_more=%d prefetch_more=%d, refresh_more=%d\n",
              (size_t)total_fw_bytes, read_more, prefetch_more, refresh_more);
+    // Only prefetching is stopped when over the memory budget; packets that
+    // are needed for playback are still read.
+    if (!read_more && total_fw_bytes >= (uint64_t)in->mem_allowance)
+        return false;
     if (total_fw_bytes >= in->max_bytes) {
         // if we hit the limit just by prefetching, simply stop prefetching
         if (!read_more)
@@ -2300,9 +2730,9 @@ static void prune_old_packets(struct demux_internal *in)
 {
     assert(in->current_range == in->ranges[in->num_ranges - 1]);
 
-    // It's not clear what the ideal way to prune old packets is. For now, we
-    // prune the oldest packet runs, as long as the total cache amount is too
-    // big.
+    // It's not clear what the ideal way to prune old packets is. By default,
+    // we prune the oldest packet runs, as long as the total cache amount is
+    // too big. --demuxer-cache-eviction can select another range to prune.
     while (1) {
         uint64_t fw_bytes = 0;
         for (int n = 0; n < in->num_streams; n++) {
@@ -2314,11 +2744,13 @@ static void prune_old_packets(struct demux_internal *in)
         // Still leave 1 byte free, so the read_packet logic doesn't get stuck.
         if (max_avail && in->max_bytes > (fw_bytes + 1) && in->opts->donate_fw)
             max_avail += in->max_bytes - (fw_bytes + 1);
+        // Leave room for other users of the global memory budget.
+        uint64_t mem_avail = in->mem_allowance;
+        max_avail = MPMIN(max_avail, mem_avail > fw_bytes ? mem_avail - fw_bytes : 0);
         if (in->total_bytes - fw_bytes <= max_avail)
             break;
 
-        // (Start from least recently used range.)
-        struct demux_cached_range *range = in->ranges[0];
+        struct demux_cached_range *range = find_prune_range(in);
         double earliest_ts = MP_NOPTS_VALUE;
         struct demux_stream *earliest_stream = NULL;
 
@@ -2451,21 +2883,125 @@ static void execute_seek(struct demux_internal *in)
 
     MP_VERBOSE(in, "execute seek (to %f flags %d)\n", pts, flags);
 
+    // (Only this thread resets the stream's statistics counters.)
+    struct stream *stream = in->d_thread->stream;
+    int64_t stream_seeks = stream ? stream->total_stream_seeks : 0;
+    int64_t start = mp_time_us();
+
     if (in->d_thread->desc->seek)
         in->d_thread->desc->seek(in->d_thread, pts, flags);
 
+    int64_t time = mp_time_us() - start;
+    if (stream)
+        stream_seeks = stream->total_stream_seeks - stream_seeks;
+
     MP_VERBOSE(in, "seek done\n");
 
     pthread_mutex_lock(&in->lock);
 
+    in->last_seek.low_level_time = time;
+    in->last_seek.stream_seeks = stream_seeks;
+
     in->seeking_in_progress = MP_NOPTS_VALUE;
 }
 
+// Inverse of the standard normal CDF for p in (0, 0.5], negated (i.e. returns
+// the z with P(X > z) = p). Abramowitz & Stegun 26.2.23, error < 4.5e-4.
+static double normal_quantile_upper(double p)
+{
+    double t = sqrt(-2 * log(p));
+    return t - (2.515517 + 0.802853 * t + 0.010328 * t * t) /
+               (1 + 1.432788 * t + 0.189269 * t * t + 0.001308 * t * t * t);
+}
+
+// --demuxer-readahead-adaptive: pick the readahead duration between
+// --demuxer-readahead-secs and --demuxer-readahead-max-secs. If a pessimistic
+// estimate of the link throughput (only exceeded downwards with the probability
+// given by --demuxer-readahead-underrun, assuming a normal distribution) is
+// below the media bitrate, the buffer would drain, and the target is raised
+// proportionally to the deficit. On fast links it stays at the minimum.
+static void update_readahead_target(struct demux_internal *in)
+{
+    struct demux_opts *opts = in->opts;
+    double min_secs = opts->min_secs;
+    double max_secs = MPMAX(min_secs, opts->readahead_max_secs);
+
+    double media_rate = 0;
+    for (int n = 0; n < in->num_streams; n++) {
+        struct demux_stream *ds = in->streams[n]->ds;
+        if (ds->eager && ds->bitrate > 0)
+            media_rate += ds->bitrate;
+    }
+
+    double target = in->readahead_target;
+    if (media_rate > 0 && in->link_rate_mean > 0) {
+        double z = normal_quantile_upper(opts->readahead_underrun);
+        double low = in->link_rate_mean - z * sqrt(in->link_rate_var);
+        double deficit = MPCLAMP(1.0 - low / media_rate, 0.0, 1.0);
+        target = min_secs + (max_secs - min_secs) * deficit;
+    }
+    in->readahead_target = MPCLAMP(target, min_secs, max_secs);
+}
+
+// Add a throughput sample. The time spent in stream reads is used instead of
+// realtime, so that idle periods (buffer full) don't count as a slow link.
+static void add_link_rate_sample(struct demux_internal *in, uint64_t bytes)
+{
+    int64_t read_time = in->stream_read_time - in->link_rate_read_time;
+    in->link_rate_read_time = in->stream_read_time;
+    if (read_time < MP_SECOND_US / 20 || !bytes)
+        return; // too little data for a meaningful sample
+
+    double rate = bytes / (read_time / (double)MP_SECOND_US);
+    if (in->link_rate_mean <= 0) {
+        in->link_rate_mean = rate;
+        in->link_rate_var = 0;
+    } else {
+        // Exponentially weighted mean and variance.
+        const double alpha = 0.2;
+        double d = rate - in->link_rate_mean;
+        in->link_rate_mean += alpha * d;
+        in->link_rate_var = (1 - alpha) * (in->link_rate_var + alpha * d * d);
+    }
+}
+
+// Remove the packets the reader has passed from the current range. Used when
+// the seekable cache gets enabled: without it, their data may have been moved
+// to the reader (see read_packet_from_cache()).
+static void drop_read_packets(struct demux_internal *in)
+{
+    struct demux_cached_range *range = in->current_range;
+    if (!range)
+        return;
+
+    for (int n = 0; n < range->num_streams; n++) {
+        struct demux_queue *queue = range->streams[n];
+        struct demux_stream *ds = queue->ds;
+
+        while (queue->head && queue->head != ds->reader_head)
+            remove_head_packet(queue);
+
+        queue->keyframe_first = queue->head;
+        while (queue->keyframe_first && !queue->keyframe_first->keyframe)
+            queue->keyframe_first = queue->keyframe_first->next;
+
+        double kf_min;
+        compute_keyframe_times(queue->keyframe_first, &kf_min, NULL);
+        queue->seek_start = kf_min;
+        if (queue->seek_start != MP_NOPTS_VALUE)
+            queue->seek_start += ds->sh->seek_preroll;
+    }
+
+    update_seek_ranges(range);
+}
+
 static void update_opts(struct demux_internal *in)
 {
     struct demux_opts *opts = in->opts;
+    bool was_seekable = in->seekable_cache;
 
     in->min_secs = opts->min_secs;
+    in->index_step = opts->index_step;
     in->max_bytes = opts->max_bytes;
     in->max_bytes_bw = opts->max_bytes_bw;
 
@@ -2480,6 +3016,10 @@ static void update_opts(struct demux_internal *in)
         if (seekable < 0)
             seekable = 1;
     }
+    if (opts->readahead_adaptive) {
+        update_readahead_target(in);
+        in->min_secs = in->readahead_target;
+    }
     in->seekable_cache = seekable == 1;
     in->using_network_cache_opts = is_streaming && use_cache;
 
@@ -2494,8 +3034,11 @@ static void update_opts(struct demux_internal *in)
         in->using_network_cache_opts = false;
     }
 
+    if (in->seekable_cache && !was_seekable)
+        drop_read_packets(in);
+
     if (in->seekable_cache && opts->disk_cache && !in->cache) {
-        in->cache = demux_cache_create(in->global, in->log);
+        in->cache = demux_cache_create(in->global, in->log, in->cache_key);
         if (!in->cache)
             MP_ERR(in, "Failed to create file cache.\n");
     }
@@ -2525,6 +3068,61 @@ static void update_opts(struct demux_internal *in)
     free_empty_cached_ranges(in);
 }
 
+// Amount of packet data compressed per compress_cold_packets() call. This
+// bounds the time the lock is held.
+#define COMPRESS_BATCH_BYTES (256 * 1024)
+
+// Compress some packets of cached ranges other than the current range. These
+// are touched only when a seek goes back to them, and are decompressed when
+// read. Returns whether there was anything to do.
+static bool compress_cold_packets(struct demux_internal *in)
+{
+    if (!in->opts->compress_cache)
+        return false;
+
+    size_t budget = COMPRESS_BATCH_BYTES;
+    bool work = false;
+
+    // (The current range is always the last one.)
+    for (int n = 0; n < in->num_ranges - 1 && budget; n++) {
+        struct demux_cached_range *range = in->ranges[n];
+
+        for (int i = 0; i < range->num_streams && budget; i++) {
+            struct demux_queue *queue = range->streams[i];
+            if (queue->compress_done)
+                continue;
+
+            work = true;
+
+            // Compressing changes the packet sizes, so cum_pos needs to be
+            // adjusted for the rest of the queue.
+            uint64_t delta = 0;
+            queue->compress_done = true;
+            struct demux_packet *dp = queue->compress_next;
+            for (dp = dp ? dp : queue->head; dp; dp = dp->next) {
+                uint64_t end = dp->next ? dp->next->cum_pos : queue->tail_cum_pos;
+                uint64_t size = end - dp->cum_pos;
+                dp->cum_pos -= delta;
+                if (budget) {
+                    budget -= MPMIN(budget, dp->len);
+                    if (demux_packet_compress(dp))
+                        delta += size - demux_packet_estimate_total_size(dp);
+                    if (!budget) {
+                        queue->compress_next = dp->next;
+                        queue->compress_done = !dp->next;
+                    }
+                } else if (!delta) {
+                    break;
+                }
+            }
+            queue->tail_cum_pos -= delta;
+            in->total_bytes -= delta;
+        }
+    }
+
+    return work;
+}
+
 // Make demuxing progress. Return whether progress was made.
 static bool thread_work(struct demux_internal *in)
 {
@@ -2548,6 +3146,8 @@ static bool thread_work(struct demux_internal *in)
     }
     if (read_packet(in))
         return true; // read_packet unlocked, so recheck conditions
+    if (compress_cold_packets(in))
+        return true;
     if (mp_time_us() >= in->next_cache_update) {
         update_cache(in);
         return true;
@@ -2559,6 +3159,7 @@ static void *demux_thread(void *pctx)
 {
     struct demux_internal *in = pctx;
     mpthread_set_name("demux");
+    mpthread_set_class(in->global, in->log, "demux");
     pthread_mutex_lock(&in->lock);
 
     stats_register_thread_cputime(in->stats, "thread");
@@ -2602,8 +3203,9 @@ static struct demux_packet *advance_reader_head(struct demux_stream *ds)
 }
 
 // Return a newly allocated new packet. The pkt parameter may be either a
-// in-memory packet (then a new reference is made), or a reference to
-// packet in the disk cache (then the packet is read from disk).
+// in-memory packet (then a new reference is made, or its data is moved if it
+// can't be read again), or a reference to packet in the disk cache (then the
+// packet is read from disk).
 static struct demux_packet *read_packet_from_cache(struct demux_internal *in,
                                                    struct demux_packet *pkt)
 {
@@ -2619,9 +3221,19 @@ static struct demux_packet *read_packet_from_cache(struct demux_internal *in,
         } else {
             MP_ERR(in, "Failed to retrieve packet from cache.\n");
         }
+    } else if (pkt->is_compressed) {
+        pkt = demux_packet_decompress(pkt);
+        if (!pkt)
+            MP_ERR(in, "Failed to decompress cached packet.\n");
     } else {
         // The returned packet is mutated etc. and will be owned by the user.
-        pkt = demux_copy_packet(pkt);
+        // Without seekable cache and backward demuxing, the reader never
+        // goes back to packets it has read, so the data can be moved. The
+        // queued packet stays as empty entry for byte accounting and pruning.
+        struct demux_packet *moved = NULL;
+        if (!in->seekable_cache && !in->back_demuxing)
+            moved = demux_move_packet(pkt);
+        pkt = moved ? moved : demux_copy_packet(pkt);
     }
 
     return pkt;
@@ -3073,8 +3685,8 @@ void demux_metadata_changed(demuxer_t *demuxer)
     pthread_mutex_unlock(&in->lock);
 }
 
-// Called locked, with user demuxer.
-static void update_final_metadata(demuxer_t *demuxer, struct timed_metadata *tm)
+// Called locked, with user demuxer. Returns whether demuxer->metadata changed.
+static bool update_final_metadata(demuxer_t *demuxer, struct timed_metadata *tm)
 {
     assert(demuxer == demuxer->in->d_user);
     struct demux_internal *in = demuxer->in;
@@ -3112,8 +3724,7 @@ static void update_final_metadata(demuxer_t *demuxer, struct timed_metadata *tm)
     if (tm && !tm->from_stream)
         dyn_tags = tm->tags;
 
-    if (dyn_tags)
-        mp_tags_merge(demuxer->metadata, dyn_tags);
+    return dyn_tags && mp_tags_merge(demuxer->metadata, dyn_tags);
 }
 
 static struct timed_metadata *lookup_timed_metadata(struct demux_internal *in,
@@ -3161,9 +3772,12 @@ void demux_update(demuxer_t *demuxer, double pts)
     struct timed_metadata *prev = lookup_timed_metadata(in, in->last_playback_pts);
     struct timed_metadata *cur = lookup_timed_metadata(in, pts);
     if (prev != cur || in->force_metadata_update) {
+        // Timed metadata often repeats the same tags (e.g. with every ICY
+        // packet); don't make the player re-process them in this case.
+        bool force = in->force_metadata_update;
         in->force_metadata_update = false;
-        update_final_metadata(demuxer, cur);
-        demuxer->events |= DEMUX_EVENT_METADATA;
+        if (update_final_metadata(demuxer, cur) || force)
+            demuxer->events |= DEMUX_EVENT_METADATA;
     }
 
     in->last_playback_pts = pts;
@@ -3255,6 +3869,26 @@ struct parent_stream_info {
     char *filename;
 };
 
+// Return a string that identifies the source and the way it was demuxed, or
+// NULL if this is not possible. Sources without known size are not identified,
+// because they could be anything (like live streams).
+static char *get_cache_key(struct demux_internal *in)
+{
+    struct demuxer *demuxer = in->d_thread;
+    int64_t size = demuxer->stream ? stream_get_size(demuxer->stream) : -1;
+    if (!demuxer->filename || size < 0)
+        return NULL;
+
+    char *key = talloc_asprintf(in, "%s\n%"PRId64"\n%s\n", demuxer->filename,
+                                size, demuxer->desc->name);
+    for (int n = 0; n < in->num_streams; n++) {
+        struct sh_stream *sh = in->streams[n];
+        key = talloc_asprintf_append(key, "%s:%s\n", stream_type_name(sh->type),
+                                     sh->codec->codec);
+    }
+    return key;
+}
+
 static struct demuxer *open_given_type(struct mpv_global *global,
                                        struct mp_log *log,
                                        const struct demuxer_desc *desc,
@@ -3287,12 +3921,15 @@ static struct demuxer *open_given_type(struct mpv_global *global,
         .events = DEMUX_EVENT_ALL,
         .duration = -1,
     };
+    demuxer->packet_pool = demux_packet_pool_create(demuxer, global);
 
     struct demux_internal *in = demuxer->in = talloc_ptrtype(demuxer, in);
     *in = (struct demux_internal){
         .global = global,
         .log = demuxer->log,
         .stats = stats_ctx_create(in, global, "demuxer"),
+        .mem = mp_memory_user_create(in, global, "demuxer-cache"),
+        .mem_allowance = INT64_MAX,
         .can_cache = params && params->is_top_level,
         .can_record = params && params->stream_record,
         .opts = opts,
@@ -3365,6 +4002,9 @@ static struct demuxer *open_given_type(struct mpv_global *global,
 
         switch_to_fresh_cache_range(in);
 
+        if (in->can_cache)
+            in->cache_key = get_cache_key(in);
+
         update_opts(in);
 
         demux_update(demuxer, MP_NOPTS_VALUE);
@@ -3545,6 +4185,10 @@ static void switch_current_range(struct demux_internal *in,
             // Remove all packets which cannot be involved in seeking.
             while (queue->head && !queue->head->keyframe)
                 remove_head_packet(queue);
+
+            // The range is cold now; let compress_cold_packets() see it.
+            queue->compress_next = NULL;
+            queue->compress_done = false;
         }
 
         // Exclude weird corner cases that break resuming.
@@ -3643,6 +4287,54 @@ static struct demux_packet *find_seek_target(struct demux_queue *queue,
     return target;
 }
 
+// Effective seek range bounds, with BOF/EOF ranges extending to infinity.
+static double range_lookup_start(struct demux_cached_range *r)
+{
+    return r->is_bof ? -INFINITY : r->seek_start;
+}
+
+static double range_lookup_end(struct demux_cached_range *r)
+{
+    return r->is_eof ? INFINITY : r->seek_end;
+}
+
+static int range_lookup_compare(const void *p1, const void *p2)
+{
+    double s1 = range_lookup_start(*(struct demux_cached_range **)p1);
+    double s2 = range_lookup_start(*(struct demux_cached_range **)p2);
+
+    if (s1 == s2)
+        return 0;
+    return s1 < s2 ? -1 : 1;
+}
+
+static void update_sorted_ranges(struct demux_internal *in)
+{
+    if (in->sorted_ranges_valid)
+        return;
+
+    in->num_sorted_ranges = 0;
+    for (int n = 0; n < in->num_ranges; n++) {
+        struct demux_cached_range *r = in->ranges[n];
+        if (r->seek_start != MP_NOPTS_VALUE) {
+            MP_TARRAY_APPEND(in, in->sorted_ranges, in->num_sorted_ranges, r);
+            MP_VERBOSE(in, "cached range %d: %f <-> %f (bof=%d, eof=%d)\n",
+                       n, r->seek_start, r->seek_end, r->is_bof, r->is_eof);
+        }
+    }
+    qsort(in->sorted_ranges, in->num_sorted_ranges, sizeof(in->sorted_ranges[0]),
+          range_lookup_compare);
+
+    MP_RESIZE_ARRAY(in, in->sorted_ends, MPMAX(in->num_sorted_ranges, 1));
+    double end = -INFINITY;
+    for (int n = 0; n < in->num_sorted_ranges; n++) {
+        end = MPMAX(end, range_lookup_end(in->sorted_ranges[n]));
+        in->sorted_ends[n] = end;
+    }
+
+    in->sorted_ranges_valid = true;
+}
+
 // Return a cache range for the given pts/flags, or NULL if none available.
 // must be called locked
 static struct demux_cached_range *find_cache_seek_range(struct demux_internal *in,
@@ -3655,25 +4347,31 @@ static struct demux_cached_range *find_cache_seek_range(struct demux_internal *i
     if ((flags & SEEK_FACTOR) || !in->seekable_cache)
         return NULL;
 
-    struct demux_cached_range *res = NULL;
+    update_sorted_ranges(in);
 
-    for (int n = 0; n < in->num_ranges; n++) {
-        struct demux_cached_range *r = in->ranges[n];
-        if (r->seek_start != MP_NOPTS_VALUE) {
-            MP_VERBOSE(in, "cached range %d: %f <-> %f (bof=%d, eof=%d)\n",
-                       n, r->seek_start, r->seek_end, r->is_bof, r->is_eof);
+    // Find the first range starting after pts; all candidates are before it.
+    int a = 0, b = in->num_sorted_ranges;
+    while (a < b) {
+        int m = a + (b - a) / 2;
+        if (range_lookup_start(in->sorted_ranges[m]) <= pts) {
+            a = m + 1;
+        } else {
+            b = m;
+        }
+    }
 
-            if ((pts >= r->seek_start || r->is_bof) &&
-                (pts <= r->seek_end || r->is_eof))
-            {
-                MP_VERBOSE(in, "...using this range for in-cache seek.\n");
-                res = r;
-                break;
-            }
+    // Ranges can overlap (the current range is joined lazily), so walk back
+    // while any of the remaining ranges could still contain pts.
+    for (int n = a - 1; n >= 0 && in->sorted_ends[n] >= pts; n--) {
+        struct demux_cached_range *r = in->sorted_ranges[n];
+        if (range_lookup_end(r) >= pts) {
+            MP_VERBOSE(in, "using range %f <-> %f for in-cache seek.\n",
+                       r->seek_start, r->seek_end);
+            return r;
         }
     }
 
-    return res;
+    return NULL;
 }
 
 // Adjust the seek target to the found video key frames. Otherwise the
@@ -3808,6 +4506,8 @@ static bool queue_seek(struct demux_internal *in, double seek_pts, int flags,
     if (seek_pts == MP_NOPTS_VALUE)
         return false;
 
+    int64_t start = mp_time_us();
+
     MP_VERBOSE(in, "queuing seek to %f%s\n", seek_pts,
                in->seeking ? " (cascade)" : "");
 
@@ -3823,6 +4523,12 @@ static bool queue_seek(struct demux_internal *in, double seek_pts, int flags,
     bool block = flags & SEEK_BLOCK;
     flags &= ~(unsigned)SEEK_BLOCK;
 
+    if (!(flags & SEEK_FACTOR)) {
+        in->seek_history[in->seek_history_pos] = seek_pts;
+        in->seek_history_pos = (in->seek_history_pos + 1) % SEEK_HISTORY_SIZE;
+        in->num_seek_history = MPMIN(in->num_seek_history + 1, SEEK_HISTORY_SIZE);
+    }
+
     struct demux_cached_range *cache_target =
         find_cache_seek_range(in, seek_pts, flags);
 
@@ -3868,6 +4574,12 @@ static bool queue_seek(struct demux_internal *in, double seek_pts, int flags,
         wakeup_ds(ds);
     }
 
+    in->last_seek = (struct demux_seek_timing){
+        .cached = !!cache_target,
+        .lookup_time = mp_time_us() - start,
+        .low_level_time = -1,
+    };
+
     if (!in->threading && in->seeking)
         execute_seek(in);
 
@@ -4031,6 +4743,18 @@ bool demux_stream_is_selected(struct sh_stream *stream)
     return r;
 }
 
+// Return the PTS of the packet the next read on this stream returns, if it is
+// already in the cache (e.g. right after a cached seek). Otherwise NOPTS.
+double demux_get_reader_head_pts(struct sh_stream *stream)
+{
+    struct demux_internal *in = stream->ds->in;
+    pthread_mutex_lock(&in->lock);
+    struct demux_packet *dp = stream->ds->reader_head;
+    double pts = dp ? MP_ADD_PTS(dp->pts, in->ts_offset) : MP_NOPTS_VALUE;
+    pthread_mutex_unlock(&in->lock);
+    return pts;
+}
+
 void demux_set_stream_wakeup_cb(struct sh_stream *sh,
                                 void (*cb)(void *ctx), void *ctx)
 {
@@ -4124,6 +4848,8 @@ static void update_bytes_read(struct demux_internal *in)
         stream->total_unbuffered_read_bytes = 0;
         new_seeks += stream->total_stream_seeks;
         stream->total_stream_seeks = 0;
+        in->stream_read_time += stream->total_read_time;
+        stream->total_read_time = 0;
     }
 
     in->cache_unbuffered_read_bytes += new;
@@ -4146,14 +4872,18 @@ static void update_cache(struct demux_internal *in)
 
     int64_t stream_size = -1;
     struct mp_tags *stream_metadata = NULL;
+    struct stream_segments stream_segments = {0};
     if (stream) {
         if (do_update)
             stream_size = stream_get_size(stream);
         stream_control(stream, STREAM_CTRL_GET_METADATA, &stream_metadata);
+        stream_control(stream, STREAM_CTRL_GET_SEGMENTS, &stream_segments);
     }
 
     pthread_mutex_lock(&in->lock);
 
+    in->stream_segments = stream_segments;
+
     update_bytes_read(in);
 
     if (do_update)
@@ -4173,6 +4903,15 @@ static void update_cache(struct demux_internal *in)
         in->bytes_per_second = 0.5 * in->speed_query_prev_sample +
                                0.5 * speed;
         in->speed_query_prev_sample = speed;
+        add_link_rate_sample(in, bytes);
+        if (in->opts->readahead_adaptive && in->can_cache) {
+            double prev = in->readahead_target;
+            update_readahead_target(in);
+            in->min_secs = in->readahead_target;
+            if (fabs(prev - in->readahead_target) >= 1)
+                MP_VERBOSE(in, "Readahead target: %.1f s\n",
+                           in->readahead_target);
+        }
     }
     // The idea is to update as long as there is "activity".
     if (in->bytes_per_second)
@@ -4485,6 +5224,10 @@ void demux_get_reader_state(struct demuxer *demuxer, struct demux_reader_state *
 
     pthread_mutex_lock(&in->lock);
 
+    // (Without thread, the stream can be accessed from here.)
+    if (!in->threading)
+        update_bytes_read(in);
+
     *r = (struct demux_reader_state){
         .eof = in->eof,
         .ts_reader = MP_NOPTS_VALUE,
@@ -4495,8 +5238,15 @@ void demux_get_reader_state(struct demuxer *demuxer, struct demux_reader_state *
         .low_level_seeks = in->low_level_seeks,
         .ts_last = in->demux_ts,
         .bytes_per_second = in->bytes_per_second,
+        .readahead_target = in->min_secs,
         .byte_level_seeks = in->byte_level_seeks,
         .file_cache_bytes = in->cache ? demux_cache_get_size(in->cache) : -1,
+        .file_cache_queued_bytes =
+            in->cache ? demux_cache_get_queued_size(in->cache) : -1,
+        .stream_read_time = in->stream_read_time,
+        .index_entries = in->index_entries,
+        .index_bytes = in->index_bytes,
+        .last_seek = in->last_seek,
     };
     bool any_packets = false;
     for (int n = 0; n < in->num_streams; n++) {
@@ -4529,6 +5279,17 @@ void demux_get_reader_state(struct demuxer *demuxer, struct demux_reader_state *
             r->eof_cached |= range->is_eof;
         }
     }
+    int num_segments = MPMIN(in->stream_segments.num_segments,
+                             MAX_STREAM_SEGMENTS);
+    for (int n = 0; n < num_segments; n++) {
+        struct stream_segment *seg = &in->stream_segments.segments[n];
+        r->stream_segments[r->num_stream_segments++] =
+            (struct demux_stream_segment){
+                .start = seg->start,
+                .end = seg->end,
+                .received = seg->received,
+            };
+    }
 
     pthread_mutex_unlock(&in->lock);
 }
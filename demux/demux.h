@@ -36,6 +36,22 @@ struct demux_seek_range {
     double start, end;
 };
 
+#define MAX_STREAM_SEGMENTS 32
+
+struct demux_stream_segment {
+    int64_t start, end;     // byte range being fetched
+    int64_t received;       // bytes of it received so far
+};
+
+// Breakdown of the last seek. Times in microseconds.
+struct demux_seek_timing {
+    bool cached;            // served from the packet cache
+    int64_t lookup_time;    // cache range and index lookup, reader reset
+    int64_t low_level_time; // demuxer seek, incl. stream seeks and reconnects;
+                            // -1 if none was needed, or still in progress
+    int64_t stream_seeks;   // byte stream seeks done by the low level seek
+};
+
 struct demux_reader_state {
     bool eof, underrun, idle;
     bool bof_cached, eof_cached;
@@ -45,15 +61,25 @@ struct demux_reader_state {
     int64_t total_bytes;
     int64_t fw_bytes;
     int64_t file_cache_bytes;
+    int64_t file_cache_queued_bytes;
     double seeking; // current low level seek target, or NOPTS
     int low_level_seeks; // number of started low level seeks
     uint64_t byte_level_seeks; // number of byte stream level seeks
     double ts_last; // approx. timestamp of demuxer position
     uint64_t bytes_per_second; // low level statistics
+    double readahead_target; // current readahead duration goal (seconds)
     // Positions that can be seeked to without incurring the latency of a low
     // level seek.
     int num_seek_ranges;
     struct demux_seek_range seek_ranges[MAX_SEEK_RANGES];
+    // Byte ranges in flight on parallel network connections (--http-connections).
+    int num_stream_segments;
+    struct demux_stream_segment stream_segments[MAX_STREAM_SEGMENTS];
+    // Statistics for benchmarking.
+    int64_t stream_read_time; // total time in low level stream reads (us)
+    int64_t index_entries; // total number of seek index entries added
+    int64_t index_bytes; // currently allocated seek index memory
+    struct demux_seek_timing last_seek;
 };
 
 #define SEEK_FACTOR   (1 << 1)      // argument is in range [0,1]
@@ -227,6 +253,8 @@ typedef struct demuxer {
 
     void *priv;   // demuxer-specific internal data
     struct mpv_global *global;
+    // For demux_packet_pool_get_buffer(); owned by demux.c.
+    struct demux_packet_pool *packet_pool;
     struct mp_log *log, *glog;
     struct demuxer_params *params;
 
@@ -256,6 +284,7 @@ int demux_read_packet_async(struct sh_stream *sh, struct demux_packet **out_pkt)
 int demux_read_packet_async_until(struct sh_stream *sh, double min_pts,
                                   struct demux_packet **out_pkt);
 bool demux_stream_is_selected(struct sh_stream *stream);
+double demux_get_reader_head_pts(struct sh_stream *stream);
 void demux_set_stream_wakeup_cb(struct sh_stream *sh,
                                 void (*cb)(void *ctx), void *ctx);
 struct demux_packet *demux_read_any_packet(struct demuxer *demuxer);
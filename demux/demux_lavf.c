@@ -24,6 +24,7 @@
 #include <strings.h>
 #include <errno.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include "config.h"
 
@@ -86,6 +87,7 @@ struct demux_lavf_opts {
     int rtsp_transport;
     int linearize_ts;
     int propagate_opts;
+    int probe_cache;
 };
 
 const struct m_sub_options demux_lavf_conf = {
@@ -113,6 +115,7 @@ const struct m_sub_options demux_lavf_conf = {
         {"demuxer-lavf-linearize-timestamps", OPT_CHOICE(linearize_ts,
             {"no", 0}, {"auto", -1}, {"yes", 1})},
         {"demuxer-lavf-propagate-opts", OPT_FLAG(propagate_opts)},
+        {"demuxer-lavf-probe-cache", OPT_FLAG(probe_cache)},
         {0}
     },
     .size = sizeof(struct demux_lavf_opts),
@@ -251,6 +254,10 @@ typedef struct lavf_priv {
 
     int retry_counter;
 
+    // Program whose streams are selected by default (if has_program_id).
+    bool has_program_id;
+    int program_id;
+
     AVDictionary *av_opts;
 
     // Proxying nested streams.
@@ -647,6 +654,23 @@ static int dict_get_decimal(AVDictionary *dict, const char *entry, int def)
     return def;
 }
 
+// Return whether stream i is part of the given program, or -1 if there is no
+// such program.
+static int stream_in_program(AVFormatContext *avfc, int program_id, int i)
+{
+    for (int n = 0; n < avfc->nb_programs; n++) {
+        AVProgram *prog = avfc->programs[n];
+        if (prog->id != program_id)
+            continue;
+        for (unsigned int s = 0; s < prog->nb_stream_indexes; s++) {
+            if (prog->stream_index[s] == i)
+                return 1;
+        }
+        return 0;
+    }
+    return -1;
+}
+
 static void handle_new_stream(demuxer_t *demuxer, int i)
 {
     lavf_priv_t *priv = demuxer->priv;
@@ -807,6 +831,11 @@ static void handle_new_stream(demuxer_t *demuxer, int i)
 
         if (st->disposition & AV_DISPOSITION_DEFAULT)
             sh->default_track = true;
+        if (priv->has_program_id) {
+            int in_program = stream_in_program(avfc, priv->program_id, i);
+            if (in_program >= 0)
+                sh->default_track = in_program;
+        }
         if (st->disposition & AV_DISPOSITION_FORCED)
             sh->forced_track = true;
         if (st->disposition & AV_DISPOSITION_DEPENDENT)
@@ -940,6 +969,150 @@ static void nested_io_close(struct AVFormatContext *s, AVIOContext *pb)
     priv->default_io_close(s, pb);
 }
 
+// Results of avformat_find_stream_info() for recently opened files, shared by
+// all demuxer instances (--demuxer-lavf-probe-cache).
+struct probe_cache_stream {
+    int id;
+    enum AVMediaType codec_type;
+    enum AVCodecID codec_id;
+    AVCodecParameters *par;
+    AVRational avg_frame_rate;
+    AVRational r_frame_rate;
+};
+
+struct probe_cache_entry {
+    char *key;
+    uint64_t last_used;
+    struct probe_cache_stream *streams;
+    int num_streams;
+};
+
+#define PROBE_CACHE_ENTRIES 32
+
+static pthread_mutex_t probe_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct probe_cache_entry *probe_cache[PROBE_CACHE_ENTRIES];
+static uint64_t probe_cache_counter;
+
+static void destroy_probe_cache_entry(void *ptr)
+{
+    struct probe_cache_entry *e = ptr;
+    for (int n = 0; n < e->num_streams; n++)
+        avcodec_parameters_free(&e->streams[n].par);
+}
+
+static char *get_probe_cache_key(void *ta_ctx, struct demuxer *demuxer)
+{
+    lavf_priv_t *priv = demuxer->priv;
+    return talloc_asprintf(ta_ctx, "%s|%"PRId64"|%s", priv->avif->name,
+                           stream_get_size(priv->stream), priv->filename);
+}
+
+// Whether find_stream_info() would add essential information.
+static bool codecpar_incomplete(AVCodecParameters *par)
+{
+    switch (par->codec_type) {
+    case AVMEDIA_TYPE_VIDEO:
+        return !par->width || !par->height || par->format < 0;
+    case AVMEDIA_TYPE_AUDIO: ;
+#if !HAVE_AV_CHANNEL_LAYOUT
+        int channels = par->channels;
+#else
+        int channels = par->ch_layout.nb_channels;
+#endif
+        return !par->sample_rate || !channels;
+    default:
+        return false;
+    }
+}
+
+// If the streams found by avformat_open_input() are the same as on a previous
+// open, restore the stream parameters from that. Returns false if
+// avformat_find_stream_info() needs to be called.
+static bool restore_probe_cache(struct demuxer *demuxer, const char *key)
+{
+    lavf_priv_t *priv = demuxer->priv;
+    AVFormatContext *avfc = priv->avfc;
+    bool ok = false;
+
+    pthread_mutex_lock(&probe_cache_lock);
+    struct probe_cache_entry *e = NULL;
+    for (int n = 0; n < PROBE_CACHE_ENTRIES; n++) {
+        if (probe_cache[n] && strcmp(probe_cache[n]->key, key) == 0)
+            e = probe_cache[n];
+    }
+    if (!e || e->num_streams != avfc->nb_streams || !e->num_streams)
+        goto done;
+    for (int n = 0; n < e->num_streams; n++) {
+        struct probe_cache_stream *cs = &e->streams[n];
+        AVStream *st = avfc->streams[n];
+        if (cs->id != st->id || cs->codec_type != st->codecpar->codec_type ||
+            cs->codec_id != st->codecpar->codec_id ||
+            cs->codec_id == AV_CODEC_ID_NONE)
+            goto done;
+    }
+    for (int n = 0; n < e->num_streams; n++) {
+        struct probe_cache_stream *cs = &e->streams[n];
+        AVStream *st = avfc->streams[n];
+        if (codecpar_incomplete(st->codecpar) &&
+            avcodec_parameters_copy(st->codecpar, cs->par) < 0)
+            goto done;
+        if (!st->avg_frame_rate.num)
+            st->avg_frame_rate = cs->avg_frame_rate;
+        if (!st->r_frame_rate.num)
+            st->r_frame_rate = cs->r_frame_rate;
+    }
+    e->last_used = ++probe_cache_counter;
+    ok = true;
+done:
+    pthread_mutex_unlock(&probe_cache_lock);
+    if (e && !ok)
+        MP_VERBOSE(demuxer, "Streams changed, ignoring cached probe info.\n");
+    return ok;
+}
+
+static void store_probe_cache(struct demuxer *demuxer, const char *key)
+{
+    lavf_priv_t *priv = demuxer->priv;
+    AVFormatContext *avfc = priv->avfc;
+
+    struct probe_cache_entry *e = talloc_zero(NULL, struct probe_cache_entry);
+    talloc_set_destructor(e, destroy_probe_cache_entry);
+    e->key = talloc_strdup(e, key);
+    for (int n = 0; n < avfc->nb_streams; n++) {
+        AVStream *st = avfc->streams[n];
+        struct probe_cache_stream cs = {
+            .id = st->id,
+            .codec_type = st->codecpar->codec_type,
+            .codec_id = st->codecpar->codec_id,
+            .par = avcodec_parameters_alloc(),
+            .avg_frame_rate = st->avg_frame_rate,
+            .r_frame_rate = st->r_frame_rate,
+        };
+        MP_TARRAY_APPEND(e, e->streams, e->num_streams, cs);
+        if (!cs.par || avcodec_parameters_copy(cs.par, st->codecpar) < 0) {
+            talloc_free(e);
+            return;
+        }
+    }
+
+    pthread_mutex_lock(&probe_cache_lock);
+    // Replace the entry with the same key, or the least recently used one.
+    int slot = 0;
+    for (int n = 0; n < PROBE_CACHE_ENTRIES; n++) {
+        struct probe_cache_entry *cur = probe_cache[n];
+        if (!cur || strcmp(cur->key, key) == 0) {
+            slot = n;
+            break;
+        }
+        if (cur->last_used < probe_cache[slot]->last_used)
+            slot = n;
+    }
+    talloc_free(probe_cache[slot]);
+    e->last_used = ++probe_cache_counter;
+    probe_cache[slot] = e;
+    pthread_mutex_unlock(&probe_cache_lock);
+}
+
 static int demux_open_lavf(demuxer_t *demuxer, enum demux_check check)
 {
     AVFormatContext *avfc;
@@ -1081,6 +1254,15 @@ static int demux_open_lavf(demuxer_t *demuxer, enum demux_check check)
     }
     if (demuxer->params && demuxer->params->skip_lavf_probing)
         probeinfo = false;
+    char *cache_key = NULL;
+    if (probeinfo && lavfdopts->probe_cache) {
+        cache_key = get_probe_cache_key(priv, demuxer);
+        if (restore_probe_cache(demuxer, cache_key)) {
+            MP_VERBOSE(demuxer, "Using cached stream info.\n");
+            probeinfo = false;
+            cache_key = NULL;
+        }
+    }
     if (probeinfo) {
         if (avformat_find_stream_info(avfc, NULL) < 0) {
             MP_ERR(demuxer, "av_find_stream_info() failed\n");
@@ -1089,6 +1271,9 @@ static int demux_open_lavf(demuxer_t *demuxer, enum demux_check check)
 
         MP_VERBOSE(demuxer, "avformat_find_stream_info() finished after %"PRId64
                    " bytes.\n", stream_tell(priv->stream));
+
+        if (cache_key)
+            store_probe_cache(demuxer, cache_key);
     }
 
     for (int i = 0; i < avfc->nb_chapters; i++) {
@@ -1099,6 +1284,10 @@ static int demux_open_lavf(demuxer_t *demuxer, enum demux_check check)
         mp_tags_copy_from_av_dictionary(demuxer->chapters[index].metadata, c->metadata);
     }
 
+    if (priv->stream && stream_control(priv->stream, STREAM_CTRL_GET_PROGRAM_ID,
+                                       &priv->program_id) == STREAM_OK)
+        priv->has_program_id = true;
+
     add_new_streams(demuxer);
 
     mp_tags_copy_from_av_dictionary(demuxer->metadata, avfc->metadata);
@@ -1201,11 +1390,12 @@ static bool demux_lavf_read_packet(struct demuxer *demux,
         return true; // don't signal EOF if skipping a packet
     }
 
-    struct demux_packet *dp = new_demux_packet_from_avpacket(pkt);
+    struct demux_packet *dp = new_demux_packet_from_avpacket_move(pkt);
     if (!dp) {
         av_packet_unref(pkt);
         return true;
     }
+    pkt = dp->avpacket; // the packet properties were moved as well
 
     if (priv->pcm_seek_hack == st && !priv->pcm_seek_hack_packet_size)
         priv->pcm_seek_hack_packet_size = pkt->size;
@@ -1217,7 +1407,6 @@ static bool demux_lavf_read_packet(struct demuxer *demux,
     dp->keyframe = pkt->flags & AV_PKT_FLAG_KEY;
     if (pkt->flags & AV_PKT_FLAG_DISCARD)
         MP_ERR(demux, "Edit lists are not correctly supported (FFmpeg issue).\n");
-    av_packet_unref(pkt);
 
     if (priv->format_hack.clear_filepos)
         dp->pos = -1;
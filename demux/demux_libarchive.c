@@ -31,11 +31,6 @@ struct demux_libarchive_opts {
     int rar_list_all_volumes;
 };
 
-static int cmp_filename(const void *a, const void *b)
-{
-    return mp_natural_sort_cmp(*(char **)a, *(char **)b);
-}
-
 static int open_file(struct demuxer *demuxer, enum demux_check check)
 {
     if (!demuxer->access_references)
@@ -87,8 +82,7 @@ static int open_file(struct demuxer *demuxer, enum demux_check check)
         MP_TARRAY_APPEND(mpa, files, num_files, f);
     }
 
-    if (files)
-        qsort(files, num_files, sizeof(files[0]), cmp_filename);
+    mp_natural_sort_strings(files, num_files);
 
     for (int n = 0; n < num_files; n++)
         playlist_add_file(pl, files[n]);
@@ -16,6 +16,7 @@
  */
 
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <strings.h>
@@ -31,6 +32,7 @@
 #include "options/m_config.h"
 #include "options/path.h"
 #include "misc/ctype.h"
+#include "misc/thread_pool.h"
 
 #include "stream/stream.h"
 #include "demux.h"
@@ -47,8 +49,29 @@ typedef struct mf {
     char **names;
     // optional
     struct stream **streams;
+
+    // for opening files
+    struct mpv_global *global;
+    struct mp_cancel *cancel;
+    int stream_origin;
+
+    // Read-ahead (only if pool is set). reads[] contains consecutive frames,
+    // and the first one is normally curr_frame.
+    struct mp_thread_pool *pool;
+    int readahead;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    struct mf_read **reads;
+    int num_reads;
 } mf_t;
 
+struct mf_read {
+    mf_t *mf;
+    int frame;
+    bstr data;      // result (talloc allocated, data.start is the parent)
+    bool done;      // protected by mf->lock
+};
+
 
 static void mf_add(mf_t *mf, const char *fname)
 {
@@ -223,48 +246,124 @@ static void demux_seek_mf(demuxer_t *demuxer, double seek_pts, int flags)
     mf->curr_frame = MPCLAMP((int)newpos, 0, mf->nr_of_files);
 }
 
-static bool demux_mf_read_packet(struct demuxer *demuxer,
-                                 struct demux_packet **pkt)
+// Return the contents of the given frame's file. May be called from worker
+// threads (in this case mf->streams is not set).
+static bstr read_frame_file(mf_t *mf, int frame)
 {
-    mf_t *mf = demuxer->priv;
-    if (mf->curr_frame >= mf->nr_of_files)
-        return false;
-    bool ok = false;
+    bstr data = {0};
 
     struct stream *entry_stream = NULL;
     if (mf->streams)
-        entry_stream = mf->streams[mf->curr_frame];
+        entry_stream = mf->streams[frame];
     struct stream *stream = entry_stream;
     if (!stream) {
-        char *filename = mf->names[mf->curr_frame];
+        char *filename = mf->names[frame];
         if (filename) {
-            stream = stream_create(filename, demuxer->stream_origin | STREAM_READ,
-                                   demuxer->cancel, demuxer->global);
+            stream = stream_create(filename, mf->stream_origin | STREAM_READ,
+                                   mf->cancel, mf->global);
         }
     }
 
     if (stream) {
         stream_seek(stream, 0);
-        bstr data = stream_read_complete(stream, NULL, MF_MAX_FILE_SIZE);
-        if (data.len) {
-            demux_packet_t *dp = new_demux_packet(data.len);
-            if (dp) {
-                memcpy(dp->buffer, data.start, data.len);
-                dp->pts = mf->curr_frame / mf->sh->codec->fps;
-                dp->keyframe = true;
-                dp->stream = mf->sh->index;
-                *pkt = dp;
-                ok = true;
-            }
-        }
-        talloc_free(data.start);
+        data = stream_read_complete(stream, NULL, MF_MAX_FILE_SIZE);
     }
 
     if (stream && stream != entry_stream)
         free_stream(stream);
 
+    return data;
+}
+
+static void read_worker(void *p)
+{
+    struct mf_read *r = p;
+    mf_t *mf = r->mf;
+
+    bstr data = read_frame_file(mf, r->frame);
+
+    pthread_mutex_lock(&mf->lock);
+    r->data = data;
+    r->done = true;
+    pthread_cond_broadcast(&mf->wakeup);
+    pthread_mutex_unlock(&mf->lock);
+}
+
+static void wait_read(mf_t *mf, struct mf_read *r)
+{
+    pthread_mutex_lock(&mf->lock);
+    while (!r->done)
+        pthread_cond_wait(&mf->wakeup, &mf->lock);
+    pthread_mutex_unlock(&mf->lock);
+}
+
+// Discard all reads (reads in progress can't be aborted, so wait for them).
+static void flush_reads(mf_t *mf)
+{
+    for (int n = 0; n < mf->num_reads; n++) {
+        struct mf_read *r = mf->reads[n];
+        wait_read(mf, r);
+        talloc_free(r->data.start);
+        talloc_free(r);
+    }
+    mf->num_reads = 0;
+}
+
+// Start reads for the frames following curr_frame, up to the read-ahead limit.
+static void queue_reads(mf_t *mf)
+{
+    if (mf->num_reads && mf->reads[0]->frame != mf->curr_frame)
+        flush_reads(mf);
+
+    int next = mf->curr_frame + mf->num_reads;
+    while (next < mf->nr_of_files && mf->num_reads < mf->readahead) {
+        struct mf_read *r = talloc_ptrtype(NULL, r);
+        *r = (struct mf_read){ .mf = mf, .frame = next++ };
+        MP_TARRAY_APPEND(mf, mf->reads, mf->num_reads, r);
+        if (!mp_thread_pool_queue(mf->pool, read_worker, r))
+            read_worker(r);
+    }
+}
+
+static bool demux_mf_read_packet(struct demuxer *demuxer,
+                                 struct demux_packet **pkt)
+{
+    mf_t *mf = demuxer->priv;
+    if (mf->curr_frame >= mf->nr_of_files)
+        return false;
+    bool ok = false;
+
+    bstr data;
+    if (mf->pool) {
+        queue_reads(mf);
+        struct mf_read *r = mf->reads[0];
+        wait_read(mf, r);
+        data = r->data;
+        MP_TARRAY_REMOVE_AT(mf->reads, mf->num_reads, 0);
+        talloc_free(r);
+    } else {
+        data = read_frame_file(mf, mf->curr_frame);
+    }
+
+    if (data.len) {
+        demux_packet_t *dp = new_demux_packet(data.len);
+        if (dp) {
+            memcpy(dp->buffer, data.start, data.len);
+            dp->pts = mf->curr_frame / mf->sh->codec->fps;
+            dp->keyframe = true;
+            dp->stream = mf->sh->index;
+            *pkt = dp;
+            ok = true;
+        }
+    }
+    talloc_free(data.start);
+
     mf->curr_frame++;
 
+    // Keep the workers busy while the packet is decoded.
+    if (mf->pool)
+        queue_reads(mf);
+
     if (!ok)
         MP_ERR(demuxer, "error reading image file\n");
 
@@ -365,10 +464,17 @@ static int demux_open_mf(demuxer_t *demuxer, enum demux_check check)
     if (!mf || mf->nr_of_files < 1)
         goto error;
 
+    mf->global = demuxer->global;
+    mf->cancel = demuxer->cancel;
+    mf->stream_origin = demuxer->stream_origin;
+
     double mf_fps;
     char *mf_type;
+    int mf_readahead;
     mp_read_option_raw(demuxer->global, "mf-fps", &m_option_type_double, &mf_fps);
     mp_read_option_raw(demuxer->global, "mf-type", &m_option_type_string, &mf_type);
+    mp_read_option_raw(demuxer->global, "mf-readahead", &m_option_type_int,
+                       &mf_readahead);
 
     const char *codec = mp_map_mimetype_to_video_codec(demuxer->stream->mime_type);
     if (!codec || (mf_type && mf_type[0]))
@@ -397,6 +503,13 @@ static int demux_open_mf(demuxer_t *demuxer, enum demux_check check)
 
     mf->sh = sh;
     demuxer->priv = (void *)mf;
+
+    if (mf_readahead > 1 && mf->nr_of_files > 1 && !mf->streams) {
+        mf->readahead = mf_readahead;
+        mf->pool = mp_thread_pool_create(mf, 0, 0, mf_readahead);
+        pthread_mutex_init(&mf->lock, NULL);
+        pthread_cond_init(&mf->wakeup, NULL);
+    }
     demuxer->seekable = true;
     demuxer->duration = mf->nr_of_files / mf->sh->codec->fps;
 
@@ -408,6 +521,13 @@ error:
 
 static void demux_close_mf(demuxer_t *demuxer)
 {
+    mf_t *mf = demuxer->priv;
+    if (!mf || !mf->pool)
+        return;
+    flush_reads(mf);
+    TA_FREEP(&mf->pool);
+    pthread_mutex_destroy(&mf->lock);
+    pthread_cond_destroy(&mf->wakeup);
 }
 
 const demuxer_desc_t demuxer_desc_mf = {
@@ -21,17 +21,20 @@
  */
 
 #include <float.h>
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <math.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <libavutil/common.h>
 #include <libavutil/lzo.h>
 #include <libavutil/intreadwrite.h>
 #include <libavutil/avstring.h>
+#include <libavutil/md5.h>
 
 #include <libavcodec/avcodec.h>
 #include <libavcodec/version.h>
@@ -46,7 +49,11 @@
 #include "common/av_common.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
+#include "options/path.h"
+#include "osdep/io.h"
+#include "osdep/threads.h"
 #include "misc/bstr.h"
+#include "misc/thread_tools.h"
 #include "stream/stream.h"
 #include "video/csputils.h"
 #include "video/mp_image.h"
@@ -187,6 +194,13 @@ typedef struct mkv_demuxer {
     size_t num_indexes;
     bool index_complete;
     int index_mode;
+    bool index_sorted;      // indexes[] is in ascending timecode order
+    bool index_gap;         // incremental index skipped parts of the file
+    bool index_eof;         // incremental index reached the end of file
+    bool index_from_cache;  // indexes[] was loaded from the index cache
+    char *index_cache_file;
+
+    struct cue_prefetch *cue_prefetch;
 
     int edition_id;
 
@@ -225,6 +239,8 @@ struct demux_mkv_opts {
     double subtitle_preroll_secs_index;
     int probe_duration;
     int probe_start_time;
+    char *index_cache_dir;
+    int prefetch_cues;
 };
 
 const struct m_sub_options demux_mkv_conf = {
@@ -238,6 +254,8 @@ const struct m_sub_options demux_mkv_conf = {
         {"probe-video-duration", OPT_CHOICE(probe_duration,
             {"no", 0}, {"yes", 1}, {"full", 2})},
         {"probe-start-time", OPT_FLAG(probe_start_time)},
+        {"index-cache-dir", OPT_STRING(index_cache_dir), .flags = M_OPT_FILE},
+        {"prefetch-cues", OPT_FLAG(prefetch_cues)},
         {0}
     },
     .size = sizeof(struct demux_mkv_opts),
@@ -789,6 +807,12 @@ static void cue_index_add(demuxer_t *demuxer, int track_id, uint64_t filepos,
 
     MP_TARRAY_GROW(mkv_d, mkv_d->indexes, mkv_d->num_indexes);
 
+    if (!mkv_d->num_indexes) {
+        mkv_d->index_sorted = true;
+    } else if (mkv_d->indexes[mkv_d->num_indexes - 1].timecode > timecode) {
+        mkv_d->index_sorted = false;
+    }
+
     mkv_d->indexes[mkv_d->num_indexes] = (mkv_index_t) {
         .tnum = track_id,
         .filepos = filepos,
@@ -820,24 +844,13 @@ static void add_block_position(demuxer_t *demuxer, struct mkv_track *track,
     track->last_index_entry = mkv_d->num_indexes - 1;
 }
 
-static int demux_mkv_read_cues(demuxer_t *demuxer)
+// Replace the incremental index with the parsed Cues, if they look sane.
+static void add_cues(demuxer_t *demuxer, struct ebml_cues *cues)
 {
     mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
-    stream_t *s = demuxer->stream;
-
-    if (mkv_d->index_mode != 1 || mkv_d->index_complete) {
-        ebml_read_skip(demuxer->log, -1, s);
-        return 0;
-    }
 
-    MP_VERBOSE(demuxer, "Parsing cues...\n");
-    struct ebml_cues cues = {0};
-    struct ebml_parse_ctx parse_ctx = {demuxer->log};
-    if (ebml_read_element(s, &parse_ctx, &cues, &ebml_cues_desc) < 0)
-        return -1;
-
-    for (int i = 0; i < cues.n_cue_point; i++) {
-        struct ebml_cue_point *cuepoint = &cues.cue_point[i];
+    for (int i = 0; i < cues->n_cue_point; i++) {
+        struct ebml_cue_point *cuepoint = &cues->cue_point[i];
         if (cuepoint->n_cue_time != 1 || !cuepoint->n_cue_track_positions) {
             MP_WARN(demuxer, "Malformed CuePoint element\n");
             goto done;
@@ -846,16 +859,17 @@ static int demux_mkv_read_cues(demuxer_t *demuxer)
             mkv_d->duration != 0)
             goto done;
     }
-    if (cues.n_cue_point <= 3) // probably too sparse and will just break seeking
+    if (cues->n_cue_point <= 3) // probably too sparse and will just break seeking
         goto done;
 
     // Discard incremental index. (Keep the first entry, which must be the
     // start of the file - helps with files that miss the first index entry.)
     mkv_d->num_indexes = MPMIN(1, mkv_d->num_indexes);
     mkv_d->index_has_durations = false;
+    mkv_d->index_sorted = true;
 
-    for (int i = 0; i < cues.n_cue_point; i++) {
-        struct ebml_cue_point *cuepoint = &cues.cue_point[i];
+    for (int i = 0; i < cues->n_cue_point; i++) {
+        struct ebml_cue_point *cuepoint = &cues->cue_point[i];
         uint64_t time = cuepoint->cue_time;
         for (int c = 0; c < cuepoint->n_cue_track_positions; c++) {
             struct ebml_cue_track_positions *trackpos =
@@ -878,6 +892,25 @@ static int demux_mkv_read_cues(demuxer_t *demuxer)
 done:
     if (!mkv_d->index_complete)
         MP_WARN(demuxer, "Discarding potentially broken or useless index.\n");
+}
+
+static int demux_mkv_read_cues(demuxer_t *demuxer)
+{
+    mkv_demuxer_t *mkv_d = (mkv_demuxer_t *) demuxer->priv;
+    stream_t *s = demuxer->stream;
+
+    if (mkv_d->index_mode != 1 || mkv_d->index_complete) {
+        ebml_read_skip(demuxer->log, -1, s);
+        return 0;
+    }
+
+    MP_VERBOSE(demuxer, "Parsing cues...\n");
+    struct ebml_cues cues = {0};
+    struct ebml_parse_ctx parse_ctx = {demuxer->log};
+    if (ebml_read_element(s, &parse_ctx, &cues, &ebml_cues_desc) < 0)
+        return -1;
+
+    add_cues(demuxer, &cues);
     talloc_free(parse_ctx.talloc_ctx);
     return 0;
 }
@@ -1271,6 +1304,109 @@ static int read_deferred_element(struct demuxer *demuxer,
     return read_header_element(demuxer, elem->id, elem->pos);
 }
 
+struct cue_prefetch {
+    struct mpv_global *global;
+    struct mp_log *log;
+    struct mp_cancel *cancel;
+    char *url;
+    int stream_origin;
+    int64_t pos;
+    pthread_t thread;
+    // Set by the thread; valid only after it was joined.
+    struct ebml_cues cues;
+    void *cues_ctx;
+    bool ok;
+};
+
+static void *cue_prefetch_thread(void *ptr)
+{
+    struct cue_prefetch *p = ptr;
+    mpthread_set_name("demux/mkvcues");
+
+    // Use a separate stream, so that reading packets continues unaffected.
+    struct stream *s = stream_create(p->url, STREAM_READ | STREAM_SILENT |
+                                     p->stream_origin, p->cancel, p->global);
+    if (!s)
+        return NULL;
+
+    if (stream_seek(s, p->pos) && ebml_read_id(s) == MATROSKA_ID_CUES) {
+        struct ebml_parse_ctx parse_ctx = {p->log};
+        p->ok = ebml_read_element(s, &parse_ctx, &p->cues, &ebml_cues_desc) >= 0;
+        p->cues_ctx = parse_ctx.talloc_ctx;
+    }
+
+    free_stream(s);
+    return NULL;
+}
+
+// Start reading deferred cues in the background, instead of stalling on the
+// first seek.
+static void start_cue_prefetch(struct demuxer *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    struct stream *s = demuxer->stream;
+
+    if (!mkv_d->opts->prefetch_cues || mkv_d->index_complete ||
+        mkv_d->index_mode != 1 || !s->url ||
+        !(s->is_local_file || s->is_network))
+        return;
+
+    struct header_elem *elem = NULL;
+    for (int n = 0; n < mkv_d->num_headers; n++) {
+        if (mkv_d->headers[n].id == MATROSKA_ID_CUES && !mkv_d->headers[n].parsed)
+            elem = &mkv_d->headers[n];
+    }
+    if (!elem)
+        return;
+
+    struct cue_prefetch *p = talloc_zero(NULL, struct cue_prefetch);
+    p->global = demuxer->global;
+    p->log = demuxer->log;
+    p->cancel = mp_cancel_new(p);
+    p->url = talloc_strdup(p, s->url);
+    p->stream_origin = demuxer->stream_origin;
+    p->pos = elem->pos;
+    mp_cancel_set_parent(p->cancel, demuxer->cancel);
+
+    if (pthread_create(&p->thread, NULL, cue_prefetch_thread, p)) {
+        talloc_free(p);
+        return;
+    }
+
+    MP_VERBOSE(demuxer, "Prefetching cues at %"PRId64".\n", p->pos);
+    mkv_d->cue_prefetch = p;
+}
+
+// Wait for the prefetch thread to end. If use is set, the cues it read are
+// added to the index; otherwise it's aborted and the result discarded.
+static void finish_cue_prefetch(struct demuxer *demuxer, bool use)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    struct cue_prefetch *p = mkv_d->cue_prefetch;
+
+    if (!p)
+        return;
+
+    if (!use)
+        mp_cancel_trigger(p->cancel);
+    pthread_join(p->thread, NULL);
+    mkv_d->cue_prefetch = NULL;
+
+    if (use && p->ok) {
+        for (int n = 0; n < mkv_d->num_headers; n++) {
+            if (mkv_d->headers[n].id == MATROSKA_ID_CUES)
+                mkv_d->headers[n].parsed = true;
+        }
+        MP_VERBOSE(demuxer, "Using prefetched cues.\n");
+        add_cues(demuxer, &p->cues);
+    } else if (use) {
+        MP_VERBOSE(demuxer, "Prefetching cues failed.\n");
+    }
+
+    talloc_free(p->cues_ctx);
+    talloc_free(p);
+}
+
 static void read_deferred_cues(demuxer_t *demuxer)
 {
     mkv_demuxer_t *mkv_d = demuxer->priv;
@@ -1278,6 +1414,9 @@ static void read_deferred_cues(demuxer_t *demuxer)
     if (mkv_d->index_complete || mkv_d->index_mode != 1)
         return;
 
+    // If this fails, the cues are read from the main stream below.
+    finish_cue_prefetch(demuxer, true);
+
     for (int n = 0; n < mkv_d->num_headers; n++) {
         struct header_elem *elem = &mkv_d->headers[n];
 
@@ -1286,6 +1425,189 @@ static void read_deferred_cues(demuxer_t *demuxer)
     }
 }
 
+// Index cache file layout (all little endian):
+//  header: magic[8], key[16], tc_scale (u64), flags (u32), count (u32)
+//  entries: tnum (u32), timecode (u64), duration (u64), filepos (u64)
+#define INDEX_CACHE_MAGIC "mpvmkvi1"
+#define INDEX_CACHE_HEADER_SIZE (8 + 16 + 8 + 4 + 4)
+#define INDEX_CACHE_ENTRY_SIZE (4 + 8 + 8 + 8)
+#define INDEX_CACHE_HAS_DURATIONS 1
+
+static int cmp_index_entry(const void *pa, const void *pb)
+{
+    const struct mkv_index *a = pa, *b = pb;
+    if (a->timecode != b->timecode)
+        return a->timecode < b->timecode ? -1 : 1;
+    if (a->filepos != b->filepos)
+        return a->filepos < b->filepos ? -1 : 1;
+    return a->tnum - b->tnum;
+}
+
+// The cache file is keyed on the identity of the file (URL, size, position of
+// the first cluster, segment UID), so a changed file is never matched.
+static void index_cache_key(struct demuxer *demuxer, uint8_t key[16])
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    char *str = talloc_asprintf(NULL, "%s\n%"PRId64"\n%"PRId64"\n%"PRId64"\n",
+                                demuxer->stream->url,
+                                stream_get_size(demuxer->stream),
+                                mkv_d->segment_start, mkv_d->cluster_start);
+    for (int i = 0; i < 16; i++) {
+        str = talloc_asprintf_append(str, "%02X",
+                                     demuxer->matroska_data.uid.segment[i]);
+    }
+    av_md5_sum(key, str, strlen(str));
+    talloc_free(str);
+}
+
+static void init_index_cache(struct demuxer *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    char *dir = mkv_d->opts->index_cache_dir;
+
+    if (!dir || !dir[0] || mkv_d->index_mode != 1 || !demuxer->stream->url ||
+        !demuxer->seekable || stream_get_size(demuxer->stream) < 0)
+        return;
+
+    uint8_t key[16];
+    index_cache_key(demuxer, key);
+
+    void *tmp = talloc_new(NULL);
+    char *name = talloc_strdup(tmp, "");
+    for (int i = 0; i < 16; i++)
+        name = talloc_asprintf_append(name, "%02X", key[i]);
+    name = talloc_strdup_append(name, ".mkvidx");
+    dir = mp_get_user_path(tmp, demuxer->global, dir);
+    mkv_d->index_cache_file = mp_path_join(mkv_d, dir, name);
+    talloc_free(tmp);
+}
+
+// Load a previously written index, if the file has no usable Cues.
+static void load_index_cache(struct demuxer *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    char *filename = mkv_d->index_cache_file;
+
+    if (!filename || mkv_d->index_complete ||
+        stat(filename, &(struct stat){0}) != 0)
+        return;
+
+    void *tmp = talloc_new(NULL);
+    struct bstr data = stream_read_file(filename, tmp, demuxer->global,
+                                        INT_MAX);
+    uint8_t key[16];
+    index_cache_key(demuxer, key);
+
+    uint8_t *p = data.start;
+    if (data.len < INDEX_CACHE_HEADER_SIZE ||
+        memcmp(p, INDEX_CACHE_MAGIC, 8) != 0 ||
+        memcmp(p + 8, key, 16) != 0 ||
+        AV_RL64(p + 24) != mkv_d->tc_scale)
+        goto invalid;
+
+    uint32_t flags = AV_RL32(p + 32);
+    size_t count = AV_RL32(p + 36);
+    if (!count || (data.len - INDEX_CACHE_HEADER_SIZE) / INDEX_CACHE_ENTRY_SIZE
+                  != count ||
+        (data.len - INDEX_CACHE_HEADER_SIZE) % INDEX_CACHE_ENTRY_SIZE)
+        goto invalid;
+
+    mkv_index_t *indexes = talloc_array(mkv_d, mkv_index_t, count);
+    p += INDEX_CACHE_HEADER_SIZE;
+    for (size_t n = 0; n < count; n++) {
+        indexes[n] = (mkv_index_t){
+            .tnum       = AV_RL32(p),
+            .timecode   = AV_RL64(p + 4),
+            .duration   = AV_RL64(p + 12),
+            .filepos    = AV_RL64(p + 20),
+        };
+        if (indexes[n].filepos < mkv_d->segment_start ||
+            indexes[n].filepos >= mkv_d->segment_end)
+        {
+            talloc_free(indexes);
+            goto invalid;
+        }
+        p += INDEX_CACHE_ENTRY_SIZE;
+    }
+
+    talloc_free(mkv_d->indexes);
+    mkv_d->indexes = indexes;
+    mkv_d->num_indexes = count;
+    mkv_d->index_has_durations = flags & INDEX_CACHE_HAS_DURATIONS;
+    mkv_d->index_sorted = true;
+    mkv_d->index_complete = true;
+    mkv_d->index_from_cache = true;
+    MP_VERBOSE(demuxer, "Loaded %zu index entries from '%s'.\n", count,
+               filename);
+    talloc_free(tmp);
+    return;
+
+invalid:
+    MP_WARN(demuxer, "Index cache file '%s' is invalid, ignoring.\n", filename);
+    talloc_free(tmp);
+}
+
+// Write the index built while reading the file, if it covers the whole file.
+static void save_index_cache(struct demuxer *demuxer)
+{
+    mkv_demuxer_t *mkv_d = demuxer->priv;
+    char *filename = mkv_d->index_cache_file;
+
+    if (!filename || mkv_d->index_complete || mkv_d->index_gap ||
+        !mkv_d->index_eof || !mkv_d->num_indexes ||
+        mkv_d->num_indexes > UINT32_MAX)
+        return;
+
+    // Cues that were never read might be fine; keep relying on them.
+    for (int n = 0; n < mkv_d->num_headers; n++) {
+        if (mkv_d->headers[n].id == MATROSKA_ID_CUES &&
+            !mkv_d->headers[n].parsed)
+            return;
+    }
+
+    void *tmp = talloc_new(NULL);
+    mkv_index_t *indexes = talloc_memdup(tmp, mkv_d->indexes,
+                            mkv_d->num_indexes * sizeof(mkv_d->indexes[0]));
+    qsort(indexes, mkv_d->num_indexes, sizeof(indexes[0]), cmp_index_entry);
+
+    size_t size = INDEX_CACHE_HEADER_SIZE +
+                  mkv_d->num_indexes * INDEX_CACHE_ENTRY_SIZE;
+    uint8_t *buf = talloc_size(tmp, size);
+    uint8_t *p = buf;
+    memcpy(p, INDEX_CACHE_MAGIC, 8);
+    index_cache_key(demuxer, p + 8);
+    AV_WL64(p + 24, mkv_d->tc_scale);
+    AV_WL32(p + 32, mkv_d->index_has_durations ? INDEX_CACHE_HAS_DURATIONS : 0);
+    AV_WL32(p + 36, mkv_d->num_indexes);
+    p += INDEX_CACHE_HEADER_SIZE;
+    for (size_t n = 0; n < mkv_d->num_indexes; n++) {
+        AV_WL32(p, indexes[n].tnum);
+        AV_WL64(p + 4, indexes[n].timecode);
+        AV_WL64(p + 12, indexes[n].duration);
+        AV_WL64(p + 20, indexes[n].filepos);
+        p += INDEX_CACHE_ENTRY_SIZE;
+    }
+
+    mp_mkdirp(bstrto0(tmp, mp_dirname(filename)));
+
+    FILE *out = fopen(filename, "wb");
+    if (out) {
+        bool ok = fwrite(buf, size, 1, out) == 1;
+        ok &= fclose(out) == 0;
+        if (ok) {
+            MP_VERBOSE(demuxer, "Saved %zu index entries to '%s'.\n",
+                       mkv_d->num_indexes, filename);
+        } else {
+            MP_WARN(demuxer, "Failed to write index cache file '%s'.\n",
+                    filename);
+            unlink(filename);
+        }
+    } else {
+        MP_WARN(demuxer, "Failed to create index cache file '%s'.\n", filename);
+    }
+    talloc_free(tmp);
+}
+
 static void add_coverart(struct demuxer *demuxer)
 {
     for (int n = 0; n < demuxer->num_attachments; n++) {
@@ -2116,17 +2438,72 @@ static int demux_mkv_open(demuxer_t *demuxer, enum demux_check check)
     add_coverart(demuxer);
     process_tags(demuxer);
 
+    init_index_cache(demuxer);
+    load_index_cache(demuxer);
+
     probe_first_timestamp(demuxer);
     if (mkv_d->opts->probe_duration)
         probe_last_timestamp(demuxer, start_pos);
     probe_x264_garbage(demuxer);
 
+    start_cue_prefetch(demuxer);
+
     return 0;
 }
 
 // Read the laced block data at the current stream position (until endpos as
 // indicated by the block length field) into individual buffers.
-static int demux_mkv_read_block_lacing(struct block_info *block, int type,
+// Parse the lace sizes from the lace header in buf. Returns the size of the
+// header, -2 if more data is needed, or -1 on invalid data. The size of the
+// last lace is not stored in the header, and is left to the caller.
+static int parse_lace_sizes(const uint8_t *buf, int size, int type, int laces,
+                            uint32_t *lace_size)
+{
+    int pos = 0;
+
+    switch (type) {
+    case 1:                /* xiph lacing */
+        for (int i = 0; i < laces - 1; i++) {
+            uint32_t sum = 0;
+            uint8_t t;
+            do {
+                if (pos >= size)
+                    return -2;
+                t = buf[pos++];
+                sum += t;
+            } while (t == 0xFF);
+            lace_size[i] = sum;
+        }
+        return pos;
+
+    case 3: {              /* EBML lacing */
+        uint64_t num;
+        int n = ebml_decode_length(buf, size, &num);
+        if (!n)
+            return size >= 8 ? -1 : -2;
+        if (num == EBML_UINT_INVALID)
+            return -1;
+        pos += n;
+        lace_size[0] = num;
+        for (int i = 1; i < laces - 1; i++) {
+            int64_t snum;
+            n = ebml_decode_signed_length(buf + pos, size - pos, &snum);
+            if (!n)
+                return size - pos >= 8 ? -1 : -2;
+            if (snum == EBML_INT_INVALID)
+                return -1;
+            pos += n;
+            lace_size[i] = lace_size[i - 1] + snum;
+        }
+        return pos;
+    }
+    }
+
+    return -1;
+}
+
+static int demux_mkv_read_block_lacing(struct demuxer *demuxer,
+                                       struct block_info *block, int type,
                                        struct stream *s, uint64_t endpos)
 {
     int laces;
@@ -2142,52 +2519,40 @@ static int demux_mkv_read_block_lacing(struct block_info *block, int type,
             goto error;
         laces += 1;
 
-        switch (type) {
-        case 1: {              /* xiph lacing */
-            uint32_t total = 0;
-            for (int i = 0; i < laces - 1; i++) {
-                lace_size[i] = 0;
-                uint8_t t;
-                do {
-                    t = stream_read_char(s);
-                    if (s->eof || stream_tell(s) >= endpos)
-                        goto error;
-                    lace_size[i] += t;
-                } while (t == 0xFF);
-                total += lace_size[i];
-            }
-            uint32_t rest_length = endpos - stream_tell(s);
-            lace_size[laces - 1] = rest_length - total;
-            break;
-        }
-
-        case 2: {              /* fixed-size lacing */
+        if (type == 2) {       /* fixed-size lacing */
             uint32_t full_length = endpos - stream_tell(s);
             for (int i = 0; i < laces; i++)
                 lace_size[i] = full_length / laces;
-            break;
-        }
-
-        case 3: {              /* EBML lacing */
-            uint64_t num = ebml_read_length(s);
-            if (num == EBML_UINT_INVALID || stream_tell(s) >= endpos)
+        } else {
+            // Decode the whole lace header from memory in one go. Xiph lace
+            // headers can be of any length, so retry with more data if needed.
+            int64_t left = endpos - stream_tell(s);
+            int hdr_size = 8 * laces;
+            int hdr;
+            while (1) {
+                uint8_t tmp[8 * MAX_NUM_LACES];
+                uint8_t *buf = tmp;
+                int peek = MPMIN(hdr_size, left);
+                if (peek > sizeof(tmp))
+                    buf = talloc_size(NULL, peek);
+                peek = stream_read_peek(s, buf, peek);
+                hdr = parse_lace_sizes(buf, peek, type, laces, lace_size);
+                if (buf != tmp)
+                    talloc_free(buf);
+                if (hdr != -2 || peek < hdr_size || peek >= left)
+                    break;
+                hdr_size *= 2;
+            }
+            // A header taking all data would leave nothing for the last lace.
+            if (hdr < 0 || hdr >= left)
                 goto error;
+            stream_seek_skip(s, stream_tell(s) + hdr);
 
-            uint32_t total = lace_size[0] = num;
-            for (int i = 1; i < laces - 1; i++) {
-                int64_t snum = ebml_read_signed_length(s);
-                if (snum == EBML_INT_INVALID || stream_tell(s) >= endpos)
-                    goto error;
-                lace_size[i] = lace_size[i - 1] + snum;
+            uint32_t total = 0;
+            for (int i = 0; i < laces - 1; i++)
                 total += lace_size[i];
-            }
             uint32_t rest_length = endpos - stream_tell(s);
             lace_size[laces - 1] = rest_length - total;
-            break;
-        }
-
-        default:
-            goto error;
         }
     }
 
@@ -2196,15 +2561,14 @@ static int demux_mkv_read_block_lacing(struct block_info *block, int type,
         if (stream_tell(s) + size > endpos || size > (1 << 30))
             goto error;
         int pad = MPMAX(AV_INPUT_BUFFER_PADDING_SIZE, AV_LZO_INPUT_PADDING);
-        AVBufferRef *buf = av_buffer_alloc(size + pad);
+        AVBufferRef *buf =
+            demux_packet_pool_get_buffer(demuxer->packet_pool, size, pad);
         if (!buf)
             goto error;
-        buf->size = size;
         if (stream_read(s, buf->data, buf->size) != buf->size) {
             av_buffer_unref(&buf);
             goto error;
         }
-        memset(buf->data + buf->size, 0, pad);
         block->laces[block->num_laces++] = buf;
     }
 
@@ -2569,7 +2933,7 @@ static int read_block(demuxer_t *demuxer, int64_t end, struct block_info *block)
     block->filepos = stream_tell(s);
 
     int lace_type = (header_flags >> 1) & 0x03;
-    if (demux_mkv_read_block_lacing(block, lace_type, s, endpos))
+    if (demux_mkv_read_block_lacing(demuxer, block, lace_type, s, endpos))
         goto exit;
 
     if (block->simple)
@@ -2848,13 +3212,16 @@ static int read_next_block_into_queue(demuxer_t *demuxer)
             uint32_t id = ebml_read_id(s);
             if (id == MATROSKA_ID_CLUSTER)
                 break;
-            if (s->eof)
+            if (s->eof) {
+                mkv_d->index_eof = true;
                 return -1;
+            }
             if (demux_cancel_test(demuxer))
                 return -1;
             if (id == EBML_ID_EBML && stream_tell(s) >= mkv_d->segment_end) {
                 // Appended segment - don't use its clusters, consider this EOF.
                 stream_seek(s, stream_tell(s) - 4);
+                mkv_d->index_eof = true;
                 return -1;
             }
             // For the sake of robustness, consider even unknown level 1
@@ -2974,14 +3341,76 @@ static int create_index_until(struct demuxer *demuxer, int64_t timecode)
     return 0;
 }
 
+static bool index_matches(struct mkv_index *index, int seek_id)
+{
+    return seek_id < 0 || index->tnum == seek_id;
+}
+
+// Last matching entry before pos; the first one if several share a timecode.
+static struct mkv_index *index_before(struct mkv_demuxer *mkv_d, int seek_id,
+                                      size_t pos)
+{
+    struct mkv_index *index = NULL;
+    for (size_t i = pos; i > 0; i--) {
+        struct mkv_index *cur = &mkv_d->indexes[i - 1];
+        if (index && cur->timecode != index->timecode)
+            break;
+        if (index_matches(cur, seek_id))
+            index = cur;
+    }
+    return index;
+}
+
+// First matching entry at or after pos.
+static struct mkv_index *index_after(struct mkv_demuxer *mkv_d, int seek_id,
+                                     size_t pos)
+{
+    for (size_t i = pos; i < mkv_d->num_indexes; i++) {
+        if (index_matches(&mkv_d->indexes[i], seek_id))
+            return &mkv_d->indexes[i];
+    }
+    return NULL;
+}
+
+// Same result as the linear search in seek_with_cues(), but requires the
+// index to be sorted by timecode.
+static struct mkv_index *bsearch_index(struct mkv_demuxer *mkv_d, int seek_id,
+                                       int64_t target_timecode, int flags)
+{
+    bool forward = flags & SEEK_FORWARD;
+
+    // Find the first entry after the target (at or after it if forward).
+    size_t lo = 0, hi = mkv_d->num_indexes;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        int64_t tc = mkv_d->indexes[mid].timecode * mkv_d->tc_scale;
+        if (forward ? tc < target_timecode : tc <= target_timecode) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    struct mkv_index *index = forward ? index_after(mkv_d, seek_id, lo)
+                                      : index_before(mkv_d, seek_id, lo);
+    if (!index) {
+        index = forward ? index_before(mkv_d, seek_id, lo)
+                        : index_after(mkv_d, seek_id, lo);
+    }
+    return index;
+}
+
 static struct mkv_index *seek_with_cues(struct demuxer *demuxer, int seek_id,
                                         int64_t target_timecode, int flags)
 {
     struct mkv_demuxer *mkv_d = demuxer->priv;
     struct mkv_index *index = NULL;
 
+    if (mkv_d->index_sorted)
+        index = bsearch_index(mkv_d, seek_id, target_timecode, flags);
+
     int64_t min_diff = INT64_MIN;
-    for (size_t i = 0; i < mkv_d->num_indexes; i++) {
+    for (size_t i = 0; !mkv_d->index_sorted && i < mkv_d->num_indexes; i++) {
         if (seek_id < 0 || mkv_d->indexes[i].tnum == seek_id) {
             int64_t diff =
                 mkv_d->indexes[i].timecode * mkv_d->tc_scale - target_timecode;
@@ -3108,6 +3537,10 @@ static void demux_mkv_seek(demuxer_t *demuxer, double seek_pts, int flags)
         int64_t size = stream_get_size(s);
         int64_t target_filepos = size * MPCLAMP(seek_pts, 0, 1);
 
+        // Skipping over clusters would leave holes in the incremental index.
+        if (!mkv_d->index_complete)
+            mkv_d->index_gap = true;
+
         mkv_index_t *index = NULL;
         if (mkv_d->index_complete) {
             for (size_t i = 0; i < mkv_d->num_indexes; i++) {
@@ -3158,6 +3591,12 @@ static void probe_last_timestamp(struct demuxer *demuxer, int64_t start_pos)
     if (v_tnum < 0)
         return;
 
+    // Blocks read near the end of file must not end up in the incremental
+    // index, which has to stay contiguous.
+    size_t *last_index_entry = NULL;
+    size_t num_indexes = mkv_d->num_indexes;
+    bool index_sorted = mkv_d->index_sorted;
+
     // In full mode, we start reading data from the current file position,
     // which works because this function is called after headers are parsed.
     if (mkv_d->opts->probe_duration != 2) {
@@ -3176,6 +3615,10 @@ static void probe_last_timestamp(struct demuxer *demuxer, int64_t start_pos)
             if (!stream_seek(demuxer->stream, target))
                 return;
         } else {
+            last_index_entry = talloc_array(NULL, size_t, mkv_d->num_tracks);
+            for (int n = 0; n < mkv_d->num_tracks; n++)
+                last_index_entry[n] = mkv_d->tracks[n]->last_index_entry;
+
             // No index -> just try to find a random cluster towards file end.
             int64_t size = stream_get_size(demuxer->stream);
             stream_seek(demuxer->stream, MPMAX(size - 10 * 1024 * 1024, 0));
@@ -3203,6 +3646,15 @@ static void probe_last_timestamp(struct demuxer *demuxer, int64_t start_pos)
         }
     }
 
+    if (last_index_entry) {
+        for (int n = 0; n < mkv_d->num_tracks; n++)
+            mkv_d->tracks[n]->last_index_entry = last_index_entry[n];
+        mkv_d->num_indexes = num_indexes;
+        mkv_d->index_sorted = index_sorted;
+        mkv_d->index_eof = false;
+        talloc_free(last_index_entry);
+    }
+
     if (!last_ts[STREAM_VIDEO])
         last_ts[STREAM_VIDEO] = mkv_d->cluster_tc;
 
@@ -3236,6 +3688,8 @@ static void mkv_free(struct demuxer *demuxer)
     if (!mkv_d)
         return;
     mkv_seek_reset(demuxer);
+    finish_cue_prefetch(demuxer, false);
+    save_index_cache(demuxer);
     for (int i = 0; i < mkv_d->num_tracks; i++)
         demux_mkv_free_trackentry(mkv_d->tracks[i]);
 }
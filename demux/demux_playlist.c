@@ -19,14 +19,21 @@
 #include <string.h>
 #include <strings.h>
 #include <dirent.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <time.h>
 
 #include <libavutil/common.h>
+#include <libavutil/md5.h>
 
 #include "config.h"
 #include "common/common.h"
+#include "options/m_config.h"
 #include "options/options.h"
 #include "common/msg.h"
 #include "common/playlist.h"
+#include "misc/thread_pool.h"
 #include "misc/thread_tools.h"
 #include "options/path.h"
 #include "stream/stream.h"
@@ -36,6 +43,26 @@
 
 #define PROBE_SIZE (8 * 1024)
 
+struct demux_playlist_opts {
+    int scan_threads;
+    char *dir_cache_dir;
+    int incremental;
+};
+
+#define OPT_BASE_STRUCT struct demux_playlist_opts
+const struct m_sub_options demux_playlist_conf = {
+    .opts = (const m_option_t[]) {
+        {"directory-scan-threads", OPT_INT(scan_threads), M_RANGE(1, 64)},
+        {"directory-cache-dir", OPT_STRING(dir_cache_dir), .flags = M_OPT_FILE},
+        {"playlist-incremental", OPT_FLAG(incremental)},
+        {0}
+    },
+    .size = sizeof(struct demux_playlist_opts),
+    .defaults = &(const struct demux_playlist_opts){
+        .scan_threads = 4,
+    },
+};
+
 static bool check_mimetype(struct stream *s, const char *const *list)
 {
     if (s->mime_type) {
@@ -49,6 +76,8 @@ static bool check_mimetype(struct stream *s, const char *const *list)
 
 struct pl_parser {
     struct mp_log *log;
+    struct mpv_global *global;
+    struct demux_playlist_opts *opts;
     struct stream *s;
     char buffer[2 * 1024 * 1024];
     int utf16;
@@ -58,8 +87,11 @@ struct pl_parser {
     bool force;
     bool add_base;
     enum demux_check check_level;
+    int stream_origin;
     struct stream *real_stream;
     char *format;
+    // If set, add entries to the loader instead of pl (on the loader thread).
+    struct playlist_loader *loader;
 };
 
 
@@ -171,6 +203,97 @@ static bool maybe_text(bstr d)
     return true;
 }
 
+struct m3u_loader {
+    struct mp_log *log;
+    struct mpv_global *global;
+    struct demux_playlist_opts *opts;
+    char *url;
+    int stream_origin;
+    int utf16;
+    int64_t pos;
+};
+
+static void parse_m3u_entries(struct pl_parser *p, bstr line);
+
+static void m3u_loader_run(struct playlist_loader *loader, void *ctx)
+{
+    struct m3u_loader *ld = ctx;
+    struct mp_cancel *cancel = playlist_loader_get_cancel(loader);
+
+    struct pl_parser *p = talloc_zero(NULL, struct pl_parser);
+    p->log = ld->log;
+    p->global = ld->global;
+    p->opts = ld->opts;
+    p->utf16 = ld->utf16;
+    p->loader = loader;
+    p->s = stream_create(ld->url, STREAM_READ | ld->stream_origin, cancel,
+                         ld->global);
+    if (!p->s || !stream_seek(p->s, ld->pos)) {
+        MP_ERR(p, "Could not reopen playlist, it will be incomplete.\n");
+    } else {
+        parse_m3u_entries(p, bstr_strip(pl_get_line(p)));
+        if (p->error && !mp_cancel_test(cancel))
+            MP_ERR(p, "Error reading the rest of the playlist.\n");
+    }
+    free_stream(p->s);
+    talloc_free(p);
+}
+
+// Read the rest of the playlist on a separate thread, starting at the current
+// stream position. Only done after the first entry, so playback can start.
+static bool start_m3u_loader(struct pl_parser *p)
+{
+    if (p->loader || !p->opts->incremental || p->format)
+        return false;
+
+    struct m3u_loader *ld = talloc_zero(NULL, struct m3u_loader);
+    ld->log = mp_log_new(ld, p->log, NULL);
+    ld->global = p->global;
+    ld->opts = mp_get_config_group(ld, p->global, &demux_playlist_conf);
+    ld->url = talloc_strdup(ld, p->real_stream->url);
+    ld->stream_origin = p->stream_origin;
+    ld->utf16 = p->utf16;
+    ld->pos = stream_tell(p->s);
+    if (!playlist_loader_start(p->pl, m3u_loader_run, ld)) {
+        MP_WARN(p, "Could not start thread, reading the complete playlist.\n");
+        return false;
+    }
+    MP_VERBOSE(p, "Reading the rest of the playlist in the background.\n");
+    return true;
+}
+
+static void parse_m3u_entries(struct pl_parser *p, bstr line)
+{
+    char *title = NULL;
+    while (line.len || !pl_eof(p)) {
+        if (bstr_eatstart0(&line, "#EXTINF:")) {
+            bstr duration, btitle;
+            if (bstr_split_tok(line, ",", &duration, &btitle) && btitle.len) {
+                talloc_free(title);
+                title = bstrto0(NULL, btitle);
+            }
+        } else if (bstr_startswith0(line, "#EXT-X-")) {
+            p->format = "hls";
+        } else if (line.len > 0 && !bstr_startswith0(line, "#")) {
+            if (p->loader) {
+                playlist_loader_add(p->loader, line, bstr0(title));
+                TA_FREEP(&title);
+            } else {
+                char *fn = bstrto0(NULL, line);
+                struct playlist_entry *e = playlist_entry_new(fn);
+                talloc_free(fn);
+                e->title = talloc_steal(e, title);
+                title = NULL;
+                playlist_add(p->pl, e);
+                if (start_m3u_loader(p))
+                    break;
+            }
+        }
+        line = bstr_strip(pl_get_line(p));
+    }
+    talloc_free(title);
+}
+
 static int parse_m3u(struct pl_parser *p)
 {
     bstr line = bstr_strip(pl_get_line(p));
@@ -196,27 +319,7 @@ ok:
     if (p->probing)
         return 0;
 
-    char *title = NULL;
-    while (line.len || !pl_eof(p)) {
-        if (bstr_eatstart0(&line, "#EXTINF:")) {
-            bstr duration, btitle;
-            if (bstr_split_tok(line, ",", &duration, &btitle) && btitle.len) {
-                talloc_free(title);
-                title = bstrto0(NULL, btitle);
-            }
-        } else if (bstr_startswith0(line, "#EXT-X-")) {
-            p->format = "hls";
-        } else if (line.len > 0 && !bstr_startswith0(line, "#")) {
-            char *fn = bstrto0(NULL, line);
-            struct playlist_entry *e = playlist_entry_new(fn);
-            talloc_free(fn);
-            e->title = talloc_steal(e, title);
-            title = NULL;
-            playlist_add(p->pl, e);
-        }
-        line = bstr_strip(pl_get_line(p));
-    }
-    talloc_free(title);
+    parse_m3u_entries(p, line);
     return 0;
 }
 
@@ -305,60 +408,297 @@ static int parse_txt(struct pl_parser *p)
 
 #define MAX_DIR_STACK 20
 
+// Listing of a single directory (not recursive).
+struct dir_listing {
+    char *path;
+    int64_t mtime;
+    char **files;   // names of entries that are not directories
+    int num_files;
+    char **dirs;    // names of subdirectories
+    int num_dirs;
+};
+
+struct dir_scan {
+    struct mp_log *log;
+    struct mp_cancel *cancel;
+    struct mp_thread_pool *pool;    // NULL: scan on the calling thread
+
+    // Loaded from the listing cache, sorted by path. Read-only during the scan.
+    struct dir_listing **cache;
+    int num_cache;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    // All fields below are protected by the lock.
+    int pending;                    // number of directories not yet done
+    char **files;                   // result (full paths)
+    int num_files;
+    struct dir_listing **listings;  // for writing the new listing cache
+    int num_listings;
+    bool complete;                  // false if an error happened or canceled
+    void *ta_ctx;                   // owner of all results
+};
+
+struct dir_job {
+    struct dir_scan *scan;
+    char *path;
+    // Stat of the directory and all parents. The last entry is the directory.
+    struct stat dir_stack[MAX_DIR_STACK + 1];
+    int num_dir_stack;
+};
+
 static bool same_st(struct stat *st1, struct stat *st2)
 {
     return st1->st_dev == st2->st_dev && st1->st_ino == st2->st_ino;
 }
 
-// Return true if this was a readable directory.
-static bool scan_dir(struct pl_parser *p, char *path,
-                     struct stat *dir_stack, int num_dir_stack,
-                     char ***files, int *num_files)
+static int cmp_listing(const void *a, const void *b)
 {
-    if (strlen(path) >= 8192 || num_dir_stack == MAX_DIR_STACK)
-        return false; // things like mount bind loops
+    return strcmp((*(struct dir_listing **)a)->path,
+                  (*(struct dir_listing **)b)->path);
+}
+
+static struct dir_listing *find_cached_listing(struct dir_scan *scan,
+                                               char *path, int64_t mtime)
+{
+    struct dir_listing key = {.path = path}, *pkey = &key;
+    struct dir_listing **res = scan->num_cache ?
+        bsearch(&pkey, scan->cache, scan->num_cache, sizeof(scan->cache[0]),
+                cmp_listing) : NULL;
+    return res && (*res)->mtime == mtime ? *res : NULL;
+}
 
-    DIR *dp = opendir(path);
+// Read the directory entries into l. Uses the entry type returned by readdir()
+// if possible, instead of calling stat() on each entry.
+static bool read_dir(struct dir_scan *scan, struct dir_listing *l)
+{
+    DIR *dp = opendir(l->path);
     if (!dp) {
-        MP_ERR(p, "Could not read directory.\n");
+        MP_ERR(scan, "Could not read directory.\n");
         return false;
     }
 
+    bool ok = true;
     struct dirent *ep;
     while ((ep = readdir(dp))) {
         if (ep->d_name[0] == '.')
             continue;
 
-        if (mp_cancel_test(p->s->cancel))
+        if (mp_cancel_test(scan->cancel)) {
+            ok = false;
             break;
+        }
 
-        char *file = mp_path_join(p, path, ep->d_name);
+        bool is_dir;
+#ifdef DT_UNKNOWN
+        if (ep->d_type != DT_UNKNOWN && ep->d_type != DT_LNK) {
+            is_dir = ep->d_type == DT_DIR;
+        } else
+#endif
+        {
+            char *file = mp_path_join(NULL, l->path, ep->d_name);
+            struct stat st;
+            is_dir = stat(file, &st) == 0 && S_ISDIR(st.st_mode);
+            talloc_free(file);
+        }
 
-        struct stat st;
-        if (stat(file, &st) == 0 && S_ISDIR(st.st_mode)) {
-            for (int n = 0; n < num_dir_stack; n++) {
-                if (same_st(&dir_stack[n], &st)) {
-                    MP_VERBOSE(p, "Skip recursive entry: %s\n", file);
-                    goto skip;
-                }
-            }
+        char *name = talloc_strdup(l, ep->d_name);
+        if (is_dir) {
+            MP_TARRAY_APPEND(l, l->dirs, l->num_dirs, name);
+        } else {
+            MP_TARRAY_APPEND(l, l->files, l->num_files, name);
+        }
+    }
+
+    closedir(dp);
+    return ok;
+}
+
+static void scan_dir_job(void *ptr);
+
+static void queue_dir_job(struct dir_scan *scan, struct dir_job *job)
+{
+    pthread_mutex_lock(&scan->lock);
+    scan->pending++;
+    pthread_mutex_unlock(&scan->lock);
+
+    if (!scan->pool || !mp_thread_pool_queue(scan->pool, scan_dir_job, job))
+        scan_dir_job(job);
+}
+
+static void scan_dir_job(void *ptr)
+{
+    struct dir_job *job = ptr;
+    struct dir_scan *scan = job->scan;
+    struct stat *st = &job->dir_stack[job->num_dir_stack - 1];
+
+    struct dir_listing *l = talloc_zero(job, struct dir_listing);
+    l->path = job->path;
+    l->mtime = st->st_mtime;
+
+    bool ok = !mp_cancel_test(scan->cancel);
+    struct dir_listing *cached = find_cached_listing(scan, l->path, l->mtime);
+    if (ok && cached) {
+        // (The cache is not freed before the scan ends.)
+        l->files = cached->files;
+        l->num_files = cached->num_files;
+        l->dirs = cached->dirs;
+        l->num_dirs = cached->num_dirs;
+    } else if (ok) {
+        ok = read_dir(scan, l);
+    }
+
+    char **files = NULL;
+    int num_files = 0;
+    for (int n = 0; n < l->num_files; n++) {
+        char *file = mp_path_join(job, l->path, l->files[n]);
+        MP_TARRAY_APPEND(job, files, num_files, file);
+    }
+
+    for (int n = 0; ok && n < l->num_dirs; n++) {
+        char *file = mp_path_join(job, l->path, l->dirs[n]);
+
+        struct stat sub_st;
+        if (stat(file, &sub_st) != 0 || !S_ISDIR(sub_st.st_mode)) {
+            MP_TARRAY_APPEND(job, files, num_files, file);
+            continue;
+        }
+
+        // things like mount bind loops
+        if (strlen(file) >= 8192 || job->num_dir_stack > MAX_DIR_STACK)
+            continue;
+        bool recursive = false;
+        for (int i = 0; i < job->num_dir_stack; i++)
+            recursive |= same_st(&job->dir_stack[i], &sub_st);
+        if (recursive) {
+            MP_VERBOSE(scan, "Skip recursive entry: %s\n", file);
+            continue;
+        }
+
+        struct dir_job *sub = talloc_zero(NULL, struct dir_job);
+        sub->scan = scan;
+        sub->path = talloc_strdup(sub, file);
+        memcpy(sub->dir_stack, job->dir_stack,
+               job->num_dir_stack * sizeof(job->dir_stack[0]));
+        sub->dir_stack[job->num_dir_stack] = sub_st;
+        sub->num_dir_stack = job->num_dir_stack + 1;
+        queue_dir_job(scan, sub);
+    }
+
+    // Directories changed in the last seconds could change again without
+    // a visible mtime change (the resolution is 1 second).
+    bool cacheable = ok && l->mtime < time(NULL) - 2;
+    for (int n = 0; n < l->num_files; n++)
+        cacheable &= !strchr(l->files[n], '\n');
+    for (int n = 0; n < l->num_dirs; n++)
+        cacheable &= !strchr(l->dirs[n], '\n');
+
+    pthread_mutex_lock(&scan->lock);
+    talloc_steal(scan->ta_ctx, job);
+    for (int n = 0; n < num_files; n++)
+        MP_TARRAY_APPEND(scan->ta_ctx, scan->files, scan->num_files, files[n]);
+    if (cacheable)
+        MP_TARRAY_APPEND(scan->ta_ctx, scan->listings, scan->num_listings, l);
+    scan->complete &= ok;
+    scan->pending--;
+    pthread_cond_broadcast(&scan->wakeup);
+    pthread_mutex_unlock(&scan->lock);
+}
+
+#define DIR_CACHE_HEADER "mpv-dirlist 1\n"
+
+// The listing cache stores the listings of all directories found when
+// scanning path, in the following format (after the header line):
+//  "D <mtime> <path>" starts a directory listing
+//  "F <name>" adds a non-directory entry
+//  "S <name>" adds a subdirectory
+static char *get_dir_cache_file(void *ta_ctx, struct pl_parser *p,
+                                const char *path)
+{
+    char *dir = p->opts->dir_cache_dir;
+    if (!dir || !dir[0])
+        return NULL;
+
+    uint8_t md5[16];
+    av_md5_sum(md5, path, strlen(path));
+    char *name = talloc_strdup(ta_ctx, "");
+    for (int i = 0; i < 16; i++)
+        name = talloc_asprintf_append(name, "%02X", md5[i]);
+    name = talloc_strdup_append(name, ".dirlist");
+    dir = mp_get_user_path(ta_ctx, p->global, dir);
+    return mp_path_join(ta_ctx, dir, name);
+}
 
-            dir_stack[num_dir_stack] = st;
-            scan_dir(p, file, dir_stack, num_dir_stack + 1, files, num_files);
+static void load_dir_cache(struct dir_scan *scan, struct pl_parser *p,
+                           const char *filename)
+{
+    if (stat(filename, &(struct stat){0}) != 0)
+        return;
+
+    bstr data = stream_read_file(filename, scan->ta_ctx, p->global, INT_MAX);
+    if (!bstr_eatstart0(&data, DIR_CACHE_HEADER))
+        goto invalid;
+
+    struct dir_listing *cur = NULL;
+    while (data.len) {
+        bstr line = bstr_strip_linebreaks(bstr_getline(data, &data));
+        if (line.len < 2 || line.start[1] != ' ')
+            goto invalid;
+        char type = line.start[0];
+        line = bstr_cut(line, 2);
+        if (type == 'D') {
+            cur = talloc_zero(scan->ta_ctx, struct dir_listing);
+            cur->mtime = bstrtoll(line, &line, 10);
+            if (!bstr_eatstart0(&line, " ") || !line.len)
+                goto invalid;
+            cur->path = bstrto0(cur, line);
+            MP_TARRAY_APPEND(scan->ta_ctx, scan->cache, scan->num_cache, cur);
+        } else if (cur && type == 'F') {
+            MP_TARRAY_APPEND(cur, cur->files, cur->num_files,
+                             bstrto0(cur, line));
+        } else if (cur && type == 'S') {
+            MP_TARRAY_APPEND(cur, cur->dirs, cur->num_dirs, bstrto0(cur, line));
         } else {
-            MP_TARRAY_APPEND(p, *files, *num_files, file);
+            goto invalid;
         }
+    }
 
-        skip: ;
+    if (scan->cache) {
+        qsort(scan->cache, scan->num_cache, sizeof(scan->cache[0]),
+              cmp_listing);
     }
+    MP_VERBOSE(p, "Loaded %d directory listings from '%s'.\n",
+               scan->num_cache, filename);
+    return;
 
-    closedir(dp);
-    return true;
+invalid:
+    MP_WARN(p, "Directory listing cache '%s' is invalid.\n", filename);
+    scan->num_cache = 0;
 }
 
-static int cmp_filename(const void *a, const void *b)
+static void save_dir_cache(struct dir_scan *scan, struct pl_parser *p,
+                           const char *filename)
 {
-    return mp_natural_sort_cmp(*(char **)a, *(char **)b);
+    void *tmp = talloc_new(NULL);
+    bstr data = {0};
+    bstr_xappend(tmp, &data, bstr0(DIR_CACHE_HEADER));
+    for (int n = 0; n < scan->num_listings; n++) {
+        struct dir_listing *l = scan->listings[n];
+        bstr_xappend_asprintf(tmp, &data, "D %"PRId64" %s\n", l->mtime, l->path);
+        for (int i = 0; i < l->num_files; i++)
+            bstr_xappend_asprintf(tmp, &data, "F %s\n", l->files[i]);
+        for (int i = 0; i < l->num_dirs; i++)
+            bstr_xappend_asprintf(tmp, &data, "S %s\n", l->dirs[i]);
+    }
+
+    mp_mkdirp(bstrto0(tmp, mp_dirname(filename)));
+    FILE *out = fopen(filename, "wb");
+    bool ok = out && fwrite(data.start, data.len, 1, out) == 1;
+    if (out)
+        ok &= fclose(out) == 0;
+    if (!ok)
+        MP_WARN(p, "Could not write directory listing cache '%s'.\n", filename);
+    talloc_free(tmp);
 }
 
 static int parse_dir(struct pl_parser *p)
@@ -372,17 +712,54 @@ static int parse_dir(struct pl_parser *p)
     if (!path)
         return -1;
 
-    char **files = NULL;
-    int num_files = 0;
-    struct stat dir_stack[MAX_DIR_STACK];
+    struct dir_job *job = talloc_zero(NULL, struct dir_job);
+    job->path = talloc_strdup(job, path);
+    if (stat(path, &job->dir_stack[0]) != 0) {
+        MP_ERR(p, "Could not read directory.\n");
+        talloc_free(job);
+        return -1;
+    }
+    job->num_dir_stack = 1;
+
+    struct dir_scan *scan = talloc_zero(NULL, struct dir_scan);
+    scan->log = p->log;
+    scan->cancel = p->s->cancel;
+    scan->complete = true;
+    scan->ta_ctx = scan;
+    pthread_mutex_init(&scan->lock, NULL);
+    pthread_cond_init(&scan->wakeup, NULL);
+    job->scan = scan;
+
+    char *cache_file = get_dir_cache_file(scan, p, path);
+    if (cache_file)
+        load_dir_cache(scan, p, cache_file);
+
+    if (p->opts->scan_threads > 1) {
+        scan->pool = mp_thread_pool_create(NULL, 1, 1, p->opts->scan_threads);
+        if (!scan->pool)
+            MP_WARN(p, "Could not create threads, scanning directly.\n");
+    }
 
-    scan_dir(p, path, dir_stack, 0, &files, &num_files);
+    queue_dir_job(scan, job);
 
-    if (files)
-        qsort(files, num_files, sizeof(files[0]), cmp_filename);
+    pthread_mutex_lock(&scan->lock);
+    while (scan->pending)
+        pthread_cond_wait(&scan->wakeup, &scan->lock);
+    pthread_mutex_unlock(&scan->lock);
+    TA_FREEP(&scan->pool);
 
-    for (int n = 0; n < num_files; n++)
-        playlist_add_file(p->pl, files[n]);
+    mp_natural_sort_strings(scan->files, scan->num_files);
+
+    for (int n = 0; n < scan->num_files; n++)
+        playlist_add_file(p->pl, scan->files[n]);
+
+    if (cache_file && scan->complete)
+        save_dir_cache(scan, p, cache_file);
+
+    int num_files = scan->num_files;
+    pthread_cond_destroy(&scan->wakeup);
+    pthread_mutex_destroy(&scan->lock);
+    talloc_free(scan);
 
     p->add_base = false;
 
@@ -435,8 +812,11 @@ static int open_file(struct demuxer *demuxer, enum demux_check check)
 
     struct pl_parser *p = talloc_zero(NULL, struct pl_parser);
     p->log = demuxer->log;
+    p->global = demuxer->global;
+    p->opts = mp_get_config_group(p, demuxer->global, &demux_playlist_conf);
     p->pl = talloc_zero(p, struct playlist);
     p->real_stream = demuxer->stream;
+    p->stream_origin = demuxer->stream_origin;
     p->add_base = true;
 
     char probe[PROBE_SIZE];
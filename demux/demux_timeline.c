@@ -16,22 +16,45 @@
  */
 
 #include <assert.h>
+#include <float.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include "common/common.h"
 #include "common/msg.h"
+#include "misc/thread_tools.h"
+#include "options/m_config.h"
+#include "options/m_option.h"
+#include "osdep/atomic.h"
+#include "osdep/threads.h"
 
 #include "demux.h"
 #include "timeline.h"
 #include "stheader.h"
 #include "stream/stream.h"
 
+struct demux_timeline_opts {
+    double prefetch;
+    int segment_cache;
+};
+
+#define OPT_BASE_STRUCT struct demux_timeline_opts
+const struct m_sub_options demux_timeline_conf = {
+    .opts = (const m_option_t[]) {
+        {"prefetch", OPT_DOUBLE(prefetch), M_RANGE(0, DBL_MAX)},
+        {"segment-cache", OPT_INT(segment_cache), M_RANGE(0, 100)},
+        {0}
+    },
+    .size = sizeof(struct demux_timeline_opts),
+};
+
 struct segment {
     int index; // index into virtual_source.segments[] (and timeline.parts[])
     double start, end;
     double d_start;
     char *url;
     bool lazy;
+    uint64_t last_used;
     struct demuxer *d;
     // stream_map[sh_stream.index] = virtual_stream, where sh_stream is a stream
     // from the source d, and virtual_stream is a streamexported by the
@@ -74,12 +97,33 @@ struct virtual_source {
     bool any_selected;          // at least one stream is actually selected
 
     struct demux_packet *next;
+
+    struct segment_prefetch *prefetch;
+};
+
+// Opens a lazy segment on a separate thread.
+struct segment_prefetch {
+    struct segment *seg;
+    char *url;
+    struct demuxer_params params;
+    struct mp_cancel *cancel;
+    struct mpv_global *global;
+    pthread_t thread;
+    atomic_bool done;
+    struct demuxer *d;          // result; valid after the thread was joined
 };
 
 struct priv {
     struct timeline *tl;
     bool owns_tl;
 
+    struct demux_timeline_opts *opts;
+    uint64_t use_counter;       // for segment.last_used
+
+    // Parent of all demuxers opened by prefetching. Triggered on close only,
+    // and must outlive these demuxers.
+    struct mp_cancel *prefetch_cancel;
+
     double duration;
 
     // As the demuxer user sees it.
@@ -190,23 +234,104 @@ static void reselect_streams(struct demuxer *demuxer)
     }
 }
 
+// Unload segments other than the current one, except the keep most recently
+// used ones.
 static void close_lazy_segments(struct demuxer *demuxer,
-                                struct virtual_source *src)
+                                struct virtual_source *src, int keep)
 {
-    // unload previous segment
-    for (int n = 0; n < src->num_segments; n++) {
-        struct segment *seg = src->segments[n];
-        if (seg != src->current && seg->d && seg->lazy) {
-            TA_FREEP(&src->next); // might depend on one of the sub-demuxers
-            demux_free(seg->d);
-            seg->d = NULL;
+    while (1) {
+        struct segment *lru = NULL;
+        int num_open = 0;
+        for (int n = 0; n < src->num_segments; n++) {
+            struct segment *seg = src->segments[n];
+            if (seg != src->current && seg->d && seg->lazy) {
+                num_open++;
+                if (!lru || seg->last_used < lru->last_used)
+                    lru = seg;
+            }
         }
+        if (num_open <= keep)
+            break;
+        TA_FREEP(&src->next); // might depend on one of the sub-demuxers
+        demux_free(lru->d);
+        lru->d = NULL;
     }
 }
 
+static void *prefetch_thread(void *ptr)
+{
+    struct segment_prefetch *pf = ptr;
+    mpthread_set_name("timeline/prefetch");
+
+    pf->d = demux_open_url(pf->url, &pf->params, pf->cancel, pf->global);
+
+    atomic_store(&pf->done, true);
+    return NULL;
+}
+
+// Open the given lazy segment in the background, so that switching to it
+// does not block on opening the demuxer.
+static void start_prefetch(struct demuxer *demuxer, struct virtual_source *src,
+                           struct segment *seg)
+{
+    struct priv *p = demuxer->priv;
+
+    if (src->prefetch || seg->d || !seg->lazy)
+        return;
+
+    struct segment_prefetch *pf = talloc_zero(NULL, struct segment_prefetch);
+    pf->seg = seg;
+    pf->url = talloc_strdup(pf, seg->url);
+    pf->params = (struct demuxer_params){
+        .init_fragment = src->tl->init_fragment,
+        .skip_lavf_probing = src->tl->dash,
+        .stream_flags = demuxer->stream_origin,
+    };
+    pf->cancel = p->prefetch_cancel;
+    pf->global = demuxer->global;
+    atomic_init(&pf->done, false);
+
+    if (pthread_create(&pf->thread, NULL, prefetch_thread, pf)) {
+        talloc_free(pf);
+        return;
+    }
+
+    MP_VERBOSE(demuxer, "prefetching segment %d\n", seg->index);
+    src->prefetch = pf;
+}
+
+// Wait for the prefetch thread and hand the demuxer to its segment. If block
+// is false, do nothing, unless the thread has finished already.
+static void finish_prefetch(struct demuxer *demuxer, struct virtual_source *src,
+                            bool block)
+{
+    struct segment_prefetch *pf = src->prefetch;
+
+    if (!pf || (!block && !atomic_load(&pf->done)))
+        return;
+
+    pthread_join(pf->thread, NULL);
+    src->prefetch = NULL;
+
+    struct segment *seg = pf->seg;
+    if (pf->d && !seg->d) {
+        seg->d = pf->d;
+        update_slave_stats(demuxer, seg->d);
+        associate_streams(demuxer, src, seg);
+    } else if (pf->d) {
+        demux_free(pf->d);
+    }
+    talloc_free(pf);
+}
+
 static void reopen_lazy_segments(struct demuxer *demuxer,
                                  struct virtual_source *src)
 {
+    struct priv *p = demuxer->priv;
+
+    if (src->prefetch)
+        finish_prefetch(demuxer, src, src->prefetch->seg == src->current);
+
     if (src->current->d)
         return;
 
@@ -214,7 +339,7 @@ static void reopen_lazy_segments(struct demuxer *demuxer,
     // because demuxed packets have demux_packet.codec set to objects owned
     // by the segments. Closing them would create dangling pointers.
     if (!src->delay_open)
-        close_lazy_segments(demuxer, src);
+        close_lazy_segments(demuxer, src, p->opts->segment_cache);
 
     struct demuxer_params params = {
         .init_fragment = src->tl->init_fragment,
@@ -234,6 +359,8 @@ static void switch_segment(struct demuxer *demuxer, struct virtual_source *src,
                            struct segment *new, double start_pts, int flags,
                            bool init)
 {
+    struct priv *p = demuxer->priv;
+
     if (!(flags & SEEK_FORWARD))
         flags |= SEEK_HR;
 
@@ -243,6 +370,7 @@ static void switch_segment(struct demuxer *demuxer, struct virtual_source *src,
         update_slave_stats(demuxer, src->current->d);
 
     src->current = new;
+    new->last_used = ++p->use_counter;
     reopen_lazy_segments(demuxer, src);
     if (!new->d)
         return;
@@ -358,6 +486,11 @@ static void do_read_next_packet(struct demuxer *demuxer,
     if (src->dts == MP_NOPTS_VALUE || (dts != MP_NOPTS_VALUE && dts > src->dts))
         src->dts = dts;
 
+    struct priv *p = demuxer->priv;
+    if (p->opts->prefetch > 0 && seg->index + 1 < src->num_segments &&
+        src->dts != MP_NOPTS_VALUE && src->dts >= seg->end - p->opts->prefetch)
+        start_prefetch(demuxer, src, src->segments[seg->index + 1]);
+
     pkt->stream = vs->sh->index;
     src->next = pkt;
     return;
@@ -642,6 +775,10 @@ static int d_open(struct demuxer *demuxer, enum demux_check check)
     if (!p->tl || p->tl->num_pars < 1)
         return -1;
 
+    p->opts = mp_get_config_group(p, demuxer->global, &demux_timeline_conf);
+    p->prefetch_cancel = mp_cancel_new(p);
+    mp_cancel_set_parent(p->prefetch_cancel, demuxer->cancel);
+
     demuxer->chapters = p->tl->chapters;
     demuxer->num_chapters = p->tl->num_chapters;
 
@@ -688,12 +825,16 @@ static void d_close(struct demuxer *demuxer)
 {
     struct priv *p = demuxer->priv;
 
+    if (p->prefetch_cancel)
+        mp_cancel_trigger(p->prefetch_cancel);
+
     for (int x = 0; x < p->num_sources; x++) {
         struct virtual_source *src = p->sources[x];
 
         src->current = NULL;
         TA_FREEP(&src->next);
-        close_lazy_segments(demuxer, src);
+        finish_prefetch(demuxer, src, true);
+        close_lazy_segments(demuxer, src, 0);
     }
 
     if (p->owns_tl) {
@@ -30,7 +30,9 @@
 
 #include <libavutil/intfloat.h>
 #include <libavutil/common.h>
+#include <libavutil/intreadwrite.h>
 #include "mpv_talloc.h"
+#include "common/common.h"
 #include "ebml.h"
 #include "stream/stream.h"
 #include "common/msg.h"
@@ -55,12 +57,76 @@ bool ebml_is_mkv_level1_id(uint32_t id)
     }
 }
 
+/*
+ * Parse an EBML variable length number from memory. The marker bit is kept if
+ * keep_marker is set (for element IDs). This uses a single unaligned load if at
+ * least 8 bytes are available.
+ * Return: number of bytes used (1-8), or 0 if invalid or size is too small.
+ */
+static int parse_vint(const uint8_t *buf, size_t size, bool keep_marker,
+                      uint64_t *out)
+{
+    if (!size || !buf[0])
+        return 0;
+    int len = 8 - av_log2(buf[0]);
+    if (len > size)
+        return 0;
+    uint64_t v;
+    if (size >= 8) {
+        v = AV_RB64(buf) >> (8 * (8 - len));
+    } else {
+        v = 0;
+        for (int i = 0; i < len; i++)
+            v = (v << 8) | buf[i];
+    }
+    if (!keep_marker)
+        v &= (UINT64_C(1) << (7 * len)) - 1;
+    *out = v;
+    return len;
+}
+
+int ebml_decode_length(const uint8_t *buf, size_t size, uint64_t *out)
+{
+    int len = parse_vint(buf, size, false, out);
+    // All value bits set means "unknown length".
+    if (len && *out == (UINT64_C(1) << (7 * len)) - 1)
+        *out = EBML_UINT_INVALID;
+    return len;
+}
+
+int ebml_decode_signed_length(const uint8_t *buf, size_t size, int64_t *out)
+{
+    uint64_t unum;
+    int len = ebml_decode_length(buf, size, &unum);
+    if (!len)
+        return 0;
+    if (unum == EBML_UINT_INVALID) {
+        *out = EBML_INT_INVALID;
+    } else {
+        *out = unum - ((1LL << ((7 * len) - 1)) - 1);
+    }
+    return len;
+}
+
 /*
  * Read: the element content data ID.
  * Return: the ID.
  */
 uint32_t ebml_read_id(stream_t *s)
 {
+    unsigned int avail;
+    uint8_t *buf = stream_peek_buffered(s, &avail);
+    if (avail >= 8) {
+        uint64_t v;
+        int len = parse_vint(buf, avail, true, &v);
+        if (!len || len > 4) {
+            stream_skip_buffered(s, 1);
+            return EBML_ID_INVALID;
+        }
+        stream_skip_buffered(s, len);
+        return v;
+    }
+
     int i, len_mask = 0x80;
     uint32_t id;
 
@@ -78,6 +144,15 @@ uint32_t ebml_read_id(stream_t *s)
  */
 uint64_t ebml_read_length(stream_t *s)
 {
+    unsigned int avail;
+    uint8_t *buf = stream_peek_buffered(s, &avail);
+    if (avail >= 8) {
+        uint64_t v;
+        int n = ebml_decode_length(buf, avail, &v);
+        stream_skip_buffered(s, MPMAX(n, 1));
+        return n ? v : EBML_UINT_INVALID;
+    }
+
     int i, j, num_ffs = 0, len_mask = 0x80;
     uint64_t len;
 
@@ -256,34 +331,14 @@ static uint32_t ebml_parse_id(uint8_t *data, size_t data_len, int *length)
 
 static uint64_t ebml_parse_length(uint8_t *data, size_t data_len, int *length)
 {
-    *length = -1;
-    uint8_t *end = data + data_len;
-    if (data == end)
-        return -1;
-    uint64_t r = *data++;
-    int len = 1;
-    int len_mask;
-    for (len_mask = 0x80; !(r & len_mask); len_mask >>= 1) {
-        len++;
-        if (len > 8)
-            return -1;
-    }
-    r &= len_mask - 1;
-
-    int num_allones = 0;
-    if (r == len_mask - 1)
-        num_allones++;
-    for (int i = 1; i < len; i++) {
-        if (data == end)
-            return -1;
-        if (*data == 255)
-            num_allones++;
-        r = (r << 8) | *data++;
-    }
-    // According to Matroska specs this means "unknown length"
+    uint64_t r;
+    int len = ebml_decode_length(data, data_len, &r);
+    // EBML_UINT_INVALID means "unknown length" according to Matroska specs.
     // Could be supported if there are any actual files using it
-    if (num_allones == len)
+    if (!len || r == EBML_UINT_INVALID) {
+        *length = -1;
         return -1;
+    }
     *length = len;
     return r;
 }
@@ -84,6 +84,8 @@ uint64_t ebml_read_length (stream_t *s);
 int64_t ebml_read_signed_length(stream_t *s);
 uint64_t ebml_read_uint (stream_t *s);
 int64_t ebml_read_int (stream_t *s);
+int ebml_decode_length(const uint8_t *buf, size_t size, uint64_t *out);
+int ebml_decode_signed_length(const uint8_t *buf, size_t size, int64_t *out);
 int ebml_read_skip(struct mp_log *log, int64_t end, stream_t *s);
 int ebml_resync_cluster(struct mp_log *log, stream_t *s);
 
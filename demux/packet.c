@@ -19,18 +19,52 @@
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <libavcodec/avcodec.h>
 #include <libavutil/intreadwrite.h>
 
 #include "config.h"
 
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #include "common/av_common.h"
 #include "common/common.h"
+#include "common/stats.h"
 #include "demux.h"
 
 #include "packet.h"
 
+// Unused AVPacket structs, kept for reuse, since every packet needs one.
+#define MAX_FREE_AVPACKETS 256
+static pthread_mutex_t free_avpackets_lock = PTHREAD_MUTEX_INITIALIZER;
+static AVPacket *free_avpackets[MAX_FREE_AVPACKETS];
+static int num_free_avpackets;
+
+static AVPacket *avpacket_alloc(void)
+{
+    AVPacket *pkt = NULL;
+    pthread_mutex_lock(&free_avpackets_lock);
+    if (num_free_avpackets)
+        pkt = free_avpackets[--num_free_avpackets];
+    pthread_mutex_unlock(&free_avpackets_lock);
+    return pkt ? pkt : av_packet_alloc();
+}
+
+static void avpacket_free(AVPacket **pkt)
+{
+    av_packet_unref(*pkt);
+    pthread_mutex_lock(&free_avpackets_lock);
+    if (num_free_avpackets < MAX_FREE_AVPACKETS) {
+        free_avpackets[num_free_avpackets++] = *pkt;
+        *pkt = NULL;
+    }
+    pthread_mutex_unlock(&free_avpackets_lock);
+    av_packet_free(pkt);
+}
+
 // Free any refcounted data dp holds (but don't free dp itself). This does not
 // care about pointers that are _not_ refcounted (like demux_packet.codec).
 // Normally, a user should use talloc_free(dp). This function is only for
@@ -39,7 +73,7 @@ void demux_packet_unref_contents(struct demux_packet *dp)
 {
     if (dp->avpacket) {
         assert(!dp->is_cached);
-        av_packet_free(&dp->avpacket);
+        avpacket_free(&dp->avpacket);
         dp->buffer = NULL;
         dp->len = 0;
     }
@@ -51,13 +85,9 @@ static void packet_destroy(void *ptr)
     demux_packet_unref_contents(dp);
 }
 
-// This actually preserves only data and side data, not PTS/DTS/pos/etc.
-// It also allows avpkt->data==NULL with avpkt->size!=0 - the libavcodec API
-// does not allow it, but we do it to simplify new_demux_packet().
-struct demux_packet *new_demux_packet_from_avpacket(struct AVPacket *avpkt)
+// Allocate a packet with a blank dp->avpacket.
+static struct demux_packet *packet_alloc(void)
 {
-    if (avpkt->size > 1000000000)
-        return NULL;
     struct demux_packet *dp = talloc(NULL, struct demux_packet);
     talloc_set_destructor(dp, packet_destroy);
     *dp = (struct demux_packet) {
@@ -68,12 +98,25 @@ struct demux_packet *new_demux_packet_from_avpacket(struct AVPacket *avpkt)
         .start = MP_NOPTS_VALUE,
         .end = MP_NOPTS_VALUE,
         .stream = -1,
-        .avpacket = av_packet_alloc(),
+        .avpacket = avpacket_alloc(),
     };
-    int r = -1;
-    if (!dp->avpacket) {
-        // error
-    } else if (avpkt->data) {
+    if (!dp->avpacket)
+        TA_FREEP(&dp);
+    return dp;
+}
+
+// This actually preserves only data and side data, not PTS/DTS/pos/etc.
+// It also allows avpkt->data==NULL with avpkt->size!=0 - the libavcodec API
+// does not allow it, but we do it to simplify new_demux_packet().
+struct demux_packet *new_demux_packet_from_avpacket(struct AVPacket *avpkt)
+{
+    if (avpkt->size > 1000000000)
+        return NULL;
+    struct demux_packet *dp = packet_alloc();
+    if (!dp)
+        return NULL;
+    int r;
+    if (avpkt->data) {
         // We hope that this function won't need/access AVPacket input padding,
         // because otherwise new_demux_packet_from() wouldn't work.
         r = av_packet_ref(dp->avpacket, avpkt);
@@ -89,6 +132,30 @@ struct demux_packet *new_demux_packet_from_avpacket(struct AVPacket *avpkt)
     return dp;
 }
 
+// Like new_demux_packet_from_avpacket(), but move the avpkt reference into the
+// new packet (avpkt is reset to a blank packet on success). If avpkt is
+// refcounted, this avoids creating a new reference and copying side data.
+// All AVPacket fields remain available in dp->avpacket. On failure, avpkt is
+// not changed.
+struct demux_packet *new_demux_packet_from_avpacket_move(struct AVPacket *avpkt)
+{
+    if (!avpkt->buf || !avpkt->data) {
+        struct demux_packet *dp = new_demux_packet_from_avpacket(avpkt);
+        if (dp)
+            av_packet_unref(avpkt);
+        return dp;
+    }
+    if (avpkt->size > 1000000000)
+        return NULL;
+    struct demux_packet *dp = packet_alloc();
+    if (!dp)
+        return NULL;
+    av_packet_move_ref(dp->avpacket, avpkt);
+    dp->buffer = dp->avpacket->data;
+    dp->len = dp->avpacket->size;
+    return dp;
+}
+
 // (buf must include proper padding)
 struct demux_packet *new_demux_packet_from_buf(struct AVBufferRef *buf)
 {
@@ -119,6 +186,70 @@ struct demux_packet *new_demux_packet(size_t len)
     return new_demux_packet_from_avpacket(&pkt);
 }
 
+// Buffer sizes (including padding) are rounded up to a power of 2, and each
+// size has its own pool. Larger buffers are always allocated directly.
+#define POOL_MIN_SHIFT 8    // 256 bytes
+#define POOL_MAX_SHIFT 16   // 64 KiB
+#define POOL_NUM_SIZES (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+
+struct demux_packet_pool {
+    struct stats_ctx *stats;
+    AVBufferPool *pools[POOL_NUM_SIZES];
+};
+
+static void pool_destroy(void *ptr)
+{
+    struct demux_packet_pool *pool = ptr;
+    // Buffers still in use stay valid; the pools are freed with the last one.
+    for (int n = 0; n < POOL_NUM_SIZES; n++)
+        av_buffer_pool_uninit(&pool->pools[n]);
+}
+
+struct demux_packet_pool *demux_packet_pool_create(void *ta_parent,
+                                                   struct mpv_global *global)
+{
+    struct demux_packet_pool *pool = talloc_zero(ta_parent,
+                                                 struct demux_packet_pool);
+    talloc_set_destructor(pool, pool_destroy);
+    pool->stats = stats_ctx_create(pool, global, "demuxer/packet-pool");
+    for (int n = 0; n < POOL_NUM_SIZES; n++) {
+        pool->pools[n] = av_buffer_pool_init(1 << (POOL_MIN_SHIFT + n), NULL);
+        if (!pool->pools[n])
+            abort();
+    }
+    return pool;
+}
+
+// Return a buffer with size bytes of (uninitialized) data, followed by padding
+// bytes set to 0. The buffer is returned to the pool when the last reference
+// to it is released, which may happen on any thread. pool==NULL is allowed.
+struct AVBufferRef *demux_packet_pool_get_buffer(struct demux_packet_pool *pool,
+                                                 size_t size, size_t padding)
+{
+    if (size > INT_MAX - padding)
+        return NULL;
+
+    AVBufferRef *buf = NULL;
+    size_t total = size + padding;
+    if (pool && total <= (1 << POOL_MAX_SHIFT)) {
+        int n = 0;
+        while ((1 << (POOL_MIN_SHIFT + n)) < total)
+            n++;
+        buf = av_buffer_pool_get(pool->pools[n]);
+        stats_event(pool->stats, "pooled");
+    } else {
+        buf = av_buffer_alloc(total);
+        if (pool)
+            stats_event(pool->stats, "unpooled");
+    }
+    if (!buf)
+        return NULL;
+
+    buf->size = size;
+    memset(buf->data + size, 0, padding);
+    return buf;
+}
+
 void demux_packet_shorten(struct demux_packet *dp, size_t len)
 {
     assert(len <= dp->len);
@@ -164,6 +295,25 @@ struct demux_packet *demux_copy_packet(struct demux_packet *dp)
     return new;
 }
 
+// Like demux_copy_packet(), but move the refcounted data of dp to the new
+// packet, which avoids creating a new reference (and copying the side data).
+// dp is left without data. Returns NULL if dp's data is not refcounted.
+struct demux_packet *demux_move_packet(struct demux_packet *dp)
+{
+    if (!dp->avpacket || !dp->avpacket->buf)
+        return NULL;
+    struct demux_packet *new = new_demux_packet_from_avpacket_move(dp->avpacket);
+    if (!new)
+        return NULL;
+    // (Can point into the middle of the buffer, e.g. with mkv lacing.)
+    new->buffer = dp->buffer;
+    new->len = dp->len;
+    demux_packet_copy_attribs(new, dp);
+    dp->buffer = NULL;
+    dp->len = 0;
+    return new;
+}
+
 #define ROUND_ALLOC(s) MP_ALIGN_UP((s), 16)
 
 // Attempt to estimate the total memory consumption of the given packet.
@@ -224,3 +374,71 @@ int demux_packet_add_blockadditional(struct demux_packet *dp, uint64_t id,
         memcpy(sd + 8, data, size);
     return 0;
 }
+
+// Packets smaller than this are not worth compressing.
+#define MIN_COMPRESS_SIZE 256
+
+// Replace the packet data with a compressed copy; side data is not touched.
+// Returns false if this is not possible or doesn't save memory. The packet can
+// not be used directly anymore; use demux_packet_decompress() to access it.
+bool demux_packet_compress(struct demux_packet *dp)
+{
+#if HAVE_ZLIB
+    if (dp->is_cached || dp->is_compressed || !dp->avpacket ||
+        dp->len < MIN_COMPRESS_SIZE || dp->len > UINT32_MAX)
+        return false;
+
+    uLongf dst_len = compressBound(dp->len);
+    AVBufferRef *buf = av_buffer_alloc(4 + dst_len);
+    if (!buf)
+        return false;
+
+    // (Z_BEST_SPEED, because this runs on the demuxer thread.)
+    if (compress2(buf->data + 4, &dst_len, dp->buffer, dp->len,
+                  Z_BEST_SPEED) != Z_OK || 4 + dst_len >= dp->len ||
+        av_buffer_realloc(&buf, 4 + dst_len) < 0)
+    {
+        av_buffer_unref(&buf);
+        return false;
+    }
+    AV_WL32(buf->data, dp->len);
+
+    // Other references (e.g. packets owned by a decoder) are independent.
+    av_buffer_unref(&dp->avpacket->buf);
+    dp->avpacket->buf = buf;
+    dp->avpacket->data = buf->data;
+    dp->avpacket->size = buf->size;
+    dp->buffer = dp->avpacket->data;
+    dp->len = dp->avpacket->size;
+    dp->is_compressed = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Return a new, uncompressed copy of a packet compressed with
+// demux_packet_compress(), or NULL on failure.
+struct demux_packet *demux_packet_decompress(struct demux_packet *dp)
+{
+    assert(dp->is_compressed);
+#if HAVE_ZLIB
+    if (dp->len < 4)
+        return NULL;
+    uLongf len = AV_RL32(dp->buffer);
+    struct demux_packet *new = new_demux_packet(len);
+    if (!new)
+        return NULL;
+    if (uncompress(new->buffer, &len, dp->buffer + 4, dp->len - 4) != Z_OK ||
+        len != new->len ||
+        av_packet_copy_props(new->avpacket, dp->avpacket) < 0)
+    {
+        talloc_free(new);
+        return NULL;
+    }
+    demux_packet_copy_attribs(new, dp);
+    return new;
+#else
+    return NULL;
+#endif
+}
@@ -52,6 +52,8 @@ typedef struct demux_packet {
 
     // If true, cached_data is valid, while buffer/len are not.
     bool is_cached : 1;
+    // If true, buffer/len contain compressed data (demux_packet_compress()).
+    bool is_compressed : 1;
 
     // segmentation (ordered chapters, EDL)
     bool segmented;
@@ -68,11 +70,13 @@ struct AVBufferRef;
 
 struct demux_packet *new_demux_packet(size_t len);
 struct demux_packet *new_demux_packet_from_avpacket(struct AVPacket *avpkt);
+struct demux_packet *new_demux_packet_from_avpacket_move(struct AVPacket *avpkt);
 struct demux_packet *new_demux_packet_from(void *data, size_t len);
 struct demux_packet *new_demux_packet_from_buf(struct AVBufferRef *buf);
 void demux_packet_shorten(struct demux_packet *dp, size_t len);
 void free_demux_packet(struct demux_packet *dp);
 struct demux_packet *demux_copy_packet(struct demux_packet *dp);
+struct demux_packet *demux_move_packet(struct demux_packet *dp);
 size_t demux_packet_estimate_total_size(struct demux_packet *dp);
 
 void demux_packet_copy_attribs(struct demux_packet *dst, struct demux_packet *src);
@@ -83,4 +87,14 @@ int demux_packet_add_blockadditional(struct demux_packet *dp, uint64_t id,
 
 void demux_packet_unref_contents(struct demux_packet *dp);
 
+struct mpv_global;
+struct demux_packet_pool;
+struct demux_packet_pool *demux_packet_pool_create(void *ta_parent,
+                                                   struct mpv_global *global);
+struct AVBufferRef *demux_packet_pool_get_buffer(struct demux_packet_pool *pool,
+                                                 size_t size, size_t padding);
+
+bool demux_packet_compress(struct demux_packet *dp);
+struct demux_packet *demux_packet_decompress(struct demux_packet *dp);
+
 #endif /* MPLAYER_DEMUX_PACKET_H */
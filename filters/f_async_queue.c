@@ -4,6 +4,7 @@
 #include "audio/aframe.h"
 #include "common/common.h"
 #include "common/msg.h"
+#include "common/stats.h"
 #include "osdep/atomic.h"
 
 #include "f_async_queue.h"
@@ -20,16 +21,25 @@ struct async_queue {
 
     pthread_mutex_t lock;
 
+    // Written with lock held, but can be read without it. This is for
+    // mp_async_queue_get_samples() and mp_async_queue_get_frames(), which
+    // are polled from the AO thread.
+    mp_atomic_int64 samples_size; // queue size in the cfg.sample_unit
+    atomic_int frame_count; // same as num_frames
+
     // -- protected by lock
     struct mp_async_queue_config cfg;
     bool active; // queue was resumed; consumer may request frames
     bool reading; // data flow: reading => consumer has requested frames
-    int64_t samples_size; // queue size in the cfg.sample_unit
     size_t byte_size; // queue size in bytes (using approx. frame sizes)
     int num_frames;
     struct mp_frame *frames;
     int eof_count; // number of MP_FRAME_EOF in frames[], for draining
     struct mp_filter *conn[2]; // filters: in (0), out (1)
+    // Set if the respective end found nothing to do (queue full for the
+    // writer, queue empty for the reader), and needs a wakeup once the other
+    // end changed this. Avoids cross-thread wakeups for every single frame.
+    bool writer_waiting, reader_waiting;
 };
 
 static void reset_queue(struct async_queue *q)
@@ -39,9 +49,11 @@ static void reset_queue(struct async_queue *q)
     for (int n = 0; n < q->num_frames; n++)
         mp_frame_unref(&q->frames[n]);
     q->num_frames = 0;
+    atomic_store(&q->frame_count, 0);
     q->eof_count = 0;
-    q->samples_size = 0;
+    atomic_store(&q->samples_size, 0);
     q->byte_size = 0;
+    q->writer_waiting = q->reader_waiting = false;
     for (int n = 0; n < 2; n++) {
         if (q->conn[n])
             mp_filter_wakeup(q->conn[n]);
@@ -95,7 +107,8 @@ static int64_t frame_get_samples(struct async_queue *q, struct mp_frame frame)
 
 static bool is_full(struct async_queue *q)
 {
-    if (q->samples_size >= q->cfg.max_samples || q->byte_size >= q->cfg.max_bytes)
+    if (atomic_load(&q->samples_size) >= q->cfg.max_samples ||
+        q->byte_size >= q->cfg.max_bytes)
         return true;
     if (q->num_frames >= 2 && q->cfg.max_duration > 0) {
         double pts1 = mp_frame_get_pts(q->frames[q->num_frames - 1]);
@@ -114,7 +127,7 @@ static void account_frame(struct async_queue *q, struct mp_frame frame,
 {
     assert(dir == 1 || dir == -1);
 
-    q->samples_size += dir * frame_get_samples(q, frame);
+    atomic_fetch_add(&q->samples_size, dir * frame_get_samples(q, frame));
     q->byte_size += dir * mp_frame_approx_size(frame);
 
     if (frame.type == MP_FRAME_EOF)
@@ -124,7 +137,7 @@ static void account_frame(struct async_queue *q, struct mp_frame frame,
 static void recompute_sizes(struct async_queue *q)
 {
     q->eof_count = 0;
-    q->samples_size = 0;
+    atomic_store(&q->samples_size, 0);
     q->byte_size = 0;
     for (int n = 0; n < q->num_frames; n++)
         account_frame(q, q->frames[n], 1);
@@ -206,27 +219,39 @@ void mp_async_queue_resume_reading(struct mp_async_queue *queue)
 
 int64_t mp_async_queue_get_samples(struct mp_async_queue *queue)
 {
-    struct async_queue *q = queue->q;
-    pthread_mutex_lock(&q->lock);
-    int64_t res = q->samples_size;
-    pthread_mutex_unlock(&q->lock);
-    return res;
+    return atomic_load(&queue->q->samples_size);
 }
 
 int mp_async_queue_get_frames(struct mp_async_queue *queue)
 {
-    struct async_queue *q = queue->q;
-    pthread_mutex_lock(&q->lock);
-    int res = q->num_frames;
-    pthread_mutex_unlock(&q->lock);
-    return res;
+    return atomic_load(&queue->q->frame_count);
 }
 
 struct priv {
     struct async_queue *q;
     struct mp_filter *notify;
+    struct stats_ctx *stats;
 };
 
+// Lock the queue from one of the access filters, and count how often the
+// other end was holding the lock.
+static void lock_queue(struct priv *p)
+{
+    if (pthread_mutex_trylock(&p->q->lock)) {
+        stats_event(p->stats, "lock-contended");
+        pthread_mutex_lock(&p->q->lock);
+    }
+}
+
+static void wakeup_conn(struct priv *p, int index)
+{
+    struct mp_filter *f = p->q->conn[index];
+    if (f) {
+        stats_event(p->stats, "wakeups");
+        mp_filter_wakeup(f);
+    }
+}
+
 static void destroy(struct mp_filter *f)
 {
     struct priv *p = f->priv;
@@ -248,7 +273,7 @@ static void process_in(struct mp_filter *f)
     struct async_queue *q = p->q;
     assert(q->conn[0] == f);
 
-    pthread_mutex_lock(&q->lock);
+    lock_queue(p);
     if (!q->reading) {
         // mp_async_queue_reset()/reset_queue() is usually called asynchronously,
         // so we might have requested a frame earlier, and now can't use it.
@@ -263,14 +288,20 @@ static void process_in(struct mp_filter *f)
         struct mp_frame frame = mp_pin_out_read(f->ppins[0]);
         account_frame(q, frame, 1);
         MP_TARRAY_INSERT_AT(q, q->frames, q->num_frames, 0, frame);
+        atomic_store(&q->frame_count, q->num_frames);
         // Notify reader that we have new frames.
-        if (q->conn[1])
-            mp_filter_wakeup(q->conn[1]);
+        if (q->reader_waiting) {
+            q->reader_waiting = false;
+            wakeup_conn(p, 1);
+        }
         bool full = is_full(q);
         if (!full)
             mp_pin_out_request_data_next(f->ppins[0]);
+        q->writer_waiting = full;
         if (p->notify && full)
             mp_filter_wakeup(p->notify);
+    } else if (is_full(q)) {
+        q->writer_waiting = true;
     }
     if (p->notify && !q->num_frames)
         mp_filter_wakeup(p->notify);
@@ -286,20 +317,26 @@ static void process_out(struct mp_filter *f)
     if (!mp_pin_in_needs_data(f->ppins[0]))
         return;
 
-    pthread_mutex_lock(&q->lock);
+    lock_queue(p);
     if (q->active && !q->reading) {
         q->reading = true;
-        mp_filter_wakeup(q->conn[0]);
+        wakeup_conn(p, 0);
     }
     if (q->active && q->num_frames) {
         struct mp_frame frame = q->frames[q->num_frames - 1];
         q->num_frames -= 1;
+        atomic_store(&q->frame_count, q->num_frames);
         account_frame(q, frame, -1);
-        assert(q->samples_size >= 0);
+        assert(atomic_load(&q->samples_size) >= 0);
         mp_pin_in_write(f->ppins[0], frame);
-        // Notify writer that we need new frames.
-        if (q->conn[0])
-            mp_filter_wakeup(q->conn[0]);
+        // Notify writer that we need new frames. Also if the queue ran empty,
+        // for mp_async_queue_set_notifier().
+        if ((q->writer_waiting && !is_full(q)) || !q->num_frames) {
+            q->writer_waiting = false;
+            wakeup_conn(p, 0);
+        }
+    } else {
+        q->reader_waiting = true;
     }
     pthread_mutex_unlock(&q->lock);
 }
@@ -357,6 +394,7 @@ struct mp_filter *mp_async_queue_create_filter(struct mp_filter *parent,
         return NULL;
 
     struct priv *p = f->priv;
+    p->stats = stats_ctx_create(f, f->global, "async-queue");
 
     struct async_queue *q = queue->q;
 
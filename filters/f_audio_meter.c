@@ -0,0 +1,533 @@
+#include <math.h>
+#include <string.h>
+
+#include "audio/aframe.h"
+#include "audio/format.h"
+#include "common/common.h"
+#include "common/msg.h"
+#include "options/m_config.h"
+#include "options/m_option.h"
+
+#include "f_audio_meter.h"
+#include "filter_internal.h"
+
+struct mp_audio_meter_opts {
+    double rate;
+    bool loudness;
+};
+
+#define OPT_BASE_STRUCT struct mp_audio_meter_opts
+const struct m_sub_options audio_meter_conf = {
+    .opts = (const struct m_option[]){
+        {"audio-meter-rate", OPT_DOUBLE(rate), M_RANGE(0, 1000)},
+        {"audio-meter-loudness", OPT_BOOL(loudness)},
+        {0}
+    },
+    .size = sizeof(OPT_BASE_STRUCT),
+};
+
+// Number of samples converted to float and measured at once.
+#define CHUNK 1024
+
+// Independent partial sums, so that the compiler can vectorize the loops
+// without reassociating floating point operations.
+#define LANES 8
+
+// True peak as in ITU-R BS.1770-4 Annex 2: 4x oversampling (2x above 96 kHz,
+// none above 192 kHz), with a windowed sinc interpolator.
+#define TP_TAPS 12 // per phase
+#define TP_MAX_FACTOR 4
+
+// EBU R128 loudness is computed from 100 ms sub-blocks. Momentary loudness
+// uses the last 4, short-term loudness the last 30.
+#define SUBBLOCKS 30
+#define MOMENTARY_SUBBLOCKS 4
+
+// The integrated loudness gating uses a histogram of the block loudness, with
+// 0.1 LU bins starting at the absolute gate (-70 LUFS).
+#define HIST_BINS 1000
+
+struct biquad {
+    double b0, b1, b2, a1, a2;
+};
+
+struct channel {
+    double weight;          // EBU R128 channel weight (0 for LFE)
+    double kw_state[2][2];  // K-weighting filter state (for each biquad)
+    // Previous samples, followed by the current chunk.
+    float tp_hist[TP_TAPS - 1 + CHUNK];
+    // Accumulated for the current update interval.
+    float peak, true_peak;
+    double sum_sq;
+};
+
+struct priv {
+    struct m_config_cache *opts_cache;
+    struct mp_audio_meter_opts *opts;
+
+    // Format the state was initialized for (format==0: not initialized).
+    int format, rate;
+    struct mp_chmap chmap;
+
+    struct channel ch[MP_NUM_CHANNELS];
+    float buf[MP_NUM_CHANNELS][CHUNK]; // current chunk, converted to float
+    float tp_acc[CHUNK];
+
+    int tp_factor;
+    float tp_coeffs[TP_MAX_FACTOR][TP_TAPS];
+
+    bool loudness;
+    struct biquad kw[2];
+    int subblock_len;
+    int subblock_pos;
+    double subblock_energy;         // weighted sum of squares
+    double subblocks[SUBBLOCKS];    // ring buffer of mean energies
+    int subblock_idx;               // next write position in subblocks[]
+    int num_subblocks;              // valid entries in subblocks[]
+    double hist_energy[HIST_BINS];
+    int64_t hist_count[HIST_BINS];
+
+    int interval_pos;   // samples measured in the current update interval
+
+    bool valid;
+    struct mp_audio_meter_state state;
+
+    struct mp_audio_meter public;
+};
+
+static double to_db(double v)
+{
+    return v > 0 ? MPMAX(20 * log10(v), MP_AUDIO_METER_FLOOR_DB)
+                 : MP_AUDIO_METER_FLOOR_DB;
+}
+
+static double energy_to_lufs(double e)
+{
+    return e > 0 ? MPMAX(-0.691 + 10 * log10(e), MP_AUDIO_METER_FLOOR_DB)
+                 : MP_AUDIO_METER_FLOOR_DB;
+}
+
+static double channel_weight(int speaker)
+{
+    switch (speaker) {
+    case MP_SPEAKER_ID_LFE:
+    case MP_SPEAKER_ID_LFE2:
+        return 0;
+    case MP_SPEAKER_ID_BL:
+    case MP_SPEAKER_ID_BR:
+    case MP_SPEAKER_ID_SL:
+    case MP_SPEAKER_ID_SR:
+        return 1.41;
+    default:
+        return 1.0;
+    }
+}
+
+// K-weighting filter (pre-filter and RLB high-pass) from ITU-R BS.1770,
+// adapted to the sample rate.
+static void init_kweighting(struct priv *p)
+{
+    double f0 = 1681.974450955533;
+    double G = 3.999843853973347;
+    double Q = 0.7071752369554196;
+    double K = tan(M_PI * f0 / p->rate);
+    double Vh = pow(10.0, G / 20.0);
+    double Vb = pow(Vh, 0.4996667741545416);
+    double a0 = 1.0 + K / Q + K * K;
+    p->kw[0] = (struct biquad){
+        .b0 = (Vh + Vb * K / Q + K * K) / a0,
+        .b1 = 2.0 * (K * K - Vh) / a0,
+        .b2 = (Vh - Vb * K / Q + K * K) / a0,
+        .a1 = 2.0 * (K * K - 1.0) / a0,
+        .a2 = (1.0 - K / Q + K * K) / a0,
+    };
+
+    f0 = 38.13547087602444;
+    Q = 0.5003270373238773;
+    K = tan(M_PI * f0 / p->rate);
+    a0 = 1.0 + K / Q + K * K;
+    p->kw[1] = (struct biquad){
+        .b0 = 1.0,
+        .b1 = -2.0,
+        .b2 = 1.0,
+        .a1 = 2.0 * (K * K - 1.0) / a0,
+        .a2 = (1.0 - K / Q + K * K) / a0,
+    };
+}
+
+static void init_true_peak(struct priv *p)
+{
+    p->tp_factor = p->rate < 96000 ? 4 : p->rate < 192000 ? 2 : 1;
+    int L = p->tp_factor;
+    int taps = L * TP_TAPS;
+    for (int phase = 0; phase < L; phase++) {
+        double sum = 0;
+        for (int k = 0; k < TP_TAPS; k++) {
+            int n = phase + L * k;
+            double t = (n - (taps - 1) / 2.0) / L;
+            double sinc = t == 0 ? 1.0 : sin(M_PI * t) / (M_PI * t);
+            double win = 0.5 - 0.5 * cos(2 * M_PI * (n + 1) / (taps + 1));
+            p->tp_coeffs[phase][k] = sinc * win;
+            sum += sinc * win;
+        }
+        // Unity gain for each phase.
+        for (int k = 0; k < TP_TAPS; k++)
+            p->tp_coeffs[phase][k] /= sum;
+    }
+}
+
+static void reset_loudness(struct priv *p)
+{
+    p->subblock_pos = 0;
+    p->subblock_energy = 0;
+    p->subblock_idx = 0;
+    p->num_subblocks = 0;
+    for (int n = 0; n < p->chmap.num; n++)
+        memset(p->ch[n].kw_state, 0, sizeof(p->ch[n].kw_state));
+}
+
+// (Keeps the gating histogram, so the integrated loudness covers seeks.)
+static void reinit(struct priv *p, int format, int rate, struct mp_chmap *chmap)
+{
+    p->format = format;
+    p->rate = rate;
+    p->chmap = *chmap;
+
+    for (int n = 0; n < chmap->num; n++) {
+        p->ch[n] = (struct channel){
+            .weight = channel_weight(chmap->speaker[n]),
+        };
+    }
+
+    init_kweighting(p);
+    init_true_peak(p);
+    p->subblock_len = MPMAX(rate / 10, 1);
+    reset_loudness(p);
+    p->interval_pos = 0;
+}
+
+static void convert(struct priv *p, uint8_t **planes, int pos, int n)
+{
+    int num_ch = p->chmap.num;
+    bool planar = af_fmt_is_planar(p->format);
+    int stride = planar ? 1 : num_ch;
+    for (int c = 0; c < num_ch; c++) {
+        float *dst = p->buf[c];
+        uint8_t *plane = planes[planar ? c : 0];
+        size_t offset = planar ? pos : pos * (size_t)num_ch + c;
+
+#define CONVERT(type, expr)                                 \
+        do {                                                \
+            const type *src = (const type *)plane + offset; \
+            for (int i = 0; i < n; i++) {                   \
+                type v = src[i * stride];                   \
+                dst[i] = (expr);                            \
+            }                                               \
+        } while (0)
+
+        switch (af_fmt_from_planar(p->format)) {
+        case AF_FORMAT_U8:
+            CONVERT(uint8_t, (v - 128) * (1.0f / 128));
+            break;
+        case AF_FORMAT_S16:
+            CONVERT(int16_t, v * (1.0f / (1 << 15)));
+            break;
+        case AF_FORMAT_S32:
+            CONVERT(int32_t, v * (1.0f / (1u << 31)));
+            break;
+        case AF_FORMAT_S64:
+            CONVERT(int64_t, v * (1.0 / 9223372036854775808.0));
+            break;
+        case AF_FORMAT_FLOAT:
+            CONVERT(float, v);
+            break;
+        case AF_FORMAT_DOUBLE:
+            CONVERT(double, v);
+            break;
+        }
+
+#undef CONVERT
+    }
+}
+
+static void measure_levels(struct channel *ch, const float *src, int n)
+{
+    float sq[LANES] = {0}, pk[LANES] = {0};
+    int i = 0;
+    for (; i + LANES <= n; i += LANES) {
+        for (int l = 0; l < LANES; l++) {
+            float v = src[i + l];
+            float a = fabsf(v);
+            sq[l] += v * v;
+            pk[l] = a > pk[l] ? a : pk[l];
+        }
+    }
+    for (; i < n; i++) {
+        float a = fabsf(src[i]);
+        sq[0] += a * a;
+        pk[0] = a > pk[0] ? a : pk[0];
+    }
+    for (int l = 0; l < LANES; l++) {
+        ch->sum_sq += sq[l];
+        ch->peak = MPMAX(ch->peak, pk[l]);
+    }
+}
+
+static void measure_true_peak(struct priv *p, struct channel *ch,
+                              const float *src, int n)
+{
+    float *x = ch->tp_hist + TP_TAPS - 1;
+    memcpy(x, src, n * sizeof(float));
+
+    float *acc = p->tp_acc;
+    float peak = ch->true_peak;
+    for (int phase = 0; phase < p->tp_factor; phase++) {
+        const float *coeffs = p->tp_coeffs[phase];
+        for (int i = 0; i < n; i++)
+            acc[i] = 0;
+        for (int k = 0; k < TP_TAPS; k++) {
+            float c = coeffs[k];
+            for (int i = 0; i < n; i++)
+                acc[i] += c * x[i - k];
+        }
+        for (int i = 0; i < n; i++) {
+            float a = fabsf(acc[i]);
+            peak = a > peak ? a : peak;
+        }
+    }
+    ch->true_peak = peak;
+
+    memmove(ch->tp_hist, ch->tp_hist + n, (TP_TAPS - 1) * sizeof(float));
+}
+
+static double biquad_run(const struct biquad *bq, double z[2], double x)
+{
+    double y = bq->b0 * x + z[0];
+    z[0] = bq->b1 * x - bq->a1 * y + z[1];
+    z[1] = bq->b2 * x - bq->a2 * y;
+    return y;
+}
+
+static void measure_loudness(struct priv *p, struct channel *ch,
+                             const float *src, int n)
+{
+    if (!ch->weight)
+        return;
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+        double y = biquad_run(&p->kw[0], ch->kw_state[0], src[i]);
+        y = biquad_run(&p->kw[1], ch->kw_state[1], y);
+        sum += y * y;
+    }
+    p->subblock_energy += ch->weight * sum;
+}
+
+// Mean energy of the last num sub-blocks.
+static double mean_energy(struct priv *p, int num)
+{
+    num = MPMIN(num, p->num_subblocks);
+    if (!num)
+        return 0;
+    double sum = 0;
+    for (int n = 1; n <= num; n++)
+        sum += p->subblocks[(p->subblock_idx - n + SUBBLOCKS) % SUBBLOCKS];
+    return sum / num;
+}
+
+static void end_subblock(struct priv *p)
+{
+    p->subblocks[p->subblock_idx] = p->subblock_energy / p->subblock_len;
+    p->subblock_idx = (p->subblock_idx + 1) % SUBBLOCKS;
+    p->num_subblocks = MPMIN(p->num_subblocks + 1, SUBBLOCKS);
+    p->subblock_pos = 0;
+    p->subblock_energy = 0;
+
+    // Gating blocks are 400 ms long, and overlap by 75%.
+    if (p->num_subblocks >= MOMENTARY_SUBBLOCKS) {
+        double e = mean_energy(p, MOMENTARY_SUBBLOCKS);
+        double l = energy_to_lufs(e);
+        if (l > -70) {
+            int bin = MPMIN((int)((l + 70) * 10), HIST_BINS - 1);
+            p->hist_energy[bin] += e;
+            p->hist_count[bin] += 1;
+        }
+    }
+}
+
+// Gated loudness over all blocks (EBU R128 integrated loudness). The relative
+// gate is applied with the precision of the histogram bins.
+static double integrated_loudness(struct priv *p)
+{
+    double sum = 0;
+    int64_t count = 0;
+    for (int n = 0; n < HIST_BINS; n++) {
+        sum += p->hist_energy[n];
+        count += p->hist_count[n];
+    }
+    if (!count)
+        return MP_AUDIO_METER_FLOOR_DB;
+
+    double gate = energy_to_lufs(sum / count) - 10;
+    int first = MPCLAMP((int)ceil((gate + 70) * 10), 0, HIST_BINS);
+    sum = 0;
+    count = 0;
+    for (int n = first; n < HIST_BINS; n++) {
+        sum += p->hist_energy[n];
+        count += p->hist_count[n];
+    }
+    return count ? energy_to_lufs(sum / count) : MP_AUDIO_METER_FLOOR_DB;
+}
+
+static void publish(struct priv *p)
+{
+    struct mp_audio_meter_state *st = &p->state;
+
+    st->chmap = p->chmap;
+    for (int n = 0; n < p->chmap.num; n++) {
+        struct channel *ch = &p->ch[n];
+        st->peak[n] = to_db(ch->peak);
+        st->rms[n] = to_db(sqrt(ch->sum_sq / MPMAX(p->interval_pos, 1)));
+        // (The interpolated signal can be below the sample peak.)
+        st->true_peak[n] = to_db(MPMAX(ch->true_peak, ch->peak));
+        ch->peak = ch->true_peak = 0;
+        ch->sum_sq = 0;
+    }
+
+    st->loudness = p->loudness;
+    if (p->loudness) {
+        st->momentary = energy_to_lufs(mean_energy(p, MOMENTARY_SUBBLOCKS));
+        st->short_term = energy_to_lufs(mean_energy(p, SUBBLOCKS));
+        st->integrated = integrated_loudness(p);
+    }
+
+    p->interval_pos = 0;
+    p->valid = true;
+    p->public.updated = true;
+}
+
+static void measure(struct mp_filter *f, struct mp_aframe *frame)
+{
+    struct priv *p = f->priv;
+
+    int format = mp_aframe_get_format(frame);
+    int rate = mp_aframe_get_rate(frame);
+    struct mp_chmap chmap;
+    if (!af_fmt_is_pcm(format) || rate < 1 ||
+        !mp_aframe_get_chmap(frame, &chmap))
+        return;
+
+    if (format != p->format || rate != p->rate ||
+        !mp_chmap_equals(&chmap, &p->chmap))
+    {
+        MP_VERBOSE(f, "Measuring %d channels at %d Hz.\n", chmap.num, rate);
+        reinit(p, format, rate, &chmap);
+    }
+
+    uint8_t **planes = mp_aframe_get_data_ro(frame);
+    int samples = mp_aframe_get_size(frame);
+    int interval_len = MPMAX(lrint(rate / p->opts->rate), 1);
+
+    for (int pos = 0; pos < samples;) {
+        int n = MPMIN(samples - pos, CHUNK);
+        n = MPMIN(n, MPMAX(interval_len - p->interval_pos, 1));
+        if (p->loudness)
+            n = MPMIN(n, p->subblock_len - p->subblock_pos);
+
+        convert(p, planes, pos, n);
+        for (int c = 0; c < chmap.num; c++) {
+            struct channel *ch = &p->ch[c];
+            measure_levels(ch, p->buf[c], n);
+            if (p->tp_factor > 1)
+                measure_true_peak(p, ch, p->buf[c], n);
+            if (p->loudness)
+                measure_loudness(p, ch, p->buf[c], n);
+        }
+
+        pos += n;
+        p->interval_pos += n;
+        if (p->loudness) {
+            p->subblock_pos += n;
+            if (p->subblock_pos >= p->subblock_len)
+                end_subblock(p);
+        }
+        if (p->interval_pos >= interval_len)
+            publish(p);
+    }
+}
+
+static void update_opts(struct priv *p)
+{
+    if (!p->opts->rate) {
+        p->valid = false;
+        p->format = 0;
+    }
+    if (p->loudness != p->opts->loudness) {
+        p->loudness = p->opts->loudness;
+        reset_loudness(p);
+        memset(p->hist_energy, 0, sizeof(p->hist_energy));
+        memset(p->hist_count, 0, sizeof(p->hist_count));
+    }
+}
+
+static void process(struct mp_filter *f)
+{
+    struct priv *p = f->priv;
+
+    if (!mp_pin_can_transfer_data(f->ppins[1], f->ppins[0]))
+        return;
+
+    struct mp_frame frame = mp_pin_out_read(f->ppins[0]);
+
+    if (frame.type == MP_FRAME_AUDIO) {
+        if (m_config_cache_update(p->opts_cache))
+            update_opts(p);
+        if (p->opts->rate > 0)
+            measure(f, frame.data);
+    }
+
+    mp_pin_in_write(f->ppins[1], frame);
+}
+
+static void reset(struct mp_filter *f)
+{
+    struct priv *p = f->priv;
+
+    // Reinit on the next frame.
+    p->format = 0;
+}
+
+static const struct mp_filter_info audio_meter_filter = {
+    .name = "audio_meter",
+    .priv_size = sizeof(struct priv),
+    .process = process,
+    .reset = reset,
+};
+
+struct mp_audio_meter *mp_audio_meter_create(struct mp_filter *parent)
+{
+    struct mp_filter *f = mp_filter_create(parent, &audio_meter_filter);
+    if (!f)
+        return NULL;
+
+    mp_filter_add_pin(f, MP_PIN_IN, "in");
+    mp_filter_add_pin(f, MP_PIN_OUT, "out");
+
+    struct priv *p = f->priv;
+    p->public.f = f;
+    p->opts_cache = m_config_cache_alloc(f, f->global, &audio_meter_conf);
+    p->opts = p->opts_cache->opts;
+    update_opts(p);
+
+    return &p->public;
+}
+
+bool mp_audio_meter_get(struct mp_audio_meter *m,
+                        struct mp_audio_meter_state *out)
+{
+    struct priv *p = m->f->priv;
+
+    if (!p->valid)
+        return false;
+    *out = p->state;
+    return true;
+}
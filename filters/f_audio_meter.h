@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "audio/chmap.h"
+#include "filter.h"
+
+// Levels reported for silence (instead of -inf).
+#define MP_AUDIO_METER_FLOOR_DB -200.0
+
+struct mp_audio_meter_state {
+    struct mp_chmap chmap;
+    // Per channel, over the last update interval. In dBFS (true_peak in dBTP).
+    double peak[MP_NUM_CHANNELS];
+    double rms[MP_NUM_CHANNELS];
+    double true_peak[MP_NUM_CHANNELS];
+    // EBU R128 loudness in LUFS. Only set if loudness is true.
+    bool loudness;
+    double momentary;
+    double short_term;
+    double integrated;
+};
+
+// Measures the audio passing through it, according to the --audio-meter-*
+// options. Frames are passed through unchanged.
+struct mp_audio_meter {
+    struct mp_filter *f;
+    // Set when new values are available. The API user can reset the flag.
+    bool updated;
+};
+
+struct mp_audio_meter *mp_audio_meter_create(struct mp_filter *parent);
+
+// Return the most recent values. Returns false if the meter is disabled, or
+// nothing was measured yet.
+bool mp_audio_meter_get(struct mp_audio_meter *m,
+                        struct mp_audio_meter_state *out);
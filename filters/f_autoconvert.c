@@ -17,6 +17,15 @@
 #include "filter.h"
 #include "filter_internal.h"
 
+// Number of video converters kept around after a format change, so that
+// switching back (e.g. between tracks or resolutions) doesn't recreate them.
+#define CONV_CACHE_SIZE 4
+
+struct conv_cache_entry {
+    int imgfmt, subfmt;         // input format
+    struct mp_filter *conv;
+};
+
 struct priv {
     struct mp_log *log;
 
@@ -36,6 +45,18 @@ struct priv {
     // sws state
     int in_imgfmt, in_subfmt;
 
+    // Input format sub.filter was built for (if it's set).
+    int conv_imgfmt, conv_subfmt;
+    // Drained converters kept for reuse, oldest first. All were built for
+    // the target formats in cache_imgfmts/cache_subfmts/cache_imgparams.
+    struct conv_cache_entry conv_cache[CONV_CACHE_SIZE];
+    int num_conv_cache;
+    int *cache_imgfmts;
+    int *cache_subfmts;
+    int cache_num_imgfmts;
+    struct mp_image_params cache_imgparams;
+    bool cache_imgparams_set;
+
     int *afmts;
     int num_afmts;
     int *srates;
@@ -285,6 +306,65 @@ bool mp_autoconvert_probe_input_video(struct mp_autoconvert *c,
     return res;
 }
 
+static void flush_conv_cache(struct priv *p)
+{
+    for (int n = 0; n < p->num_conv_cache; n++)
+        talloc_free(p->conv_cache[n].conv);
+    p->num_conv_cache = 0;
+}
+
+// Flush the converter cache if the conversion targets changed since the
+// cached converters were built.
+static void check_conv_cache(struct priv *p)
+{
+    bool same = p->cache_num_imgfmts == p->num_imgfmts &&
+        (!p->num_imgfmts ||
+         (!memcmp(p->cache_imgfmts, p->imgfmts, p->num_imgfmts * sizeof(int)) &&
+          !memcmp(p->cache_subfmts, p->subfmts, p->num_imgfmts * sizeof(int)))) &&
+        p->cache_imgparams_set == p->imgparams_set &&
+        (!p->imgparams_set ||
+         mp_image_params_equal(&p->cache_imgparams, &p->imgparams));
+    if (same)
+        return;
+
+    flush_conv_cache(p);
+    talloc_free(p->cache_imgfmts);
+    talloc_free(p->cache_subfmts);
+    p->cache_imgfmts = talloc_memdup(p, p->imgfmts, p->num_imgfmts * sizeof(int));
+    p->cache_subfmts = talloc_memdup(p, p->subfmts, p->num_imgfmts * sizeof(int));
+    p->cache_num_imgfmts = p->num_imgfmts;
+    p->cache_imgparams = p->imgparams;
+    p->cache_imgparams_set = p->imgparams_set;
+}
+
+static void add_conv_cache(struct priv *p, struct mp_filter *conv)
+{
+    if (p->num_conv_cache == CONV_CACHE_SIZE) {
+        talloc_free(p->conv_cache[0].conv);
+        MP_TARRAY_REMOVE_AT(p->conv_cache, p->num_conv_cache, 0);
+    }
+    p->conv_cache[p->num_conv_cache++] = (struct conv_cache_entry){
+        .imgfmt = p->conv_imgfmt,
+        .subfmt = p->conv_subfmt,
+        .conv = conv,
+    };
+}
+
+static struct mp_filter *take_conv_cache(struct priv *p, struct mp_image *img)
+{
+    for (int n = p->num_conv_cache - 1; n >= 0; n--) {
+        struct conv_cache_entry *e = &p->conv_cache[n];
+        if (e->imgfmt == img->params.imgfmt &&
+            e->subfmt == img->params.hw_subfmt)
+        {
+            struct mp_filter *conv = e->conv;
+            MP_TARRAY_REMOVE_AT(p->conv_cache, p->num_conv_cache, n);
+            return conv;
+        }
+    }
+    return NULL;
+}
+
 static void handle_video_frame(struct mp_filter *f)
 {
     struct priv *p = f->priv;
@@ -299,22 +379,34 @@ static void handle_video_frame(struct mp_filter *f)
         return;
     }
 
-    if (!mp_subfilter_drain_destroy(&p->sub)) {
+    struct mp_filter *old = NULL;
+    if (!mp_subfilter_drain_detach(&p->sub, &old)) {
         p->in_imgfmt = p->in_subfmt = 0;
         return;
     }
 
+    // The old converter was built for the old targets; keep it only if they
+    // didn't change.
+    if (old)
+        add_conv_cache(p, old);
+    check_conv_cache(p);
+
     p->in_imgfmt = img->params.imgfmt;
     p->in_subfmt = img->params.hw_subfmt;
     p->force_update = false;
 
-    struct mp_filter *conv = NULL;
-    if (build_image_converter(&p->public, p->log, img, &conv)) {
-        p->sub.filter = conv;
-        mp_subfilter_continue(&p->sub);
-    } else {
+    struct mp_filter *conv = take_conv_cache(p, img);
+    if (conv) {
+        MP_VERBOSE(p, "Reusing converter for %s\n",
+                   mp_imgfmt_to_name(img->imgfmt));
+    } else if (!build_image_converter(&p->public, p->log, img, &conv)) {
         mp_filter_internal_mark_failed(f);
+        return;
     }
+    p->sub.filter = conv;
+    p->conv_imgfmt = p->in_imgfmt;
+    p->conv_subfmt = p->in_subfmt;
+    mp_subfilter_continue(&p->sub);
 }
 
 static void handle_audio_frame(struct mp_filter *f)
@@ -484,6 +576,7 @@ static void destroy(struct mp_filter *f)
 
     mp_subfilter_reset(&p->sub);
     TA_FREEP(&p->sub.filter);
+    flush_conv_cache(p);
 }
 
 static const struct mp_filter_info autoconvert_filter = {
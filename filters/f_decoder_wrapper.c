@@ -40,11 +40,16 @@
 #include "common/codecs.h"
 #include "common/global.h"
 #include "common/recorder.h"
+#include "common/stats.h"
 #include "misc/dispatch.h"
+#include "misc/thread_pool.h"
 
 #include "audio/aframe.h"
 #include "video/out/vo.h"
 #include "video/csputils.h"
+#include "video/image_cache.h"
+#include "video/mp_image_pool.h"
+#include "video/sws_utils.h"
 
 #include "demux/stheader.h"
 
@@ -108,6 +113,8 @@ struct dec_wrapper_opts {
     struct dec_queue_opts *adec_queue_opts;
     int64_t video_reverse_size;
     int64_t audio_reverse_size;
+    int video_convert_format;
+    int video_convert_threads;
 };
 
 static int decoder_list_help(struct mp_log *log, const m_option_t *opt,
@@ -136,6 +143,8 @@ const struct m_sub_options dec_wrapper_conf = {
             M_RANGE(0, M_MAX_MEM_BYTES)},
         {"audio-reversal-buffer", OPT_BYTE_SIZE(audio_reverse_size),
             M_RANGE(0, M_MAX_MEM_BYTES)} ,
+        {"vd-convert-format", OPT_IMAGEFORMAT(video_convert_format)},
+        {"vd-convert-threads", OPT_INT(video_convert_threads), M_RANGE(1, 16)},
         {0}
     },
     .size = sizeof(struct dec_wrapper_opts),
@@ -145,6 +154,7 @@ const struct m_sub_options dec_wrapper_conf = {
         .aspect_method = 2,
         .video_reverse_size = 1 * 1024 * 1024 * 1024,
         .audio_reverse_size = 64 * 1024 * 1024,
+        .video_convert_threads = 2,
     },
 };
 
@@ -166,6 +176,7 @@ struct priv {
 
     struct mp_codec_params *codec;
     struct mp_decoder *decoder;
+    struct stats_ctx *stats;
 
     // Demuxer output.
     struct mp_pin *demux;
@@ -198,6 +209,7 @@ struct priv {
     double fps;
 
     double start_pts;
+    struct mp_frame hrseek_held; // last frame before start_pts
     double start, end;
     struct demux_packet *new_segment;
     struct mp_frame packet;
@@ -210,6 +222,7 @@ struct priv {
 
     struct mp_frame decoded_coverart;
     int coverart_returned; // 0: no, 1: coverart frame itself, 2: EOF returned
+    struct demux_packet *coverart_packet; // source of the coverart, if cached
 
     int play_dir;
 
@@ -219,6 +232,7 @@ struct priv {
 
     // --- Specific access depending on threading stuff.
     struct mp_async_queue *queue; // decoded frame output queue
+    struct mp_filter *standby_root; // until mp_decoder_wrapper_attach()
     struct mp_dispatch_queue *dec_dispatch; // non-NULL if decoding thread used
     bool dec_thread_lock; // debugging (esp. for no-thread case)
     pthread_t dec_thread;
@@ -230,9 +244,14 @@ struct priv {
     char *decoder_desc;
     bool try_spdif;
     bool attached_picture;
+    struct mp_image_cache *image_cache;
     bool pts_reset;
     int attempt_framedrops; // try dropping this many frames
     int dropped_frames; // total frames _probably_ dropped
+    bool keyframes_only;
+    int64_t reset_end; // mp_time_us() when the last reset finished
+    int64_t flush_time; // duration of the last reset (us)
+    int64_t refill_time; // reset to first decoded frame (us), -1 if pending
 };
 
 static int decoder_list_help(struct mp_log *log, const m_option_t *opt,
@@ -301,6 +320,7 @@ static void reset_decoder(struct priv *p)
 {
     p->first_packet_pdts = MP_NOPTS_VALUE;
     p->start_pts = MP_NOPTS_VALUE;
+    mp_frame_unref(&p->hrseek_held);
     p->codec_pts = MP_NOPTS_VALUE;
     p->codec_dts = MP_NOPTS_VALUE;
     p->num_codec_pts_problems = 0;
@@ -323,6 +343,8 @@ static void decf_reset(struct mp_filter *f)
     struct priv *p = f->priv;
     assert(p->decf == f);
 
+    int64_t start = mp_time_us();
+
     p->pts = MP_NOPTS_VALUE;
     p->last_format = p->fixed_format = (struct mp_image_params){0};
 
@@ -330,6 +352,7 @@ static void decf_reset(struct mp_filter *f)
     p->pts_reset = false;
     p->attempt_framedrops = 0;
     p->dropped_frames = 0;
+    p->keyframes_only = false;
     pthread_mutex_unlock(&p->cache_lock);
 
     p->coverart_returned = 0;
@@ -341,6 +364,23 @@ static void decf_reset(struct mp_filter *f)
     p->reverse_queue_complete = false;
 
     reset_decoder(p);
+
+    int64_t end = mp_time_us();
+    pthread_mutex_lock(&p->cache_lock);
+    p->reset_end = end;
+    p->flush_time = end - start;
+    p->refill_time = -1;
+    pthread_mutex_unlock(&p->cache_lock);
+}
+
+void mp_decoder_wrapper_get_reset_timing(struct mp_decoder_wrapper *d,
+                                         int64_t *flush_us, int64_t *refill_us)
+{
+    struct priv *p = d->f->priv;
+    pthread_mutex_lock(&p->cache_lock);
+    *flush_us = p->flush_time;
+    *refill_us = p->refill_time;
+    pthread_mutex_unlock(&p->cache_lock);
 }
 
 int mp_decoder_wrapper_control(struct mp_decoder_wrapper *d,
@@ -375,6 +415,8 @@ static void decf_destroy(struct mp_filter *f)
 
     decf_reset(f);
     mp_frame_unref(&p->decoded_coverart);
+    free_demux_packet(p->coverart_packet);
+    p->coverart_packet = NULL;
 }
 
 struct mp_decoder_list *video_decoder_list(void)
@@ -534,6 +576,15 @@ void mp_decoder_wrapper_set_coverart_flag(struct mp_decoder_wrapper *d, bool c)
     pthread_mutex_unlock(&p->cache_lock);
 }
 
+void mp_decoder_wrapper_set_image_cache(struct mp_decoder_wrapper *d,
+                                        struct mp_image_cache *cache)
+{
+    struct priv *p = d->f->priv;
+    pthread_mutex_lock(&p->cache_lock);
+    p->image_cache = cache;
+    pthread_mutex_unlock(&p->cache_lock);
+}
+
 bool mp_decoder_wrapper_get_pts_reset(struct mp_decoder_wrapper *d)
 {
     struct priv *p = d->f->priv;
@@ -698,6 +749,19 @@ static bool process_decoded_frame(struct priv *p, struct mp_frame *frame)
             demuxer_feed_caption(p->header, ccpkt);
         }
 
+        // Frames before the hr-seek target are discarded by the player
+        // anyway. Keep only the most recent one (shown if the target is past
+        // EOF), so the others don't go through the filter chain.
+        if (p->start_pts != MP_NOPTS_VALUE && mpi->pts != MP_NOPTS_VALUE &&
+            mpi->pts < p->start_pts - .005 && p->play_dir > 0)
+        {
+            mp_frame_unref(&p->hrseek_held);
+            p->hrseek_held = *frame;
+            *frame = MP_NO_FRAME;
+            goto done;
+        }
+        mp_frame_unref(&p->hrseek_held);
+
         // Stop hr-seek logic.
         if (mpi->pts == MP_NOPTS_VALUE || mpi->pts >= p->start_pts)
             p->start_pts = MP_NOPTS_VALUE;
@@ -826,6 +890,15 @@ static void process_output_frame(struct priv *p, struct mp_frame frame)
     }
 }
 
+void mp_decoder_wrapper_set_keyframes_only(struct mp_decoder_wrapper *d,
+                                           bool enable)
+{
+    struct priv *p = d->f->priv;
+    pthread_mutex_lock(&p->cache_lock);
+    p->keyframes_only = enable;
+    pthread_mutex_unlock(&p->cache_lock);
+}
+
 void mp_decoder_wrapper_set_start_pts(struct mp_decoder_wrapper *d, double pts)
 {
     struct priv *p = d->f->priv;
@@ -865,6 +938,29 @@ static void feed_packet(struct priv *p)
     if (!p->packet.type)
         return;
 
+    // Cover art that was already decoded (e.g. by a previous playlist entry).
+    if (p->packet.type == MP_FRAME_PACKET && !p->coverart_packet) {
+        pthread_mutex_lock(&p->cache_lock);
+        struct mp_image_cache *cache =
+            p->attached_picture ? p->image_cache : NULL;
+        pthread_mutex_unlock(&p->cache_lock);
+
+        if (cache) {
+            struct demux_packet *pkt = p->packet.data;
+            struct mp_image *img = mp_image_cache_get(cache, pkt);
+            if (img) {
+                MP_VERBOSE(p, "Using cached cover art.\n");
+                pthread_mutex_lock(&p->cache_lock);
+                p->decoded_coverart = MAKE_FRAME(MP_FRAME_VIDEO, img);
+                pthread_mutex_unlock(&p->cache_lock);
+                mp_frame_unref(&p->packet);
+                mp_filter_internal_mark_progress(p->decf);
+                return;
+            }
+            p->coverart_packet = demux_copy_packet(pkt);
+        }
+    }
+
     // Flush current data if the packet is a new segment.
     if (is_new_segment(p, p->packet)) {
         assert(!p->new_segment);
@@ -876,6 +972,16 @@ static void feed_packet(struct priv *p)
     struct demux_packet *packet =
         p->packet.type == MP_FRAME_PACKET ? p->packet.data : NULL;
 
+    pthread_mutex_lock(&p->cache_lock);
+    bool keyframes_only = p->keyframes_only;
+    pthread_mutex_unlock(&p->cache_lock);
+
+    if (keyframes_only && packet && !packet->keyframe) {
+        mp_frame_unref(&p->packet);
+        mp_filter_internal_mark_progress(p->decf);
+        return;
+    }
+
     // For video framedropping, including parts of the hr-seek logic.
     if (p->decoder->control) {
         double start_pts = p->start_pts;
@@ -894,7 +1000,15 @@ static void feed_packet(struct priv *p)
             packet->pts < start_pts - .005 && !p->has_broken_packet_pts)
             framedrop_type = 2;
 
+        if (keyframes_only)
+            framedrop_type = 3;
+
         p->decoder->control(p->decoder->f, VDCTRL_SET_FRAMEDROP, &framedrop_type);
+
+        double skip_pts = MP_NOPTS_VALUE;
+        if (p->play_dir > 0 && !p->has_broken_packet_pts)
+            skip_pts = p->start_pts;
+        p->decoder->control(p->decoder->f, VDCTRL_SET_SKIP_PTS, &skip_pts);
     }
 
     if (!p->dec_dispatch && p->public.recorder_sink)
@@ -986,9 +1100,14 @@ static void read_frame(struct priv *p)
     if (!frame.type)
         return;
 
+    struct mp_image_cache *image_cache = NULL;
     pthread_mutex_lock(&p->cache_lock);
-    if (p->attached_picture && frame.type == MP_FRAME_VIDEO)
+    if (p->refill_time < 0 && frame.type != MP_FRAME_EOF)
+        p->refill_time = mp_time_us() - p->reset_end;
+    if (p->attached_picture && frame.type == MP_FRAME_VIDEO) {
         p->decoded_coverart = frame;
+        image_cache = p->image_cache;
+    }
     if (p->attempt_framedrops) {
         int dropped = MPMAX(0, p->packets_without_output - 1);
         p->attempt_framedrops = MPMAX(0, p->attempt_framedrops - dropped);
@@ -997,12 +1116,24 @@ static void read_frame(struct priv *p)
     pthread_mutex_unlock(&p->cache_lock);
 
     if (p->decoded_coverart.type) {
+        if (image_cache && p->coverart_packet)
+            mp_image_cache_add(image_cache, p->coverart_packet, frame.data);
+        free_demux_packet(p->coverart_packet);
+        p->coverart_packet = NULL;
         mp_filter_internal_mark_progress(p->decf);
         return;
     }
 
     p->packets_without_output = 0;
 
+    // Output the frame held back by the hr-seek logic before EOF.
+    if (frame.type == MP_FRAME_EOF && p->hrseek_held.type) {
+        mp_pin_out_unread(p->decoder->f->pins[1], frame);
+        frame = p->hrseek_held;
+        p->hrseek_held = MP_NO_FRAME;
+        goto output_frame;
+    }
+
     if (p->preroll_discard && frame.type != MP_FRAME_EOF) {
         double ts = mp_frame_get_pts(frame);
         if (ts == MP_NOPTS_VALUE) {
@@ -1013,7 +1144,9 @@ static void read_frame(struct priv *p)
         p->preroll_discard = false;
     }
 
+    stats_time_start(p->stats, "process-frame");
     bool segment_ended = process_decoded_frame(p, &frame);
+    stats_time_end(p->stats, "process-frame");
 
     if (p->play_dir < 0 && frame.type) {
         enqueue_backward_frame(p, frame);
@@ -1060,12 +1193,17 @@ static void update_queue_config(struct priv *p)
     if (!p->queue)
         return;
 
+    // A standby decoder only decodes the first frame. After it's attached, it
+    // keeps its thread, but shouldn't decode further ahead than requested.
     struct mp_async_queue_config cfg = {
-        .max_bytes = p->queue_opts->max_bytes,
         .sample_unit = AQUEUE_UNIT_SAMPLES,
-        .max_samples = p->queue_opts->max_samples,
-        .max_duration = p->queue_opts->max_duration,
+        .max_samples = 1,
     };
+    if (!p->standby_root && p->queue_opts && p->queue_opts->use_queue) {
+        cfg.max_bytes = p->queue_opts->max_bytes;
+        cfg.max_samples = p->queue_opts->max_samples;
+        cfg.max_duration = p->queue_opts->max_duration;
+    }
     mp_async_queue_set_config(p->queue, cfg);
 }
 
@@ -1077,7 +1215,9 @@ static void decf_process(struct mp_filter *f)
     if (m_config_cache_update(p->opt_cache))
         update_queue_config(p);
 
+    stats_time_start(p->stats, "feed-packet");
     feed_packet(p);
+    stats_time_end(p->stats, "feed-packet");
     read_frame(p);
 }
 
@@ -1091,9 +1231,12 @@ static void *dec_thread(void *ptr)
     case STREAM_AUDIO: t_name = "adec"; break;
     }
     mpthread_set_name(t_name);
+    mpthread_set_class(p->dec_root_filter->global, p->log, "decoder");
 
     while (!p->request_terminate_dec_thread) {
+        stats_time_start(p->stats, "decode-thread");
         mp_filter_graph_run(p->dec_root_filter);
+        stats_time_end(p->stats, "decode-thread");
         update_cached_values(p);
         mp_dispatch_queue_process(p->dec_dispatch, INFINITY);
     }
@@ -1120,6 +1263,8 @@ static void public_f_reset(struct mp_filter *f)
 static void public_f_destroy(struct mp_filter *f)
 {
     struct priv *p = f->priv;
+    if (!p)
+        return; // replaced by mp_decoder_wrapper_attach()
     assert(p->public.f == f);
 
     if (p->dec_thread_valid) {
@@ -1137,6 +1282,7 @@ static void public_f_destroy(struct mp_filter *f)
     talloc_free(p->dec_root_filter);
     talloc_free(p->queue);
     pthread_mutex_destroy(&p->cache_lock);
+    talloc_free(p);
 }
 
 static const struct mp_filter_info decf_filter = {
@@ -1146,13 +1292,200 @@ static const struct mp_filter_info decf_filter = {
     .destroy = decf_destroy,
 };
 
+// The priv struct is allocated separately, because it's moved to a new filter
+// by mp_decoder_wrapper_attach().
 static const struct mp_filter_info decode_wrapper_filter = {
     .name = "decode_wrapper",
-    .priv_size = sizeof(struct priv),
     .reset = public_f_reset,
     .destroy = public_f_destroy,
 };
 
+// Optional stage after the decoder (--vd-convert-format). Downloads hardware
+// frames and converts them to the requested format on a thread pool. Multiple
+// frames are converted at once, but returned in decoding order.
+struct convert_job {
+    struct convert_priv *c;
+    char *stats_name;
+    struct mp_frame frame;      // input; output once done
+    bool done;                  // protected by convert_priv.lock
+};
+
+struct convert_priv {
+    struct mp_filter *f;
+    struct stats_ctx *stats;
+    int imgfmt;
+    struct mp_thread_pool *pool;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    struct convert_job *jobs;   // ring buffer of num_slots entries
+    int num_slots;
+    int first;                  // index of the oldest job
+    int num_jobs;               // jobs in flight or finished, not returned
+};
+
+static struct mp_image *convert_image(struct convert_priv *c,
+                                      struct mp_image *img)
+{
+    if (img->hwctx) {
+        struct mp_image *sw = mp_image_hw_download(img, NULL);
+        if (!sw)
+            return NULL;
+        mp_image_copy_attributes(sw, img);
+        talloc_free(img);
+        img = sw;
+    }
+
+    if (img->imgfmt != c->imgfmt) {
+        struct mp_image *dst = mp_image_alloc(c->imgfmt, img->w, img->h);
+        if (!dst)
+            return img;
+        mp_image_copy_attributes(dst, img);
+        mp_image_params_guess_csp(&dst->params);
+        if (mp_image_swscale(dst, img, mp_sws_fast_flags) < 0) {
+            talloc_free(dst);
+            return img;
+        }
+        talloc_free(img);
+        img = dst;
+    }
+
+    return img;
+}
+
+static void convert_job_run(void *ptr)
+{
+    struct convert_job *job = ptr;
+    struct convert_priv *c = job->c;
+
+    stats_time_start(c->stats, job->stats_name);
+    struct mp_image *res = convert_image(c, job->frame.data);
+    stats_time_end(c->stats, job->stats_name);
+
+    pthread_mutex_lock(&c->lock);
+    // On failure, pass through the source frame.
+    if (res)
+        job->frame.data = res;
+    job->done = true;
+    // (The filter can't be destroyed before all jobs are done.)
+    mp_filter_wakeup(c->f);
+    pthread_cond_broadcast(&c->wakeup);
+    pthread_mutex_unlock(&c->lock);
+}
+
+// Wait until no thread pool job accesses c anymore.
+static void convert_wait_jobs(struct convert_priv *c)
+{
+    pthread_mutex_lock(&c->lock);
+    for (int n = 0; n < c->num_jobs; n++) {
+        struct convert_job *job = &c->jobs[(c->first + n) % c->num_slots];
+        while (!job->done)
+            pthread_cond_wait(&c->wakeup, &c->lock);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+static void convert_process(struct mp_filter *f)
+{
+    struct convert_priv *c = f->priv;
+
+    // Return finished frames in order.
+    pthread_mutex_lock(&c->lock);
+    while (c->num_jobs && c->jobs[c->first].done &&
+           mp_pin_in_needs_data(f->ppins[1]))
+    {
+        struct convert_job *job = &c->jobs[c->first];
+        mp_pin_in_write(f->ppins[1], job->frame);
+        job->frame = MP_NO_FRAME;
+        c->first = (c->first + 1) % c->num_slots;
+        c->num_jobs--;
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    // Start new jobs. first/num_jobs are only changed by the filter thread.
+    while (c->num_jobs < c->num_slots && mp_pin_out_request_data(f->ppins[0])) {
+        struct mp_frame frame = mp_pin_out_read(f->ppins[0]);
+        struct convert_job *job =
+            &c->jobs[(c->first + c->num_jobs) % c->num_slots];
+        bool convert = frame.type == MP_FRAME_VIDEO;
+        if (convert) {
+            struct mp_image *img = frame.data;
+            convert = img->hwctx || img->imgfmt != c->imgfmt;
+        }
+        job->frame = frame;
+        job->done = !convert;
+        c->num_jobs++;
+        if (convert && !mp_thread_pool_queue(c->pool, convert_job_run, job)) {
+            pthread_mutex_lock(&c->lock);
+            job->done = true;
+            pthread_mutex_unlock(&c->lock);
+        }
+        // Non-video frames and unqueued jobs can be returned right away.
+        if (job->done)
+            mp_filter_internal_mark_progress(f);
+    }
+}
+
+static void convert_reset(struct mp_filter *f)
+{
+    struct convert_priv *c = f->priv;
+
+    convert_wait_jobs(c);
+    for (int n = 0; n < c->num_jobs; n++)
+        mp_frame_unref(&c->jobs[(c->first + n) % c->num_slots].frame);
+    c->first = c->num_jobs = 0;
+}
+
+static void convert_destroy(struct mp_filter *f)
+{
+    struct convert_priv *c = f->priv;
+
+    convert_reset(f);
+    talloc_free(c->pool);
+    pthread_cond_destroy(&c->wakeup);
+    pthread_mutex_destroy(&c->lock);
+}
+
+static const struct mp_filter_info convert_filter = {
+    .name = "convert",
+    .priv_size = sizeof(struct convert_priv),
+    .process = convert_process,
+    .reset = convert_reset,
+    .destroy = convert_destroy,
+};
+
+static struct mp_filter *convert_create(struct mp_filter *parent,
+                                        struct priv *p)
+{
+    struct mp_filter *f = mp_filter_create(parent, &convert_filter);
+    if (!f)
+        return NULL;
+
+    mp_filter_add_pin(f, MP_PIN_IN, "in");
+    mp_filter_add_pin(f, MP_PIN_OUT, "out");
+
+    struct convert_priv *c = f->priv;
+    int threads = p->opts->video_convert_threads;
+    c->f = f;
+    c->stats = p->stats;
+    c->imgfmt = p->opts->video_convert_format;
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->wakeup, NULL);
+    // Allow 1 more frame per thread to be waiting for output.
+    c->num_slots = threads * 2;
+    c->jobs = talloc_zero_array(c, struct convert_job, c->num_slots);
+    for (int n = 0; n < c->num_slots; n++) {
+        c->jobs[n].c = c;
+        c->jobs[n].stats_name = talloc_asprintf(c, "convert-%d", n);
+    }
+    c->pool = mp_thread_pool_create(c, 1, threads, threads);
+    if (!c->pool) {
+        talloc_free(f);
+        return NULL;
+    }
+
+    return f;
+}
+
 static void wakeup_dec_thread(void *ptr)
 {
     struct priv *p = ptr;
@@ -1167,15 +1500,18 @@ static void onlock_dec_thread(void *ptr)
     mp_filter_graph_interrupt(p->dec_root_filter);
 }
 
-struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
-                                                     struct sh_stream *src)
+static struct mp_decoder_wrapper *create(struct mp_filter *parent,
+                                         struct sh_stream *src, bool standby)
 {
     struct mp_filter *public_f = mp_filter_create(parent, &decode_wrapper_filter);
     if (!public_f)
         return NULL;
 
-    struct priv *p = public_f->priv;
+    struct priv *p = talloc_zero(NULL, struct priv);
+    public_f->priv = p;
     p->public.f = public_f;
+    if (standby)
+        p->standby_root = parent;
 
     pthread_mutex_init(&p->cache_lock, NULL);
     p->opt_cache = m_config_cache_alloc(p, public_f->global, &dec_wrapper_conf);
@@ -1183,6 +1519,8 @@ struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
     p->header = src;
     p->codec = p->header->codec;
     p->play_dir = 1;
+    p->stats = stats_ctx_create(p, public_f->global,
+                                src->type == STREAM_VIDEO ? "vd" : "ad");
     mp_filter_add_pin(public_f, MP_PIN_OUT, "out");
 
     if (p->header->type == STREAM_VIDEO) {
@@ -1199,6 +1537,13 @@ struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
         }
 
         p->queue_opts = p->opts->vdec_queue_opts;
+
+        // Decoding ahead into a queue adds latency by design.
+        struct mp_vo_opts *vo_opts =
+            mp_get_config_group(NULL, public_f->global, &vo_sub_opts);
+        if (vo_opts->latency_mode)
+            p->queue_opts = NULL;
+        talloc_free(vo_opts);
     } else if (p->header->type == STREAM_AUDIO) {
         p->log = mp_log_new(p, parent->global->log, "!ad");
         p->queue_opts = p->opts->adec_queue_opts;
@@ -1206,7 +1551,7 @@ struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
         goto error;
     }
 
-    if (p->queue_opts && p->queue_opts->use_queue) {
+    if (standby || (p->queue_opts && p->queue_opts->use_queue)) {
         p->queue = mp_async_queue_create();
         p->dec_dispatch = mp_dispatch_create(p);
         p->dec_root_filter = mp_filter_create_root(public_f->global);
@@ -1238,13 +1583,22 @@ struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
 
     decf_reset(p->decf);
 
+    struct mp_pin *dec_out = p->decf->pins[0];
+    if (p->header->type == STREAM_VIDEO && p->opts->video_convert_format) {
+        struct mp_filter *conv = convert_create(p->dec_root_filter ? p->dec_root_filter : public_f, p);
+        if (!conv)
+            goto error;
+        mp_pin_connect(conv->pins[0], dec_out);
+        dec_out = conv->pins[1];
+    }
+
     if (p->queue) {
         struct mp_filter *f_in =
             mp_async_queue_create_filter(public_f, MP_PIN_OUT, p->queue);
         struct mp_filter *f_out =
             mp_async_queue_create_filter(p->decf, MP_PIN_IN, p->queue);
         mp_pin_connect(public_f->ppins[0], f_in->pins[0]);
-        mp_pin_connect(f_out->pins[0], p->decf->pins[0]);
+        mp_pin_connect(f_out->pins[0], dec_out);
 
         p->dec_thread_valid = true;
         if (pthread_create(&p->dec_thread, NULL, dec_thread, p)) {
@@ -1252,7 +1606,7 @@ struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
             goto error;
         }
     } else {
-        mp_pin_connect(public_f->ppins[0], p->decf->pins[0]);
+        mp_pin_connect(public_f->ppins[0], dec_out);
     }
 
     public_f_reset(public_f);
@@ -1263,6 +1617,67 @@ error:
     return NULL;
 }
 
+struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
+                                                     struct sh_stream *src)
+{
+    return create(parent, src, false);
+}
+
+struct mp_decoder_wrapper *mp_decoder_wrapper_create_standby(
+    struct mpv_global *global, struct sh_stream *src,
+    struct mp_stream_info *info)
+{
+    struct mp_filter *root = mp_filter_create_root(global);
+    root->stream_info = info;
+
+    struct mp_decoder_wrapper *d = create(root, src, true);
+    if (!d || !mp_decoder_wrapper_reinit(d)) {
+        talloc_free(root);
+        return NULL;
+    }
+
+    // Let the decoder thread fill the queue without a reader.
+    struct priv *p = d->f->priv;
+    mp_async_queue_resume_reading(p->queue);
+    return d;
+}
+
+void mp_decoder_wrapper_free_standby(struct mp_decoder_wrapper *d)
+{
+    if (!d)
+        return;
+    struct priv *p = d->f->priv;
+    assert(p->standby_root);
+    talloc_free(p->standby_root);
+}
+
+void mp_decoder_wrapper_attach(struct mp_decoder_wrapper *d,
+                               struct mp_filter *parent)
+{
+    struct priv *p = d->f->priv;
+    assert(p->standby_root && p->queue);
+
+    // Drop the old wrapper and its queue reader first; the queue itself, and
+    // the frames already in it, are kept.
+    p->public.f->priv = NULL;
+    talloc_free(p->standby_root);
+    p->standby_root = NULL;
+
+    struct mp_filter *public_f = mp_filter_create(parent, &decode_wrapper_filter);
+    public_f->priv = p;
+    public_f->log = p->log;
+    p->public.f = public_f;
+    mp_filter_add_pin(public_f, MP_PIN_OUT, "out");
+
+    struct mp_filter *f_in =
+        mp_async_queue_create_filter(public_f, MP_PIN_OUT, p->queue);
+    mp_pin_connect(public_f->ppins[0], f_in->pins[0]);
+
+    thread_lock(p);
+    update_queue_config(p);
+    thread_unlock(p);
+}
+
 void lavc_process(struct mp_filter *f, struct lavc_state *state,
                   int (*send)(struct mp_filter *f, struct demux_packet *pkt),
                   int (*receive)(struct mp_filter *f, struct mp_frame *res))
@@ -26,6 +26,7 @@ struct mp_codec_params;
 struct mp_image_params;
 struct mp_decoder_list;
 struct demux_packet;
+struct mp_image_cache;
 
 // (free with talloc_free(mp_decoder_wrapper.f)
 struct mp_decoder_wrapper {
@@ -42,6 +43,25 @@ struct mp_decoder_wrapper {
 struct mp_decoder_wrapper *mp_decoder_wrapper_create(struct mp_filter *parent,
                                                      struct sh_stream *src);
 
+// Create a decoder in its own filter graph, which starts decoding the first
+// frame on its own thread right away. info is used for the hwdec and DR
+// interfaces, and must stay valid until the decoder is destroyed or attached.
+// The decoder can be used only after mp_decoder_wrapper_attach(), or freed
+// with mp_decoder_wrapper_free_standby(). Returns NULL on failure.
+struct mp_decoder_wrapper *mp_decoder_wrapper_create_standby(
+    struct mpv_global *global, struct sh_stream *src,
+    struct mp_stream_info *info);
+
+// Free a decoder that was created with mp_decoder_wrapper_create_standby() and
+// was not attached. NULL is ignored.
+void mp_decoder_wrapper_free_standby(struct mp_decoder_wrapper *d);
+
+// Move a standby decoder into the given filter graph. Frames it decoded so far
+// are returned first. After this, it behaves like a normal decoder (free it
+// with talloc_free(d->f)).
+void mp_decoder_wrapper_attach(struct mp_decoder_wrapper *d,
+                               struct mp_filter *parent);
+
 // For informational purposes.
 void mp_decoder_wrapper_get_desc(struct mp_decoder_wrapper *d,
                                  char *buf, size_t buf_size);
@@ -58,6 +78,10 @@ void mp_decoder_wrapper_set_spdif_flag(struct mp_decoder_wrapper *d, bool spdif)
 // Whether to decode only 1 frame and then stop, and cache the frame across resets.
 void mp_decoder_wrapper_set_coverart_flag(struct mp_decoder_wrapper *d, bool c);
 
+// Look up coverart in this cache before decoding it, and add it after decoding.
+void mp_decoder_wrapper_set_image_cache(struct mp_decoder_wrapper *d,
+                                        struct mp_image_cache *cache);
+
 // True if a pts reset was observed (audio only, heuristic).
 bool mp_decoder_wrapper_get_pts_reset(struct mp_decoder_wrapper *d);
 
@@ -66,6 +90,16 @@ void mp_decoder_wrapper_set_play_dir(struct mp_decoder_wrapper *d, int dir);
 struct mp_decoder_list *video_decoder_list(void);
 struct mp_decoder_list *audio_decoder_list(void);
 
+// Time the last decoder reset (e.g. a seek) took to flush the decoder, and the
+// time from then until the first decoded frame (-1 if none yet), both in us.
+void mp_decoder_wrapper_get_reset_timing(struct mp_decoder_wrapper *d,
+                                         int64_t *flush_us, int64_t *refill_us);
+
+// Decode keyframes only, and skip all other packets (for scrubbing). This is
+// automatically unset on reset.
+void mp_decoder_wrapper_set_keyframes_only(struct mp_decoder_wrapper *d,
+                                           bool enable);
+
 // For precise seeking: if possible, try to drop frames up until the given PTS.
 // This is automatically unset if the target is reached, or on reset.
 void mp_decoder_wrapper_set_start_pts(struct mp_decoder_wrapper *d, double pts);
@@ -75,8 +109,21 @@ enum dec_ctrl {
     VDCTRL_GET_HWDEC,
     VDCTRL_REINIT,
     VDCTRL_GET_BFRAMES,
-    // framedrop mode: 0=none, 1=standard, 2=hrseek
+    // framedrop mode: 0=none, 1=standard, 2=hrseek, 3=keyframes only
     VDCTRL_SET_FRAMEDROP,
+    // double*: output frames before this pts are discarded (hr-seek), so the
+    // decoder may skip expensive output work for them (MP_NOPTS_VALUE: none)
+    VDCTRL_SET_SKIP_PTS,
+    VDCTRL_GET_DROP_POLICY, // struct vd_drop_policy_info*
+};
+
+// State of --vd-lavc-adaptive-drop. Times are in seconds.
+struct vd_drop_policy_info {
+    const char *level;      // static string
+    bool active;            // false if disabled for this decoder (hwdec)
+    double budget;          // time between output frames
+    double cost;            // average decode time per frame
+    double type_cost[4];    // same, indexed by mp_image.pict_type
 };
 
 int mp_decoder_wrapper_control(struct mp_decoder_wrapper *d,
@@ -1,7 +1,13 @@
+#include <pthread.h>
+#include <stdbool.h>
+
 #include <libavutil/buffer.h>
 #include <libavutil/hwcontext.h>
 #include <libavutil/mem.h>
 
+#include "common/stats.h"
+#include "misc/thread_pool.h"
+#include "osdep/timer.h"
 #include "video/fmt-conversion.h"
 #include "video/hwdec.h"
 #include "video/mp_image.h"
@@ -370,40 +376,133 @@ error:
     return NULL;
 }
 
-static void hwdownload_process(struct mp_filter *f)
-{
-    struct mp_hwdownload *d = f->priv;
+// Number of downloads in flight. Each holds a hw surface until it is done,
+// so keep this well below the --hwdec-extra-frames default.
+#define HWDOWNLOAD_FRAMES 2
 
-    if (!mp_pin_can_transfer_data(f->ppins[1], f->ppins[0]))
-        return;
+struct hwdownload_job {
+    struct hwdownload_priv *p;
+    struct mp_image_pool *pool; // used by this job only
+    struct mp_frame frame;      // input; output once done
+    int64_t queue_time;
+    bool done;                  // protected by hwdownload_priv.lock
+};
 
-    struct mp_frame frame = mp_pin_out_read(f->ppins[0]);
-    if (frame.type != MP_FRAME_VIDEO)
-        goto passthrough;
+struct hwdownload_priv {
+    struct mp_hwdownload public;
 
-    struct mp_image *src = frame.data;
-    if (!src->hwctx)
-        goto passthrough;
+    struct stats_ctx *stats;
+    struct mp_thread_pool *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    struct hwdownload_job jobs[HWDOWNLOAD_FRAMES]; // ring buffer
+    int first;                  // index of the oldest job
+    int num_jobs;               // jobs in flight or finished, not returned
+};
+
+static void hwdownload_job_run(void *ptr)
+{
+    struct hwdownload_job *job = ptr;
+    struct hwdownload_priv *p = job->p;
+    struct mp_filter *f = p->public.f;
 
-    struct mp_image *dst = mp_image_hw_download(src, d->pool);
-    if (!dst) {
+    struct mp_image *src = job->frame.data;
+    struct mp_image *dst = mp_image_hw_download(src, job->pool);
+    if (!dst)
         MP_ERR(f, "Could not copy hardware frame to CPU memory.\n");
-        goto passthrough;
+
+    pthread_mutex_lock(&p->lock);
+    // On failure, pass through the hw frame.
+    if (dst) {
+        talloc_free(src);
+        job->frame.data = dst;
     }
+    stats_value(p->stats, "latency",
+                (mp_time_us() - job->queue_time) / 1e6);
+    job->done = true;
+    // (The filter can't be destroyed before all jobs are done.)
+    mp_filter_wakeup(f);
+    pthread_cond_broadcast(&p->wakeup);
+    pthread_mutex_unlock(&p->lock);
+}
 
-    mp_frame_unref(&frame);
-    mp_pin_in_write(f->ppins[1], MAKE_FRAME(MP_FRAME_VIDEO, dst));
-    return;
+static void hwdownload_process(struct mp_filter *f)
+{
+    struct hwdownload_priv *p = f->priv;
 
-passthrough:
-    mp_pin_in_write(f->ppins[1], frame);
-    return;
+    // Return finished frames in order.
+    pthread_mutex_lock(&p->lock);
+    while (p->num_jobs && p->jobs[p->first].done &&
+           mp_pin_in_needs_data(f->ppins[1]))
+    {
+        struct hwdownload_job *job = &p->jobs[p->first];
+        mp_pin_in_write(f->ppins[1], job->frame);
+        job->frame = MP_NO_FRAME;
+        p->first = (p->first + 1) % HWDOWNLOAD_FRAMES;
+        p->num_jobs--;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    // Start new downloads. first/num_jobs are only changed by this thread.
+    while (p->num_jobs < HWDOWNLOAD_FRAMES &&
+           mp_pin_out_request_data(f->ppins[0]))
+    {
+        struct mp_frame frame = mp_pin_out_read(f->ppins[0]);
+        struct hwdownload_job *job =
+            &p->jobs[(p->first + p->num_jobs) % HWDOWNLOAD_FRAMES];
+        bool download = frame.type == MP_FRAME_VIDEO &&
+                        ((struct mp_image *)frame.data)->hwctx;
+        job->frame = frame;
+        job->queue_time = mp_time_us();
+        job->done = !download;
+        p->num_jobs++;
+        if (download)
+            mp_thread_pool_queue(p->threads, hwdownload_job_run, job);
+        // Other frames are passed through as soon as it's their turn.
+        if (job->done)
+            mp_filter_internal_mark_progress(f);
+    }
+}
+
+// Wait until no thread pool job accesses p anymore.
+static void hwdownload_wait_jobs(struct hwdownload_priv *p)
+{
+    pthread_mutex_lock(&p->lock);
+    for (int n = 0; n < p->num_jobs; n++) {
+        struct hwdownload_job *job =
+            &p->jobs[(p->first + n) % HWDOWNLOAD_FRAMES];
+        while (!job->done)
+            pthread_cond_wait(&p->wakeup, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void hwdownload_reset(struct mp_filter *f)
+{
+    struct hwdownload_priv *p = f->priv;
+
+    hwdownload_wait_jobs(p);
+    for (int n = 0; n < p->num_jobs; n++)
+        mp_frame_unref(&p->jobs[(p->first + n) % HWDOWNLOAD_FRAMES].frame);
+    p->first = p->num_jobs = 0;
+}
+
+static void hwdownload_destroy(struct mp_filter *f)
+{
+    struct hwdownload_priv *p = f->priv;
+
+    hwdownload_reset(f);
+    talloc_free(p->threads);
+    pthread_cond_destroy(&p->wakeup);
+    pthread_mutex_destroy(&p->lock);
 }
 
 static const struct mp_filter_info hwdownload_filter = {
     .name = "hwdownload",
-    .priv_size = sizeof(struct mp_hwdownload),
+    .priv_size = sizeof(struct hwdownload_priv),
     .process = hwdownload_process,
+    .reset = hwdownload_reset,
+    .destroy = hwdownload_destroy,
 };
 
 struct mp_hwdownload *mp_hwdownload_create(struct mp_filter *parent)
@@ -412,10 +511,23 @@ struct mp_hwdownload *mp_hwdownload_create(struct mp_filter *parent)
     if (!f)
         return NULL;
 
-    struct mp_hwdownload *d = f->priv;
+    struct hwdownload_priv *p = f->priv;
+    struct mp_hwdownload *d = &p->public;
 
     d->f = f;
-    d->pool = mp_image_pool_new(d);
+    p->stats = stats_ctx_create(p, f->global, "hwdownload");
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wakeup, NULL);
+    for (int n = 0; n < HWDOWNLOAD_FRAMES; n++) {
+        p->jobs[n].p = p;
+        p->jobs[n].pool = mp_image_pool_new(p);
+    }
+    // Further threads are created on demand.
+    p->threads = mp_thread_pool_create(p, 1, 1, HWDOWNLOAD_FRAMES);
+    if (!p->threads) {
+        talloc_free(f);
+        return NULL;
+    }
 
     mp_filter_add_pin(f, MP_PIN_IN, "in");
     mp_filter_add_pin(f, MP_PIN_OUT, "out");
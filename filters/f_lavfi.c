@@ -39,6 +39,7 @@
 #include "common/av_common.h"
 #include "common/tags.h"
 #include "common/msg.h"
+#include "common/stats.h"
 
 #include "audio/format.h"
 #include "audio/aframe.h"
@@ -56,6 +57,7 @@
 struct lavfi {
     struct mp_log *log;
     struct mp_filter *f;
+    struct stats_ctx *stats;
 
     char *graph_string;
     char **graph_opts;
@@ -326,7 +328,8 @@ static void send_global_eof(struct lavfi *c)
 }
 
 // libavfilter allows changing some parameters on the fly, but not
-// others.
+// others. Anything not checked here (e.g. colorspace or HDR metadata) is
+// passed with the frames, and does not require recreating the graph.
 static bool is_aformat_ok(struct mp_aframe *a, struct mp_aframe *b)
 {
     struct mp_chmap ca = {0}, cb = {0};
@@ -338,10 +341,14 @@ static bool is_aformat_ok(struct mp_aframe *a, struct mp_aframe *b)
 }
 static bool is_vformat_ok(struct mp_image *a, struct mp_image *b)
 {
+    // The hw frames context is fixed in the buffersrc parameters. (Compare the
+    // context itself, not the per-frame references to it.)
+    void *hwa = a->hwctx ? a->hwctx->data : NULL;
+    void *hwb = b->hwctx ? b->hwctx->data : NULL;
     return a->imgfmt == b->imgfmt &&
-           a->w == b->w && a->h && b->h &&
+           a->w == b->w && a->h == b->h &&
            a->params.p_w == b->params.p_w && a->params.p_h == b->params.p_h &&
-           a->nominal_fps == b->nominal_fps;
+           a->nominal_fps == b->nominal_fps && hwa == hwb;
 }
 static bool is_format_ok(struct mp_frame a, struct mp_frame b)
 {
@@ -557,7 +564,10 @@ static void init_graph(struct lavfi *c)
         }
 
         // And here the actual libavfilter initialization happens.
-        if (avfilter_graph_config(c->graph, NULL) < 0) {
+        stats_time_start(c->stats, "graph-init");
+        int r = avfilter_graph_config(c->graph, NULL);
+        stats_time_end(c->stats, "graph-init");
+        if (r < 0) {
             MP_FATAL(c, "failed to configure the filter graph\n");
             free_graph(c);
             c->failed = true;
@@ -764,6 +774,7 @@ static void lavfi_process(struct mp_filter *f)
 
         if (all_eof) {
             MP_VERBOSE(c, "recovering all eof\n");
+            stats_event(c->stats, "graph-reinit");
             free_graph(c);
             mp_filter_internal_mark_progress(c->f);
         }
@@ -835,6 +846,7 @@ static struct lavfi *lavfi_alloc(struct mp_filter *parent)
 
     c->f = f;
     c->log = f->log;
+    c->stats = stats_ctx_create(c, f->global, "lavfi");
     c->public.f = f;
     c->tmp_frame = av_frame_alloc();
     if (!c->tmp_frame)
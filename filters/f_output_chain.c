@@ -7,6 +7,7 @@
 
 #include "filter_internal.h"
 
+#include "f_audio_meter.h"
 #include "f_autoconvert.h"
 #include "f_auto_filters.h"
 #include "f_lavfi.h"
@@ -699,6 +700,15 @@ struct mp_output_chain *mp_output_chain_create(struct mp_filter *parent,
     if (type == MP_OUTPUT_CHAIN_AUDIO) {
         p->convert->on_audio_format_change = on_audio_format_change;
         p->convert->on_audio_format_change_opaque = p;
+
+        // Measure what is actually sent to the AO.
+        struct mp_user_filter *meter = create_wrapper_filter(p);
+        c->audio_meter = mp_audio_meter_create(meter->wrapper);
+        if (!c->audio_meter)
+            abort();
+        meter->name = "meter";
+        meter->f = c->audio_meter->f;
+        MP_TARRAY_APPEND(p, p->post_filters, p->num_post_filters, meter);
     }
 
     // Dummy filter for reporting and logging the output format.
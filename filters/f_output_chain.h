@@ -42,6 +42,8 @@ struct mp_output_chain {
     // reference. The API user needs to call mp_output_chain_set_ao() again.
     // Until this is done, the filter chain will not output new data.
     bool ao_needs_update;
+    // Meter for the output of the filter chain (--audio-meter-rate).
+    struct mp_audio_meter *audio_meter;
 };
 
 // (free by freeing mp_output_chain.f)
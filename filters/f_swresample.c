@@ -30,6 +30,7 @@
 #include "common/common.h"
 #include "common/av_common.h"
 #include "common/msg.h"
+#include "common/stats.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
 
@@ -38,6 +39,7 @@
 
 struct priv {
     struct mp_log *log;
+    struct stats_ctx *stats;
     bool is_resampling;
     struct SwrContext *avrctx;
     struct mp_aframe *avrctx_fmt; // output format of avrctx
@@ -50,6 +52,10 @@ struct priv {
     int reorder_out[MP_NUM_CHANNELS];
     struct mp_aframe_pool *reorder_buffer;
     struct mp_aframe_pool *out_pool;
+    // Same rate and format, and the output channels are a permutation of the
+    // input channels: bypass avrctx and just reorder.
+    bool reorder_only;
+    int reorder_map[MP_NUM_CHANNELS]; // out channel n = in channel map[n]
 
     int in_rate_user; // user input sample rate
     int in_rate;      // actual rate (used by lavr), adjusted for playback speed
@@ -99,6 +105,7 @@ static void close_lavrr(struct priv *p)
 {
     swr_free(&p->avrctx);
     swr_free(&p->avrctx_out);
+    p->reorder_only = false;
 
     TA_FREEP(&p->pre_out_fmt);
     TA_FREEP(&p->avrctx_fmt);
@@ -157,10 +164,37 @@ static void transpose_order(int *map, int num)
     memcpy(map, nmap, sizeof(nmap));
 }
 
+// Return whether out contains exactly the channels of in, and set map so that
+// out->speaker[n] = in->speaker[map[n]].
+static bool get_channel_permutation(int map[MP_NUM_CHANNELS],
+                                    struct mp_chmap *in, struct mp_chmap *out)
+{
+    if (in->num != out->num)
+        return false;
+
+    if (mp_chmap_equals(in, out)) {
+        for (int n = 0; n < out->num; n++)
+            map[n] = n;
+        return true;
+    }
+
+    // Unknown layouts are mapped 1:1, like libswresample does.
+    mp_chmap_get_reorder(map, in, out);
+    bool used[MP_NUM_CHANNELS] = {0};
+    for (int n = 0; n < out->num; n++) {
+        if (map[n] < 0 || used[map[n]])
+            return false;
+        used[map[n]] = true;
+    }
+    return true;
+}
+
 static bool configure_lavrr(struct priv *p, bool verbose)
 {
     close_lavrr(p);
 
+    stats_event(p->stats, "reinit");
+
     p->in_rate = rate_from_speed(p->in_rate_user, p->speed);
 
     MP_VERBOSE(p, "%dHz %s %s -> %dHz %s %s\n",
@@ -300,6 +334,13 @@ static bool configure_lavrr(struct priv *p, bool verbose)
 
     p->is_resampling = false;
 
+    p->reorder_only = p->in_rate == p->out_rate &&
+                      p->in_format == p->out_format &&
+                      get_channel_permutation(p->reorder_map, &p->in_channels,
+                                              &p->out_channels);
+    if (verbose && p->reorder_only)
+        MP_VERBOSE(p, "Only reordering channels.\n");
+
     if (swr_init(p->avrctx) < 0 || swr_init(p->avrctx_out) < 0) {
         MP_ERR(p, "Cannot open Libavresample context.\n");
         goto error;
@@ -379,6 +420,65 @@ static int resample_frame(struct SwrContext *r,
         av_i ? MPMIN(av_i->nb_samples, consume_in) : 0);
 }
 
+#define REORDER_SAMPLES(type) do {                                      \
+        const type *s_ = (const type *)src;                             \
+        type *d_ = (type *)dst;                                         \
+        for (int i = 0; i < samples; i++) {                             \
+            for (int c = 0; c < num_ch; c++)                            \
+                d_[c] = s_[p->reorder_map[c]];                          \
+            s_ += num_ch;                                               \
+            d_ += num_ch;                                               \
+        }                                                               \
+    } while (0)
+
+// Output in with the channels reordered (p->reorder_only). This consumes all
+// of in, and never buffers anything.
+static struct mp_frame filter_reorder_output(struct priv *p,
+                                             struct mp_aframe *in)
+{
+    struct mp_aframe *out = NULL;
+
+    if (af_fmt_is_planar(p->in_format)) {
+        out = mp_aframe_new_ref(in);
+        if (!mp_aframe_permute_planes(out, p->reorder_map, &p->out_channels))
+            goto error;
+    } else {
+        int samples = mp_aframe_get_size(in);
+        out = mp_aframe_create();
+        mp_aframe_config_copy(out, p->pre_out_fmt);
+        if (mp_aframe_pool_allocate(p->out_pool, out, samples) < 0)
+            goto error;
+        mp_aframe_copy_attributes(out, in);
+
+        uint8_t **src_planes = mp_aframe_get_data_ro(in);
+        uint8_t **dst_planes = mp_aframe_get_data_rw(out);
+        if (!src_planes || !dst_planes)
+            goto error;
+        const uint8_t *src = src_planes[0];
+        uint8_t *dst = dst_planes[0];
+        int num_ch = p->out_channels.num;
+
+        switch (af_fmt_to_bytes(p->in_format)) {
+        case 1: REORDER_SAMPLES(uint8_t); break;
+        case 2: REORDER_SAMPLES(uint16_t); break;
+        case 4: REORDER_SAMPLES(uint32_t); break;
+        case 8: REORDER_SAMPLES(uint64_t); break;
+        default: goto error;
+        }
+    }
+
+    p->current_pts = mp_aframe_end_pts(in);
+    if (p->current_pts != MP_NOPTS_VALUE)
+        mp_aframe_mul_speed(out, p->speed);
+
+    return MAKE_FRAME(MP_FRAME_AUDIO, out);
+error:
+    talloc_free(out);
+    MP_ERR(p, "Error on reordering.\n");
+    mp_filter_internal_mark_failed(p->public.f);
+    return MP_NO_FRAME;
+}
+
 static struct mp_frame filter_resample_output(struct priv *p,
                                               struct mp_aframe *in)
 {
@@ -403,7 +503,9 @@ static struct mp_frame filter_resample_output(struct priv *p,
 
     int out_samples = 0;
     if (samples) {
+        stats_time_start(p->stats, "resample");
         out_samples = resample_frame(p->avrctx, out, in, consume_in);
+        stats_time_end(p->stats, "resample");
         if (out_samples < 0 || out_samples > samples)
             goto error;
         mp_aframe_set_size(out, out_samples);
@@ -581,6 +683,22 @@ static void process(struct mp_filter *f)
         }
     }
 
+    // Total correction applied (e.g. by --video-sync=display-resample), and
+    // the part of it done by compensation without reinitializing.
+    stats_value(p->stats, "speed-ppm", (p->speed - 1) * 1e6);
+    stats_value(p->stats, "compensation-ppm", use_comp ?
+                (p->speed * p->in_rate_user / p->in_rate - 1) * 1e6 : 0);
+
+    // avrctx was never fed in this mode, so nothing needs to be drained
+    // when switching to it.
+    if (p->reorder_only && exact_rate && !p->is_resampling && p->input) {
+        struct mp_frame out = filter_reorder_output(p, p->input);
+        TA_FREEP(&p->input);
+        if (out.type)
+            mp_pin_in_write(f->ppins[1], out);
+        return;
+    }
+
     if (!exact_rate) {
         // Before reconfiguring, drain the audio that is still buffered
         // in the resampler.
@@ -662,6 +780,7 @@ struct mp_swresample *mp_swresample_create(struct mp_filter *parent,
     p->public.speed = 1.0;
     p->cmd_speed = 1.0;
     p->log = f->log;
+    p->stats = stats_ctx_create(p, f->global, "swresample");
 
     if (opts) {
         p->opts = talloc_dup(p, opts);
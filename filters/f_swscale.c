@@ -15,6 +15,7 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -45,19 +46,17 @@ int mp_sws_find_best_out_format(struct mp_sws_filter *sws, int in_format,
 {
     sws->sws->force_scaler = sws->force_scaler;
 
-    int best = 0;
+    int best = 0, best_cost = INT_MAX;
     for (int n = 0; n < num_out_formats; n++) {
         int out_format = out_formats[n];
 
         if (!mp_sws_supports_formats(sws->sws, out_format, in_format))
             continue;
 
-        if (best) {
-            int candidate = mp_imgfmt_select_best(best, out_format, in_format);
-            if (candidate)
-                best = candidate;
-        } else {
+        int cost = mp_imgfmt_conversion_cost(out_format, in_format);
+        if (!best || cost < best_cost) {
             best = out_format;
+            best_cost = cost;
         }
     }
     return best;
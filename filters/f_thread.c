@@ -0,0 +1,302 @@
+#include <pthread.h>
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "osdep/atomic.h"
+#include "osdep/threads.h"
+
+#include "f_async_queue.h"
+#include "filter_internal.h"
+#include "user_filters.h"
+
+// Runs a chain of user filters in a separate filter graph on its own thread.
+// The outer filter and the worker graph are connected by 2 async queues, so
+// the worker filters run in parallel to the rest of the outer graph (and to
+// other such threads), while frames still flow through normal mp_pins.
+//
+//  outer graph:  ppins[0] -> [q_in writer]         [q_out reader] -> ppins[1]
+//                                 |                       ^
+//  worker graph:             [q_in reader] -> chain -> [q_out writer]
+
+struct thread_opts {
+    struct m_obj_settings *filters;
+    int queue_frames;
+    enum mp_output_chain_type type; // (not an option)
+};
+
+struct priv {
+    struct thread_opts *opts;
+
+    struct mp_async_queue *q_in, *q_out;
+
+    struct mp_filter *root;         // worker graph
+    struct mp_filter **chain;       // user filters in root
+    int num_chain;
+
+    pthread_t thread;
+    bool thread_valid;
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    // -- protected by lock
+    bool terminate;
+    bool need_run;                  // root requested mp_filter_graph_run()
+    void (*work_fn)(struct priv *p, void *arg); // synchronous call, or NULL
+    void *work_arg;
+
+    atomic_bool failed;             // a worker filter failed
+    struct mp_filter *f;            // outer filter (for async wakeups only)
+};
+
+static void wakeup_worker(void *ctx)
+{
+    struct priv *p = ctx;
+    pthread_mutex_lock(&p->lock);
+    p->need_run = true;
+    pthread_cond_broadcast(&p->wakeup);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void *worker_thread(void *arg)
+{
+    struct priv *p = arg;
+    mpthread_set_name("filter");
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->terminate) {
+        if (p->work_fn) {
+            void (*fn)(struct priv *p, void *arg) = p->work_fn;
+            pthread_mutex_unlock(&p->lock);
+            fn(p, p->work_arg);
+            pthread_mutex_lock(&p->lock);
+            p->work_fn = NULL;
+            pthread_cond_broadcast(&p->wakeup);
+            continue;
+        }
+        if (p->need_run) {
+            p->need_run = false;
+            pthread_mutex_unlock(&p->lock);
+            mp_filter_graph_run(p->root);
+            if (mp_filter_has_failed(p->root)) {
+                atomic_store(&p->failed, true);
+                mp_filter_wakeup(p->f);
+            }
+            pthread_mutex_lock(&p->lock);
+            continue;
+        }
+        pthread_cond_wait(&p->wakeup, &p->lock);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+// Run fn on the worker thread, and wait until it's done. The worker graph
+// must only be accessed from there.
+static void run_on_worker(struct priv *p, void (*fn)(struct priv *p, void *arg),
+                          void *arg)
+{
+    pthread_mutex_lock(&p->lock);
+    assert(!p->work_fn);
+    p->work_fn = fn;
+    p->work_arg = arg;
+    pthread_cond_broadcast(&p->wakeup);
+    while (p->work_fn)
+        pthread_cond_wait(&p->wakeup, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void process(struct mp_filter *f)
+{
+    struct priv *p = f->priv;
+
+    if (atomic_exchange(&p->failed, false))
+        mp_filter_internal_mark_failed(f);
+}
+
+static void worker_reset(struct priv *p, void *arg)
+{
+    mp_filter_reset(p->root);
+}
+
+static void reset(struct mp_filter *f)
+{
+    struct priv *p = f->priv;
+
+    // Order as recommended by f_async_queue.h. The queue access filters in
+    // the outer graph were already reset by mp_filter_reset().
+    mp_async_queue_reset(p->q_in);
+    mp_async_queue_reset(p->q_out);
+    run_on_worker(p, worker_reset, NULL);
+    mp_async_queue_resume(p->q_in);
+    mp_async_queue_resume(p->q_out);
+}
+
+struct command_ctx {
+    struct mp_filter_command *cmd;
+    bool res;
+};
+
+static void worker_command(struct priv *p, void *arg)
+{
+    struct command_ctx *ctx = arg;
+    for (int n = 0; n < p->num_chain; n++)
+        ctx->res |= mp_filter_command(p->chain[n], ctx->cmd);
+}
+
+static bool command(struct mp_filter *f, struct mp_filter_command *cmd)
+{
+    struct priv *p = f->priv;
+
+    // Sent to all filters in the chain; success if any accepted it.
+    struct command_ctx ctx = {.cmd = cmd};
+    run_on_worker(p, worker_command, &ctx);
+    return ctx.res;
+}
+
+static void destroy(struct mp_filter *f)
+{
+    struct priv *p = f->priv;
+
+    if (p->thread_valid) {
+        pthread_mutex_lock(&p->lock);
+        p->terminate = true;
+        pthread_cond_broadcast(&p->wakeup);
+        pthread_mutex_unlock(&p->lock);
+        pthread_join(p->thread, NULL);
+    }
+
+    talloc_free(p->root);
+    talloc_free(p->q_in);
+    talloc_free(p->q_out);
+    pthread_cond_destroy(&p->wakeup);
+    pthread_mutex_destroy(&p->lock);
+}
+
+static const struct mp_filter_info thread_filter = {
+    .name = "thread",
+    .priv_size = sizeof(struct priv),
+    .process = process,
+    .reset = reset,
+    .command = command,
+    .destroy = destroy,
+};
+
+static struct mp_filter *thread_create(struct mp_filter *parent, void *options)
+{
+    struct thread_opts *opts = options;
+
+    struct mp_filter *f = mp_filter_create(parent, &thread_filter);
+    if (!f) {
+        talloc_free(opts);
+        return NULL;
+    }
+
+    mp_filter_add_pin(f, MP_PIN_IN, "in");
+    mp_filter_add_pin(f, MP_PIN_OUT, "out");
+
+    struct priv *p = f->priv;
+    p->opts = talloc_steal(f, opts);
+    p->f = f;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->wakeup, NULL);
+
+    p->q_in = mp_async_queue_create();
+    p->q_out = mp_async_queue_create();
+    struct mp_async_queue_config cfg = {
+        .max_bytes = INT64_MAX,
+        .max_samples = opts->queue_frames,
+    };
+    mp_async_queue_set_config(p->q_in, cfg);
+    mp_async_queue_set_config(p->q_out, cfg);
+
+    p->root = mp_filter_create_root(f->global);
+    mp_filter_graph_set_wakeup_cb(p->root, wakeup_worker, p);
+
+    struct mp_filter *w_in =
+        mp_async_queue_create_filter(p->root, MP_PIN_OUT, p->q_in);
+    struct mp_filter *w_out =
+        mp_async_queue_create_filter(p->root, MP_PIN_IN, p->q_out);
+
+    // The graph is built here, before the thread exists, so no locking.
+    struct mp_pin *cur = w_in->pins[0];
+    for (int n = 0; opts->filters && opts->filters[n].name; n++) {
+        struct m_obj_settings *entry = &opts->filters[n];
+        if (!entry->enabled)
+            continue;
+        struct mp_filter *uf = mp_create_user_filter(p->root, opts->type,
+                                                     entry->name,
+                                                     entry->attribs);
+        if (!uf)
+            goto error;
+        MP_TARRAY_APPEND(p, p->chain, p->num_chain, uf);
+        mp_pin_connect(uf->pins[0], cur);
+        cur = uf->pins[1];
+    }
+    if (!p->num_chain) {
+        MP_ERR(f, "No filters given.\n");
+        goto error;
+    }
+    mp_pin_connect(w_out->pins[0], cur);
+
+    struct mp_filter *o_in =
+        mp_async_queue_create_filter(f, MP_PIN_IN, p->q_in);
+    struct mp_filter *o_out =
+        mp_async_queue_create_filter(f, MP_PIN_OUT, p->q_out);
+    mp_pin_connect(o_in->pins[0], f->ppins[0]);
+    mp_pin_connect(f->ppins[1], o_out->pins[0]);
+
+    mp_async_queue_resume(p->q_in);
+    mp_async_queue_resume(p->q_out);
+
+    if (pthread_create(&p->thread, NULL, worker_thread, p)) {
+        MP_ERR(f, "Could not create thread.\n");
+        goto error;
+    }
+    p->thread_valid = true;
+
+    return f;
+
+error:
+    talloc_free(f);
+    return NULL;
+}
+
+extern const struct m_obj_list af_obj_list;
+extern const struct m_obj_list vf_obj_list;
+
+#define OPT_BASE_STRUCT struct thread_opts
+
+const struct mp_user_filter_entry af_thread = {
+    .desc = {
+        .description = "run filters on a separate thread",
+        .name = "thread",
+        .priv_size = sizeof(OPT_BASE_STRUCT),
+        .options = (const m_option_t[]){
+            {"filters", OPT_SETTINGSLIST(filters, &af_obj_list)},
+            {"queue-frames", OPT_INT(queue_frames), M_RANGE(1, 100)},
+            {0}
+        },
+        .priv_defaults = &(const OPT_BASE_STRUCT){
+            .queue_frames = 2,
+            .type = MP_OUTPUT_CHAIN_AUDIO,
+        },
+    },
+    .create = thread_create,
+};
+
+const struct mp_user_filter_entry vf_thread = {
+    .desc = {
+        .description = "run filters on a separate thread",
+        .name = "thread",
+        .priv_size = sizeof(OPT_BASE_STRUCT),
+        .options = (const m_option_t[]){
+            {"filters", OPT_SETTINGSLIST(filters, &vf_obj_list)},
+            {"queue-frames", OPT_INT(queue_frames), M_RANGE(1, 100)},
+            {0}
+        },
+        .priv_defaults = &(const OPT_BASE_STRUCT){
+            .queue_frames = 2,
+            .type = MP_OUTPUT_CHAIN_VIDEO,
+        },
+    },
+    .create = thread_create,
+};
@@ -97,7 +97,12 @@ bool mp_subfilter_read(struct mp_subfilter *sub)
             struct mp_frame frame = mp_pin_out_read(sub->filter->pins[1]);
             if (sub->draining && frame.type == MP_FRAME_EOF) {
                 sub->draining = false;
-                TA_FREEP(&sub->filter);
+                if (sub->detach) {
+                    sub->detached = sub->filter;
+                    sub->filter = NULL;
+                } else {
+                    TA_FREEP(&sub->filter);
+                }
                 mark_progress(sub);
                 return false;
             }
@@ -125,6 +130,8 @@ void mp_subfilter_reset(struct mp_subfilter *sub)
     if (sub->filter && sub->draining)
         TA_FREEP(&sub->filter);
     sub->draining = false;
+    sub->detach = false;
+    TA_FREEP(&sub->detached);
     mp_frame_unref(&sub->frame);
 }
 
@@ -147,6 +154,7 @@ void mp_subfilter_destroy(struct mp_subfilter *sub)
 {
     TA_FREEP(&sub->filter);
     sub->draining = false;
+    sub->detach = false;
 }
 
 bool mp_subfilter_drain_destroy(struct mp_subfilter *sub)
@@ -160,6 +168,19 @@ bool mp_subfilter_drain_destroy(struct mp_subfilter *sub)
     return !sub->filter;
 }
 
+bool mp_subfilter_drain_detach(struct mp_subfilter *sub, struct mp_filter **out)
+{
+    *out = NULL;
+    if (!sub->draining && sub->filter)
+        sub->detach = true;
+    if (!mp_subfilter_drain_destroy(sub))
+        return false;
+    *out = sub->detached;
+    sub->detached = NULL;
+    sub->detach = false;
+    return true;
+}
+
 static const struct mp_filter_info bidir_nop_filter = {
     .name = "nop",
 };
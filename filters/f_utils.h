@@ -37,6 +37,8 @@ struct mp_subfilter {
     struct mp_filter *filter;
     // Internal state.
     bool draining;
+    bool detach;
+    struct mp_filter *detached;
 };
 
 // Make requests for a new frame.
@@ -68,6 +70,12 @@ void mp_subfilter_destroy(struct mp_subfilter *sub);
 // The filter is destroyed with talloc_free(sub->filter).
 bool mp_subfilter_drain_destroy(struct mp_subfilter *sub);
 
+// Like mp_subfilter_drain_destroy(), but the drained filter is not destroyed.
+// Once this returns true, sub->filter is unset, and the former filter is
+// returned in *out (NULL if there was none). The caller owns it, and can set
+// it as sub->filter again later.
+bool mp_subfilter_drain_detach(struct mp_subfilter *sub, struct mp_filter **out);
+
 // A bidirectional filter which passes through all data.
 struct mp_filter *mp_bidir_nop_filter_create(struct mp_filter *parent);
 
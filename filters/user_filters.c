@@ -41,6 +41,7 @@ const struct mp_user_filter_entry *af_list[] = {
 #endif
     &af_lavcac3enc,
     &af_drop,
+    &af_thread,
 };
 
 static bool get_af_desc(struct m_obj_desc *dst, int index)
@@ -97,6 +98,7 @@ const struct mp_user_filter_entry *vf_list[] = {
 #if HAVE_EGL_HELPERS && HAVE_GL && HAVE_EGL
     &vf_gpu,
 #endif
+    &vf_thread,
 };
 
 static bool get_vf_desc(struct m_obj_desc *dst, int index)
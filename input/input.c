@@ -69,6 +69,11 @@ struct cmd_bind {
     struct cmd_bind_section *owner;
 };
 
+struct bind_index_entry {
+    int key;                    // last key of the binding
+    int bind;                   // index into cmd_bind_section.binds
+};
+
 struct cmd_bind_section {
     char *owner;
     struct cmd_bind *binds;
@@ -76,6 +81,10 @@ struct cmd_bind_section {
     char *section;
     struct mp_rect mouse_area;  // set at runtime, if at all
     bool mouse_area_set;        // mouse_area is valid and should be tested
+    // binds[] sorted by the key completing each binding; rebuilt on lookup
+    // if index_valid is false
+    struct bind_index_entry *index;
+    bool index_valid;
 };
 
 #define MP_MAX_SOURCES 10
@@ -84,9 +93,24 @@ struct cmd_bind_section {
 
 struct active_section {
     char *name;
+    struct cmd_bind_section *bs;
     int flags;
 };
 
+// Result of the last find_any_bind_for_key() call without force_section, and
+// all state it depends on.
+struct bind_cache {
+    bool valid;
+    uint64_t binds_gen;
+    int code;
+    int keys[MP_MAX_KEY_DOWN];
+    int last_key_down;
+    int mouse_vo_x, mouse_vo_y;
+    char *mouse_section;
+    bool default_bindings;
+    struct cmd_bind *result;
+};
+
 struct cmd_queue {
     struct mp_cmd *first;
 };
@@ -129,6 +153,10 @@ struct input_ctx {
     // Unlike mouse_x/y, this can be used to resolve mouse click bindings.
     int mouse_vo_x, mouse_vo_y;
 
+    // Pacing of mouse movement commands (see mp_input_set_mouse_move_rate())
+    double mouse_move_rate;
+    int64_t last_mouse_move_time;
+
     bool mouse_mangle, mouse_src_mangle;
     struct mp_rect mouse_src, mouse_dst;
 
@@ -142,6 +170,11 @@ struct input_ctx {
     struct cmd_bind_section **sections;
     int num_sections;
 
+    // Incremented on any change to the sections, their bindings, or the
+    // active section stack.
+    uint64_t binds_gen;
+    struct bind_cache bind_cache;
+
     // List currently active command sections
     struct active_section active_sections[MAX_ACTIVE_SECTIONS];
     int num_active_sections;
@@ -376,57 +409,102 @@ static void key_buf_add(int *buf, int code)
     buf[0] = code;
 }
 
-static struct cmd_bind *find_bind_for_key_section(struct input_ctx *ictx,
-                                                  char *section, int code)
+// Must be called when anything about the sections or bindings changes.
+static void binds_changed(struct input_ctx *ictx, struct cmd_bind_section *bs)
+{
+    if (bs)
+        bs->index_valid = false;
+    ictx->binds_gen++;
+}
+
+static int cmp_bind_index(const void *p1, const void *p2)
+{
+    const struct bind_index_entry *e1 = p1, *e2 = p2;
+    if (e1->key != e2->key)
+        return e1->key < e2->key ? -1 : 1;
+    return e1->bind - e2->bind;
+}
+
+static void update_bind_index(struct cmd_bind_section *bs)
 {
-    struct cmd_bind_section *bs = get_bind_section(ictx, bstr0(section));
+    if (bs->index_valid)
+        return;
+    bs->index = talloc_realloc(bs, bs->index, struct bind_index_entry,
+                               bs->num_binds);
+    int num = 0;
+    for (int n = 0; n < bs->num_binds; n++) {
+        struct cmd_bind *b = &bs->binds[n];
+        if (b->num_keys) {
+            bs->index[num++] = (struct bind_index_entry){
+                .key = b->keys[b->num_keys - 1],
+                .bind = n,
+            };
+        }
+    }
+    qsort(bs->index, num, sizeof(bs->index[0]), cmp_bind_index);
+    // Entries past num are never used: lookups stop at a key mismatch.
+    for (int n = num; n < bs->num_binds; n++)
+        bs->index[n] = (struct bind_index_entry){.key = INT_MAX, .bind = -1};
+    bs->index_valid = true;
+}
 
+static struct cmd_bind *find_bind_for_key_section(struct input_ctx *ictx,
+                                                  struct cmd_bind_section *bs,
+                                                  int code)
+{
     if (!bs->num_binds)
         return NULL;
 
+    update_bind_index(bs);
+
     int keys[MP_MAX_KEY_DOWN];
     memcpy(keys, ictx->key_history, sizeof(keys));
     key_buf_add(keys, code);
 
-    struct cmd_bind *best = NULL;
+    // Find the first binding completed by this key.
+    int lo = 0, hi = bs->num_binds;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (bs->index[mid].key < code) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
 
-    // Prefer user-defined keys over builtin bindings
-    for (int builtin = 0; builtin < 2; builtin++) {
-        if (builtin && !ictx->opts->default_bindings)
-            break;
-        if (best)
-            break;
-        for (int n = 0; n < bs->num_binds; n++) {
-            if (bs->binds[n].is_builtin == (bool)builtin) {
-                struct cmd_bind *b = &bs->binds[n];
-                // we have: keys=[key2 key1 keyX ...]
-                // and: b->keys=[key1 key2] (and may be just a prefix)
-                for (int i = 0; i < b->num_keys; i++) {
-                    if (b->keys[i] != keys[b->num_keys - 1 - i])
-                        goto skip;
-                }
-                if (!best || b->num_keys >= best->num_keys)
-                    best = b;
-            skip: ;
-            }
+    // best[0]: user-defined, best[1]: builtin
+    struct cmd_bind *best[2] = {0};
+    for (int n = lo; n < bs->num_binds && bs->index[n].key == code; n++) {
+        struct cmd_bind *b = &bs->binds[bs->index[n].bind];
+        // we have: keys=[key2 key1 keyX ...]
+        // and: b->keys=[key1 key2] (and may be just a prefix)
+        for (int i = 0; i < b->num_keys; i++) {
+            if (b->keys[i] != keys[b->num_keys - 1 - i])
+                goto skip;
         }
+        struct cmd_bind **pbest = &best[b->is_builtin];
+        if (!*pbest || b->num_keys >= (*pbest)->num_keys)
+            *pbest = b;
+    skip: ;
     }
-    return best;
+
+    // Prefer user-defined keys over builtin bindings
+    if (best[0] || !ictx->opts->default_bindings)
+        return best[0];
+    return best[1];
 }
 
-static struct cmd_bind *find_any_bind_for_key(struct input_ctx *ictx,
-                                              char *force_section, int code)
+static struct cmd_bind *find_any_bind_for_key_uncached(struct input_ctx *ictx,
+                                                       int code)
 {
-    if (force_section)
-        return find_bind_for_key_section(ictx, force_section, code);
-
     bool use_mouse = MP_KEY_DEPENDS_ON_MOUSE_POS(code);
 
     // First look whether a mouse section is capturing all mouse input
     // exclusively (regardless of the active section stack order).
     if (use_mouse && MP_KEY_IS_MOUSE_BTN_SINGLE(ictx->last_key_down)) {
-        struct cmd_bind *bind =
-            find_bind_for_key_section(ictx, ictx->mouse_section, code);
+        struct cmd_bind_section *bs =
+            get_bind_section(ictx, bstr0(ictx->mouse_section));
+        struct cmd_bind *bind = find_bind_for_key_section(ictx, bs, code);
         if (bind)
             return bind;
     }
@@ -434,7 +512,7 @@ static struct cmd_bind *find_any_bind_for_key(struct input_ctx *ictx,
     struct cmd_bind *best_bind = NULL;
     for (int i = ictx->num_active_sections - 1; i >= 0; i--) {
         struct active_section *s = &ictx->active_sections[i];
-        struct cmd_bind *bind = find_bind_for_key_section(ictx, s->name, code);
+        struct cmd_bind *bind = find_bind_for_key_section(ictx, s->bs, code);
         if (bind) {
             struct cmd_bind_section *bs = bind->owner;
             if (!use_mouse || (bs->mouse_area_set && test_rect(&bs->mouse_area,
@@ -454,6 +532,41 @@ static struct cmd_bind *find_any_bind_for_key(struct input_ctx *ictx,
     return best_bind;
 }
 
+static struct cmd_bind *find_any_bind_for_key(struct input_ctx *ictx,
+                                              char *force_section, int code)
+{
+    if (force_section) {
+        struct cmd_bind_section *bs = get_bind_section(ictx, bstr0(force_section));
+        return find_bind_for_key_section(ictx, bs, code);
+    }
+
+    // Mouse movement typically looks up the same key in the same state twice
+    // (update_mouse_section() and the actual key event).
+    struct bind_cache *c = &ictx->bind_cache;
+    struct bind_cache key = {
+        .valid = true,
+        .binds_gen = ictx->binds_gen,
+        .code = code,
+        .last_key_down = ictx->last_key_down,
+        .mouse_vo_x = ictx->mouse_vo_x,
+        .mouse_vo_y = ictx->mouse_vo_y,
+        .mouse_section = ictx->mouse_section,
+        .default_bindings = ictx->opts->default_bindings,
+    };
+    memcpy(key.keys, ictx->key_history, sizeof(key.keys));
+    if (c->valid && c->binds_gen == key.binds_gen && c->code == key.code &&
+        c->last_key_down == key.last_key_down &&
+        c->mouse_vo_x == key.mouse_vo_x && c->mouse_vo_y == key.mouse_vo_y &&
+        c->mouse_section == key.mouse_section &&
+        c->default_bindings == key.default_bindings &&
+        memcmp(c->keys, key.keys, sizeof(key.keys)) == 0)
+        return c->result;
+
+    key.result = find_any_bind_for_key_uncached(ictx, code);
+    *c = key;
+    return key.result;
+}
+
 static mp_cmd_t *get_cmd_from_keys(struct input_ctx *ictx, char *force_section,
                                    int code)
 {
@@ -561,6 +674,26 @@ static struct mp_cmd *resolve_key(struct input_ctx *ictx, int code)
     return NULL;
 }
 
+// Smooth scrolling produces many small wheel events. If the previous command
+// in the queue is the same command from the same wheel binding, add the scale
+// to it instead of queuing another command.
+static bool merge_wheel_cmd(struct input_ctx *ictx, struct mp_cmd *cmd)
+{
+    struct mp_cmd *tail = queue_peek_tail(&ictx->cmd_queue);
+    if (!cmd->wheel || !tail || !tail->wheel || tail->def != cmd->def ||
+        !tail->original || !cmd->original ||
+        strcmp(tail->original, cmd->original) != 0 ||
+        !tail->key_name || !cmd->key_name ||
+        strcmp(tail->key_name, cmd->key_name) != 0 ||
+        tail->input_section != cmd->input_section)
+        return false;
+    tail->scale += cmd->scale;
+    tail->scale_units += cmd->scale_units;
+    talloc_free(cmd);
+    mp_input_wakeup(ictx);
+    return true;
+}
+
 static void interpret_key(struct input_ctx *ictx, int code, double scale,
                           int scale_units)
 {
@@ -627,7 +760,9 @@ static void interpret_key(struct input_ctx *ictx, int code, double scale,
     if (mp_input_is_scalable_cmd(cmd)) {
         cmd->scale = scale;
         cmd->scale_units = scale_units;
-        mp_input_queue_cmd(ictx, cmd);
+        cmd->wheel = MP_KEY_IS_WHEEL(code & ~MP_KEY_MODIFIER_MASK);
+        if (!merge_wheel_cmd(ictx, cmd))
+            mp_input_queue_cmd(ictx, cmd);
     } else {
         // Non-scalable commands won't understand cmd->scale, so synthesize
         // multiple commands with cmd->scale = 1
@@ -888,6 +1023,28 @@ unsigned int mp_input_get_mouse_event_counter(struct input_ctx *ictx)
     return ret;
 }
 
+void mp_input_set_mouse_move_rate(struct input_ctx *ictx, double rate)
+{
+    input_lock(ictx);
+    ictx->mouse_move_rate = rate;
+    input_unlock(ictx);
+}
+
+// If the only queued command is a mouse movement, which came too soon after
+// the previous one, return the time in seconds until it can be delivered.
+// (It's kept at the tail of the queue, so further movement replaces it.)
+static double mouse_move_delay(struct input_ctx *ictx)
+{
+    struct mp_cmd *head = ictx->cmd_queue.first;
+    if (!head || !head->mouse_move || head->queue_next ||
+        ictx->mouse_move_rate <= 0)
+        return 0;
+    int64_t next = ictx->last_mouse_move_time +
+                   (int64_t)(1e6 / ictx->mouse_move_rate);
+    int64_t now = mp_time_us();
+    return now < next ? (next - now) / 1e6 : 0;
+}
+
 // adjust min time to wait until next repeat event
 static void adjust_max_wait_time(struct input_ctx *ictx, double *time)
 {
@@ -896,6 +1053,9 @@ static void adjust_max_wait_time(struct input_ctx *ictx, double *time)
         *time = MPMIN(*time, 1.0 / opts->ar_rate);
         *time = MPMIN(*time, opts->ar_delay / 1000.0);
     }
+    double mouse_delay = mouse_move_delay(ictx);
+    if (mouse_delay > 0)
+        *time = MPMIN(*time, mouse_delay);
 }
 
 int mp_input_queue_cmd(struct input_ctx *ictx, mp_cmd_t *cmd)
@@ -960,12 +1120,15 @@ void mp_input_wakeup(struct input_ctx *ictx)
 mp_cmd_t *mp_input_read_cmd(struct input_ctx *ictx)
 {
     input_lock(ictx);
-    struct mp_cmd *ret = queue_remove_head(&ictx->cmd_queue);
+    struct mp_cmd *ret = NULL;
+    if (mouse_move_delay(ictx) <= 0)
+        ret = queue_remove_head(&ictx->cmd_queue);
     if (!ret)
         ret = check_autorepeat(ictx);
     if (ret && ret->mouse_move) {
         ictx->mouse_x = ret->mouse_x;
         ictx->mouse_y = ret->mouse_y;
+        ictx->last_mouse_move_time = mp_time_us();
     }
     input_unlock(ictx);
     return ret;
@@ -999,6 +1162,7 @@ void mp_input_disable_section(struct input_ctx *ictx, char *name)
         if (strcmp(as->name, name) == 0) {
             MP_TARRAY_REMOVE_AT(ictx->active_sections,
                                 ictx->num_active_sections, i);
+            binds_changed(ictx, NULL);
         }
     }
     input_unlock(ictx);
@@ -1024,8 +1188,13 @@ void mp_input_enable_section(struct input_ctx *ictx, char *name, int flags)
             for (int n = ictx->num_active_sections; n > top; n--)
                 ictx->active_sections[n] = ictx->active_sections[n - 1];
         }
-        ictx->active_sections[top] = (struct active_section){name, flags};
+        ictx->active_sections[top] = (struct active_section){
+            .name = name,
+            .bs = get_bind_section(ictx, bstr0(name)),
+            .flags = flags,
+        };
         ictx->num_active_sections++;
+        binds_changed(ictx, NULL);
     }
 
     MP_TRACE(ictx, "active section stack:\n");
@@ -1041,6 +1210,7 @@ void mp_input_disable_all_sections(struct input_ctx *ictx)
 {
     input_lock(ictx);
     ictx->num_active_sections = 0;
+    binds_changed(ictx, NULL);
     input_unlock(ictx);
 }
 
@@ -1051,6 +1221,7 @@ void mp_input_set_section_mouse_area(struct input_ctx *ictx, char *name,
     struct cmd_bind_section *s = get_bind_section(ictx, bstr0(name));
     s->mouse_area = (struct mp_rect){x0, y0, x1, y1};
     s->mouse_area_set = x0 != x1 && y0 != y1;
+    binds_changed(ictx, s);
     input_unlock(ictx);
 }
 
@@ -1062,7 +1233,7 @@ static bool test_mouse(struct input_ctx *ictx, int x, int y, int rej_flags)
         struct active_section *as = &ictx->active_sections[i];
         if (as->flags & rej_flags)
             continue;
-        struct cmd_bind_section *s = get_bind_section(ictx, bstr0(as->name));
+        struct cmd_bind_section *s = as->bs;
         if (s->mouse_area_set && test_rect(&s->mouse_area, x, y)) {
             res = true;
             break;
@@ -1094,8 +1265,10 @@ static void bind_dealloc(struct cmd_bind *bind)
 }
 
 // builtin: if true, remove all builtin binds, else remove all user binds
-static void remove_binds(struct cmd_bind_section *bs, bool builtin)
+static void remove_binds(struct input_ctx *ictx, struct cmd_bind_section *bs,
+                         bool builtin)
 {
+    binds_changed(ictx, bs);
     for (int n = bs->num_binds - 1; n >= 0; n--) {
         if (bs->binds[n].is_builtin == builtin) {
             bind_dealloc(&bs->binds[n]);
@@ -1120,7 +1293,7 @@ void mp_input_define_section(struct input_ctx *ictx, char *name, char *location,
         talloc_free(bs->owner);
         bs->owner = talloc_strdup(bs, owner);
     }
-    remove_binds(bs, builtin);
+    remove_binds(ictx, bs, builtin);
     if (contents && contents[0]) {
         // Redefine:
         parse_config(ictx, builtin, bstr0(contents), location, name);
@@ -1138,8 +1311,8 @@ void mp_input_remove_sections_by_owner(struct input_ctx *ictx, char *owner)
         struct cmd_bind_section *bs = ictx->sections[n];
         if (bs->owner && owner && strcmp(bs->owner, owner) == 0) {
             mp_input_disable_section(ictx, bs->section);
-            remove_binds(bs, false);
-            remove_binds(bs, true);
+            remove_binds(ictx, bs, false);
+            remove_binds(ictx, bs, true);
         }
     }
     input_unlock(ictx);
@@ -1180,6 +1353,7 @@ static void bind_keys(struct input_ctx *ictx, bool builtin, bstr section,
     }
 
     bind_dealloc(bind);
+    binds_changed(ictx, bs);
 
     *bind = (struct cmd_bind) {
         .cmd = bstrdup0(bs->binds, command),
@@ -1470,6 +1644,7 @@ void mp_input_bind_key(struct input_ctx *ictx, int key, bstr command)
     }
 
     bind_dealloc(bind);
+    binds_changed(ictx, bs);
 
     *bind = (struct cmd_bind) {
         .cmd = bstrdup0(bs->binds, command),
@@ -101,6 +101,10 @@ void mp_input_set_mouse_pos_artificial(struct input_ctx *ictx, int x, int y);
 
 void mp_input_get_mouse_pos(struct input_ctx *ictx, int *x, int *y, int *hover);
 
+// Deliver mouse movement to the player at most at this rate (in Hz, normally
+// the display refresh rate). Movement in between is coalesced. 0 disables it.
+void mp_input_set_mouse_move_rate(struct input_ctx *ictx, double rate);
+
 // Return whether we want/accept mouse input.
 bool mp_input_mouse_enabled(struct input_ctx *ictx);
 
@@ -227,13 +231,24 @@ bool mp_ipc_start_anon_client(struct mp_ipc_ctx *ctx, struct mpv_handle *h,
                               int out_fd[2]);
 void mp_uninit_ipc(struct mp_ipc_ctx *ctx);
 
-// Serialize the given mpv_event structure to JSON. Returns an allocated string.
+// Per-connection IPC state. Must be zero-initialized.
+struct mp_ipc_conn {
+    bool msgpack;       // use MessagePack frames instead of JSON lines
+};
+
+// Serialize the given mpv_event structure with the connection's protocol.
+// Returns an allocated string (free with talloc_free(result.start)).
 struct mpv_event;
-char *mp_json_encode_event(struct mpv_event *event);
+bstr mp_ipc_encode_event(struct mp_ipc_conn *conn, struct mpv_event *event);
+
+// Whether the raw IPC input buffer "buf" contains a complete command.
+bool mp_ipc_has_next_command(struct mp_ipc_conn *conn, bstr buf);
 
-// Given the raw IPC input buffer "buf", remove the first newline-separated
-// command, execute it and return the result (if any) as an allocated string.
+// Given the raw IPC input buffer "buf", remove the first command (a newline-
+// separated line, or a frame with the binary protocol), execute it and return
+// the result (if any) as an allocated string. The result may contain 0 bytes.
 struct mpv_handle;
-char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf);
+bstr mp_ipc_consume_next_command(struct mpv_handle *client,
+                                 struct mp_ipc_conn *conn, void *ctx, bstr *buf);
 
 #endif /* MPLAYER_INPUT_H */
@@ -45,10 +45,29 @@
 #define MSG_NOSIGNAL 0
 #endif
 
+// Serves all clients from a single thread. Clients can outlive the
+// mp_ipc_ctx that created the loop (e.g. if --input-ipc-server is changed at
+// runtime), so the thread exits only once the ctx is gone and the last client
+// disconnected.
+struct client_loop {
+    struct mp_log *log;
+
+    pthread_mutex_t lock;
+    struct client_arg **new_clients;    // added by other threads
+    int num_new_clients;
+    bool detached;                      // ctx is gone, exit when idle
+    int wakeup_pipe[2];
+
+    // Accessed by the loop thread only.
+    struct client_arg **clients;
+    int num_clients;
+};
+
 struct mp_ipc_ctx {
     struct mp_log *log;
     struct mp_client_api *client_api;
     const char *path;
+    struct client_loop *loop;
 
     pthread_t thread;
     int death_pipe[2];
@@ -64,164 +83,274 @@ struct client_arg {
     bool quit_on_close;
 
     bool writable;
+    struct mp_ipc_conn conn;
+
+    int wakeup_fd;          // from mpv_get_wakeup_pipe()
+    bool events_pending;    // mpv_wait_event() might return something
+    bstr in_buf;            // incomplete commands
+    bstr out_buf;           // queued replies and events, sent up to out_pos
+    size_t out_pos;
 };
 
-static int ipc_write_str(struct client_arg *client, const char *buf)
+// If a client doesn't read its socket, stop reading its events and commands
+// once this much output is queued. Further events pile up (and get dropped)
+// in the mpv_handle's event queue, like with any other slow client.
+#define MAX_OUT_BUF (16 * 1024 * 1024)
+
+// Maximum number of events fetched with a single mpv_wait_events() call.
+#define EVENT_BATCH 64
+
+static void queue_output(struct client_arg *client, bstr data)
+{
+    if (client->writable)
+        bstr_xappend(client, &client->out_buf, data);
+}
+
+// Send as much of the queued output as possible without blocking.
+static int flush_output(struct client_arg *client)
 {
-    size_t count = strlen(buf);
-    while (count > 0) {
-        ssize_t rc = send(client->client_fd, buf, count, MSG_NOSIGNAL);
+    while (client->out_pos < client->out_buf.len) {
+        ssize_t rc = send(client->client_fd,
+                          client->out_buf.start + client->out_pos,
+                          client->out_buf.len - client->out_pos, MSG_NOSIGNAL);
         if (rc <= 0) {
             if (rc == 0)
                 return -1;
 
             if (errno == EBADF || errno == ENOTSOCK) {
                 client->writable = false;
-                return 0;
+                break;
             }
 
-            if (errno == EINTR || errno == EAGAIN)
+            if (errno == EINTR)
                 continue;
 
+            if (errno == EAGAIN)
+                return 0; // wait for POLLOUT
+
             return rc;
         }
 
-        count -= rc;
-        buf   += rc;
+        client->out_pos += rc;
     }
 
+    client->out_buf.len = client->out_pos = 0;
+    // Don't keep the memory of a large burst around.
+    if (talloc_get_size(client->out_buf.start) > 64 * 1024)
+        TA_FREEP(&client->out_buf.start);
+
     return 0;
 }
 
-static void *client_thread(void *p)
+// Handle the poll() results for a client. fds[0] is the client's wakeup pipe,
+// fds[1] the client socket. Returns false if the client is to be closed.
+static bool client_process(struct client_arg *arg, struct pollfd *fds)
 {
-    pthread_detach(pthread_self());
-
-    // We don't use MSG_NOSIGNAL because the moldy fruit OS doesn't support it.
-    struct sigaction sa = { .sa_handler = SIG_IGN, .sa_flags = SA_RESTART };
-    sigfillset(&sa.sa_mask);
-    sigaction(SIGPIPE, &sa, NULL);
+    if (fds[0].revents & POLLIN) {
+        mp_flush_wakeup_pipe(arg->wakeup_fd);
+        arg->events_pending = true;
+    }
 
-    int rc;
+    if (fds[1].revents & (POLLOUT | POLLHUP | POLLERR)) {
+        if (flush_output(arg) < 0) {
+            MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
+            return false;
+        }
+    }
 
-    struct client_arg *arg = p;
-    bstr client_msg = { talloc_strdup(NULL, ""), 0 };
+    // A fetched batch is always queued completely, so the output buffer may
+    // exceed MAX_OUT_BUF by up to one batch.
+    while (arg->events_pending && arg->out_buf.len < MAX_OUT_BUF) {
+        mpv_event events[EVENT_BATCH];
+        int num_events = mpv_wait_events(arg->client, 0, events, EVENT_BATCH);
 
-    mpthread_set_name(arg->client_name);
+        if (!num_events) {
+            arg->events_pending = false;
+            break;
+        }
 
-    int pipe_fd = mpv_get_wakeup_pipe(arg->client);
-    if (pipe_fd < 0) {
-        MP_ERR(arg, "Could not get wakeup pipe\n");
-        goto done;
-    }
+        for (int n = 0; n < num_events; n++) {
+            mpv_event *event = &events[n];
 
-    MP_VERBOSE(arg, "Client connected\n");
+            if (event->event_id == MPV_EVENT_SHUTDOWN)
+                return false;
 
-    struct pollfd fds[2] = {
-        {.events = POLLIN, .fd = pipe_fd},
-        {.events = POLLIN, .fd = arg->client_fd},
-    };
+            if (!arg->writable)
+                continue;
 
-    fcntl(arg->client_fd, F_SETFL, fcntl(arg->client_fd, F_GETFL, 0) | O_NONBLOCK);
+            bstr event_msg = mp_ipc_encode_event(&arg->conn, event);
+            if (!event_msg.start) {
+                MP_ERR(arg, "Encoding error\n");
+                return false;
+            }
 
-    while (1) {
-        rc = poll(fds, 2, 0);
-        if (rc == 0)
-            rc = poll(fds, 2, -1);
-        if (rc < 0) {
-            MP_ERR(arg, "Poll error\n");
-            continue;
+            queue_output(arg, event_msg);
+            talloc_free(event_msg.start);
         }
+    }
 
-        if (fds[0].revents & POLLIN) {
-            mp_flush_wakeup_pipe(pipe_fd);
-
-            while (1) {
-                mpv_event *event = mpv_wait_event(arg->client, 0);
+    if (fds[1].revents & (POLLIN | POLLHUP | POLLNVAL)) {
+        while (arg->out_buf.len < MAX_OUT_BUF) {
+            char buf[4096];
 
-                if (event->event_id == MPV_EVENT_NONE)
+            ssize_t bytes = read(arg->client_fd, buf, sizeof(buf));
+            if (bytes < 0) {
+                if (errno == EAGAIN)
                     break;
 
-                if (event->event_id == MPV_EVENT_SHUTDOWN)
-                    goto done;
+                MP_ERR(arg, "Read error (%s)\n", mp_strerror(errno));
+                return false;
+            }
 
-                if (!arg->writable)
-                    continue;
+            if (bytes == 0) {
+                MP_VERBOSE(arg, "Client disconnected\n");
+                return false;
+            }
 
-                char *event_msg = mp_json_encode_event(event);
-                if (!event_msg) {
-                    MP_ERR(arg, "Encoding error\n");
-                    goto done;
-                }
+            bstr_xappend(NULL, &arg->in_buf, (bstr){buf, bytes});
 
-                rc = ipc_write_str(arg, event_msg);
-                talloc_free(event_msg);
-                if (rc < 0) {
-                    MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
-                    goto done;
-                }
+            while (mp_ipc_has_next_command(&arg->conn, arg->in_buf)) {
+                bstr reply_msg = mp_ipc_consume_next_command(arg->client,
+                    &arg->conn, NULL, &arg->in_buf);
+                queue_output(arg, reply_msg);
+                talloc_free(reply_msg.start);
             }
         }
+    }
 
-        if (fds[1].revents & (POLLIN | POLLHUP | POLLNVAL)) {
-            while (1) {
-                char buf[128];
-                bstr append = { buf, 0 };
+    // Most of the time, everything fits into the socket buffer right away.
+    if (flush_output(arg) < 0) {
+        MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+static void client_destroy(struct client_arg *arg)
+{
+    // Best effort, e.g. for replies to commands sent just before disconnecting.
+    flush_output(arg);
 
-                ssize_t bytes = read(arg->client_fd, buf, sizeof(buf));
-                if (bytes < 0) {
-                    if (errno == EAGAIN)
-                        break;
+    if (arg->in_buf.len > 0)
+        MP_WARN(arg, "Ignoring unterminated command on disconnect.\n");
+    talloc_free(arg->in_buf.start);
+    if (arg->close_client_fd)
+        close(arg->client_fd);
+    struct mpv_handle *h = arg->client;
+    bool quit = arg->quit_on_close;
+    talloc_free(arg);
+    // Not mpv_terminate_destroy(): it waits until all clients are gone, which
+    // includes the other clients served by this thread.
+    if (quit)
+        mpv_command(h, (const char *[]){"quit", NULL});
+    mpv_destroy(h);
+}
 
-                    MP_ERR(arg, "Read error (%s)\n", mp_strerror(errno));
-                    goto done;
-                }
+static void *client_loop_thread(void *p)
+{
+    pthread_detach(pthread_self());
 
-                if (bytes == 0) {
-                    MP_VERBOSE(arg, "Client disconnected\n");
-                    goto done;
-                }
+    // We don't use MSG_NOSIGNAL because the moldy fruit OS doesn't support it.
+    struct sigaction sa = { .sa_handler = SIG_IGN, .sa_flags = SA_RESTART };
+    sigfillset(&sa.sa_mask);
+    sigaction(SIGPIPE, &sa, NULL);
 
-                append.len = bytes;
+    struct client_loop *loop = p;
+    struct pollfd *fds = NULL;
 
-                bstr_xappend(NULL, &client_msg, append);
+    mpthread_set_name("ipc clients");
 
-                while (bstrchr(client_msg, '\n') != -1) {
-                    char *reply_msg = mp_ipc_consume_next_command(arg->client,
-                        NULL, &client_msg);
+    while (1) {
+        pthread_mutex_lock(&loop->lock);
+        for (int n = 0; n < loop->num_new_clients; n++) {
+            MP_TARRAY_APPEND(loop, loop->clients, loop->num_clients,
+                             loop->new_clients[n]);
+        }
+        loop->num_new_clients = 0;
+        bool done = loop->detached && !loop->num_clients;
+        pthread_mutex_unlock(&loop->lock);
+
+        if (done)
+            break;
+
+        int num_fds = 1 + loop->num_clients * 2;
+        MP_TARRAY_GROW(loop, fds, num_fds);
+        fds[0] = (struct pollfd){.events = POLLIN, .fd = loop->wakeup_pipe[0]};
+        for (int n = 0; n < loop->num_clients; n++) {
+            struct client_arg *arg = loop->clients[n];
+            short events = 0;
+            if (arg->out_buf.len < MAX_OUT_BUF)
+                events |= POLLIN;
+            if (arg->out_pos < arg->out_buf.len)
+                events |= POLLOUT;
+            fds[1 + n * 2] = (struct pollfd){.events = POLLIN,
+                                             .fd = arg->wakeup_fd};
+            fds[2 + n * 2] = (struct pollfd){.events = events,
+                                             .fd = arg->client_fd};
+        }
 
-                    if (reply_msg && arg->writable) {
-                        rc = ipc_write_str(arg, reply_msg);
-                        if (rc < 0) {
-                            MP_ERR(arg, "Write error (%s)\n", mp_strerror(errno));
-                            talloc_free(reply_msg);
-                            goto done;
-                        }
-                    }
+        if (poll(fds, num_fds, -1) < 0) {
+            if (errno != EINTR)
+                MP_ERR(loop, "Poll error\n");
+            continue;
+        }
 
-                    talloc_free(reply_msg);
-                }
+        if (fds[0].revents & POLLIN)
+            mp_flush_wakeup_pipe(loop->wakeup_pipe[0]);
+
+        // Backwards, so removing a client doesn't affect the fds mapping.
+        for (int n = loop->num_clients - 1; n >= 0; n--) {
+            struct client_arg *arg = loop->clients[n];
+            if (!client_process(arg, &fds[1 + n * 2])) {
+                client_destroy(arg);
+                MP_TARRAY_REMOVE_AT(loop->clients, loop->num_clients, n);
             }
         }
     }
 
-done:
-    if (client_msg.len > 0)
-        MP_WARN(arg, "Ignoring unterminated command on disconnect.\n");
-    talloc_free(client_msg.start);
-    if (arg->close_client_fd)
-        close(arg->client_fd);
-    struct mpv_handle *h = arg->client;
-    bool quit = arg->quit_on_close;
-    talloc_free(arg);
-    if (quit) {
-        mpv_terminate_destroy(h);
-    } else {
-        mpv_destroy(h);
-    }
+    close(loop->wakeup_pipe[0]);
+    close(loop->wakeup_pipe[1]);
+    pthread_mutex_destroy(&loop->lock);
+    talloc_free(loop);
     return NULL;
 }
 
+static struct client_loop *client_loop_create(struct mpv_global *global)
+{
+    struct client_loop *loop = talloc_ptrtype(NULL, loop);
+    *loop = (struct client_loop){
+        .log = mp_log_new(loop, global->log, "ipc"),
+    };
+
+    if (mp_make_wakeup_pipe(loop->wakeup_pipe) < 0) {
+        talloc_free(loop);
+        return NULL;
+    }
+
+    pthread_mutex_init(&loop->lock, NULL);
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, client_loop_thread, loop)) {
+        pthread_mutex_destroy(&loop->lock);
+        close(loop->wakeup_pipe[0]);
+        close(loop->wakeup_pipe[1]);
+        talloc_free(loop);
+        return NULL;
+    }
+
+    return loop;
+}
+
+// Let the loop exit once all its clients are gone.
+static void client_loop_detach(struct client_loop *loop)
+{
+    pthread_mutex_lock(&loop->lock);
+    loop->detached = true;
+    pthread_mutex_unlock(&loop->lock);
+    (void)write(loop->wakeup_pipe[1], &(char){0}, 1);
+}
+
 static bool ipc_start_client(struct mp_ipc_ctx *ctx, struct client_arg *client,
                              bool free_on_init_fail)
 {
@@ -232,9 +361,22 @@ static bool ipc_start_client(struct mp_ipc_ctx *ctx, struct client_arg *client,
 
     client->log = mp_client_get_log(client->client);
 
-    pthread_t client_thr;
-    if (pthread_create(&client_thr, NULL, client_thread, client))
+    client->wakeup_fd = mpv_get_wakeup_pipe(client->client);
+    if (client->wakeup_fd < 0) {
+        MP_ERR(client, "Could not get wakeup pipe\n");
         goto err;
+    }
+
+    fcntl(client->client_fd, F_SETFL,
+          fcntl(client->client_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    MP_VERBOSE(client, "Client connected\n");
+
+    struct client_loop *loop = ctx->loop;
+    pthread_mutex_lock(&loop->lock);
+    MP_TARRAY_APPEND(loop, loop->new_clients, loop->num_new_clients, client);
+    pthread_mutex_unlock(&loop->lock);
+    (void)write(loop->wakeup_pipe[1], &(char){0}, 1);
 
     return true;
 
@@ -261,6 +403,7 @@ static void ipc_start_client_json(struct mp_ipc_ctx *ctx, int id, int fd)
         .close_client_fd = id >= 0,
         .quit_on_close = id < 0,
         .writable = true,
+        .events_pending = true,
     };
 
     ipc_start_client(ctx, client, true);
@@ -269,6 +412,9 @@ static void ipc_start_client_json(struct mp_ipc_ctx *ctx, int id, int fd)
 bool mp_ipc_start_anon_client(struct mp_ipc_ctx *ctx, struct mpv_handle *h,
                               int out_fd[2])
 {
+    if (!ctx)
+        return false;
+
     int pair[2];
     if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair))
         return false;
@@ -282,6 +428,7 @@ bool mp_ipc_start_anon_client(struct mp_ipc_ctx *ctx, struct mpv_handle *h,
         .client_fd   = pair[1],
         .close_client_fd = true,
         .writable = true,
+        .events_pending = true,
     };
 
     if (!ipc_start_client(ctx, client, false)) {
@@ -392,9 +539,17 @@ struct mp_ipc_ctx *mp_init_ipc(struct mp_client_api *client_api,
         .log        = mp_log_new(arg, global->log, "ipc"),
         .client_api = client_api,
         .path       = mp_get_user_path(arg, global, opts->ipc_path),
+        .loop       = client_loop_create(global),
         .death_pipe = {-1, -1},
     };
 
+    if (!arg->loop) {
+        MP_ERR(arg, "Could not start IPC client thread\n");
+        talloc_free(opts);
+        talloc_free(arg);
+        return NULL;
+    }
+
     if (opts->ipc_client && opts->ipc_client[0]) {
         int fd = -1;
         if (strncmp(opts->ipc_client, "fd://", 5) == 0) {
@@ -412,8 +567,9 @@ struct mp_ipc_ctx *mp_init_ipc(struct mp_client_api *client_api,
 
     talloc_free(opts);
 
+    // Without a listening socket, the ctx still serves anonymous clients.
     if (!arg->path || !arg->path[0])
-        goto out;
+        return arg;
 
     if (mp_make_wakeup_pipe(arg->death_pipe) < 0)
         goto out;
@@ -427,9 +583,9 @@ out:
     if (arg->death_pipe[0] >= 0) {
         close(arg->death_pipe[0]);
         close(arg->death_pipe[1]);
+        arg->death_pipe[0] = arg->death_pipe[1] = -1;
     }
-    talloc_free(arg);
-    return NULL;
+    return arg;
 }
 
 void mp_uninit_ipc(struct mp_ipc_ctx *arg)
@@ -437,10 +593,14 @@ void mp_uninit_ipc(struct mp_ipc_ctx *arg)
     if (!arg)
         return;
 
-    (void)write(arg->death_pipe[1], &(char){0}, 1);
-    pthread_join(arg->thread, NULL);
+    if (arg->death_pipe[0] >= 0) {
+        (void)write(arg->death_pipe[1], &(char){0}, 1);
+        pthread_join(arg->thread, NULL);
+
+        close(arg->death_pipe[0]);
+        close(arg->death_pipe[1]);
+    }
 
-    close(arg->death_pipe[0]);
-    close(arg->death_pipe[1]);
+    client_loop_detach(arg->loop);
     talloc_free(arg);
 }
@@ -33,6 +33,9 @@
 #include "options/options.h"
 #include "player/client.h"
 
+// Maximum number of events fetched with a single mpv_wait_events() call.
+#define EVENT_BATCH 64
+
 struct mp_ipc_ctx {
     struct mp_log *log;
     struct mp_client_api *client_api;
@@ -50,6 +53,7 @@ struct client_arg {
     HANDLE client_h;
     bool writable;
     OVERLAPPED write_ol;
+    struct mp_ipc_conn conn;
 };
 
 // Get a string SID representing the current user. Must be freed by LocalFree.
@@ -167,11 +171,11 @@ static bool pipe_error_is_fatal(DWORD error)
     return true;
 }
 
-static DWORD ipc_write_str(struct client_arg *arg, const char *buf)
+static DWORD ipc_write(struct client_arg *arg, bstr buf)
 {
     DWORD error = 0;
 
-    if ((error = async_write(arg->client_h, buf, strlen(buf), &arg->write_ol)))
+    if ((error = async_write(arg->client_h, buf.start, buf.len, &arg->write_ol)))
         goto done;
     if (!GetOverlappedResult(arg->client_h, &arg->write_ol, &(DWORD){0}, TRUE)) {
         error = GetLastError();
@@ -241,25 +245,31 @@ static void *client_thread(void *p)
             ResetEvent(wakeup_event);
 
             while (1) {
-                mpv_event *event = mpv_wait_event(arg->client, 0);
+                mpv_event events[EVENT_BATCH];
+                int num_events =
+                    mpv_wait_events(arg->client, 0, events, EVENT_BATCH);
 
-                if (event->event_id == MPV_EVENT_NONE)
+                if (!num_events)
                     break;
 
-                if (event->event_id == MPV_EVENT_SHUTDOWN)
-                    goto done;
+                for (int i = 0; i < num_events; i++) {
+                    mpv_event *event = &events[i];
 
-                if (!arg->writable)
-                    continue;
+                    if (event->event_id == MPV_EVENT_SHUTDOWN)
+                        goto done;
 
-                char *event_msg = mp_json_encode_event(event);
-                if (!event_msg) {
-                    MP_ERR(arg, "Encoding error\n");
-                    goto done;
-                }
+                    if (!arg->writable)
+                        continue;
 
-                ipc_write_str(arg, event_msg);
-                talloc_free(event_msg);
+                    bstr event_msg = mp_ipc_encode_event(&arg->conn, event);
+                    if (!event_msg.start) {
+                        MP_ERR(arg, "Encoding error\n");
+                        goto done;
+                    }
+
+                    ipc_write(arg, event_msg);
+                    talloc_free(event_msg.start);
+                }
             }
 
             break;
@@ -271,12 +281,12 @@ static void *client_thread(void *p)
             }
 
             bstr_xappend(NULL, &client_msg, (bstr){buf, r});
-            while (bstrchr(client_msg, '\n') != -1) {
-                char *reply_msg = mp_ipc_consume_next_command(arg->client,
-                    NULL, &client_msg);
-                if (reply_msg && arg->writable)
-                    ipc_write_str(arg, reply_msg);
-                talloc_free(reply_msg);
+            while (mp_ipc_has_next_command(&arg->conn, client_msg)) {
+                bstr reply_msg = mp_ipc_consume_next_command(arg->client,
+                    &arg->conn, NULL, &client_msg);
+                if (reply_msg.len && arg->writable)
+                    ipc_write(arg, reply_msg);
+                talloc_free(reply_msg.start);
             }
 
             // Begin the next read operation on the pipe
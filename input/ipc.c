@@ -20,6 +20,7 @@
 #include "common/msg.h"
 #include "input/input.h"
 #include "misc/json.h"
+#include "misc/msgpack.h"
 #include "misc/node.h"
 #include "options/m_option.h"
 #include "options/options.h"
@@ -74,6 +75,19 @@ static void mpv_node_map_add_string(void *ta_parent, mpv_node *src, const char *
     mpv_node_map_add(ta_parent, src, key, &val_node);
 }
 
+// Interval argument of the observe commands, in seconds.
+static bool get_interval(mpv_node *node, double *out)
+{
+    if (node->format == MPV_FORMAT_INT64) {
+        *out = node->u.int64;
+    } else if (node->format == MPV_FORMAT_DOUBLE) {
+        *out = node->u.double_;
+    } else {
+        return false;
+    }
+    return *out >= 0;
+}
+
 // This is supposed to write a reply that looks like "normal" command execution.
 static void mpv_format_command_reply(void *ta_parent, mpv_event *event,
                                      mpv_node *dst)
@@ -89,9 +103,40 @@ static void mpv_format_command_reply(void *ta_parent, mpv_event *event,
     mpv_node_map_add(ta_parent, dst, "data", &cmd->result);
 }
 
-char *mp_json_encode_event(mpv_event *event)
+// Binary protocol frames: payload size as 4 byte big endian, followed by the
+// MessagePack encoded payload.
+#define FRAME_HEADER 4
+
+static uint32_t frame_size(bstr buf)
 {
-    void *ta_parent = talloc_new(NULL);
+    const unsigned char *p = buf.start;
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+// Encode a reply or event with the protocol currently used by the connection.
+static bstr encode_node(struct mp_ipc_conn *conn, void *ta_parent,
+                        mpv_node *node)
+{
+    if (!conn->msgpack) {
+        char *output = talloc_strdup(ta_parent, "");
+        json_write(&output, node);
+        output = ta_talloc_strdup_append(output, "\n");
+        return bstr0(output);
+    }
+
+    bstr output = {0};
+    char header[FRAME_HEADER] = {0}; // filled in below
+    bstr_xappend(ta_parent, &output, (bstr){header, FRAME_HEADER});
+    msgpack_write(ta_parent, &output, node);
+    uint32_t size = output.len - FRAME_HEADER;
+    for (int n = 0; n < FRAME_HEADER; n++)
+        output.start[n] = size >> ((FRAME_HEADER - 1 - n) * 8);
+    return output;
+}
+
+bstr mp_ipc_encode_event(struct mp_ipc_conn *conn, mpv_event *event)
+{
+    void *ta_parent = talloc_new_arena(NULL);
 
     struct mpv_node event_node;
     if (event->event_id == MPV_EVENT_COMMAND_REPLY) {
@@ -103,44 +148,35 @@ char *mp_json_encode_event(mpv_event *event)
         talloc_steal(ta_parent, node_get_alloc(&event_node));
     }
 
-    char *output = talloc_strdup(NULL, "");
-    json_write(&output, &event_node);
-    output = ta_talloc_strdup_append(output, "\n");
+    bstr output = encode_node(conn, NULL, &event_node);
 
     talloc_free(ta_parent);
 
     return output;
 }
 
-// Function is allowed to modify src[n].
-static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
-                                  char *src)
+// msg_node is NULL if the command could not be parsed.
+static bstr execute_command(struct mpv_handle *client, struct mp_ipc_conn *conn,
+                            void *ta_parent, mpv_node *msg_node)
 {
     int rc;
     const char *cmd = NULL;
     struct mp_log *log = mp_client_get_log(client);
 
-    mpv_node msg_node;
     mpv_node reply_node = {.format = MPV_FORMAT_NODE_MAP, .u.list = NULL};
     mpv_node *reqid_node = NULL;
     int64_t reqid = 0;
     mpv_node *async_node = NULL;
     bool async = false;
     bool send_reply = true;
+    bool msgpack = conn->msgpack;
 
-    rc = json_parse(ta_parent, &msg_node, &src, 50);
-    if (rc < 0) {
-        mp_err(log, "malformed JSON received: '%s'\n", src);
-        rc = MPV_ERROR_INVALID_PARAMETER;
-        goto error;
-    }
-
-    if (msg_node.format != MPV_FORMAT_NODE_MAP) {
+    if (!msg_node || msg_node->format != MPV_FORMAT_NODE_MAP) {
         rc = MPV_ERROR_INVALID_PARAMETER;
         goto error;
     }
 
-    async_node = node_map_get(&msg_node, "async");
+    async_node = node_map_get(msg_node, "async");
     if (async_node) {
         if (async_node->format != MPV_FORMAT_FLAG) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -149,7 +185,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         async = async_node->u.flag;
     }
 
-    reqid_node = node_map_get(&msg_node, "request_id");
+    reqid_node = node_map_get(msg_node, "request_id");
     if (reqid_node) {
         if (reqid_node->format == MPV_FORMAT_INT64) {
             reqid = reqid_node->u.int64;
@@ -163,7 +199,7 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         }
     }
 
-    mpv_node *cmd_node = node_map_get(&msg_node, "command");
+    mpv_node *cmd_node = node_map_get(msg_node, "command");
     if (!cmd_node) {
         rc = MPV_ERROR_INVALID_PARAMETER;
         goto error;
@@ -191,6 +227,27 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
         int64_t ver = mpv_client_api_version();
         mpv_node_map_add_int64(ta_parent, &reply_node, "data", ver);
         rc = MPV_ERROR_SUCCESS;
+    } else if (cmd && !strcmp("set_protocol", cmd)) {
+        if (cmd_node->u.list->num != 2) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        if (cmd_node->u.list->values[1].format != MPV_FORMAT_STRING) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        char *name = cmd_node->u.list->values[1].u.string;
+        if (!strcmp(name, "json")) {
+            msgpack = false;
+        } else if (!strcmp(name, "msgpack")) {
+            msgpack = true;
+        } else {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+        rc = MPV_ERROR_SUCCESS;
     } else if (cmd && !strcmp("get_property", cmd)) {
         mpv_node result_node;
 
@@ -210,6 +267,25 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
             mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
             mpv_free_node_contents(&result_node);
         }
+    } else if (cmd && !strcmp("get_properties", cmd)) {
+        mpv_node result_node;
+        int num = cmd_node->u.list->num;
+        const char **names = talloc_array(ta_parent, const char *, num);
+
+        for (int n = 1; n < num; n++) {
+            if (cmd_node->u.list->values[n].format != MPV_FORMAT_STRING) {
+                rc = MPV_ERROR_INVALID_PARAMETER;
+                goto error;
+            }
+            names[n - 1] = cmd_node->u.list->values[n].u.string;
+        }
+        names[num - 1] = NULL;
+
+        rc = mpv_get_properties(client, names, &result_node);
+        if (rc >= 0) {
+            mpv_node_map_add(ta_parent, &reply_node, "data", &result_node);
+            mpv_free_node_contents(&result_node);
+        }
     } else if (cmd && !strcmp("get_property_string", cmd)) {
         if (cmd_node->u.list->num != 2) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -244,8 +320,17 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
 
         rc = mpv_set_property(client, cmd_node->u.list->values[1].u.string,
                               MPV_FORMAT_NODE, &cmd_node->u.list->values[2]);
+    } else if (cmd && !strcmp("set_properties", cmd)) {
+        if (cmd_node->u.list->num != 2) {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        rc = mpv_set_properties(client, &cmd_node->u.list->values[1]);
     } else if (cmd && !strcmp("observe_property", cmd)) {
-        if (cmd_node->u.list->num != 3) {
+        double interval = 0;
+
+        if (cmd_node->u.list->num != 3 && cmd_node->u.list->num != 4) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
@@ -260,12 +345,21 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
             goto error;
         }
 
-        rc = mpv_observe_property(client,
-                                  cmd_node->u.list->values[1].u.int64,
-                                  cmd_node->u.list->values[2].u.string,
-                                  MPV_FORMAT_NODE);
+        if (cmd_node->u.list->num == 4 &&
+            !get_interval(&cmd_node->u.list->values[3], &interval))
+        {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        rc = mpv_observe_property_interval(client,
+                                           cmd_node->u.list->values[1].u.int64,
+                                           cmd_node->u.list->values[2].u.string,
+                                           MPV_FORMAT_NODE, interval);
     } else if (cmd && !strcmp("observe_property_string", cmd)) {
-        if (cmd_node->u.list->num != 3) {
+        double interval = 0;
+
+        if (cmd_node->u.list->num != 3 && cmd_node->u.list->num != 4) {
             rc = MPV_ERROR_INVALID_PARAMETER;
             goto error;
         }
@@ -280,10 +374,17 @@ static char *json_execute_command(struct mpv_handle *client, void *ta_parent,
             goto error;
         }
 
-        rc = mpv_observe_property(client,
-                                  cmd_node->u.list->values[1].u.int64,
-                                  cmd_node->u.list->values[2].u.string,
-                                  MPV_FORMAT_STRING);
+        if (cmd_node->u.list->num == 4 &&
+            !get_interval(&cmd_node->u.list->values[3], &interval))
+        {
+            rc = MPV_ERROR_INVALID_PARAMETER;
+            goto error;
+        }
+
+        rc = mpv_observe_property_interval(client,
+                                           cmd_node->u.list->values[1].u.int64,
+                                           cmd_node->u.list->values[2].u.string,
+                                           MPV_FORMAT_STRING, interval);
     } else if (cmd && !strcmp("unobserve_property", cmd)) {
         if (cmd_node->u.list->num != 2) {
             rc = MPV_ERROR_INVALID_PARAMETER;
@@ -372,26 +473,73 @@ error:
 
     mpv_node_map_add_string(ta_parent, &reply_node, "error", mpv_error_string(rc));
 
-    char *output = talloc_strdup(ta_parent, "");
+    bstr output = {0};
 
-    if (send_reply) {
-        json_write(&output, &reply_node);
-        output = ta_talloc_strdup_append(output, "\n");
-    }
+    // The reply to set_protocol still uses the old protocol.
+    if (send_reply)
+        output = encode_node(conn, ta_parent, &reply_node);
+
+    if (rc >= 0)
+        conn->msgpack = msgpack;
 
     return output;
 }
 
-static char *text_execute_command(struct mpv_handle *client, void *tmp, char *src)
+static bstr json_execute_command(struct mpv_handle *client,
+                                 struct mp_ipc_conn *conn, void *ta_parent,
+                                 char *src)
+{
+    mpv_node msg_node;
+    if (json_parse(ta_parent, &msg_node, &src, 50) < 0) {
+        mp_err(mp_client_get_log(client), "malformed JSON received: '%s'\n", src);
+        return execute_command(client, conn, ta_parent, NULL);
+    }
+    return execute_command(client, conn, ta_parent, &msg_node);
+}
+
+static bstr msgpack_execute_command(struct mpv_handle *client,
+                                    struct mp_ipc_conn *conn, void *ta_parent,
+                                    bstr src)
+{
+    mpv_node msg_node;
+    if (msgpack_parse(ta_parent, &msg_node, &src, 50) < 0 || src.len) {
+        mp_err(mp_client_get_log(client), "malformed MessagePack received\n");
+        return execute_command(client, conn, ta_parent, NULL);
+    }
+    return execute_command(client, conn, ta_parent, &msg_node);
+}
+
+static bstr text_execute_command(struct mpv_handle *client, void *tmp, char *src)
 {
     mpv_command_string(client, src);
 
-    return NULL;
+    return (bstr){0};
 }
 
-char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *buf)
+bool mp_ipc_has_next_command(struct mp_ipc_conn *conn, bstr buf)
 {
-    void *tmp = talloc_new(NULL);
+    if (!conn->msgpack)
+        return bstrchr(buf, '\n') != -1;
+    return buf.len >= FRAME_HEADER && buf.len - FRAME_HEADER >= frame_size(buf);
+}
+
+bstr mp_ipc_consume_next_command(struct mpv_handle *client,
+                                 struct mp_ipc_conn *conn, void *ctx, bstr *buf)
+{
+    void *tmp = talloc_new_arena(NULL);
+
+    if (conn->msgpack) {
+        size_t size = frame_size(*buf);
+        bstr frame = {buf->start + FRAME_HEADER, size};
+        bstr rest = {frame.start + size, buf->len - FRAME_HEADER - size};
+        talloc_steal(tmp, buf->start);
+        *buf = bstrdup(NULL, rest);
+
+        bstr reply_msg = msgpack_execute_command(client, conn, tmp, frame);
+        talloc_steal(ctx, reply_msg.start);
+        talloc_free(tmp);
+        return reply_msg;
+    }
 
     bstr rest;
     bstr line = bstr_getline(*buf, &rest);
@@ -401,16 +549,16 @@ char *mp_ipc_consume_next_command(struct mpv_handle *client, void *ctx, bstr *bu
 
     json_skip_whitespace(&line0);
 
-    char *reply_msg = NULL;
+    bstr reply_msg = {0};
     if (line0[0] == '\0' || line0[0] == '#') {
         // skip
     } else if (line0[0] == '{') {
-        reply_msg = json_execute_command(client, tmp, line0);
+        reply_msg = json_execute_command(client, conn, tmp, line0);
     } else {
         reply_msg = text_execute_command(client, tmp, line0);
     }
 
-    talloc_steal(ctx, reply_msg);
+    talloc_steal(ctx, reply_msg.start);
     talloc_free(tmp);
     return reply_msg;
 }
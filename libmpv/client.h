@@ -242,7 +242,7 @@ extern "C" {
  * relational operators (<, >, <=, >=).
  */
 #define MPV_MAKE_VERSION(major, minor) (((major) << 16) | (minor) | 0UL)
-#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(2, 0)
+#define MPV_CLIENT_API_VERSION MPV_MAKE_VERSION(2, 7)
 
 /**
  * The API user is allowed to "#define MPV_ENABLE_DEPRECATED 0" before
@@ -1070,6 +1070,16 @@ MPV_EXPORT int mpv_set_property(mpv_handle *ctx, const char *name, mpv_format fo
  */
 MPV_EXPORT int mpv_set_property_string(mpv_handle *ctx, const char *name, const char *data);
 
+/**
+ * Set multiple properties at once. This is like calling mpv_set_property()
+ * with MPV_FORMAT_NODE for each map entry in order, but the core is locked
+ * only once for all of them. Setting stops at the first property that fails.
+ *
+ * @param properties a MPV_FORMAT_NODE_MAP of property names and new values
+ * @return error code of the first failing property, or 0 on success
+ */
+MPV_EXPORT int mpv_set_properties(mpv_handle *ctx, mpv_node *properties);
+
 /**
  * Set a property asynchronously. You will receive the result of the operation
  * as MPV_EVENT_SET_PROPERTY_REPLY event. The mpv_event.error field will contain
@@ -1133,6 +1143,22 @@ MPV_EXPORT char *mpv_get_property_string(mpv_handle *ctx, const char *name);
  */
 MPV_EXPORT char *mpv_get_property_osd_string(mpv_handle *ctx, const char *name);
 
+/**
+ * Read multiple properties at once. This is like calling mpv_get_property()
+ * with MPV_FORMAT_NODE for each name, but the core is locked only once, so
+ * all values are from the same point in time.
+ *
+ * @param names NULL-terminated array of property names
+ * @param[out] result set to a MPV_FORMAT_NODE_MAP with an entry for each
+ *                    name (in order). Properties that are unavailable or
+ *                    failed to be read have a MPV_FORMAT_NONE entry. Free
+ *                    with mpv_free_node_contents().
+ * @return error code (fails only if the parameters are invalid or the core
+ *         is not initialized; errors of single properties are not reported)
+ */
+MPV_EXPORT int mpv_get_properties(mpv_handle *ctx, const char **names,
+                                  mpv_node *result);
+
 /**
  * Get a property asynchronously. You will receive the result of the operation
  * as well as the property data with the MPV_EVENT_GET_PROPERTY_REPLY event.
@@ -1206,6 +1232,26 @@ MPV_EXPORT int mpv_get_property_async(mpv_handle *ctx, uint64_t reply_userdata,
 MPV_EXPORT int mpv_observe_property(mpv_handle *mpv, uint64_t reply_userdata,
                                     const char *name, mpv_format format);
 
+/**
+ * Like mpv_observe_property(), but send at most one MPV_EVENT_PROPERTY_CHANGE
+ * per min_interval seconds for this property. Changes within the interval are
+ * coalesced, and the property is not even read until the interval has passed,
+ * so the event carries the value at the end of the interval. The initial
+ * change notification is sent immediately.
+ *
+ * This is meant for properties that change very often (like "time-pos"), if
+ * the client would rate limit the updates anyway.
+ *
+ * @param min_interval Minimum time between change events in seconds. 0 is the
+ *                     same as mpv_observe_property().
+ * @return error code (also fails if min_interval is negative)
+ */
+MPV_EXPORT int mpv_observe_property_interval(mpv_handle *mpv,
+                                             uint64_t reply_userdata,
+                                             const char *name,
+                                             mpv_format format,
+                                             double min_interval);
+
 /**
  * Undo mpv_observe_property(). This will remove all observed properties for
  * which the given number was passed as reply_userdata to mpv_observe_property.
@@ -1687,13 +1733,35 @@ MPV_EXPORT int mpv_request_log_messages(mpv_handle *ctx, const char *min_level);
  *                will wait with an infinite timeout.
  * @return A struct containing the event ID and other data. The pointer (and
  *         fields in the struct) stay valid until the next mpv_wait_event()
- *         call, or until the mpv_handle is destroyed. You must not write to
+ *         or mpv_wait_events() call, or until the mpv_handle is destroyed. You must not write to
  *         the struct, and all memory referenced by it will be automatically
  *         released by the API on the next mpv_wait_event() call, or when the
  *         context is destroyed. The return value is never NULL.
  */
 MPV_EXPORT mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout);
 
+/**
+ * Like mpv_wait_event(), but return up to max_events events at once. This
+ * waits for the first event like mpv_wait_event() (the timeout has the same
+ * meaning), and then fetches all further events that are available without
+ * waiting, up to max_events. This is more efficient than calling
+ * mpv_wait_event() in a loop if many events are expected, such as when many
+ * properties are observed.
+ *
+ * The same thread restrictions as with mpv_wait_event() apply.
+ *
+ * @param events Array with room for at least max_events entries, to which the
+ *               events are written. MPV_EVENT_NONE is never returned in it.
+ *               All memory referenced by the events stays valid until the next
+ *               mpv_wait_events() or mpv_wait_event() call, or until the
+ *               mpv_handle is destroyed. Calling either function also
+ *               invalidates the event returned by a previous mpv_wait_event().
+ * @param max_events Size of the events array. Must be at least 1.
+ * @return Number of events written to the events array. 0 on timeout.
+ */
+MPV_EXPORT int mpv_wait_events(mpv_handle *ctx, double timeout,
+                               mpv_event *events, int max_events);
+
 /**
  * Interrupt the current mpv_wait_event() call. This will wake up the thread
  * currently waiting in mpv_wait_event(). If no thread is waiting, the next
@@ -50,6 +50,7 @@ extern "C" {
  * ------------------
  *
  * OpenGL: via MPV_RENDER_API_TYPE_OPENGL, see render_gl.h header.
+ * Vulkan: via MPV_RENDER_API_TYPE_VULKAN, see render_vk.h header.
  * Software: via MPV_RENDER_API_TYPE_SW, see section "Software renderer"
  *
  * Threading
@@ -135,7 +136,10 @@ extern "C" {
  * Call mpv_render_context_render() with various MPV_RENDER_PARAM_SW_* fields
  * to render the video frame to an in-memory surface. The following fields are
  * required: MPV_RENDER_PARAM_SW_SIZE, MPV_RENDER_PARAM_SW_FORMAT,
- * MPV_RENDER_PARAM_SW_STRIDE, MPV_RENDER_PARAM_SW_POINTER.
+ * MPV_RENDER_PARAM_SW_STRIDE, MPV_RENDER_PARAM_SW_POINTER. If the video
+ * is not scaled, and the target format is the same as the video format, the
+ * video is copied instead of converted. MPV_RENDER_PARAM_SW_DAMAGE can be
+ * used to avoid redundant rendering when redrawing unchanged frames.
  *
  * This method of rendering is very slow, because everything, including color
  * conversion, scaling, and OSD rendering, is done on the CPU, single-threaded.
@@ -188,6 +192,9 @@ typedef enum mpv_render_param_type {
      *      It is expected that an OpenGL context is valid and "current" when
      *      calling mpv_render_* functions (unless specified otherwise). It
      *      must be the same context for the same mpv_render_context.
+     *   MPV_RENDER_API_TYPE_VULKAN:
+     *      Vulkan 1.1 or later, on a device created by the API user.
+     *      Providing MPV_RENDER_PARAM_VULKAN_INIT_PARAMS is required.
      */
     MPV_RENDER_PARAM_API_TYPE = 1,
     /**
@@ -421,6 +428,63 @@ typedef enum mpv_render_param_type {
      * See MPV_RENDER_PARAM_SW_STRIDE for alignment requirements.
      */
     MPV_RENDER_PARAM_SW_POINTER = 20,
+    /**
+     * OpenGL only. Valid for mpv_render_context_render(). Return a fence for
+     * the rendering commands issued by this call.
+     *
+     * Type: void** (really GLsync*)
+     *
+     * If this is set, mpv creates a sync object with glFenceSync() after
+     * issuing all commands for the frame, flushes the command stream, and
+     * writes the sync object to the pointed-to variable (or NULL if fences
+     * are not supported by the OpenGL context). The user owns the sync object
+     * and must free it with glDeleteSync(). If nothing was rendered (e.g. with
+     * MPV_RENDER_PARAM_SKIP_RENDERING, or on errors), the variable is left
+     * untouched, so it should be initialized to NULL.
+     *
+     * This lets the API user issue its own rendering without waiting for
+     * mpv's rendering to finish, and synchronize only where the result is
+     * needed, e.g. by calling glWaitSync() on a shared context before
+     * sampling the FBO, or by polling it with glClientWaitSync() and a 0
+     * timeout. Combine it with MPV_RENDER_PARAM_BLOCK_FOR_TARGET_TIME=0 and
+     * the target_time returned by MPV_RENDER_PARAM_NEXT_FRAME_INFO to
+     * schedule mpv_render_context_render() calls yourself, so that they
+     * never block on video timing.
+     *
+     * Note that this does not make mpv_render_context_render() fully
+     * asynchronous: the GPU commands are still issued on the calling thread,
+     * and the OpenGL context must be current, as usual.
+     */
+    MPV_RENDER_PARAM_OPENGL_FENCE = 21,
+    /**
+     * Required parameters for initializing the Vulkan renderer. Valid for
+     * mpv_render_context_create().
+     * Type: mpv_vulkan_init_params*
+     */
+    MPV_RENDER_PARAM_VULKAN_INIT_PARAMS = 22,
+    /**
+     * Describes a Vulkan render target. Valid for mpv_render_context_render().
+     * Type: mpv_vulkan_fbo*
+     */
+    MPV_RENDER_PARAM_VULKAN_FBO = 23,
+    /**
+     * MPV_RENDER_API_TYPE_SW only: return the part of the target surface that
+     * was written, and allow mpv to skip unchanged parts. Optional.
+     * Valid for MPV_RENDER_API_TYPE_SW & mpv_render_context_render().
+     * Type: int*: points to an int[4] (x0, y0, x1, y1), written by mpv
+     *
+     * If this is set, the API user promises that the contents of the target
+     * surface were not changed since the last mpv_render_context_render()
+     * call that used the same pointer, stride, size, and format. mpv may then
+     * leave parts that would be rendered identically untouched (for example
+     * when the same video frame is redrawn), and sets the rect to the bounding
+     * box of the pixels it wrote (x1 and y1 are exclusive). If nothing was
+     * written, the rect has 0 size. The API user can use this to update only
+     * the damaged part of its own output.
+     *
+     * If this is not set, the entire surface is rendered on every call.
+     */
+    MPV_RENDER_PARAM_SW_DAMAGE = 24,
 } mpv_render_param_type;
 
 /**
@@ -465,6 +529,8 @@ typedef struct mpv_render_param {
  */
 // See render_gl.h
 #define MPV_RENDER_API_TYPE_OPENGL "opengl"
+// See render_vk.h
+#define MPV_RENDER_API_TYPE_VULKAN "vulkan"
 // See section "Software renderer"
 #define MPV_RENDER_API_TYPE_SW "sw"
 
@@ -76,7 +76,9 @@ extern "C" {
  * MPV_RENDER_API_TYPE_OPENGL, and MPV_RENDER_PARAM_OPENGL_INIT_PARAMS provided.
  *
  * Call mpv_render_context_render() with MPV_RENDER_PARAM_OPENGL_FBO to render
- * the video frame to an FBO.
+ * the video frame to an FBO. Pass MPV_RENDER_PARAM_OPENGL_FENCE to get a
+ * GLsync object for the rendering, instead of relying on implicit
+ * synchronization.
  *
  * Hardware decoding
  * -----------------
@@ -0,0 +1,166 @@
+/* Copyright (C) 2026 the mpv developers
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef MPV_CLIENT_API_RENDER_VK_H_
+#define MPV_CLIENT_API_RENDER_VK_H_
+
+#include <vulkan/vulkan.h>
+
+#include "render.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Vulkan backend
+ * --------------
+ *
+ * This header contains definitions for using Vulkan with the render.h API.
+ *
+ * The API user owns the Vulkan instance and device, and mpv renders into
+ * VkImages provided by the API user. Unlike with OpenGL, there is no implicit
+ * state: all synchronization is explicit, via semaphores passed with each
+ * render call.
+ *
+ * Use mpv_render_context_create() with MPV_RENDER_PARAM_API_TYPE set to
+ * MPV_RENDER_API_TYPE_VULKAN, and MPV_RENDER_PARAM_VULKAN_INIT_PARAMS
+ * provided.
+ *
+ * Call mpv_render_context_render() with MPV_RENDER_PARAM_VULKAN_FBO to render
+ * the video frame to a VkImage. mpv_render_context_render() does not wait for
+ * the GPU to finish rendering; use the signal semaphore in mpv_vulkan_fbo to
+ * synchronize with it.
+ *
+ * Device requirements
+ * -------------------
+ *
+ * The device must be created for Vulkan 1.1 or later, and should have at
+ * least the extensions and features libplacebo requires (or recommends)
+ * enabled. The list of enabled extensions and features must be passed to
+ * mpv, because the Vulkan API offers no way to query them. Timeline
+ * semaphores (VK_KHR_timeline_semaphore, or Vulkan 1.2) are required if the
+ * semaphores passed with mpv_vulkan_fbo are timeline semaphores.
+ *
+ * Queues
+ * ------
+ *
+ * mpv submits work to the queues given in mpv_vulkan_init_params from the
+ * thread calling mpv_render_* functions. Vulkan requires external
+ * synchronization of vkQueueSubmit() and vkQueuePresentKHR(), so if the API
+ * user submits to the same queues from other threads, it must provide the
+ * lock_queue/unlock_queue callbacks.
+ */
+
+/**
+ * For initializing the mpv Vulkan state via MPV_RENDER_PARAM_VULKAN_INIT_PARAMS.
+ * All handles must remain valid until mpv_render_context_free() returns.
+ */
+typedef struct mpv_vulkan_init_params {
+    /**
+     * The instance the device was created from.
+     */
+    VkInstance instance;
+    /**
+     * Used to resolve all other Vulkan functions. Must not be NULL.
+     */
+    PFN_vkGetInstanceProcAddr get_instance_proc_addr;
+    /**
+     * The physical device and the logical device created from it.
+     */
+    VkPhysicalDevice physical_device;
+    VkDevice device;
+    /**
+     * Device extensions the device was created with.
+     */
+    const char * const *extensions;
+    int num_extensions;
+    /**
+     * Features the device was created with (as a chain of structs that was
+     * passed to vkCreateDevice()), or NULL if no optional features were
+     * enabled.
+     */
+    const VkPhysicalDeviceFeatures2 *features;
+    /**
+     * Queue family index and number of queues mpv may use for rendering.
+     * The family must support graphics and compute operations. queue_count
+     * must be at least 1.
+     */
+    int queue_family_index;
+    int queue_count;
+    /**
+     * Optional. Called around every use of a queue by mpv, with the queue
+     * family and queue index. See "Queues" above.
+     */
+    void (*lock_queue)(void *ctx, uint32_t queue_family, uint32_t index);
+    void (*unlock_queue)(void *ctx, uint32_t queue_family, uint32_t index);
+    /**
+     * Value passed as ctx parameter to lock_queue() and unlock_queue().
+     */
+    void *queue_ctx;
+} mpv_vulkan_init_params;
+
+/**
+ * For MPV_RENDER_PARAM_VULKAN_FBO.
+ */
+typedef struct mpv_vulkan_fbo {
+    /**
+     * The image to render to. It must be a 2D image with 1 mip level and 1
+     * array layer, created on the device passed with
+     * mpv_vulkan_init_params, with exclusive sharing mode, and the usage
+     * below. mpv only accesses it between the wait and signal semaphores.
+     */
+    VkImage image;
+    /**
+     * Valid dimensions and format of the image. These must always be set.
+     */
+    int w, h;
+    VkFormat format;
+    /**
+     * The usage flags the image was created with. It must include at least
+     * VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT. VK_IMAGE_USAGE_STORAGE_BIT and
+     * VK_IMAGE_USAGE_TRANSFER_DST_BIT can make rendering more efficient.
+     */
+    VkImageUsageFlags usage;
+    /**
+     * The layout the image is in when the wait semaphore is signaled
+     * (VK_IMAGE_LAYOUT_UNDEFINED if the contents can be discarded), and the
+     * layout mpv transitions it to before signaling the signal semaphore.
+     */
+    VkImageLayout layout;
+    VkImageLayout final_layout;
+    /**
+     * Optional. mpv waits on this semaphore before accessing the image. For
+     * timeline semaphores, wait_value is the value to wait for (otherwise it
+     * is ignored).
+     */
+    VkSemaphore wait_semaphore;
+    uint64_t wait_value;
+    /**
+     * mpv signals this semaphore once rendering to the image is complete. For
+     * timeline semaphores, signal_value is the value to signal (otherwise it
+     * is ignored). This must be set. It is signaled only if
+     * mpv_render_context_render() actually rendered (i.e. it returned success
+     * and MPV_RENDER_PARAM_SKIP_RENDERING was not set).
+     */
+    VkSemaphore signal_semaphore;
+    uint64_t signal_value;
+} mpv_vulkan_fbo;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -163,6 +163,53 @@ typedef void (*mpv_stream_cb_close_fn)(void *cookie);
  */
 typedef void (*mpv_stream_cb_cancel_fn)(void *cookie);
 
+/**
+ * Data returned by mpv_stream_cb_read_ref_fn. It remains owned by the user.
+ */
+typedef struct mpv_stream_cb_slice {
+    /**
+     * The data. It must remain valid and unchanged until release_fn is called.
+     */
+    const void *data;
+    /**
+     * Number of bytes at data. Must be larger than 0.
+     */
+    uint64_t size;
+    /**
+     * Called by mpv with the opaque parameter when it doesn't access the data
+     * anymore. This can happen on any thread, and also after the close
+     * callback was called. Can be NULL.
+     */
+    void (*release_fn)(void *opaque);
+    void *opaque;
+} mpv_stream_cb_slice;
+
+/**
+ * Alternative read callback, which hands data owned by the user to mpv instead
+ * of copying it into a buffer provided by mpv. This is useful if the data is
+ * already in memory, because the user doesn't need to stage it, and it can be
+ * returned in (possibly large) pieces of any size. Blocking semantics are the
+ * same as with mpv_stream_cb_read_fn. mpv requests the next slice only after
+ * it has consumed the previous one, or after a seek.
+ *
+ * mpv might still copy the data into its own buffers internally.
+ *
+ * This callback can be NULL. If set, it is used instead of read_fn, and read_fn
+ * can be NULL.
+ *
+ * Available since API 2.1.
+ *
+ * @param cookie opaque cookie identifying the stream,
+ *               returned from mpv_stream_cb_open_fn
+ * @param slice set to the data following the current stream position on
+ *              success (mpv initializes it with all fields set to 0)
+ * @return 1 if a slice was returned
+ * @return 0 on EOF
+ * @return -1 on error
+ */
+typedef int (*mpv_stream_cb_read_ref_fn)(void *cookie,
+                                         mpv_stream_cb_slice *slice);
+
 /**
  * See mpv_stream_cb_open_ro_fn callback.
  */
@@ -180,13 +227,15 @@ typedef struct mpv_stream_cb_info {
      * Callbacks set by the user in the mpv_stream_cb_open_ro_fn callback. Some
      * of them are optional, and can be left unset.
      *
-     * The following callbacks are mandatory: read_fn, close_fn
+     * The following callbacks are mandatory: read_fn (or read_ref_fn),
+     * close_fn
      */
     mpv_stream_cb_read_fn read_fn;
     mpv_stream_cb_seek_fn seek_fn;
     mpv_stream_cb_size_fn size_fn;
     mpv_stream_cb_close_fn close_fn;
     mpv_stream_cb_cancel_fn cancel_fn; /* since API 1.106 */
+    mpv_stream_cb_read_ref_fn read_ref_fn; /* since API 2.1 */
 } mpv_stream_cb_info;
 
 /**
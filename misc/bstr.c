@@ -295,9 +295,29 @@ struct bstr bstr_split_utf8(struct bstr str, struct bstr *out_next)
     return bstr_splice(str, 0, str.len - rest.len);
 }
 
+// Skip the initial run of ASCII characters. Checks 8 bytes at a time, which
+// makes validating mostly-ASCII text (e.g. subtitles) much cheaper.
+static struct bstr skip_ascii(struct bstr s)
+{
+    size_t n = 0;
+    while (s.len - n >= 8) {
+        uint64_t v;
+        memcpy(&v, s.start + n, 8);
+        if (v & 0x8080808080808080ULL)
+            break;
+        n += 8;
+    }
+    while (n < s.len && s.start[n] < 0x80)
+        n++;
+    return (struct bstr){s.start + n, s.len - n};
+}
+
 int bstr_validate_utf8(struct bstr s)
 {
-    while (s.len) {
+    while (1) {
+        s = skip_ascii(s);
+        if (!s.len)
+            break;
         if (bstr_decode_utf8(s, &s) < 0) {
             // Try to guess whether the sequence was just cut-off.
             unsigned int codepoint = (unsigned char)s.start[0];
@@ -325,7 +345,10 @@ struct bstr bstr_sanitize_utf8_latin1(void *talloc_ctx, struct bstr s)
     bstr new = {0};
     bstr left = s;
     unsigned char *first_ok = s.start;
-    while (left.len) {
+    while (1) {
+        left = skip_ascii(left);
+        if (!left.len)
+            break;
         int r = bstr_decode_utf8(left, &left);
         if (r < 0) {
             bstr_xappend(talloc_ctx, &new, (bstr){first_ok, left.start - first_ok});
@@ -0,0 +1,184 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "osdep/io.h"
+
+#include "common/common.h"
+#include "dir_cache.h"
+
+// Maximum number of directory listings kept.
+#define MAX_ENTRIES 64
+
+struct listing {
+    char *path;
+    time_t mtime;
+    struct mp_dir_entry *entries;
+    int num_entries;
+    bool have_types;
+};
+
+struct mp_dir_cache {
+    pthread_mutex_t lock;
+    // Least recently used first.
+    struct listing **listings;
+    int num_listings;
+};
+
+static void destroy(void *p)
+{
+    struct mp_dir_cache *cache = p;
+    pthread_mutex_destroy(&cache->lock);
+}
+
+struct mp_dir_cache *mp_dir_cache_create(void *ta_parent)
+{
+    struct mp_dir_cache *cache = talloc_zero(ta_parent, struct mp_dir_cache);
+    talloc_set_destructor(cache, destroy);
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void mp_dir_cache_flush(struct mp_dir_cache *cache)
+{
+    pthread_mutex_lock(&cache->lock);
+    for (int n = 0; n < cache->num_listings; n++)
+        talloc_free(cache->listings[n]);
+    cache->num_listings = 0;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Must be called locked.
+static int find_listing(struct mp_dir_cache *cache, const char *path)
+{
+    for (int n = 0; n < cache->num_listings; n++) {
+        if (strcmp(cache->listings[n]->path, path) == 0)
+            return n;
+    }
+    return -1;
+}
+
+static int copy_entries(void *ta_parent, struct listing *l,
+                        struct mp_dir_entry **out)
+{
+    struct mp_dir_entry *res =
+        talloc_array(ta_parent, struct mp_dir_entry, l->num_entries);
+    for (int n = 0; n < l->num_entries; n++) {
+        res[n] = l->entries[n];
+        res[n].name = talloc_strdup(res, l->entries[n].name);
+    }
+    *out = res;
+    return l->num_entries;
+}
+
+static enum mp_dir_entry_type stat_entry(void *tmp, const char *path,
+                                         const char *name)
+{
+    char *fullpath = talloc_asprintf(tmp, "%s/%s", path, name);
+    struct stat st;
+    enum mp_dir_entry_type type = MP_DIR_ENTRY_NONE;
+    if (stat(fullpath, &st) == 0) {
+        type = S_ISREG(st.st_mode) ? MP_DIR_ENTRY_FILE :
+               S_ISDIR(st.st_mode) ? MP_DIR_ENTRY_DIR : MP_DIR_ENTRY_OTHER;
+    }
+    talloc_free(fullpath);
+    return type;
+}
+
+static struct listing *read_listing(const char *path, time_t mtime,
+                                    bool want_types)
+{
+    DIR *d = opendir(path);
+    if (!d)
+        return NULL;
+    struct listing *l = talloc_zero(NULL, struct listing);
+    l->path = talloc_strdup(l, path);
+    l->mtime = mtime;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        struct mp_dir_entry e = {.name = talloc_strdup(l, de->d_name)};
+        MP_TARRAY_APPEND(l, l->entries, l->num_entries, e);
+    }
+    closedir(d);
+    if (want_types) {
+        for (int n = 0; n < l->num_entries; n++)
+            l->entries[n].type = stat_entry(l, path, l->entries[n].name);
+        l->have_types = true;
+    }
+    return l;
+}
+
+int mp_dir_cache_list(struct mp_dir_cache *cache, void *ta_parent,
+                      const char *path, bool want_types,
+                      struct mp_dir_entry **out, bool *from_cache)
+{
+    if (from_cache)
+        *from_cache = false;
+
+    struct stat st;
+    if (stat(path, &st))
+        return -1;
+
+    if (cache) {
+        pthread_mutex_lock(&cache->lock);
+        int idx = find_listing(cache, path);
+        if (idx >= 0) {
+            struct listing *l = cache->listings[idx];
+            if (l->mtime == st.st_mtime && (l->have_types || !want_types)) {
+                MP_TARRAY_REMOVE_AT(cache->listings, cache->num_listings, idx);
+                MP_TARRAY_APPEND(cache, cache->listings, cache->num_listings, l);
+                int num = copy_entries(ta_parent, l, out);
+                pthread_mutex_unlock(&cache->lock);
+                if (from_cache)
+                    *from_cache = true;
+                return num;
+            }
+        }
+        pthread_mutex_unlock(&cache->lock);
+    }
+
+    // Do the actual I/O unlocked, so slow directories don't block others.
+    struct listing *l = read_listing(path, st.st_mtime, want_types);
+    if (!l)
+        return -1;
+    int num = copy_entries(ta_parent, l, out);
+
+    if (!cache) {
+        talloc_free(l);
+        return num;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    int idx = find_listing(cache, path);
+    if (idx >= 0) {
+        talloc_free(cache->listings[idx]);
+        MP_TARRAY_REMOVE_AT(cache->listings, cache->num_listings, idx);
+    }
+    if (cache->num_listings >= MAX_ENTRIES) {
+        talloc_free(cache->listings[0]);
+        MP_TARRAY_REMOVE_AT(cache->listings, cache->num_listings, 0);
+    }
+    MP_TARRAY_APPEND(cache, cache->listings, cache->num_listings,
+                     talloc_steal(cache, l));
+    pthread_mutex_unlock(&cache->lock);
+
+    return num;
+}
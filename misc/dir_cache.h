@@ -0,0 +1,41 @@
+#ifndef MP_DIR_CACHE_H
+#define MP_DIR_CACHE_H
+
+#include <stdbool.h>
+
+enum mp_dir_entry_type {
+    MP_DIR_ENTRY_UNKNOWN,   // not requested
+    MP_DIR_ENTRY_NONE,      // stat() failed
+    MP_DIR_ENTRY_FILE,
+    MP_DIR_ENTRY_DIR,
+    MP_DIR_ENTRY_OTHER,
+};
+
+struct mp_dir_entry {
+    char *name;
+    enum mp_dir_entry_type type;
+};
+
+struct mp_dir_cache;
+
+// Cache of directory listings, to avoid listing the same directory again for
+// each file of a playlist. A cached listing is used only if the directory's
+// mtime did not change, so each lookup still costs a stat() call. The returned
+// data is always a copy. All functions are thread-safe.
+struct mp_dir_cache *mp_dir_cache_create(void *ta_parent);
+
+// Drop all cached listings.
+void mp_dir_cache_flush(struct mp_dir_cache *cache);
+
+// List the directory contents (including "." and ".."), in readdir() order.
+// Returns the number of entries, and sets *out to an array allocated under
+// ta_parent. Returns -1 if the directory could not be read.
+// If want_types is set, the type field of each entry is set as well (requires
+// a stat() call for each entry, whose results are cached too).
+// cache can be NULL, in which case this always reads the directory.
+// If from_cache is not NULL, it's set to whether the cached listing was used.
+int mp_dir_cache_list(struct mp_dir_cache *cache, void *ta_parent,
+                      const char *path, bool want_types,
+                      struct mp_dir_entry **out, bool *from_cache);
+
+#endif
@@ -27,7 +27,12 @@
 struct mp_dispatch_queue {
     struct mp_dispatch_item *head, *tail;
     pthread_mutex_t lock;
+    // Signaled to wake up the target thread (only it waits on this).
     pthread_cond_t cond;
+    // Signaled to wake up mp_dispatch_lock() callers.
+    pthread_cond_t lock_cond;
+    // The target thread is waiting on cond.
+    bool target_waiting;
     void (*wakeup_fn)(void *wakeup_ctx);
     void *wakeup_ctx;
     void (*onlock_fn)(void *onlock_ctx);
@@ -57,6 +62,7 @@ struct mp_dispatch_item {
     bool asynchronous;
     bool mergeable;
     bool completed;
+    pthread_cond_t *completed_cond; // for synchronous items
     struct mp_dispatch_item *next;
 };
 
@@ -68,6 +74,7 @@ static void queue_dtor(void *p)
     assert(!queue->lock_requests);
     assert(!queue->locked);
     pthread_cond_destroy(&queue->cond);
+    pthread_cond_destroy(&queue->lock_cond);
     pthread_mutex_destroy(&queue->lock);
 }
 
@@ -87,6 +94,7 @@ struct mp_dispatch_queue *mp_dispatch_create(void *ta_parent)
     talloc_set_destructor(queue, queue_dtor);
     pthread_mutex_init(&queue->lock, NULL);
     pthread_cond_init(&queue->cond, NULL);
+    pthread_cond_init(&queue->lock_cond, NULL);
     return queue;
 }
 
@@ -123,6 +131,21 @@ void mp_dispatch_set_onlock_fn(struct mp_dispatch_queue *queue,
     queue->onlock_ctx = onlock_ctx;
 }
 
+// Wake up the target thread if it's blocked in mp_dispatch_queue_process().
+// Waking up only the thread that can make progress (instead of broadcasting to
+// everything that waits on the queue) avoids useless context switches.
+static void wakeup_target(struct mp_dispatch_queue *queue)
+{
+    if (queue->target_waiting)
+        pthread_cond_signal(&queue->cond);
+}
+
+static void wakeup_lockers(struct mp_dispatch_queue *queue)
+{
+    if (queue->lock_requests)
+        pthread_cond_broadcast(&queue->lock_cond);
+}
+
 static void mp_dispatch_append(struct mp_dispatch_queue *queue,
                                struct mp_dispatch_item *item)
 {
@@ -146,9 +169,7 @@ static void mp_dispatch_append(struct mp_dispatch_queue *queue,
     }
     queue->tail = item;
 
-    // Wake up the main thread; note that other threads might wait on this
-    // condition for reasons, so broadcast the condition.
-    pthread_cond_broadcast(&queue->cond);
+    wakeup_target(queue);
     // No wakeup callback -> assume mp_dispatch_queue_process() needs to be
     // interrupted instead.
     if (!queue->wakeup_fn)
@@ -241,16 +262,20 @@ void mp_dispatch_cancel_fn(struct mp_dispatch_queue *queue,
 void mp_dispatch_run(struct mp_dispatch_queue *queue,
                      mp_dispatch_fn fn, void *fn_data)
 {
+    pthread_cond_t completed_cond;
+    pthread_cond_init(&completed_cond, NULL);
     struct mp_dispatch_item item = {
         .fn = fn,
         .fn_data = fn_data,
+        .completed_cond = &completed_cond,
     };
     mp_dispatch_append(queue, &item);
 
     pthread_mutex_lock(&queue->lock);
     while (!item.completed)
-        pthread_cond_wait(&queue->cond, &queue->lock);
+        pthread_cond_wait(&completed_cond, &queue->lock);
     pthread_mutex_unlock(&queue->lock);
+    pthread_cond_destroy(&completed_cond);
 }
 
 // Process any outstanding dispatch items in the queue. This also handles
@@ -277,12 +302,13 @@ void mp_dispatch_queue_process(struct mp_dispatch_queue *queue, double timeout)
     queue->in_process = true;
     queue->in_process_thread = pthread_self();
     // Wake up thread which called mp_dispatch_lock().
-    if (queue->lock_requests)
-        pthread_cond_broadcast(&queue->cond);
+    wakeup_lockers(queue);
     while (1) {
         if (queue->lock_requests) {
             // Block due to something having called mp_dispatch_lock().
+            queue->target_waiting = true;
             pthread_cond_wait(&queue->cond, &queue->lock);
+            queue->target_waiting = false;
         } else if (queue->head) {
             struct mp_dispatch_item *item = queue->head;
             queue->head = item->next;
@@ -302,17 +328,19 @@ void mp_dispatch_queue_process(struct mp_dispatch_queue *queue, double timeout)
             pthread_mutex_lock(&queue->lock);
             assert(queue->locked);
             queue->locked = false;
-            // Wakeup mp_dispatch_run(), also mp_dispatch_lock().
-            pthread_cond_broadcast(&queue->cond);
+            wakeup_lockers(queue);
             if (item->asynchronous) {
                 talloc_free(item);
             } else {
                 item->completed = true;
+                pthread_cond_signal(item->completed_cond);
             }
         } else if (queue->wait > 0 && !queue->interrupted) {
             struct timespec ts = mp_time_us_to_timespec(queue->wait);
+            queue->target_waiting = true;
             if (pthread_cond_timedwait(&queue->cond, &queue->lock, &ts))
                 queue->wait = 0;
+            queue->target_waiting = false;
         } else {
             break;
         }
@@ -333,7 +361,7 @@ void mp_dispatch_interrupt(struct mp_dispatch_queue *queue)
 {
     pthread_mutex_lock(&queue->lock);
     queue->interrupted = true;
-    pthread_cond_broadcast(&queue->cond);
+    wakeup_target(queue);
     pthread_mutex_unlock(&queue->lock);
 }
 
@@ -350,7 +378,7 @@ void mp_dispatch_adjust_timeout(struct mp_dispatch_queue *queue, int64_t until)
     pthread_mutex_lock(&queue->lock);
     if (queue->in_process && queue->wait > until) {
         queue->wait = until;
-        pthread_cond_broadcast(&queue->cond);
+        wakeup_target(queue);
     }
     pthread_mutex_unlock(&queue->lock);
 }
@@ -384,11 +412,11 @@ void mp_dispatch_lock(struct mp_dispatch_queue *queue)
         pthread_mutex_lock(&queue->lock);
         if (queue->in_process)
             break;
-        pthread_cond_wait(&queue->cond, &queue->lock);
+        pthread_cond_wait(&queue->lock_cond, &queue->lock);
     }
     // Wait until we can get the lock.
     while (!queue->in_process || queue->locked)
-        pthread_cond_wait(&queue->cond, &queue->lock);
+        pthread_cond_wait(&queue->lock_cond, &queue->lock);
     // "Lock".
     assert(queue->lock_requests);
     assert(!queue->locked);
@@ -413,6 +441,7 @@ void mp_dispatch_unlock(struct mp_dispatch_queue *queue)
     queue->lock_requests -= 1;
     // Wakeup mp_dispatch_queue_process(), and maybe other mp_dispatch_lock()s.
     // (Would be nice to wake up only 1 other locker if lock_requests>0.)
-    pthread_cond_broadcast(&queue->cond);
+    wakeup_target(queue);
+    wakeup_lockers(queue);
     pthread_mutex_unlock(&queue->lock);
 }
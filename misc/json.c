@@ -103,14 +103,17 @@ static int read_str(void *ta_parent, struct mpv_node *dst, char **src)
     char *str = *src;
     char *cur = str;
     bool has_escapes = false;
-    while (cur[0] && cur[0] != '"') {
-        if (cur[0] == '\\') {
-            has_escapes = true;
-            // skip >\"< and >\\< (latter to handle >\\"< correctly)
-            if (cur[1] == '"' || cur[1] == '\\')
-                cur++;
-        }
-        cur++;
+    while (1) {
+        // strcspn() is usually vectorized by libc.
+        cur += strcspn(cur, "\"\\");
+        if (cur[0] != '\\')
+            break;
+        has_escapes = true;
+        // skip >\"< and >\\< (latter to handle >\\"< correctly)
+        if (cur[1] == '"' || cur[1] == '\\')
+            cur++;
+        if (cur[0])
+            cur++;
     }
     if (cur[0] != '"')
         return -1; // invalid termination
@@ -221,6 +224,13 @@ int json_parse(void *ta_parent, struct mpv_node *dst, char **src, int max_depth)
         long long int numi = strtoll(*src, &nsrci, 0);
         if (errno)
             nsrci = *src;
+        // Skip strtod() if it can't possibly parse more than strtoll() did.
+        if (nsrci > *src && !(*nsrci && strchr(".eEpP", *nsrci))) {
+            *src = nsrci;
+            dst->format = MPV_FORMAT_INT64;
+            dst->u.int64 = numi;
+            return 0;
+        }
         errno = 0;
         double numf = strtod(*src, &nsrcf);
         if (errno)
@@ -251,33 +261,46 @@ static const char special_escape[] = {
     ['\n'] = 'n',
     ['\r'] = 'r',
     ['\t'] = 't',
+    ['"'] = '"',
+    ['\\'] = '\\',
 };
 
 static void write_json_str(bstr *b, unsigned char *str)
 {
     APPEND(b, "\"");
+    unsigned char *cur = str;
     while (1) {
-        unsigned char *cur = str;
         while (cur[0] >= 32 && cur[0] != '"' && cur[0] != '\\')
             cur++;
+        bstr_xappend(NULL, b, (bstr){str, cur - str});
         if (!cur[0])
             break;
-        bstr_xappend(NULL, b, (bstr){str, cur - str});
-        if (cur[0] == '\"') {
-            bstr_xappend(NULL, b, (bstr){"\\\"", 2});
-        } else if (cur[0] == '\\') {
-            bstr_xappend(NULL, b, (bstr){"\\\\", 2});
-        } else if (cur[0] < sizeof(special_escape) && special_escape[cur[0]]) {
-            bstr_xappend_asprintf(NULL, b, "\\%c", special_escape[cur[0]]);
-        } else {
-            bstr_xappend_asprintf(NULL, b, "\\u%04x", (unsigned char)cur[0]);
-        }
-        str = cur + 1;
+        // Avoid bstr_xappend_asprintf(), which is slow for such small strings.
+        char buf[8] = {'\\', special_escape[cur[0]]};
+        int len = 2;
+        if (!buf[1])
+            len = snprintf(buf, sizeof(buf), "\\u%04x", cur[0]);
+        bstr_xappend(NULL, b, (bstr){buf, len});
+        str = ++cur;
     }
-    APPEND(b, str);
     APPEND(b, "\"");
 }
 
+// Faster than printf("%"PRId64).
+static void write_json_int(bstr *b, int64_t v)
+{
+    char buf[24];
+    char *cur = buf + sizeof(buf);
+    uint64_t u = v < 0 ? -(uint64_t)v : v;
+    do {
+        *--cur = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (v < 0)
+        *--cur = '-';
+    bstr_xappend(NULL, b, (bstr){cur, buf + sizeof(buf) - cur});
+}
+
 static void add_indent(bstr *b, int indent)
 {
     if (indent < 0)
@@ -297,11 +320,17 @@ static int json_append(bstr *b, const struct mpv_node *src, int indent)
         APPEND(b, src->u.flag ? "true" : "false");
         return 0;
     case MPV_FORMAT_INT64:
-        bstr_xappend_asprintf(NULL, b, "%"PRId64, src->u.int64);
+        write_json_int(b, src->u.int64);
         return 0;
     case MPV_FORMAT_DOUBLE: {
         const char *px = isfinite(src->u.double_) ? "" : "\"";
-        bstr_xappend_asprintf(NULL, b, "%s%f%s", px, src->u.double_, px);
+        char buf[64];
+        int len = snprintf(buf, sizeof(buf), "%s%f%s", px, src->u.double_, px);
+        if (len >= sizeof(buf)) { // huge values with %f
+            bstr_xappend_asprintf(NULL, b, "%s%f%s", px, src->u.double_, px);
+        } else {
+            bstr_xappend(NULL, b, (bstr){buf, len});
+        }
         return 0;
     }
     case MPV_FORMAT_STRING:
@@ -0,0 +1,326 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* MessagePack parser and writer for mpv_node.
+ *
+ * Mapping:
+ *  nil <-> MPV_FORMAT_NONE, bool <-> MPV_FORMAT_FLAG,
+ *  int <-> MPV_FORMAT_INT64 (uint64 values above INT64_MAX are rejected),
+ *  float <-> MPV_FORMAT_DOUBLE (float32 is accepted on input),
+ *  str <-> MPV_FORMAT_STRING (embedded 0 bytes are rejected),
+ *  bin <-> MPV_FORMAT_BYTE_ARRAY, array <-> MPV_FORMAT_NODE_ARRAY,
+ *  map <-> MPV_FORMAT_NODE_MAP (keys must be strings).
+ * Extension types are not supported.
+ *
+ * The writer always uses the smallest encoding.
+ *
+ * Also see: https://github.com/msgpack/msgpack/blob/master/spec.md
+ */
+
+#include <string.h>
+#include <assert.h>
+
+#include "common/common.h"
+#include "mpv_talloc.h"
+
+#include "msgpack.h"
+
+// bstr_cut() takes an int, which is not enough for str/bin 32.
+static void skip(bstr *src, size_t n)
+{
+    src->start += n;
+    src->len -= n;
+}
+
+static bool read_bytes(bstr *src, int n, const unsigned char **out)
+{
+    if (src->len < n)
+        return false;
+    *out = src->start;
+    skip(src, n);
+    return true;
+}
+
+static bool read_uint(bstr *src, int n, uint64_t *out)
+{
+    const unsigned char *p;
+    if (!read_bytes(src, n, &p))
+        return false;
+    *out = 0;
+    for (int i = 0; i < n; i++)
+        *out = (*out << 8) | p[i];
+    return true;
+}
+
+static int read_str(void *ta_parent, struct mpv_node *dst, bstr *src,
+                    uint64_t len)
+{
+    if (len > src->len || memchr(src->start, 0, len))
+        return -1;
+    dst->format = MPV_FORMAT_STRING;
+    dst->u.string = talloc_strndup(ta_parent, src->start, len);
+    skip(src, len);
+    return 0;
+}
+
+static int read_bin(void *ta_parent, struct mpv_node *dst, bstr *src,
+                    uint64_t len)
+{
+    if (len > src->len)
+        return -1;
+    struct mpv_byte_array *ba = talloc_zero(ta_parent, struct mpv_byte_array);
+    ba->data = talloc_memdup(ba, src->start, len);
+    ba->size = len;
+    dst->format = MPV_FORMAT_BYTE_ARRAY;
+    dst->u.ba = ba;
+    skip(src, len);
+    return 0;
+}
+
+static int read_sub(void *ta_parent, struct mpv_node *dst, bstr *src,
+                    uint64_t num, bool is_obj, int max_depth)
+{
+    // Each entry takes at least 1 byte (or 2 for map entries).
+    if (num > src->len)
+        return -1;
+    struct mpv_node_list *list = talloc_zero(ta_parent, struct mpv_node_list);
+    MP_TARRAY_GROW(list, list->values, num);
+    if (is_obj)
+        MP_TARRAY_GROW(list, list->keys, num);
+    for (uint64_t n = 0; n < num; n++) {
+        if (is_obj) {
+            struct mpv_node keynode;
+            if (msgpack_parse(list, &keynode, src, max_depth) < 0 ||
+                keynode.format != MPV_FORMAT_STRING)
+                return -1; // key is not a string
+            list->keys[list->num] = keynode.u.string;
+        }
+        if (msgpack_parse(list, &list->values[list->num], src, max_depth) < 0)
+            return -1;
+        list->num++;
+    }
+    dst->format = is_obj ? MPV_FORMAT_NODE_MAP : MPV_FORMAT_NODE_ARRAY;
+    dst->u.list = list;
+    return 0;
+}
+
+/* Parse the MessagePack value at the start of *src, and write the result into
+ * *dst. max_depth limits the recursion and tree depth.
+ * Returns:
+ *   0: success, *dst is valid, *src is advanced past the value
+ *  -1: failure (including truncated input), *dst is invalid, there may be dead
+ *      allocs under ta_parent
+ * Unlike json_parse(), the input is not mutated, and *dst does not point into
+ * it.
+ */
+int msgpack_parse(void *ta_parent, struct mpv_node *dst, bstr *src,
+                  int max_depth)
+{
+    max_depth -= 1;
+    if (max_depth < 0)
+        return -1;
+
+    uint64_t t, v;
+    if (!read_uint(src, 1, &t))
+        return -1; // early EOF
+
+    if (t <= 0x7f || t >= 0xe0) { // positive/negative fixint
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = (int8_t)t;
+        if (t <= 0x7f)
+            dst->u.int64 = t;
+        return 0;
+    }
+    if (t <= 0x8f) // fixmap
+        return read_sub(ta_parent, dst, src, t & 0xf, true, max_depth);
+    if (t <= 0x9f) // fixarray
+        return read_sub(ta_parent, dst, src, t & 0xf, false, max_depth);
+    if (t <= 0xbf) // fixstr
+        return read_str(ta_parent, dst, src, t & 0x1f);
+
+    switch (t) {
+    case 0xc0:
+        dst->format = MPV_FORMAT_NONE;
+        return 0;
+    case 0xc2:
+    case 0xc3:
+        dst->format = MPV_FORMAT_FLAG;
+        dst->u.flag = t == 0xc3;
+        return 0;
+    case 0xc4: case 0xc5: case 0xc6: // bin 8/16/32
+        if (!read_uint(src, 1 << (t - 0xc4), &v))
+            return -1;
+        return read_bin(ta_parent, dst, src, v);
+    case 0xca: { // float 32
+        if (!read_uint(src, 4, &v))
+            return -1;
+        uint32_t u = v;
+        float f;
+        memcpy(&f, &u, sizeof(f));
+        dst->format = MPV_FORMAT_DOUBLE;
+        dst->u.double_ = f;
+        return 0;
+    }
+    case 0xcb: // float 64
+        if (!read_uint(src, 8, &v))
+            return -1;
+        dst->format = MPV_FORMAT_DOUBLE;
+        memcpy(&dst->u.double_, &v, sizeof(double));
+        return 0;
+    case 0xcc: case 0xcd: case 0xce: case 0xcf: // uint 8/16/32/64
+        if (!read_uint(src, 1 << (t - 0xcc), &v) || v > INT64_MAX)
+            return -1;
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = v;
+        return 0;
+    case 0xd0: case 0xd1: case 0xd2: case 0xd3: { // int 8/16/32/64
+        int n = 1 << (t - 0xd0);
+        if (!read_uint(src, n, &v))
+            return -1;
+        // Sign-extend.
+        if (n < 8 && (v & (1ULL << (n * 8 - 1))))
+            v |= ~0ULL << (n * 8);
+        dst->format = MPV_FORMAT_INT64;
+        dst->u.int64 = (int64_t)v;
+        return 0;
+    }
+    case 0xd9: case 0xda: case 0xdb: // str 8/16/32
+        if (!read_uint(src, 1 << (t - 0xd9), &v))
+            return -1;
+        return read_str(ta_parent, dst, src, v);
+    case 0xdc: case 0xdd: // array 16/32
+        if (!read_uint(src, 2 << (t - 0xdc), &v))
+            return -1;
+        return read_sub(ta_parent, dst, src, v, false, max_depth);
+    case 0xde: case 0xdf: // map 16/32
+        if (!read_uint(src, 2 << (t - 0xde), &v))
+            return -1;
+        return read_sub(ta_parent, dst, src, v, true, max_depth);
+    }
+
+    return -1; // extension types and unused 0xc1
+}
+
+static void write_uint(void *ta_parent, bstr *dst, int type, int n, uint64_t v)
+{
+    unsigned char buf[9] = {type};
+    for (int i = 0; i < n; i++)
+        buf[1 + i] = v >> ((n - 1 - i) * 8);
+    bstr_xappend(ta_parent, dst, (bstr){buf, 1 + n});
+}
+
+// Write the header of a value with a size (str, bin, array, map). fix is the
+// type of the "fix" variant (or -1 if there is none), fix_max its maximum
+// size, and type8 the type of the 8 bit variant (or the 16 bit one, if there
+// is no 8 bit variant).
+static void write_size(void *ta_parent, bstr *dst, int fix, int fix_max,
+                       int type8, bool has_8bit, uint64_t size)
+{
+    if (fix >= 0 && size <= fix_max) {
+        write_uint(ta_parent, dst, fix | size, 0, 0);
+        return;
+    }
+    if (has_8bit) {
+        if (size <= UINT8_MAX) {
+            write_uint(ta_parent, dst, type8, 1, size);
+            return;
+        }
+        type8 += 1;
+    }
+    if (size <= UINT16_MAX) {
+        write_uint(ta_parent, dst, type8, 2, size);
+    } else {
+        write_uint(ta_parent, dst, type8 + 1, 4, size);
+    }
+}
+
+static int msgpack_append(void *ta_parent, bstr *dst,
+                          const struct mpv_node *src)
+{
+    switch (src->format) {
+    case MPV_FORMAT_NONE:
+        write_uint(ta_parent, dst, 0xc0, 0, 0);
+        return 0;
+    case MPV_FORMAT_FLAG:
+        write_uint(ta_parent, dst, src->u.flag ? 0xc3 : 0xc2, 0, 0);
+        return 0;
+    case MPV_FORMAT_INT64: {
+        int64_t v = src->u.int64;
+        if (v >= 0 && v <= 0x7f) {
+            write_uint(ta_parent, dst, v, 0, 0);
+        } else if (v < 0 && v >= -32) {
+            write_uint(ta_parent, dst, v & 0xff, 0, 0);
+        } else if (v >= INT8_MIN && v <= INT8_MAX) {
+            write_uint(ta_parent, dst, 0xd0, 1, v);
+        } else if (v >= INT16_MIN && v <= INT16_MAX) {
+            write_uint(ta_parent, dst, 0xd1, 2, v);
+        } else if (v >= INT32_MIN && v <= INT32_MAX) {
+            write_uint(ta_parent, dst, 0xd2, 4, v);
+        } else {
+            write_uint(ta_parent, dst, 0xd3, 8, v);
+        }
+        return 0;
+    }
+    case MPV_FORMAT_DOUBLE: {
+        uint64_t v;
+        memcpy(&v, &src->u.double_, sizeof(v));
+        write_uint(ta_parent, dst, 0xcb, 8, v);
+        return 0;
+    }
+    case MPV_FORMAT_STRING: {
+        size_t len = strlen(src->u.string);
+        write_size(ta_parent, dst, 0xa0, 31, 0xd9, true, len);
+        bstr_xappend(ta_parent, dst, (bstr){src->u.string, len});
+        return 0;
+    }
+    case MPV_FORMAT_BYTE_ARRAY: {
+        struct mpv_byte_array *ba = src->u.ba;
+        write_size(ta_parent, dst, -1, 0, 0xc4, true, ba->size);
+        bstr_xappend(ta_parent, dst, (bstr){ba->data, ba->size});
+        return 0;
+    }
+    case MPV_FORMAT_NODE_ARRAY:
+    case MPV_FORMAT_NODE_MAP: {
+        struct mpv_node_list *list = src->u.list;
+        bool is_obj = src->format == MPV_FORMAT_NODE_MAP;
+        write_size(ta_parent, dst, is_obj ? 0x80 : 0x90, 15,
+                   is_obj ? 0xde : 0xdc, false, list->num);
+        for (int n = 0; n < list->num; n++) {
+            if (is_obj) {
+                struct mpv_node key = {
+                    .format = MPV_FORMAT_STRING,
+                    .u.string = list->keys[n],
+                };
+                msgpack_append(ta_parent, dst, &key);
+            }
+            if (msgpack_append(ta_parent, dst, &list->values[n]) < 0)
+                return -1;
+        }
+        return 0;
+    }
+    }
+    return -1; // unknown format
+}
+
+/* Write the contents of *src as MessagePack, and append it to *dst, which is
+ * extended with bstr_xappend() (using ta_parent).
+ * Returns: 0 on success, <0 on failure.
+ */
+int msgpack_write(void *ta_parent, bstr *dst, struct mpv_node *src)
+{
+    return msgpack_append(ta_parent, dst, src);
+}
@@ -15,7 +15,12 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "misc/ctype.h"
+#include "mpv_talloc.h"
 
 #include "natural_sort.h"
 
@@ -51,9 +56,10 @@ int mp_natural_sort_cmp(const char *name1, const char *name2)
                 name2++;
             }
         } else {
-            if (mp_tolower(name1[0]) < mp_tolower(name2[0]))
+            unsigned char c1 = mp_tolower(name1[0]), c2 = mp_tolower(name2[0]);
+            if (c1 < c2)
                 return -1;
-            if (mp_tolower(name1[0]) > mp_tolower(name2[0]))
+            if (c1 > c2)
                 return 1;
             name1++;
             name2++;
@@ -65,3 +71,61 @@ int mp_natural_sort_cmp(const char *name1, const char *name2)
         return 1;
     return 0;
 }
+
+// The key is the lower-cased string, with each run of digits replaced by
+// '0', the number of digits without padding (4 bytes, big endian), and the
+// digits without padding. The leading '0' makes a number compare to other
+// characters the same way as in mp_natural_sort_cmp().
+struct bstr mp_natural_sort_key(void *ta_parent, const char *name)
+{
+    struct bstr key = {talloc_size(ta_parent, strlen(name) * 5 + 1), 0};
+    while (name[0]) {
+        if (mp_isdigit(name[0])) {
+            while (name[0] == '0')
+                name++;
+            const char *end = name;
+            while (mp_isdigit(*end))
+                end++;
+            uint32_t len = end - name;
+            key.start[key.len++] = '0';
+            for (int n = 3; n >= 0; n--)
+                key.start[key.len++] = len >> (n * 8);
+            memcpy(key.start + key.len, name, len);
+            key.len += len;
+            name = end;
+        } else {
+            key.start[key.len++] = mp_tolower(name[0]);
+            name++;
+        }
+    }
+    return key;
+}
+
+struct sort_entry {
+    struct bstr key;
+    char *str;
+};
+
+static int cmp_sort_entry(const void *a, const void *b)
+{
+    const struct sort_entry *e1 = a, *e2 = b;
+    return mp_natural_sort_key_cmp(e1->key, e2->key);
+}
+
+void mp_natural_sort_strings(char **list, int num)
+{
+    if (num < 2)
+        return;
+    void *tmp = talloc_new(NULL);
+    struct sort_entry *entries = talloc_array(tmp, struct sort_entry, num);
+    for (int n = 0; n < num; n++) {
+        entries[n] = (struct sort_entry){
+            .key = mp_natural_sort_key(tmp, list[n]),
+            .str = list[n],
+        };
+    }
+    qsort(entries, num, sizeof(entries[0]), cmp_sort_entry);
+    for (int n = 0; n < num; n++)
+        list[n] = entries[n].str;
+    talloc_free(tmp);
+}
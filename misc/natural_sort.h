@@ -18,6 +18,26 @@
 #ifndef MP_NATURAL_SORT_H
 #define MP_NATURAL_SORT_H
 
+#include "misc/bstr.h"
+
 int mp_natural_sort_cmp(const char *name1, const char *name2);
 
+// Return a sort key for name. Comparing two keys with
+// mp_natural_sort_key_cmp() gives the same result as mp_natural_sort_cmp() on
+// the original strings, but is much cheaper if strings are compared often.
+struct bstr mp_natural_sort_key(void *ta_parent, const char *name);
+
+static inline int mp_natural_sort_key_cmp(struct bstr key1, struct bstr key2)
+{
+    size_t len = key1.len < key2.len ? key1.len : key2.len;
+    int r = memcmp(key1.start, key2.start, len);
+    if (r)
+        return r;
+    return key1.len < key2.len ? -1 : key1.len > key2.len;
+}
+
+// Sort the list of strings with mp_natural_sort_cmp() order. The sort keys are
+// computed once per string.
+void mp_natural_sort_strings(char **list, int num);
+
 #endif
@@ -16,6 +16,8 @@
 #include <pthread.h>
 
 #include "common/common.h"
+#include "common/stats.h"
+#include "osdep/atomic.h"
 #include "osdep/threads.h"
 #include "osdep/timer.h"
 
@@ -28,6 +30,13 @@
 struct work {
     void (*fn)(void *ctx);
     void *fn_ctx;
+    int64_t queued_us;  // only set if stats are enabled
+};
+
+// FIFO; items[first..num-1] are pending.
+struct work_queue {
+    struct work *items;
+    int num, first;
 };
 
 struct mp_thread_pool {
@@ -46,10 +55,64 @@ struct mp_thread_pool {
 
     bool terminate;
 
-    struct work *work;
-    int num_work;
+    struct work_queue queues[MP_THREAD_POOL_PRIO_COUNT];
+    int num_work;       // sum over all queues
+
+    struct stats_ctx *stats;
 };
 
+static void push_work(struct mp_thread_pool *pool, enum mp_thread_pool_prio prio,
+                      struct work work)
+{
+    struct work_queue *q = &pool->queues[prio];
+    // Reclaim the consumed space if it dominates.
+    if (q->first > 16 && q->first * 2 > q->num) {
+        memmove(q->items, q->items + q->first,
+                (q->num - q->first) * sizeof(q->items[0]));
+        q->num -= q->first;
+        q->first = 0;
+    }
+    MP_TARRAY_APPEND(pool, q->items, q->num, work);
+    pool->num_work += 1;
+}
+
+// Take the oldest work item of the highest priority.
+static struct work pop_work(struct mp_thread_pool *pool)
+{
+    for (int prio = 0; prio < MP_THREAD_POOL_PRIO_COUNT; prio++) {
+        struct work_queue *q = &pool->queues[prio];
+        if (q->first < q->num) {
+            struct work work = q->items[q->first++];
+            if (q->first == q->num)
+                q->first = q->num = 0;
+            pool->num_work -= 1;
+            return work;
+        }
+    }
+    return (struct work){0};
+}
+
+// Remove queued (not yet started) items matching fn/fn_ctx. Returns the number
+// of removed items.
+static int remove_work(struct mp_thread_pool *pool, void (*fn)(void *ctx),
+                       void *fn_ctx)
+{
+    int removed = 0;
+    for (int prio = 0; prio < MP_THREAD_POOL_PRIO_COUNT; prio++) {
+        struct work_queue *q = &pool->queues[prio];
+        for (int n = q->num - 1; n >= q->first; n--) {
+            if (q->items[n].fn == fn && q->items[n].fn_ctx == fn_ctx) {
+                MP_TARRAY_REMOVE_AT(q->items, q->num, n);
+                removed += 1;
+            }
+        }
+        if (q->first == q->num)
+            q->first = q->num = 0;
+    }
+    pool->num_work -= removed;
+    return removed;
+}
+
 static void *worker_thread(void *arg)
 {
     struct mp_thread_pool *pool = arg;
@@ -61,11 +124,7 @@ static void *worker_thread(void *arg)
     struct timespec ts = {0};
     bool got_timeout = false;
     while (1) {
-        struct work work = {0};
-        if (pool->num_work > 0) {
-            work = pool->work[pool->num_work - 1];
-            pool->num_work -= 1;
-        }
+        struct work work = pop_work(pool);
 
         if (!work.fn) {
             if (got_timeout || pool->terminate)
@@ -85,6 +144,11 @@ static void *worker_thread(void *arg)
         pool->busy_threads += 1;
         pthread_mutex_unlock(&pool->lock);
 
+        if (pool->stats && work.queued_us) {
+            stats_value(pool->stats, "queue-latency",
+                        (mp_time_us() - work.queued_us) / 1e6);
+        }
+
         work.fn(work.fn_ctx);
 
         pthread_mutex_lock(&pool->lock);
@@ -178,15 +242,30 @@ struct mp_thread_pool *mp_thread_pool_create(void *ta_parent, int init_threads,
     return pool;
 }
 
-static bool thread_pool_add(struct mp_thread_pool *pool, void (*fn)(void *ctx),
-                            void *fn_ctx, bool allow_queue)
+void mp_thread_pool_enable_stats(struct mp_thread_pool *pool,
+                                 struct mpv_global *global, const char *name)
+{
+    // Owned by the pool, so it outlives the worker threads.
+    struct stats_ctx *stats = stats_ctx_create(pool, global, name);
+
+    pthread_mutex_lock(&pool->lock);
+    assert(!pool->stats);
+    pool->stats = stats;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static bool thread_pool_add(struct mp_thread_pool *pool,
+                            enum mp_thread_pool_prio prio,
+                            void (*fn)(void *ctx), void *fn_ctx,
+                            bool allow_queue)
 {
     bool ok = true;
 
     assert(fn);
+    assert(prio >= 0 && prio < MP_THREAD_POOL_PRIO_COUNT);
 
     pthread_mutex_lock(&pool->lock);
-    struct work work = {fn, fn_ctx};
+    struct work work = {fn, fn_ctx, pool->stats ? mp_time_us() : 0};
 
     // If there are not enough threads to process all at once, but we can
     // create a new thread, then do so. If work is queued quickly, it can
@@ -202,22 +281,116 @@ static bool thread_pool_add(struct mp_thread_pool *pool, void (*fn)(void *ctx),
     }
 
     if (ok) {
-        MP_TARRAY_INSERT_AT(pool, pool->work, pool->num_work, 0, work);
+        push_work(pool, prio, work);
         pthread_cond_signal(&pool->wakeup);
     }
 
+    int num_work = pool->num_work;
+    struct stats_ctx *stats = pool->stats;
+
     pthread_mutex_unlock(&pool->lock);
+
+    if (stats)
+        stats_value(stats, "queue-depth", num_work);
+
     return ok;
 }
 
 bool mp_thread_pool_queue(struct mp_thread_pool *pool, void (*fn)(void *ctx),
                           void *fn_ctx)
 {
-    return thread_pool_add(pool, fn, fn_ctx, true);
+    return thread_pool_add(pool, MP_THREAD_POOL_PRIO_NORMAL, fn, fn_ctx, true);
+}
+
+bool mp_thread_pool_queue_prio(struct mp_thread_pool *pool,
+                               enum mp_thread_pool_prio prio,
+                               void (*fn)(void *ctx), void *fn_ctx)
+{
+    return thread_pool_add(pool, prio, fn, fn_ctx, true);
 }
 
 bool mp_thread_pool_run(struct mp_thread_pool *pool, void (*fn)(void *ctx),
                         void *fn_ctx)
 {
-    return thread_pool_add(pool, fn, fn_ctx, false);
+    return thread_pool_add(pool, MP_THREAD_POOL_PRIO_NORMAL, fn, fn_ctx, false);
+}
+
+struct parallel_for {
+    void (*fn)(void *ctx, int index);
+    void *fn_ctx;
+    int count;
+    atomic_int next;        // next index to be claimed
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    int active;             // helpers queued or running (protected by lock)
+};
+
+static void parallel_for_run(struct parallel_for *pf)
+{
+    while (1) {
+        int index = atomic_fetch_add(&pf->next, 1);
+        if (index >= pf->count)
+            break;
+        pf->fn(pf->fn_ctx, index);
+    }
+}
+
+static void parallel_for_helper(void *ctx)
+{
+    struct parallel_for *pf = ctx;
+
+    parallel_for_run(pf);
+
+    pthread_mutex_lock(&pf->lock);
+    pf->active -= 1;
+    pthread_cond_broadcast(&pf->wakeup);
+    pthread_mutex_unlock(&pf->lock);
+}
+
+void mp_thread_pool_parallel_for(struct mp_thread_pool *pool, int count,
+                                 void (*fn)(void *ctx, int index), void *fn_ctx)
+{
+    struct parallel_for pf = {
+        .fn = fn,
+        .fn_ctx = fn_ctx,
+        .count = count,
+        .next = ATOMIC_VAR_INIT(0),
+    };
+    pthread_mutex_init(&pf.lock, NULL);
+    pthread_cond_init(&pf.wakeup, NULL);
+
+    // Each helper claims indexes until none are left, so the load is balanced
+    // even if some items take longer, or some helpers start late.
+    int helpers = MPMIN(count - 1, pool->max_threads);
+    for (int n = 0; n < helpers; n++) {
+        pthread_mutex_lock(&pf.lock);
+        pf.active += 1;
+        pthread_mutex_unlock(&pf.lock);
+        if (!thread_pool_add(pool, MP_THREAD_POOL_PRIO_HIGH,
+                             parallel_for_helper, &pf, true))
+        {
+            pthread_mutex_lock(&pf.lock);
+            pf.active -= 1;
+            pthread_mutex_unlock(&pf.lock);
+            break;
+        }
+    }
+
+    parallel_for_run(&pf);
+
+    // Helpers which did not start yet would only find no work left; don't
+    // wait for a thread to become free for them.
+    pthread_mutex_lock(&pool->lock);
+    int removed = remove_work(pool, parallel_for_helper, &pf);
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_mutex_lock(&pf.lock);
+    pf.active -= removed;
+    while (pf.active > 0)
+        pthread_cond_wait(&pf.wakeup, &pf.lock);
+    pthread_mutex_unlock(&pf.lock);
+
+    pthread_cond_destroy(&pf.wakeup);
+    pthread_mutex_destroy(&pf.lock);
 }
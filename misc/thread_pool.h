@@ -2,6 +2,16 @@
 #define MPV_MP_THREAD_POOL_H
 
 struct mp_thread_pool;
+struct mpv_global;
+
+// Work with a higher priority is always started before queued work with a
+// lower priority. Work of the same priority is started in FIFO order.
+enum mp_thread_pool_prio {
+    MP_THREAD_POOL_PRIO_HIGH,       // something is blocked waiting for it
+    MP_THREAD_POOL_PRIO_NORMAL,     // default
+    MP_THREAD_POOL_PRIO_LOW,        // background work (preloading, caches)
+    MP_THREAD_POOL_PRIO_COUNT,
+};
 
 // Create a thread pool with the given number of worker threads. This can return
 // NULL if the worker threads could not be created. The thread pool can be
@@ -26,9 +36,27 @@ struct mp_thread_pool *mp_thread_pool_create(void *ta_parent, int init_threads,
 bool mp_thread_pool_queue(struct mp_thread_pool *pool, void (*fn)(void *ctx),
                           void *fn_ctx);
 
+// Like mp_thread_pool_queue(), but with the given priority (the former uses
+// MP_THREAD_POOL_PRIO_NORMAL).
+bool mp_thread_pool_queue_prio(struct mp_thread_pool *pool,
+                               enum mp_thread_pool_prio prio,
+                               void (*fn)(void *ctx), void *fn_ctx);
+
 // Like mp_thread_pool_queue(), but only queue the item and succeed if a thread
 // can be reserved for the item (i.e. minimal wait time instead of unbounded).
 bool mp_thread_pool_run(struct mp_thread_pool *pool, void (*fn)(void *ctx),
                         void *fn_ctx);
 
+// Call fn(fn_ctx, index) for each index in [0, count), distributed over the
+// calling thread and the pool's threads, and return once all calls are done.
+// The calling thread always participates, so this works even if no pool
+// threads are available.
+void mp_thread_pool_parallel_for(struct mp_thread_pool *pool, int count,
+                                 void (*fn)(void *ctx, int index), void *fn_ctx);
+
+// Report the queue depth and the queue latency (time between queuing an item
+// and a thread starting it) as stats values under the given name.
+void mp_thread_pool_enable_stats(struct mp_thread_pool *pool,
+                                 struct mpv_global *global, const char *name);
+
 #endif
@@ -38,6 +38,10 @@ struct m_config_shadow {
     pthread_mutex_t lock;
     // Incremented on every option change.
     mp_atomic_uint64 ts;
+    // Per group (same indexes as groups[]): ts of the last change to an option
+    // in the group or any of its sub groups. Lets caches check for changes
+    // relevant to them without taking the lock.
+    mp_atomic_uint64 *group_ts;
     // -- immutable after init
     // List of m_sub_options instances.
     // Index 0 is the top-level and is always present.
@@ -103,6 +107,8 @@ struct config_cache {
 struct m_group_data {
     char *udata;        // pointer to group user option struct
     uint64_t ts;        // timestamp of the data copy
+    uint64_t *opt_ts;   // shadow data only: per option ts of the last change
+                        // (NULL if no option was changed yet)
 };
 
 static const union m_option_value default_value = {0};
@@ -430,6 +436,9 @@ struct m_config_shadow *m_config_shadow_new(const struct m_sub_options *root)
 
     add_sub_group(shadow, NULL, -1, -1, root);
 
+    shadow->group_ts =
+        talloc_zero_array(shadow, mp_atomic_uint64, shadow->num_groups);
+
     if (!root->size)
         return shadow;
 
@@ -612,7 +621,11 @@ static void update_next_option(struct m_config_cache *cache, void **p_opt)
             while (opts && opts[in->upd_opt].name) {
                 const struct m_option *opt = &opts[in->upd_opt];
 
-                if (opt->offset >= 0 && opt->type->size) {
+                // Skip options not written since our copy was made.
+                bool maybe_changed =
+                    gsrc->opt_ts && gsrc->opt_ts[in->upd_opt] > gdst->ts;
+
+                if (maybe_changed && opt->offset >= 0 && opt->type->size) {
                     void *dsrc = gsrc->udata + opt->offset;
                     void *ddst = gdst->udata + opt->offset;
 
@@ -657,9 +670,9 @@ static bool cache_check_update(struct m_config_cache *cache)
     struct config_cache *in = cache->internal;
     struct m_config_shadow *shadow = in->shadow;
 
-    // Using atomics and checking outside of the lock - it's unknown whether
-    // this makes it faster or slower. Just cargo culting it.
-    uint64_t new_ts = atomic_load(&shadow->ts);
+    // Checked outside of the lock, so that changes to options this cache
+    // doesn't include never make it contend for the lock.
+    uint64_t new_ts = atomic_load(&shadow->group_ts[in->group_start]);
     if (in->ts >= new_ts)
         return false;
 
@@ -756,7 +769,16 @@ bool m_config_cache_write_opt(struct m_config_cache *cache, void *ptr)
     if (changed) {
         m_option_copy(opt, gsrc->udata + opt->offset, ptr);
 
-        gsrc->ts = atomic_fetch_add(&shadow->ts, 1) + 1;
+        uint64_t ts = atomic_fetch_add(&shadow->ts, 1) + 1;
+        gsrc->ts = ts;
+
+        if (!gsrc->opt_ts)
+            gsrc->opt_ts = talloc_zero_array(in->src, uint64_t, g->opt_count);
+        gsrc->opt_ts[opt_idx] = ts;
+
+        // Publish after the data was written (readers take the lock to copy).
+        for (int n = group_idx; n >= 0; n = shadow->groups[n].parent_group)
+            atomic_store(&shadow->group_ts[n], ts);
 
         for (int n = 0; n < shadow->num_listeners; n++) {
             struct config_cache *listener = shadow->listeners[n];
@@ -102,6 +102,9 @@ typedef struct m_config {
 
     // Private. Thread-safe shadow memory; only set for the main m_config.
     struct m_config_shadow *shadow;
+
+    // Private. Parsed config files (see parse_configfile.c).
+    struct m_config_file_cache *file_cache;
 } m_config_t;
 
 // Create a new config object.
@@ -37,7 +37,7 @@
 #include "common/common.h"
 
 static int m_property_multiply(struct mp_log *log,
-                               const struct m_property *prop_list,
+                               const struct m_property_list *prop_list,
                                const char *property, double f, void *ctx)
 {
     union m_option_value val = {0};
@@ -62,17 +62,28 @@ static int m_property_multiply(struct mp_log *log,
     return r;
 }
 
-struct m_property *m_property_list_find(const struct m_property *list,
+static int compare_prop(const void *a, const void *b)
+{
+    return strcmp(((const struct m_property *)a)->name,
+                  ((const struct m_property *)b)->name);
+}
+
+void m_property_list_sort(struct m_property_list *list)
+{
+    qsort(list->props, list->num, sizeof(list->props[0]), compare_prop);
+}
+
+struct m_property *m_property_list_find(const struct m_property_list *list,
                                         const char *name)
 {
-    for (int n = 0; list && list[n].name; n++) {
-        if (strcmp(list[n].name, name) == 0)
-            return (struct m_property *)&list[n];
-    }
-    return NULL;
+    if (!list || !list->num)
+        return NULL;
+    struct m_property key = {.name = name};
+    return bsearch(&key, list->props, list->num, sizeof(list->props[0]),
+                   compare_prop);
 }
 
-static int do_action(const struct m_property *prop_list, const char *name,
+static int do_action(const struct m_property_list *prop_list, const char *name,
                      int action, void *arg, void *ctx)
 {
     struct m_property *prop;
@@ -97,7 +108,7 @@ static int do_action(const struct m_property *prop_list, const char *name,
 }
 
 // (as a hack, log can be NULL on read-only paths)
-int m_property_do(struct mp_log *log, const struct m_property *prop_list,
+int m_property_do(struct mp_log *log, const struct m_property_list *prop_list,
                   const char *name, int action, void *arg, void *ctx)
 {
     union m_option_value val = {0};
@@ -236,7 +247,7 @@ static void m_property_unkey(int *action, void **arg)
     }
 }
 
-static int m_property_do_bstr(const struct m_property *prop_list, bstr name,
+static int m_property_do_bstr(const struct m_property_list *prop_list, bstr name,
                               int action, void *arg, void *ctx)
 {
     char name0[64];
@@ -254,50 +265,68 @@ static void append_str(char **s, int *len, bstr append)
     *len = *len + append.len;
 }
 
-static int expand_property(const struct m_property *prop_list, char **ret,
-                           int *ret_len, bstr prop, bool silent_error, void *ctx)
+enum template_op_type {
+    TEMPLATE_TEXT,      // literal text
+    TEMPLATE_PROP,      // "${...", starts a nesting level
+    TEMPLATE_END,       // "}" closing a TEMPLATE_PROP
+};
+
+struct template_op {
+    enum template_op_type type;
+    bstr text;          // TEMPLATE_TEXT
+    // TEMPLATE_PROP
+    bstr name;
+    bstr comp_with;
+    bool cond_yes, cond_no, raw, comp, have_fallback;
+};
+
+struct m_property_template {
+    struct template_op *ops;
+    int num_ops;
+};
+
+static void add_text(struct m_property_template *t, bstr text)
 {
-    bool cond_yes = bstr_eatstart0(&prop, "?");
-    bool cond_no = !cond_yes && bstr_eatstart0(&prop, "!");
-    bool test = cond_yes || cond_no;
-    bool raw = bstr_eatstart0(&prop, "=");
-    bstr comp_with = {0};
-    bool comp = test && bstr_split_tok(prop, "==", &prop, &comp_with);
-    if (test && !comp)
-        raw = true;
-    int method = raw ? M_PROPERTY_GET_STRING : M_PROPERTY_PRINT;
-
-    char *s = NULL;
-    int r = m_property_do_bstr(prop_list, prop, method, &s, ctx);
-    bool skip;
-    if (comp) {
-        skip = ((s && bstr_equals0(comp_with, s)) != cond_yes);
-    } else if (test) {
-        skip = (!!s != cond_yes);
+    if (!text.len)
+        return;
+    if (t->num_ops && t->ops[t->num_ops - 1].type == TEMPLATE_TEXT) {
+        bstr_xappend(t, &t->ops[t->num_ops - 1].text, text);
     } else {
-        skip = !!s;
-        char *append = s;
-        if (!s && !silent_error && !raw)
-            append = (r == M_PROPERTY_UNAVAILABLE) ? "(unavailable)" : "(error)";
-        append_str(ret, ret_len, bstr0(append));
+        struct template_op op = {.type = TEMPLATE_TEXT};
+        bstr_xappend(t, &op.text, text);
+        MP_TARRAY_APPEND(t, t->ops, t->num_ops, op);
     }
-    talloc_free(s);
-    return skip;
 }
 
-char *m_properties_expand_string(const struct m_property *prop_list,
-                                 const char *str0, void *ctx)
+static void add_prop(struct m_property_template *t, bstr prop,
+                     bool have_fallback)
 {
-    char *ret = NULL;
-    int ret_len = 0;
-    bool skip = false;
-    int level = 0, skip_level = 0;
+    struct template_op op = {.type = TEMPLATE_PROP,
+                             .have_fallback = have_fallback};
+    op.cond_yes = bstr_eatstart0(&prop, "?");
+    op.cond_no = !op.cond_yes && bstr_eatstart0(&prop, "!");
+    bool test = op.cond_yes || op.cond_no;
+    op.raw = bstr_eatstart0(&prop, "=");
+    op.comp = test && bstr_split_tok(prop, "==", &prop, &op.comp_with);
+    if (test && !op.comp)
+        op.raw = true;
+    op.name = bstrdup(t, prop);
+    op.comp_with = bstrdup(t, op.comp_with);
+    MP_TARRAY_APPEND(t, t->ops, t->num_ops, op);
+}
+
+struct m_property_template *m_property_template_compile(void *ta_parent,
+                                                        const char *str0)
+{
+    struct m_property_template *t =
+        talloc_zero(ta_parent, struct m_property_template);
+    int level = 0;
     bstr str = bstr0(str0);
 
     while (str.len) {
         if (level > 0 && bstr_eatstart0(&str, "}")) {
-            if (skip && level <= skip_level)
-                skip = false;
+            MP_TARRAY_APPEND(t, t->ops, t->num_ops,
+                             (struct template_op){.type = TEMPLATE_END});
             level--;
         } else if (bstr_startswith0(str, "${") && bstr_find0(str, "}") >= 0) {
             str = bstr_cut(str, 2);
@@ -310,14 +339,9 @@ char *m_properties_expand_string(const struct m_property *prop_list,
             str = bstr_cut(str, term_pos);
             bool have_fallback = bstr_eatstart0(&str, ":");
 
-            if (!skip) {
-                skip = expand_property(prop_list, &ret, &ret_len, name,
-                                       have_fallback, ctx);
-                if (skip)
-                    skip_level = level;
-            }
+            add_prop(t, name, have_fallback);
         } else if (level == 0 && bstr_eatstart0(&str, "$>")) {
-            append_str(&ret, &ret_len, str);
+            add_text(t, str);
             break;
         } else {
             char c;
@@ -332,8 +356,66 @@ char *m_properties_expand_string(const struct m_property *prop_list,
                 str = bstr_cut(str, 1);
             }
 
+            add_text(t, (bstr){(unsigned char *)&c, 1});
+        }
+    }
+
+    return t;
+}
+
+static int expand_property(const struct m_property_list *prop_list, char **ret,
+                           int *ret_len, struct template_op *op, void *ctx)
+{
+    bool test = op->cond_yes || op->cond_no;
+    int method = op->raw ? M_PROPERTY_GET_STRING : M_PROPERTY_PRINT;
+
+    char *s = NULL;
+    int r = m_property_do_bstr(prop_list, op->name, method, &s, ctx);
+    bool skip;
+    if (op->comp) {
+        skip = ((s && bstr_equals0(op->comp_with, s)) != op->cond_yes);
+    } else if (test) {
+        skip = (!!s != op->cond_yes);
+    } else {
+        skip = !!s;
+        char *append = s;
+        if (!s && !op->have_fallback && !op->raw)
+            append = (r == M_PROPERTY_UNAVAILABLE) ? "(unavailable)" : "(error)";
+        append_str(ret, ret_len, bstr0(append));
+    }
+    talloc_free(s);
+    return skip;
+}
+
+char *m_property_template_expand(struct m_property_template *t,
+                                 const struct m_property_list *prop_list,
+                                 void *ctx)
+{
+    char *ret = NULL;
+    int ret_len = 0;
+    bool skip = false;
+    int level = 0, skip_level = 0;
+
+    for (int n = 0; n < t->num_ops; n++) {
+        struct template_op *op = &t->ops[n];
+        switch (op->type) {
+        case TEMPLATE_TEXT:
             if (!skip)
-                MP_TARRAY_APPEND(NULL, ret, ret_len, c);
+                append_str(&ret, &ret_len, op->text);
+            break;
+        case TEMPLATE_PROP:
+            level++;
+            if (!skip) {
+                skip = expand_property(prop_list, &ret, &ret_len, op, ctx);
+                if (skip)
+                    skip_level = level;
+            }
+            break;
+        case TEMPLATE_END:
+            if (skip && level <= skip_level)
+                skip = false;
+            level--;
+            break;
         }
     }
 
@@ -341,18 +423,22 @@ char *m_properties_expand_string(const struct m_property *prop_list,
     return ret;
 }
 
-void m_properties_print_help_list(struct mp_log *log,
-                                  const struct m_property *list)
+char *m_properties_expand_string(const struct m_property_list *prop_list,
+                                 const char *str, void *ctx)
 {
-    int count = 0;
+    struct m_property_template *t = m_property_template_compile(NULL, str);
+    char *ret = m_property_template_expand(t, prop_list, ctx);
+    talloc_free(t);
+    return ret;
+}
 
+void m_properties_print_help_list(struct mp_log *log,
+                                  const struct m_property_list *list)
+{
     mp_info(log, "Name\n\n");
-    for (int i = 0; list[i].name; i++) {
-        const struct m_property *p = &list[i];
-        mp_info(log, " %s\n", p->name);
-        count++;
-    }
-    mp_info(log, "\nTotal: %d properties\n", count);
+    for (int i = 0; i < list->num; i++)
+        mp_info(log, " %s\n", list->props[i].name);
+    mp_info(log, "\nTotal: %d properties\n", list->num);
 }
 
 int m_property_flag_ro(int action, void* arg, int var)
@@ -524,6 +610,61 @@ int m_property_read_sub(const struct m_sub_property *props, int action, void *ar
 // count: number of items.
 // get_item: callback to access a single item.
 // ctx: userdata passed to get_item.
+// Return the items [start, start + count) as node array.
+static struct mpv_node read_list_range(int start, int count,
+                                       m_get_item_cb get_item, void *ctx)
+{
+    struct mpv_node node;
+    node.format = MPV_FORMAT_NODE_ARRAY;
+    node.u.list = talloc_zero(NULL, mpv_node_list);
+    node.u.list->num = count;
+    node.u.list->values = talloc_array(node.u.list, mpv_node, count);
+    for (int n = 0; n < count; n++) {
+        struct mpv_node *sub = &node.u.list->values[n];
+        sub->format = MPV_FORMAT_NONE;
+        int item = start + n;
+        int r;
+        r = get_item(item, M_PROPERTY_GET_NODE, sub, ctx);
+        if (r == M_PROPERTY_NOT_IMPLEMENTED) {
+            struct m_option opt = {0};
+            r = get_item(item, M_PROPERTY_GET_TYPE, &opt, ctx);
+            if (r != M_PROPERTY_OK)
+                goto err;
+            union m_option_value val = {0};
+            r = get_item(item, M_PROPERTY_GET, &val, ctx);
+            if (r != M_PROPERTY_OK)
+                goto err;
+            m_option_get_node(&opt, node.u.list, sub, &val);
+            m_option_free(&opt, &val);
+        err: ;
+        }
+    }
+    return node;
+}
+
+// Handle "range/START/COUNT" keys. The range is clipped to the list.
+static int read_list_range_key(struct m_property_action_arg *ka, int count,
+                               m_get_item_cb get_item, void *ctx)
+{
+    int start, num;
+    char dummy;
+    if (sscanf(ka->key, "range/%d/%d%c", &start, &num, &dummy) != 2 ||
+        start < 0 || num < 0)
+        return M_PROPERTY_UNKNOWN;
+    start = MPMIN(start, MPMAX(count, 0));
+    num = MPMIN(num, MPMAX(count, 0) - start);
+
+    switch (ka->action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)ka->arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET:
+        *(struct mpv_node *)ka->arg = read_list_range(start, num, get_item, ctx);
+        return M_PROPERTY_OK;
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
 int m_property_read_list(int action, void *arg, int count,
                          m_get_item_cb get_item, void *ctx)
 {
@@ -532,34 +673,9 @@ int m_property_read_list(int action, void *arg, int count,
     case M_PROPERTY_GET_TYPE:
         *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
         return M_PROPERTY_OK;
-    case M_PROPERTY_GET: {
-        struct mpv_node node;
-        node.format = MPV_FORMAT_NODE_ARRAY;
-        node.u.list = talloc_zero(NULL, mpv_node_list);
-        node.u.list->num = count;
-        node.u.list->values = talloc_array(node.u.list, mpv_node, count);
-        for (int n = 0; n < count; n++) {
-            struct mpv_node *sub = &node.u.list->values[n];
-            sub->format = MPV_FORMAT_NONE;
-            int r;
-            r = get_item(n, M_PROPERTY_GET_NODE, sub, ctx);
-            if (r == M_PROPERTY_NOT_IMPLEMENTED) {
-                struct m_option opt = {0};
-                r = get_item(n, M_PROPERTY_GET_TYPE, &opt, ctx);
-                if (r != M_PROPERTY_OK)
-                    goto err;
-                union m_option_value val = {0};
-                r = get_item(n, M_PROPERTY_GET, &val, ctx);
-                if (r != M_PROPERTY_OK)
-                    goto err;
-                m_option_get_node(&opt, node.u.list, sub, &val);
-                m_option_free(&opt, &val);
-            err: ;
-            }
-        }
-        *(struct mpv_node *)arg = node;
+    case M_PROPERTY_GET:
+        *(struct mpv_node *)arg = read_list_range(0, count, get_item, ctx);
         return M_PROPERTY_OK;
-    }
     case M_PROPERTY_PRINT: {
         // See m_property_read_sub() remarks.
         char *res = NULL;
@@ -591,6 +707,8 @@ int m_property_read_list(int action, void *arg, int count,
             }
             return M_PROPERTY_NOT_IMPLEMENTED;
         }
+        if (strncmp(ka->key, "range/", 6) == 0)
+            return read_list_range_key(ka, count, get_item, ctx);
         // This is expected of the form "123" or "123/rest"
         char *next = strchr(ka->key, '/');
         char *end = NULL;
@@ -135,14 +135,24 @@ struct m_property {
     bool is_option;
 };
 
-struct m_property *m_property_list_find(const struct m_property *list,
+// List of properties. Must be sorted with m_property_list_sort() before it is
+// used with any of the functions below, which look up properties by name with
+// a binary search.
+struct m_property_list {
+    struct m_property *props;
+    int num;
+};
+
+void m_property_list_sort(struct m_property_list *list);
+
+struct m_property *m_property_list_find(const struct m_property_list *list,
                                         const char *name);
 
 // Access a property.
 // action: one of m_property_action
 // ctx: opaque value passed through to property implementation
 // returns: one of mp_property_return
-int m_property_do(struct mp_log *log, const struct m_property* prop_list,
+int m_property_do(struct mp_log *log, const struct m_property_list *prop_list,
                   const char* property_name, int action, void* arg, void *ctx);
 
 // Given a path of the form "a/b/c", this function will set *prefix to "a",
@@ -153,7 +163,7 @@ bool m_property_split_path(const char *path, bstr *prefix, char **rem);
 
 // Print a list of properties.
 void m_properties_print_help_list(struct mp_log *log,
-                                  const struct m_property *list);
+                                  const struct m_property_list *list);
 
 // Expand a property string.
 // This function allows to print strings containing property values.
@@ -167,9 +177,19 @@ void m_properties_print_help_list(struct mp_log *log,
 // STR is recursively expanded using the same rules.
 // "$$" can be used to escape "$", and "$}" to escape "}".
 // "$>" disables parsing of "$" for the rest of the string.
-char* m_properties_expand_string(const struct m_property *prop_list,
+char* m_properties_expand_string(const struct m_property_list *prop_list,
                                  const char *str, void *ctx);
 
+// A string as used by m_properties_expand_string(), parsed once, so that it
+// can be expanded repeatedly without parsing it again.
+struct m_property_template;
+struct m_property_template *m_property_template_compile(void *ta_parent,
+                                                        const char *str);
+// Same as m_properties_expand_string() on the compiled string.
+char *m_property_template_expand(struct m_property_template *t,
+                                 const struct m_property_list *prop_list,
+                                 void *ctx);
+
 // Trivial helpers for implementing properties.
 int m_property_flag_ro(int action, void* arg, int var);
 int m_property_int_ro(int action, void* arg, int var);
@@ -42,6 +42,7 @@
 #include "video/csputils.h"
 #include "video/hwdec.h"
 #include "video/image_writer.h"
+#include "video/mp_image_pool.h"
 #include "sub/osd.h"
 #include "player/core.h"
 #include "player/command.h"
@@ -61,6 +62,8 @@ extern const struct m_sub_options tv_params_conf;
 extern const struct m_sub_options stream_cdda_conf;
 extern const struct m_sub_options stream_dvb_conf;
 extern const struct m_sub_options stream_lavf_conf;
+extern const struct m_sub_options stream_concat_conf;
+extern const struct m_sub_options stream_file_conf;
 extern const struct m_sub_options sws_conf;
 extern const struct m_sub_options zimg_conf;
 extern const struct m_sub_options drm_conf;
@@ -69,6 +72,8 @@ extern const struct m_sub_options demux_rawvideo_conf;
 extern const struct m_sub_options demux_lavf_conf;
 extern const struct m_sub_options demux_mkv_conf;
 extern const struct m_sub_options demux_cue_conf;
+extern const struct m_sub_options demux_timeline_conf;
+extern const struct m_sub_options demux_playlist_conf;
 extern const struct m_sub_options vd_lavc_conf;
 extern const struct m_sub_options ad_lavc_conf;
 extern const struct m_sub_options input_config;
@@ -79,6 +84,7 @@ extern const struct m_sub_options ao_alsa_conf;
 
 extern const struct m_sub_options demux_conf;
 extern const struct m_sub_options demux_cache_conf;
+extern const struct m_sub_options thread_conf;
 
 extern const struct m_obj_list vf_obj_list;
 extern const struct m_obj_list af_obj_list;
@@ -188,6 +194,7 @@ static const m_option_t mp_vo_opt_list[] = {
     {"android-surface-size", OPT_SIZE_BOX(android_surface_size)},
 #endif
     {"swapchain-depth", OPT_INT(swapchain_depth), M_RANGE(1, 8)},
+    {"latency-mode", OPT_CHOICE(latency_mode, {"normal", 0}, {"low", 1})},
     {0}
 };
 
@@ -260,6 +267,7 @@ const struct m_sub_options mp_subtitle_sub_opts = {
         {"stretch-image-subs-to-screen", OPT_FLAG(stretch_image_subs)},
         {"image-subs-video-resolution", OPT_FLAG(image_subs_video_res)},
         {"sub-fix-timing", OPT_FLAG(sub_fix_timing)},
+        {"sub-render-ahead", OPT_FLAG(sub_render_ahead)},
         {"sub-pos", OPT_INT(sub_pos), M_RANGE(0, 150)},
         {"sub-gauss", OPT_FLOAT(sub_gauss), M_RANGE(0.0, 3.0)},
         {"sub-gray", OPT_FLAG(sub_gray)},
@@ -274,6 +282,8 @@ const struct m_sub_options mp_subtitle_sub_opts = {
             {"no", 0}, {"basic", 1}, {"full", 2}, {"force-601", 3})},
         {"sub-ass-vsfilter-blur-compat", OPT_FLAG(ass_vsfilter_blur_compat)},
         {"embeddedfonts", OPT_FLAG(use_embedded_fonts), .flags = UPDATE_SUB_HARD},
+        {"embeddedfonts-lazy", OPT_FLAG(embedded_fonts_lazy),
+            .flags = UPDATE_SUB_HARD},
         {"sub-ass-force-style", OPT_STRINGLIST(ass_force_style_list),
             .flags = UPDATE_SUB_HARD},
         {"sub-ass-styles", OPT_STRING(ass_styles_file),
@@ -423,6 +433,10 @@ static const m_option_t mp_opts[] = {
         .flags = CONF_PRE_PARSE | UPDATE_TERM},
     {"dump-stats", OPT_STRING(dump_stats),
         .flags = UPDATE_TERM | CONF_PRE_PARSE | M_OPT_FILE},
+    {"dump-startup-timeline", OPT_STRING(dump_startup_timeline),
+        .flags = M_OPT_FILE},
+    {"alloc-profile", OPT_FLAG(alloc_profile)},
+    {"stats-trace", OPT_FLAG(stats_trace)},
     {"msg-color", OPT_FLAG(msg_color), .flags = CONF_PRE_PARSE | UPDATE_TERM},
     {"log-file", OPT_STRING(log_file),
         .flags = CONF_PRE_PARSE | M_OPT_FILE | UPDATE_TERM},
@@ -462,6 +476,8 @@ static const m_option_t mp_opts[] = {
     {"load-auto-profiles",
         OPT_CHOICE(lua_load_auto_profiles, {"no", 0}, {"yes", 1}, {"auto", -1}),
         .flags = UPDATE_BUILTIN_SCRIPTS},
+    {"script-threads", OPT_INT(script_threads), M_RANGE(0, 64)},
+    {"script-bytecode-cache", OPT_FLAG(script_bytecode_cache)},
 #endif
 
 // ------------------------- stream options --------------------
@@ -527,7 +543,8 @@ static const m_option_t mp_opts[] = {
         {"embedded-first", 1}, {"external-first", 2})},
 
     {"hls-bitrate", OPT_CHOICE(hls_bitrate,
-        {"no", -1}, {"min", 0}, {"max", INT_MAX}), M_RANGE(0, INT_MAX)},
+        {"no", -1}, {"min", 0}, {"max", INT_MAX}, {"auto", -2}),
+        M_RANGE(0, INT_MAX)},
 
     {"display-tags", OPT_STRINGLIST(display_tags)},
 
@@ -544,16 +561,22 @@ static const m_option_t mp_opts[] = {
     {"demuxer-termination-timeout", OPT_DOUBLE(demux_termination_timeout)},
     {"demuxer-cache-wait", OPT_FLAG(demuxer_cache_wait)},
     {"prefetch-playlist", OPT_FLAG(prefetch_open)},
+    {"prefetch-playlist-decoder", OPT_FLAG(prefetch_decoder)},
+    {"prefetch-playlist-lead", OPT_DOUBLE(prefetch_lead), M_RANGE(0, DBL_MAX)},
     {"cache-pause", OPT_FLAG(cache_pause)},
     {"cache-pause-initial", OPT_FLAG(cache_pause_initial)},
     {"cache-pause-wait", OPT_FLOAT(cache_pause_wait), M_RANGE(0, DBL_MAX)},
 
     {"mf-fps", OPT_DOUBLE(mf_fps)},
     {"mf-type", OPT_STRING(mf_type)},
+    {"mf-readahead", OPT_INT(mf_readahead), M_RANGE(0, 64)},
 #if HAVE_DVBIN
     {"dvbin", OPT_SUBSTRUCT(stream_dvb_opts, stream_dvb_conf)},
 #endif
     {"", OPT_SUBSTRUCT(stream_lavf_opts, stream_lavf_conf)},
+#if HAVE_LIBURING
+    {"", OPT_SUBSTRUCT(stream_file_opts, stream_file_conf)},
+#endif
 
 // ------------------------- a-v sync options --------------------
 
@@ -591,6 +614,8 @@ static const m_option_t mp_opts[] = {
     {"demuxer-rawvideo", OPT_SUBSTRUCT(demux_rawvideo, demux_rawvideo_conf)},
     {"demuxer-mkv", OPT_SUBSTRUCT(demux_mkv, demux_mkv_conf)},
     {"demuxer-cue", OPT_SUBSTRUCT(demux_cue, demux_cue_conf)},
+    {"demuxer-timeline", OPT_SUBSTRUCT(demux_timeline, demux_timeline_conf)},
+    {"", OPT_SUBSTRUCT(demux_playlist, demux_playlist_conf)},
 
 // ------------------------- subtitles options --------------------
 
@@ -688,6 +713,16 @@ static const m_option_t mp_opts[] = {
         {"decoder", 2},
         {"decoder+vo", 3})},
     {"video-latency-hacks", OPT_FLAG(video_latency_hacks)},
+    {"image-buffer-cache", OPT_BYTE_SIZE(image_buffer_cache),
+        M_RANGE(0, M_MAX_MEM_BYTES)},
+    {"memory-budget", OPT_BYTE_SIZE(memory_budget),
+        M_RANGE(0, M_MAX_MEM_BYTES)},
+    {"image-hugepages", OPT_CHOICE(image_hugepages,
+        {"no", MP_HUGEPAGES_NO},
+        {"transparent", MP_HUGEPAGES_TRANSPARENT},
+        {"explicit", MP_HUGEPAGES_EXPLICIT})},
+    {"image-hugepages-threshold", OPT_BYTE_SIZE(image_hugepages_threshold),
+        M_RANGE(0, M_MAX_MEM_BYTES)},
 
     {"untimed", OPT_FLAG(untimed)},
 
@@ -717,6 +752,8 @@ static const m_option_t mp_opts[] = {
     {"watch-later-directory", OPT_STRING(watch_later_directory),
         .flags = M_OPT_FILE},
     {"watch-later-options", OPT_STRINGLIST(watch_later_options)},
+    {"watch-later-store", OPT_CHOICE(watch_later_store,
+        {"files", 0}, {"log", 1})},
 
     {"ordered-chapters", OPT_FLAG(ordered_chapters)},
     {"ordered-chapters-files", OPT_STRING(ordered_chapters_files),
@@ -770,6 +807,7 @@ static const m_option_t mp_opts[] = {
     {"input-ipc-server", OPT_STRING(ipc_path), .flags = M_OPT_FILE},
 #if HAVE_POSIX
     {"input-ipc-client", OPT_STRING(ipc_client)},
+    {"telemetry-file", OPT_STRING(telemetry_path), .flags = M_OPT_FILE},
 #endif
 
     {"screenshot", OPT_SUBSTRUCT(screenshot_image_opts, screenshot_conf)},
@@ -777,11 +815,13 @@ static const m_option_t mp_opts[] = {
     {"screenshot-directory", OPT_STRING(screenshot_directory),
         .flags = M_OPT_FILE},
     {"screenshot-sw", OPT_BOOL(screenshot_sw)},
+    {"screenshot-queue", OPT_INT(screenshot_queue), M_RANGE(0, 64)},
 
     {"record-file", OPT_STRING(record_file), .flags = M_OPT_FILE,
         .deprecation_message = "use --stream-record or the dump-cache command"},
 
     {"", OPT_SUBSTRUCT(resample_opts, resample_conf)},
+    {"", OPT_SUBSTRUCT(audio_meter_opts, audio_meter_conf)},
 
     {"", OPT_SUBSTRUCT(input_opts, input_config)},
 
@@ -789,6 +829,8 @@ static const m_option_t mp_opts[] = {
     {"", OPT_SUBSTRUCT(demux_opts, demux_conf)},
     {"", OPT_SUBSTRUCT(demux_cache_opts, demux_cache_conf)},
     {"", OPT_SUBSTRUCT(stream_opts, stream_conf)},
+    {"", OPT_SUBSTRUCT(stream_concat_opts, stream_concat_conf)},
+    {"", OPT_SUBSTRUCT(thread_opts, thread_conf)},
 
     {"", OPT_SUBSTRUCT(ra_ctx_opts, ra_ctx_conf)},
     {"", OPT_SUBSTRUCT(gl_video_opts, gl_video_conf)},
@@ -1013,6 +1055,8 @@ static const struct MPOpts mp_default_opts = {
     .default_max_pts_correction = -1,
     .initial_audio_sync = 1,
     .frame_dropping = 1,
+    .image_buffer_cache = 64 * 1024 * 1024,
+    .image_hugepages_threshold = 8 * 1024 * 1024,
     .term_osd = 2,
     .term_osd_bar_chars = "[-+-]",
     .consolecontrols = 1,
@@ -1040,6 +1084,7 @@ static const struct MPOpts mp_default_opts = {
     .coverart_whitelist = true,
     .osd_bar_visible = 1,
     .screenshot_template = "mpv-shot%n",
+    .screenshot_queue = 4,
     .play_dir = 1,
 
     .audio_output_channels = {
@@ -1050,6 +1095,7 @@ static const struct MPOpts mp_default_opts = {
     .index_mode = 1,
 
     .mf_fps = 1.0,
+    .mf_readahead = 4,
 
     .display_tags = (char **)(const char*[]){
         "Artist", "Album", "Album_Artist", "Comment", "Composer",
@@ -70,6 +70,7 @@ typedef struct mp_vo_opts {
     struct m_geometry android_surface_size;
 
     int swapchain_depth;  // max number of images to render ahead
+    int latency_mode;     // 1: minimize buffering in the whole video pipeline
 } mp_vo_opts;
 
 // Subtitle options needed by the subtitle decoders/renderers.
@@ -86,6 +87,7 @@ struct mp_subtitle_opts {
     int stretch_image_subs;
     int image_subs_video_res;
     int sub_fix_timing;
+    int sub_render_ahead;
     int sub_scale_by_window;
     int sub_scale_with_window;
     int ass_scale_with_window;
@@ -101,6 +103,7 @@ struct mp_subtitle_opts {
     int ass_vsfilter_color_compat;
     int ass_vsfilter_blur_compat;
     int use_embedded_fonts;
+    int embedded_fonts_lazy;
     char **ass_force_style_list;
     char *ass_styles_file;
     int ass_style_override;
@@ -137,6 +140,9 @@ typedef struct MPOpts {
     int property_print_help;
     int use_terminal;
     char *dump_stats;
+    char *dump_startup_timeline;
+    int alloc_profile;
+    int stats_trace;
     int verbose;
     int msg_really_quiet;
     char **msg_levels;
@@ -158,6 +164,8 @@ typedef struct MPOpts {
     int lua_load_stats;
     int lua_load_console;
     int lua_load_auto_profiles;
+    int script_threads;
+    int script_bytecode_cache;
 
     int auto_load_scripts;
 
@@ -214,7 +222,7 @@ typedef struct MPOpts {
     int load_config;
     char *force_configdir;
     int use_filedir_conf;
-    int hls_bitrate;
+    int hls_bitrate;            // -1: no, -2: auto
     int edition_id;
     int initial_audio_sync;
     double sync_max_video_change;
@@ -228,6 +236,10 @@ typedef struct MPOpts {
     int autosync;
     int frame_dropping;
     int video_latency_hacks;
+    int64_t image_buffer_cache;
+    int64_t memory_budget;
+    int image_hugepages;
+    int64_t image_hugepages_threshold;
     int term_osd;
     int term_osd_bar;
     char *term_osd_bar_chars;
@@ -257,6 +269,7 @@ typedef struct MPOpts {
     int ignore_path_in_watch_later_config;
     char *watch_later_directory;
     char **watch_later_options;
+    int watch_later_store;
     int pause;
     int keep_open;
     int keep_open_pause;
@@ -275,6 +288,8 @@ typedef struct MPOpts {
     double demux_termination_timeout;
     int demuxer_cache_wait;
     int prefetch_open;
+    int prefetch_decoder;
+    double prefetch_lead;
     char *audio_demuxer_name;
     char *sub_demuxer_name;
 
@@ -286,6 +301,7 @@ typedef struct MPOpts {
     char *screenshot_template;
     char *screenshot_directory;
     bool screenshot_sw;
+    int screenshot_queue;
 
     int index_mode;
 
@@ -315,22 +331,28 @@ typedef struct MPOpts {
     struct cdda_params *stream_cdda_opts;
     struct dvb_params *stream_dvb_opts;
     struct stream_lavf_params *stream_lavf_opts;
+    struct stream_file_opts *stream_file_opts;
 
     char *cdrom_device;
     char *bluray_device;
 
     double mf_fps;
     char *mf_type;
+    int mf_readahead;
 
     struct demux_rawaudio_opts *demux_rawaudio;
     struct demux_rawvideo_opts *demux_rawvideo;
     struct demux_lavf_opts *demux_lavf;
     struct demux_mkv_opts *demux_mkv;
     struct demux_cue_opts *demux_cue;
+    struct demux_timeline_opts *demux_timeline;
+    struct demux_playlist_opts *demux_playlist;
 
     struct demux_opts *demux_opts;
     struct demux_cache_opts *demux_cache_opts;
     struct stream_opts *stream_opts;
+    struct stream_concat_opts *stream_concat_opts;
+    struct thread_opts *thread_opts;
 
     struct vd_lavc_params *vd_lavc_params;
     struct ad_lavc_params *ad_lavc_params;
@@ -342,10 +364,12 @@ typedef struct MPOpts {
 
     char *ipc_path;
     char *ipc_client;
+    char *telemetry_path;
 
     int wingl_dwm_flush;
 
     struct mp_resample_opts *resample_opts;
+    struct mp_audio_meter_opts *audio_meter_opts;
 
     struct ra_ctx_opts *ra_ctx_opts;
     struct gl_video_opts *gl_video_opts;
@@ -384,6 +408,7 @@ extern const struct m_sub_options mp_sub_filter_opts;
 extern const struct m_sub_options mp_osd_render_sub_opts;
 extern const struct m_sub_options filter_conf;
 extern const struct m_sub_options resample_conf;
+extern const struct m_sub_options audio_meter_conf;
 extern const struct m_sub_options stream_conf;
 extern const struct m_sub_options dec_wrapper_conf;
 extern const struct m_sub_options mp_opt_root;
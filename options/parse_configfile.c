@@ -22,6 +22,7 @@
 #include <string.h>
 #include <errno.h>
 #include <assert.h>
+#include <sys/stat.h>
 
 #include "osdep/io.h"
 
@@ -41,23 +42,53 @@ static bool skip_ws(bstr *s)
     return s->len;
 }
 
-int m_config_parse(m_config_t *config, const char *location, bstr data,
-                   char *initial_section, int flags)
+// One line of a config file that does something.
+struct cfg_item {
+    int line_no;
+    char *profile;      // if non-NULL, the line starts this profile section
+    bstr option, value; // option assignment (if profile==NULL && !error)
+    char *error;        // if non-NULL, parse error message for this line
+};
+
+// Parse result of a config file, independent of the option state.
+struct cfg_parsed {
+    char *path;
+    int64_t mtime, size;
+    struct cfg_item *items;
+    int num_items;
+};
+
+// Parsed config files, so that repeatedly loaded files (like per-directory
+// config files with --use-filedir-conf) are not read and parsed every time.
+#define MAX_CACHED_FILES 16
+
+struct m_config_file_cache {
+    struct cfg_parsed **files; // most recently used first
+    int num_files;
+};
+
+static void add_item(struct cfg_parsed *p, int line_no, char *profile,
+                     bstr option, bstr value, char *error)
 {
-    m_profile_t *profile = m_config_add_profile(config, initial_section);
-    void *tmp = talloc_new(NULL);
+    struct cfg_item item = {
+        .line_no = line_no,
+        .profile = profile,
+        .option = bstrdup(p, option),
+        .value = bstrdup(p, value),
+        .error = error,
+    };
+    MP_TARRAY_APPEND(p, p->items, p->num_items, item);
+}
+
+static struct cfg_parsed *parse_data(void *ta_parent, bstr data)
+{
+    struct cfg_parsed *p = talloc_zero(ta_parent, struct cfg_parsed);
     int line_no = 0;
-    int errors = 0;
 
     bstr_eatstart0(&data, "\xEF\xBB\xBF"); // skip BOM
 
     while (data.len) {
-        talloc_free_children(tmp);
-        bool ok = false;
-
         line_no++;
-        char loc[512];
-        snprintf(loc, sizeof(loc), "%s:%d:", location, line_no);
 
         bstr line = bstr_strip_linebreaks(bstr_getline(data, &data));
         if (!skip_ws(&line))
@@ -67,15 +98,18 @@ int m_config_parse(m_config_t *config, const char *location, bstr data,
         if (bstr_eatstart0(&line, "[")) {
             bstr profilename;
             if (!bstr_split_tok(line, "]", &profilename, &line)) {
-                MP_ERR(config, "%s missing closing ]\n", loc);
-                goto error;
+                add_item(p, line_no, NULL, (bstr){0}, (bstr){0},
+                         talloc_strdup(p, "missing closing ]"));
+                continue;
             }
             if (skip_ws(&line)) {
-                MP_ERR(config, "%s unparseable extra characters: '%.*s'\n",
-                       loc, BSTR_P(line));
-                goto error;
+                add_item(p, line_no, NULL, (bstr){0}, (bstr){0},
+                         talloc_asprintf(p, "unparseable extra characters: "
+                                         "'%.*s'", BSTR_P(line)));
+                continue;
             }
-            profile = m_config_add_profile(config, bstrto0(tmp, profilename));
+            add_item(p, line_no, bstrto0(p, profilename), (bstr){0}, (bstr){0},
+                     NULL);
             continue;
         }
 
@@ -96,8 +130,9 @@ int m_config_parse(m_config_t *config, const char *location, bstr data,
                 char term[2] = {line.start[0], 0};
                 line = bstr_cut(line, 1);
                 if (!bstr_split_tok(line, term, &value, &line)) {
-                    MP_ERR(config, "%s unterminated quote\n", loc);
-                    goto error;
+                    add_item(p, line_no, NULL, (bstr){0}, (bstr){0},
+                             talloc_strdup(p, "unterminated quote"));
+                    continue;
                 }
             } else if (bstr_eatstart0(&line, "%")) {
                 // Quoting with length, like %5%value
@@ -106,11 +141,12 @@ int m_config_parse(m_config_t *config, const char *location, bstr data,
                 if (rest.len == line.len || !bstr_eatstart0(&rest, "%") ||
                     len > rest.len)
                 {
-                    MP_ERR(config, "%s fixed-length quoting expected - put "
-                           "\"quotes\" around the option value if you did not "
-                           "intend to use this, but your option value starts "
-                           "with '%%'\n", loc);
-                    goto error;
+                    add_item(p, line_no, NULL, (bstr){0}, (bstr){0},
+                        talloc_strdup(p, "fixed-length quoting expected - put "
+                            "\"quotes\" around the option value if you did "
+                            "not intend to use this, but your option value "
+                            "starts with '%'"));
+                    continue;
                 }
                 value = bstr_splice(rest, 0, len);
                 line = bstr_cut(rest, len);
@@ -122,22 +158,45 @@ int m_config_parse(m_config_t *config, const char *location, bstr data,
             }
         }
         if (skip_ws(&line)) {
-            MP_ERR(config, "%s unparseable extra characters: '%.*s'\n",
-                   loc, BSTR_P(line));
-            goto error;
+            add_item(p, line_no, NULL, (bstr){0}, (bstr){0},
+                     talloc_asprintf(p, "unparseable extra characters: '%.*s'",
+                                     BSTR_P(line)));
+            continue;
         }
 
-        int res = m_config_set_profile_option(config, profile, option, value);
-        if (res < 0) {
+        add_item(p, line_no, NULL, option, value, NULL);
+    }
+
+    return p;
+}
+
+static void apply_parsed(m_config_t *config, const char *location,
+                         struct cfg_parsed *p, char *initial_section, int flags)
+{
+    m_profile_t *profile = m_config_add_profile(config, initial_section);
+    int errors = 0;
+
+    for (int n = 0; n < p->num_items; n++) {
+        struct cfg_item *item = &p->items[n];
+
+        char loc[512];
+        snprintf(loc, sizeof(loc), "%s:%d:", location, item->line_no);
+
+        if (item->error) {
+            MP_ERR(config, "%s %s\n", loc, item->error);
+        } else if (item->profile) {
+            profile = m_config_add_profile(config, item->profile);
+            continue;
+        } else {
+            int res = m_config_set_profile_option(config, profile, item->option,
+                                                  item->value);
+            if (res >= 0)
+                continue;
             MP_ERR(config, "%s setting option %.*s='%.*s' failed.\n",
-                   loc, BSTR_P(option), BSTR_P(value));
-            goto error;
+                   loc, BSTR_P(item->option), BSTR_P(item->value));
         }
 
-        ok = true;
-    error:
-        if (!ok)
-            errors++;
+        errors++;
         if (errors > 16) {
             MP_ERR(config, "%s: too many errors, stopping.\n", location);
             break;
@@ -146,8 +205,14 @@ int m_config_parse(m_config_t *config, const char *location, bstr data,
 
     if (config->recursion_depth == 0)
         m_config_finish_default_profile(config, flags);
+}
 
-    talloc_free(tmp);
+int m_config_parse(m_config_t *config, const char *location, bstr data,
+                   char *initial_section, int flags)
+{
+    struct cfg_parsed *p = parse_data(NULL, data);
+    apply_parsed(config, location, p, initial_section, flags);
+    talloc_free(p);
     return 1;
 }
 
@@ -179,6 +244,67 @@ static bstr read_file(struct mp_log *log, const char *filename)
     MP_ASSERT_UNREACHABLE();
 }
 
+// Return the parsed contents of the file (allocated under ta_parent), taken
+// from the cache if the file was not changed since it was last parsed. Returns
+// NULL if the file can't be read. Use put_parsed_file() to cache it again.
+// (Entries are removed while in use, because applying a file can recursively
+// load other files, which could evict it.)
+static struct cfg_parsed *get_parsed_file(m_config_t *config, void *ta_parent,
+                                          const char *conffile)
+{
+    if (!config->file_cache)
+        config->file_cache = talloc_zero(config, struct m_config_file_cache);
+    struct m_config_file_cache *cache = config->file_cache;
+
+    struct stat st;
+    bool have_stat = stat(conffile, &st) == 0;
+
+    for (int n = 0; n < cache->num_files; n++) {
+        struct cfg_parsed *p = cache->files[n];
+        if (strcmp(p->path, conffile) != 0)
+            continue;
+        MP_TARRAY_REMOVE_AT(cache->files, cache->num_files, n);
+        if (have_stat && p->mtime == st.st_mtime && p->size == st.st_size)
+            return talloc_steal(ta_parent, p);
+        talloc_free(p);
+        break;
+    }
+
+    bstr data = read_file(config->log, conffile);
+    if (!data.start)
+        return NULL;
+
+    struct cfg_parsed *p = parse_data(ta_parent, data);
+    talloc_free(data.start);
+
+    // Without a valid stat, there is no way to tell whether it changed.
+    if (have_stat) {
+        p->path = talloc_strdup(p, conffile);
+        p->mtime = st.st_mtime;
+        p->size = st.st_size;
+    }
+    return p;
+}
+
+static void put_parsed_file(m_config_t *config, struct cfg_parsed *p)
+{
+    struct m_config_file_cache *cache = config->file_cache;
+
+    if (!p->path)
+        return;
+
+    // Possibly added again by a recursive include of the same file.
+    for (int n = 0; n < cache->num_files; n++) {
+        if (strcmp(cache->files[n]->path, p->path) == 0)
+            return;
+    }
+
+    if (cache->num_files == MAX_CACHED_FILES)
+        talloc_free(cache->files[--cache->num_files]);
+    MP_TARRAY_INSERT_AT(cache, cache->files, cache->num_files, 0,
+                        talloc_steal(cache, p));
+}
+
 // Load options and profiles from a config file.
 //  conffile: path to the config file
 //  initial_section: default section where to add normal options
@@ -191,11 +317,14 @@ int m_config_parse_config_file(m_config_t *config, const char *conffile,
 
     MP_VERBOSE(config, "Reading config file %s\n", conffile);
 
-    bstr data = read_file(config->log, conffile);
-    if (!data.start)
-        return 0;
-
-    int r = m_config_parse(config, conffile, data, initial_section, flags);
-    talloc_free(data.start);
+    void *tmp = talloc_new(NULL);
+    struct cfg_parsed *p = get_parsed_file(config, tmp, conffile);
+    int r = 0;
+    if (p) {
+        apply_parsed(config, conffile, p, initial_section, flags);
+        put_parsed_file(config, p);
+        r = 1;
+    }
+    talloc_free(tmp);
     return r;
 }
@@ -16,11 +16,16 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <pthread.h>
 
 #include "common/common.h"
+#include "common/msg.h"
 #include "config.h"
+#include "options/m_config.h"
+#include "options/m_option.h"
 #include "threads.h"
 #include "timer.h"
 
@@ -28,6 +33,32 @@
 #include <pthread_np.h>
 #endif
 
+#if HAVE_POSIX
+#include <sched.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct thread_opts {
+    char **affinity;
+    char **policy;
+    char **io_priority;
+};
+
+#define OPT_BASE_STRUCT struct thread_opts
+const struct m_sub_options thread_conf = {
+    .opts = (const struct m_option[]) {
+        {"thread-affinity", OPT_KEYVALUELIST(affinity)},
+        {"thread-policy", OPT_KEYVALUELIST(policy)},
+        {"thread-io-priority", OPT_KEYVALUELIST(io_priority)},
+        {0}
+    },
+    .size = sizeof(struct thread_opts),
+};
+
 int mpthread_mutex_init_recursive(pthread_mutex_t *mutex)
 {
     pthread_mutexattr_t attr;
@@ -54,6 +85,176 @@ void mpthread_set_name(const char *name)
 #endif
 }
 
+// Return the value set for the thread class in a key/value list, or NULL.
+static const char *find_class(char **list, const char *cls)
+{
+    for (int n = 0; list && list[n] && list[n + 1]; n += 2) {
+        if (strcmp(list[n], cls) == 0)
+            return list[n + 1];
+    }
+    return NULL;
+}
+
+// Parse "name" or "name:N" into name and *level (unchanged if not present).
+static bool parse_level(const char *spec, char *name, size_t name_size,
+                        int *level)
+{
+    const char *sep = strchr(spec, ':');
+    size_t len = sep ? sep - spec : strlen(spec);
+    if (len >= name_size)
+        return false;
+    memcpy(name, spec, len);
+    name[len] = '\0';
+    if (sep) {
+        char *end;
+        long v = strtol(sep + 1, &end, 10);
+        if (end == sep + 1 || *end || v < 0 || v > 99)
+            return false;
+        *level = v;
+    }
+    return true;
+}
+
+// spec is a list of CPU numbers or ranges separated by "+", e.g. "0-3+6".
+static void set_affinity(struct mp_log *log, const char *spec)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    const char *s = spec;
+    while (*s) {
+        char *end;
+        long a = strtol(s, &end, 10), b = a;
+        if (end == s)
+            goto error;
+        if (*end == '-') {
+            s = end + 1;
+            b = strtol(s, &end, 10);
+            if (end == s)
+                goto error;
+        }
+        if (a < 0 || b < a || b >= CPU_SETSIZE)
+            goto error;
+        for (long n = a; n <= b; n++)
+            CPU_SET(n, &set);
+        if (*end == '+') {
+            end++;
+        } else if (*end) {
+            goto error;
+        }
+        s = end;
+    }
+    int r = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (r) {
+        mp_warn(log, "Could not set CPU affinity %s: %s\n", spec, mp_strerror(r));
+    } else {
+        mp_verbose(log, "Thread CPU affinity: %s\n", spec);
+    }
+    return;
+error:
+    mp_warn(log, "Invalid CPU list: %s\n", spec);
+#else
+    mp_warn(log, "Setting CPU affinity is not supported on this platform.\n");
+#endif
+}
+
+// spec is "other", "fifo" or "rr", optionally followed by ":PRIORITY".
+static void set_policy(struct mp_log *log, const char *spec)
+{
+#if HAVE_POSIX
+    char name[20];
+    int prio = -1;
+    if (!parse_level(spec, name, sizeof(name), &prio))
+        goto error;
+    int policy;
+    if (strcmp(name, "other") == 0) {
+        policy = SCHED_OTHER;
+    } else if (strcmp(name, "fifo") == 0) {
+        policy = SCHED_FIFO;
+    } else if (strcmp(name, "rr") == 0) {
+        policy = SCHED_RR;
+    } else {
+        goto error;
+    }
+    struct sched_param param = {
+        .sched_priority = prio >= 0 ? prio : sched_get_priority_min(policy),
+    };
+    int r = pthread_setschedparam(pthread_self(), policy, &param);
+    if (r) {
+        mp_warn(log, "Could not set scheduling policy %s: %s\n", spec,
+                mp_strerror(r));
+    } else {
+        mp_verbose(log, "Thread scheduling policy: %s (priority %d)\n", name,
+                   param.sched_priority);
+    }
+    return;
+error:
+    mp_warn(log, "Invalid scheduling policy: %s\n", spec);
+#else
+    mp_warn(log, "Setting the scheduling policy is not supported on this "
+            "platform.\n");
+#endif
+}
+
+// spec is "realtime", "best-effort" or "idle", optionally followed by ":LEVEL".
+static void set_io_priority(struct mp_log *log, const char *spec)
+{
+#if defined(__linux__) && defined(SYS_ioprio_set)
+    // From linux/ioprio.h, which is not always installed.
+    enum { IOPRIO_CLASS_SHIFT = 13, IOPRIO_WHO_PROCESS = 1 };
+    char name[20];
+    int level = 4;
+    if (!parse_level(spec, name, sizeof(name), &level) || level > 7)
+        goto error;
+    int ioclass;
+    if (strcmp(name, "realtime") == 0) {
+        ioclass = 1;
+    } else if (strcmp(name, "best-effort") == 0) {
+        ioclass = 2;
+    } else if (strcmp(name, "idle") == 0) {
+        ioclass = 3;
+        level = 0;
+    } else {
+        goto error;
+    }
+    // who=0 means the calling thread.
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                (ioclass << IOPRIO_CLASS_SHIFT) | level) < 0)
+    {
+        mp_warn(log, "Could not set I/O priority %s: %s\n", spec,
+                mp_strerror(errno));
+    } else {
+        mp_verbose(log, "Thread I/O priority: %s (level %d)\n", name, level);
+    }
+    return;
+error:
+    mp_warn(log, "Invalid I/O priority: %s\n", spec);
+#else
+    mp_warn(log, "Setting the I/O priority is not supported on this "
+            "platform.\n");
+#endif
+}
+
+void mpthread_set_class(struct mpv_global *global, struct mp_log *log,
+                        const char *cls)
+{
+    struct thread_opts *opts = mp_get_config_group(NULL, global, &thread_conf);
+
+    const char *affinity = find_class(opts->affinity, cls);
+    if (affinity)
+        set_affinity(log, affinity);
+
+    const char *policy = find_class(opts->policy, cls);
+    if (policy)
+        set_policy(log, policy);
+
+    const char *io_priority = find_class(opts->io_priority, cls);
+    if (io_priority)
+        set_io_priority(log, io_priority);
+
+    talloc_free(opts);
+}
+
 int mp_ptwrap_check(const char *file, int line, int res)
 {
     if (res && res != ETIMEDOUT) {
@@ -10,6 +10,15 @@ int mpthread_mutex_init_recursive(pthread_mutex_t *mutex);
 // Set thread name (for debuggers).
 void mpthread_set_name(const char *name);
 
+struct mpv_global;
+struct mp_log;
+
+// Apply the user's CPU affinity, scheduling policy and I/O priority settings
+// for the given thread class ("audio", "video", "demux", "decoder", "io") to
+// the calling thread. What was applied (or failed) is logged to log.
+void mpthread_set_class(struct mpv_global *global, struct mp_log *log,
+                        const char *cls);
+
 int mp_ptwrap_check(const char *file, int line, int res);
 int mp_ptwrap_mutex_init(const char *file, int line, pthread_mutex_t *m,
                          const pthread_mutexattr_t *attr);
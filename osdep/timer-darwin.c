@@ -28,6 +28,7 @@
 #include "timer.h"
 
 static double timebase_ratio;
+static struct mach_timebase_info timebase;
 
 void mp_sleep_us(int64_t us)
 {
@@ -36,15 +37,21 @@ void mp_sleep_us(int64_t us)
     mach_wait_until(deadline);
 }
 
-uint64_t mp_raw_time_us(void)
+uint64_t mp_raw_time_ns(void)
 {
-    return mach_absolute_time() * timebase_ratio * 1e6;
+    // Split to avoid overflows with large numer.
+    uint64_t t = mach_absolute_time();
+    return t / timebase.denom * timebase.numer +
+           t % timebase.denom * timebase.numer / timebase.denom;
 }
 
-void mp_raw_time_init(void)
+uint64_t mp_raw_time_coarse_ns(void)
 {
-    struct mach_timebase_info timebase;
+    return mp_raw_time_ns();
+}
 
+void mp_raw_time_init(void)
+{
     mach_timebase_info(&timebase);
     timebase_ratio = (double)timebase.numer / (double)timebase.denom * 1e-9;
 }
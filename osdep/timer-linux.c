@@ -36,19 +36,41 @@ void mp_sleep_us(int64_t us)
 }
 
 #if defined(_POSIX_TIMERS) && _POSIX_TIMERS > 0 && defined(CLOCK_MONOTONIC)
-uint64_t mp_raw_time_us(void)
+// (On Linux, this is normally answered from the vDSO using the TSC, with the
+// kernel doing the calibration and falling back to other clock sources.)
+uint64_t mp_raw_time_ns(void)
 {
     struct timespec ts;
     if (clock_gettime(CLOCK_MONOTONIC, &ts))
         abort();
-    return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+#ifdef CLOCK_MONOTONIC_COARSE
+uint64_t mp_raw_time_coarse_ns(void)
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC_COARSE, &ts))
+        return mp_raw_time_ns();
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
 }
 #else
-uint64_t mp_raw_time_us(void)
+uint64_t mp_raw_time_coarse_ns(void)
+{
+    return mp_raw_time_ns();
+}
+#endif
+#else
+uint64_t mp_raw_time_ns(void)
 {
     struct timeval tv;
     gettimeofday(&tv,NULL);
-    return tv.tv_sec * 1000000LL + tv.tv_usec;
+    return tv.tv_sec * 1000000000LL + tv.tv_usec * 1000LL;
+}
+
+uint64_t mp_raw_time_coarse_ns(void)
+{
+    return mp_raw_time_ns();
 }
 #endif
 
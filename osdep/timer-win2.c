@@ -66,16 +66,21 @@ void mp_sleep_us(int64_t us)
     mp_end_hires_timers(hrt);
 }
 
-uint64_t mp_raw_time_us(void)
+uint64_t mp_raw_time_ns(void)
 {
     LARGE_INTEGER perf_count;
     QueryPerformanceCounter(&perf_count);
 
-    // Convert QPC units (1/perf_freq seconds) to microseconds. This will work
+    // Convert QPC units (1/perf_freq seconds) to nanoseconds. This will work
     // without overflow because the QPC value is guaranteed not to roll-over
     // within 100 years, so perf_freq must be less than 2.9*10^9.
-    return perf_count.QuadPart / perf_freq.QuadPart * 1000000 +
-        perf_count.QuadPart % perf_freq.QuadPart * 1000000 / perf_freq.QuadPart;
+    return perf_count.QuadPart / perf_freq.QuadPart * 1000000000 +
+        perf_count.QuadPart % perf_freq.QuadPart * 1000000000 / perf_freq.QuadPart;
+}
+
+uint64_t mp_raw_time_coarse_ns(void)
+{
+    return mp_raw_time_ns();
 }
 
 void mp_raw_time_init(void)
@@ -27,18 +27,18 @@
 #include "common/msg.h"
 #include "timer.h"
 
-static uint64_t raw_time_offset;
+static uint64_t raw_time_offset; // in ns
 static pthread_once_t timer_init_once = PTHREAD_ONCE_INIT;
 
 static void do_timer_init(void)
 {
     mp_raw_time_init();
-    srand(mp_raw_time_us());
-    raw_time_offset = mp_raw_time_us();
+    srand(mp_raw_time_ns() / 1000);
+    raw_time_offset = mp_raw_time_ns();
     // Arbitrary additional offset to avoid confusing relative/absolute times.
     // Also,we rule that the timer never returns 0 (so default-initialized
     // time values will be always in the past).
-    raw_time_offset -= MP_START_TIME;
+    raw_time_offset -= MP_START_TIME * 1000LL;
 }
 
 void mp_time_init(void)
@@ -46,9 +46,27 @@ void mp_time_init(void)
     pthread_once(&timer_init_once, do_timer_init);
 }
 
+uint64_t mp_raw_time_us(void)
+{
+    return mp_raw_time_ns() / 1000;
+}
+
+int64_t mp_time_ns(void)
+{
+    int64_t r = mp_raw_time_ns() - raw_time_offset;
+    if (r < MP_START_TIME * 1000LL)
+        r = MP_START_TIME * 1000LL;
+    return r;
+}
+
 int64_t mp_time_us(void)
 {
-    int64_t r = mp_raw_time_us() - raw_time_offset;
+    return mp_time_ns() / 1000;
+}
+
+int64_t mp_time_us_coarse(void)
+{
+    int64_t r = (int64_t)(mp_raw_time_coarse_ns() - raw_time_offset) / 1000;
     if (r < MP_START_TIME)
         r = MP_START_TIME;
     return r;
@@ -26,12 +26,24 @@ void mp_time_init(void);
 // Return time in microseconds. Never wraps. Never returns 0 or negative values.
 int64_t mp_time_us(void);
 
+// Like mp_time_us(), but in nanoseconds (mp_time_us() == mp_time_ns() / 1000).
+// The actual resolution depends on the OS timer.
+int64_t mp_time_ns(void);
+
+// Like mp_time_us(), but possibly cheaper, and with a resolution of only some
+// milliseconds (it may lag behind mp_time_us() by that much). Not suitable
+// for anything that is compared against deadlines used for sleeping.
+int64_t mp_time_us_coarse(void);
+
 // Return time in seconds. Can have down to 1 microsecond resolution, but will
 // be much worse when casted to float.
 double mp_time_sec(void);
 
 // Provided by OS specific functions (timer-linux.c)
 void mp_raw_time_init(void);
+uint64_t mp_raw_time_ns(void);
+uint64_t mp_raw_time_coarse_ns(void);
+
 uint64_t mp_raw_time_us(void);
 
 // Sleep in microseconds.
@@ -27,6 +27,7 @@
 
 #include "common/msg.h"
 #include "common/encode.h"
+#include "common/stats.h"
 #include "options/options.h"
 #include "common/common.h"
 #include "osdep/timer.h"
@@ -35,6 +36,7 @@
 #include "audio/out/ao.h"
 #include "demux/demux.h"
 #include "filters/f_async_queue.h"
+#include "filters/f_audio_meter.h"
 #include "filters/f_decoder_wrapper.h"
 #include "filters/filter_internal.h"
 
@@ -414,9 +416,11 @@ static int reinit_audio_filters_and_output(struct MPContext *mpctx)
 
     mpctx->ao_filter_fmt = out_fmt;
 
-    mpctx->ao = ao_init_best(mpctx->global, ao_flags, mp_wakeup_core_cb,
+    stats_startup_begin(mpctx->global, "ao-create");
+    mpctx->ao = ao_init_best(mpctx->global, ao_flags, mp_wakeup_core_ao_cb,
                              mpctx, mpctx->encode_lavc_ctx, out_rate,
                              out_format, out_channels);
+    stats_startup_end(mpctx->global, "ao-create");
 
     int ao_rate = 0;
     int ao_format = 0;
@@ -854,6 +858,12 @@ void fill_audio_out_buffers(struct MPContext *mpctx)
         return;
     }
 
+    if (ao_c->filter->audio_meter->updated) {
+        ao_c->filter->audio_meter->updated = false;
+        mp_notify_property(mpctx, "audio-meter");
+        mp_notify_property(mpctx, "audio-meter-channels");
+    }
+
     if (ao_c->filter->ao_needs_update) {
         if (reinit_audio_filters_and_output(mpctx) < 0)
             return;
@@ -78,6 +78,11 @@ struct mp_client_api {
     // clients.
     uint64_t clients_list_change_ts;
     int64_t id_alloc;
+    // Number of observe_property entries of all clients, indexed by property
+    // ID (mp_get_property_id()). May be higher than the real number for a
+    // short time, never lower.
+    int *num_observers;
+    int num_observers_size;
 
     struct mp_custom_protocol *custom_protocols;
     int num_custom_protocols;
@@ -94,6 +99,7 @@ struct observe_property {
     int64_t reply_id;
     mpv_format format;
     const struct m_option *type;
+    double min_interval;    // min. time between change events (seconds)
     // -- protected by owner->lock
     size_t refcount;
     uint64_t change_ts;     // logical timestamp incremented on each change
@@ -103,6 +109,7 @@ struct observe_property {
     uint64_t value_ret_ts;  // logical timestamp of value returned to user
     union m_option_value value_ret;
     bool waiting_for_hook;  // flag for draining old property changes on a hook
+    double last_change;     // mp_time_sec() of the last value change
 };
 
 struct mpv_handle {
@@ -114,9 +121,9 @@ struct mpv_handle {
     int64_t id;
 
     // -- not thread-safe
-    struct mpv_event *cur_event;
-    struct mpv_event_property cur_property_event;
-    struct observe_property *cur_property;
+    struct mpv_event *cur_event; // also talloc parent for returned event data
+    struct observe_property **ret_props; // referenced by returned events
+    int num_ret_props;
 
     pthread_mutex_t lock;
 
@@ -162,8 +169,17 @@ struct mpv_handle {
     int messages_level;
 };
 
-static bool gen_log_message_event(struct mpv_handle *ctx);
-static bool gen_property_change_event(struct mpv_handle *ctx);
+// Value of an observed property read during a mp_client_send_property_changes()
+// call; shared by all clients observing it with the same format.
+struct prop_snapshot {
+    char *name;
+    mpv_format format;
+    int status;
+    union m_option_value value;
+};
+
+static bool gen_log_message_event(struct mpv_handle *ctx, mpv_event *event);
+static bool gen_property_change_event(struct mpv_handle *ctx, mpv_event *event);
 static void notify_property_events(struct mpv_handle *ctx, int event);
 
 // Must be called with prop->owner->lock held.
@@ -178,6 +194,36 @@ static void prop_unref(struct observe_property *prop)
         talloc_free(prop);
 }
 
+// Free the data of events returned by the previous mpv_wait_event(s)() call.
+// Must be called with ctx->lock held.
+static void release_returned_events(struct mpv_handle *ctx)
+{
+    for (int n = 0; n < ctx->num_ret_props; n++)
+        prop_unref(ctx->ret_props[n]);
+    ctx->num_ret_props = 0;
+    talloc_free_children(ctx->cur_event);
+}
+
+// Must be called without any mpv_handle.lock held.
+static void add_observers(struct mp_client_api *clients, int id, int delta)
+{
+    if (id < 0)
+        return;
+
+    pthread_mutex_lock(&clients->lock);
+    if (id >= clients->num_observers_size) {
+        int old_size = clients->num_observers_size;
+        MP_TARRAY_GROW(clients, clients->num_observers, id);
+        clients->num_observers_size = talloc_get_size(clients->num_observers) /
+                                      sizeof(clients->num_observers[0]);
+        for (int n = old_size; n < clients->num_observers_size; n++)
+            clients->num_observers[n] = 0;
+    }
+    clients->num_observers[id] += delta;
+    assert(clients->num_observers[id] >= 0);
+    pthread_mutex_unlock(&clients->lock);
+}
+
 void mp_clients_init(struct MPContext *mpctx)
 {
     mpctx->clients = talloc_ptrtype(NULL, mpctx->clients);
@@ -447,16 +493,23 @@ static void mp_destroy_client(mpv_handle *ctx, bool terminate)
 
     ctx->destroying = true;
 
-    for (int n = 0; n < ctx->num_properties; n++)
+    int *ids = talloc_array(NULL, int, ctx->num_properties);
+    int num_ids = ctx->num_properties;
+    for (int n = 0; n < ctx->num_properties; n++) {
+        ids[n] = ctx->properties[n]->id;
         prop_unref(ctx->properties[n]);
+    }
     ctx->num_properties = 0;
     ctx->properties_change_ts += 1;
 
-    prop_unref(ctx->cur_property);
-    ctx->cur_property = NULL;
+    release_returned_events(ctx);
 
     pthread_mutex_unlock(&ctx->lock);
 
+    for (int n = 0; n < num_ids; n++)
+        add_observers(clients, ids[n], -1);
+    talloc_free(ids);
+
     abort_async(mpctx, ctx, 0, 0);
 
     // reserved_events equals the number of asynchronous requests that weren't
@@ -665,7 +718,7 @@ int mpv_initialize(mpv_handle *ctx)
 {
     lock_core(ctx);
     int res = mp_initialize(ctx->mpctx, NULL) ? MPV_ERROR_INVALID_PARAMETER : 0;
-    mp_wakeup_core(ctx->mpctx);
+    mp_wakeup_core_reason(ctx->mpctx, MP_WAKEUP_CLIENT);
     unlock_core(ctx);
     return res;
 }
@@ -792,7 +845,7 @@ void mp_client_broadcast_event_external(struct mp_client_api *api, int event,
     struct MPContext *mpctx = api->mpctx;
 
     mp_client_broadcast_event(mpctx, event, data);
-    mp_wakeup_core(mpctx);
+    mp_wakeup_core_reason(mpctx, MP_WAKEUP_CLIENT);
 }
 
 // If client_name == NULL, then broadcast and free the event.
@@ -892,14 +945,55 @@ static bool check_for_for_hook_flags(mpv_handle *ctx)
     return false;
 }
 
-mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
+// Fetch the next event into *event without waiting. Event data is allocated
+// under ctx->cur_event. Must be called with ctx->lock held.
+static bool read_event(mpv_handle *ctx, mpv_event *event)
 {
-    mpv_event *event = ctx->cur_event;
+    // Recover from overflow.
+    if (ctx->choked && !ctx->num_events) {
+        ctx->choked = false;
+        *event = (mpv_event){.event_id = MPV_EVENT_QUEUE_OVERFLOW};
+        return true;
+    }
+    struct mpv_event *ev =
+        ctx->num_events ? &ctx->events[ctx->first_event] : NULL;
+    if (ev && ev->event_id == MPV_EVENT_HOOK) {
+        // Give old property notifications priority over hooks. This is a
+        // guarantee given to clients to simplify their logic. New property
+        // changes after this are treated normally, so
+        if (!ctx->hook_pending) {
+            ctx->hook_pending = true;
+            set_wait_for_hook_flags(ctx);
+        }
+        if (check_for_for_hook_flags(ctx)) {
+            ev = NULL; // delay
+        } else {
+            ctx->hook_pending = false;
+        }
+    }
+    if (ev) {
+        *event = *ev;
+        ctx->first_event = (ctx->first_event + 1) % ctx->max_events;
+        ctx->num_events--;
+        talloc_steal(ctx->cur_event, event->data);
+        return true;
+    }
+    // If there's a changed property, generate change event (never queued).
+    if (gen_property_change_event(ctx, event))
+        return true;
+    // Pop item from message queue, and return as event.
+    return gen_log_message_event(ctx, event);
+}
+
+int mpv_wait_events(mpv_handle *ctx, double timeout, mpv_event *events,
+                    int max_events)
+{
+    int num = 0;
 
     pthread_mutex_lock(&ctx->lock);
 
     if (!ctx->fuzzy_initialized)
-        mp_wakeup_core(ctx->clients->mpctx);
+        mp_wakeup_core_reason(ctx->clients->mpctx, MP_WAKEUP_CLIENT);
     ctx->fuzzy_initialized = true;
 
     if (timeout < 0)
@@ -907,46 +1001,18 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
 
     int64_t deadline = mp_add_timeout(mp_time_us(), timeout);
 
-    *event = (mpv_event){0};
-    talloc_free_children(event);
+    release_returned_events(ctx);
 
-    while (1) {
+    while (num < max_events) {
         if (ctx->queued_wakeup)
             deadline = 0;
-        // Recover from overflow.
-        if (ctx->choked && !ctx->num_events) {
-            ctx->choked = false;
-            event->event_id = MPV_EVENT_QUEUE_OVERFLOW;
-            break;
-        }
-        struct mpv_event *ev =
-            ctx->num_events ? &ctx->events[ctx->first_event] : NULL;
-        if (ev && ev->event_id == MPV_EVENT_HOOK) {
-            // Give old property notifications priority over hooks. This is a
-            // guarantee given to clients to simplify their logic. New property
-            // changes after this are treated normally, so
-            if (!ctx->hook_pending) {
-                ctx->hook_pending = true;
-                set_wait_for_hook_flags(ctx);
-            }
-            if (check_for_for_hook_flags(ctx)) {
-                ev = NULL; // delay
-            } else {
-                ctx->hook_pending = false;
-            }
-        }
-        if (ev) {
-            *event = *ev;
-            ctx->first_event = (ctx->first_event + 1) % ctx->max_events;
-            ctx->num_events--;
-            talloc_steal(event, event->data);
-            break;
+        if (read_event(ctx, &events[num])) {
+            num++;
+            // Only wait for the first event; drain the rest without blocking.
+            deadline = 0;
+            continue;
         }
-        // If there's a changed property, generate change event (never queued).
-        if (gen_property_change_event(ctx))
-            break;
-        // Pop item from message queue, and return as event.
-        if (gen_log_message_event(ctx))
+        if (num)
             break;
         int r = wait_wakeup(ctx, deadline);
         if (r == ETIMEDOUT)
@@ -956,6 +1022,16 @@ mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
 
     pthread_mutex_unlock(&ctx->lock);
 
+    return num;
+}
+
+mpv_event *mpv_wait_event(mpv_handle *ctx, double timeout)
+{
+    mpv_event *event = ctx->cur_event;
+
+    mpv_event ev;
+    *event = mpv_wait_events(ctx, timeout, &ev, 1) ? ev : (mpv_event){0};
+
     return event;
 }
 
@@ -1337,6 +1413,56 @@ int mpv_set_property(mpv_handle *ctx, const char *name, mpv_format format,
     return req.status;
 }
 
+struct setproperties_request {
+    struct MPContext *mpctx;
+    struct mpv_node_list *list;
+    int status;
+};
+
+static void setproperties_fn(void *arg)
+{
+    struct setproperties_request *req = arg;
+
+    req->status = 0;
+    for (int n = 0; n < req->list->num; n++) {
+        struct setproperty_request r = {
+            .mpctx = req->mpctx,
+            .name = req->list->keys[n],
+            .format = MPV_FORMAT_NODE,
+            .data = &req->list->values[n],
+        };
+        setproperty_fn(&r);
+        if (r.status < 0) {
+            req->status = r.status;
+            break;
+        }
+    }
+}
+
+int mpv_set_properties(mpv_handle *ctx, mpv_node *properties)
+{
+    if (!properties || properties->format != MPV_FORMAT_NODE_MAP)
+        return MPV_ERROR_INVALID_PARAMETER;
+    struct mpv_node_list *list = properties->u.list;
+
+    if (!ctx->mpctx->initialized) {
+        for (int n = 0; n < list->num; n++) {
+            int r = mpv_set_property(ctx, list->keys[n], MPV_FORMAT_NODE,
+                                     &list->values[n]);
+            if (r < 0)
+                return r;
+        }
+        return 0;
+    }
+
+    struct setproperties_request req = {
+        .mpctx = ctx->mpctx,
+        .list = list,
+    };
+    run_locked(ctx, setproperties_fn, &req);
+    return req.status;
+}
+
 int mpv_set_property_string(mpv_handle *ctx, const char *name, const char *data)
 {
     return mpv_set_property(ctx, name, MPV_FORMAT_STRING, &data);
@@ -1485,6 +1611,51 @@ int mpv_get_property(mpv_handle *ctx, const char *name, mpv_format format,
     return req.status;
 }
 
+struct getproperties_request {
+    struct MPContext *mpctx;
+    const char **names;
+    struct mpv_node *res;
+};
+
+static void getproperties_fn(void *arg)
+{
+    struct getproperties_request *req = arg;
+
+    node_init(req->res, MPV_FORMAT_NODE_MAP, NULL);
+    for (int n = 0; req->names[n]; n++) {
+        struct mpv_node val = {0};
+        struct getproperty_request r = {
+            .mpctx = req->mpctx,
+            .name = req->names[n],
+            .format = MPV_FORMAT_NODE,
+            .data = &val,
+        };
+        getproperty_fn(&r);
+        struct mpv_node *entry = node_map_add(req->res, req->names[n],
+                                              MPV_FORMAT_NONE);
+        if (r.status >= 0) {
+            *entry = val;
+            talloc_steal(req->res->u.list, node_get_alloc(entry));
+        }
+    }
+}
+
+int mpv_get_properties(mpv_handle *ctx, const char **names, mpv_node *result)
+{
+    if (!ctx->mpctx->initialized)
+        return MPV_ERROR_UNINITIALIZED;
+    if (!names || !result)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    struct getproperties_request req = {
+        .mpctx = ctx->mpctx,
+        .names = names,
+        .res = result,
+    };
+    run_locked(ctx, getproperties_fn, &req);
+    return 0;
+}
+
 char *mpv_get_property_string(mpv_handle *ctx, const char *name)
 {
     char *str = NULL;
@@ -1530,8 +1701,9 @@ static void property_free(void *p)
     }
 }
 
-int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
-                         const char *name, mpv_format format)
+static int observe_property(mpv_handle *ctx, uint64_t userdata,
+                            const char *name, mpv_format format,
+                            double min_interval)
 {
     const struct m_option *type = get_mp_type_get(format);
     if (format != MPV_FORMAT_NONE && !type)
@@ -1539,6 +1711,12 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
     // Explicitly disallow this, because it would require a special code path.
     if (format == MPV_FORMAT_OSD_STRING)
         return MPV_ERROR_PROPERTY_FORMAT;
+    if (!(min_interval >= 0))
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    // Register before the property can be found, so no change is missed.
+    int id = mp_get_property_id(ctx->mpctx, name);
+    add_observers(ctx->clients, id, 1);
 
     pthread_mutex_lock(&ctx->lock);
     assert(!ctx->destroying);
@@ -1547,11 +1725,12 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
     *prop = (struct observe_property){
         .owner = ctx,
         .name = talloc_strdup(prop, name),
-        .id = mp_get_property_id(ctx->mpctx, name),
+        .id = id,
         .event_mask = mp_get_property_event_mask(name),
         .reply_id = userdata,
         .format = format,
         .type = type,
+        .min_interval = min_interval,
         .change_ts = 1, // force initial event
         .refcount = 1,
     };
@@ -1562,12 +1741,26 @@ int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
     ctx->cur_property_index = 0;
     ctx->has_pending_properties = true;
     pthread_mutex_unlock(&ctx->lock);
-    mp_wakeup_core(ctx->mpctx);
+    mp_wakeup_core_reason(ctx->mpctx, MP_WAKEUP_CLIENT);
     return 0;
 }
 
+int mpv_observe_property(mpv_handle *ctx, uint64_t userdata,
+                         const char *name, mpv_format format)
+{
+    return observe_property(ctx, userdata, name, format, 0);
+}
+
+int mpv_observe_property_interval(mpv_handle *ctx, uint64_t userdata,
+                                  const char *name, mpv_format format,
+                                  double min_interval)
+{
+    return observe_property(ctx, userdata, name, format, min_interval);
+}
+
 int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
 {
+    int *ids = NULL;
     pthread_mutex_lock(&ctx->lock);
     int count = 0;
     for (int n = ctx->num_properties - 1; n >= 0; n--) {
@@ -1575,6 +1768,8 @@ int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
         // Perform actual removal of the property lazily to avoid creating
         // dangling pointers and such.
         if (prop->reply_id == userdata) {
+            MP_TARRAY_GROW(NULL, ids, count);
+            ids[count] = prop->id;
             prop_unref(prop);
             ctx->properties_change_ts += 1;
             MP_TARRAY_REMOVE_AT(ctx->properties, ctx->num_properties, n);
@@ -1583,6 +1778,9 @@ int mpv_unobserve_property(mpv_handle *ctx, uint64_t userdata)
         }
     }
     pthread_mutex_unlock(&ctx->lock);
+    for (int n = 0; n < count; n++)
+        add_observers(ctx->clients, ids[n], -1);
+    talloc_free(ids);
     return count;
 }
 
@@ -1595,6 +1793,14 @@ void mp_client_property_change(struct MPContext *mpctx, const char *name)
 
     pthread_mutex_lock(&clients->lock);
 
+    // Most property changes are not observed by anyone.
+    if (id >= 0 && (id >= clients->num_observers_size ||
+                    !clients->num_observers[id]))
+    {
+        pthread_mutex_unlock(&clients->lock);
+        return;
+    }
+
     for (int n = 0; n < clients->num_clients; n++) {
         struct mpv_handle *client = clients->clients[n];
         pthread_mutex_lock(&client->lock);
@@ -1635,8 +1841,48 @@ static void notify_property_events(struct mpv_handle *ctx, int event)
         mp_dispatch_adjust_timeout(ctx->mpctx->dispatch, 0);
 }
 
+// Read the property, or reuse the value read for another client during the
+// same mp_client_send_property_changes() call. Only called on the playloop
+// thread, with no locks held.
+static int read_observed_property(struct MPContext *mpctx,
+                                  struct prop_snapshot **snaps, int *num_snaps,
+                                  const char *name, mpv_format format,
+                                  union m_option_value *val)
+{
+    const struct m_option *type = get_mp_type_get(format);
+
+    for (int n = 0; n < *num_snaps; n++) {
+        struct prop_snapshot *snap = &(*snaps)[n];
+        if (snap->format == format && strcmp(snap->name, name) == 0) {
+            if (snap->status >= 0)
+                m_option_copy(type, val, &snap->value);
+            return snap->status;
+        }
+    }
+
+    struct getproperty_request req = {
+        .mpctx = mpctx,
+        .name = name,
+        .format = format,
+        .data = val,
+    };
+    getproperty_fn(&req);
+
+    struct prop_snapshot snap = {
+        .name = talloc_strdup(NULL, name),
+        .format = format,
+        .status = req.status,
+    };
+    if (req.status >= 0)
+        m_option_copy(type, &snap.value, val);
+    MP_TARRAY_APPEND(NULL, *snaps, *num_snaps, snap);
+    return req.status;
+}
+
 // Call with ctx->lock held (only). May temporarily drop the lock.
-static void send_client_property_changes(struct mpv_handle *ctx)
+static void send_client_property_changes(struct mpv_handle *ctx,
+                                         struct prop_snapshot **snaps,
+                                         int *num_snaps)
 {
     uint64_t cur_ts = ctx->properties_change_ts;
 
@@ -1648,16 +1894,21 @@ static void send_client_property_changes(struct mpv_handle *ctx)
         if (prop->value_ts == prop->change_ts)
             continue;
 
+        // Rate limited: leave the change pending, and look at it again once
+        // the interval has passed. (Not for the initial event.)
+        if (prop->min_interval > 0 && prop->value_ts) {
+            double wait = prop->last_change + prop->min_interval - mp_time_sec();
+            if (wait > 0) {
+                mp_set_timeout(ctx->mpctx, wait);
+                ctx->has_pending_properties = true;
+                continue;
+            }
+        }
+
         bool changed = false;
         if (prop->format) {
             const struct m_option *type = prop->type;
             union m_option_value val = {0};
-            struct getproperty_request req = {
-                .mpctx = ctx->mpctx,
-                .name = prop->name,
-                .format = prop->format,
-                .data = &val,
-            };
 
             // Temporarily unlock and read the property. The very important
             // thing is that property getters can do whatever they want, _and_
@@ -1666,7 +1917,8 @@ static void send_client_property_changes(struct mpv_handle *ctx)
             prop->refcount += 1; // keep prop alive (esp. prop->name)
             ctx->async_counter += 1; // keep ctx alive
             pthread_mutex_unlock(&ctx->lock);
-            getproperty_fn(&req);
+            int status = read_observed_property(ctx->mpctx, snaps, num_snaps,
+                                                prop->name, prop->format, &val);
             pthread_mutex_lock(&ctx->lock);
             ctx->async_counter -= 1;
             prop_unref(prop);
@@ -1681,7 +1933,7 @@ static void send_client_property_changes(struct mpv_handle *ctx)
             }
             assert(prop->refcount > 0);
 
-            bool val_valid = req.status >= 0;
+            bool val_valid = status >= 0;
             changed = prop->value_valid != val_valid;
             if (prop->value_valid && val_valid)
                 changed = !equal_mpv_value(&prop->value, &val, prop->format);
@@ -1713,6 +1965,8 @@ static void send_client_property_changes(struct mpv_handle *ctx)
             ctx->new_property_events = true;
         }
 
+        if (changed)
+            prop->last_change = mp_time_sec();
         prop->value_ts = prop->change_ts;
     }
 
@@ -1724,6 +1978,9 @@ void mp_client_send_property_changes(struct MPContext *mpctx)
 {
     struct mp_client_api *clients = mpctx->clients;
 
+    struct prop_snapshot *snaps = NULL;
+    int num_snaps = 0;
+
     pthread_mutex_lock(&clients->lock);
     uint64_t cur_ts = clients->clients_list_change_ts;
 
@@ -1737,7 +1994,7 @@ void mp_client_send_property_changes(struct MPContext *mpctx)
         }
         // Keep ctx->lock locked (unlock order does not matter).
         pthread_mutex_unlock(&clients->lock);
-        send_client_property_changes(ctx);
+        send_client_property_changes(ctx, &snaps, &num_snaps);
         pthread_mutex_unlock(&ctx->lock);
         pthread_mutex_lock(&clients->lock);
         if (cur_ts != clients->clients_list_change_ts) {
@@ -1748,11 +2005,18 @@ void mp_client_send_property_changes(struct MPContext *mpctx)
     }
 
     pthread_mutex_unlock(&clients->lock);
+
+    for (int n = 0; n < num_snaps; n++) {
+        if (snaps[n].status >= 0)
+            m_option_free(get_mp_type_get(snaps[n].format), &snaps[n].value);
+        talloc_free(snaps[n].name);
+    }
+    talloc_free(snaps);
 }
 
-// Set ctx->cur_event to a generated property change event, if there is any
+// Set *event to a generated property change event, if there is any
 // outstanding property.
-static bool gen_property_change_event(struct mpv_handle *ctx)
+static bool gen_property_change_event(struct mpv_handle *ctx, mpv_event *event)
 {
     if (!ctx->mpctx->initialized)
         return false;
@@ -1773,22 +2037,23 @@ static bool gen_property_change_event(struct mpv_handle *ctx)
         {
             prop->value_ret_ts = prop->value_ts;
             prop->waiting_for_hook = false;
-            prop_unref(ctx->cur_property);
-            ctx->cur_property = prop;
+            // Keep it alive while the event is accessed by the user.
+            MP_TARRAY_APPEND(ctx, ctx->ret_props, ctx->num_ret_props, prop);
             prop->refcount += 1;
 
             if (prop->value_valid)
                 m_option_copy(prop->type, &prop->value_ret, &prop->value);
 
-            ctx->cur_property_event = (struct mpv_event_property){
+            struct mpv_event_property *pev = talloc_ptrtype(ctx->cur_event, pev);
+            *pev = (struct mpv_event_property){
                 .name = prop->name,
                 .format = prop->value_valid ? prop->format : 0,
                 .data = prop->value_valid ? &prop->value_ret : NULL,
             };
-            *ctx->cur_event = (struct mpv_event){
+            *event = (struct mpv_event){
                 .event_id = MPV_EVENT_PROPERTY_CHANGE,
                 .reply_userdata = prop->reply_id,
-                .data = &ctx->cur_property_event,
+                .data = pev,
             };
             return true;
         }
@@ -1873,8 +2138,8 @@ int mpv_request_log_messages(mpv_handle *ctx, const char *min_level)
     return 0;
 }
 
-// Set ctx->cur_event to a generated log message event, if any available.
-static bool gen_log_message_event(struct mpv_handle *ctx)
+// Set *event to a generated log message event, if any available.
+static bool gen_log_message_event(struct mpv_handle *ctx, mpv_event *event)
 {
     if (ctx->messages) {
         struct mp_log_buffer_entry *msg =
@@ -1889,7 +2154,7 @@ static bool gen_log_message_event(struct mpv_handle *ctx)
                 .log_level = mp_mpv_log_levels[msg->level],
                 .text = msg->text,
             };
-            *ctx->cur_event = (struct mpv_event){
+            *event = (struct mpv_event){
                 .event_id = MPV_EVENT_LOG_MESSAGE,
                 .data = cmsg,
             };
@@ -36,9 +36,11 @@
 #include "client.h"
 #include "common/av_common.h"
 #include "common/codecs.h"
+#include "common/memory.h"
 #include "common/msg.h"
 #include "common/msg_control.h"
 #include "common/stats.h"
+#include "filters/f_audio_meter.h"
 #include "filters/f_decoder_wrapper.h"
 #include "command.h"
 #include "osdep/timer.h"
@@ -58,12 +60,15 @@
 #include "video/out/vo.h"
 #include "video/csputils.h"
 #include "video/hwdec.h"
+#include "video/mp_image_pool.h"
 #include "audio/aframe.h"
 #include "audio/format.h"
 #include "audio/out/ao.h"
 #include "video/out/bitmap_packer.h"
 #include "options/path.h"
 #include "screenshot.h"
+#include "telemetry.h"
+#include "misc/dir_cache.h"
 #include "misc/dispatch.h"
 #include "misc/node.h"
 #include "misc/thread_pool.h"
@@ -78,9 +83,24 @@
 #include <windows.h>
 #endif
 
+// Number of compiled property expansion strings kept.
+#define MAX_EXPAND_TEMPLATES 8
+
+struct expand_template {
+    char *str;          // source string (before unescaping if escaped)
+    bool escaped;
+    struct m_property_template *t;
+    uint64_t last_use;
+    int busy;           // being expanded (property getters may expand too)
+};
+
 struct command_ctx {
-    // All properties, terminated with a {0} item.
-    struct m_property *properties;
+    // All properties, sorted by name.
+    struct m_property_list properties;
+
+    // Recently expanded strings, e.g. --term-status-msg.
+    struct expand_template expand_templates[MAX_EXPAND_TEMPLATES];
+    uint64_t expand_counter;
 
     double last_seek_time;
     double last_seek_pts;
@@ -950,6 +970,7 @@ static int parse_node_chapters(struct MPContext *mpctx,
     talloc_free(mpctx->chapters);
     mpctx->num_chapters = 0;
     mpctx->chapters = talloc_array(NULL, struct demux_chapter, 0);
+    mpctx->chapters_unsorted = false;
 
     for (int n = 0; n < given_chapters->u.list->num; n++) {
         struct mpv_node *chapter_data = &given_chapters->u.list->values[n];
@@ -989,6 +1010,9 @@ static int parse_node_chapters(struct MPContext *mpctx,
             };
             if (title)
                 mp_tags_set_str(new.metadata, "title", title);
+            if (mpctx->num_chapters &&
+                mpctx->chapters[mpctx->num_chapters - 1].pts > time)
+                mpctx->chapters_unsorted = true;
             MP_TARRAY_APPEND(NULL, mpctx->chapters, mpctx->num_chapters, new);
         }
     }
@@ -1471,8 +1495,13 @@ static int mp_property_demuxer_cache_state(void *ctx, struct m_property *prop,
     node_map_add_int64(r, "fw-bytes", s.fw_bytes);
     if (s.file_cache_bytes >= 0)
         node_map_add_int64(r, "file-cache-bytes", s.file_cache_bytes);
+    if (s.file_cache_queued_bytes >= 0) {
+        node_map_add_int64(r, "file-cache-queued-bytes",
+                           s.file_cache_queued_bytes);
+    }
     if (s.bytes_per_second > 0)
         node_map_add_int64(r, "raw-input-rate", s.bytes_per_second);
+    node_map_add_double(r, "readahead-target", s.readahead_target);
     if (s.seeking != MP_NOPTS_VALUE)
         node_map_add_double(r, "debug-seeking", s.seeking);
     node_map_add_int64(r, "debug-low-level-seeks", s.low_level_seeks);
@@ -1492,6 +1521,79 @@ static int mp_property_demuxer_cache_state(void *ctx, struct m_property *prop,
         node_map_add_double(sub, "end", range->end);
     }
 
+    if (s.num_stream_segments) {
+        struct mpv_node *segs =
+            node_map_add(r, "network-segments", MPV_FORMAT_NODE_ARRAY);
+        for (int n = 0; n < s.num_stream_segments; n++) {
+            struct demux_stream_segment *seg = &s.stream_segments[n];
+            struct mpv_node *sub = node_array_add(segs, MPV_FORMAT_NODE_MAP);
+            node_map_add_int64(sub, "start", seg->start);
+            node_map_add_int64(sub, "end", seg->end);
+            node_map_add_int64(sub, "received", seg->received);
+        }
+    }
+
+    return M_PROPERTY_OK;
+}
+
+static void add_seek_time(struct mpv_node *r, const char *name, int64_t us)
+{
+    if (us >= 0)
+        node_map_add_double(r, name, us / 1e6);
+}
+
+static int mp_property_last_seek_timing(void *ctx, struct m_property *prop,
+                                        int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    struct seek_timing *t = &mpctx->seek_timing;
+    if (!t->queued)
+        return M_PROPERTY_UNAVAILABLE;
+
+    if (action == M_PROPERTY_GET_TYPE) {
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    }
+    if (action != M_PROPERTY_GET)
+        return M_PROPERTY_NOT_IMPLEMENTED;
+
+    struct mpv_node *r = (struct mpv_node *)arg;
+    node_init(r, MPV_FORMAT_NODE_MAP, NULL);
+
+    node_map_add_flag(r, "done", t->done);
+    add_seek_time(r, "execute", t->executed);
+    add_seek_time(r, "demux", t->demux_done);
+    add_seek_time(r, "reset", t->reset_done);
+    add_seek_time(r, "first-frame", t->first_frame);
+    add_seek_time(r, "restart", t->restarted);
+
+    if (t->done) {
+        node_map_add_flag(r, "demux-cached", t->demux.cached);
+        add_seek_time(r, "demux-lookup", t->demux.lookup_time);
+        add_seek_time(r, "demux-low-level", t->demux.low_level_time);
+        node_map_add_int64(r, "demux-stream-seeks", t->demux.stream_seeks);
+        add_seek_time(r, "video-flush", t->vdec_flush);
+        add_seek_time(r, "video-refill", t->vdec_refill);
+        add_seek_time(r, "audio-flush", t->adec_flush);
+        add_seek_time(r, "audio-refill", t->adec_refill);
+    }
+
+    return M_PROPERTY_OK;
+}
+
+static int mp_property_startup_timeline(void *ctx, struct m_property *prop,
+                                        int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+
+    if (action == M_PROPERTY_GET_TYPE) {
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    }
+    if (action != M_PROPERTY_GET)
+        return M_PROPERTY_NOT_IMPLEMENTED;
+
+    stats_startup_query(mpctx->global, arg);
     return M_PROPERTY_OK;
 }
 
@@ -1666,6 +1768,16 @@ static int mp_property_ao_mute(void *ctx, struct m_property *prop,
     return M_PROPERTY_NOT_IMPLEMENTED;
 }
 
+static int mp_property_ao_latency(void *ctx, struct m_property *prop,
+                                  int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    struct ao *ao = mpctx->ao;
+    if (!ao)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_double_ro(action, arg, ao_get_delay(ao));
+}
+
 static int get_device_entry(int item, int action, void *arg, void *ctx)
 {
     struct ao_device_list *list = ctx;
@@ -1818,6 +1930,70 @@ static int mp_property_audio_out_params(void *ctx, struct m_property *prop,
     return r;
 }
 
+static bool get_audio_meter(struct MPContext *mpctx,
+                            struct mp_audio_meter_state *st)
+{
+    return mpctx->ao_chain &&
+           mp_audio_meter_get(mpctx->ao_chain->filter->audio_meter, st);
+}
+
+static int mp_property_audio_meter(void *ctx, struct m_property *prop,
+                                   int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    struct mp_audio_meter_state st;
+    if (!get_audio_meter(mpctx, &st))
+        return M_PROPERTY_UNAVAILABLE;
+
+    double peak = MP_AUDIO_METER_FLOOR_DB, true_peak = MP_AUDIO_METER_FLOOR_DB;
+    for (int n = 0; n < st.chmap.num; n++) {
+        peak = MPMAX(peak, st.peak[n]);
+        true_peak = MPMAX(true_peak, st.true_peak[n]);
+    }
+
+    struct m_sub_property props[] = {
+        {"channel-count",   SUB_PROP_INT(st.chmap.num)},
+        {"peak",            SUB_PROP_DOUBLE(peak)},
+        {"true-peak",       SUB_PROP_DOUBLE(true_peak)},
+        {"momentary",       SUB_PROP_DOUBLE(st.momentary),
+                            .unavailable = !st.loudness},
+        {"short-term",      SUB_PROP_DOUBLE(st.short_term),
+                            .unavailable = !st.loudness},
+        {"integrated",      SUB_PROP_DOUBLE(st.integrated),
+                            .unavailable = !st.loudness},
+        {0}
+    };
+
+    return m_property_read_sub(props, action, arg);
+}
+
+static int get_audio_meter_entry(int item, int action, void *arg, void *ctx)
+{
+    struct mp_audio_meter_state *st = ctx;
+    const char *name = mp_speaker_id_to_str(st->chmap.speaker[item]);
+
+    struct m_sub_property props[] = {
+        {"name",        SUB_PROP_STR(name), .unavailable = !name},
+        {"peak",        SUB_PROP_DOUBLE(st->peak[item])},
+        {"rms",         SUB_PROP_DOUBLE(st->rms[item])},
+        {"true-peak",   SUB_PROP_DOUBLE(st->true_peak[item])},
+        {0}
+    };
+
+    return m_property_read_sub(props, action, arg);
+}
+
+static int mp_property_audio_meter_channels(void *ctx, struct m_property *prop,
+                                            int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    struct mp_audio_meter_state st;
+    if (!get_audio_meter(mpctx, &st))
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_read_list(action, arg, st.chmap.num,
+                                get_audio_meter_entry, &st);
+}
+
 static struct track* track_next(struct MPContext *mpctx, enum stream_type type,
                                 int direction, struct track *track)
 {
@@ -2119,6 +2295,37 @@ static int mp_property_hwdec_current(void *ctx, struct m_property *prop,
     return m_property_strdup_ro(action, arg, current);
 }
 
+static int mp_property_decoder_drop_policy(void *ctx, struct m_property *prop,
+                                           int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    struct track *track = mpctx->current_track[0][STREAM_VIDEO];
+    struct mp_decoder_wrapper *dec = track ? track->dec : NULL;
+
+    struct vd_drop_policy_info info;
+    if (!dec || mp_decoder_wrapper_control(dec, VDCTRL_GET_DROP_POLICY,
+                                           &info) != CONTROL_TRUE)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct m_sub_property props[] = {
+        {"level",           SUB_PROP_STR(info.level)},
+        {"active",          SUB_PROP_FLAG(info.active)},
+        {"frame-budget",    SUB_PROP_DOUBLE(info.budget),
+                            .unavailable = info.budget <= 0},
+        {"decode-time",     SUB_PROP_DOUBLE(info.cost),
+                            .unavailable = info.cost <= 0},
+        {"decode-time-i",   SUB_PROP_DOUBLE(info.type_cost[1]),
+                            .unavailable = info.type_cost[1] <= 0},
+        {"decode-time-p",   SUB_PROP_DOUBLE(info.type_cost[2]),
+                            .unavailable = info.type_cost[2] <= 0},
+        {"decode-time-b",   SUB_PROP_DOUBLE(info.type_cost[3]),
+                            .unavailable = info.type_cost[3] <= 0},
+        {0}
+    };
+
+    return m_property_read_sub(props, action, arg);
+}
+
 static int mp_property_hwdec_interop(void *ctx, struct m_property *prop,
                                      int action, void *arg)
 {
@@ -2431,6 +2638,19 @@ static int mp_property_vsync_jitter(void *ctx, struct m_property *prop,
     return m_property_double_ro(action, arg, stddev);
 }
 
+static int mp_property_display_latency(void *ctx, struct m_property *prop,
+                                       int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    struct vo *vo = mpctx->video_out;
+    if (!vo)
+        return M_PROPERTY_UNAVAILABLE;
+    double latency = vo_get_display_latency(vo);
+    if (latency <= 0)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_double_ro(action, arg, latency);
+}
+
 static int mp_property_display_resolution(void *ctx, struct m_property *prop,
                                           int action, void *arg)
 {
@@ -2594,6 +2814,22 @@ out:
     return ret;
 }
 
+static int mp_property_vo_quality_tier(void *ctx, struct m_property *prop,
+                                       int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+    if (!mpctx->video_out)
+        return M_PROPERTY_UNAVAILABLE;
+
+    struct voctrl_performance_data *data = talloc_ptrtype(NULL, data);
+    int ret = M_PROPERTY_UNAVAILABLE;
+    if (vo_control(mpctx->video_out, VOCTRL_PERFORMANCE_DATA, data) > 0 &&
+        data->auto_quality)
+        ret = m_property_int_ro(action, arg, data->quality_tier);
+    talloc_free(data);
+    return ret;
+}
+
 static int mp_property_perf_info(void *ctx, struct m_property *p, int action,
                                  void *arg)
 {
@@ -2611,6 +2847,23 @@ static int mp_property_perf_info(void *ctx, struct m_property *p, int action,
     return M_PROPERTY_NOT_IMPLEMENTED;
 }
 
+static int mp_property_memory_usage(void *ctx, struct m_property *p,
+                                    int action, void *arg)
+{
+    MPContext *mpctx = ctx;
+
+    switch (action) {
+    case M_PROPERTY_GET_TYPE:
+        *(struct m_option *)arg = (struct m_option){.type = CONF_TYPE_NODE};
+        return M_PROPERTY_OK;
+    case M_PROPERTY_GET: {
+        mp_memory_query(mpctx->global, (struct mpv_node *)arg);
+        return M_PROPERTY_OK;
+    }
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
 static int mp_property_vo(void *ctx, struct m_property *p, int action, void *arg)
 {
     MPContext *mpctx = ctx;
@@ -3444,9 +3697,9 @@ static int mp_property_list(void *ctx, struct m_property *prop,
     case M_PROPERTY_GET: {
         char **list = NULL;
         int num = 0;
-        for (int n = 0; cmd->properties[n].name; n++) {
+        for (int n = 0; n < cmd->properties.num; n++) {
             MP_TARRAY_APPEND(NULL, list, num,
-                                talloc_strdup(NULL, cmd->properties[n].name));
+                             talloc_strdup(NULL, cmd->properties.props[n].name));
         }
         MP_TARRAY_APPEND(NULL, list, num, NULL);
         *(char ***)arg = list;
@@ -3609,6 +3862,8 @@ static const struct m_property mp_properties_base[] = {
     {"demuxer-cache-idle", mp_property_demuxer_cache_idle},
     {"demuxer-start-time", mp_property_demuxer_start_time},
     {"demuxer-cache-state", mp_property_demuxer_cache_state},
+    {"last-seek-timing", mp_property_last_seek_timing},
+    {"startup-timeline", mp_property_startup_timeline},
     {"cache-buffering-state", mp_property_cache_buffering},
     {"paused-for-cache", mp_property_paused_for_cache},
     {"demuxer-via-network", mp_property_demuxer_is_network},
@@ -3634,11 +3889,14 @@ static const struct m_property mp_properties_base[] = {
     {"volume", mp_property_volume},
     {"ao-volume", mp_property_ao_volume},
     {"ao-mute", mp_property_ao_mute},
+    {"ao-latency", mp_property_ao_latency},
     {"audio-delay", mp_property_audio_delay},
     {"audio-codec-name", mp_property_audio_codec_name},
     {"audio-codec", mp_property_audio_codec},
     {"audio-params", mp_property_audio_params},
     {"audio-out-params", mp_property_audio_out_params},
+    {"audio-meter", mp_property_audio_meter},
+    {"audio-meter-channels", mp_property_audio_meter_channels},
     {"aid", property_switch_track, .priv = (void *)(const int[]){0, STREAM_AUDIO}},
     {"audio-device", mp_property_audio_device},
     {"audio-device-list", mp_property_audio_devices},
@@ -3658,7 +3916,9 @@ static const struct m_property mp_properties_base[] = {
     {"current-window-scale", mp_property_current_window_scale},
     {"vo-configured", mp_property_vo_configured},
     {"vo-passes", mp_property_vo_passes},
+    {"vo-quality-tier", mp_property_vo_quality_tier},
     {"perf-info", mp_property_perf_info},
+    {"memory-usage", mp_property_memory_usage},
     {"current-vo", mp_property_vo},
     {"container-fps", mp_property_fps},
     {"estimated-vf-fps", mp_property_vf_fps},
@@ -3667,6 +3927,7 @@ static const struct m_property mp_properties_base[] = {
     {"vid", property_switch_track, .priv = (void *)(const int[]){0, STREAM_VIDEO}},
     {"hwdec-current", mp_property_hwdec_current},
     {"hwdec-interop", mp_property_hwdec_interop},
+    {"decoder-drop-policy", mp_property_decoder_drop_policy},
 
     {"estimated-frame-count", mp_property_frame_count},
     {"estimated-frame-number", mp_property_frame_number},
@@ -3724,6 +3985,7 @@ static const struct m_property mp_properties_base[] = {
     {"display-fps", mp_property_display_fps},
     {"estimated-display-fps", mp_property_estimated_display_fps},
     {"vsync-jitter", mp_property_vsync_jitter},
+    {"display-latency", mp_property_display_latency},
     {"display-hidpi-scale", mp_property_hidpi_scale},
 
     {"working-directory", mp_property_cwd},
@@ -3778,10 +4040,11 @@ static const char *const *const mp_event_property_change[] = {
       "estimated-vf-fps", "drop-frame-count", "vo-drop-frame-count",
       "total-avsync-change", "audio-speed-correction", "video-speed-correction",
       "vo-delayed-frame-count", "mistimed-frame-count", "vsync-ratio",
-      "estimated-display-fps", "vsync-jitter", "sub-text", "secondary-sub-text",
+      "estimated-display-fps", "vsync-jitter", "display-latency", "sub-text",
+      "secondary-sub-text",
       "audio-bitrate", "video-bitrate", "sub-bitrate", "decoder-frame-drop-count",
       "frame-drop-count", "video-frame-info", "vf-metadata", "af-metadata",
-      "sub-start", "sub-end", "secondary-sub-start", "secondary-sub-end"),
+      "decoder-drop-policy", "sub-start", "sub-end", "secondary-sub-start", "secondary-sub-end"),
     E(MP_EVENT_DURATION_UPDATE, "duration"),
     E(MPV_EVENT_VIDEO_RECONFIG, "video-out-params", "video-params",
       "video-format", "video-codec", "video-bitrate", "dwidth", "dheight",
@@ -3791,9 +4054,12 @@ static const char *const *const mp_event_property_change[] = {
     E(MPV_EVENT_AUDIO_RECONFIG, "audio-format", "audio-codec", "audio-bitrate",
       "samplerate", "channels", "audio", "volume", "mute",
       "current-ao", "audio-codec-name", "audio-params",
-      "audio-out-params", "volume-max", "mixer-active"),
-    E(MPV_EVENT_SEEK, "seeking", "core-idle", "eof-reached"),
-    E(MPV_EVENT_PLAYBACK_RESTART, "seeking", "core-idle", "eof-reached"),
+      "audio-out-params", "volume-max", "mixer-active", "audio-meter",
+      "audio-meter-channels"),
+    E(MPV_EVENT_SEEK, "seeking", "core-idle", "eof-reached",
+      "last-seek-timing"),
+    E(MPV_EVENT_PLAYBACK_RESTART, "seeking", "core-idle", "eof-reached",
+      "last-seek-timing", "startup-timeline"),
     E(MP_EVENT_METADATA_UPDATE, "metadata", "filtered-metadata", "media-title"),
     E(MP_EVENT_CHAPTER_CHANGE, "chapter", "chapter-metadata"),
     E(MP_EVENT_CACHE_UPDATE,
@@ -3855,11 +4121,14 @@ uint64_t mp_get_property_event_mask(const char *name)
 int mp_get_property_id(struct MPContext *mpctx, const char *name)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    for (int n = 0; ctx->properties[n].name; n++) {
-        if (match_property(ctx->properties[n].name, name))
-            return n;
-    }
-    return -1;
+    // Same as match_property(): sub-properties and options/ map to the
+    // top-level property.
+    if (strncmp(name, "options/", 8) == 0)
+        name += 8;
+    char base[128];
+    snprintf(base, sizeof(base), "%.*s", (int)strcspn(name, "/"), name);
+    struct m_property *prop = m_property_list_find(&ctx->properties, base);
+    return prop ? prop - ctx->properties.props : -1;
 }
 
 static bool is_property_set(int action, void *val)
@@ -3884,7 +4153,7 @@ int mp_property_do(const char *name, int action, void *val,
                    struct MPContext *ctx)
 {
     struct command_ctx *cmd = ctx->command_ctx;
-    int r = m_property_do(ctx->log, cmd->properties, name, action, val, ctx);
+    int r = m_property_do(ctx->log, &cmd->properties, name, action, val, ctx);
 
     if (mp_msg_test(ctx->log, MSGL_V) && is_property_set(action, val)) {
         struct m_option ot = {0};
@@ -3906,37 +4175,98 @@ int mp_property_do(const char *name, int action, void *val,
     return r;
 }
 
-char *mp_property_expand_string(struct MPContext *mpctx, const char *str)
-{
-    struct command_ctx *ctx = mpctx->command_ctx;
-    return m_properties_expand_string(ctx->properties, str, mpctx);
-}
-
-// Before expanding properties, parse C-style escapes like "\n"
-char *mp_property_expand_escaped_string(struct MPContext *mpctx, const char *str)
+// Parse C-style escapes like "\n". Returns NULL on error.
+static char *unescape_string(void *ta_parent, const char *str)
 {
-    void *tmp = talloc_new(NULL);
     bstr strb = bstr0(str);
     bstr dst = {0};
     while (strb.len) {
-        if (!mp_append_escaped_string(tmp, &dst, &strb)) {
-            talloc_free(tmp);
-            return talloc_strdup(NULL, "(broken escape sequences)");
-        }
+        if (!mp_append_escaped_string(ta_parent, &dst, &strb))
+            return NULL;
         // pass " through literally
         if (!bstr_eatstart0(&strb, "\""))
             break;
-        bstr_xappend(tmp, &dst, bstr0("\""));
+        bstr_xappend(ta_parent, &dst, bstr0("\""));
     }
-    char *r = mp_property_expand_string(mpctx, dst.start);
+    return dst.start ? (char *)dst.start : talloc_strdup(ta_parent, "");
+}
+
+static struct m_property_template *compile_template(void *ta_parent,
+                                                    const char *str,
+                                                    bool escaped)
+{
+    if (!escaped)
+        return m_property_template_compile(ta_parent, str);
+    void *tmp = talloc_new(NULL);
+    char *s = unescape_string(tmp, str);
+    struct m_property_template *t =
+        m_property_template_compile(ta_parent, s ? s : "$>(broken escape sequences)");
     talloc_free(tmp);
+    return t;
+}
+
+// The same strings (status line, window title, OSD messages) are typically
+// expanded over and over, so keep the most recently used ones compiled
+// instead of parsing them on each update.
+static char *expand_string(struct MPContext *mpctx, const char *str,
+                           bool escaped)
+{
+    struct command_ctx *ctx = mpctx->command_ctx;
+    if (!str)
+        str = "";
+    struct expand_template *entry = NULL;
+    for (int n = 0; n < MAX_EXPAND_TEMPLATES; n++) {
+        struct expand_template *e = &ctx->expand_templates[n];
+        if (e->str && e->escaped == escaped && strcmp(e->str, str) == 0) {
+            entry = e;
+            break;
+        }
+    }
+
+    if (!entry) {
+        for (int n = 0; n < MAX_EXPAND_TEMPLATES; n++) {
+            struct expand_template *e = &ctx->expand_templates[n];
+            if (!e->busy && (!entry || e->last_use < entry->last_use))
+                entry = e;
+        }
+        if (!entry) {
+            // All in use by nested expansions; don't cache.
+            void *t = compile_template(NULL, str, escaped);
+            char *r = m_property_template_expand(t, &ctx->properties, mpctx);
+            talloc_free(t);
+            return r;
+        }
+        talloc_free(entry->str);
+        talloc_free(entry->t);
+        *entry = (struct expand_template){
+            .str = talloc_strdup(ctx, str),
+            .escaped = escaped,
+            .t = compile_template(ctx, str, escaped),
+        };
+    }
+
+    entry->last_use = ++ctx->expand_counter;
+    entry->busy++;
+    char *r = m_property_template_expand(entry->t, &ctx->properties, mpctx);
+    entry->busy--;
     return r;
 }
 
+char *mp_property_expand_string(struct MPContext *mpctx, const char *str)
+{
+    return expand_string(mpctx, str, false);
+}
+
+// Before expanding properties, parse C-style escapes like "\n"
+char *mp_property_expand_escaped_string(struct MPContext *mpctx, const char *str)
+{
+    return expand_string(mpctx, str, true);
+}
+
 void property_print_help(struct MPContext *mpctx)
 {
     struct command_ctx *ctx = mpctx->command_ctx;
-    m_properties_print_help_list(mpctx->log, ctx->properties);
+    m_properties_print_help_list(mpctx->log, &ctx->properties);
 }
 
 /* List of default ways to show a property on OSD.
@@ -4784,6 +5114,9 @@ static void cmd_seek(void *p)
     case 1: precision = MPSEEK_KEYFRAME; break;
     case 2: precision = MPSEEK_EXACT; break;
     }
+    unsigned flags = MPSEEK_FLAG_DELAY;
+    if (cmd->args[1].v.i & 64)
+        flags |= MPSEEK_FLAG_SCRUB;
     if (!mpctx->playback_initialized) {
         cmd->success = false;
         return;
@@ -4792,14 +5125,14 @@ static void cmd_seek(void *p)
     mark_seek(mpctx);
     switch (abs) {
     case 0: { // Relative seek
-        queue_seek(mpctx, MPSEEK_RELATIVE, v, precision, MPSEEK_FLAG_DELAY);
+        queue_seek(mpctx, MPSEEK_RELATIVE, v, precision, flags);
         set_osd_function(mpctx, (v > 0) ? OSD_FFW : OSD_REW);
         break;
     }
     case 1: { // Absolute seek by percentage
         double ratio = v / 100.0;
         double cur_pos = get_current_pos_ratio(mpctx, false);
-        queue_seek(mpctx, MPSEEK_FACTOR, ratio, precision, MPSEEK_FLAG_DELAY);
+        queue_seek(mpctx, MPSEEK_FACTOR, ratio, precision, flags);
         set_osd_function(mpctx, cur_pos < ratio ? OSD_FFW : OSD_REW);
         break;
     }
@@ -4813,7 +5146,7 @@ static void cmd_seek(void *p)
             }
             v = MPMAX(0, len + v);
         }
-        queue_seek(mpctx, MPSEEK_ABSOLUTE, v, precision, MPSEEK_FLAG_DELAY);
+        queue_seek(mpctx, MPSEEK_ABSOLUTE, v, precision, flags);
         set_osd_function(mpctx,
                          v > get_current_time(mpctx) ? OSD_FFW : OSD_REW);
         break;
@@ -4821,7 +5154,7 @@ static void cmd_seek(void *p)
     case 3: { // Relative seek by percentage
         queue_seek(mpctx, MPSEEK_FACTOR,
                    get_current_pos_ratio(mpctx, false) + v / 100.0,
-                   precision, MPSEEK_FLAG_DELAY);
+                   precision, flags);
         set_osd_function(mpctx, v > 0 ? OSD_FFW : OSD_REW);
         break;
     }}
@@ -5427,6 +5760,8 @@ static void cmd_rescan_external_files(void *p)
         return;
     }
 
+    // The directory mtime may not catch all changes.
+    mp_dir_cache_flush(mpctx->dir_cache);
     autoload_external_files(mpctx, cmd->abort->cancel);
     if (!cmd->args[0].v.i && mpctx->playback_initialized) {
         // somewhat fuzzy and not ideal
@@ -5802,6 +6137,19 @@ static void cmd_write_watch_later_config(void *p)
     mp_write_watch_later_conf(mpctx);
 }
 
+static void cmd_dump_trace(void *p)
+{
+    struct mp_cmd_ctx *cmd = p;
+    struct MPContext *mpctx = cmd->mpctx;
+
+    void *tmp = talloc_new(NULL);
+    struct mpv_node trace;
+    stats_trace_query(mpctx->global, &trace);
+    talloc_steal(tmp, trace.u.list);
+    cmd->success = write_json_file(mpctx, cmd->args[0].v.s, &trace);
+    talloc_free(tmp);
+}
+
 static void cmd_delete_watch_later_config(void *p)
 {
     struct mp_cmd_ctx *cmd = p;
@@ -6042,7 +6390,8 @@ const struct mp_cmd_def mp_cmds[] = {
                 {"absolute", 4|2},
                 {"relative-percent", 4|3},
                 {"keyframes", 32|8},
-                {"exact", 32|16}),
+                {"exact", 32|16},
+                {"scrub", 64}),
                 OPTDEF_INT(4|0)},
             // backwards compatibility only
             {"legacy", OPT_CHOICE(v.i,
@@ -6250,6 +6599,17 @@ const struct mp_cmd_def mp_cmds[] = {
                 OPTDEF_INT(2)},
         },
     },
+    { "extract-thumbnails", cmd_extract_thumbnails,
+        {
+            {"url", OPT_STRING(v.s)},
+            {"times", OPT_STRINGLIST(v.str_list)},
+            {"width", OPT_INT(v.i), M_RANGE(0, 16384), OPTDEF_INT(160)},
+            {"height", OPT_INT(v.i), M_RANGE(0, 16384), OPTDEF_INT(0)},
+            {"threads", OPT_INT(v.i), M_RANGE(0, 16), OPTDEF_INT(0)},
+        },
+        .spawn_thread = true,
+        .can_abort = true,
+    },
     { "loadfile", cmd_loadfile,
         {
             {"url", OPT_STRING(v.s)},
@@ -6429,6 +6789,8 @@ const struct mp_cmd_def mp_cmds[] = {
 
     { "load-script", cmd_load_script, {{"filename", OPT_STRING(v.s)}} },
 
+    { "dump-trace", cmd_dump_trace, { {"filename", OPT_STRING(v.s)} } },
+
     { "dump-cache", cmd_dump_cache, { {"start", OPT_TIME(v.d),
                                         .flags = M_OPT_ALLOW_NO},
                                       {"end", OPT_TIME(v.d),
@@ -6476,10 +6838,14 @@ void command_init(struct MPContext *mpctx)
 
     int num_base = MP_ARRAY_SIZE(mp_properties_base);
     int num_opts = m_config_get_co_count(mpctx->mconfig);
-    ctx->properties =
-        talloc_zero_array(ctx, struct m_property, num_base + num_opts + 1);
-    memcpy(ctx->properties, mp_properties_base, sizeof(mp_properties_base));
-
+    struct m_property_list *props = &ctx->properties;
+    props->props = talloc_zero_array(ctx, struct m_property, num_base + num_opts);
+    memcpy(props->props, mp_properties_base, sizeof(mp_properties_base));
+    props->num = num_base;
+    m_property_list_sort(props);
+
+    // Option properties are appended after the sorted base properties, and
+    // are only looked up in the base part while the list is being built.
     int count = num_base;
     for (int n = 0; n < num_opts; n++) {
         struct m_config_option *co = m_config_get_co_index(mpctx->mconfig, n);
@@ -6513,11 +6879,14 @@ void command_init(struct MPContext *mpctx)
         }
 
         // The option might be covered by a manual property already.
-        if (m_property_list_find(ctx->properties, prop.name))
+        if (m_property_list_find(props, prop.name))
             continue;
 
-        ctx->properties[count++] = prop;
+        props->props[count++] = prop;
     }
+
+    props->num = count;
+    m_property_list_sort(props);
 }
 
 static void command_event(struct MPContext *mpctx, int event, void *arg)
@@ -6640,11 +7009,29 @@ void mp_option_change_callback(void *ctx, struct m_config_option *co, int flags,
     if (flags & UPDATE_INPUT)
         mp_input_update_opts(mpctx->input);
 
+    if (init || opt_ptr == &opts->memory_budget)
+        mp_memory_set_budget(mpctx->global, opts->memory_budget);
+
+    if (init || opt_ptr == &opts->image_buffer_cache ||
+        opt_ptr == &opts->image_hugepages ||
+        opt_ptr == &opts->image_hugepages_threshold)
+    {
+        mp_image_buffer_cache_configure(mpctx->global, opts->image_buffer_cache,
+                                        opts->image_hugepages,
+                                        opts->image_hugepages_threshold);
+    }
+
     if (init || opt_ptr == &opts->ipc_path || opt_ptr == &opts->ipc_client) {
         mp_uninit_ipc(mpctx->ipc_ctx);
         mpctx->ipc_ctx = mp_init_ipc(mpctx->clients, mpctx->global);
     }
 
+    if (init || opt_ptr == &opts->telemetry_path)
+        mp_telemetry_reinit(mpctx);
+
+    if (init || opt_ptr == &opts->stats_trace)
+        stats_trace_enable(mpctx->global, opts->stats_trace);
+
     if (opt_ptr == &opts->vo->video_driver_list) {
         struct track *track = mpctx->current_track[0][STREAM_VIDEO];
         uninit_video_out(mpctx);
@@ -47,6 +47,7 @@
 
 #include "core.h"
 #include "command.h"
+#include "watch_later_store.h"
 
 static void load_all_cfgfiles(struct MPContext *mpctx, char *section,
                               char *filename)
@@ -166,6 +167,7 @@ void mp_load_auto_profiles(struct MPContext *mpctx)
 }
 
 #define MP_WATCH_LATER_CONF "watch_later"
+#define WATCH_LATER_STORE_FILE "resume.log"
 
 static bool check_mtime(const char *f1, const char *f2)
 {
@@ -193,8 +195,9 @@ static bool copy_mtime(const char *f1, const char *f2)
     return true;
 }
 
-static char *mp_get_playback_resume_config_filename(struct MPContext *mpctx,
-                                                    const char *fname)
+// Return the hash of the (absolute) filename, used to identify the entry.
+static char *get_resume_key(struct MPContext *mpctx, void *ta_parent,
+                            const char *fname)
 {
     struct MPOpts *opts = mpctx->opts;
     char *res = NULL;
@@ -213,10 +216,17 @@ static char *mp_get_playback_resume_config_filename(struct MPContext *mpctx,
     }
     uint8_t md5[16];
     av_md5_sum(md5, realpath, strlen(realpath));
-    char *conf = talloc_strdup(tmp, "");
+    res = talloc_strdup(ta_parent, "");
     for (int i = 0; i < 16; i++)
-        conf = talloc_asprintf_append(conf, "%02X", md5[i]);
+        res = talloc_asprintf_append(res, "%02X", md5[i]);
 
+exit:
+    talloc_free(tmp);
+    return res;
+}
+
+static char *get_watch_later_dir(struct MPContext *mpctx)
+{
     if (!mpctx->cached_watch_later_configdir) {
         char *wl_dir = mpctx->opts->watch_later_directory;
         if (wl_dir && wl_dir[0]) {
@@ -230,14 +240,45 @@ static char *mp_get_playback_resume_config_filename(struct MPContext *mpctx,
             mp_find_user_config_file(mpctx, mpctx->global, MP_WATCH_LATER_CONF);
     }
 
-    if (mpctx->cached_watch_later_configdir)
-        res = mp_path_join(NULL, mpctx->cached_watch_later_configdir, conf);
+    return mpctx->cached_watch_later_configdir;
+}
 
-exit:
-    talloc_free(tmp);
+static char *mp_get_playback_resume_config_filename(struct MPContext *mpctx,
+                                                    const char *fname)
+{
+    char *res = NULL;
+    char *conf = get_resume_key(mpctx, NULL, fname);
+    char *dir = get_watch_later_dir(mpctx);
+    if (conf && dir)
+        res = mp_path_join(NULL, dir, conf);
+    talloc_free(conf);
     return res;
 }
 
+// Return the single-file store if --watch-later-store=log is used.
+static struct watch_later_store *get_watch_later_store(struct MPContext *mpctx)
+{
+    if (!mpctx->opts->watch_later_store)
+        return NULL;
+    if (!mpctx->watch_later_store) {
+        char *dir = get_watch_later_dir(mpctx);
+        if (!dir)
+            return NULL;
+        char *path = mp_path_join(NULL, dir, WATCH_LATER_STORE_FILE);
+        mpctx->watch_later_store = watch_later_store_open(mpctx,
+                        mp_log_new(mpctx, mpctx->log, "watch_later"), path);
+        talloc_free(path);
+    }
+    return mpctx->watch_later_store;
+}
+
+void mp_close_watch_later_store(struct MPContext *mpctx)
+{
+    if (mpctx->watch_later_store)
+        watch_later_store_compact(mpctx->watch_later_store);
+    TA_FREEP(&mpctx->watch_later_store);
+}
+
 // Should follow what parser-cfg.c does/needs
 static bool needs_config_quoting(const char *s)
 {
@@ -251,57 +292,84 @@ static bool needs_config_quoting(const char *s)
     return false;
 }
 
-static void write_filename(struct MPContext *mpctx, FILE *file, char *filename)
+static void write_filename(struct MPContext *mpctx, char **data, char *filename)
 {
     if (mpctx->opts->write_filename_in_watch_later_config) {
         char write_name[1024] = {0};
         for (int n = 0; filename[n] && n < sizeof(write_name) - 1; n++)
             write_name[n] = (unsigned char)filename[n] < 32 ? '_' : filename[n];
-        fprintf(file, "# %s\n", write_name);
+        *data = talloc_asprintf_append(*data, "# %s\n", write_name);
     }
 }
 
-static void write_redirect(struct MPContext *mpctx, char *path)
+// Write the resume config data for the given media file.
+static void write_resume_data(struct MPContext *mpctx, char *path,
+                              const char *data)
 {
-    char *conffile = mp_get_playback_resume_config_filename(mpctx, path);
-    if (conffile) {
-        FILE *file = fopen(conffile, "wb");
-        if (file) {
-            fprintf(file, "# redirect entry\n");
-            write_filename(mpctx, file, path);
-            fclose(file);
+    bool check_mtime = mpctx->opts->position_check_mtime &&
+                       !mp_is_url(bstr0(path));
+
+    struct watch_later_store *store = get_watch_later_store(mpctx);
+    if (store) {
+        char *key = get_resume_key(mpctx, NULL, path);
+        struct stat st;
+        int64_t mtime = -1;
+        if (check_mtime) {
+            if (stat(path, &st) == 0) {
+                mtime = st.st_mtime;
+            } else {
+                MP_WARN(mpctx, "Can't get mtime of %s\n", path);
+            }
         }
+        if (key)
+            watch_later_store_put(store, key, data, mtime);
+        talloc_free(key);
+        return;
+    }
 
-        if (mpctx->opts->position_check_mtime &&
-            !mp_is_url(bstr0(path)) && !copy_mtime(path, conffile))
-            MP_WARN(mpctx, "Can't copy mtime from %s to %s\n", path, conffile);
+    char *conffile = mp_get_playback_resume_config_filename(mpctx, path);
+    if (!conffile)
+        return;
+
+    FILE *file = fopen(conffile, "wb");
+    if (file) {
+        fputs(data, file);
+        fclose(file);
 
-        talloc_free(conffile);
+        if (check_mtime && !copy_mtime(path, conffile))
+            MP_WARN(mpctx, "Can't copy mtime from %s to %s\n", path, conffile);
     }
+
+    talloc_free(conffile);
+}
+
+static void write_redirect(struct MPContext *mpctx, char *path)
+{
+    char *data = talloc_strdup(NULL, "# redirect entry\n");
+    write_filename(mpctx, &data, path);
+    write_resume_data(mpctx, path, data);
+    talloc_free(data);
 }
 
 void mp_write_watch_later_conf(struct MPContext *mpctx)
 {
     struct playlist_entry *cur = mpctx->playing;
-    char *conffile = NULL;
+    char *data = NULL;
     if (!cur)
         goto exit;
 
     struct demuxer *demux = mpctx->demuxer;
 
-    conffile = mp_get_playback_resume_config_filename(mpctx, cur->filename);
-    if (!conffile)
+    char *dir = get_watch_later_dir(mpctx);
+    if (!dir)
         goto exit;
 
-    mp_mk_config_dir(mpctx->global, mpctx->cached_watch_later_configdir);
+    mp_mk_config_dir(mpctx->global, dir);
 
     MP_INFO(mpctx, "Saving state.\n");
 
-    FILE *file = fopen(conffile, "wb");
-    if (!file)
-        goto exit;
-
-    write_filename(mpctx, file, cur->filename);
+    data = talloc_strdup(NULL, "");
+    write_filename(mpctx, &data, cur->filename);
 
     double pos = get_current_time(mpctx);
 
@@ -310,7 +378,7 @@ void mp_write_watch_later_conf(struct MPContext *mpctx)
     {
         MP_INFO(mpctx, "Not seekable, or time unknown - not saving position.\n");
     } else {
-        fprintf(file, "start=%f\n", pos);
+        data = talloc_asprintf_append(data, "start=%f\n", pos);
     }
     char **watch_later_options = mpctx->opts->watch_later_options;
     for (int i = 0; watch_later_options && watch_later_options[i]; i++) {
@@ -321,22 +389,15 @@ void mp_write_watch_later_conf(struct MPContext *mpctx)
             mp_property_do(pname, M_PROPERTY_GET_STRING, &val, mpctx);
             if (needs_config_quoting(val)) {
                 // e.g. '%6%STRING'
-                fprintf(file, "%s=%%%d%%%s\n", pname, (int)strlen(val), val);
+                data = talloc_asprintf_append(data, "%s=%%%d%%%s\n", pname,
+                                              (int)strlen(val), val);
             } else {
-                fprintf(file, "%s=%s\n", pname, val);
+                data = talloc_asprintf_append(data, "%s=%s\n", pname, val);
             }
             talloc_free(val);
         }
     }
-    fclose(file);
-
-    if (mpctx->opts->position_check_mtime &&
-        !mp_is_url(bstr0(cur->filename)) &&
-        !copy_mtime(cur->filename, conffile))
-    {
-        MP_WARN(mpctx, "Can't copy mtime from %s to %s\n", cur->filename,
-                conffile);
-    }
+    write_resume_data(mpctx, cur->filename, data);
 
     // This allows us to recursively resume directories etc., whose entries are
     // expanded the first time it's "played". For example, if "/a/b/c.mkv" is
@@ -370,7 +431,7 @@ void mp_write_watch_later_conf(struct MPContext *mpctx)
     }
 
 exit:
-    talloc_free(conffile);
+    talloc_free(data);
 }
 
 void mp_delete_watch_later_conf(struct MPContext *mpctx, const char *file)
@@ -384,16 +445,58 @@ void mp_delete_watch_later_conf(struct MPContext *mpctx, const char *file)
             return;
     }
 
+    struct watch_later_store *store = get_watch_later_store(mpctx);
+    if (store) {
+        char *key = get_resume_key(mpctx, NULL, file);
+        if (key && watch_later_store_has(store, key))
+            watch_later_store_put(store, key, NULL, -1);
+        talloc_free(key);
+        return;
+    }
+
     char *fname = mp_get_playback_resume_config_filename(mpctx, file);
     if (fname)
         unlink(fname);
     talloc_free(fname);
 }
 
+static void load_playback_resume_from_store(struct MPContext *mpctx,
+                                            struct watch_later_store *store,
+                                            const char *file)
+{
+    char *key = get_resume_key(mpctx, NULL, file);
+    int64_t mtime;
+    char *data = key ? watch_later_store_get(store, key, key, &mtime) : NULL;
+    if (data) {
+        struct stat st;
+        if (mpctx->opts->position_check_mtime && !mp_is_url(bstr0(file)) &&
+            (stat(file, &st) != 0 || st.st_mtime != mtime))
+        {
+            talloc_free(key);
+            return;
+        }
+
+        // Never apply the saved start position to following files
+        m_config_backup_opt(mpctx->mconfig, "start");
+        MP_INFO(mpctx, "Resuming playback. This behavior can "
+               "be disabled with --no-resume-playback.\n");
+        MP_VERBOSE(mpctx, "Loading watch later entry %s\n", key);
+        m_config_parse(mpctx->mconfig, key, bstr0(data), NULL,
+                       M_SETOPT_PRESERVE_CMDLINE);
+        watch_later_store_put(store, key, NULL, -1);
+    }
+    talloc_free(key);
+}
+
 void mp_load_playback_resume(struct MPContext *mpctx, const char *file)
 {
     if (!mpctx->opts->position_resume)
         return;
+    struct watch_later_store *store = get_watch_later_store(mpctx);
+    if (store) {
+        load_playback_resume_from_store(mpctx, store, file);
+        return;
+    }
     char *fname = mp_get_playback_resume_config_filename(mpctx, file);
     if (fname && mp_path_exists(fname)) {
         if (mpctx->opts->position_check_mtime &&
@@ -423,11 +526,20 @@ struct playlist_entry *mp_check_playlist_resume(struct MPContext *mpctx,
 {
     if (!mpctx->opts->position_resume)
         return NULL;
+    struct watch_later_store *store = get_watch_later_store(mpctx);
     for (int n = 0; n < playlist->num_entries; n++) {
         struct playlist_entry *e = playlist->entries[n];
-        char *conf = mp_get_playback_resume_config_filename(mpctx, e->filename);
-        bool exists = conf && mp_path_exists(conf);
-        talloc_free(conf);
+        bool exists;
+        if (store) {
+            char *key = get_resume_key(mpctx, NULL, e->filename);
+            exists = key && watch_later_store_has(store, key);
+            talloc_free(key);
+        } else {
+            char *conf = mp_get_playback_resume_config_filename(mpctx,
+                                                                e->filename);
+            exists = conf && mp_path_exists(conf);
+            talloc_free(conf);
+        }
         if (exists)
             return e;
     }
@@ -26,6 +26,7 @@
 #include "libmpv/client.h"
 
 #include "common/common.h"
+#include "demux/demux.h"
 #include "filters/filter.h"
 #include "filters/f_output_chain.h"
 #include "options/options.h"
@@ -83,8 +84,25 @@ enum seek_precision {
 enum seek_flags {
     MPSEEK_FLAG_DELAY = 1 << 0, // give player chance to coalesce multiple seeks
     MPSEEK_FLAG_NOFLUSH = 1 << 1, // keeping remaining data for seamless loops
+    MPSEEK_FLAG_SCRUB = 1 << 2, // show the target keyframe with minimal latency
 };
 
+// Why the playloop was woken up (mp_wakeup_core_reason()).
+enum mp_wakeup_reason {
+    MP_WAKEUP_OTHER     = 1 << 0, // anything not listed below
+    MP_WAKEUP_TIMEOUT   = 1 << 1, // mp_set_timeout() elapsed
+    MP_WAKEUP_INPUT     = 1 << 2, // input_ctx
+    MP_WAKEUP_CLIENT    = 1 << 3, // client API
+    MP_WAKEUP_VO        = 1 << 4, // VO (events, frame timing)
+    MP_WAKEUP_AO        = 1 << 5, // AO (events, underruns)
+    MP_WAKEUP_FILTER    = 1 << 6, // filter graph (decoders, AO queue)
+    MP_WAKEUP_DEMUX     = 1 << 7, // demuxer (new packets, cache state)
+};
+
+// Wakeups which only concern the playback data flow. Handlers for user
+// interaction can be skipped if nothing else woke up the playloop.
+#define MP_WAKEUP_DATA (MP_WAKEUP_AO | MP_WAKEUP_FILTER | MP_WAKEUP_DEMUX)
+
 struct seek_params {
     enum seek_type type;
     enum seek_precision exact;
@@ -92,6 +110,21 @@ struct seek_params {
     unsigned flags; // MPSEEK_FLAG_*
 };
 
+// Breakdown of the most recent seek (last-seek-timing property). All times
+// are in microseconds relative to "queued", or -1 if not reached (yet).
+struct seek_timing {
+    int64_t queued;         // mp_time_us() when the seek was first queued
+    int64_t executed;       // mp_seek() started (after coalescing/delays)
+    int64_t demux_done;     // demux_seek() returned
+    int64_t reset_done;     // decoders and outputs were reset
+    int64_t first_frame;    // first video frame after the seek was shown
+    int64_t restarted;      // playback restart
+    bool done;              // the fields below were filled on restart
+    struct demux_seek_timing demux;
+    int64_t vdec_flush, vdec_refill; // see mp_decoder_wrapper_get_reset_timing
+    int64_t adec_flush, adec_refill;
+};
+
 // Information about past video frames that have been sent to the VO.
 struct frame_info {
     double pts;
@@ -168,6 +201,10 @@ struct vo_chain {
 
     bool underrun;
     bool underrun_signaled;
+
+    // Filtered keyframes shown by scrub seeks, most recently used first.
+    struct mp_image *scrub_cache[8];
+    int num_scrub_cache;
 };
 
 // Like vo_chain, for audio.
@@ -243,7 +280,15 @@ typedef struct MPContext {
     // mp_dispatch_lock must be called to change it.
     int64_t outstanding_async;
 
+    // Pending MP_WAKEUP_* bits, set by mp_wakeup_core_reason().
+    atomic_uint wakeup_reasons_pending;
+    // MP_WAKEUP_* bits of the last mp_wait_events() (0 if it didn't sleep).
+    unsigned wakeup_reasons;
+
     struct mp_thread_pool *thread_pool; // for coarse I/O, often during loading
+    struct mp_dir_cache *dir_cache; // shared by autoloading and scripts
+    struct mp_image_cache *image_cache; // decoded cover art
+    struct mp_script_pool *script_pool; // for --script-threads
 
     struct mp_log *statusline;
     struct osd_state *osd;
@@ -269,6 +314,10 @@ typedef struct MPContext {
 
     struct playlist *playlist;
     struct playlist_entry *playing; // currently playing file
+    // Reads the rest of a playlist that was opened with --playlist-incremental.
+    // Its entries are inserted after playlist_loader_last (which is reserved).
+    struct playlist_loader *playlist_loader;
+    struct playlist_entry *playlist_loader_last;
     char *filename; // immutable copy of playing->filename (or NULL)
     char *stream_open_filename;
     enum stop_play_reason stop_play;
@@ -289,6 +338,8 @@ typedef struct MPContext {
 
     struct demux_chapter *chapters;
     int num_chapters;
+    // Set if chapters are not sorted by pts (only if set by the user).
+    bool chapters_unsorted;
 
     struct demuxer *demuxer;
     struct mp_tags *filtered_tags;
@@ -340,6 +391,10 @@ typedef struct MPContext {
     bool hrseek_lastframe;  // drop everything until last frame reached
     bool hrseek_backstep;   // go to frame before seek target
     double hrseek_pts;
+    bool scrubbing;         // current seek is a scrub seek (keyframes only)
+    bool scrub_resync;      // decoder still in keyframes-only mode after scrub
+    struct mp_image *scrub_frame; // cached frame to show for the scrub seek
+    double scrub_skip_pts;  // skip decoded frames up to this (scrub_frame)
     struct seek_params current_seek;
     bool ab_loop_clip;      // clip to the "b" part of an A-B loop if available
     // AV sync: the next frame should be shown when the audio out has this
@@ -360,6 +415,7 @@ typedef struct MPContext {
     double video_pts;
     // Last seek target.
     double last_seek_pts;
+    struct seek_timing seek_timing;
     // Frame duration field from demuxer. Only used for duration of the last
     // video frame.
     double last_frame_duration;
@@ -377,6 +433,7 @@ typedef struct MPContext {
 
     double last_idle_tick;
     double next_cache_update;
+    double next_hls_switch;     // for --hls-bitrate=auto
 
     double sleeptime;      // number of seconds to sleep before next iteration
 
@@ -423,12 +480,14 @@ typedef struct MPContext {
     struct mp_recorder *recorder;
 
     char *cached_watch_later_configdir;
+    struct watch_later_store *watch_later_store;
 
     struct screenshot_ctx *screenshot_ctx;
     struct command_ctx *command_ctx;
     struct encode_lavc_context *encode_lavc_ctx;
 
     struct mp_ipc_ctx *ipc_ctx;
+    struct mp_telemetry_ctx *telemetry;
 
     int64_t builtin_script_ids[5];
 
@@ -454,6 +513,14 @@ typedef struct MPContext {
     //     to true.
     struct demuxer *open_res_demuxer;
     int open_res_error;
+
+    // Video decoder created ahead of time for the prefetched file
+    // (--prefetch-playlist-decoder). Owned by MPContext. Used by
+    // init_video_decoder() if the same stream gets selected.
+    struct mp_decoder_wrapper *standby_vdec;
+    struct sh_stream *standby_vdec_stream;
+    struct mp_stream_info standby_vdec_info;
+    bool standby_vdec_tried;
 } MPContext;
 
 // Contains information about an asynchronous work item, how it can be aborted,
@@ -496,6 +563,7 @@ void mp_load_auto_profiles(struct MPContext *mpctx);
 void mp_load_playback_resume(struct MPContext *mpctx, const char *file);
 void mp_write_watch_later_conf(struct MPContext *mpctx);
 void mp_delete_watch_later_conf(struct MPContext *mpctx, const char *file);
+void mp_close_watch_later_store(struct MPContext *mpctx);
 struct playlist_entry *mp_check_playlist_resume(struct MPContext *mpctx,
                                                 struct playlist *playlist);
 
@@ -532,10 +600,14 @@ void print_track_list(struct MPContext *mpctx, const char *msg);
 void reselect_demux_stream(struct MPContext *mpctx, struct track *track,
                            bool refresh_only);
 void prepare_playlist(struct MPContext *mpctx, struct playlist *pl);
+void update_playlist_loader(struct MPContext *mpctx, bool wait);
+void uninit_playlist_loader(struct MPContext *mpctx);
 void autoload_external_files(struct MPContext *mpctx, struct mp_cancel *cancel);
 struct track *select_default_track(struct MPContext *mpctx, int order,
                                    enum stream_type type);
 void prefetch_next(struct MPContext *mpctx);
+void prefetch_video_decoder(struct MPContext *mpctx);
+void free_standby_decoder(struct MPContext *mpctx);
 void close_recorder(struct MPContext *mpctx);
 void close_recorder_and_error(struct MPContext *mpctx);
 void open_recorder(struct MPContext *mpctx, bool on_init);
@@ -560,6 +632,9 @@ void update_window_title(struct MPContext *mpctx, bool force);
 void error_on_track(struct MPContext *mpctx, struct track *track);
 int stream_dump(struct MPContext *mpctx, const char *source_filename);
 double get_track_seek_offset(struct MPContext *mpctx, struct track *track);
+void finish_startup_timeline(struct MPContext *mpctx);
+bool write_json_file(struct MPContext *mpctx, const char *file,
+                     struct mpv_node *node);
 
 // osd.c
 void set_osd_bar(struct MPContext *mpctx, int type,
@@ -575,7 +650,12 @@ void set_osd_bar_chapters(struct MPContext *mpctx, int type);
 void mp_wait_events(struct MPContext *mpctx);
 void mp_set_timeout(struct MPContext *mpctx, double sleeptime);
 void mp_wakeup_core(struct MPContext *mpctx);
+void mp_wakeup_core_reason(struct MPContext *mpctx, unsigned reason);
 void mp_wakeup_core_cb(void *ctx);
+void mp_wakeup_core_vo_cb(void *ctx);
+void mp_wakeup_core_ao_cb(void *ctx);
+void mp_wakeup_core_input_cb(void *ctx);
+void mp_wakeup_core_filter_cb(void *ctx);
 void mp_core_lock(struct MPContext *mpctx);
 void mp_core_unlock(struct MPContext *mpctx);
 double get_relative_time(struct MPContext *mpctx);
@@ -599,6 +679,7 @@ double chapter_start_time(struct MPContext *mpctx, int chapter);
 int get_chapter_count(struct MPContext *mpctx);
 int get_cache_buffering_percentage(struct MPContext *mpctx);
 void execute_queued_seek(struct MPContext *mpctx);
+void seek_timing_mark(struct MPContext *mpctx, int64_t *field);
 void run_playloop(struct MPContext *mpctx);
 void mp_idle(struct MPContext *mpctx);
 void idle_loop(struct MPContext *mpctx);
@@ -616,16 +697,28 @@ struct mp_script_args {
     struct mpv_handle *client;
     const char *filename;
     const char *path;
+    // If set, load() may return 1 after mp_script_task_create(); the task
+    // then owns the client and this struct.
+    struct mp_script_pool *pool;
+    // Directory for caching compiled scripts, NULL if disabled.
+    const char *cache_dir;
 };
 struct mp_scripting {
     const char *name;       // e.g. "lua script"
     const char *file_ext;   // e.g. "lua"
     bool no_thread;         // don't run load() on dedicated thread
+    bool tasks;             // can run as task with --script-threads
     int (*load)(struct mp_script_args *args);
 };
 bool mp_load_scripts(struct MPContext *mpctx);
 void mp_load_builtin_scripts(struct MPContext *mpctx);
 int64_t mp_load_user_script(struct MPContext *mpctx, const char *fname);
+struct mp_script_task;
+struct mp_script_task *mp_script_task_create(struct mp_script_args *args,
+        bool (*run)(struct mp_script_task *task, void *ctx),
+        void (*destroy)(void *ctx), void *ctx);
+void mp_script_task_set_timeout(struct mp_script_task *task, double timeout);
+void mp_script_pool_destroy(struct MPContext *mpctx);
 
 // sub.c
 void reset_subtitle_state(struct MPContext *mpctx);
@@ -636,10 +729,14 @@ void uninit_sub_all(struct MPContext *mpctx);
 void update_osd_msg(struct MPContext *mpctx);
 bool update_subtitles(struct MPContext *mpctx, double video_pts);
 
+// thumbnail.c
+void cmd_extract_thumbnails(void *p);
+
 // video.c
 int video_get_colors(struct vo_chain *vo_c, const char *item, int *value);
 int video_set_colors(struct vo_chain *vo_c, const char *item, int value);
 void reset_video_state(struct MPContext *mpctx);
+void video_start_scrub(struct MPContext *mpctx);
 int init_video_decoder(struct MPContext *mpctx, struct track *track);
 void reinit_video_chain(struct MPContext *mpctx);
 void reinit_video_chain_src(struct MPContext *mpctx, struct track *track);
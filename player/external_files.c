@@ -15,7 +15,6 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <dirent.h>
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
@@ -28,10 +27,27 @@
 #include "common/msg.h"
 #include "misc/ctype.h"
 #include "misc/charset_conv.h"
+#include "misc/dir_cache.h"
+#include "misc/thread_pool.h"
 #include "options/options.h"
 #include "options/path.h"
 #include "external_files.h"
 
+// Maximum number of directories scanned concurrently.
+#define MAX_DIR_SCAN_THREADS 8
+
+struct dir_scan {
+    // Set by the caller.
+    char *path;
+    int limit_fuzziness;
+    int limit_type;
+    struct mp_dir_cache *cache;
+    // Set by scan_dir(). num_entries is -1 if the directory could not be read.
+    struct mp_dir_entry *entries;
+    int num_entries;
+    bool from_cache;
+};
+
 static const char *const sub_exts[] = {"utf", "utf8", "utf-8", "idx", "sub",
                                        "srt", "rt", "ssa", "ass", "mks", "vtt",
                                        "sup", "scc", "smi", "lrc", "pgs",
@@ -153,11 +169,46 @@ static struct bstr guess_lang_from_filename(struct bstr name, int *fn_start)
     return (struct bstr){name.start + i + 1, n};
 }
 
+// Runs on a worker thread.
+static void scan_dir(void *p)
+{
+    struct dir_scan *s = p;
+
+    s->num_entries = -1;
+    if (mp_is_url(bstr0(s->path)))
+        return;
+
+    s->num_entries = mp_dir_cache_list(s->cache, s->path, s->path, false,
+                                       &s->entries, &s->from_cache);
+}
+
+// Scan all directories concurrently. The first one is run on the calling
+// thread, and freeing the pool waits for the rest.
+static void scan_dirs(struct dir_scan *scans, int num_scans)
+{
+    if (!num_scans)
+        return;
+
+    struct mp_thread_pool *pool = mp_thread_pool_create(NULL, 0, 0,
+        MPCLAMP(num_scans - 1, 1, MAX_DIR_SCAN_THREADS));
+    for (int n = 1; n < num_scans; n++) {
+        if (!mp_thread_pool_queue(pool, scan_dir, &scans[n]))
+            scan_dir(&scans[n]);
+    }
+    scan_dir(&scans[0]);
+    talloc_free(pool);
+}
+
 static void append_dir_subtitles(struct mpv_global *global, struct MPOpts *opts,
                                  struct subfn **slist, int *nsub,
-                                 struct bstr path, const char *fname,
-                                 int limit_fuzziness, int limit_type)
+                                 struct dir_scan *scan, const char *fname)
 {
+    int limit_fuzziness = scan->limit_fuzziness;
+    int limit_type = scan->limit_type;
+    if (scan->num_entries < 0)
+        return;
+    struct bstr path = bstr0(scan->path);
+
     void *tmpmem = talloc_new(NULL);
     struct mp_log *log = mp_log_new(tmpmem, global->log, "find_files");
 
@@ -171,19 +222,12 @@ static void append_dir_subtitles(struct mpv_global *global, struct MPOpts *opts,
     if (f_fbname.start != f_fname.start)
         talloc_steal(tmpmem, f_fname.start);
 
-    char *path0 = bstrdup0(tmpmem, path);
-
-    if (mp_is_url(bstr0(path0)))
-        goto out;
-
-    DIR *d = opendir(path0);
-    if (!d)
-        goto out;
-    mp_verbose(log, "Loading external files in %.*s\n", BSTR_P(path));
-    struct dirent *de;
-    while ((de = readdir(d))) {
+    mp_verbose(log, "Loading external files in %.*s%s\n", BSTR_P(path),
+               scan->from_cache ? " (cached)" : "");
+    for (int i = 0; i < scan->num_entries; i++) {
         void *tmpmem2 = talloc_new(tmpmem);
-        struct bstr den = bstr0(de->d_name);
+        const char *d_name = scan->entries[i].name;
+        struct bstr den = bstr0(d_name);
         struct bstr dename = mp_iconv_to_utf8(log, den,
                                               "UTF-8-MAC", MP_NO_LATIN1_FALLBACK);
         // retrieve various parts of the filename
@@ -255,7 +299,7 @@ static void append_dir_subtitles(struct mpv_global *global, struct MPOpts *opts,
             prio |= 1;
 
         mp_dbg(log, "Potential external file: \"%s\"  Priority: %d\n",
-               de->d_name, prio);
+               d_name, prio);
 
         if (prio) {
             char *subpath = mp_path_join_bstr(*slist, path, dename);
@@ -278,9 +322,7 @@ static void append_dir_subtitles(struct mpv_global *global, struct MPOpts *opts,
     next_sub:
         talloc_free(tmpmem2);
     }
-    closedir(d);
 
- out:
     talloc_free(tmpmem);
 }
 
@@ -311,51 +353,75 @@ static void filter_subidx(struct subfn **slist, int *nsub)
     }
 }
 
-static void load_paths(struct mpv_global *global, struct MPOpts *opts,
-                       struct subfn **slist, int *nsubs, const char *fname,
-                       char **paths, char *cfg_path, int type)
+static void add_scan(void *ta_parent, struct dir_scan **scans, int *num_scans,
+                     char *path, int limit_fuzziness, int limit_type)
+{
+    struct dir_scan s = {
+        .path = talloc_strdup(ta_parent, path),
+        .limit_fuzziness = limit_fuzziness,
+        .limit_type = limit_type,
+    };
+    MP_TARRAY_APPEND(ta_parent, *scans, *num_scans, s);
+}
+
+static void load_paths(struct mpv_global *global, void *ta_parent,
+                       struct dir_scan **scans, int *num_scans,
+                       const char *fname, char **paths, char *cfg_path,
+                       int type)
 {
     for (int i = 0; paths && paths[i]; i++) {
         char *expanded_path = mp_get_user_path(NULL, global, paths[i]);
         char *path = mp_path_join_bstr(
-            *slist, mp_dirname(fname),
+            ta_parent, mp_dirname(fname),
             bstr0(expanded_path ? expanded_path : paths[i]));
-        append_dir_subtitles(global, opts, slist, nsubs, bstr0(path),
-                             fname, 0, type);
+        add_scan(ta_parent, scans, num_scans, path, 0, type);
         talloc_free(expanded_path);
     }
 
     // Load subtitles in ~/.mpv/sub (or similar) limiting sub fuzziness
     char *mp_subdir = mp_find_config_file(NULL, global, cfg_path);
-    if (mp_subdir) {
-        append_dir_subtitles(global, opts, slist, nsubs, bstr0(mp_subdir),
-                             fname, 1, type);
-    }
+    if (mp_subdir)
+        add_scan(ta_parent, scans, num_scans, mp_subdir, 1, type);
     talloc_free(mp_subdir);
 }
 
 // Return a list of subtitles and audio files found, sorted by priority.
 // Last element is terminated with a fname==NULL entry.
+// If cache is not NULL, directory listings are reused from it and added to it.
 struct subfn *find_external_files(struct mpv_global *global, const char *fname,
-                                  struct MPOpts *opts)
+                                  struct MPOpts *opts,
+                                  struct mp_dir_cache *cache)
 {
-    struct subfn *slist = talloc_array_ptrtype(NULL, slist, 1);
-    int n = 0;
+    void *tmp = talloc_new(NULL);
+    struct dir_scan *scans = NULL;
+    int num_scans = 0;
 
     // Load subtitles from current media directory
-    append_dir_subtitles(global, opts, &slist, &n, mp_dirname(fname), fname, 0, -1);
+    add_scan(tmp, &scans, &num_scans, bstrto0(tmp, mp_dirname(fname)), 0, -1);
 
     // Load subtitles in dirs specified by sub-paths option
     if (opts->sub_auto >= 0) {
-        load_paths(global, opts, &slist, &n, fname, opts->sub_paths, "sub",
-                   STREAM_SUB);
+        load_paths(global, tmp, &scans, &num_scans, fname, opts->sub_paths,
+                   "sub", STREAM_SUB);
     }
 
     if (opts->audiofile_auto >= 0) {
-        load_paths(global, opts, &slist, &n, fname, opts->audiofile_paths,
-                   "audio", STREAM_AUDIO);
+        load_paths(global, tmp, &scans, &num_scans, fname,
+                   opts->audiofile_paths, "audio", STREAM_AUDIO);
     }
 
+    for (int i = 0; i < num_scans; i++)
+        scans[i].cache = cache;
+    scan_dirs(scans, num_scans);
+
+    struct subfn *slist = talloc_array_ptrtype(NULL, slist, 1);
+    int n = 0;
+
+    for (int i = 0; i < num_scans; i++)
+        append_dir_subtitles(global, opts, &slist, &n, &scans[i], fname);
+
+    talloc_free(tmp);
+
     // Sort by name for filter_subidx()
     qsort(slist, n, sizeof(*slist), compare_sub_filename);
 
@@ -29,8 +29,11 @@ struct subfn {
 
 struct mpv_global;
 struct MPOpts;
+struct mp_dir_cache;
+
 struct subfn *find_external_files(struct mpv_global *global, const char *fname,
-                                  struct MPOpts *opts);
+                                  struct MPOpts *opts,
+                                  struct mp_dir_cache *cache);
 
 bool mp_might_be_subtitle_file(const char *filename);
 
@@ -21,7 +21,6 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <dirent.h>
 #include <math.h>
 #include <stdint.h>
 
@@ -31,6 +30,7 @@
 #include "mpv_talloc.h"
 #include "common/common.h"
 #include "options/m_property.h"
+#include "common/memory.h"
 #include "common/msg.h"
 #include "common/msg_control.h"
 #include "common/stats.h"
@@ -38,6 +38,7 @@
 #include "input/input.h"
 #include "options/path.h"
 #include "misc/bstr.h"
+#include "misc/dir_cache.h"
 #include "osdep/timer.h"
 #include "osdep/threads.h"
 #include "stream/stream.h"
@@ -56,6 +57,9 @@ static const char *const builtin_files[][3] = {
     {0}
 };
 
+// Maximum number of events fetched with a single mpv_wait_events() call.
+#define EVENT_BATCH 32
+
 // Represents a loaded script. Each has its own js state.
 struct script_ctx {
     const char *filename;
@@ -66,6 +70,10 @@ struct script_ctx {
     char *last_error_str;
     size_t js_malloc_size;
     struct stats_ctx *stats;
+    struct mp_memory_user *mem; // heap size (updated when waiting for events)
+    // Events fetched by mpv_wait_events(), but not returned to the script yet.
+    mpv_event events[EVENT_BATCH];
+    int num_events, next_event;
 };
 
 static struct script_ctx *jctx(js_State *J)
@@ -232,8 +240,8 @@ static bool pushed_error(js_State *J, int err, int def)
 //  allocation happened, and then if af_TARGET threw then s_TARGET will catch
 //  it (and return 1) and we'll free if afterwards.
 
-// add_af_file, add_af_dir, add_af_mpv_alloc take a valid FILE*/DIR*/char* value
-// respectively, and fclose/closedir/mpv_free it when the parent is freed.
+// add_af_file, add_af_mpv_alloc take a valid FILE*/char* value respectively,
+// and fclose/mpv_free it when the parent is freed.
 
 static void destruct_af_file(void *p)
 {
@@ -247,18 +255,6 @@ static void add_af_file(void *parent, FILE *f)
     talloc_set_destructor(pf, destruct_af_file);
 }
 
-static void destruct_af_dir(void *p)
-{
-    closedir(*(DIR**)p);
-}
-
-static void add_af_dir(void *parent, DIR *d)
-{
-    DIR **pd = talloc(parent, DIR*);
-    *pd = d;
-    talloc_set_destructor(pd, destruct_af_dir);
-}
-
 static void destruct_af_mpv_alloc(void *p)
 {
     mpv_free(*(char**)p);
@@ -528,6 +524,7 @@ static int s_load_javascript(struct mp_script_args *args)
         .js_malloc_size = 0,
         .stats = stats_ctx_create(ctx, args->mpctx->global,
                     mp_tprintf(80, "script/%s", mpv_client_name(args->client))),
+        .mem = mp_memory_user_create(ctx, args->mpctx->global, "scripts"),
     };
 
     stats_register_thread_cputime(ctx->stats, "cpu");
@@ -741,7 +738,7 @@ static void script_get_property_osd(js_State *J, void *af)
         js_pushstring(J, res);
 }
 
-// args: id, name, type
+// args: id, name, type, interval
 static void script__observe_property(js_State *J)
 {
     const char *fmts[] = {"none", "native", "bool", "string", "number", NULL};
@@ -749,9 +746,9 @@ static void script__observe_property(js_State *J)
                              MPV_FORMAT_STRING, MPV_FORMAT_DOUBLE};
 
     mpv_format f = mf[checkopt(J, 3, "none", fmts, "observe type")];
-    int e = mpv_observe_property(jclient(J), jsL_checkuint64(J, 1),
-                                             js_tostring(J, 2),
-                                             f);
+    double interval = js_isundefined(J, 4) ? 0 : js_tonumber(J, 4);
+    int e = mpv_observe_property_interval(jclient(J), jsL_checkuint64(J, 1),
+                                          js_tostring(J, 2), f, interval);
     push_status(J, e);
 }
 
@@ -860,30 +857,23 @@ static void script_readdir(js_State *J, void *af)
     const char *path = js_isundefined(J, 1) ? "." : js_tostring(J, 1);
     int t = checkopt(J, 2, "normal", filters, "listing filter");
 
-    DIR *dir = opendir(path);
-    if (!dir) {
+    struct mp_dir_entry *entries;
+    int num = mp_dir_cache_list(jctx(J)->mpctx->dir_cache, af, path, t,
+                                &entries, NULL);
+    if (num < 0) {
         push_failure(J, "Cannot open dir");
         return;
     }
-    add_af_dir(af, dir);
     set_last_error(jctx(J), 0, NULL);
     js_newarray(J);  // the return value
-    char *fullpath = talloc_strdup(af, "");
-    struct dirent *e;
     int n = 0;
-    while ((e = readdir(dir))) {
-        char *name = e->d_name;
+    for (int i = 0; i < num; i++) {
+        char *name = entries[i].name;
         if (t) {
             if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
                 continue;
-            if (fullpath)
-                fullpath[0] = '\0';
-            fullpath = talloc_asprintf_append(fullpath, "%s/%s", path, name);
-            struct stat st;
-            if (stat(fullpath, &st))
-                continue;
-            if (!(((t & 1) && S_ISREG(st.st_mode)) ||
-                  ((t & 2) && S_ISDIR(st.st_mode))))
+            if (!(((t & 1) && entries[i].type == MP_DIR_ENTRY_FILE) ||
+                  ((t & 2) && entries[i].type == MP_DIR_ENTRY_DIR)))
             {
                 continue;
             }
@@ -1139,8 +1129,20 @@ static void makenode(void *ta_ctx, mpv_node *dst, js_State *J, int idx)
 // args: wait in secs (infinite if negative) if mpv doesn't send events earlier.
 static void script_wait_event(js_State *J, void *af)
 {
+    struct script_ctx *ctx = jctx(J);
     double timeout = js_isnumber(J, 1) ? js_tonumber(J, 1) : -1;
-    mpv_event *event = mpv_wait_event(jclient(J), timeout);
+
+    if (ctx->next_event >= ctx->num_events) {
+        mp_memory_report(ctx->mem, ctx->js_malloc_size);
+        ctx->num_events = mpv_wait_events(ctx->client, timeout, ctx->events,
+                                          EVENT_BATCH);
+        ctx->next_event = 0;
+    }
+
+    mpv_event none = {0};
+    mpv_event *event = &none;
+    if (ctx->next_event < ctx->num_events)
+        event = &ctx->events[ctx->next_event++];
 
     mpv_node *rn = new_af_mpv_node(af);
     mpv_event_to_node(rn, event);
@@ -1180,7 +1182,7 @@ static const struct fn_entry main_fns[] = {
     FN_ENTRY(set_property_bool, 2),
     FN_ENTRY(set_property_number, 2),
     AF_ENTRY(set_property_native, 2),
-    FN_ENTRY(_observe_property, 3),
+    FN_ENTRY(_observe_property, 4),
     FN_ENTRY(_unobserve_property, 1),
     FN_ENTRY(get_time_ms, 0),
     AF_ENTRY(format_time, 2),
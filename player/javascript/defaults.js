@@ -83,10 +83,11 @@ function notify_idle_observers() {
 var next_oid = 1,
     observers = new_cache();  // items of id: fn
 
-mp.observe_property = function(name, format, fn) {
+mp.observe_property = function(name, format, fn, interval) {
     var id = next_oid++;
     observers[id] = fn;
-    return mp._observe_property(id, name, format || undefined);  // allow null
+    return mp._observe_property(id, name, format || undefined,  // allow null
+                                interval);
 }
 
 mp.unobserve_property = function(fn) {
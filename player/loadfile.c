@@ -20,6 +20,7 @@
 #include <strings.h>
 #include <inttypes.h>
 #include <assert.h>
+#include <limits.h>
 
 #include <libavutil/avutil.h>
 
@@ -67,7 +68,7 @@
 static void wakeup_demux(void *pctx)
 {
     struct MPContext *mpctx = pctx;
-    mp_wakeup_core(mpctx);
+    mp_wakeup_core_reason(mpctx, MP_WAKEUP_DEMUX);
 }
 
 // Called by foreign threads when playback should be stopped and such.
@@ -193,6 +194,10 @@ static void kill_demuxers_reentrant(struct MPContext *mpctx,
 
 static void uninit_demuxer(struct MPContext *mpctx)
 {
+    // Otherwise it belongs to the prefetched file, not this one.
+    if (!mpctx->open_res_demuxer)
+        free_standby_decoder(mpctx);
+
     for (int t = 0; t < STREAM_TYPE_COUNT; t++) {
         for (int r = 0; r < num_ptracks[t]; r++)
             mpctx->current_track[r][t] = NULL;
@@ -201,6 +206,7 @@ static void uninit_demuxer(struct MPContext *mpctx)
     talloc_free(mpctx->chapters);
     mpctx->chapters = NULL;
     mpctx->num_chapters = 0;
+    mpctx->chapters_unsorted = false;
 
     mp_abort_cache_dumping(mpctx);
 
@@ -494,11 +500,14 @@ static bool compare_track(struct track *t1, struct track *t2, char **langs,
         return t1->default_track;
     if (t1->attached_picture != t2->attached_picture)
         return !t1->attached_picture;
-    if (t1->stream && t2->stream && opts->hls_bitrate >= 0 &&
+    // With "auto", start with the lowest bitrate; update_hls_variants()
+    // switches up once the input rate is known.
+    int hls_bitrate = opts->hls_bitrate == -2 ? 0 : opts->hls_bitrate;
+    if (t1->stream && t2->stream && hls_bitrate >= 0 &&
         t1->stream->hls_bitrate != t2->stream->hls_bitrate)
     {
-        bool t1_ok = t1->stream->hls_bitrate <= opts->hls_bitrate;
-        bool t2_ok = t2->stream->hls_bitrate <= opts->hls_bitrate;
+        bool t1_ok = t1->stream->hls_bitrate <= hls_bitrate;
+        bool t2_ok = t2->stream->hls_bitrate <= hls_bitrate;
         if (t1_ok != t2_ok)
             return t1_ok;
         if (t1_ok && t2_ok)
@@ -757,46 +766,84 @@ bool mp_remove_track(struct MPContext *mpctx, struct track *track)
     return true;
 }
 
-// Add the given file as additional track. The filter argument controls how or
-// if tracks are auto-selected at any point.
-// To be run on a worker thread, locked (temporarily unlocks core).
-// cancel will generally be used to abort the loading process, but on success
-// the demuxer is changed to be slaved to mpctx->playback_abort instead.
-int mp_add_external_file(struct MPContext *mpctx, char *filename,
-                         enum stream_type filter, struct mp_cancel *cancel,
-                         bool cover_art)
+// Maximum number of external files opened concurrently.
+#define MAX_EXTERNAL_OPEN_THREADS 8
+
+// An external file to be opened, and its result. The demuxer is opened without
+// holding the core lock, possibly concurrently with other files.
+struct external_file {
+    char *filename;
+    enum stream_type filter;
+    bool cover_art;
+    char *lang;                     // set on tracks without language, or NULL
+    struct mpv_global *global;
+    struct mp_cancel *cancel;
+    struct demuxer_params params;
+    struct demuxer *demuxer;        // result of opening the file
+    int first_num;                  // result of add_external_demuxer()
+    int end_num;                    // mpctx->num_tracks after adding it
+};
+
+// Locked.
+static void init_external_file(struct MPContext *mpctx, void *ta_parent,
+                               struct external_file *f, char *filename,
+                               enum stream_type filter,
+                               struct mp_cancel *cancel, bool cover_art)
 {
     struct MPOpts *opts = mpctx->opts;
-    if (!filename || mp_cancel_test(cancel))
-        return -1;
 
-    char *disp_filename = filename;
-    if (strncmp(disp_filename, "memory://", 9) == 0)
-        disp_filename = "memory://"; // avoid noise
-
-    struct demuxer_params params = {
-        .is_top_level = true,
-        .stream_flags = STREAM_ORIGIN_DIRECT,
+    *f = (struct external_file){
+        .filename = talloc_strdup(ta_parent, filename),
+        .filter = filter,
+        .cover_art = cover_art,
+        .global = mpctx->global,
+        .cancel = cancel,
+        .params = {
+            .is_top_level = true,
+            .stream_flags = STREAM_ORIGIN_DIRECT,
+        },
+        .first_num = -1,
     };
 
     switch (filter) {
     case STREAM_SUB:
-        params.force_format = opts->sub_demuxer_name;
+        f->params.force_format = talloc_strdup(ta_parent, opts->sub_demuxer_name);
         break;
     case STREAM_AUDIO:
-        params.force_format = opts->audio_demuxer_name;
+        f->params.force_format = talloc_strdup(ta_parent, opts->audio_demuxer_name);
         break;
     }
+}
 
-    mp_core_unlock(mpctx);
+// Unlocked; can be run on any thread.
+static void open_external_demuxer(void *p)
+{
+    struct external_file *f = p;
+
+    if (f->filename && !mp_cancel_test(f->cancel))
+        f->demuxer = demux_open_url(f->filename, &f->params, f->cancel, f->global);
+}
+
+// Locked. Add the tracks of the opened demuxer (takes over f->demuxer).
+static int add_external_demuxer(struct MPContext *mpctx, struct external_file *f)
+{
+    struct MPOpts *opts = mpctx->opts;
+    struct demuxer *demuxer = f->demuxer;
+    enum stream_type filter = f->filter;
+    char *filename = f->filename;
+
+    f->demuxer = NULL;
+
+    if (!filename)
+        return -1;
+
+    char *disp_filename = filename;
+    if (strncmp(disp_filename, "memory://", 9) == 0)
+        disp_filename = "memory://"; // avoid noise
 
-    struct demuxer *demuxer =
-        demux_open_url(filename, &params, cancel, mpctx->global);
     if (demuxer)
         enable_demux_thread(mpctx, demuxer);
 
-    mp_core_lock(mpctx);
-
     // The command could have overlapped with playback exiting. (We don't care
     // if playback has started again meanwhile - weird, but not a problem.)
     if (mpctx->stop_play)
@@ -839,7 +886,7 @@ int mp_add_external_file(struct MPContext *mpctx, char *filename,
         t->no_default = sh->type != filter;
         t->no_auto_select = t->no_default;
         // if we found video, and we are loading cover art, flag as such.
-        t->attached_picture = t->type == STREAM_VIDEO && cover_art;
+        t->attached_picture = t->type == STREAM_VIDEO && f->cover_art;
         if (first_num < 0 && (filter == STREAM_TYPE_COUNT || sh->type == filter))
             first_num = mpctx->num_tracks - 1;
     }
@@ -850,23 +897,99 @@ int mp_add_external_file(struct MPContext *mpctx, char *filename,
 
 err_out:
     demux_cancel_and_free(demuxer);
-    if (!mp_cancel_test(cancel))
+    if (!mp_cancel_test(f->cancel))
         MP_ERR(mpctx, "Can not open external file %s.\n", disp_filename);
     return -1;
 }
 
-// to be run on a worker thread, locked (temporarily unlocks core)
-static void open_external_files(struct MPContext *mpctx, char **files,
-                                enum stream_type filter)
+// Add the given file as additional track. The filter argument controls how or
+// if tracks are auto-selected at any point.
+// To be run on a worker thread, locked (temporarily unlocks core).
+// cancel will generally be used to abort the loading process, but on success
+// the demuxer is changed to be slaved to mpctx->playback_abort instead.
+int mp_add_external_file(struct MPContext *mpctx, char *filename,
+                         enum stream_type filter, struct mp_cancel *cancel,
+                         bool cover_art)
 {
-    // Need a copy, because the option value could be mutated during iteration.
+    if (!filename || mp_cancel_test(cancel))
+        return -1;
+
     void *tmp = talloc_new(NULL);
-    files = mp_dup_str_array(tmp, files);
+    struct external_file f;
+    init_external_file(mpctx, tmp, &f, filename, filter, cancel, cover_art);
 
-    for (int n = 0; files && files[n]; n++)
+    mp_core_unlock(mpctx);
+    open_external_demuxer(&f);
+    mp_core_lock(mpctx);
+
+    int first_num = add_external_demuxer(mpctx, &f);
+    talloc_free(tmp);
+    return first_num;
+}
+
+// Open all given files concurrently, and then add their tracks in list order
+// (so track IDs are the same as when opening them one by one). Sets
+// files[n].first_num like mp_add_external_file() returns it.
+// To be run on a worker thread, locked (temporarily unlocks core).
+static void add_external_files(struct MPContext *mpctx,
+                               struct external_file *files, int num_files)
+{
+    if (!num_files)
+        return;
+
+    mp_core_unlock(mpctx);
+
+    // Run the first file on this thread. Freeing the pool waits for the rest.
+    struct mp_thread_pool *pool = mp_thread_pool_create(NULL, 0, 0,
+        MPCLAMP(num_files - 1, 1, MAX_EXTERNAL_OPEN_THREADS));
+    for (int n = 1; n < num_files; n++) {
+        if (!mp_thread_pool_queue(pool, open_external_demuxer, &files[n]))
+            open_external_demuxer(&files[n]);
+    }
+    open_external_demuxer(&files[0]);
+    talloc_free(pool);
+
+    mp_core_lock(mpctx);
+
+    for (int n = 0; n < num_files; n++) {
+        files[n].first_num = add_external_demuxer(mpctx, &files[n]);
+        files[n].end_num = mpctx->num_tracks;
+    }
+}
+
+// Locked.
+static void append_external_files(struct MPContext *mpctx, void *ta_parent,
+                                  struct external_file **list, int *num,
+                                  char **files, enum stream_type filter)
+{
+    for (int n = 0; files && files[n]; n++) {
+        struct external_file f;
         // when given filter is set to video, we are loading up cover art
-        mp_add_external_file(mpctx, files[n], filter, mpctx->playback_abort,
-                             filter == STREAM_VIDEO);
+        init_external_file(mpctx, ta_parent, &f, files[n], filter,
+                           mpctx->playback_abort, filter == STREAM_VIDEO);
+        MP_TARRAY_APPEND(ta_parent, *list, *num, f);
+    }
+}
+
+// to be run on a worker thread, locked (temporarily unlocks core)
+static void open_external_files(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+    void *tmp = talloc_new(NULL);
+    struct external_file *list = NULL;
+    int num = 0;
+
+    // (Copies the filenames, because the options could be mutated while the
+    // core is unlocked.)
+    append_external_files(mpctx, tmp, &list, &num, opts->audio_files,
+                          STREAM_AUDIO);
+    append_external_files(mpctx, tmp, &list, &num, opts->sub_name, STREAM_SUB);
+    append_external_files(mpctx, tmp, &list, &num, opts->coverart_files,
+                          STREAM_VIDEO);
+    append_external_files(mpctx, tmp, &list, &num, opts->external_files,
+                          STREAM_TYPE_COUNT);
+
+    add_external_files(mpctx, list, num);
 
     talloc_free(tmp);
 }
@@ -882,7 +1005,8 @@ void autoload_external_files(struct MPContext *mpctx, struct mp_cancel *cancel)
         return;
 
     void *tmp = talloc_new(NULL);
-    struct subfn *list = find_external_files(mpctx->global, mpctx->filename, opts);
+    struct subfn *list = find_external_files(mpctx->global, mpctx->filename,
+                                             opts, mpctx->dir_cache);
     talloc_steal(tmp, list);
 
     int sc[STREAM_TYPE_COUNT] = {0};
@@ -891,6 +1015,9 @@ void autoload_external_files(struct MPContext *mpctx, struct mp_cancel *cancel)
             sc[mpctx->tracks[n]->type]++;
     }
 
+    struct external_file *files = NULL;
+    int num_files = 0;
+
     for (int i = 0; list && list[i].fname; i++) {
         struct subfn *e = &list[i];
 
@@ -899,6 +1026,10 @@ void autoload_external_files(struct MPContext *mpctx, struct mp_cancel *cancel)
             if (t->demuxer && strcmp(t->demuxer->filename, e->fname) == 0)
                 goto skip;
         }
+        for (int n = 0; n < num_files; n++) {
+            if (strcmp(files[n].filename, e->fname) == 0)
+                goto skip;
+        }
         if (e->type == STREAM_SUB && !sc[STREAM_VIDEO] && !sc[STREAM_AUDIO])
             goto skip;
         if (e->type == STREAM_AUDIO && !sc[STREAM_VIDEO])
@@ -907,18 +1038,27 @@ void autoload_external_files(struct MPContext *mpctx, struct mp_cancel *cancel)
             goto skip;
 
         // when given filter is set to video, we are loading up cover art
-        int first = mp_add_external_file(mpctx, e->fname, e->type, cancel,
-                                         e->type == STREAM_VIDEO);
-        if (first < 0)
-            goto skip;
+        struct external_file f;
+        init_external_file(mpctx, tmp, &f, e->fname, e->type, cancel,
+                           e->type == STREAM_VIDEO);
+        f.lang = e->lang;
+        MP_TARRAY_APPEND(tmp, files, num_files, f);
+    skip:;
+    }
+
+    add_external_files(mpctx, files, num_files);
+
+    for (int i = 0; i < num_files; i++) {
+        struct external_file *f = &files[i];
+        if (f->first_num < 0)
+            continue;
 
-        for (int n = first; n < mpctx->num_tracks; n++) {
+        for (int n = f->first_num; n < f->end_num; n++) {
             struct track *t = mpctx->tracks[n];
             t->auto_loaded = true;
             if (!t->lang)
-                t->lang = talloc_strdup(t, e->lang);
+                t->lang = talloc_strdup(t, f->lang);
         }
-    skip:;
     }
 
     talloc_free(tmp);
@@ -948,23 +1088,125 @@ void prepare_playlist(struct MPContext *mpctx, struct playlist *pl)
         pl->current = playlist_get_first(pl);
 }
 
+// Number of entries that are added from mpctx->playlist_loader in advance.
+#define PLAYLIST_LOADER_AHEAD 100
+
+static void set_playlist_loader_last(struct MPContext *mpctx,
+                                     struct playlist_entry *e)
+{
+    if (e)
+        e->reserved++;
+    if (mpctx->playlist_loader_last)
+        playlist_entry_unref(mpctx->playlist_loader_last);
+    mpctx->playlist_loader_last = e;
+}
+
+void uninit_playlist_loader(struct MPContext *mpctx)
+{
+    TA_FREEP(&mpctx->playlist_loader);
+    set_playlist_loader_last(mpctx, NULL);
+}
+
+static void wakeup_playlist_loader(void *ctx)
+{
+    mp_wakeup_core(ctx);
+}
+
+// Insert up to max entries from the loader after the last entry it added.
+static void fetch_playlist_loader(struct MPContext *mpctx, int max)
+{
+    struct playlist *tmp = talloc_zero(NULL, struct playlist);
+    playlist_loader_fetch(mpctx->playlist_loader, tmp, max);
+    struct playlist_entry *last = playlist_get_last(tmp);
+    if (last) {
+        int index = playlist_entry_to_index(mpctx->playlist,
+                                            mpctx->playlist_loader_last) + 1;
+        playlist_insert_entries(mpctx->playlist, index, tmp);
+        set_playlist_loader_last(mpctx, last);
+        mp_notify(mpctx, MP_EVENT_CHANGE_PLAYLIST, NULL);
+    }
+    talloc_free(tmp);
+}
+
+// Add entries from the playlist loader (if any). This is done lazily, when
+// the current entry gets close to the last entry added by the loader. If wait
+// is set, and the current entry is the last added entry, block until the next
+// entry is available (or the loader is done).
+void update_playlist_loader(struct MPContext *mpctx, bool wait)
+{
+    struct playlist_loader *loader = mpctx->playlist_loader;
+    if (!loader)
+        return;
+
+    struct playlist_entry *last = mpctx->playlist_loader_last;
+    if (last->pl != mpctx->playlist) {
+        // Last entry was removed, so there's no place to add the rest.
+        MP_VERBOSE(mpctx, "Dropping the rest of the incremental playlist.\n");
+        uninit_playlist_loader(mpctx);
+        return;
+    }
+
+    struct playlist *pl = mpctx->playlist;
+    struct playlist_entry *cur = pl->current;
+    if (cur && playlist_entry_to_index(pl, cur) + PLAYLIST_LOADER_AHEAD >
+               playlist_entry_to_index(pl, last))
+    {
+        if (wait && cur == last)
+            playlist_loader_wait(loader);
+        fetch_playlist_loader(mpctx, PLAYLIST_LOADER_AHEAD);
+    }
+
+    if (playlist_loader_is_done(loader))
+        uninit_playlist_loader(mpctx);
+}
+
 // Replace the current playlist entry with playlist contents. Moves the entries
 // from the given playlist pl, so the entries don't actually need to be copied.
 static void transfer_playlist(struct MPContext *mpctx, struct playlist *pl,
                               int64_t *start_id, int *num_new_entries)
 {
+    struct MPOpts *opts = mpctx->opts;
+
+    if (pl->loader && (opts->shuffle || opts->merge_files ||
+                       opts->playlist_pos >= 0))
+    {
+        // These need the complete playlist.
+        while (playlist_loader_wait(pl->loader))
+            playlist_loader_fetch(pl->loader, pl, INT_MAX);
+        TA_FREEP(&pl->loader);
+    }
+
     if (pl->num_entries) {
         prepare_playlist(mpctx, pl);
         struct playlist_entry *new = pl->current;
+        struct playlist_entry *last = playlist_get_last(pl);
         if (mpctx->playlist->current)
             playlist_add_redirect(pl, mpctx->playlist->current->filename);
+        if (pl->loader && mpctx->playlist_loader) {
+            // Only one loader at a time. The new entries are inserted before
+            // the entries of the old loader, so its order is preserved.
+            while (mpctx->playlist_loader_last->pl == mpctx->playlist &&
+                   playlist_loader_wait(mpctx->playlist_loader))
+                fetch_playlist_loader(mpctx, INT_MAX);
+            uninit_playlist_loader(mpctx);
+        }
         *num_new_entries = pl->num_entries;
         *start_id = playlist_transfer_entries(mpctx->playlist, pl);
         // current entry is replaced
-        if (mpctx->playlist->current)
+        if (mpctx->playlist->current) {
+            if (mpctx->playlist_loader_last == mpctx->playlist->current)
+                set_playlist_loader_last(mpctx, last);
             playlist_remove(mpctx->playlist, mpctx->playlist->current);
+        }
         if (new)
             mpctx->playlist->current = new;
+        if (pl->loader) {
+            mpctx->playlist_loader = talloc_steal(mpctx, pl->loader);
+            pl->loader = NULL;
+            playlist_loader_set_wakeup_cb(mpctx->playlist_loader,
+                                          wakeup_playlist_loader, mpctx);
+            set_playlist_loader_last(mpctx, last);
+        }
     } else {
         MP_WARN(mpctx, "Empty playlist!\n");
     }
@@ -1010,6 +1252,7 @@ static void load_chapters(struct MPContext *mpctx)
         talloc_free(mpctx->chapters);
         mpctx->num_chapters = src->num_chapters;
         mpctx->chapters = demux_copy_chapter_data(src->chapters, src->num_chapters);
+        mpctx->chapters_unsorted = false; // demuxers sort them
         if (mpctx->opts->rebase_start_time) {
             for (int n = 0; n < mpctx->num_chapters; n++)
                 mpctx->chapters[n].pts -= src->start_time;
@@ -1037,12 +1280,14 @@ static void *open_demux_thread(void *ctx)
 
     struct demuxer_params p = {
         .force_format = mpctx->open_format,
-        .stream_flags = mpctx->open_url_flags,
+        .stream_flags = mpctx->open_url_flags | STREAM_SHARE,
         .stream_record = true,
         .is_top_level = true,
     };
+    stats_startup_begin(mpctx->global, "open-demuxer");
     struct demuxer *demux =
         demux_open_url(mpctx->open_url, &p, mpctx->open_cancel, mpctx->global);
+    stats_startup_end(mpctx->global, "open-demuxer");
     mpctx->open_res_demuxer = demux;
 
     if (demux) {
@@ -1083,9 +1328,12 @@ static void cancel_open(struct MPContext *mpctx)
         pthread_join(mpctx->open_thread, NULL);
     mpctx->open_active = false;
 
-    if (mpctx->open_res_demuxer)
+    if (mpctx->open_res_demuxer) {
+        free_standby_decoder(mpctx);
         demux_cancel_and_free(mpctx->open_res_demuxer);
+    }
     mpctx->open_res_demuxer = NULL;
+    mpctx->standby_vdec_tried = false;
 
     TA_FREEP(&mpctx->open_cancel);
     TA_FREEP(&mpctx->open_url);
@@ -1167,6 +1415,64 @@ static void open_demux_reentrant(struct MPContext *mpctx)
     cancel_open(mpctx); // cleanup
 }
 
+void free_standby_decoder(struct MPContext *mpctx)
+{
+    if (mpctx->standby_vdec)
+        MP_VERBOSE(mpctx, "Dropping prefetched video decoder.\n");
+    mp_decoder_wrapper_free_standby(mpctx->standby_vdec);
+    mpctx->standby_vdec = NULL;
+    mpctx->standby_vdec_stream = NULL;
+}
+
+// Once the prefetched file is opened, start decoding its first video frame.
+// The stream is guessed, because track selection needs the file's tracks and
+// options; init_video_decoder() uses the decoder only if the guess was right.
+void prefetch_video_decoder(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = mpctx->opts;
+
+    if (!opts->prefetch_decoder || mpctx->standby_vdec_tried ||
+        !mpctx->open_active || !mpctx->open_for_prefetch ||
+        !atomic_load(&mpctx->open_done) || !mpctx->open_res_demuxer)
+        return;
+    mpctx->standby_vdec_tried = true;
+
+    // Needs the VO's hwdec and DR interfaces, which must not change before
+    // the decoder is used.
+    if (!mpctx->video_out || mpctx->encode_lavc_ctx || opts->play_dir < 0 ||
+        (opts->lavfi_complex && opts->lavfi_complex[0]) ||
+        !opts->stream_auto_sel)
+        return;
+
+    struct demuxer *demux = mpctx->open_res_demuxer;
+    struct sh_stream *sh = NULL;
+    int num_streams = demux_get_num_stream(demux);
+    for (int n = 0; n < num_streams; n++) {
+        struct sh_stream *s = demux_get_stream(demux, n);
+        if (s->type != STREAM_VIDEO || s->attached_picture || s->image)
+            continue;
+        if (!sh || (s->default_track && !sh->default_track))
+            sh = s;
+    }
+    if (!sh)
+        return;
+
+    // Packets read now must have the same timestamps as during playback.
+    if (opts->rebase_start_time)
+        demux_set_ts_offset(demux, -demux->start_time);
+
+    mpctx->standby_vdec_info = (struct mp_stream_info){
+        .hwdec_devs = mpctx->video_out->hwdec_devs,
+        .dr_vo = mpctx->video_out,
+    };
+    mpctx->standby_vdec = mp_decoder_wrapper_create_standby(mpctx->global, sh,
+                                                &mpctx->standby_vdec_info);
+    if (mpctx->standby_vdec) {
+        mpctx->standby_vdec_stream = sh;
+        MP_VERBOSE(mpctx, "Prefetching video decoder.\n");
+    }
+}
+
 void prefetch_next(struct MPContext *mpctx)
 {
     if (!mpctx->opts->prefetch_open)
@@ -1382,12 +1688,11 @@ static void load_external_opts_thread(void *p)
 
     mp_core_lock(mpctx);
 
+    stats_startup_begin(mpctx->global, "external-files");
     load_chapters(mpctx);
-    open_external_files(mpctx, mpctx->opts->audio_files, STREAM_AUDIO);
-    open_external_files(mpctx, mpctx->opts->sub_name, STREAM_SUB);
-    open_external_files(mpctx, mpctx->opts->coverart_files, STREAM_VIDEO);
-    open_external_files(mpctx, mpctx->opts->external_files, STREAM_TYPE_COUNT);
+    open_external_files(mpctx);
     autoload_external_files(mpctx, mpctx->playback_abort);
+    stats_startup_end(mpctx->global, "external-files");
 
     mp_waiter_wakeup(waiter, 0);
     mp_wakeup_core(mpctx);
@@ -1446,6 +1751,7 @@ static void play_current_file(struct MPContext *mpctx)
     mpctx->last_chapter_seek = -2;
     mpctx->last_chapter_pts = MP_NOPTS_VALUE;
     mpctx->last_chapter = -2;
+    mpctx->next_hls_switch = 0;
     mpctx->paused = false;
     mpctx->playing_msg_shown = false;
     mpctx->max_frames = -1;
@@ -1456,8 +1762,10 @@ static void play_current_file(struct MPContext *mpctx)
     // let get_current_time() show 0 as start time (before playback_pts is set)
     mpctx->last_seek_pts = 0.0;
     mpctx->seek = (struct seek_params){ 0 };
+    mpctx->seek_timing = (struct seek_timing){0};
     mpctx->filter_root = mp_filter_create_root(mpctx->global);
-    mp_filter_graph_set_wakeup_cb(mpctx->filter_root, mp_wakeup_core_cb, mpctx);
+    mp_filter_graph_set_wakeup_cb(mpctx->filter_root, mp_wakeup_core_filter_cb,
+                                  mpctx);
     mp_filter_graph_set_max_run_time(mpctx->filter_root, 0.1);
 
     reset_playback_state(mpctx);
@@ -1555,6 +1863,7 @@ static void play_current_file(struct MPContext *mpctx)
 
     opts->subs_rend->forced_subs_only_current = (opts->subs_rend->forced_subs_only == 1) ? 1 : 0;
 
+    stats_startup_begin(mpctx->global, "select-tracks");
     for (int t = 0; t < STREAM_TYPE_COUNT; t++) {
         for (int i = 0; i < num_ptracks[t]; i++) {
             struct track *sel = NULL;
@@ -1598,13 +1907,19 @@ static void play_current_file(struct MPContext *mpctx)
 
     for (int n = 0; n < mpctx->num_tracks; n++)
         reselect_demux_stream(mpctx, mpctx->tracks[n], false);
+    stats_startup_end(mpctx->global, "select-tracks");
 
     update_demuxer_properties(mpctx);
 
     update_playback_speed(mpctx);
 
+    stats_startup_begin(mpctx->global, "init-video-chain");
     reinit_video_chain(mpctx);
+    stats_startup_end(mpctx->global, "init-video-chain");
+    free_standby_decoder(mpctx); // not used if another track was selected
+    stats_startup_begin(mpctx->global, "init-audio-chain");
     reinit_audio_chain(mpctx);
+    stats_startup_end(mpctx->global, "init-audio-chain");
     reinit_sub_all(mpctx);
 
     if (mpctx->encode_lavc_ctx) {
@@ -1795,6 +2110,8 @@ terminate_playback:
 struct playlist_entry *mp_next_file(struct MPContext *mpctx, int direction,
                                     bool force, bool mutate)
 {
+    if (direction > 0)
+        update_playlist_loader(mpctx, mutate);
     struct playlist_entry *next = playlist_get_next(mpctx->playlist, direction);
     if (next && direction < 0 && !force) {
         // Don't jump to files that would immediately go to next file anyway
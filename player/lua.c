@@ -21,19 +21,23 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
-#include <dirent.h>
 #include <math.h>
 
 #include <lua.h>
 #include <lualib.h>
 #include <lauxlib.h>
 
+#include <libavutil/md5.h>
+#include <libavutil/mem.h>
+
+
 #include "osdep/io.h"
 
 #include "mpv_talloc.h"
 
 #include "common/common.h"
 #include "options/m_property.h"
+#include "common/memory.h"
 #include "common/msg.h"
 #include "common/msg_control.h"
 #include "common/stats.h"
@@ -41,6 +45,7 @@
 #include "input/input.h"
 #include "options/path.h"
 #include "misc/bstr.h"
+#include "misc/dir_cache.h"
 #include "misc/json.h"
 #include "osdep/subprocess.h"
 #include "osdep/timer.h"
@@ -82,6 +87,9 @@ static const char * const builtin_lua_scripts[][2] = {
     {0}
 };
 
+// Maximum number of events fetched with a single mpv_wait_events() call.
+#define EVENT_BATCH 32
+
 // Represents a loaded script. Each has its own Lua state.
 struct script_ctx {
     const char *name;
@@ -95,6 +103,15 @@ struct script_ctx {
     lua_Alloc lua_allocf;
     void *lua_alloc_ud;
     struct stats_ctx *stats;
+    struct mp_memory_user *mem; // heap size (updated when waiting for events)
+    const char *cache_dir; // for compiled chunks, NULL if disabled
+    bool pooled;        // may run as task (--script-threads)
+    bool run_as_task;   // loaded, and uses the default event loop
+    bool keep_running;  // mp.keep_running after the last task run
+    double next_timeout;
+    // Events fetched by mpv_wait_events(), but not returned to the script yet.
+    mpv_event events[EVENT_BATCH];
+    int num_events, next_event;
 };
 
 #if LUA_VERSION_NUM <= 501
@@ -145,20 +162,8 @@ static void af_pushcclosure(lua_State *L, af_CFunction fn, int n);
 #define     af_pushcfunction(L, fn) af_pushcclosure((L), (fn), 0)
 
 
-// add_af_dir, add_af_mpv_alloc take a valid DIR*/char* value respectively,
-// and closedir/mpv_free it when the parent is freed.
-
-static void destruct_af_dir(void *p)
-{
-    closedir(*(DIR**)p);
-}
-
-static void add_af_dir(void *parent, DIR *d)
-{
-    DIR **pd = talloc(parent, DIR*);
-    *pd = d;
-    talloc_set_destructor(pd, destruct_af_dir);
-}
+// add_af_mpv_alloc takes a valid char* value, and mpv_frees it when the parent
+// is freed.
 
 static void destruct_af_mpv_alloc(void *p)
 {
@@ -243,6 +248,102 @@ static int check_error(lua_State *L, int err)
 }
 
 static void add_functions(struct script_ctx *ctx);
+static void add_node_view_mt(lua_State *L);
+
+// Return the path of the cached bytecode for a chunk. id names the chunk, and
+// key must change whenever the chunk's source changes.
+static char *get_cache_path(void *ta_ctx, struct script_ctx *ctx, bstr id,
+                            bstr key)
+{
+    // Binary chunks depend on the VM. The loader rejects mismatching headers,
+    // but avoid that different builds keep overwriting each other's cache.
+    char vm[40];
+    snprintf(vm, sizeof(vm), "%s %d\n", LUA_RELEASE, (int)sizeof(void *));
+
+    struct AVMD5 *md5 = av_md5_alloc();
+    if (!md5)
+        return NULL;
+    uint8_t hash[16];
+    av_md5_init(md5);
+    av_md5_update(md5, vm, strlen(vm));
+    av_md5_update(md5, id.start, id.len);
+    av_md5_update(md5, "\n", 1);
+    av_md5_update(md5, key.start, key.len);
+    av_md5_final(md5, hash);
+    av_free(md5);
+
+    char name[40];
+    for (int n = 0; n < 16; n++)
+        snprintf(name + n * 2, 3, "%02x", hash[n]);
+    snprintf(name + 32, sizeof(name) - 32, ".luac");
+    return mp_path_join(ta_ctx, ctx->cache_dir, name);
+}
+
+// Push the cached chunk and return true, or return false if there's no
+// usable cache file.
+static bool load_cached(lua_State *L, struct script_ctx *ctx, const char *path,
+                        const char *dispname)
+{
+    struct stat st;
+    if (stat(path, &st))
+        return false;
+    void *tmp = talloc_new(ctx);
+    bstr s = stream_read_file(path, tmp, ctx->mpctx->global, 100000000);
+    // Never treat a damaged file as source code.
+    bool ok = s.len && s.start[0] == LUA_SIGNATURE[0];
+    if (ok && luaL_loadbuffer(L, s.start, s.len, dispname)) {
+        MP_VERBOSE(ctx, "Ignoring bytecode cache %s: %s\n", path,
+                   lua_tostring(L, -1));
+        lua_pop(L, 1);
+        ok = false;
+    }
+    talloc_free(tmp);
+    return ok;
+}
+
+struct cache_writer {
+    void *ta_ctx;
+    bstr data;
+};
+
+static int append_chunk(lua_State *L, const void *p, size_t sz, void *ud)
+{
+    struct cache_writer *w = ud;
+    bstr_xappend(w->ta_ctx, &w->data, (bstr){(unsigned char *)p, sz});
+    return 0;
+}
+
+// Write the function at the top of the stack to the cache file. Failure is
+// not an error; the source is simply compiled again next time.
+static void write_cache(lua_State *L, struct script_ctx *ctx, const char *path)
+{
+    void *tmp = talloc_new(ctx);
+    struct cache_writer w = {tmp};
+    if (lua_dump(L, append_chunk, &w) || !w.data.len)
+        goto done;
+
+    mp_mkdirp(ctx->cache_dir);
+
+    // Scripts are loaded concurrently, and may write the same file.
+    char *tmpname = talloc_asprintf(tmp, "%s.%d.%p.tmp", path, (int)getpid(),
+                                    (void *)ctx);
+    FILE *f = fopen(tmpname, "wb");
+    if (!f)
+        goto fail;
+    bool ok = fwrite(w.data.start, w.data.len, 1, f) == 1;
+    ok &= fclose(f) == 0;
+    if (!ok || rename(tmpname, path)) {
+        unlink(tmpname);
+        goto fail;
+    }
+    MP_DBG(ctx, "Wrote bytecode cache %s\n", path);
+    goto done;
+
+fail:
+    MP_VERBOSE(ctx, "Could not write bytecode cache %s\n", path);
+done:
+    talloc_free(tmp);
+}
 
 static void load_file(lua_State *L, const char *fname)
 {
@@ -251,25 +352,48 @@ static void load_file(lua_State *L, const char *fname)
     void *tmp = talloc_new(ctx);
     // according to Lua manual chunkname should be '@' plus the filename
     char *dispname = talloc_asprintf(tmp, "@%s", fname);
-    struct bstr s = stream_read_file(fname, tmp, ctx->mpctx->global, 100000000);
-    if (!s.start)
-        luaL_error(L, "Could not read file.\n");
-    if (luaL_loadbuffer(L, s.start, s.len, dispname))
-        lua_error(L);
+    char *cache = NULL;
+    struct stat st;
+    if (ctx->cache_dir && !stat(fname, &st)) {
+        char *key = talloc_asprintf(tmp, "%lld %lld", (long long)st.st_mtime,
+                                    (long long)st.st_size);
+        cache = get_cache_path(tmp, ctx, bstr0(fname), bstr0(key));
+    }
+    if (!cache || !load_cached(L, ctx, cache, dispname)) {
+        struct bstr s = stream_read_file(fname, tmp, ctx->mpctx->global,
+                                         100000000);
+        if (!s.start)
+            luaL_error(L, "Could not read file.\n");
+        if (luaL_loadbuffer(L, s.start, s.len, dispname))
+            lua_error(L);
+        if (cache)
+            write_cache(L, ctx, cache);
+    }
     lua_call(L, 0, 1);
     talloc_free(tmp);
 }
 
 static int load_builtin(lua_State *L)
 {
+    struct script_ctx *ctx = get_ctx(L);
     const char *name = luaL_checkstring(L, 1);
     char dispname[80];
     snprintf(dispname, sizeof(dispname), "@%s", name);
     for (int n = 0; builtin_lua_scripts[n][0]; n++) {
         if (strcmp(name, builtin_lua_scripts[n][0]) == 0) {
             const char *script = builtin_lua_scripts[n][1];
-            if (luaL_loadbuffer(L, script, strlen(script), dispname))
-                lua_error(L);
+            char *cache = NULL;
+            if (ctx->cache_dir) {
+                // (parent is ctx, so this doesn't leak on Lua errors)
+                cache = get_cache_path(ctx, ctx, bstr0(name), bstr0(script));
+            }
+            if (!cache || !load_cached(L, ctx, cache, dispname)) {
+                if (luaL_loadbuffer(L, script, strlen(script), dispname))
+                    lua_error(L);
+                if (cache)
+                    write_cache(L, ctx, cache);
+            }
+            talloc_free(cache);
             lua_call(L, 0, 1);
             return 1;
         }
@@ -315,6 +439,9 @@ static int load_scripts(lua_State *L)
 
     require(L, "mp.defaults");
 
+    lua_getglobal(L, "mp_event_loop"); // fn
+    lua_setfield(L, LUA_REGISTRYINDEX, "default_event_loop"); // -
+
     if (fname[0] == '@') {
         require(L, fname);
     } else {
@@ -324,6 +451,18 @@ static int load_scripts(lua_State *L)
     lua_getglobal(L, "mp_event_loop"); // fn
     if (lua_isnil(L, -1))
         luaL_error(L, "no event loop function\n");
+
+    // The default event loop can be run piecewise with mp.dispatch_events().
+    if (ctx->pooled) {
+        lua_getfield(L, LUA_REGISTRYINDEX, "default_event_loop"); // fn dfn
+        ctx->run_as_task = lua_rawequal(L, -1, -2);
+        lua_pop(L, 1); // fn
+        if (ctx->run_as_task) {
+            lua_pop(L, 1); // -
+            return 0;
+        }
+    }
+
     lua_call(L, 0, 0); // -
 
     return 0;
@@ -404,6 +543,8 @@ static int run_lua(lua_State *L)
 
     lua_pop(L, 1); // -
 
+    add_node_view_mt(L);
+
     assert(lua_gettop(L) == 0);
 
     // Add a preloader for each builtin Lua module
@@ -434,6 +575,75 @@ static int run_lua(lua_State *L)
     return 0;
 }
 
+// Process all pending events and due timers without blocking.
+static int dispatch_events(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+
+    lua_getglobal(L, "mp"); // mp
+    lua_getfield(L, -1, "dispatch_events"); // mp fn
+    lua_pushboolean(L, 0); // mp fn false
+    lua_call(L, 1, 0); // mp
+
+    lua_getfield(L, -1, "keep_running"); // mp keep_running
+    ctx->keep_running = lua_toboolean(L, -1);
+    lua_pop(L, 1); // mp
+
+    lua_getfield(L, -1, "get_next_timeout"); // mp fn
+    lua_call(L, 0, 1); // mp timeout
+    ctx->next_timeout = -1;
+    if (lua_isnumber(L, -1))
+        ctx->next_timeout = MPMAX(lua_tonumber(L, -1), 0);
+    lua_pop(L, 2); // -
+
+    return 0;
+}
+
+static int run_events(lua_State *L)
+{
+    struct script_ctx *ctx = lua_touserdata(L, -1);
+    lua_pop(L, 1); // -
+
+    lua_pushcfunction(L, error_handler); // errf
+    lua_pushcfunction(L, dispatch_events); // errf fn
+    if (lua_pcall(L, 0, 0, -2)) { // errf [error]
+        const char *e = lua_tostring(L, -1);
+        MP_FATAL(ctx, "Lua error: %s\n", e ? e : "(unknown)");
+        ctx->keep_running = false;
+    }
+
+    return 0;
+}
+
+static bool run_lua_task(struct mp_script_task *task, void *p)
+{
+    struct script_ctx *ctx = p;
+
+    if (mp_cpcall(ctx->state, run_events, ctx)) {
+        const char *err = "unknown error";
+        if (lua_type(ctx->state, -1) == LUA_TSTRING) // avoid allocation
+            err = lua_tostring(ctx->state, -1);
+        MP_FATAL(ctx, "Lua error: %s\n", err);
+        return false;
+    }
+
+    if (!ctx->keep_running)
+        return false;
+
+    mp_script_task_set_timeout(task, ctx->next_timeout);
+    return true;
+}
+
+static void destroy_lua_task(void *p)
+{
+    struct script_ctx *ctx = p;
+    struct mpv_handle *client = ctx->client;
+
+    lua_close(ctx->state);
+    talloc_free(ctx);
+    mpv_destroy(client);
+}
+
 static int load_lua(struct mp_script_args *args)
 {
     int r = -1;
@@ -448,9 +658,14 @@ static int load_lua(struct mp_script_args *args)
         .path = args->path,
         .stats = stats_ctx_create(ctx, args->mpctx->global,
                     mp_tprintf(80, "script/%s", mpv_client_name(args->client))),
+        .mem = mp_memory_user_create(ctx, args->mpctx->global, "scripts"),
+        .cache_dir = args->cache_dir,
+        .pooled = !!args->pool,
     };
 
-    stats_register_thread_cputime(ctx->stats, "cpu");
+    // Pool threads are shared, so this would be meaningless.
+    if (!ctx->pooled)
+        stats_register_thread_cputime(ctx->stats, "cpu");
 
     if (LUA_VERSION_NUM != 501 && LUA_VERSION_NUM != 502) {
         MP_FATAL(ctx, "Only Lua 5.1 and 5.2 are supported.\n");
@@ -475,6 +690,11 @@ static int load_lua(struct mp_script_args *args)
         goto error_out;
     }
 
+    if (ctx->run_as_task) {
+        mp_script_task_create(args, run_lua_task, destroy_lua_task, ctx);
+        return 1;
+    }
+
     r = 0;
 
 error_out:
@@ -548,7 +768,17 @@ static int script_raw_wait_event(lua_State *L, void *tmp)
 {
     struct script_ctx *ctx = get_ctx(L);
 
-    mpv_event *event = mpv_wait_event(ctx->client, luaL_optnumber(L, 1, 1e20));
+    if (ctx->next_event >= ctx->num_events) {
+        mp_memory_report(ctx->mem, ctx->lua_malloc_size);
+        ctx->num_events = mpv_wait_events(ctx->client, luaL_optnumber(L, 1, 1e20),
+                                          ctx->events, EVENT_BATCH);
+        ctx->next_event = 0;
+    }
+
+    mpv_event none = {0};
+    mpv_event *event = &none;
+    if (ctx->next_event < ctx->num_events)
+        event = &ctx->events[ctx->next_event++];
 
     struct mpv_node rn;
     mpv_event_to_node(&rn, event);
@@ -907,6 +1137,147 @@ static void pushnode(lua_State *L, mpv_node *node)
     }
 }
 
+// A read-only view of a map or array within a property value, returned by
+// mp.get_property_lazy(). All views created from the same property read share
+// one snapshot of the value; nested values are converted only when accessed.
+struct node_snapshot {
+    int refcount;
+    struct mpv_node node;
+};
+
+struct node_view {
+    struct node_snapshot *snap; // NULL if not initialized yet
+    struct mpv_node *node;      // within snap->node
+};
+
+#define NODE_VIEW_MT "mp.node_view"
+
+static bool is_node_list(struct mpv_node *node)
+{
+    return node->format == MPV_FORMAT_NODE_ARRAY ||
+           node->format == MPV_FORMAT_NODE_MAP;
+}
+
+// Push a view, or the converted value if it's not a map or array.
+static void push_node_view(lua_State *L, struct node_snapshot *snap,
+                           struct mpv_node *node)
+{
+    if (!is_node_list(node)) {
+        pushnode(L, node);
+        return;
+    }
+    struct node_view *v = lua_newuserdata(L, sizeof(*v)); // view
+    *v = (struct node_view){snap, node};
+    snap->refcount++;
+    luaL_getmetatable(L, NODE_VIEW_MT); // view mt
+    lua_setmetatable(L, -2); // view
+}
+
+static int node_view_gc(lua_State *L)
+{
+    struct node_view *v = luaL_checkudata(L, 1, NODE_VIEW_MT);
+    if (v->snap && --v->snap->refcount == 0) {
+        mpv_free_node_contents(&v->snap->node);
+        talloc_free(v->snap);
+    }
+    v->snap = NULL;
+    return 0;
+}
+
+static int node_view_index(lua_State *L)
+{
+    struct node_view *v = luaL_checkudata(L, 1, NODE_VIEW_MT);
+    struct mpv_node_list *list = v->node->u.list;
+    struct mpv_node *res = NULL;
+    if (v->node->format == MPV_FORMAT_NODE_ARRAY) {
+        if (lua_type(L, 2) == LUA_TNUMBER) {
+            lua_Number n = lua_tonumber(L, 2);
+            if (n >= 1 && n <= list->num && n == (int)n)
+                res = &list->values[(int)n - 1];
+        }
+    } else if (lua_type(L, 2) == LUA_TSTRING) {
+        const char *key = lua_tostring(L, 2);
+        for (int n = 0; n < list->num; n++) {
+            if (strcmp(list->keys[n], key) == 0) {
+                res = &list->values[n];
+                break;
+            }
+        }
+    }
+    if (res) {
+        push_node_view(L, v->snap, res);
+    } else {
+        lua_pushnil(L);
+    }
+    return 1;
+}
+
+static int node_view_len(lua_State *L)
+{
+    struct node_view *v = luaL_checkudata(L, 1, NODE_VIEW_MT);
+    lua_pushinteger(L, v->node->u.list->num);
+    return 1;
+}
+
+// view() returns the whole value as normal Lua table.
+static int node_view_call(lua_State *L)
+{
+    struct node_view *v = luaL_checkudata(L, 1, NODE_VIEW_MT);
+    pushnode(L, v->node);
+    return 1;
+}
+
+static int node_view_newindex(lua_State *L)
+{
+    return luaL_error(L, "property views are read-only");
+}
+
+static void add_node_view_mt(lua_State *L)
+{
+    luaL_newmetatable(L, NODE_VIEW_MT); // mt
+    lua_pushcfunction(L, node_view_gc); // mt fn
+    lua_setfield(L, -2, "__gc"); // mt
+    lua_pushcfunction(L, node_view_index); // mt fn
+    lua_setfield(L, -2, "__index"); // mt
+    lua_pushcfunction(L, node_view_newindex); // mt fn
+    lua_setfield(L, -2, "__newindex"); // mt
+    lua_pushcfunction(L, node_view_len); // mt fn
+    lua_setfield(L, -2, "__len"); // mt
+    lua_pushcfunction(L, node_view_call); // mt fn
+    lua_setfield(L, -2, "__call"); // mt
+    lua_pop(L, 1); // -
+}
+
+static int script_get_property_lazy(lua_State *L)
+{
+    struct script_ctx *ctx = get_ctx(L);
+    const char *name = luaL_checkstring(L, 1);
+    mp_lua_optarg(L, 2);
+
+    // Create the view before reading the property, so that the GC frees the
+    // snapshot even if a Lua error happens below.
+    struct node_view *v = lua_newuserdata(L, sizeof(*v)); // view
+    *v = (struct node_view){0};
+    luaL_getmetatable(L, NODE_VIEW_MT); // view mt
+    lua_setmetatable(L, -2); // view
+
+    struct node_snapshot *snap = talloc_zero(NULL, struct node_snapshot);
+    int err = mpv_get_property(ctx->client, name, MPV_FORMAT_NODE, &snap->node);
+    if (err < 0) {
+        talloc_free(snap);
+        lua_pushvalue(L, 2);
+        lua_pushstring(L, mpv_error_string(err));
+        return 2;
+    }
+    snap->refcount = 1;
+    v->snap = snap;
+    v->node = &snap->node;
+
+    if (!is_node_list(v->node))
+        pushnode(L, v->node); // view value
+    return 1;
+}
+
 static int script_get_property_native(lua_State *L, void *tmp)
 {
     struct script_ctx *ctx = get_ctx(L);
@@ -947,7 +1318,9 @@ static int script_raw_observe_property(lua_State *L)
     uint64_t id = luaL_checknumber(L, 1);
     const char *name = luaL_checkstring(L, 2);
     mpv_format format = check_property_format(L, 3);
-    return check_error(L, mpv_observe_property(ctx->client, id, name, format));
+    double interval = luaL_optnumber(L, 4, 0);
+    return check_error(L, mpv_observe_property_interval(ctx->client, id, name,
+                                                        format, interval));
 }
 
 static int script_raw_unobserve_property(lua_State *L)
@@ -1055,30 +1428,23 @@ static int script_readdir(lua_State *L, void *tmp)
     const char *fmts[] = {"all", "files", "dirs", "normal", NULL};
     const char *path = luaL_checkstring(L, 1);
     int t = luaL_checkoption(L, 2, "normal", fmts);
-    DIR *dir = opendir(path);
-    if (!dir) {
+    struct mp_dir_entry *entries;
+    int num = mp_dir_cache_list(get_mpctx(L)->dir_cache, tmp, path, t, &entries,
+                                NULL);
+    if (num < 0) {
         lua_pushnil(L);
         lua_pushstring(L, "error");
         return 2;
     }
-    add_af_dir(tmp, dir);
     lua_newtable(L); // list
-    char *fullpath = talloc_strdup(tmp, "");
-    struct dirent *e;
     int n = 0;
-    while ((e = readdir(dir))) {
-        char *name = e->d_name;
+    for (int i = 0; i < num; i++) {
+        char *name = entries[i].name;
         if (t) {
             if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
                 continue;
-            if (fullpath)
-                fullpath[0] = '\0';
-            fullpath = talloc_asprintf_append(fullpath, "%s/%s", path, name);
-            struct stat st;
-            if (stat(fullpath, &st))
-                continue;
-            if (!(((t & 1) && S_ISREG(st.st_mode)) ||
-                  ((t & 2) && S_ISDIR(st.st_mode))))
+            if (!(((t & 1) && entries[i].type == MP_DIR_ENTRY_FILE) ||
+                  ((t & 2) && entries[i].type == MP_DIR_ENTRY_DIR)))
                 continue;
         }
         lua_pushinteger(L, ++n); // list index
@@ -1219,6 +1585,7 @@ static const struct fn_entry main_fns[] = {
     FN_ENTRY(get_property_bool),
     FN_ENTRY(get_property_number),
     AF_ENTRY(get_property_native),
+    FN_ENTRY(get_property_lazy),
     FN_ENTRY(set_property),
     FN_ENTRY(set_property_bool),
     FN_ENTRY(set_property_number),
@@ -1329,5 +1696,6 @@ static void add_functions(struct script_ctx *ctx)
 const struct mp_scripting mp_scripting_lua = {
     .name = "lua script",
     .file_ext = "lua",
+    .tasks = true,
     .load = load_lua,
 };
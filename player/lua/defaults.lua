@@ -385,11 +385,11 @@ end
 local property_id = 0
 local properties = {}
 
-function mp.observe_property(name, t, cb)
+function mp.observe_property(name, t, cb, interval)
     local id = property_id + 1
     property_id = id
     properties[id] = cb
-    mp.raw_observe_property(id, name, t)
+    mp.raw_observe_property(id, name, t, interval)
 end
 
 function mp.unobserve_property(cb)
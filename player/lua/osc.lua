@@ -2033,7 +2033,9 @@ function osc_init()
             if (element.state.lastseek == nil) or
                 (not (element.state.lastseek == seekto)) then
                     local flags = "absolute-percent"
-                    if not user_opts.seekbarkeyframes then
+                    if user_opts.seekbarkeyframes then
+                        flags = flags .. "+scrub"
+                    else
                         flags = flags .. "+exact"
                     end
                     mp.commandv("seek", seekto, flags)
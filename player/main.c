@@ -27,6 +27,7 @@
 #include "config.h"
 #include "mpv_talloc.h"
 
+#include "misc/dir_cache.h"
 #include "misc/dispatch.h"
 #include "misc/thread_pool.h"
 #include "osdep/io.h"
@@ -37,6 +38,7 @@
 #include "common/av_log.h"
 #include "common/codecs.h"
 #include "common/encode.h"
+#include "common/memory.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
 #include "options/m_property.h"
@@ -57,12 +59,16 @@
 #include "misc/thread_tools.h"
 #include "sub/osd.h"
 #include "test/tests.h"
+#include "video/hwdec.h"
+#include "video/image_cache.h"
+#include "video/mp_image_pool.h"
 #include "video/out/vo.h"
 
 #include "core.h"
 #include "client.h"
 #include "command.h"
 #include "screenshot.h"
+#include "telemetry.h"
 
 static const char def_config[] =
 #include "generated/etc/builtin.conf.inc"
@@ -159,19 +165,30 @@ void mp_print_version(struct mp_log *log, int always)
 void mp_destroy(struct MPContext *mpctx)
 {
     mp_shutdown_clients(mpctx);
+    mp_script_pool_destroy(mpctx);
 
     mp_uninit_ipc(mpctx->ipc_ctx);
     mpctx->ipc_ctx = NULL;
 
+    mp_telemetry_uninit(mpctx);
+
     uninit_audio_out(mpctx);
     uninit_video_out(mpctx);
 
+    mp_image_buffer_cache_uninit(mpctx->global);
+    TA_FREEP(&mpctx->image_cache);
+    hwdec_warm_pool_flush(mpctx->global);
+
     // If it's still set here, it's an error.
     encode_lavc_free(mpctx->encode_lavc_ctx);
     mpctx->encode_lavc_ctx = NULL;
 
     command_uninit(mpctx);
 
+    mp_close_watch_later_store(mpctx);
+
+    uninit_playlist_loader(mpctx);
+
     mp_clients_destroy(mpctx);
 
     osd_free(mpctx->osd);
@@ -260,8 +277,10 @@ struct MPContext *mp_create(void)
         .dispatch = mp_dispatch_create(mpctx),
         .playback_abort = mp_cancel_new(mpctx),
         .thread_pool = mp_thread_pool_create(mpctx, 0, 1, 30),
+        .dir_cache = mp_dir_cache_create(mpctx),
         .stop_play = PT_NEXT_ENTRY,
         .play_dir = 1,
+        .scrub_skip_pts = MP_NOPTS_VALUE,
     };
 
     pthread_mutex_init(&mpctx->abort_lock, NULL);
@@ -269,6 +288,8 @@ struct MPContext *mp_create(void)
     mpctx->global = talloc_zero(mpctx, struct mpv_global);
 
     stats_global_init(mpctx->global);
+    mp_memory_global_init(mpctx->global);
+    mpctx->image_cache = mp_image_cache_create(mpctx, mpctx->global);
 
     // Nothing must call mp_msg*() and related before this
     mp_msg_init(mpctx->global);
@@ -276,6 +297,8 @@ struct MPContext *mp_create(void)
     mpctx->statusline = mp_log_new(mpctx, mpctx->log, "!statusline");
 
     mpctx->stats = stats_ctx_create(mpctx, mpctx->global, "main");
+    mp_thread_pool_enable_stats(mpctx->thread_pool, mpctx->global,
+                                "thread-pool");
 
     // Create the config context and register the options
     mpctx->mconfig = m_config_new(mpctx, mpctx->log, &mp_opt_root);
@@ -288,7 +311,7 @@ struct MPContext *mp_create(void)
     mpctx->mconfig->global = mpctx->global;
     m_config_parse(mpctx->mconfig, "", bstr0(def_config), NULL, 0);
 
-    mpctx->input = mp_input_init(mpctx->global, mp_wakeup_core_cb, mpctx);
+    mpctx->input = mp_input_init(mpctx->global, mp_wakeup_core_input_cb, mpctx);
     screenshot_init(mpctx);
     command_init(mpctx);
     init_libav(mpctx->global);
@@ -319,6 +342,8 @@ int mp_initialize(struct MPContext *mpctx, char **options)
 
     assert(!mpctx->initialized);
 
+    stats_startup_begin(mpctx->global, "initialize");
+
     // Preparse the command line, so we can init the terminal early.
     if (options) {
         m_config_preparse_command_line(mpctx->mconfig, mpctx->global,
@@ -338,7 +363,9 @@ int mp_initialize(struct MPContext *mpctx, char **options)
 
     mp_print_version(mpctx->log, false);
 
+    stats_startup_begin(mpctx->global, "parse-cfgfiles");
     mp_parse_cfgfiles(mpctx);
+    stats_startup_end(mpctx->global, "parse-cfgfiles");
 
     if (options) {
         int r = m_config_parse_mp_command_line(mpctx->mconfig, mpctx->playlist,
@@ -347,6 +374,9 @@ int mp_initialize(struct MPContext *mpctx, char **options)
             return r == M_OPT_EXIT ? 1 : -1;
     }
 
+    if (opts->alloc_profile && !ta_enable_alloc_profile())
+        MP_WARN(mpctx, "--alloc-profile is not supported by this build.\n");
+
     if (opts->operation_mode == 1) {
         m_config_set_profile(mpctx->mconfig, "builtin-pseudo-gui",
                              M_SETOPT_NO_OVERWRITE);
@@ -404,7 +434,9 @@ int mp_initialize(struct MPContext *mpctx, char **options)
         mp_input_enable_section(mpctx->input, "encode", MP_INPUT_EXCLUSIVE);
     }
 
+    stats_startup_begin(mpctx->global, "load-scripts");
     mp_load_scripts(mpctx);
+    stats_startup_end(mpctx->global, "load-scripts");
 
     if (opts->force_vo == 2 && handle_force_window(mpctx, false) < 0)
         return -1;
@@ -414,6 +446,7 @@ int mp_initialize(struct MPContext *mpctx, char **options)
         mpctx->stop_play = PT_STOP;
 
     MP_STATS(mpctx, "end init");
+    stats_startup_end(mpctx->global, "initialize");
 
     return 0;
 }
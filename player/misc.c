@@ -19,6 +19,7 @@
 #include <stdbool.h>
 #include <errno.h>
 #include <assert.h>
+#include <math.h>
 
 #include "config.h"
 #include "mpv_talloc.h"
@@ -31,11 +32,15 @@
 #include "options/options.h"
 #include "options/m_property.h"
 #include "options/m_config.h"
+#include "options/path.h"
 #include "common/common.h"
 #include "common/global.h"
 #include "common/encode.h"
 #include "common/playlist.h"
+#include "common/stats.h"
 #include "input/input.h"
+#include "misc/json.h"
+#include "misc/node.h"
 
 #include "audio/out/ao.h"
 #include "demux/demux.h"
@@ -319,3 +324,96 @@ const char *mp_status_str(enum playback_status st)
     default:                return "bug";
     }
 }
+
+// Write node as JSON to the given file (overwriting it). Logs errors.
+bool write_json_file(struct MPContext *mpctx, const char *file,
+                     struct mpv_node *node)
+{
+    void *tmp = talloc_new(NULL);
+    char *json = talloc_strdup(tmp, "");
+    char *path = mp_get_user_path(tmp, mpctx->global, file);
+    bool ok = false;
+    FILE *f = NULL;
+    if (json_write(&json, node) >= 0)
+        f = fopen(path, "wb");
+    if (f) {
+        ok = fputs(json, f) >= 0;
+        ok &= fclose(f) == 0;
+    }
+    if (!ok)
+        MP_ERR(mpctx, "Could not write '%s'.\n", path);
+    talloc_free(tmp);
+    return ok;
+}
+
+// Convert the stats_startup_query() output to the Chrome trace event format.
+static void startup_to_trace(struct mpv_node *events, struct mpv_node *dst)
+{
+    node_init(dst, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_string(dst, "displayTimeUnit", "ms");
+    struct mpv_node *list = node_map_add(dst, "traceEvents", MPV_FORMAT_NODE_ARRAY);
+
+    struct mpv_node *meta = node_array_add(list, MPV_FORMAT_NODE_MAP);
+    node_map_add_string(meta, "name", "thread_name");
+    node_map_add_string(meta, "ph", "M");
+    node_map_add_int64(meta, "pid", 0);
+    node_map_add_int64(meta, "tid", 0);
+    struct mpv_node *args = node_map_add(meta, "args", MPV_FORMAT_NODE_MAP);
+    node_map_add_string(args, "name", "core");
+
+    for (int n = 0; n < events->u.list->num; n++) {
+        struct mpv_node *ev = &events->u.list->values[n];
+        struct mpv_node *name = node_map_get(ev, "name");
+        struct mpv_node *thread = node_map_get(ev, "thread");
+        struct mpv_node *start = node_map_get(ev, "start");
+        struct mpv_node *duration = node_map_get(ev, "duration");
+
+        struct mpv_node *te = node_array_add(list, MPV_FORMAT_NODE_MAP);
+        node_map_add_string(te, "name", name->u.string);
+        node_map_add_int64(te, "pid", 0);
+        node_map_add_int64(te, "tid", thread->u.int64);
+        node_map_add_int64(te, "ts", llrint(start->u.double_ * 1e6));
+        if (duration) {
+            node_map_add_string(te, "ph", "X");
+            node_map_add_int64(te, "dur", llrint(duration->u.double_ * 1e6));
+        } else {
+            node_map_add_string(te, "ph", "i");
+            node_map_add_string(te, "s", "t");
+        }
+    }
+}
+
+// Stop recording the startup timeline (once the first file is playing), log
+// it, and write it to --dump-startup-timeline.
+void finish_startup_timeline(struct MPContext *mpctx)
+{
+    if (!stats_startup_finish(mpctx->global))
+        return;
+
+    void *tmp = talloc_new(NULL);
+    struct mpv_node events;
+    stats_startup_query(mpctx->global, &events);
+    talloc_steal(tmp, events.u.list);
+
+    for (int n = 0; n < events.u.list->num; n++) {
+        struct mpv_node *ev = &events.u.list->values[n];
+        struct mpv_node *duration = node_map_get(ev, "duration");
+        MP_VERBOSE(mpctx, "startup: %8.3f ms %-20s thread %d%s\n",
+                   node_map_get(ev, "start")->u.double_ * 1e3,
+                   node_map_get(ev, "name")->u.string,
+                   (int)node_map_get(ev, "thread")->u.int64,
+                   duration ? mp_tprintf(40, ", took %.3f ms",
+                                         duration->u.double_ * 1e3) : "");
+    }
+
+    char *file = mpctx->opts->dump_startup_timeline;
+    if (file && file[0]) {
+        struct mpv_node trace;
+        startup_to_trace(&events, &trace);
+        talloc_steal(tmp, trace.u.list);
+        if (write_json_file(mpctx, file, &trace))
+            MP_VERBOSE(mpctx, "Startup timeline written to '%s'.\n", file);
+    }
+
+    talloc_free(tmp);
+}
@@ -27,6 +27,7 @@
 #include "core.h"
 #include "mpv_talloc.h"
 #include "screenshot.h"
+#include "telemetry.h"
 
 #include "audio/out/ao.h"
 #include "common/common.h"
@@ -52,6 +53,18 @@
 
 // Wait until mp_wakeup_core() is called, since the last time
 // mp_wait_events() was called.
+static void account_wakeup_reasons(struct MPContext *mpctx, unsigned reasons)
+{
+    static const char *const names[] = {
+        "wakeup-other", "wakeup-timeout", "wakeup-input", "wakeup-client",
+        "wakeup-vo", "wakeup-ao", "wakeup-filter", "wakeup-demux",
+    };
+    for (int n = 0; n < MP_ARRAY_SIZE(names); n++) {
+        if (reasons & (1u << n))
+            stats_event(mpctx->stats, names[n]);
+    }
+}
+
 void mp_wait_events(struct MPContext *mpctx)
 {
     mp_client_send_property_changes(mpctx);
@@ -64,6 +77,12 @@ void mp_wait_events(struct MPContext *mpctx)
 
     mp_dispatch_queue_process(mpctx->dispatch, mpctx->sleeptime);
 
+    unsigned reasons = atomic_exchange(&mpctx->wakeup_reasons_pending, 0);
+    if (!reasons && sleeping)
+        reasons = MP_WAKEUP_TIMEOUT;
+    account_wakeup_reasons(mpctx, reasons);
+    mpctx->wakeup_reasons = reasons;
+
     mpctx->sleeptime = INFINITY;
 
     if (sleeping)
@@ -87,14 +106,41 @@ void mp_set_timeout(struct MPContext *mpctx, double sleeptime)
 // of going to sleep in the next mp_wait_events().
 void mp_wakeup_core(struct MPContext *mpctx)
 {
+    mp_wakeup_core_reason(mpctx, MP_WAKEUP_OTHER);
+}
+
+// Like mp_wakeup_core(), but record why (MP_WAKEUP_* bits). This lets the
+// playloop skip handlers which can't be affected, and is counted in the stats.
+void mp_wakeup_core_reason(struct MPContext *mpctx, unsigned reason)
+{
+    atomic_fetch_or(&mpctx->wakeup_reasons_pending, reason);
     mp_dispatch_interrupt(mpctx->dispatch);
 }
 
-// Opaque callback variant of mp_wakeup_core().
+// Opaque callback variants of mp_wakeup_core().
 void mp_wakeup_core_cb(void *ctx)
 {
-    struct MPContext *mpctx = ctx;
-    mp_wakeup_core(mpctx);
+    mp_wakeup_core_reason(ctx, MP_WAKEUP_OTHER);
+}
+
+void mp_wakeup_core_vo_cb(void *ctx)
+{
+    mp_wakeup_core_reason(ctx, MP_WAKEUP_VO);
+}
+
+void mp_wakeup_core_ao_cb(void *ctx)
+{
+    mp_wakeup_core_reason(ctx, MP_WAKEUP_AO);
+}
+
+void mp_wakeup_core_input_cb(void *ctx)
+{
+    mp_wakeup_core_reason(ctx, MP_WAKEUP_INPUT);
+}
+
+void mp_wakeup_core_filter_cb(void *ctx)
+{
+    mp_wakeup_core_reason(ctx, MP_WAKEUP_FILTER);
 }
 
 void mp_core_lock(struct MPContext *mpctx)
@@ -110,6 +156,9 @@ void mp_core_unlock(struct MPContext *mpctx)
 // Process any queued user input.
 static void mp_process_input(struct MPContext *mpctx)
 {
+    double refresh = mpctx->video_out ? vo_get_display_fps(mpctx->video_out) : 0;
+    mp_input_set_mouse_move_rate(mpctx->input, refresh);
+
     int processed = 0;
     for (;;) {
         mp_cmd_t *cmd = mp_input_read_cmd(mpctx->input);
@@ -243,6 +292,8 @@ void reset_playback_state(struct MPContext *mpctx)
     mpctx->hrseek_active = false;
     mpctx->hrseek_lastframe = false;
     mpctx->hrseek_backstep = false;
+    mpctx->scrubbing = false;
+    mpctx->scrub_resync = false;
     mpctx->current_seek = (struct seek_params){0};
     mpctx->playback_pts = MP_NOPTS_VALUE;
     mpctx->step_frames = 0;
@@ -258,6 +309,65 @@ void reset_playback_state(struct MPContext *mpctx)
     update_core_idle_state(mpctx);
 }
 
+// Start a new last-seek-timing breakdown.
+static void seek_timing_start(struct MPContext *mpctx)
+{
+    mpctx->seek_timing = (struct seek_timing){
+        .queued = mp_time_us(),
+        .executed = -1,
+        .demux_done = -1,
+        .reset_done = -1,
+        .first_frame = -1,
+        .restarted = -1,
+    };
+}
+
+// Set *field to the time passed since the seek was queued.
+void seek_timing_mark(struct MPContext *mpctx, int64_t *field)
+{
+    if (mpctx->seek_timing.queued && *field < 0)
+        *field = mp_time_us() - mpctx->seek_timing.queued;
+}
+
+static void seek_timing_finish(struct MPContext *mpctx)
+{
+    struct seek_timing *t = &mpctx->seek_timing;
+    if (!t->queued || t->done || t->executed < 0)
+        return;
+
+    seek_timing_mark(mpctx, &t->restarted);
+    t->done = true;
+
+    struct demux_reader_state s;
+    demux_get_reader_state(mpctx->demuxer, &s);
+    t->demux = s.last_seek;
+
+    t->vdec_flush = t->vdec_refill = t->adec_flush = t->adec_refill = -1;
+    if (mpctx->vo_chain && mpctx->vo_chain->track &&
+        mpctx->vo_chain->track->dec)
+    {
+        mp_decoder_wrapper_get_reset_timing(mpctx->vo_chain->track->dec,
+                                            &t->vdec_flush, &t->vdec_refill);
+    }
+    if (mpctx->ao_chain && mpctx->ao_chain->track &&
+        mpctx->ao_chain->track->dec)
+    {
+        mp_decoder_wrapper_get_reset_timing(mpctx->ao_chain->track->dec,
+                                            &t->adec_flush, &t->adec_refill);
+    }
+
+    MP_DBG(mpctx, "seek timing (ms): execute %.1f, demux %.1f (%s, lookup %.1f, "
+           "low level %.1f, %"PRId64" stream seeks), reset %.1f, "
+           "video flush %.1f refill %.1f, audio flush %.1f refill %.1f, "
+           "first frame %.1f, restart %.1f\n",
+           t->executed / 1e3, t->demux_done / 1e3,
+           t->demux.cached ? "cached" : "uncached", t->demux.lookup_time / 1e3,
+           t->demux.low_level_time / 1e3, t->demux.stream_seeks,
+           t->reset_done / 1e3, t->vdec_flush / 1e3, t->vdec_refill / 1e3,
+           t->adec_flush / 1e3, t->adec_refill / 1e3,
+           t->first_frame / 1e3, t->restarted / 1e3);
+}
+
 static void mp_seek(MPContext *mpctx, struct seek_params seek)
 {
     struct MPOpts *opts = mpctx->opts;
@@ -265,6 +375,11 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
     if (!mpctx->demuxer || !seek.type || seek.amount == MP_NOPTS_VALUE)
         return;
 
+    // Not queued with queue_seek() (or already executed).
+    if (!mpctx->seek_timing.queued || mpctx->seek_timing.executed >= 0)
+        seek_timing_start(mpctx);
+    seek_timing_mark(mpctx, &mpctx->seek_timing.executed);
+
     bool hr_seek_very_exact = seek.exact == MPSEEK_VERY_EXACT;
     double current_time = get_playback_time(mpctx);
     if (current_time == MP_NOPTS_VALUE && seek.type == MPSEEK_RELATIVE)
@@ -296,6 +411,10 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
 
     double demux_pts = seek_pts;
 
+    bool scrub = (seek.flags & MPSEEK_FLAG_SCRUB) && opts->play_dir > 0;
+    if (scrub)
+        seek.exact = MPSEEK_KEYFRAME;
+
     bool hr_seek = seek.exact != MPSEEK_KEYFRAME && seek_pts != MP_NOPTS_VALUE &&
         (seek.exact >= MPSEEK_EXACT || opts->hr_seek == 1 ||
          (opts->hr_seek >= 0 && seek.type == MPSEEK_ABSOLUTE) ||
@@ -349,8 +468,10 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
             MP_ERR(mpctx, "Cannot seek in this stream.\n");
             MP_ERR(mpctx, "You can force it with '--force-seekable=yes'.\n");
         }
+        mpctx->seek_timing = (struct seek_timing){0};
         return;
     }
+    seek_timing_mark(mpctx, &mpctx->seek_timing.demux_done);
 
     mpctx->play_dir = play_dir;
 
@@ -372,6 +493,11 @@ static void mp_seek(MPContext *mpctx, struct seek_params seek)
         clear_audio_output_buffers(mpctx);
 
     reset_playback_state(mpctx);
+    seek_timing_mark(mpctx, &mpctx->seek_timing.reset_done);
+    if (scrub) {
+        mpctx->scrubbing = true;
+        video_start_scrub(mpctx);
+    }
     if (mpctx->recorder)
         mp_recorder_mark_discontinuity(mpctx->recorder);
 
@@ -431,6 +557,10 @@ void queue_seek(struct MPContext *mpctx, enum seek_type type, double amount,
     if (mpctx->stop_play == AT_END_OF_FILE)
         mpctx->stop_play = KEEP_PLAYING;
 
+    // Consecutive seeks are combined, so time from the first one.
+    if (type != MPSEEK_NONE && !seek->type)
+        seek_timing_start(mpctx);
+
     switch (type) {
     case MPSEEK_RELATIVE:
         seek->flags |= flags;
@@ -463,6 +593,16 @@ void queue_seek(struct MPContext *mpctx, enum seek_type type, double amount,
 
 void execute_queued_seek(struct MPContext *mpctx)
 {
+    // After scrubbing, the decoder skipped everything but keyframes. Once
+    // playback continues, seek back to the shown keyframe to decode normally.
+    if (mpctx->scrub_resync && !mpctx->seek.type &&
+        !get_internal_paused(mpctx) && mpctx->playback_pts != MP_NOPTS_VALUE)
+    {
+        mpctx->scrub_resync = false;
+        queue_seek(mpctx, MPSEEK_ABSOLUTE, mpctx->playback_pts,
+                   MPSEEK_KEYFRAME, 0);
+    }
+
     if (mpctx->seek.type) {
         bool queued_hr_seek = mpctx->seek.exact != MPSEEK_KEYFRAME;
         // Let explicitly imprecise seeks cancel precise seeks:
@@ -471,7 +611,10 @@ void execute_queued_seek(struct MPContext *mpctx)
         // If the user seeks continuously (keeps arrow key down) try to finish
         // showing a frame from one location before doing another seek (instead
         // of never updating the screen).
+        // Scrub seeks abort the current seek instead (only the latest target
+        // matters, and showing it is cheap).
         if ((mpctx->seek.flags & MPSEEK_FLAG_DELAY) &&
+            !(mpctx->seek.flags & MPSEEK_FLAG_SCRUB) &&
             mp_time_sec() - mpctx->start_timestamp < 0.3)
         {
             // Wait until a video frame is available and has been shown.
@@ -581,9 +724,23 @@ int get_current_chapter(struct MPContext *mpctx)
         return -2;
     double current_pts = get_current_time(mpctx);
     int i;
-    for (i = 0; i < mpctx->num_chapters; i++)
-        if (current_pts < mpctx->chapters[i].pts)
-            break;
+    if (mpctx->chapters_unsorted) {
+        for (i = 0; i < mpctx->num_chapters; i++)
+            if (current_pts < mpctx->chapters[i].pts)
+                break;
+    } else {
+        // Binary search for the first chapter starting after current_pts.
+        int lo = 0, hi = mpctx->num_chapters;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (current_pts < mpctx->chapters[mid].pts) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        i = lo;
+    }
     return MPMAX(mpctx->last_chapter_seek, i - 1);
 }
 
@@ -677,6 +834,62 @@ static void clear_underruns(struct MPContext *mpctx)
     }
 }
 
+// Minimum time between two variant switches with --hls-bitrate=auto.
+#define HLS_SWITCH_INTERVAL 10.0
+
+// With --hls-bitrate=auto, switch the selected HLS/DASH variants to the
+// highest bitrate the measured input rate can sustain.
+static void update_hls_variants(struct MPContext *mpctx,
+                                struct demux_reader_state *s, double now)
+{
+    if (mpctx->opts->hls_bitrate != -2 || now < mpctx->next_hls_switch)
+        return;
+
+    // The input rate is only meaningful while the demuxer is reading as fast
+    // as it can. With a full cache, the current variant is fine anyway.
+    bool starved = s->underrun || mpctx->paused_for_cache;
+    if ((s->idle && !starved) || !s->bytes_per_second)
+        return;
+    // Leave some headroom for rate fluctuations and other tracks.
+    double budget = s->bytes_per_second * 8 * 0.75;
+
+    bool switched = false;
+    for (int t = 0; t < STREAM_TYPE_COUNT; t++) {
+        struct track *cur = mpctx->current_track[0][t];
+        if (!cur || !cur->stream || cur->stream->hls_bitrate <= 0)
+            continue;
+
+        struct track *best = NULL, *lowest = NULL;
+        for (int n = 0; n < mpctx->num_tracks; n++) {
+            struct track *track = mpctx->tracks[n];
+            if (track->type != t || track->demuxer != cur->demuxer ||
+                !track->stream || track->stream->hls_bitrate <= 0)
+                continue;
+            int rate = track->stream->hls_bitrate;
+            if (rate <= budget && (!best || rate > best->stream->hls_bitrate))
+                best = track;
+            if (!lowest || rate < lowest->stream->hls_bitrate)
+                lowest = track;
+        }
+        if (!best)
+            best = lowest;
+        // Never switch up while the current variant is already too slow.
+        if (best->stream->hls_bitrate > cur->stream->hls_bitrate && starved)
+            continue;
+        if (best != cur) {
+            MP_VERBOSE(mpctx, "Switching %s to the %d kbps variant (input "
+                       "rate %.0f kbps).\n", stream_type_name(t),
+                       best->stream->hls_bitrate / 1000,
+                       s->bytes_per_second * 8 / 1000.0);
+            mp_switch_track(mpctx, t, best, 0);
+            switched = true;
+        }
+    }
+
+    if (switched)
+        mpctx->next_hls_switch = now + HLS_SWITCH_INTERVAL;
+}
+
 static void handle_update_cache(struct MPContext *mpctx)
 {
     bool force_update = false;
@@ -782,8 +995,21 @@ static void handle_update_cache(struct MPContext *mpctx)
         force_update = true;
     }
 
-    if (s.eof && !busy)
+    prefetch_video_decoder(mpctx);
+
+    update_hls_variants(mpctx, &s, now);
+
+    if (s.eof && !busy) {
         prefetch_next(mpctx);
+    } else if (opts->prefetch_lead > 0 && !mpctx->open_active) {
+        // Start early enough that the next file's first packets are in
+        // memory by the time this file ends.
+        double len = get_time_length(mpctx);
+        double pos = get_current_time(mpctx);
+        if (len != MP_NOPTS_VALUE && pos != MP_NOPTS_VALUE &&
+            len - pos <= opts->prefetch_lead)
+            prefetch_next(mpctx);
+    }
 
     if (force_update) {
         mpctx->cache_update_pts = mpctx->playback_pts;
@@ -796,6 +1022,14 @@ int get_cache_buffering_percentage(struct MPContext *mpctx)
     return mpctx->demuxer ? mpctx->cache_buffer : -1;
 }
 
+// True if only the playback data flow (and no timer, input, VO or client)
+// woke up the playloop.
+static bool wakeup_is_data_only(struct MPContext *mpctx)
+{
+    unsigned r = mpctx->wakeup_reasons;
+    return r && !(r & ~(unsigned)MP_WAKEUP_DATA);
+}
+
 static void handle_cursor_autohide(struct MPContext *mpctx)
 {
     struct MPOpts *opts = mpctx->opts;
@@ -807,6 +1041,12 @@ static void handle_cursor_autohide(struct MPContext *mpctx)
     bool mouse_cursor_visible = mpctx->mouse_cursor_visible;
     double now = mp_time_sec();
 
+    // Mouse movement can't have happened; only keep the timer armed.
+    if (wakeup_is_data_only(mpctx) && mpctx->mouse_timer > now) {
+        mp_set_timeout(mpctx, mpctx->mouse_timer - now);
+        return;
+    }
+
     unsigned mouse_event_ts = mp_input_get_mouse_event_counter(mpctx->input);
     if (mpctx->mouse_event_ts != mouse_event_ts) {
         mpctx->mouse_event_ts = mouse_event_ts;
@@ -1006,13 +1246,14 @@ int handle_force_window(struct MPContext *mpctx, bool force)
             .input_ctx = mpctx->input,
             .osd = mpctx->osd,
             .encode_lavc_ctx = mpctx->encode_lavc_ctx,
-            .wakeup_cb = mp_wakeup_core_cb,
+            .wakeup_cb = mp_wakeup_core_vo_cb,
             .wakeup_ctx = mpctx,
         };
         mpctx->video_out = init_best_video_out(mpctx->global, &ex);
         if (!mpctx->video_out)
             goto err;
         mpctx->mouse_cursor_visible = true;
+        mp_load_builtin_scripts(mpctx);
     }
 
     if (!mpctx->video_out->config_ok || force) {
@@ -1126,7 +1367,12 @@ static void handle_playback_restart(struct MPContext *mpctx)
     if (!mpctx->restart_complete) {
         mpctx->hrseek_active = false;
         mpctx->restart_complete = true;
+        mpctx->scrub_resync = mpctx->scrubbing;
+        mpctx->scrubbing = false;
         mpctx->current_seek = (struct seek_params){0};
+        seek_timing_finish(mpctx);
+        stats_startup_mark(mpctx->global, "playback-restart");
+        finish_startup_timeline(mpctx);
         handle_playback_time(mpctx);
         mp_notify(mpctx, MPV_EVENT_PLAYBACK_RESTART, NULL);
         update_core_idle_state(mpctx);
@@ -1202,8 +1448,11 @@ void run_playloop(struct MPContext *mpctx)
 
     update_demuxer_properties(mpctx);
 
+    update_playlist_loader(mpctx, false);
+
     handle_cursor_autohide(mpctx);
-    handle_vo_events(mpctx);
+    if (!wakeup_is_data_only(mpctx))
+        handle_vo_events(mpctx);
     handle_command_updates(mpctx);
 
     if (mpctx->lavfi && mp_filter_has_failed(mpctx->lavfi))
@@ -1242,7 +1491,9 @@ void run_playloop(struct MPContext *mpctx)
     handle_osd_redraw(mpctx);
 
     if (mp_filter_graph_run(mpctx->filter_root))
-        mp_wakeup_core(mpctx);
+        mp_wakeup_core_reason(mpctx, MP_WAKEUP_FILTER);
+
+    mp_telemetry_update(mpctx);
 
     mp_wait_events(mpctx);
 
@@ -1258,6 +1509,7 @@ void run_playloop(struct MPContext *mpctx)
 void mp_idle(struct MPContext *mpctx)
 {
     handle_dummy_ticks(mpctx);
+    mp_telemetry_update(mpctx);
     mp_wait_events(mpctx);
     mp_process_input(mpctx);
     handle_command_updates(mpctx);
@@ -15,6 +15,7 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
@@ -26,11 +27,13 @@
 #include "mpv_talloc.h"
 #include "screenshot.h"
 #include "core.h"
+#include "client.h"
 #include "command.h"
 #include "input/cmd.h"
 #include "misc/bstr.h"
 #include "misc/dispatch.h"
 #include "misc/node.h"
+#include "misc/thread_pool.h"
 #include "misc/thread_tools.h"
 #include "common/msg.h"
 #include "options/path.h"
@@ -54,8 +57,30 @@ typedef struct screenshot_ctx {
 
     int frameno;
     uint64_t last_frame_count;
+
+    // Background writes (each-frame mode).
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    // -- protected by lock
+    char **queued_names;        // filenames of unfinished background writes
+    int num_queued;
 } screenshot_ctx;
 
+struct write_job {
+    struct MPContext *mpctx;
+    struct mp_image *image;
+    char *filename;
+    struct image_writer_opts opts;
+};
+
+static void screenshot_ctx_destroy(void *p)
+{
+    screenshot_ctx *ctx = p;
+    assert(!ctx->num_queued); // outstanding_async prevents this
+    pthread_cond_destroy(&ctx->wakeup);
+    pthread_mutex_destroy(&ctx->lock);
+}
+
 void screenshot_init(struct MPContext *mpctx)
 {
     mpctx->screenshot_ctx = talloc(mpctx, screenshot_ctx);
@@ -63,6 +88,9 @@ void screenshot_init(struct MPContext *mpctx)
         .mpctx = mpctx,
         .frameno = 1,
     };
+    pthread_mutex_init(&mpctx->screenshot_ctx->lock, NULL);
+    pthread_cond_init(&mpctx->screenshot_ctx->wakeup, NULL);
+    talloc_set_destructor(mpctx->screenshot_ctx, screenshot_ctx_destroy);
 }
 
 static char *stripext(void *talloc_ctx, const char *s)
@@ -97,6 +125,86 @@ static bool write_screenshot(struct mp_cmd_ctx *cmd, struct mp_image *img,
     return ok;
 }
 
+static void write_job_run(void *p)
+{
+    struct write_job *job = p;
+    struct MPContext *mpctx = job->mpctx;
+    screenshot_ctx *ctx = mpctx->screenshot_ctx;
+
+    if (write_image(job->image, &job->opts, job->filename, mpctx->global,
+                    mpctx->log))
+    {
+        MP_INFO(mpctx, "Screenshot: '%s'\n", job->filename);
+    } else {
+        MP_ERR(mpctx, "Error writing screenshot '%s'!\n", job->filename);
+    }
+
+    pthread_mutex_lock(&ctx->lock);
+    for (int n = 0; n < ctx->num_queued; n++) {
+        if (ctx->queued_names[n] == job->filename) {
+            MP_TARRAY_REMOVE_AT(ctx->queued_names, ctx->num_queued, n);
+            break;
+        }
+    }
+    pthread_cond_broadcast(&ctx->wakeup);
+    pthread_mutex_unlock(&ctx->lock);
+
+    talloc_free(job);
+
+    mp_core_lock(mpctx);
+    mpctx->outstanding_async -= 1;
+    if (!mpctx->outstanding_async && mp_is_shutting_down(mpctx))
+        mp_wakeup_core(mpctx);
+    mp_core_unlock(mpctx);
+}
+
+// Convert and encode the image on a worker thread, and return immediately,
+// unless --screenshot-queue writes are already in progress, in which case
+// this waits until one of them is done. Takes ownership of the image and
+// filename. Errors are only logged.
+static void queue_screenshot(struct MPContext *mpctx, struct mp_image *img,
+                             char *filename)
+{
+    screenshot_ctx *ctx = mpctx->screenshot_ctx;
+    int max = mpctx->opts->screenshot_queue;
+
+    struct write_job *job = talloc_ptrtype(NULL, job);
+    *job = (struct write_job){
+        .mpctx = mpctx,
+        .image = talloc_steal(job, img),
+        .filename = talloc_steal(job, filename),
+        .opts = *mpctx->opts->screenshot_image_opts,
+    };
+
+    mp_core_unlock(mpctx);
+    pthread_mutex_lock(&ctx->lock);
+    while (ctx->num_queued >= max)
+        pthread_cond_wait(&ctx->wakeup, &ctx->lock);
+    MP_TARRAY_APPEND(ctx, ctx->queued_names, ctx->num_queued, job->filename);
+    pthread_mutex_unlock(&ctx->lock);
+    mp_core_lock(mpctx);
+
+    mpctx->outstanding_async += 1; // prevent that core disappears
+    if (!mp_thread_pool_queue_prio(mpctx->thread_pool, MP_THREAD_POOL_PRIO_LOW,
+                                   write_job_run, job))
+    {
+        mp_core_unlock(mpctx);
+        write_job_run(job);
+        mp_core_lock(mpctx);
+    }
+}
+
+// Whether a background write to this file is still in progress.
+static bool is_queued(screenshot_ctx *ctx, const char *filename)
+{
+    bool res = false;
+    pthread_mutex_lock(&ctx->lock);
+    for (int n = 0; n < ctx->num_queued; n++)
+        res |= strcmp(ctx->queued_names[n], filename) == 0;
+    pthread_mutex_unlock(&ctx->lock);
+    return res;
+}
+
 #ifdef _WIN32
 #define ILLEGAL_FILENAME_CHARS "?\"/\\<>*|:"
 #else
@@ -307,7 +415,7 @@ static char *gen_fname(struct mp_cmd_ctx *cmd, const char *file_ext)
             mp_mkdirp(full_dir);
         }
 
-        if (!mp_path_exists(fname))
+        if (!mp_path_exists(fname) && !is_queued(ctx, fname))
             return fname;
 
         if (sequence == prev_sequence) {
@@ -485,8 +593,15 @@ void cmd_screenshot(void *p)
 
     if (image) {
         char *filename = gen_fname(cmd, image_writer_file_ext(opts));
-        if (filename)
+        if (filename && each_frame_mode && mpctx->opts->screenshot_queue) {
+            // Let the next frame's screenshot be taken while this is written.
+            queue_screenshot(mpctx, image, filename);
+            image = NULL;
+            filename = NULL;
+            cmd->success = true;
+        } else if (filename) {
             cmd->success = write_screenshot(cmd, image, filename, NULL);
+        }
         talloc_free(filename);
     } else {
         mp_cmd_msg(cmd, MSGL_ERR, "Taking screenshot failed.");
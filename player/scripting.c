@@ -29,14 +29,19 @@
 #include "osdep/io.h"
 #include "osdep/subprocess.h"
 #include "osdep/threads.h"
+#include "osdep/timer.h"
 
 #include "common/common.h"
 #include "common/msg.h"
+#include "common/stats.h"
 #include "input/input.h"
 #include "options/m_config.h"
 #include "options/parse_configfile.h"
 #include "options/path.h"
 #include "misc/bstr.h"
+#include "misc/natural_sort.h"
+#include "misc/thread_pool.h"
+#include "video/out/vo.h"
 #include "core.h"
 #include "client.h"
 #include "libmpv/client.h"
@@ -81,14 +86,227 @@ static char *script_name_from_filename(void *talloc_ctx, const char *fname)
     return talloc_asprintf(talloc_ctx, "%s", name);
 }
 
+// Shared by all scripts running as tasks (--script-threads).
+struct mp_script_pool {
+    struct mp_thread_pool *threads;
+    pthread_t timer_thread;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;      // for the timer thread
+    // -- protected by lock
+    struct mp_script_task **timers; // tasks with deadline set
+    int num_timers;
+    bool terminate;
+};
+
+// A script that is run on the pool each time its client is woken up, or its
+// timeout expires.
+struct mp_script_task {
+    struct mp_script_pool *pool;
+    struct mpv_handle *client;
+    // returns false if the script exited
+    bool (*run)(struct mp_script_task *task, void *ctx);
+    void (*destroy)(void *ctx); // must destroy the client too
+    void *ctx;
+    // -- protected by pool->lock
+    int64_t deadline;           // mp_time_us() time, 0 if unset
+    bool queued, running, rerun;
+};
+
+static void run_task(void *p);
+
+static void remove_timer_locked(struct mp_script_task *task)
+{
+    struct mp_script_pool *pool = task->pool;
+    for (int n = 0; n < pool->num_timers; n++) {
+        if (pool->timers[n] == task) {
+            MP_TARRAY_REMOVE_AT(pool->timers, pool->num_timers, n);
+            break;
+        }
+    }
+    task->deadline = 0;
+}
+
+static void queue_task_locked(struct mp_script_task *task)
+{
+    if (task->running) {
+        task->rerun = true;
+    } else if (!task->queued) {
+        task->queued = true;
+        mp_thread_pool_queue(task->pool->threads, run_task, task);
+    }
+}
+
+static void wakeup_task(void *p)
+{
+    struct mp_script_task *task = p;
+    pthread_mutex_lock(&task->pool->lock);
+    queue_task_locked(task);
+    pthread_mutex_unlock(&task->pool->lock);
+}
+
+static void run_task(void *p)
+{
+    struct mp_script_task *task = p;
+    struct mp_script_pool *pool = task->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    task->queued = false;
+    task->running = true;
+    task->rerun = false;
+    remove_timer_locked(task);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!task->run(task, task->ctx)) {
+        // Once this returns, the wakeup callback can't run anymore. Since the
+        // task is marked as running, it can't have been queued again either.
+        mpv_set_wakeup_callback(task->client, NULL, NULL);
+        pthread_mutex_lock(&pool->lock);
+        remove_timer_locked(task);
+        pthread_mutex_unlock(&pool->lock);
+        task->destroy(task->ctx);
+        talloc_free(task);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    task->running = false;
+    if (task->rerun)
+        queue_task_locked(task);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+static void *timer_thread(void *p)
+{
+    struct mp_script_pool *pool = p;
+    mpthread_set_name("script timers");
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->terminate) {
+        int64_t now = mp_time_us();
+        int64_t next = INT64_MAX;
+        for (int n = pool->num_timers - 1; n >= 0; n--) {
+            struct mp_script_task *task = pool->timers[n];
+            if (task->deadline <= now) {
+                remove_timer_locked(task);
+                queue_task_locked(task);
+            } else {
+                next = MPMIN(next, task->deadline);
+            }
+        }
+        if (next == INT64_MAX) {
+            pthread_cond_wait(&pool->wakeup, &pool->lock);
+        } else {
+            struct timespec ts = mp_time_us_to_timespec(next);
+            pthread_cond_timedwait(&pool->wakeup, &pool->lock, &ts);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+
+static struct mp_script_pool *get_script_pool(struct MPContext *mpctx)
+{
+    if (mpctx->script_pool)
+        return mpctx->script_pool;
+
+    int num_threads = mpctx->opts->script_threads;
+    struct mp_script_pool *pool = talloc_zero(NULL, struct mp_script_pool);
+    pool->threads = mp_thread_pool_create(pool, 1, 1, num_threads);
+    if (!pool->threads) {
+        talloc_free(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wakeup, NULL);
+    if (pthread_create(&pool->timer_thread, NULL, timer_thread, pool)) {
+        pthread_cond_destroy(&pool->wakeup);
+        pthread_mutex_destroy(&pool->lock);
+        talloc_free(pool);
+        return NULL;
+    }
+
+    MP_VERBOSE(mpctx, "Running scripts on up to %d threads.\n", num_threads);
+    mpctx->script_pool = pool;
+    return pool;
+}
+
+// Must be called after all clients were destroyed.
+void mp_script_pool_destroy(struct MPContext *mpctx)
+{
+    struct mp_script_pool *pool = mpctx->script_pool;
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->terminate = true;
+    pthread_cond_signal(&pool->wakeup);
+    pthread_mutex_unlock(&pool->lock);
+    pthread_join(pool->timer_thread, NULL);
+
+    // Waits until tasks which destroyed their client have returned.
+    talloc_free(pool->threads);
+    assert(!pool->num_timers);
+
+    pthread_cond_destroy(&pool->wakeup);
+    pthread_mutex_destroy(&pool->lock);
+    talloc_free(pool);
+    mpctx->script_pool = NULL;
+}
+
+// Continue running the script as task. run(ctx) is called on a pool thread
+// whenever the client is woken up, or the timeout set by
+// mp_script_task_set_timeout() expires. Calls never overlap. Once run()
+// returns false, destroy(ctx) is called and the task is freed. args is
+// reparented to the task.
+struct mp_script_task *mp_script_task_create(struct mp_script_args *args,
+        bool (*run)(struct mp_script_task *task, void *ctx),
+        void (*destroy)(void *ctx), void *ctx)
+{
+    assert(args->pool);
+    struct mp_script_task *task = talloc_ptrtype(NULL, task);
+    *task = (struct mp_script_task){
+        .pool = args->pool,
+        .client = args->client,
+        .run = run,
+        .destroy = destroy,
+        .ctx = ctx,
+    };
+    talloc_steal(task, args);
+    // This queues the first run.
+    mpv_set_wakeup_callback(task->client, wakeup_task, task);
+    return task;
+}
+
+// Run the task again after the given number of seconds, even if there are no
+// new events. A negative value clears the timeout. Only valid within run().
+void mp_script_task_set_timeout(struct mp_script_task *task, double timeout)
+{
+    struct mp_script_pool *pool = task->pool;
+    pthread_mutex_lock(&pool->lock);
+    remove_timer_locked(task);
+    if (timeout >= 0) {
+        task->deadline = MPMAX(mp_add_timeout(mp_time_us(), timeout), 1);
+        MP_TARRAY_APPEND(pool, pool->timers, pool->num_timers, task);
+        pthread_cond_signal(&pool->wakeup);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
 static void run_script(struct mp_script_args *arg)
 {
-    char name[90];
-    snprintf(name, sizeof(name), "%s (%s)", arg->backend->name,
-             mpv_client_name(arg->client));
-    mpthread_set_name(name);
+    if (!arg->pool) {
+        char name[90];
+        snprintf(name, sizeof(name), "%s (%s)", arg->backend->name,
+                 mpv_client_name(arg->client));
+        mpthread_set_name(name);
+    }
 
-    if (arg->backend->load(arg) < 0)
+    int r = arg->backend->load(arg);
+    if (r == 1)
+        return; // continues as task
+    if (r < 0)
         MP_ERR(arg, "Could not load %s %s\n", arg->backend->name, arg->filename);
 
     mpv_destroy(arg->client);
@@ -105,6 +323,11 @@ static void *script_thread(void *p)
     return NULL;
 }
 
+static void script_pool_load(void *p)
+{
+    run_script(p);
+}
+
 static int64_t mp_load_script(struct MPContext *mpctx, const char *fname)
 {
     char *ext = mp_splitext(fname, NULL);
@@ -184,12 +407,21 @@ static int64_t mp_load_script(struct MPContext *mpctx, const char *fname)
 
     mp_client_set_weak(arg->client);
     arg->log = mp_client_get_log(arg->client);
+    if (mpctx->opts->script_bytecode_cache) {
+        arg->cache_dir =
+            mp_find_user_config_file(arg, mpctx->global, "script_cache");
+    }
     int64_t id = mpv_client_id(arg->client);
 
     MP_DBG(arg, "Loading %s %s...\n", backend->name, arg->filename);
 
+    if (backend->tasks && mpctx->opts->script_threads > 0)
+        arg->pool = get_script_pool(mpctx);
+
     if (backend->no_thread) {
         run_script(arg);
+    } else if (arg->pool) {
+        mp_thread_pool_queue(arg->pool->threads, script_pool_load, arg);
     } else {
         pthread_t thread;
         if (pthread_create(&thread, NULL, script_thread, arg)) {
@@ -210,13 +442,6 @@ int64_t mp_load_user_script(struct MPContext *mpctx, const char *fname)
     return ret;
 }
 
-static int compare_filename(const void *pa, const void *pb)
-{
-    char *a = (char *)pa;
-    char *b = (char *)pb;
-    return strcmp(a, b);
-}
-
 static char **list_script_files(void *talloc_ctx, char *path)
 {
     char **files = NULL;
@@ -234,14 +459,25 @@ static char **list_script_files(void *talloc_ctx, char *path)
         }
     }
     closedir(dp);
-    if (files)
-        qsort(files, count, sizeof(char *), compare_filename);
+    mp_natural_sort_strings(files, count);
     MP_TARRAY_APPEND(talloc_ctx, files, count, NULL);
     return files;
 }
 
+// Whether there is (or will be) no VO the OSD based scripts could be used
+// with, such as with --vo=null or --no-video.
+static bool headless_ui(struct MPContext *mpctx)
+{
+    if (mpctx->video_out)
+        return mpctx->video_out->driver->headless;
+    if (mpctx->opts->stream_id[0][STREAM_VIDEO] == -2 && !mpctx->opts->force_vo)
+        return true;
+    return vo_list_is_headless(mpctx->global);
+}
+
+// If defer is set, a script that is not loaded yet is not loaded now either.
 static void load_builtin_script(struct MPContext *mpctx, int slot, bool enable,
-                                const char *fname)
+                                bool defer, const char *fname)
 {
     assert(slot < MP_ARRAY_SIZE(mpctx->builtin_script_ids));
     int64_t *pid = &mpctx->builtin_script_ids[slot];
@@ -249,6 +485,10 @@ static void load_builtin_script(struct MPContext *mpctx, int slot, bool enable,
         *pid = 0; // died
     if ((*pid > 0) != enable) {
         if (enable) {
+            if (defer) {
+                MP_VERBOSE(mpctx, "Not loading %s without a VO.\n", fname);
+                return;
+            }
             *pid = mp_load_script(mpctx, fname);
         } else {
             char *name = mp_tprintf(22, "@%"PRIi64, *pid);
@@ -257,14 +497,21 @@ static void load_builtin_script(struct MPContext *mpctx, int slot, bool enable,
     }
 }
 
+// Also called when a VO is created, to load the scripts which were deferred
+// because they are useless without one.
 void mp_load_builtin_scripts(struct MPContext *mpctx)
 {
-    load_builtin_script(mpctx, 0, mpctx->opts->lua_load_osc, "@osc.lua");
-    load_builtin_script(mpctx, 1, mpctx->opts->lua_load_ytdl, "@ytdl_hook.lua");
-    load_builtin_script(mpctx, 2, mpctx->opts->lua_load_stats, "@stats.lua");
-    load_builtin_script(mpctx, 3, mpctx->opts->lua_load_console, "@console.lua");
-    load_builtin_script(mpctx, 4, mpctx->opts->lua_load_auto_profiles,
+    struct MPOpts *opts = mpctx->opts;
+    bool headless = headless_ui(mpctx);
+    stats_startup_begin(mpctx->global, "load-builtin-scripts");
+    load_builtin_script(mpctx, 0, opts->lua_load_osc, headless, "@osc.lua");
+    load_builtin_script(mpctx, 1, opts->lua_load_ytdl, false, "@ytdl_hook.lua");
+    load_builtin_script(mpctx, 2, opts->lua_load_stats, headless, "@stats.lua");
+    load_builtin_script(mpctx, 3, opts->lua_load_console, headless,
+                        "@console.lua");
+    load_builtin_script(mpctx, 4, opts->lua_load_auto_profiles, false,
                         "@auto_profiles.lua");
+    stats_startup_end(mpctx->global, "load-builtin-scripts");
 }
 
 bool mp_load_scripts(struct MPContext *mpctx)
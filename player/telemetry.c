@@ -0,0 +1,224 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+
+#if HAVE_POSIX
+#include <sys/mman.h>
+#endif
+
+#include "mpv_talloc.h"
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "common/stats.h"
+#include "demux/demux.h"
+#include "filters/f_decoder_wrapper.h"
+#include "options/path.h"
+#include "osdep/io.h"
+#include "osdep/timer.h"
+#include "video/out/vo.h"
+
+#include "core.h"
+#include "telemetry.h"
+
+struct mp_telemetry_ctx {
+    char *path;         // as set with the option
+    int fd;
+    struct mp_telemetry *page;
+    unsigned seq;
+    double next_stats_update;
+};
+
+// The shared page is useless without real (lock-free) atomics.
+#define TELEMETRY_SUPPORTED (HAVE_POSIX && HAVE_STDATOMIC)
+
+void mp_telemetry_uninit(struct MPContext *mpctx)
+{
+    struct mp_telemetry_ctx *ctx = mpctx->telemetry;
+    if (!ctx)
+        return;
+
+#if TELEMETRY_SUPPORTED
+    if (ctx->page) {
+        atomic_store_explicit(&ctx->page->seq, ++ctx->seq, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        ctx->page->pid = 0;
+        atomic_store_explicit(&ctx->page->seq, ++ctx->seq, memory_order_release);
+        munmap(ctx->page, sizeof(*ctx->page));
+    }
+#endif
+    if (ctx->fd >= 0)
+        close(ctx->fd);
+
+    TA_FREEP(&mpctx->telemetry);
+}
+
+void mp_telemetry_reinit(struct MPContext *mpctx)
+{
+    char *opt = mpctx->opts->telemetry_path;
+    if (!opt || !opt[0]) {
+        mp_telemetry_uninit(mpctx);
+        return;
+    }
+
+    if (mpctx->telemetry && strcmp(mpctx->telemetry->path, opt) == 0)
+        return;
+
+    mp_telemetry_uninit(mpctx);
+
+#if TELEMETRY_SUPPORTED
+    struct mp_telemetry_ctx *ctx = talloc_ptrtype(NULL, ctx);
+    *ctx = (struct mp_telemetry_ctx){
+        .path = talloc_strdup(ctx, opt),
+        .fd = -1,
+    };
+
+    char *path = mp_get_user_path(ctx, mpctx->global, opt);
+    ctx->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (ctx->fd < 0 || ftruncate(ctx->fd, sizeof(*ctx->page)) < 0) {
+        MP_ERR(mpctx, "Could not create telemetry file '%s'.\n", path);
+        goto error;
+    }
+
+    void *p = mmap(NULL, sizeof(*ctx->page), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, ctx->fd, 0);
+    if (p == MAP_FAILED) {
+        MP_ERR(mpctx, "Could not map telemetry file '%s'.\n", path);
+        goto error;
+    }
+    ctx->page = p;
+
+    // Start with an odd seq, so readers wait for the first complete update.
+    memset(ctx->page, 0, sizeof(*ctx->page));
+    ctx->seq = 1;
+    atomic_store_explicit(&ctx->page->seq, ctx->seq, memory_order_relaxed);
+    ctx->page->version = MP_TELEMETRY_VERSION;
+    ctx->page->size = sizeof(*ctx->page);
+    atomic_thread_fence(memory_order_release);
+    ctx->page->magic = MP_TELEMETRY_MAGIC;
+
+    mpctx->telemetry = ctx;
+    MP_VERBOSE(mpctx, "Writing telemetry to '%s'.\n", path);
+    mp_telemetry_update(mpctx);
+    return;
+
+error:
+    if (ctx->fd >= 0)
+        close(ctx->fd);
+    talloc_free(ctx);
+#else
+    MP_ERR(mpctx, "--telemetry-file is not supported on this platform.\n");
+#endif
+}
+
+#if TELEMETRY_SUPPORTED
+static void add_stat(void *p, const char *name, double val)
+{
+    struct mp_telemetry *t = p;
+    if (t->num_stats >= MP_TELEMETRY_MAX_STATS)
+        return;
+    struct mp_telemetry_stat *st = &t->stats[t->num_stats++];
+    snprintf(st->name, sizeof(st->name), "%s", name);
+    st->value = val;
+}
+
+static double nopts_to_nan(double v)
+{
+    return v == MP_NOPTS_VALUE ? NAN : v;
+}
+#endif
+
+void mp_telemetry_update(struct MPContext *mpctx)
+{
+    struct mp_telemetry_ctx *ctx = mpctx->telemetry;
+    if (!ctx)
+        return;
+
+#if TELEMETRY_SUPPORTED
+    // Gather everything first, to keep the write-side critical section short.
+    struct mp_telemetry t = {
+        .update_time_us = mp_time_us(),
+        .pid = getpid(),
+        .time_pos = NAN,
+        .duration = NAN,
+        .speed = mpctx->opts->playback_speed,
+        .avsync = mpctx->last_av_difference,
+        .cache_duration = NAN,
+        .cache_bytes = -1,
+        .decoder_drop_count = -1,
+        .vo_drop_count = -1,
+        .vo_delayed_count = -1,
+    };
+
+    if (mpctx->playback_initialized) {
+        t.flags |= MP_TELEMETRY_PLAYING;
+        t.time_pos = nopts_to_nan(get_current_time(mpctx));
+        t.duration = nopts_to_nan(get_time_length(mpctx));
+    }
+    if (mpctx->opts->pause)
+        t.flags |= MP_TELEMETRY_PAUSED;
+    if (!mpctx->playback_active)
+        t.flags |= MP_TELEMETRY_CORE_IDLE;
+    if (mpctx->paused_for_cache)
+        t.flags |= MP_TELEMETRY_BUFFERING;
+
+    if (mpctx->demuxer) {
+        struct demux_reader_state s;
+        demux_get_reader_state(mpctx->demuxer, &s);
+        if (s.ts_duration >= 0)
+            t.cache_duration = s.ts_duration;
+        t.cache_bytes = s.fw_bytes;
+    }
+
+    if (mpctx->vo_chain) {
+        struct mp_decoder_wrapper *dec = mpctx->vo_chain->track
+            ? mpctx->vo_chain->track->dec : NULL;
+        if (dec)
+            t.decoder_drop_count = mp_decoder_wrapper_get_frames_dropped(dec);
+        t.vo_drop_count = vo_get_drop_count(mpctx->video_out);
+        t.vo_delayed_count = vo_get_delayed_count(mpctx->video_out);
+    }
+
+    double now = mp_time_sec();
+    bool update_stats = now >= ctx->next_stats_update;
+    if (update_stats) {
+        stats_global_read_values(mpctx->global, add_stat, &t);
+        ctx->next_stats_update = now + 1.0;
+    }
+
+    struct mp_telemetry *page = ctx->page;
+
+    if (!(ctx->seq & 1))
+        atomic_store_explicit(&page->seq, ++ctx->seq, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    // Copy everything past seq; the header fields never change.
+    t.update_count = page->update_count + 1;
+    size_t start = offsetof(struct mp_telemetry, update_count);
+    size_t end = update_stats ? sizeof(t)
+                              : offsetof(struct mp_telemetry, num_stats);
+    memcpy((char *)page + start, (char *)&t + start, end - start);
+
+    atomic_store_explicit(&page->seq, ++ctx->seq, memory_order_release);
+#endif
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPLAYER_TELEMETRY_H
+#define MPLAYER_TELEMETRY_H
+
+#include <stdint.h>
+
+#include "osdep/atomic.h"
+
+struct MPContext;
+
+/* Layout of the file written with --telemetry-file. All fields use the
+ * native byte order and alignment. Readers must use the seqlock: read seq,
+ * retry while it's odd, copy the struct, and retry if seq changed meanwhile.
+ * New fields are only ever appended (check size), incompatible changes bump
+ * version.
+ */
+
+#define MP_TELEMETRY_MAGIC      0x5456504d // "MPVT" in little endian
+#define MP_TELEMETRY_VERSION    1
+#define MP_TELEMETRY_MAX_STATS  32
+
+enum mp_telemetry_flags {
+    MP_TELEMETRY_PLAYING        = 1 << 0,   // a file is loaded
+    MP_TELEMETRY_PAUSED         = 1 << 1,   // pause property
+    MP_TELEMETRY_CORE_IDLE      = 1 << 2,   // core-idle property
+    MP_TELEMETRY_BUFFERING      = 1 << 3,   // paused-for-cache property
+};
+
+struct mp_telemetry_stat {
+    char name[56];                  // 0-terminated
+    double value;
+};
+
+struct mp_telemetry {
+    uint32_t magic;                 // MP_TELEMETRY_MAGIC
+    uint32_t version;               // MP_TELEMETRY_VERSION
+    uint32_t size;                  // sizeof(struct mp_telemetry)
+    atomic_uint seq;                // odd while an update is in progress
+    int64_t update_count;           // incremented on each update
+    int64_t update_time_us;         // player clock, only differences matter
+    int32_t pid;                    // 0 after the player exited
+    uint32_t flags;                 // enum mp_telemetry_flags
+    double time_pos;                // time-pos, NAN if unavailable
+    double duration;                // duration, NAN if unavailable
+    double speed;                   // speed
+    double avsync;                  // avsync
+    double cache_duration;          // demuxer-cache-duration, or NAN
+    int64_t cache_bytes;            // demuxer-cache-state/fw-bytes, or -1
+    int64_t decoder_drop_count;     // decoder-frame-drop-count, or -1
+    int64_t vo_drop_count;          // frame-drop-count, or -1
+    int64_t vo_delayed_count;       // vo-delayed-frame-count, or -1
+    uint32_t num_stats;
+    uint32_t reserved;
+    // Static values of the internal stats (like in stats.lua's page 4).
+    // Updated at most once per second.
+    struct mp_telemetry_stat stats[MP_TELEMETRY_MAX_STATS];
+};
+
+// Open or close the file according to the current options.
+void mp_telemetry_reinit(struct MPContext *mpctx);
+void mp_telemetry_uninit(struct MPContext *mpctx);
+
+// Called by the playback core on each iteration.
+void mp_telemetry_update(struct MPContext *mpctx);
+
+#endif
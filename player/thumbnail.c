@@ -0,0 +1,342 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/cpu.h>
+
+#include "mpv_talloc.h"
+
+#include "common/av_common.h"
+#include "common/global.h"
+#include "common/msg.h"
+#include "demux/demux.h"
+#include "demux/packet.h"
+#include "demux/stheader.h"
+#include "input/cmd.h"
+#include "misc/node.h"
+#include "misc/thread_pool.h"
+#include "misc/thread_tools.h"
+#include "stream/stream.h"
+#include "video/mp_image.h"
+#include "video/sws_utils.h"
+
+#include "command.h"
+#include "core.h"
+
+// Give up on a timestamp after reading this many packets without getting a
+// decoded keyframe (broken keyframe flags, or no video after the seek point).
+#define MAX_PACKETS 2000
+
+// Maximum number of parallel pipelines.
+#define MAX_WORKERS 16
+
+// Each worker opens its own demuxer and decoder (no VO, no filters), and
+// processes the entries n*num_workers+index of the sorted timestamp list, so
+// that every worker seeks forward through the file.
+
+struct thumb_entry {
+    double time;            // requested
+    int index;              // position in the command's timestamp list
+    struct mp_image *img;   // result (BGR0), or NULL on failure
+};
+
+struct thumb_job {
+    struct mpv_global *global;
+    struct mp_log *log;
+    struct mp_cancel *cancel;
+    const char *url;
+    int w, h;
+    struct thumb_entry *entries;
+    int num_entries;
+    int worker, num_workers;
+};
+
+static struct sh_stream *select_video(struct demuxer *demux)
+{
+    for (int n = 0; n < demux_get_num_stream(demux); n++) {
+        struct sh_stream *sh = demux_get_stream(demux, n);
+        if (sh->type == STREAM_VIDEO && !sh->attached_picture) {
+            demuxer_select_track(demux, sh, MP_NOPTS_VALUE, true);
+            return sh;
+        }
+    }
+    return NULL;
+}
+
+static AVCodecContext *open_decoder(struct mp_log *log, struct mp_codec_params *c)
+{
+    const AVCodec *codec = avcodec_find_decoder(mp_codec_to_av_codec_id(c->codec));
+    if (!codec) {
+        mp_err(log, "No decoder for codec '%s'.\n", c->codec ? c->codec : "?");
+        return NULL;
+    }
+    AVCodecContext *avctx = avcodec_alloc_context3(codec);
+    if (!avctx)
+        return NULL;
+    avctx->pkt_timebase = mp_get_codec_timebase(c);
+    // Parallelism comes from running several pipelines instead.
+    avctx->thread_count = 1;
+    avctx->skip_frame = AVDISCARD_NONKEY;
+    if (mp_set_avctx_codec_headers(avctx, c) < 0 ||
+        avcodec_open2(avctx, codec, NULL) < 0)
+    {
+        mp_err(log, "Could not open decoder.\n");
+        avcodec_free_context(&avctx);
+    }
+    return avctx;
+}
+
+// Seek to the keyframe before entry->time, and decode it.
+static struct mp_image *decode_keyframe(struct thumb_job *job,
+                                        struct demuxer *demux,
+                                        struct mp_codec_params *c,
+                                        AVCodecContext *avctx, AVFrame *frame,
+                                        double time)
+{
+    AVRational tb = avctx->pkt_timebase;
+    struct mp_image *res = NULL;
+
+    avcodec_flush_buffers(avctx);
+    demux_seek(demux, time, 0);
+
+    bool eof = false;
+    for (int n = 0; n < MAX_PACKETS && !mp_cancel_test(job->cancel); n++) {
+        int ret = avcodec_receive_frame(avctx, frame);
+        if (ret >= 0) {
+            res = mp_image_from_av_frame(frame);
+            if (res)
+                res->pts = mp_pts_from_av(frame->pts, &tb);
+            av_frame_unref(frame);
+            break;
+        }
+        if (ret != AVERROR(EAGAIN) || eof)
+            break;
+
+        struct demux_packet *pkt = demux_read_any_packet(demux);
+        if (pkt && !pkt->keyframe) {
+            talloc_free(pkt);
+            continue;
+        }
+        AVPacket avpkt;
+        mp_set_av_packet(&avpkt, pkt, &tb);
+        eof = !pkt;
+        avcodec_send_packet(avctx, pkt ? &avpkt : NULL);
+        talloc_free(pkt);
+    }
+
+    if (!res)
+        return NULL;
+
+    if (c->par_w > 0 && c->par_h > 0) {
+        res->params.p_w = c->par_w;
+        res->params.p_h = c->par_h;
+    }
+    mp_image_params_guess_csp(&res->params);
+    return res;
+}
+
+static struct mp_image *scale_image(struct thumb_job *job,
+                                    struct mp_sws_context *sws,
+                                    struct mp_image *src)
+{
+    int d_w, d_h;
+    mp_image_params_get_dsize(&src->params, &d_w, &d_h);
+    int w = job->w > 0 ? job->w : -1;
+    int h = job->h > 0 ? job->h : -1;
+    if (w < 0 && h < 0)
+        w = d_w;
+    if (w < 0)
+        w = MPMAX(lrint(h * (double)d_w / d_h), 1);
+    if (h < 0)
+        h = MPMAX(lrint(w * (double)d_h / d_w), 1);
+
+    struct mp_image *dst = mp_image_alloc(IMGFMT_BGR0, w, h);
+    if (!dst)
+        return NULL;
+    if (mp_sws_scale(sws, dst, src) < 0)
+        TA_FREEP(&dst);
+    return dst;
+}
+
+static void run_worker(void *p)
+{
+    struct thumb_job *job = p;
+    void *tmp = talloc_new(NULL);
+
+    struct demuxer_params params = {
+        .is_top_level = true,
+        .stream_flags = STREAM_ORIGIN_DIRECT,
+    };
+    struct demuxer *demux =
+        demux_open_url(job->url, &params, job->cancel, job->global);
+    if (!demux) {
+        mp_err(job->log, "Could not open '%s'.\n", job->url);
+        goto done;
+    }
+
+    struct sh_stream *sh = select_video(demux);
+    if (!sh) {
+        mp_err(job->log, "No video stream.\n");
+        goto done;
+    }
+
+    AVCodecContext *avctx = open_decoder(job->log, sh->codec);
+    AVFrame *frame = av_frame_alloc();
+    struct mp_sws_context *sws = mp_sws_alloc(tmp);
+    mp_sws_enable_cmdline_opts(sws, job->global);
+
+    for (int n = job->worker; n < job->num_entries && avctx && frame;
+         n += job->num_workers)
+    {
+        if (mp_cancel_test(job->cancel))
+            break;
+        struct thumb_entry *e = &job->entries[n];
+        struct mp_image *img =
+            decode_keyframe(job, demux, sh->codec, avctx, frame, e->time);
+        if (img) {
+            e->img = scale_image(job, sws, img);
+            if (e->img)
+                e->img->pts = img->pts;
+        }
+        if (!e->img)
+            mp_warn(job->log, "No keyframe for time %f.\n", e->time);
+        talloc_free(img);
+    }
+
+    av_frame_free(&frame);
+    avcodec_free_context(&avctx);
+
+done:
+    demux_free(demux);
+    talloc_free(tmp);
+}
+
+static int compare_time(const void *pa, const void *pb)
+{
+    const struct thumb_entry *a = pa, *b = pb;
+    return a->time < b->time ? -1 : (a->time > b->time);
+}
+
+static int compare_index(const void *pa, const void *pb)
+{
+    const struct thumb_entry *a = pa, *b = pb;
+    return a->index - b->index;
+}
+
+void cmd_extract_thumbnails(void *p)
+{
+    struct mp_cmd_ctx *cmd = p;
+    struct MPContext *mpctx = cmd->mpctx;
+    char **times = cmd->args[1].v.str_list;
+
+    void *tmp = talloc_new(NULL);
+    struct mp_log *log = mp_log_new(tmp, mpctx->log, "thumbnail");
+
+    struct thumb_entry *entries = NULL;
+    int num_entries = 0;
+    for (int n = 0; times && times[n]; n++) {
+        char *end;
+        double t = strtod(times[n], &end);
+        if (end == times[n] || *end || !isfinite(t)) {
+            mp_cmd_msg(cmd, MSGL_ERR, "Invalid timestamp: '%s'", times[n]);
+            cmd->success = false;
+            goto done;
+        }
+        struct thumb_entry e = {.time = t, .index = num_entries};
+        MP_TARRAY_APPEND(tmp, entries, num_entries, e);
+    }
+    qsort(entries, num_entries, sizeof(entries[0]), compare_time);
+
+    int num_workers = cmd->args[4].v.i;
+    if (num_workers <= 0)
+        num_workers = av_cpu_count();
+    num_workers = MPCLAMP(MPMIN(num_workers, num_entries), 1, MAX_WORKERS);
+
+    struct thumb_job *jobs = talloc_zero_array(tmp, struct thumb_job, num_workers);
+    for (int n = 0; n < num_workers; n++) {
+        jobs[n] = (struct thumb_job){
+            .global = mpctx->global,
+            .log = log,
+            .cancel = cmd->abort->cancel,
+            .url = cmd->args[0].v.s,
+            .w = cmd->args[2].v.i,
+            .h = cmd->args[3].v.i,
+            .entries = entries,
+            .num_entries = num_entries,
+            .worker = n,
+            .num_workers = num_workers,
+        };
+    }
+
+    mp_core_unlock(mpctx);
+
+    // Run the first job on this thread. Freeing the pool waits for the rest.
+    struct mp_thread_pool *pool =
+        mp_thread_pool_create(NULL, 0, 0, MPMAX(num_workers - 1, 1));
+    for (int n = 1; n < num_workers; n++) {
+        if (!mp_thread_pool_queue(pool, run_worker, &jobs[n]))
+            run_worker(&jobs[n]);
+    }
+    run_worker(&jobs[0]);
+    talloc_free(pool);
+
+    mp_core_lock(mpctx);
+
+    if (mp_cancel_test(cmd->abort->cancel)) {
+        cmd->success = false;
+        goto done;
+    }
+
+    // Return the results in the order the timestamps were passed.
+    qsort(entries, num_entries, sizeof(entries[0]), compare_index);
+
+    struct mpv_node *res = &cmd->result;
+    node_init(res, MPV_FORMAT_NODE_ARRAY, NULL);
+    bool found = false;
+    for (int n = 0; n < num_entries; n++) {
+        struct thumb_entry *e = &entries[n];
+        struct mpv_node *m = node_array_add(res, MPV_FORMAT_NODE_MAP);
+        node_map_add_double(m, "time", e->time);
+        struct mp_image *img = e->img;
+        if (!img)
+            continue;
+        if (img->pts != MP_NOPTS_VALUE)
+            node_map_add_double(m, "pts", img->pts);
+        node_map_add_int64(m, "w", img->w);
+        node_map_add_int64(m, "h", img->h);
+        node_map_add_int64(m, "stride", img->stride[0]);
+        node_map_add_string(m, "format", "bgr0");
+        struct mpv_byte_array *ba =
+            node_map_add(m, "data", MPV_FORMAT_BYTE_ARRAY)->u.ba;
+        *ba = (struct mpv_byte_array){
+            .data = img->planes[0],
+            .size = img->stride[0] * img->h,
+        };
+        talloc_steal(ba, img);
+        e->img = NULL;
+        found = true;
+    }
+    cmd->success = found || !num_entries;
+
+done:
+    for (int n = 0; n < num_entries; n++)
+        talloc_free(entries[n].img);
+    talloc_free(tmp);
+}
@@ -17,6 +17,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <string.h>
 #include <inttypes.h>
 #include <math.h>
 #include <assert.h>
@@ -30,6 +31,7 @@
 #include "options/m_option.h"
 #include "common/common.h"
 #include "common/encode.h"
+#include "common/stats.h"
 #include "options/m_property.h"
 #include "osdep/timer.h"
 
@@ -71,6 +73,46 @@ static bool recreate_video_filters(struct MPContext *mpctx)
     return mp_output_chain_update_filters(vo_c->filter, opts->vf_settings);
 }
 
+static void scrub_cache_clear(struct vo_chain *vo_c)
+{
+    for (int n = 0; n < vo_c->num_scrub_cache; n++)
+        talloc_free(vo_c->scrub_cache[n]);
+    vo_c->num_scrub_cache = 0;
+}
+
+// Move the entry with the given PTS to the front, and return it (or NULL).
+static struct mp_image *scrub_cache_find(struct vo_chain *vo_c, double pts)
+{
+    for (int n = 0; n < vo_c->num_scrub_cache; n++) {
+        struct mp_image *img = vo_c->scrub_cache[n];
+        if (img->pts == pts) {
+            memmove(&vo_c->scrub_cache[1], &vo_c->scrub_cache[0],
+                    n * sizeof(vo_c->scrub_cache[0]));
+            vo_c->scrub_cache[0] = img;
+            return img;
+        }
+    }
+    return NULL;
+}
+
+static void scrub_cache_add(struct vo_chain *vo_c, struct mp_image *img)
+{
+    // Hardware frames would keep decoder surfaces busy.
+    if (img->pts == MP_NOPTS_VALUE || IMGFMT_IS_HWACCEL(img->imgfmt) ||
+        scrub_cache_find(vo_c, img->pts))
+        return;
+    struct mp_image *ref = mp_image_new_ref(img);
+    if (!ref)
+        return;
+    int max = MP_ARRAY_SIZE(vo_c->scrub_cache);
+    if (vo_c->num_scrub_cache == max)
+        talloc_free(vo_c->scrub_cache[--vo_c->num_scrub_cache]);
+    memmove(&vo_c->scrub_cache[1], &vo_c->scrub_cache[0],
+            vo_c->num_scrub_cache * sizeof(vo_c->scrub_cache[0]));
+    vo_c->scrub_cache[0] = ref;
+    vo_c->num_scrub_cache++;
+}
+
 int reinit_video_filters(struct MPContext *mpctx)
 {
     struct vo_chain *vo_c = mpctx->vo_chain;
@@ -78,6 +120,8 @@ int reinit_video_filters(struct MPContext *mpctx)
     if (!vo_c)
         return 0;
 
+    scrub_cache_clear(vo_c);
+
     if (!recreate_video_filters(mpctx))
         return -1;
 
@@ -108,6 +152,8 @@ void reset_video_state(struct MPContext *mpctx)
         mp_image_unrefp(&mpctx->next_frames[n]);
     mpctx->num_next_frames = 0;
     mp_image_unrefp(&mpctx->saved_frame);
+    mp_image_unrefp(&mpctx->scrub_frame);
+    mpctx->scrub_skip_pts = MP_NOPTS_VALUE;
 
     mpctx->delay = 0;
     mpctx->time_frame = 0;
@@ -123,9 +169,30 @@ void reset_video_state(struct MPContext *mpctx)
     mpctx->video_status = mpctx->vo_chain ? STATUS_SYNCING : STATUS_EOF;
 }
 
+// Called after the seek reset of a scrub seek. The decoder skips everything
+// but keyframes, and if the target keyframe was shown by an earlier scrub
+// seek (and the demuxer cache already points to it), it's shown immediately.
+void video_start_scrub(struct MPContext *mpctx)
+{
+    struct vo_chain *vo_c = mpctx->vo_chain;
+    if (!vo_c || vo_c->is_coverart || !vo_c->track || !vo_c->track->dec)
+        return;
+
+    mp_decoder_wrapper_set_keyframes_only(vo_c->track->dec, true);
+
+    double pts = demux_get_reader_head_pts(vo_c->track->stream);
+    struct mp_image *img = scrub_cache_find(vo_c, pts);
+    if (img) {
+        MP_VERBOSE(mpctx, "Using cached keyframe at %f.\n", pts);
+        mpctx->scrub_frame = mp_image_new_ref(img);
+        mpctx->scrub_skip_pts = pts;
+    }
+}
+
 void uninit_video_out(struct MPContext *mpctx)
 {
     uninit_video_chain(mpctx);
+    free_standby_decoder(mpctx); // uses the VO
     if (mpctx->video_out) {
         vo_destroy(mpctx->video_out);
         mp_notify(mpctx, MPV_EVENT_VIDEO_RECONFIG, NULL);
@@ -148,6 +215,7 @@ static void vo_chain_uninit(struct vo_chain *vo_c)
     if (vo_c->filter_src)
         mp_pin_disconnect(vo_c->filter_src);
 
+    scrub_cache_clear(vo_c);
     talloc_free(vo_c->filter->f);
     talloc_free(vo_c);
     // this does not free the VO
@@ -182,6 +250,17 @@ int init_video_decoder(struct MPContext *mpctx, struct track *track)
     if (track->vo_c)
         parent = track->vo_c->filter->f;
 
+    if (mpctx->standby_vdec && mpctx->standby_vdec_stream == track->stream &&
+        track->vo_c && mpctx->standby_vdec_info.dr_vo == track->vo_c->vo)
+    {
+        MP_VERBOSE(mpctx, "Using prefetched video decoder.\n");
+        track->dec = mpctx->standby_vdec;
+        mpctx->standby_vdec = NULL;
+        mpctx->standby_vdec_stream = NULL;
+        mp_decoder_wrapper_attach(track->dec, parent);
+        return 1;
+    }
+
     track->dec = mp_decoder_wrapper_create(parent, track->stream);
     if (!track->dec)
         goto err_out;
@@ -227,10 +306,12 @@ void reinit_video_chain_src(struct MPContext *mpctx, struct track *track)
             .input_ctx = mpctx->input,
             .osd = mpctx->osd,
             .encode_lavc_ctx = mpctx->encode_lavc_ctx,
-            .wakeup_cb = mp_wakeup_core_cb,
+            .wakeup_cb = mp_wakeup_core_vo_cb,
             .wakeup_ctx = mpctx,
         };
+        stats_startup_begin(mpctx->global, "vo-create");
         mpctx->video_out = init_best_video_out(mpctx->global, &ex);
+        stats_startup_end(mpctx->global, "vo-create");
         if (!mpctx->video_out) {
             MP_FATAL(mpctx, "Error opening/initializing "
                     "the selected video_out (--vo) device.\n");
@@ -238,6 +319,7 @@ void reinit_video_chain_src(struct MPContext *mpctx, struct track *track)
             goto err_out;
         }
         mpctx->mouse_cursor_visible = true;
+        mp_load_builtin_scripts(mpctx);
     }
 
     update_window_title(mpctx, true);
@@ -264,8 +346,10 @@ void reinit_video_chain_src(struct MPContext *mpctx, struct track *track)
         vo_c->is_coverart = !!track->attached_picture;
         vo_c->is_sparse = track->stream->still_image || vo_c->is_coverart;
 
-        if (vo_c->is_coverart)
+        if (vo_c->is_coverart) {
             mp_decoder_wrapper_set_coverart_flag(track->dec, true);
+            mp_decoder_wrapper_set_image_cache(track->dec, mpctx->image_cache);
+        }
 
         track->vo_c = vo_c;
         vo_c->track = track;
@@ -409,12 +493,18 @@ static void shift_frames(struct MPContext *mpctx)
     mpctx->num_next_frames -= 1;
 }
 
+// --video-latency-hacks, also implied by --latency-mode=low.
+static bool use_latency_hacks(struct MPContext *mpctx)
+{
+    return mpctx->opts->video_latency_hacks || mpctx->opts->vo->latency_mode;
+}
+
 static bool use_video_lookahead(struct MPContext *mpctx)
 {
     return mpctx->video_out &&
            !(mpctx->video_out->driver->caps & VO_CAP_NORETAIN) &&
            !(mpctx->opts->untimed || mpctx->video_out->driver->untimed) &&
-           !mpctx->opts->video_latency_hacks;
+           !use_latency_hacks(mpctx);
 }
 
 static int get_req_frames(struct MPContext *mpctx, bool eof)
@@ -423,6 +513,10 @@ static int get_req_frames(struct MPContext *mpctx, bool eof)
     if (eof)
         return 1;
 
+    // The next frame is the next keyframe, which could take long.
+    if (mpctx->scrubbing)
+        return 1;
+
     if (!use_video_lookahead(mpctx))
         return 1;
 
@@ -490,6 +584,11 @@ static int video_output_image(struct MPContext *mpctx, bool *logical_eof)
         hrseek = false;
     }
 
+    if (mpctx->scrub_frame && needs_new_frame(mpctx)) {
+        add_new_frame(mpctx, mpctx->scrub_frame);
+        mpctx->scrub_frame = NULL;
+    }
+
     if (have_new_frame(mpctx, false))
         return VD_NEW_FRAME;
 
@@ -505,6 +604,9 @@ static int video_output_image(struct MPContext *mpctx, bool *logical_eof)
             r = VD_EOF;
         } else if (frame.type == MP_FRAME_VIDEO) {
             img = frame.data;
+            if (mpctx->video_status == STATUS_SYNCING &&
+                !mpctx->num_next_frames && !mpctx->saved_frame)
+                stats_startup_mark(mpctx->global, "first-frame-decoded");
         } else {
             MP_ERR(mpctx, "unexpected frame type %s\n",
                    mp_frame_type_str(frame.type));
@@ -526,7 +628,14 @@ static int video_output_image(struct MPContext *mpctx, bool *logical_eof)
             {
                 /* just skip - but save in case it was the last frame */
                 mp_image_setrefp(&mpctx->saved_frame, img);
+            } else if (mpctx->scrub_skip_pts != MP_NOPTS_VALUE &&
+                       img->pts <= mpctx->scrub_skip_pts)
+            {
+                // Already shown from the scrub cache.
             } else {
+                if (mpctx->scrubbing && mpctx->video_status == STATUS_SYNCING)
+                    scrub_cache_add(vo_c, img);
+                mpctx->scrub_skip_pts = MP_NOPTS_VALUE;
                 if (hrseek && mpctx->hrseek_backstep) {
                     if (mpctx->saved_frame) {
                         add_new_frame(mpctx, mpctx->saved_frame);
@@ -1215,10 +1324,12 @@ void write_video(struct MPContext *mpctx)
     if (mpctx->video_status < STATUS_PLAYING) {
         mpctx->video_status = STATUS_READY;
         // After a seek, make sure to wait until the first frame is visible.
-        if (!opts->video_latency_hacks) {
+        if (!use_latency_hacks(mpctx)) {
             vo_wait_frame(vo);
             MP_VERBOSE(mpctx, "first video frame after restart shown\n");
         }
+        seek_timing_mark(mpctx, &mpctx->seek_timing.first_frame);
+        stats_startup_mark(mpctx->global, "first-frame-shown");
     }
 
     mp_notify(mpctx, MPV_EVENT_TICK, NULL);
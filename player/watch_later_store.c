@@ -0,0 +1,297 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "osdep/io.h"
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "misc/bstr.h"
+#include "watch_later_store.h"
+
+// Each record is:
+//   "#mpv-watch-later <key> <mtime> <len>\n" <len bytes of data> "\n"
+// len==-1 is a deleted entry (with no data). The last record for a key wins.
+#define MAGIC "#mpv-watch-later "
+
+// Entries larger than this are considered corrupted.
+#define MAX_DATA_SIZE (16 * 1024 * 1024)
+
+struct entry {
+    char *key;
+    char *data;
+    int64_t mtime;
+    int64_t record_size;
+};
+
+struct watch_later_store {
+    struct mp_log *log;
+    char *path;
+    // Sorted by key.
+    struct entry *entries;
+    int num_entries;
+    int64_t parsed;     // file bytes consumed by parse_records()
+    int64_t live_bytes; // sum of record_size of all entries
+};
+
+struct watch_later_store *watch_later_store_open(void *ta_parent,
+                                                 struct mp_log *log,
+                                                 const char *path)
+{
+    struct watch_later_store *st = talloc_zero(ta_parent, struct watch_later_store);
+    st->log = log;
+    st->path = talloc_strdup(st, path);
+    return st;
+}
+
+// Return the index of the entry, or the insertion position as -(pos + 1).
+static int find_entry(struct watch_later_store *st, const char *key)
+{
+    int lo = 0, hi = st->num_entries;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        int r = strcmp(st->entries[mid].key, key);
+        if (r == 0)
+            return mid;
+        if (r < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return -(lo + 1);
+}
+
+static void set_entry(struct watch_later_store *st, const char *key,
+                      bstr data, bool remove, int64_t mtime,
+                      int64_t record_size)
+{
+    int idx = find_entry(st, key);
+    if (idx >= 0) {
+        struct entry *e = &st->entries[idx];
+        st->live_bytes -= e->record_size;
+        talloc_free(e->key);
+        talloc_free(e->data);
+        MP_TARRAY_REMOVE_AT(st->entries, st->num_entries, idx);
+    } else {
+        idx = -idx - 1;
+    }
+    if (remove)
+        return;
+    struct entry e = {
+        .key = talloc_strdup(st, key),
+        .data = bstrto0(st, data),
+        .mtime = mtime,
+        .record_size = record_size,
+    };
+    MP_TARRAY_INSERT_AT(st, st->entries, st->num_entries, idx, e);
+    st->live_bytes += record_size;
+}
+
+static void clear_entries(struct watch_later_store *st)
+{
+    for (int n = 0; n < st->num_entries; n++) {
+        talloc_free(st->entries[n].key);
+        talloc_free(st->entries[n].data);
+    }
+    st->num_entries = 0;
+    st->live_bytes = 0;
+    st->parsed = 0;
+}
+
+// Parse as many complete records as possible, and return the number of bytes
+// consumed. Garbage (e.g. from a crash while writing) is skipped.
+static int64_t parse_records(struct watch_later_store *st, bstr buf)
+{
+    bstr magic = bstr0("\n" MAGIC);
+    int64_t pos = 0;
+    while (pos < buf.len) {
+        bstr rest = bstr_cut(buf, pos);
+        if (!bstr_startswith0(rest, MAGIC)) {
+            int next = bstr_find(rest, magic);
+            if (next < 0)
+                break;
+            MP_WARN(st, "Skipping corrupted data in %s.\n", st->path);
+            pos += next + 1;
+            continue;
+        }
+        int hdr_end = bstrchr(rest, '\n');
+        if (hdr_end < 0)
+            break; // incomplete
+        char hdr[256];
+        snprintf(hdr, sizeof(hdr), "%.*s", hdr_end, rest.start);
+        char key[65];
+        int64_t mtime, len;
+        if (sscanf(hdr, MAGIC "%64s %"SCNd64" %"SCNd64, key, &mtime, &len) != 3 ||
+            len < -1 || len > MAX_DATA_SIZE)
+        {
+            pos += hdr_end + 1; // resync
+            continue;
+        }
+        int64_t data_len = MPMAX(len, 0);
+        int64_t size = hdr_end + 1 + data_len + 1;
+        if (size > rest.len) {
+            // Truncated record followed by further records, or incomplete.
+            if (bstr_find(bstr_cut(rest, hdr_end), magic) >= 0) {
+                pos += hdr_end + 1;
+                continue;
+            }
+            break;
+        }
+        if (rest.start[size - 1] != '\n') {
+            pos += hdr_end + 1;
+            continue;
+        }
+        bstr data = bstr_splice(rest, hdr_end + 1, hdr_end + 1 + data_len);
+        set_entry(st, key, data, len < 0, mtime, size);
+        pos += size;
+    }
+    return pos;
+}
+
+static bool read_from(void *ta_parent, const char *path, int64_t offset,
+                      bstr *out)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+    bool ok = fseek(f, offset, SEEK_SET) == 0;
+    *out = (bstr){0};
+    while (ok) {
+        char buf[64 * 1024];
+        size_t r = fread(buf, 1, sizeof(buf), f);
+        bstr_xappend(ta_parent, out, (bstr){(unsigned char *)buf, r});
+        if (r < sizeof(buf)) {
+            ok = !ferror(f);
+            break;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// Pick up records appended since the last call (possibly by other processes).
+static void refresh(struct watch_later_store *st)
+{
+    struct stat s;
+    if (stat(st->path, &s)) {
+        clear_entries(st);
+        return;
+    }
+    // File was replaced (compacted by another process).
+    if (s.st_size < st->parsed)
+        clear_entries(st);
+    if (s.st_size == st->parsed)
+        return;
+
+    void *tmp = talloc_new(NULL);
+    bstr data;
+    if (read_from(tmp, st->path, st->parsed, &data)) {
+        st->parsed += parse_records(st, data);
+    } else {
+        MP_WARN(st, "Can't read %s.\n", st->path);
+    }
+    talloc_free(tmp);
+}
+
+char *watch_later_store_get(struct watch_later_store *st, void *ta_parent,
+                            const char *key, int64_t *mtime)
+{
+    refresh(st);
+    int idx = find_entry(st, key);
+    if (idx < 0)
+        return NULL;
+    *mtime = st->entries[idx].mtime;
+    return talloc_strdup(ta_parent, st->entries[idx].data);
+}
+
+bool watch_later_store_has(struct watch_later_store *st, const char *key)
+{
+    refresh(st);
+    return find_entry(st, key) >= 0;
+}
+
+static void append_record(void *ta_parent, bstr *dst, const char *key,
+                          const char *data, int64_t mtime)
+{
+    int64_t len = data ? strlen(data) : -1;
+    bstr_xappend_asprintf(ta_parent, dst, MAGIC "%s %"PRId64" %"PRId64"\n%s\n",
+                          key, mtime, len, data ? data : "");
+}
+
+bool watch_later_store_put(struct watch_later_store *st, const char *key,
+                           const char *data, int64_t mtime)
+{
+    refresh(st);
+
+    void *tmp = talloc_new(NULL);
+    bstr rec = {0};
+    // Make sure the record starts on a new line if there is trailing garbage.
+    struct stat s;
+    if (!stat(st->path, &s) && s.st_size != st->parsed)
+        bstr_xappend(tmp, &rec, bstr0("\n"));
+    append_record(tmp, &rec, key, data, mtime);
+
+    // A single write in append mode, so concurrent writers don't interleave.
+    FILE *f = fopen(st->path, "ab");
+    bool ok = f && fwrite(rec.start, rec.len, 1, f) == 1;
+    if (f)
+        ok &= fclose(f) == 0;
+    talloc_free(tmp);
+
+    if (!ok) {
+        MP_ERR(st, "Can't write %s.\n", st->path);
+        return false;
+    }
+
+    refresh(st);
+    return true;
+}
+
+void watch_later_store_compact(struct watch_later_store *st)
+{
+    refresh(st);
+    if (st->parsed - st->live_bytes <= st->live_bytes)
+        return;
+
+    void *tmp = talloc_new(NULL);
+    bstr out = {0};
+    for (int n = 0; n < st->num_entries; n++) {
+        struct entry *e = &st->entries[n];
+        append_record(tmp, &out, e->key, e->data, e->mtime);
+    }
+
+    char *tmpname = talloc_asprintf(tmp, "%s.%d.tmp", st->path, (int)getpid());
+    FILE *f = fopen(tmpname, "wb");
+    bool ok = f && (!out.len || fwrite(out.start, out.len, 1, f) == 1);
+    if (f)
+        ok &= fclose(f) == 0;
+    if (!ok || rename(tmpname, st->path)) {
+        unlink(tmpname);
+        MP_WARN(st, "Can't compact %s.\n", st->path);
+    } else {
+        MP_VERBOSE(st, "Compacted %s from %"PRId64" to %zu bytes.\n", st->path,
+                   st->parsed, out.len);
+        st->parsed = out.len;
+    }
+    talloc_free(tmp);
+}
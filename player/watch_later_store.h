@@ -0,0 +1,49 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MP_WATCH_LATER_STORE_H
+#define MP_WATCH_LATER_STORE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct mp_log;
+struct watch_later_store;
+
+// Single-file store for watch later entries. The file is an append-only log of
+// records, which is read into memory and indexed by key. Changes made by other
+// processes appending to the same file are picked up on each access.
+// Not thread-safe.
+struct watch_later_store *watch_later_store_open(void *ta_parent,
+                                                 struct mp_log *log,
+                                                 const char *path);
+
+// Return the data stored for key (allocated under ta_parent), or NULL if there
+// is no entry. *mtime is set to the mtime stored with the entry (or -1).
+char *watch_later_store_get(struct watch_later_store *st, void *ta_parent,
+                            const char *key, int64_t *mtime);
+
+bool watch_later_store_has(struct watch_later_store *st, const char *key);
+
+// Add or replace an entry. data==NULL removes the entry.
+bool watch_later_store_put(struct watch_later_store *st, const char *key,
+                           const char *data, int64_t mtime);
+
+// Rewrite the file with only the live entries, if enough of it is obsolete.
+void watch_later_store_compact(struct watch_later_store *st);
+
+#endif
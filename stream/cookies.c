@@ -28,6 +28,8 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <inttypes.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "osdep/io.h"
 
@@ -159,12 +161,20 @@ static struct cookie_list_type *load_cookies_from(void *ctx,
 // Return a cookies string as expected by lavf (libavformat/http.c). The format
 // is like a Set-Cookie header (http://curl.haxx.se/rfc/cookie_spec.html),
 // separated by newlines.
-char *cookies_lavf(void *talloc_ctx, struct mp_log *log, char *file)
+// The formatted cookies of the last file loaded. Every network stream open
+// calls cookies_lavf(), so don't reload and reformat unchanged files.
+static pthread_mutex_t cookie_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct {
+    char *file;
+    int64_t mtime;
+    int64_t size;
+    char *cookies;
+} cookie_cache;
+
+static char *format_cookies(void *talloc_ctx, struct mp_log *log, char *file)
 {
     void *tmp = talloc_new(NULL);
-    struct cookie_list_type *list = NULL;
-    if (file && file[0])
-        list = load_cookies_from(tmp, log, file);
+    struct cookie_list_type *list = load_cookies_from(tmp, log, file);
 
     char *res = talloc_strdup(talloc_ctx, "");
 
@@ -178,3 +188,30 @@ char *cookies_lavf(void *talloc_ctx, struct mp_log *log, char *file)
     talloc_free(tmp);
     return res;
 }
+
+char *cookies_lavf(void *talloc_ctx, struct mp_log *log, char *file)
+{
+    if (!file || !file[0])
+        return talloc_strdup(talloc_ctx, "");
+
+    struct stat st;
+    if (stat(file, &st))
+        return format_cookies(talloc_ctx, log, file); // logs the error
+
+    pthread_mutex_lock(&cookie_cache_lock);
+    if (!cookie_cache.file || strcmp(cookie_cache.file, file) != 0 ||
+        cookie_cache.mtime != st.st_mtime || cookie_cache.size != st.st_size)
+    {
+        talloc_free(cookie_cache.file);
+        talloc_free(cookie_cache.cookies);
+        cookie_cache.file = talloc_strdup(NULL, file);
+        cookie_cache.mtime = st.st_mtime;
+        cookie_cache.size = st.st_size;
+        cookie_cache.cookies = format_cookies(NULL, log, file);
+    } else {
+        mp_verbose(log, "Using cached cookie file: %s\n", file);
+    }
+    char *res = talloc_strdup(talloc_ctx, cookie_cache.cookies);
+    pthread_mutex_unlock(&cookie_cache_lock);
+    return res;
+}
@@ -109,6 +109,7 @@ typedef struct {
     int is_on;
     int retry;
     unsigned int last_freq;
+    bool full_ts;           // filter passes the full transponder (PID 8192)
     bool switching_channel;
     bool stream_used;
 } dvb_state_t;
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include <strings.h>
 #include <assert.h>
@@ -36,6 +37,8 @@
 #include "options/m_config.h"
 #include "options/options.h"
 #include "options/path.h"
+#include "osdep/atomic.h"
+#include "osdep/threads.h"
 #include "osdep/timer.h"
 #include "stream.h"
 
@@ -61,6 +64,7 @@ extern const stream_info_t stream_info_bdnav;
 extern const stream_info_t stream_info_edl;
 extern const stream_info_t stream_info_libarchive;
 extern const stream_info_t stream_info_cb;
+extern const stream_info_t stream_info_shm;
 
 static const stream_info_t *const stream_list[] = {
 #if HAVE_CDDA
@@ -92,6 +96,9 @@ static const stream_info_t *const stream_list[] = {
     &stream_info_slice,
     &stream_info_fd,
     &stream_info_cb,
+#if HAVE_STREAM_SHM
+    &stream_info_shm,
+#endif
     NULL
 };
 
@@ -102,9 +109,15 @@ static const stream_info_t *const stream_list[] = {
 // Must be power of 2.
 #define STREAM_MAX_BUFFER_SIZE (512 * 1024 * 1024)
 
+// Sort of arbitrary; must be power of 2.
+#define STREAM_MAX_BACKGROUND_BUFFER (256 * 1024 * 1024)
+
 struct stream_opts {
     int64_t buffer_size;
+    int64_t background_buffer;
     int load_unsafe_playlists;
+    char *share_name;
+    int64_t share_size;
 };
 
 #define OPT_BASE_STRUCT struct stream_opts
@@ -113,12 +126,18 @@ const struct m_sub_options stream_conf = {
     .opts = (const struct m_option[]){
         {"stream-buffer-size", OPT_BYTE_SIZE(buffer_size),
             M_RANGE(STREAM_MIN_BUFFER_SIZE, STREAM_MAX_BUFFER_SIZE)},
+        {"stream-background-buffer", OPT_BYTE_SIZE(background_buffer),
+            M_RANGE(0, STREAM_MAX_BACKGROUND_BUFFER)},
         {"load-unsafe-playlists", OPT_FLAG(load_unsafe_playlists)},
+        {"stream-share", OPT_STRING(share_name)},
+        {"stream-share-size", OPT_BYTE_SIZE(share_size),
+            M_RANGE(STREAM_MIN_BUFFER_SIZE, M_MAX_MEM_BYTES)},
         {0}
     },
     .size = sizeof(struct stream_opts),
     .defaults = &(const struct stream_opts){
         .buffer_size = 128 * 1024,
+        .share_size = 16 * 1024 * 1024,
     },
 };
 
@@ -311,6 +330,237 @@ static bool stream_resize_buffer(struct stream *s, int keep, int new)
     return true;
 }
 
+// Background reader for --stream-background-buffer. A thread calls the stream
+// implementation's fill_buffer() and writes the data into a single-producer,
+// single-consumer ring buffer, from which the wrapped fill_buffer() copies it
+// without taking any lock if data is available.
+// All other calls into the stream implementation (seek, control, get_size)
+// suspend the reader thread first, so implementations don't need to be thread
+// safe. The ring buffer is reset on seeks.
+struct stream_reader {
+    struct stream *s;
+    pthread_t thread;
+
+    // Original callbacks of the stream implementation.
+    int (*fill_buffer)(struct stream *s, void *buffer, int max_len);
+    int (*seek)(struct stream *s, int64_t pos);
+    int64_t (*get_size)(struct stream *s);
+    int (*control)(struct stream *s, int cmd, void *arg);
+
+    uint8_t *buffer;
+    uint64_t buffer_mask;           // buffer size - 1 (power of 2)
+
+    // Total bytes written by the thread/read by the consumer. Each is written
+    // by one side only; the difference is the amount of buffered data.
+    mp_atomic_uint64 write_pos;
+    mp_atomic_uint64 read_pos;
+    atomic_bool need_space;         // thread waits for the buffer to drain
+
+    // Only used for sleeping and suspending; not held while copying data.
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    bool eof;                       // fill_buffer() returned EOF or error
+    bool paused;                    // the thread must not call fill_buffer()
+    bool busy;                      // the thread is in fill_buffer()
+    bool terminate;
+};
+
+static void *reader_thread(void *p)
+{
+    struct stream_reader *r = p;
+
+    mpthread_set_name("stream/reader");
+    mpthread_set_class(r->s->global, r->s->log, "io");
+
+    pthread_mutex_lock(&r->lock);
+    while (!r->terminate) {
+        uint64_t size = r->buffer_mask + 1;
+        uint64_t wpos = atomic_load(&r->write_pos);
+        uint64_t avail = size - (wpos - atomic_load(&r->read_pos));
+        if (!avail) {
+            // Set the flag before checking again, so the consumer can't miss it.
+            atomic_store(&r->need_space, true);
+            avail = size - (wpos - atomic_load(&r->read_pos));
+        }
+        if (r->paused || r->eof || !avail) {
+            pthread_cond_wait(&r->wakeup, &r->lock);
+            continue;
+        }
+        atomic_store(&r->need_space, false);
+
+        uint64_t pos = wpos & r->buffer_mask;
+        int len = MPMIN(MPMIN(avail, size - pos), STREAM_BUFFER_SIZE * 16);
+        r->busy = true;
+        pthread_mutex_unlock(&r->lock);
+
+        int res = r->fill_buffer(r->s, &r->buffer[pos], len);
+
+        pthread_mutex_lock(&r->lock);
+        r->busy = false;
+        if (res > 0) {
+            atomic_store(&r->write_pos, wpos + res);
+        } else {
+            r->eof = true;
+        }
+        pthread_cond_broadcast(&r->wakeup);
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return NULL;
+}
+
+// Stop the thread from calling into the stream implementation.
+static void reader_pause(struct stream_reader *r)
+{
+    pthread_mutex_lock(&r->lock);
+    r->paused = true;
+    while (r->busy)
+        pthread_cond_wait(&r->wakeup, &r->lock);
+    pthread_mutex_unlock(&r->lock);
+}
+
+static void reader_resume(struct stream_reader *r, bool reset)
+{
+    pthread_mutex_lock(&r->lock);
+    if (reset) {
+        atomic_store(&r->read_pos, atomic_load(&r->write_pos));
+        r->eof = false;
+    }
+    r->paused = false;
+    pthread_cond_broadcast(&r->wakeup);
+    pthread_mutex_unlock(&r->lock);
+}
+
+static int reader_fill_buffer(struct stream *s, void *buffer, int max_len)
+{
+    struct stream_reader *r = s->reader;
+
+    while (1) {
+        uint64_t rpos = atomic_load(&r->read_pos);
+        uint64_t avail = atomic_load(&r->write_pos) - rpos;
+        if (avail) {
+            uint64_t pos = rpos & r->buffer_mask;
+            int len = MPMIN(MPMIN(avail, r->buffer_mask + 1 - pos), max_len);
+            memcpy(buffer, &r->buffer[pos], len);
+            atomic_store(&r->read_pos, rpos + len);
+            if (atomic_load(&r->need_space)) {
+                pthread_mutex_lock(&r->lock);
+                pthread_cond_broadcast(&r->wakeup);
+                pthread_mutex_unlock(&r->lock);
+            }
+            return len;
+        }
+
+        pthread_mutex_lock(&r->lock);
+        bool eof = false;
+        if (atomic_load(&r->write_pos) == rpos) {
+            if (r->eof || mp_cancel_test(s->cancel)) {
+                // Report it once, but let the next read try again (like with
+                // direct reads; some streams can grow).
+                r->eof = false;
+                pthread_cond_broadcast(&r->wakeup);
+                eof = true;
+            } else {
+                pthread_cond_wait(&r->wakeup, &r->lock);
+            }
+        }
+        pthread_mutex_unlock(&r->lock);
+        if (eof)
+            return -1;
+    }
+}
+
+static int reader_seek(struct stream *s, int64_t pos)
+{
+    struct stream_reader *r = s->reader;
+    reader_pause(r);
+    int res = r->seek(s, pos);
+    reader_resume(r, true);
+    return res;
+}
+
+static int64_t reader_get_size(struct stream *s)
+{
+    struct stream_reader *r = s->reader;
+    reader_pause(r);
+    int64_t res = r->get_size(s);
+    reader_resume(r, false);
+    return res;
+}
+
+static int reader_control(struct stream *s, int cmd, void *arg)
+{
+    struct stream_reader *r = s->reader;
+    reader_pause(r);
+    int res = r->control(s, cmd, arg);
+    // These change the read position.
+    bool reset = res == STREAM_OK &&
+        (cmd == STREAM_CTRL_AVSEEK || cmd == STREAM_CTRL_SEEK_TO_TIME ||
+         cmd == STREAM_CTRL_SET_ANGLE || cmd == STREAM_CTRL_SET_CURRENT_TITLE);
+    reader_resume(r, reset);
+    return res;
+}
+
+static void stream_start_reader(struct stream *s, int64_t size)
+{
+    struct stream_reader *r = talloc_zero(s, struct stream_reader);
+    r->s = s;
+    r->fill_buffer = s->fill_buffer;
+    r->seek = s->seek;
+    r->get_size = s->get_size;
+    r->control = s->control;
+    size = mp_round_next_power_of_2(MPMAX(size, STREAM_BUFFER_SIZE));
+    r->buffer = ta_alloc_size(r, size);
+    if (!r->buffer) {
+        talloc_free(r);
+        return;
+    }
+    r->buffer_mask = size - 1;
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->wakeup, NULL);
+
+    if (pthread_create(&r->thread, NULL, reader_thread, r)) {
+        pthread_cond_destroy(&r->wakeup);
+        pthread_mutex_destroy(&r->lock);
+        talloc_free(r);
+        return;
+    }
+
+    s->reader = r;
+    s->fill_buffer = reader_fill_buffer;
+    if (s->seek)
+        s->seek = reader_seek;
+    if (s->get_size)
+        s->get_size = reader_get_size;
+    if (s->control)
+        s->control = reader_control;
+
+    MP_VERBOSE(s, "Using background reader with %lld bytes buffer.\n",
+               (long long)size);
+}
+
+static void stream_stop_reader(struct stream *s)
+{
+    struct stream_reader *r = s->reader;
+
+    pthread_mutex_lock(&r->lock);
+    r->terminate = true;
+    pthread_cond_broadcast(&r->wakeup);
+    pthread_mutex_unlock(&r->lock);
+    pthread_join(r->thread, NULL);
+
+    pthread_cond_destroy(&r->wakeup);
+    pthread_mutex_destroy(&r->lock);
+
+    // Restore the callbacks, so the implementation's close() sees its own.
+    s->fill_buffer = r->fill_buffer;
+    s->seek = r->seek;
+    s->get_size = r->get_size;
+    s->control = r->control;
+    s->reader = NULL;
+    talloc_free(r);
+}
+
 static int stream_create_instance(const stream_info_t *sinfo,
                                   struct stream_open_args *args,
                                   struct stream **ret)
@@ -402,6 +652,20 @@ static int stream_create_instance(const stream_info_t *sinfo,
 
     assert(s->seekable == !!s->seek);
 
+    // (Pointless for memory streams, which wrap other streams or plain data.)
+    if (opts->background_buffer && s->mode == STREAM_READ && s->fill_buffer &&
+        !args->special_arg && sinfo != &stream_info_memory)
+        stream_start_reader(s, opts->background_buffer);
+
+#if HAVE_STREAM_SHM
+    if ((flags & STREAM_SHARE) && opts->share_name && opts->share_name[0] &&
+        s->mode == STREAM_READ && s->fill_buffer)
+    {
+        s->share = stream_share_create(s, s->log, opts->share_name,
+                                       opts->share_size);
+    }
+#endif
+
     if (s->mime_type)
         MP_VERBOSE(s, "Mime-type: '%s'\n", s->mime_type);
 
@@ -488,8 +752,11 @@ static int stream_read_unbuffered(stream_t *s, void *buf, int len)
 
     int res = 0;
     // we will retry even if we already reached EOF previously.
-    if (s->fill_buffer && !mp_cancel_test(s->cancel))
+    if (s->fill_buffer && !mp_cancel_test(s->cancel)) {
+        int64_t start = mp_time_us();
         res = s->fill_buffer(s, buf, len);
+        s->total_read_time += mp_time_us() - start;
+    }
     if (res <= 0) {
         s->eof = 1;
         return 0;
@@ -497,6 +764,10 @@ static int stream_read_unbuffered(stream_t *s, void *buf, int len)
     assert(res <= len);
     // When reading succeeded we are obviously not at eof.
     s->eof = 0;
+#if HAVE_STREAM_SHM
+    if (s->share)
+        stream_share_write(s->share, s->pos, buf, res);
+#endif
     s->pos += res;
     s->total_unbuffered_read_bytes += res;
     return res;
@@ -769,6 +1040,11 @@ void free_stream(stream_t *s)
     if (!s)
         return;
 
+    if (s->reader)
+        stream_stop_reader(s);
+#if HAVE_STREAM_SHM
+    stream_share_destroy(s->share);
+#endif
     if (s->close)
         s->close(s);
     talloc_free(s);
@@ -50,6 +50,7 @@
 
 #define STREAM_LOCAL_FS_ONLY    (1 << 5) // stream_file only, no URLs
 #define STREAM_LESS_NOISE       (1 << 6) // try to log errors only
+#define STREAM_SHARE            (1 << 7) // publish data if --stream-share is set
 
 // end flags for stream_open_ext (the naming convention sucks)
 
@@ -64,6 +65,8 @@ enum stream_ctrl {
     STREAM_CTRL_AVSEEK,
     STREAM_CTRL_HAS_AVSEEK,
     STREAM_CTRL_GET_METADATA,
+    STREAM_CTRL_GET_SEGMENTS,           // struct stream_segments*
+    STREAM_CTRL_GET_PROGRAM_ID,         // int* (MPEG-TS program to prefer)
 
     // Optical discs (internal interface between streams and demux_disc)
     STREAM_CTRL_GET_TIME_LENGTH,
@@ -95,6 +98,18 @@ struct stream_dvd_info_req {
     int num_subs;
 };
 
+// for STREAM_CTRL_GET_SEGMENTS
+#define STREAM_MAX_SEGMENTS 32
+struct stream_segment {
+    int64_t start, end;     // requested byte range (end is exclusive)
+    int64_t received;       // number of bytes received so far
+};
+
+struct stream_segments {
+    struct stream_segment segments[STREAM_MAX_SEGMENTS];
+    int num_segments;
+};
+
 // for STREAM_CTRL_AVSEEK
 struct stream_avseek {
     int stream_index;
@@ -160,6 +175,8 @@ typedef struct stream {
     uint64_t total_unbuffered_read_bytes;
     // Seek statistics. The user can reset this as needed.
     uint64_t total_stream_seeks;
+    // Time spent in fill_buffer calls, in microseconds. Can be reset as well.
+    int64_t total_read_time;
 
     // Buffer size requested by user; s->buffer may have a different size
     int requested_buffer_size;
@@ -187,6 +204,12 @@ typedef struct stream {
 
     unsigned int buffer_mask; // buffer_size-1, where buffer_size == 2**n
     uint8_t *buffer;
+
+    // Set if --stream-background-buffer is used (internal to stream.c).
+    struct stream_reader *reader;
+
+    // Set if --stream-share is used (internal to stream.c).
+    struct stream_share *share;
 } stream_t;
 
 // Non-inline version of stream_read_char().
@@ -201,6 +224,26 @@ inline static int stream_read_char(stream_t *s)
         : stream_read_char_fallback(s);
 }
 
+// Return a pointer to the data buffered at the current position, and set *len
+// to the number of bytes that can be accessed through it (without wrapping
+// around the ring buffer). This does not read any new data. Use
+// stream_skip_buffered() to consume bytes.
+inline static uint8_t *stream_peek_buffered(stream_t *s, unsigned int *len)
+{
+    unsigned int pos = s->buf_cur & s->buffer_mask;
+    unsigned int contiguous = s->buffer_mask + 1 - pos;
+    *len = s->buf_end - s->buf_cur;
+    if (*len > contiguous)
+        *len = contiguous;
+    return s->buffer + pos;
+}
+
+// Consume len bytes returned by stream_peek_buffered().
+inline static void stream_skip_buffered(stream_t *s, unsigned int len)
+{
+    s->buf_cur += len;
+}
+
 int stream_skip_bom(struct stream *s);
 
 inline static int64_t stream_tell(stream_t *s)
@@ -251,6 +294,13 @@ struct stream *stream_memory_open(struct mpv_global *global, void *data, int len
 struct stream *stream_concat_open(struct mpv_global *global, struct mp_cancel *c,
                                   struct stream **streams, int num_streams);
 
+// stream_shm.c
+struct stream_share *stream_share_create(void *ta_parent, struct mp_log *log,
+                                         const char *name, int64_t size);
+void stream_share_write(struct stream_share *sh, int64_t pos, void *buf,
+                        int len);
+void stream_share_destroy(struct stream_share *sh);
+
 // stream_file.c
 char *mp_file_url_to_filename(void *talloc_ctx, bstr url);
 char *mp_file_get_path(void *talloc_ctx, bstr url);
@@ -1,6 +1,7 @@
 #include "config.h"
 
 #include <stdio.h>
+#include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -22,8 +23,38 @@
 struct priv {
     mpv_stream_cb_info info;
     struct mp_cancel *cancel;
+    // Current slice returned by read_ref_fn, and how much of it was consumed.
+    mpv_stream_cb_slice slice;
+    uint64_t slice_pos;
 };
 
+static void release_slice(struct priv *p)
+{
+    if (p->slice.release_fn)
+        p->slice.release_fn(p->slice.opaque);
+    p->slice = (mpv_stream_cb_slice){0};
+    p->slice_pos = 0;
+}
+
+static int fill_buffer_ref(stream_t *s, void *buffer, int max_len)
+{
+    struct priv *p = s->priv;
+    if (p->slice_pos == p->slice.size) {
+        release_slice(p);
+        int r = p->info.read_ref_fn(p->info.cookie, &p->slice);
+        if (r <= 0 || !p->slice.data || !p->slice.size) {
+            if (r > 0)
+                MP_ERR(s, "read_ref_fn returned an empty slice.\n");
+            release_slice(p);
+            return r < 0 ? -1 : 0;
+        }
+    }
+    size_t len = MPMIN(max_len, p->slice.size - p->slice_pos);
+    memcpy(buffer, (const char *)p->slice.data + p->slice_pos, len);
+    p->slice_pos += len;
+    return len;
+}
+
 static int fill_buffer(stream_t *s, void *buffer, int max_len)
 {
     struct priv *p = s->priv;
@@ -33,6 +64,7 @@ static int fill_buffer(stream_t *s, void *buffer, int max_len)
 static int seek(stream_t *s, int64_t newpos)
 {
     struct priv *p = s->priv;
+    release_slice(p);
     return p->info.seek_fn(p->info.cookie, newpos) >= 0;
 }
 
@@ -52,12 +84,13 @@ static int64_t get_size(stream_t *s)
 static void s_close(stream_t *s)
 {
     struct priv *p = s->priv;
+    release_slice(p);
     p->info.close_fn(p->info.cookie);
 }
 
 static int open_cb(stream_t *stream)
 {
-    struct priv *p = talloc_ptrtype(stream, p);
+    struct priv *p = talloc_zero(stream, struct priv);
     stream->priv = p;
 
     bstr bproto = mp_split_proto(bstr0(stream->url), NULL);
@@ -78,7 +111,7 @@ static int open_cb(stream_t *stream)
         return STREAM_ERROR;
     }
 
-    if (!info.read_fn || !info.close_fn) {
+    if ((!info.read_fn && !info.read_ref_fn) || !info.close_fn) {
         MP_FATAL(stream, "required read_fn or close_fn callbacks not set.\n");
         return STREAM_ERROR;
     }
@@ -90,7 +123,7 @@ static int open_cb(stream_t *stream)
         stream->seekable = true;
     }
     stream->fast_skip = true;
-    stream->fill_buffer = fill_buffer;
+    stream->fill_buffer = p->info.read_ref_fn ? fill_buffer_ref : fill_buffer;
     stream->get_size = get_size;
     stream->close = s_close;
 
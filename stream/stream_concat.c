@@ -15,11 +15,30 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
+
 #include <libavutil/common.h>
 
 #include "common/common.h"
+#include "options/m_config.h"
+#include "options/m_option.h"
+#include "osdep/threads.h"
 #include "stream.h"
 
+struct stream_concat_opts {
+    int64_t prefetch;
+};
+
+#define OPT_BASE_STRUCT struct stream_concat_opts
+const struct m_sub_options stream_concat_conf = {
+    .opts = (const struct m_option[]){
+        {"stream-concat-prefetch", OPT_BYTE_SIZE(prefetch),
+            M_RANGE(0, 256 * 1024 * 1024)},
+        {0}
+    },
+    .size = sizeof(struct stream_concat_opts),
+};
+
 struct priv {
     struct stream **streams;
     int num_streams;
@@ -27,19 +46,80 @@ struct priv {
     int64_t size;
 
     int cur; // streams[cur] is the stream for current stream.pos
+
+    // Read-ahead of streams[prefetch_index] on prefetch_thread. While it's
+    // running, that stream must not be accessed by anything else.
+    int64_t prefetch;
+    bool prefetch_active;
+    bool prefetch_seeked;   // streams[prefetch_index] was rewound
+    int prefetch_index;
+    bool prefetch_seekable;
+    pthread_t prefetch_thread;
 };
 
+static void *prefetch_thread(void *ptr)
+{
+    struct priv *p = ptr;
+    mpthread_set_name("concat-prefetch");
+
+    struct stream *sub = p->streams[p->prefetch_index];
+    if (p->prefetch_seekable)
+        stream_seek(sub, 0);
+    stream_peek(sub, MPMIN(p->prefetch, INT_MAX));
+    return NULL;
+}
+
+static void stop_prefetch(struct priv *p)
+{
+    if (p->prefetch_active) {
+        pthread_join(p->prefetch_thread, NULL);
+        p->prefetch_active = false;
+    }
+}
+
+// Start reading the next stream in the background, if the current stream is
+// close enough to its end.
+static void check_prefetch(struct stream *s)
+{
+    struct priv *p = s->priv;
+    int next = p->cur + 1;
+    if (!p->prefetch || p->prefetch_active || next >= p->num_streams ||
+        (p->prefetch_seeked && p->prefetch_index == next))
+        return;
+
+    struct stream *sub = p->streams[p->cur];
+    int64_t size = stream_get_size(sub);
+    if (size < 0 || size - stream_tell(sub) > p->prefetch)
+        return;
+
+    p->prefetch_index = next;
+    p->prefetch_seekable = s->seekable;
+    if (pthread_create(&p->prefetch_thread, NULL, prefetch_thread, p)) {
+        p->prefetch = 0; // don't try again
+        return;
+    }
+    p->prefetch_active = true;
+    p->prefetch_seeked = true;
+}
+
 static int fill_buffer(struct stream *s, void *buffer, int len)
 {
     struct priv *p = s->priv;
 
     while (1) {
         int res = stream_read_partial(p->streams[p->cur], buffer, len);
-        if (res || p->cur == p->num_streams - 1)
+        if (res) {
+            check_prefetch(s);
+            return res;
+        }
+        if (p->cur == p->num_streams - 1)
             return res;
 
         p->cur += 1;
-        if (s->seekable)
+        bool prefetched = p->prefetch_seeked && p->prefetch_index == p->cur;
+        stop_prefetch(p);
+        p->prefetch_seeked = false;
+        if (s->seekable && !prefetched)
             stream_seek(p->streams[p->cur], 0);
     }
 }
@@ -48,6 +128,9 @@ static int seek(struct stream *s, int64_t newpos)
 {
     struct priv *p = s->priv;
 
+    stop_prefetch(p);
+    p->prefetch_seeked = false;
+
     int64_t next_pos = 0;
     int64_t base_pos = 0;
 
@@ -83,6 +166,8 @@ static void s_close(struct stream *s)
 {
     struct priv *p = s->priv;
 
+    stop_prefetch(p);
+
     for (int n = 0; n < p->num_streams; n++)
         free_stream(p->streams[n]);
 }
@@ -110,6 +195,10 @@ static int open2(struct stream *stream, const struct stream_open_args *args)
 
     stream->seekable = true;
 
+    struct stream_concat_opts *opts =
+        mp_get_config_group(p, stream->global, &stream_concat_conf);
+    p->prefetch = opts->prefetch;
+
     struct priv *list = args->special_arg;
     if (!list || !list->num_streams) {
         MP_FATAL(stream, "No sub-streams.\n");
@@ -802,6 +802,23 @@ int dvb_set_channel(stream_t *stream, unsigned int adapter, unsigned int n)
     }
     channel = &(new_list->channels[n]);
 
+    bool full_ts = channel->pids_cnt == 1 && channel->pids[0] == 8192;
+
+    // All programs of the transponder are already being passed through, so
+    // switching to another one on it needs no retuning or filter changes.
+    // The demuxer picks the program via STREAM_CTRL_GET_PROGRAM_ID.
+    if (state->is_on && state->full_ts && full_ts &&
+        state->cur_adapter == adapter &&
+        state->cur_frontend == channel->frontend &&
+        state->last_freq == channel->freq)
+    {
+        new_list->current = n;
+        MP_VERBOSE(stream, "DVB_SET_CHANNEL: new channel name=%s on the same "
+                   "transponder, not retuning\n", channel->name);
+        return 1;
+    }
+    state->full_ts = false;
+
     if (state->is_on) {  //the fds are already open and we have to stop the demuxers
         /* Remove all demuxes. */
         dvb_fix_demuxes(priv, 0);
@@ -880,6 +897,7 @@ int dvb_set_channel(stream_t *stream, unsigned int adapter, unsigned int n)
         }
     }
 
+    state->full_ts = full_ts;
     return 1;
 }
 
@@ -901,6 +919,13 @@ static int dvbin_stream_control(struct stream *s, int cmd, void *arg)
         *(struct mp_tags **)arg = metadata;
         return STREAM_OK;
     }
+    case STREAM_CTRL_GET_PROGRAM_ID: {
+        int service_id = list->channels[list->current].service_id;
+        if (service_id == -1)
+            return STREAM_UNSUPPORTED;
+        *(int *)arg = service_id;
+        return STREAM_OK;
+    }
     }
     return STREAM_UNSUPPORTED;
 }
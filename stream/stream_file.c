@@ -36,6 +36,7 @@
 #include "common/msg.h"
 #include "misc/thread_tools.h"
 #include "stream.h"
+#include "options/m_config.h"
 #include "options/m_option.h"
 #include "options/path.h"
 
@@ -48,6 +49,10 @@
 #include <sys/vfs.h>
 #endif
 
+#if HAVE_LIBURING
+#include <liburing.h>
+#endif
+
 #ifdef _WIN32
 #include <windows.h>
 #include <winternl.h>
@@ -58,6 +63,61 @@
 #endif
 #endif
 
+#if HAVE_LIBURING
+
+#define OPT_BASE_STRUCT struct stream_file_opts
+struct stream_file_opts {
+    int io_uring;
+    int io_uring_depth;
+    int64_t io_uring_block_size;
+    int direct_io;
+};
+
+const struct m_sub_options stream_file_conf = {
+    .opts = (const struct m_option[]){
+        {"file-io-uring", OPT_FLAG(io_uring)},
+        {"file-io-uring-depth", OPT_INT(io_uring_depth), M_RANGE(1, 64)},
+        {"file-io-uring-block-size", OPT_BYTE_SIZE(io_uring_block_size),
+            M_RANGE(64 * 1024, 64 * 1024 * 1024)},
+        {"file-direct-io", OPT_FLAG(direct_io)},
+        {0}
+    },
+    .size = sizeof(struct stream_file_opts),
+    .defaults = &(const struct stream_file_opts){
+        .io_uring_depth = 4,
+        .io_uring_block_size = 1024 * 1024,
+    },
+};
+
+// O_DIRECT requires this alignment for buffers, offsets and sizes.
+#define URING_ALIGN 4096
+
+struct uring_block {
+    int64_t pos;                // file offset of data[0]
+    int len;                    // bytes read, or -1 if still in flight
+    bool error;                 // read failed
+    uint8_t *data;
+};
+
+// Ring of blocks read ahead sequentially, starting at blocks[head]. The first
+// num_queued blocks (wrapping around) are in flight or completed.
+struct uring_reader {
+    struct io_uring ring;
+    int fd;                     // fd used for reads (can be an O_DIRECT fd)
+    bool close_fd;
+    bool fixed;                 // buffers are registered with the ring
+    int block_size;
+    struct uring_block *blocks;
+    int num_blocks;
+    int head;
+    int num_queued;
+    int num_inflight;
+    int64_t read_pos;           // logical stream position
+    int64_t next_pos;           // offset of the next block to request
+};
+
+#endif
+
 struct priv {
     int fd;
     bool close;
@@ -66,12 +126,188 @@ struct priv {
     bool appending;
     int64_t orig_size;
     struct mp_cancel *cancel;
+#if HAVE_LIBURING
+    struct uring_reader *uring;
+#endif
 };
 
 // Total timeout = RETRY_TIMEOUT * MAX_RETRIES
 #define RETRY_TIMEOUT 0.2
 #define MAX_RETRIES 10
 
+#if HAVE_LIBURING
+
+// Wait for one completion. Returns false if nothing could be reaped.
+static bool uring_wait(struct uring_reader *u)
+{
+    if (!u->num_inflight)
+        return false;
+
+    struct io_uring_cqe *cqe;
+    int r;
+    do {
+        r = io_uring_wait_cqe(&u->ring, &cqe);
+    } while (r == -EINTR);
+    if (r < 0)
+        return false;
+
+    struct uring_block *b = &u->blocks[(uintptr_t)io_uring_cqe_get_data(cqe)];
+    b->len = MPMAX(cqe->res, 0);
+    b->error = cqe->res < 0;
+    io_uring_cqe_seen(&u->ring, cqe);
+    u->num_inflight--;
+    return true;
+}
+
+// Wait for all reads in flight and discard all blocks; restart at pos.
+static void uring_reset(struct uring_reader *u, int64_t pos)
+{
+    while (u->num_inflight && uring_wait(u)) {}
+    u->head = 0;
+    u->num_queued = 0;
+    u->read_pos = pos;
+    u->next_pos = pos & ~(int64_t)(URING_ALIGN - 1);
+}
+
+static void uring_submit(struct uring_reader *u)
+{
+    bool queued = false;
+    while (u->num_queued < u->num_blocks) {
+        struct io_uring_sqe *sqe = io_uring_get_sqe(&u->ring);
+        if (!sqe)
+            break;
+        int idx = (u->head + u->num_queued) % u->num_blocks;
+        struct uring_block *b = &u->blocks[idx];
+        b->pos = u->next_pos;
+        b->len = -1;
+        b->error = false;
+        if (u->fixed) {
+            io_uring_prep_read_fixed(sqe, u->fd, b->data, u->block_size,
+                                     b->pos, idx);
+        } else {
+            io_uring_prep_read(sqe, u->fd, b->data, u->block_size, b->pos);
+        }
+        io_uring_sqe_set_data(sqe, (void *)(uintptr_t)idx);
+        u->num_queued++;
+        u->num_inflight++;
+        u->next_pos += u->block_size;
+        queued = true;
+    }
+    if (queued)
+        io_uring_submit(&u->ring);
+}
+
+// Returns -1 on errors (caller must fall back to read()), 0 on EOF.
+static int uring_read(struct uring_reader *u, void *buffer, int max_len)
+{
+    while (1) {
+        uring_submit(u);
+
+        struct uring_block *b = &u->blocks[u->head];
+        while (b->len < 0) {
+            if (!uring_wait(u))
+                return -1;
+        }
+        if (b->error)
+            return -1;
+
+        int64_t offset = u->read_pos - b->pos;
+        if (offset < b->len) {
+            int len = MPMIN(b->len - offset, max_len);
+            memcpy(buffer, b->data + offset, len);
+            u->read_pos += len;
+            return len;
+        }
+
+        if (b->len < u->block_size) {
+            // Short read: EOF. Start over at the same position next time, so
+            // the file can be re-read if it grows.
+            uring_reset(u, u->read_pos);
+            return 0;
+        }
+
+        u->head = (u->head + 1) % u->num_blocks;
+        u->num_queued--;
+    }
+}
+
+static void uring_destroy(struct uring_reader *u)
+{
+    if (!u)
+        return;
+    uring_reset(u, 0);
+    io_uring_queue_exit(&u->ring);
+    if (u->close_fd)
+        close(u->fd);
+    for (int n = 0; n < u->num_blocks; n++)
+        free(u->blocks[n].data);
+    talloc_free(u);
+}
+
+static struct uring_reader *uring_create(struct stream *s, const char *filename)
+{
+    struct priv *p = s->priv;
+    struct stream_file_opts *opts =
+        mp_get_config_group(NULL, s->global, &stream_file_conf);
+    struct uring_reader *u = NULL;
+
+    if (!opts->io_uring)
+        goto done;
+
+    u = talloc_zero(NULL, struct uring_reader);
+    u->fd = p->fd;
+    u->num_blocks = opts->io_uring_depth;
+    u->block_size = MP_ALIGN_UP(opts->io_uring_block_size, URING_ALIGN);
+    u->blocks = talloc_zero_array(u, struct uring_block, u->num_blocks);
+
+    if (io_uring_queue_init(u->num_blocks, &u->ring, 0) < 0) {
+        MP_VERBOSE(s, "io_uring not available.\n");
+        talloc_free(u);
+        u = NULL;
+        goto done;
+    }
+
+    for (int n = 0; n < u->num_blocks; n++) {
+        if (posix_memalign((void **)&u->blocks[n].data, URING_ALIGN,
+                           u->block_size))
+        {
+            u->blocks[n].data = NULL;
+            u->num_blocks = n;
+            uring_destroy(u);
+            u = NULL;
+            goto done;
+        }
+    }
+
+    if (opts->direct_io && filename) {
+        int fd = open(filename, O_RDONLY | O_CLOEXEC | O_DIRECT);
+        if (fd >= 0) {
+            u->fd = fd;
+            u->close_fd = true;
+        } else {
+            MP_VERBOSE(s, "Cannot use O_DIRECT: %s\n", mp_strerror(errno));
+        }
+    }
+
+    struct iovec *iov = talloc_array(NULL, struct iovec, u->num_blocks);
+    for (int n = 0; n < u->num_blocks; n++)
+        iov[n] = (struct iovec){u->blocks[n].data, u->block_size};
+    u->fixed = io_uring_register_buffers(&u->ring, iov, u->num_blocks) == 0;
+    talloc_free(iov);
+
+    uring_reset(u, 0);
+
+    MP_VERBOSE(s, "Using io_uring with %d x %d bytes%s%s.\n", u->num_blocks,
+               u->block_size, u->close_fd ? ", O_DIRECT" : "",
+               u->fixed ? ", registered buffers" : "");
+
+done:
+    talloc_free(opts);
+    return u;
+}
+
+#endif
+
 static int64_t get_size(stream_t *s)
 {
     struct priv *p = s->priv;
@@ -89,6 +325,18 @@ static int fill_buffer(stream_t *s, void *buffer, int max_len)
 {
     struct priv *p = s->priv;
 
+#if HAVE_LIBURING
+    if (p->uring) {
+        int r = uring_read(p->uring, buffer, max_len);
+        if (r >= 0)
+            return r;
+        MP_WARN(s, "io_uring read failed, falling back to read().\n");
+        lseek(p->fd, p->uring->read_pos, SEEK_SET);
+        uring_destroy(p->uring);
+        p->uring = NULL;
+    }
+#endif
+
 #ifndef __MINGW32__
     if (p->use_poll) {
         int c = mp_cancel_get_fd(p->cancel);
@@ -134,12 +382,21 @@ static int write_buffer(stream_t *s, void *buffer, int len)
 static int seek(stream_t *s, int64_t newpos)
 {
     struct priv *p = s->priv;
+#if HAVE_LIBURING
+    if (p->uring) {
+        uring_reset(p->uring, newpos);
+        return 1;
+    }
+#endif
     return lseek(p->fd, newpos, SEEK_SET) != (off_t)-1;
 }
 
 static void s_close(stream_t *s)
 {
     struct priv *p = s->priv;
+#if HAVE_LIBURING
+    uring_destroy(p->uring);
+#endif
     if (p->close)
         close(p->fd);
 }
@@ -261,6 +518,7 @@ static int open_f(stream_t *stream, const struct stream_open_args *args)
 
     char *filename = stream->path;
     char *url = "";
+    const char *direct_filename = NULL; // for opening the file again
     if (!strict_fs) {
         char *fn = mp_file_url_to_filename(stream, bstr0(stream->url));
         if (fn)
@@ -303,6 +561,7 @@ static int open_f(stream_t *stream, const struct stream_open_args *args)
             return STREAM_ERROR;
         }
         p->close = true;
+        direct_filename = filename;
     }
 
     struct stat st;
@@ -352,6 +611,12 @@ static int open_f(stream_t *stream, const struct stream_open_args *args)
 
     p->orig_size = get_size(stream);
 
+#if HAVE_LIBURING
+    // Only for plain files; growing files are handled by the read() path.
+    if (!write && p->regular_file && !p->appending && stream->seekable)
+        p->uring = uring_create(stream, direct_filename);
+#endif
+
     p->cancel = mp_cancel_new(p);
     if (stream->cancel)
         mp_cancel_set_parent(p->cancel, stream->cancel);
@@ -15,6 +15,8 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <pthread.h>
+
 #include <libavformat/avformat.h>
 #include <libavformat/avio.h>
 #include <libavutil/opt.h>
@@ -25,6 +27,8 @@
 #include "common/tags.h"
 #include "common/av_common.h"
 #include "misc/thread_tools.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
 #include "stream.h"
 #include "options/m_config.h"
 #include "options/m_option.h"
@@ -48,6 +52,10 @@ struct stream_lavf_params {
     char *tls_key_file;
     double timeout;
     char *http_proxy;
+    int http_connections;
+    int64_t http_segment_size;
+    int http_pool_size;
+    double http_pool_timeout;
 };
 
 const struct m_sub_options stream_lavf_conf = {
@@ -64,31 +72,426 @@ const struct m_sub_options stream_lavf_conf = {
         {"tls-key-file", OPT_STRING(tls_key_file), .flags = M_OPT_FILE},
         {"network-timeout", OPT_DOUBLE(timeout), M_RANGE(0, DBL_MAX)},
         {"http-proxy", OPT_STRING(http_proxy)},
+        {"http-connections", OPT_INT(http_connections), M_RANGE(1, 16)},
+        {"http-segment-size", OPT_BYTE_SIZE(http_segment_size),
+            M_RANGE(64 * 1024, 64 * 1024 * 1024)},
+        {"http-pool-size", OPT_INT(http_pool_size), M_RANGE(0, 64)},
+        {"http-pool-idle-timeout", OPT_DOUBLE(http_pool_timeout),
+            M_RANGE(0, DBL_MAX)},
         {0}
     },
     .size = sizeof(struct stream_lavf_params),
     .defaults = &(const struct stream_lavf_params){
         .useragent = "libmpv",
         .timeout = 60,
+        .http_connections = 1,
+        .http_segment_size = 2 * 1024 * 1024,
+        .http_pool_size = 4,
+        .http_pool_timeout = 15,
     },
 };
 
 static const char *const http_like[] =
     {"http", "https", "mmsh", "mmshttp", "httproxy", NULL};
 
+// One byte range requested by a fetch_worker.
+struct fetch_slot {
+    int64_t start, end;         // requested byte range (end is exclusive)
+    int64_t received;           // number of bytes in data[]
+    uint8_t *data;              // segment_size bytes
+    bool used;                  // range assigned
+    bool busy;                  // a worker is writing to it
+    bool stale;                 // not wanted anymore (freed by the worker)
+};
+
+struct fetch_worker {
+    struct fetcher *f;
+    pthread_t thread;
+    AVIOContext *avio;          // separate connection, opened on first use
+};
+
+// For --http-connections > 1: fetch segments ahead of the read position over
+// multiple connections, and return them in order from fill_buffer().
+struct fetcher {
+    struct stream *stream;
+    char *url;
+    AVDictionary *opts;
+    int64_t size;
+    int64_t segment_size;
+
+    struct fetch_worker *workers;
+    int num_workers;
+
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    // -- protected by lock
+    struct fetch_slot *slots;
+    int num_slots;
+    int64_t read_pos;           // stream position of the next read
+    int64_t next_pos;           // start of the next segment to request
+    bool failed;                // a request failed; use the main connection
+    bool terminate;
+};
+
+// An HTTP connection that can be kept open after the stream is closed, and
+// reused if the same URL is opened again (see --http-pool-size).
+struct pool_conn {
+    char *key;                  // URL and avio options
+    AVIOContext *avio;
+    char *mime_type;
+    struct stream *stream;      // owner; NULL while idle (set under pool_lock)
+    int64_t idle_since;         // mp_time_us_coarse() when it was returned
+};
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct pool_conn **pool; // oldest first
+static int num_pool;
+
+struct priv {
+    AVIOContext *avio;
+    struct fetcher *fetcher;    // NULL if not using parallel connections
+    struct pool_conn *conn;     // NULL if the connection is not poolable
+    int pool_size;
+    double pool_timeout;
+};
+
 static int open_f(stream_t *stream);
 static struct mp_tags *read_icy(stream_t *stream);
 
+// Used instead of interrupt_cb() for poolable connections. The AVIOContext
+// keeps the callback for its whole lifetime, so it can't point to the stream.
+static int pool_interrupt_cb(void *ctx)
+{
+    struct pool_conn *conn = ctx;
+    struct stream *stream = conn->stream;
+    return stream ? mp_cancel_test(stream->cancel) : 0;
+}
+
+static void pool_conn_destroy(struct pool_conn *conn)
+{
+    if (conn->avio)
+        avio_close(conn->avio);
+    talloc_free(conn);
+}
+
+// Remove connections which were idle for too long, and the oldest ones above
+// max_size. Those are returned in *dead, to be closed outside of the lock.
+// Must be called with pool_lock held.
+static void pool_prune(int max_size, double timeout, struct pool_conn ***dead,
+                       int *num_dead)
+{
+    int64_t now = mp_time_us_coarse();
+    for (int n = num_pool - 1; n >= 0; n--) {
+        struct pool_conn *conn = pool[n];
+        if (n < num_pool - max_size ||
+            (now - conn->idle_since) / 1e6 > timeout)
+        {
+            MP_TARRAY_APPEND(NULL, *dead, *num_dead, conn);
+            MP_TARRAY_REMOVE_AT(pool, num_pool, n);
+        }
+    }
+}
+
+static void pool_close_dead(struct pool_conn **dead, int num_dead)
+{
+    for (int n = 0; n < num_dead; n++)
+        pool_conn_destroy(dead[n]);
+    talloc_free(dead);
+}
+
+// Take an idle connection matching key out of the pool, or return NULL.
+static struct pool_conn *pool_get(struct stream *stream, const char *key,
+                                  struct stream_lavf_params *params)
+{
+    struct pool_conn *res = NULL;
+    struct pool_conn **dead = NULL;
+    int num_dead = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    pool_prune(params->http_pool_size, params->http_pool_timeout,
+               &dead, &num_dead);
+    for (int n = num_pool - 1; n >= 0; n--) {
+        if (strcmp(pool[n]->key, key) == 0) {
+            res = pool[n];
+            MP_TARRAY_REMOVE_AT(pool, num_pool, n);
+            res->stream = stream;
+            break;
+        }
+    }
+    if (!num_pool)
+        TA_FREEP(&pool);
+    pthread_mutex_unlock(&pool_lock);
+
+    pool_close_dead(dead, num_dead);
+    return res;
+}
+
+// Hand the connection to the pool (or close it if the pool is disabled).
+static void pool_put(struct pool_conn *conn, int max_size, double timeout)
+{
+    struct pool_conn **dead = NULL;
+    int num_dead = 0;
+
+    pthread_mutex_lock(&pool_lock);
+    conn->stream = NULL;
+    conn->idle_since = mp_time_us_coarse();
+    MP_TARRAY_APPEND(NULL, pool, num_pool, conn);
+    pool_prune(max_size, timeout, &dead, &num_dead);
+    if (!num_pool)
+        TA_FREEP(&pool);
+    pthread_mutex_unlock(&pool_lock);
+
+    pool_close_dead(dead, num_dead);
+}
+
+static int fetch_interrupt_cb(void *ctx)
+{
+    struct fetcher *f = ctx;
+    // (Reading without lock is just a hint.)
+    return f->terminate || mp_cancel_test(f->stream->cancel);
+}
+
+static bool fetch_segment(struct fetch_worker *w, struct fetch_slot *slot)
+{
+    struct fetcher *f = w->f;
+
+    if (!w->avio) {
+        AVDictionary *dict = NULL;
+        av_dict_copy(&dict, f->opts, 0);
+        AVIOInterruptCB cb = {
+            .callback = fetch_interrupt_cb,
+            .opaque = f,
+        };
+        int err = avio_open2(&w->avio, f->url, AVIO_FLAG_READ, &cb, &dict);
+        av_dict_free(&dict);
+        if (err < 0) {
+            MP_WARN(f->stream, "Could not open additional connection.\n");
+            return false;
+        }
+    }
+
+    // Limit the HTTP request to the segment (failure to set it is harmless).
+    av_opt_set_int(w->avio, "end_offset", slot->end, AV_OPT_SEARCH_CHILDREN);
+    if (avio_seek(w->avio, slot->start, SEEK_SET) < 0)
+        return false;
+
+    int64_t pos = slot->start;
+    while (pos < slot->end) {
+        pthread_mutex_lock(&f->lock);
+        bool stop = slot->stale || f->terminate;
+        pthread_mutex_unlock(&f->lock);
+        if (stop)
+            return true;
+
+        int len = MPMIN(slot->end - pos, 64 * 1024);
+        int r = avio_read_partial(w->avio, slot->data + (pos - slot->start), len);
+        if (r <= 0)
+            return false;
+        pos += r;
+
+        pthread_mutex_lock(&f->lock);
+        slot->received = pos - slot->start;
+        pthread_cond_broadcast(&f->wakeup);
+        pthread_mutex_unlock(&f->lock);
+    }
+
+    return true;
+}
+
+static void *fetch_thread(void *p)
+{
+    struct fetch_worker *w = p;
+    struct fetcher *f = w->f;
+
+    mpthread_set_name("stream/fetch");
+
+    pthread_mutex_lock(&f->lock);
+    while (!f->terminate && !f->failed) {
+        struct fetch_slot *slot = NULL;
+        for (int n = 0; n < f->num_slots && f->next_pos < f->size; n++) {
+            if (!f->slots[n].used) {
+                slot = &f->slots[n];
+                break;
+            }
+        }
+        if (!slot) {
+            pthread_cond_wait(&f->wakeup, &f->lock);
+            continue;
+        }
+
+        slot->used = slot->busy = true;
+        slot->stale = false;
+        slot->start = f->next_pos;
+        slot->end = MPMIN(f->next_pos + f->segment_size, f->size);
+        slot->received = 0;
+        f->next_pos = slot->end;
+        pthread_mutex_unlock(&f->lock);
+
+        bool ok = fetch_segment(w, slot);
+
+        pthread_mutex_lock(&f->lock);
+        slot->busy = false;
+        if (slot->stale) {
+            slot->used = false;
+        } else if (!ok) {
+            MP_WARN(f->stream, "Request failed, using a single connection.\n");
+            f->failed = true;
+        }
+        pthread_cond_broadcast(&f->wakeup);
+    }
+    pthread_mutex_unlock(&f->lock);
+
+    return NULL;
+}
+
+// Must be called locked.
+static void drop_slot(struct fetcher *f, struct fetch_slot *slot)
+{
+    if (slot->busy) {
+        slot->stale = true;
+    } else {
+        slot->used = false;
+    }
+    pthread_cond_broadcast(&f->wakeup);
+}
+
+static int fetch_read(struct fetcher *f, AVIOContext *avio, void *buffer,
+                      int max_len)
+{
+    int res = -1;
+
+    pthread_mutex_lock(&f->lock);
+    while (!f->failed && f->read_pos < f->size) {
+        struct fetch_slot *slot = NULL;
+        for (int n = 0; n < f->num_slots; n++) {
+            struct fetch_slot *cur = &f->slots[n];
+            if (!cur->used || cur->stale)
+                continue;
+            if (cur->end <= f->read_pos) {
+                drop_slot(f, cur);
+            } else if (cur->start <= f->read_pos) {
+                slot = cur;
+            }
+        }
+
+        if (!slot) {
+            // After a seek, throw away everything and restart at read_pos.
+            if (f->next_pos != f->read_pos) {
+                for (int n = 0; n < f->num_slots; n++) {
+                    if (f->slots[n].used && !f->slots[n].stale)
+                        drop_slot(f, &f->slots[n]);
+                }
+                f->next_pos = f->read_pos;
+                pthread_cond_broadcast(&f->wakeup);
+            }
+        } else if (slot->start + slot->received > f->read_pos) {
+            int64_t offset = f->read_pos - slot->start;
+            res = MPMIN(max_len, slot->received - offset);
+            memcpy(buffer, slot->data + offset, res);
+            f->read_pos += res;
+            if (f->read_pos >= slot->end)
+                drop_slot(f, slot);
+            break;
+        }
+
+        if (mp_cancel_test(f->stream->cancel))
+            break;
+        pthread_cond_wait(&f->wakeup, &f->lock);
+    }
+    bool fallback = f->failed && f->read_pos < f->size;
+    int64_t pos = f->read_pos;
+    pthread_mutex_unlock(&f->lock);
+
+    if (fallback) {
+        if (avio_tell(avio) != pos && avio_seek(avio, pos, SEEK_SET) < 0)
+            return -1;
+        res = avio_read_partial(avio, buffer, max_len);
+        if (res <= 0)
+            return -1;
+        pthread_mutex_lock(&f->lock);
+        f->read_pos += res;
+        pthread_mutex_unlock(&f->lock);
+    }
+
+    return res;
+}
+
+static void fetcher_destroy(struct fetcher *f)
+{
+    pthread_mutex_lock(&f->lock);
+    f->terminate = true;
+    pthread_cond_broadcast(&f->wakeup);
+    pthread_mutex_unlock(&f->lock);
+
+    for (int n = 0; n < f->num_workers; n++) {
+        struct fetch_worker *w = &f->workers[n];
+        pthread_join(w->thread, NULL);
+        if (w->avio)
+            avio_close(w->avio);
+    }
+
+    av_dict_free(&f->opts);
+    pthread_cond_destroy(&f->wakeup);
+    pthread_mutex_destroy(&f->lock);
+    talloc_free(f);
+}
+
+// opts is copied. Returns NULL if no connection thread could be started.
+static struct fetcher *fetcher_create(struct stream *stream, const char *url,
+                                      AVDictionary *opts, int64_t size,
+                                      struct stream_lavf_params *params)
+{
+    struct fetcher *f = talloc_ptrtype(NULL, f);
+    *f = (struct fetcher){
+        .stream = stream,
+        .url = talloc_strdup(f, url),
+        .size = size,
+        .segment_size = params->http_segment_size,
+    };
+    av_dict_copy(&f->opts, opts, 0);
+    // Reuse the connection for subsequent segment requests.
+    av_dict_set(&f->opts, "multiple_requests", "1", 0);
+    pthread_mutex_init(&f->lock, NULL);
+    pthread_cond_init(&f->wakeup, NULL);
+
+    // Allow each connection to have 1 segment buffered ahead.
+    f->num_slots = MPMIN(params->http_connections * 2, STREAM_MAX_SEGMENTS);
+    f->slots = talloc_zero_array(f, struct fetch_slot, f->num_slots);
+    for (int n = 0; n < f->num_slots; n++)
+        f->slots[n].data = talloc_size(f, f->segment_size);
+
+    f->workers = talloc_zero_array(f, struct fetch_worker,
+                                   params->http_connections);
+    for (int n = 0; n < params->http_connections; n++) {
+        struct fetch_worker *w = &f->workers[f->num_workers];
+        w->f = f;
+        if (pthread_create(&w->thread, NULL, fetch_thread, w))
+            break;
+        f->num_workers++;
+    }
+
+    if (!f->num_workers) {
+        fetcher_destroy(f);
+        return NULL;
+    }
+
+    MP_VERBOSE(stream, "Using %d connections.\n", f->num_workers);
+    return f;
+}
+
 static int fill_buffer(stream_t *s, void *buffer, int max_len)
 {
-    AVIOContext *avio = s->priv;
-    int r = avio_read_partial(avio, buffer, max_len);
+    struct priv *p = s->priv;
+    if (p->fetcher)
+        return fetch_read(p->fetcher, p->avio, buffer, max_len);
+    int r = avio_read_partial(p->avio, buffer, max_len);
     return (r <= 0) ? -1 : r;
 }
 
 static int write_buffer(stream_t *s, void *buffer, int len)
 {
-    AVIOContext *avio = s->priv;
+    struct priv *p = s->priv;
+    AVIOContext *avio = p->avio;
     avio_write(avio, buffer, len);
     avio_flush(avio);
     if (avio->error)
@@ -98,8 +501,15 @@ static int write_buffer(stream_t *s, void *buffer, int len)
 
 static int seek(stream_t *s, int64_t newpos)
 {
-    AVIOContext *avio = s->priv;
-    if (avio_seek(avio, newpos, SEEK_SET) < 0) {
+    struct priv *p = s->priv;
+    if (p->fetcher) {
+        pthread_mutex_lock(&p->fetcher->lock);
+        p->fetcher->read_pos = newpos;
+        pthread_cond_broadcast(&p->fetcher->wakeup);
+        pthread_mutex_unlock(&p->fetcher->lock);
+        return 1;
+    }
+    if (avio_seek(p->avio, newpos, SEEK_SET) < 0) {
         return 0;
     }
     return 1;
@@ -107,28 +517,45 @@ static int seek(stream_t *s, int64_t newpos)
 
 static int64_t get_size(stream_t *s)
 {
-    AVIOContext *avio = s->priv;
-    return avio_size(avio);
+    struct priv *p = s->priv;
+    return avio_size(p->avio);
 }
 
 static void close_f(stream_t *stream)
 {
-    AVIOContext *avio = stream->priv;
+    struct priv *p = stream->priv;
+    if (!p)
+        return;
+    if (p->fetcher)
+        fetcher_destroy(p->fetcher);
     /* NOTE: As of 2011 write streams must be manually flushed before close.
      * Currently write_buffer() always flushes them after writing.
      * avio_close() could return an error, but we have no way to return that
      * with the current stream API.
      */
-    if (avio)
-        avio_close(avio);
+    if (p->conn) {
+        // Only connections in a sane state can be reused. A failed read
+        // leaves the error set; the next avio_seek() would reconnect anyway.
+        if (p->avio->error || !p->pool_size) {
+            pool_conn_destroy(p->conn);
+        } else {
+            pool_put(p->conn, p->pool_size, p->pool_timeout);
+        }
+    } else if (p->avio) {
+        avio_close(p->avio);
+    }
 }
 
 static int control(stream_t *s, int cmd, void *arg)
 {
-    AVIOContext *avio = s->priv;
+    struct priv *p = s->priv;
+    AVIOContext *avio = p->avio;
     switch(cmd) {
     case STREAM_CTRL_AVSEEK: {
         struct stream_avseek *c = arg;
+        // (Time based seeking and the parallel reader are mutually exclusive.)
+        if (p->fetcher)
+            break;
         int64_t r = avio_seek_time(avio, c->stream_index, c->timestamp, c->flags);
         if (r >= 0) {
             stream_drop_buffers(s);
@@ -166,6 +593,26 @@ static int control(stream_t *s, int cmd, void *arg)
             break;
         return 1;
     }
+    case STREAM_CTRL_GET_SEGMENTS: {
+        if (!p->fetcher)
+            break;
+        struct fetcher *f = p->fetcher;
+        struct stream_segments *segs = arg;
+        segs->num_segments = 0;
+        pthread_mutex_lock(&f->lock);
+        for (int n = 0; n < f->num_slots; n++) {
+            struct fetch_slot *slot = &f->slots[n];
+            if (slot->used && !slot->stale) {
+                segs->segments[segs->num_segments++] = (struct stream_segment){
+                    .start = slot->start,
+                    .end = slot->end,
+                    .received = slot->received,
+                };
+            }
+        }
+        pthread_mutex_unlock(&f->lock);
+        return 1;
+    }
     }
     return STREAM_UNSUPPORTED;
 }
@@ -256,7 +703,10 @@ static int open_f(stream_t *stream)
     AVIOContext *avio = NULL;
     int res = STREAM_ERROR;
     AVDictionary *dict = NULL;
+    AVDictionary *fetch_dict = NULL;
     void *temp = talloc_new(NULL);
+    struct stream_lavf_params *params =
+        mp_get_config_group(temp, stream->global, &stream_lavf_conf);
 
     stream->seek = NULL;
     stream->seekable = false;
@@ -311,26 +761,92 @@ static int open_f(stream_t *stream)
         av_dict_set(&dict, "timeout", "0", 0);
     }
 
-    int err = avio_open2(&avio, filename, flags, &cb, &dict);
-    if (err < 0) {
-        if (err == AVERROR_PROTOCOL_NOT_FOUND)
-            MP_ERR(stream, "Protocol not found. Make sure"
-                   " ffmpeg/Libav is compiled with networking support.\n");
-        goto out;
+    bool is_http = false;
+    bstr proto = mp_split_proto(bstr0(filename), NULL);
+    for (int n = 0; http_like[n]; n++)
+        is_http |= bstr_equals0(proto, http_like[n]);
+    bool parallel = is_http && stream->mode == STREAM_READ &&
+                    params->http_connections > 1;
+    if (parallel)
+        av_dict_copy(&fetch_dict, dict, 0);
+
+    // Plain HTTP reads can be served from/returned to the connection pool.
+    // The options are part of the key, because they affect the request.
+    struct pool_conn *conn = NULL;
+    bool poolable = !parallel && stream->mode == STREAM_READ &&
+        (bstr_equals0(proto, "http") || bstr_equals0(proto, "https"));
+    if (poolable) {
+        // Keep the connection alive for subsequent requests (such as seeks).
+        av_dict_set(&dict, "multiple_requests", "1", 0);
+        char *opts_str = NULL;
+        av_dict_get_string(dict, &opts_str, '=', '\n');
+        char *key = talloc_asprintf(temp, "%s\n%s", filename,
+                                    opts_str ? opts_str : "");
+        av_free(opts_str);
+
+        conn = pool_get(stream, key, params);
+        if (conn) {
+            if (avio_seek(conn->avio, 0, SEEK_SET) < 0) {
+                pool_conn_destroy(conn);
+                conn = NULL;
+            } else {
+                MP_VERBOSE(stream, "Reusing pooled connection.\n");
+                avio = conn->avio;
+            }
+        }
+        if (!conn) {
+            conn = talloc_zero(NULL, struct pool_conn);
+            conn->key = talloc_strdup(conn, key);
+            conn->stream = stream;
+            cb = (AVIOInterruptCB){
+                .callback = pool_interrupt_cb,
+                .opaque = conn,
+            };
+        }
     }
 
-    mp_avdict_print_unset(stream->log, MSGL_V, dict);
+    if (!avio) {
+        int err = avio_open2(&avio, filename, flags, &cb, &dict);
+        if (err < 0) {
+            if (err == AVERROR_PROTOCOL_NOT_FOUND)
+                MP_ERR(stream, "Protocol not found. Make sure"
+                       " ffmpeg/Libav is compiled with networking support.\n");
+            talloc_free(conn);
+            goto out;
+        }
+
+        mp_avdict_print_unset(stream->log, MSGL_V, dict);
+
+        if (avio->av_class) {
+            uint8_t *mt = NULL;
+            if (av_opt_get(avio, "mime_type", AV_OPT_SEARCH_CHILDREN, &mt) >= 0)
+            {
+                stream->mime_type = talloc_strdup(stream, mt);
+                av_free(mt);
+            }
+        }
 
-    if (avio->av_class) {
-        uint8_t *mt = NULL;
-        if (av_opt_get(avio, "mime_type", AV_OPT_SEARCH_CHILDREN, &mt) >= 0) {
-            stream->mime_type = talloc_strdup(stream, mt);
-            av_free(mt);
+        if (conn) {
+            conn->avio = avio;
+            conn->mime_type = talloc_strdup(conn, stream->mime_type);
         }
+    } else {
+        stream->mime_type = talloc_strdup(stream, conn->mime_type);
     }
 
-    stream->priv = avio;
+    struct priv *p = talloc_zero(stream, struct priv);
+    p->avio = avio;
+    p->conn = conn;
+    p->pool_size = params->http_pool_size;
+    p->pool_timeout = params->http_pool_timeout;
+    stream->priv = p;
     stream->seekable = avio->seekable & AVIO_SEEKABLE_NORMAL;
+
+    // Byte range requests only work if the server supports seeking.
+    int64_t size = avio_size(avio);
+    if (parallel && stream->seekable && size > 0)
+        p->fetcher = fetcher_create(stream, filename, fetch_dict, size, params);
+
     stream->seek = stream->seekable ? seek : NULL;
     stream->fill_buffer = fill_buffer;
     stream->write_buffer = write_buffer;
@@ -345,13 +861,15 @@ static int open_f(stream_t *stream)
 
 out:
     av_dict_free(&dict);
+    av_dict_free(&fetch_dict);
     talloc_free(temp);
     return res;
 }
 
 static struct mp_tags *read_icy(stream_t *s)
 {
-    AVIOContext *avio = s->priv;
+    struct priv *p = s->priv;
+    AVIOContext *avio = p->avio;
 
     if (!avio->av_class)
         return NULL;
@@ -15,6 +15,8 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <inttypes.h>
+
 #include <archive.h>
 #include <archive_entry.h>
 
@@ -441,25 +443,121 @@ bool mp_archive_next_entry(struct mp_archive *mpa)
     return success;
 }
 
+// Maximum number of readers kept around in addition to the current one.
+#define MAX_CHECKPOINTS 3
+
+// A reader left at some position within the entry. Since libarchive can't
+// seek in compressed data, and its decoder state can't be copied, this is the
+// only way to avoid decompressing everything from the start on each seek.
+struct checkpoint {
+    struct mp_archive *mpa;
+    struct stream *src;
+    int64_t pos;
+};
+
 struct priv {
     struct mp_archive *mpa;
     bool broken_seek;
     struct stream *src;
     int64_t entry_size;
     char *entry_name;
+    char *base_url;
+    // Archive parameters from the first successful open (0 if none yet).
+    int flags;
+    int num_volumes;
+    struct checkpoint checkpoints[MAX_CHECKPOINTS];
+    int num_checkpoints;
 };
 
+static void close_reader(struct mp_archive *mpa, struct stream *src)
+{
+    mp_archive_free(mpa);
+    free_stream(src);
+}
+
+static void remember_archive_params(struct priv *p)
+{
+    if (p->mpa) {
+        p->flags = p->mpa->flags;
+        p->num_volumes = p->mpa->num_volumes;
+    }
+}
+
+// Keep the current reader (if any) as checkpoint. Unsets p->mpa and p->src.
+static void park_reader(stream_t *s)
+{
+    struct priv *p = s->priv;
+    remember_archive_params(p);
+    if (!p->mpa || s->pos <= 0) {
+        close_reader(p->mpa, p->src);
+    } else {
+        if (p->num_checkpoints == MAX_CHECKPOINTS) {
+            // Drop the one closest to the start, as it's the cheapest to
+            // recreate.
+            int drop = 0;
+            for (int n = 1; n < p->num_checkpoints; n++) {
+                if (p->checkpoints[n].pos < p->checkpoints[drop].pos)
+                    drop = n;
+            }
+            close_reader(p->checkpoints[drop].mpa, p->checkpoints[drop].src);
+            MP_TARRAY_REMOVE_AT(p->checkpoints, p->num_checkpoints, drop);
+        }
+        p->checkpoints[p->num_checkpoints++] = (struct checkpoint){
+            .mpa = p->mpa,
+            .src = p->src,
+            .pos = s->pos,
+        };
+    }
+    p->mpa = NULL;
+    p->src = NULL;
+}
+
+// Switch to the checkpoint closest to newpos, if it's closer than the current
+// position (and doesn't require seeking backwards).
+static bool resume_checkpoint(stream_t *s, int64_t newpos)
+{
+    struct priv *p = s->priv;
+    int best = -1;
+    int64_t best_pos = p->mpa && newpos >= s->pos ? s->pos : -1;
+    for (int n = 0; n < p->num_checkpoints; n++) {
+        int64_t pos = p->checkpoints[n].pos;
+        if (pos <= newpos && pos > best_pos) {
+            best = n;
+            best_pos = pos;
+        }
+    }
+    if (best < 0)
+        return false;
+
+    struct checkpoint cp = p->checkpoints[best];
+    MP_TARRAY_REMOVE_AT(p->checkpoints, p->num_checkpoints, best);
+    park_reader(s);
+    p->mpa = cp.mpa;
+    p->src = cp.src;
+    s->pos = cp.pos;
+    MP_VERBOSE(s, "resuming from reader at %"PRId64" for seek\n", cp.pos);
+    return true;
+}
+
 static int reopen_archive(stream_t *s)
 {
     struct priv *p = s->priv;
     s->pos = 0;
-    if (!p->mpa) {
+    remember_archive_params(p);
+    mp_archive_free(p->mpa);
+    p->mpa = NULL;
+
+    if (!p->src) {
+        p->src = stream_create(p->base_url, STREAM_READ | s->stream_origin,
+                               s->cancel, s->global);
+        if (!p->src)
+            return STREAM_ERROR;
+    }
+
+    if (!p->num_volumes) {
         p->mpa = mp_archive_new(s->log, p->src, MP_ARCHIVE_FLAG_UNSAFE, 0);
     } else {
-        int flags = p->mpa->flags;
-        int num_volumes = p->mpa->num_volumes;
-        mp_archive_free(p->mpa);
-        p->mpa = mp_archive_new_raw(s->log, p->src, flags, num_volumes);
+        p->mpa = mp_archive_new_raw(s->log, p->src, p->flags, p->num_volumes);
     }
 
     if (!p->mpa)
@@ -474,6 +572,7 @@ static int reopen_archive(stream_t *s)
             if (archive_entry_size_is_set(mpa->entry))
                 p->entry_size = archive_entry_size(mpa->entry);
             uselocale(oldlocale);
+            remember_archive_params(p);
             return STREAM_OK;
         }
     }
@@ -517,10 +616,12 @@ static int archive_entry_seek(stream_t *s, int64_t newpos)
             return -1;
     }
     // libarchive can't seek in most formats.
-    if (newpos < s->pos) {
+    if (!resume_checkpoint(s, newpos) && newpos < s->pos) {
         // Hack seeking backwards into working by reopening the archive and
-        // starting over.
+        // starting over. The old reader is kept, in case the demuxer seeks
+        // back to where it was.
         MP_VERBOSE(s, "trying to reopen archive for performing seek\n");
+        park_reader(s);
         if (reopen_archive(s) < STREAM_OK)
             return -1;
     }
@@ -563,8 +664,12 @@ static int archive_entry_seek(stream_t *s, int64_t newpos)
 static void archive_entry_close(stream_t *s)
 {
     struct priv *p = s->priv;
-    mp_archive_free(p->mpa);
-    free_stream(p->src);
+    for (int n = 0; n < p->num_checkpoints; n++)
+        close_reader(p->checkpoints[n].mpa, p->checkpoints[n].src);
+    p->num_checkpoints = 0;
+    close_reader(p->mpa, p->src);
+    p->mpa = NULL;
+    p->src = NULL;
 }
 
 static int64_t archive_entry_get_size(stream_t *s)
@@ -588,13 +693,7 @@ static int archive_entry_open(stream_t *stream)
         name += 1;
     p->entry_name = name;
     mp_url_unescape_inplace(base);
-
-    p->src = stream_create(base, STREAM_READ | stream->stream_origin,
-                           stream->cancel, stream->global);
-    if (!p->src) {
-        archive_entry_close(stream);
-        return STREAM_ERROR;
-    }
+    p->base_url = base;
 
     int r = reopen_archive(stream);
     if (r < STREAM_OK) {
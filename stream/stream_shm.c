@@ -0,0 +1,284 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Sharing a stream between processes: an instance playing a (live) source
+// with --stream-share=name copies all bytes it reads from the source into a
+// ring buffer in POSIX shared memory, and other instances read it with the
+// shm://name protocol, so the source is fetched only once. Each reader demuxes
+// the data on its own.
+
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "config.h"
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "misc/thread_tools.h"
+#include "osdep/timer.h"
+#include "stream.h"
+
+#if !HAVE_STDATOMIC
+#error "stream_shm.c requires C11 atomics, which work across processes."
+#endif
+
+#define SHM_MAGIC 0x6d707673 // "mpvs"
+#define SHM_HEADER_SIZE 4096
+
+// How long readers sleep when waiting for new data (in seconds).
+#define SHM_POLL_INTERVAL 0.01
+
+struct shm_header {
+    uint32_t magic;
+    uint32_t header_size;
+    uint64_t size;              // size of the data ring after the header
+    // Total number of bytes written. Data for the byte at position pos is at
+    // data[pos % size], and valid if write_start - pos <= size.
+    _Atomic uint64_t write_pos;
+    // Set to the end of a write before its data is copied to the ring. Bytes
+    // below write_start - size may have been overwritten.
+    _Atomic uint64_t write_start;
+    // Set when the writer is done (source EOF, or the writer went away).
+    _Atomic bool eof;
+};
+
+static char *shm_object_name(void *ta_parent, const char *name)
+{
+    return talloc_asprintf(ta_parent, "/mpv-%s", name);
+}
+
+struct stream_share {
+    struct mp_log *log;
+    char *shm_name;
+    struct shm_header *hdr;
+    uint8_t *data;
+    size_t map_size;
+    int64_t next_pos;           // stream position following the written data
+};
+
+struct stream_share *stream_share_create(void *ta_parent, struct mp_log *log,
+                                         const char *name, int64_t size)
+{
+    struct stream_share *sh = talloc_zero(ta_parent, struct stream_share);
+    sh->log = log;
+    sh->shm_name = shm_object_name(sh, name);
+    sh->map_size = SHM_HEADER_SIZE + size;
+
+    // Readers still attached to a previous ring keep their mapping, and see
+    // the eof flag of it.
+    shm_unlink(sh->shm_name);
+    int fd = shm_open(sh->shm_name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        MP_ERR(sh, "Could not create shared memory %s.\n", sh->shm_name);
+        goto fail;
+    }
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, sh->map_size) == 0) {
+        map = mmap(NULL, sh->map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        MP_ERR(sh, "Could not map shared memory %s.\n", sh->shm_name);
+        shm_unlink(sh->shm_name);
+        goto fail;
+    }
+
+    sh->hdr = map;
+    sh->data = (uint8_t *)map + SHM_HEADER_SIZE;
+    *sh->hdr = (struct shm_header){
+        .header_size = SHM_HEADER_SIZE,
+        .size = size,
+    };
+    // Publish the header last, so readers never see a partial header.
+    atomic_thread_fence(memory_order_release);
+    sh->hdr->magic = SHM_MAGIC;
+
+    MP_VERBOSE(sh, "Sharing stream as shm://%s.\n", name);
+    return sh;
+
+fail:
+    talloc_free(sh);
+    return NULL;
+}
+
+// Append data read from stream position pos. Data that was already written
+// (when re-reading after a seek back) is skipped.
+void stream_share_write(struct stream_share *sh, int64_t pos, void *buf,
+                        int len)
+{
+    uint8_t *src = buf;
+    if (pos < sh->next_pos) {
+        int64_t skip = MPMIN(sh->next_pos - pos, len);
+        src += skip;
+        len -= skip;
+        pos += skip;
+    }
+    if (!len)
+        return;
+    sh->next_pos = pos + len;
+
+    uint64_t size = sh->hdr->size;
+    if ((uint64_t)len > size) {
+        src += len - size;
+        len = size;
+    }
+
+    uint64_t wpos = atomic_load_explicit(&sh->hdr->write_pos,
+                                         memory_order_relaxed);
+    atomic_store_explicit(&sh->hdr->write_start, wpos + len,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    while (len) {
+        size_t offset = wpos % size;
+        size_t copy = MPMIN(len, size - offset);
+        memcpy(sh->data + offset, src, copy);
+        src += copy;
+        len -= copy;
+        wpos += copy;
+    }
+    atomic_store_explicit(&sh->hdr->write_pos, wpos, memory_order_release);
+}
+
+void stream_share_destroy(struct stream_share *sh)
+{
+    if (!sh)
+        return;
+    atomic_store(&sh->hdr->eof, true);
+    munmap(sh->hdr, sh->map_size);
+    shm_unlink(sh->shm_name);
+    talloc_free(sh);
+}
+
+struct priv {
+    struct shm_header *hdr;
+    uint8_t *data;
+    size_t map_size;
+    uint64_t pos;
+};
+
+// Start at a bit of backlog, so the demuxer finds a keyframe soon.
+static uint64_t start_pos(struct priv *p)
+{
+    uint64_t wpos = atomic_load_explicit(&p->hdr->write_pos,
+                                         memory_order_acquire);
+    return wpos - MPMIN(wpos, p->hdr->size / 4);
+}
+
+static int fill_buffer(stream_t *s, void *buffer, int max_len)
+{
+    struct priv *p = s->priv;
+    uint64_t size = p->hdr->size;
+
+    while (1) {
+        uint64_t wpos = atomic_load_explicit(&p->hdr->write_pos,
+                                             memory_order_acquire);
+        if (wpos > p->pos) {
+            int len = MPMIN(max_len, wpos - p->pos);
+            uint64_t pos = p->pos;
+            uint8_t *dst = buffer;
+            for (int left = len; left > 0;) {
+                size_t offset = pos % size;
+                size_t copy = MPMIN(left, size - offset);
+                memcpy(dst, p->data + offset, copy);
+                dst += copy;
+                left -= copy;
+                pos += copy;
+            }
+            // Check whether the writer overwrote the data while we copied it.
+            atomic_thread_fence(memory_order_acquire);
+            uint64_t wstart = atomic_load_explicit(&p->hdr->write_start,
+                                                   memory_order_relaxed);
+            if (wstart - p->pos <= size) {
+                p->pos += len;
+                return len;
+            }
+            MP_WARN(s, "Reading too slowly, skipping data.\n");
+            p->pos = start_pos(p);
+            continue;
+        }
+        if (atomic_load(&p->hdr->eof))
+            return 0;
+        if (s->cancel) {
+            if (mp_cancel_wait(s->cancel, SHM_POLL_INTERVAL))
+                return 0;
+        } else {
+            mp_sleep_us(SHM_POLL_INTERVAL * 1e6);
+        }
+    }
+}
+
+static void s_close(stream_t *s)
+{
+    struct priv *p = s->priv;
+    munmap(p->hdr, p->map_size);
+}
+
+static int open_f(stream_t *s)
+{
+    struct priv *p = talloc_zero(s, struct priv);
+    s->priv = p;
+
+    char *shm_name = shm_object_name(s, s->path);
+    int fd = shm_open(shm_name, O_RDONLY, 0);
+    if (fd < 0) {
+        MP_ERR(s, "Could not open shared memory %s.\n", shm_name);
+        return STREAM_ERROR;
+    }
+
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > SHM_HEADER_SIZE) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        p->map_size = st.st_size;
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        MP_ERR(s, "Could not map shared memory %s.\n", shm_name);
+        return STREAM_ERROR;
+    }
+    p->hdr = map;
+    p->data = (uint8_t *)map + SHM_HEADER_SIZE;
+
+    atomic_thread_fence(memory_order_acquire);
+    if (p->hdr->magic != SHM_MAGIC || p->hdr->header_size != SHM_HEADER_SIZE ||
+        p->hdr->size != p->map_size - SHM_HEADER_SIZE)
+    {
+        MP_ERR(s, "%s is not a shared mpv stream.\n", shm_name);
+        munmap(map, p->map_size);
+        return STREAM_ERROR;
+    }
+
+    p->pos = start_pos(p);
+
+    s->fill_buffer = fill_buffer;
+    s->close = s_close;
+    s->streaming = true;
+
+    return STREAM_OK;
+}
+
+const stream_info_t stream_info_shm = {
+    .name = "shm",
+    .open = open_f,
+    .protocols = (const char*const[]){ "shm", NULL },
+    .stream_origin = STREAM_ORIGIN_UNSAFE,
+};
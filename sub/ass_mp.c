@@ -37,6 +37,7 @@
 #include "osd.h"
 #include "stream/stream.h"
 #include "options/options.h"
+#include "osdep/atomic.h"
 #include "video/out/bitmap_packer.h"
 #include "video/mp_image.h"
 
@@ -194,6 +195,41 @@ static void draw_ass_rgba(unsigned char *src, int src_w, int src_h,
     }
 }
 
+// Persistent atlas for SUBBITMAP_LIBASS. libass returns the same (cached)
+// bitmaps for glyphs that didn't change, so these stay where they are, and only
+// new bitmaps are copied into it (and need to be uploaded by the VO). Space is
+// allocated in shelves (rows of bitmaps with similar height), and a shelf is
+// reclaimed as a whole once none of its bitmaps was used in the current frame.
+#define ATLAS_MIN_SIZE 256
+#define ATLAS_MAX_SIZE 8192
+
+struct atlas_slot {
+    const void *bitmap;     // libass bitmap the contents were copied from
+    int w, h, stride;
+    int x, y;
+    int shelf;
+};
+
+struct atlas_shelf {
+    int y, h;
+    int x;                  // allocated up to here
+    int64_t last_used;      // atlas.frame
+};
+
+struct atlas {
+    struct mp_image *img;
+    struct atlas_shelf *shelves;
+    int num_shelves;
+    // slots[0..num_sorted-1] are sorted by bitmap pointer, the rest were
+    // added in the current frame.
+    struct atlas_slot *slots;
+    int num_slots, num_sorted;
+    int64_t frame;
+    int64_t id;             // sub_bitmaps.packed_id of the current contents
+};
+
+static mp_atomic_int64 atlas_next_id = ATOMIC_VAR_INIT(1);
+
 struct mp_ass_packer {
     struct sub_bitmap *cached_parts; // only for the array memory
     struct mp_image *cached_img;
@@ -201,6 +237,7 @@ struct mp_ass_packer {
     bool cached_subs_valid;
     struct sub_bitmap rgba_imgs[MP_SUB_BB_LIST_MAX];
     struct bitmap_packer *packer;
+    struct atlas *atlas;
 };
 
 // Free with talloc_free().
@@ -208,6 +245,7 @@ struct mp_ass_packer *mp_ass_packer_alloc(void *ta_parent)
 {
     struct mp_ass_packer *p = talloc_zero(ta_parent, struct mp_ass_packer);
     p->packer = talloc_zero(p, struct bitmap_packer);
+    p->atlas = talloc_zero(p, struct atlas);
     return p;
 }
 
@@ -258,20 +296,233 @@ static bool pack(struct mp_ass_packer *p, struct sub_bitmaps *res, int imgfmt)
     return true;
 }
 
+static int compare_slot(const void *pa, const void *pb)
+{
+    const struct atlas_slot *a = pa, *b = pb;
+    uintptr_t ka = (uintptr_t)a->bitmap, kb = (uintptr_t)b->bitmap;
+    return ka < kb ? -1 : (ka > kb);
+}
+
+static bool slot_matches(struct atlas *a, struct atlas_slot *s,
+                         struct sub_bitmap *b)
+{
+    if (s->bitmap != b->bitmap || s->w != b->w || s->h != b->h ||
+        s->stride != b->stride)
+        return false;
+    // libass may have reused the memory for a different bitmap.
+    int stride = a->img->stride[0];
+    uint8_t *src = b->bitmap;
+    uint8_t *dst = a->img->planes[0] + s->y * stride + s->x;
+    for (int y = 0; y < s->h; y++) {
+        if (memcmp(dst + y * stride, src + y * b->stride, s->w))
+            return false;
+    }
+    return true;
+}
+
+static struct atlas_slot *atlas_find(struct atlas *a, struct sub_bitmap *b)
+{
+    // Lower bound in the sorted part.
+    int lo = 0, hi = a->num_sorted;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if ((uintptr_t)a->slots[mid].bitmap < (uintptr_t)b->bitmap) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    for (int n = lo; n < a->num_sorted && a->slots[n].bitmap == b->bitmap; n++) {
+        if (slot_matches(a, &a->slots[n], b))
+            return &a->slots[n];
+    }
+    for (int n = a->num_sorted; n < a->num_slots; n++) {
+        if (slot_matches(a, &a->slots[n], b))
+            return &a->slots[n];
+    }
+    return NULL;
+}
+
+static void atlas_reset(struct atlas *a)
+{
+    a->num_shelves = 0;
+    a->num_slots = a->num_sorted = 0;
+}
+
+// Free the shelves not used in the current frame, and drop their slots.
+static void atlas_evict(struct atlas *a)
+{
+    for (int n = 0; n < a->num_shelves; n++) {
+        if (a->shelves[n].last_used != a->frame)
+            a->shelves[n].x = 0;
+    }
+    // Empty shelves at the bottom can be reused with a different height.
+    while (a->num_shelves && !a->shelves[a->num_shelves - 1].x)
+        a->num_shelves--;
+
+    int num = 0, num_sorted = 0;
+    for (int n = 0; n < a->num_slots; n++) {
+        struct atlas_slot *s = &a->slots[n];
+        if (s->shelf < a->num_shelves && a->shelves[s->shelf].x) {
+            num_sorted += n < a->num_sorted;
+            a->slots[num++] = *s;
+        }
+    }
+    a->num_slots = num;
+    a->num_sorted = num_sorted;
+}
+
+static int atlas_find_shelf(struct atlas *a, int w, int h)
+{
+    int best = -1;
+    for (int n = 0; n < a->num_shelves; n++) {
+        struct atlas_shelf *sh = &a->shelves[n];
+        if (sh->h >= h && sh->x + w <= a->img->w &&
+            (best < 0 || sh->h < a->shelves[best].h))
+            best = n;
+    }
+    // Start a new shelf rather than wasting much of a taller one.
+    int bottom = a->num_shelves ? a->shelves[a->num_shelves - 1].y +
+                                  a->shelves[a->num_shelves - 1].h : 0;
+    if ((best < 0 || a->shelves[best].h > h + h / 2 + 2) &&
+        bottom + h <= a->img->h && w <= a->img->w)
+    {
+        MP_TARRAY_APPEND(a, a->shelves, a->num_shelves,
+                         (struct atlas_shelf){.y = bottom, .h = h});
+        best = a->num_shelves - 1;
+    }
+    return best;
+}
+
+// Double the atlas size, keeping the contents.
+static bool atlas_grow(struct atlas *a)
+{
+    int w = a->img->w, h = a->img->h;
+    if (w <= h) {
+        w *= 2;
+    } else {
+        h *= 2;
+    }
+    if (w > ATLAS_MAX_SIZE || h > ATLAS_MAX_SIZE)
+        return false;
+    struct mp_image *img = mp_image_alloc(IMGFMT_Y8, w, h);
+    if (!img)
+        return false;
+    memcpy_pic(img->planes[0], a->img->planes[0], a->img->w, a->img->h,
+               img->stride[0], a->img->stride[0]);
+    talloc_free(a->img);
+    a->img = talloc_steal(a, img);
+    return true;
+}
+
+// Copy b into the atlas. *full is set if the atlas was reallocated.
+static struct atlas_slot *atlas_insert(struct atlas *a, struct sub_bitmap *b,
+                                       bool *full)
+{
+    int shelf = atlas_find_shelf(a, b->w, b->h);
+    if (shelf < 0) {
+        atlas_evict(a);
+        shelf = atlas_find_shelf(a, b->w, b->h);
+    }
+    while (shelf < 0 && atlas_grow(a)) {
+        *full = true;
+        shelf = atlas_find_shelf(a, b->w, b->h);
+    }
+    if (shelf < 0)
+        return NULL;
+
+    struct atlas_shelf *sh = &a->shelves[shelf];
+    struct atlas_slot s = {
+        .bitmap = b->bitmap,
+        .w = b->w,
+        .h = b->h,
+        .stride = b->stride,
+        .x = sh->x,
+        .y = sh->y,
+        .shelf = shelf,
+    };
+    sh->x += b->w;
+
+    int stride = a->img->stride[0];
+    memcpy_pic(a->img->planes[0] + s.y * stride + s.x, b->bitmap, b->w, b->h,
+               stride, b->stride);
+
+    MP_TARRAY_APPEND(a, a->slots, a->num_slots, s);
+    return &a->slots[a->num_slots - 1];
+}
+
 static bool pack_libass(struct mp_ass_packer *p, struct sub_bitmaps *res)
 {
-    if (!pack(p, res, IMGFMT_Y8))
+    struct atlas *a = p->atlas;
+
+    if (!res->num_parts)
         return false;
 
+    if (!a->img) {
+        a->img = mp_image_alloc(IMGFMT_Y8, ATLAS_MIN_SIZE, ATLAS_MIN_SIZE);
+        if (!a->img)
+            return false;
+        talloc_steal(a, a->img);
+        atlas_reset(a);
+        a->id = 0;
+    }
+    if (!mp_image_make_writeable(a->img))
+        return false;
+
+    a->frame++;
+    bool full = false, was_reset = false;
+    struct mp_rect dirty = {0};
+
+retry:
     for (int n = 0; n < res->num_parts; n++) {
         struct sub_bitmap *b = &res->parts[n];
+        struct atlas_slot *s = atlas_find(a, b);
+        if (!s) {
+            s = atlas_insert(a, b, &full);
+            if (!s) {
+                // Too fragmented (or too large): start over with only the
+                // bitmaps of this frame. This invalidates the positions
+                // assigned so far.
+                if (was_reset)
+                    return false;
+                atlas_reset(a);
+                full = was_reset = true;
+                goto retry;
+            }
+            mp_rect_extend(&dirty, &(struct mp_rect){s->x, s->y,
+                                                     s->x + s->w, s->y + s->h});
+        }
+        a->shelves[s->shelf].last_used = a->frame;
+        b->src_x = s->x;
+        b->src_y = s->y;
+    }
+
+    if (a->num_slots > a->num_sorted) {
+        qsort(a->slots, a->num_slots, sizeof(a->slots[0]), compare_slot);
+        a->num_sorted = a->num_slots;
+    }
+
+    res->packed = a->img;
+    res->packed_w = res->packed_h = 0;
+    for (int n = 0; n < a->num_shelves; n++) {
+        res->packed_w = MPMAX(res->packed_w, a->shelves[n].x);
+        res->packed_h = a->shelves[n].y + a->shelves[n].h;
+    }
 
-        int stride = res->packed->stride[0];
-        void *pdata =
-            (uint8_t *)res->packed->planes[0] + b->src_y * stride + b->src_x;
-        memcpy_pic(pdata, b->bitmap, b->w, b->h, stride, b->stride);
+    res->packed_prev_id = a->id;
+    if (full || !a->id) {
+        res->packed_prev_id = 0;
+        dirty = (struct mp_rect){0, 0, res->packed_w, res->packed_h};
+    }
+    if (dirty.x1 > dirty.x0)
+        a->id = atomic_fetch_add(&atlas_next_id, 1);
+    res->packed_id = a->id;
+    res->packed_dirty = dirty;
 
-        b->bitmap = pdata;
+    int stride = a->img->stride[0];
+    for (int n = 0; n < res->num_parts; n++) {
+        struct sub_bitmap *b = &res->parts[n];
+        b->bitmap = a->img->planes[0] + b->src_y * stride + b->src_x;
         b->stride = stride;
     }
 
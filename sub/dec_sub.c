@@ -31,8 +31,11 @@
 #include "common/global.h"
 #include "common/msg.h"
 #include "common/recorder.h"
+#include "common/stats.h"
 #include "misc/dispatch.h"
+#include "osdep/atomic.h"
 #include "osdep/threads.h"
+#include "video/mp_image.h"
 
 extern const struct sd_functions sd_ass;
 extern const struct sd_functions sd_lavc;
@@ -43,10 +46,15 @@ static const struct sd_functions *const sd_list[] = {
     NULL
 };
 
+// Container timestamps are often rounded to ms, so the predicted PTS can be
+// off by that much. libass renders at ms granularity anyway.
+#define AHEAD_PTS_TOLERANCE 0.0015
+
 struct dec_sub {
     pthread_mutex_t lock;
 
     struct mp_log *log;
+    struct stats_ctx *stats;
     struct mpv_global *global;
     struct mp_subtitle_opts *opts;
     struct m_config_cache *opts_cache;
@@ -70,8 +78,157 @@ struct dec_sub {
     struct sd *sd;
 
     struct demux_packet *new_segment;
+
+    // --sub-render-ahead: the next frame is rendered on ahead_thread while
+    // the VO is idle. Protected by lock, like everything else.
+    pthread_t ahead_thread;
+    bool ahead_thread_valid;
+    pthread_cond_t ahead_wakeup;
+    bool ahead_terminate;
+    bool ahead_request;             // render ahead_pts/dim/format
+    bool ahead_done;                // ahead_res is the result for them
+    double ahead_pts;
+    struct mp_osd_res ahead_dim;
+    int ahead_format;
+    struct sub_bitmaps *ahead_res;  // may be NULL even if ahead_done
+    bool ahead_discarded;           // renderer state moved on without the VO
+    double prev_render_pts;
+    struct mp_osd_res vo_dim;       // parameters of the last VO render
+    int vo_format;
+    // Video PTS of the frame queued to the VO (sub_set_next_video_pts()).
+    // Written without lock, so a render ahead doesn't block the caller.
+    mp_atomic_double next_video_pts;
+    struct mp_image_params video_params;
 };
 
+// Called locked.
+static void discard_ahead(struct dec_sub *sub)
+{
+    // The discarded render updated the renderer's change detection, so the
+    // next result must be treated as changed.
+    if (sub->ahead_done)
+        sub->ahead_discarded = true;
+    sub->ahead_request = false;
+    sub->ahead_done = false;
+    TA_FREEP(&sub->ahead_res);
+}
+
+static double pts_to_subtitle(struct dec_sub *sub, double pts);
+static void apply_next_video_pts(struct dec_sub *sub);
+
+static void *render_ahead_thread(void *arg)
+{
+    struct dec_sub *sub = arg;
+    mpthread_set_name("sub/render");
+
+    pthread_mutex_lock(&sub->lock);
+    while (!sub->ahead_terminate) {
+        if (!sub->ahead_request) {
+            pthread_cond_wait(&sub->ahead_wakeup, &sub->lock);
+            continue;
+        }
+        sub->ahead_request = false;
+
+        double pts = sub->ahead_pts;
+        // Don't render into a segment the decoder hasn't switched to yet.
+        if ((sub->new_segment && pts >= sub->new_segment->start) ||
+            (sub->end != MP_NOPTS_VALUE && pts >= sub->end))
+            continue;
+
+        sub->ahead_res = sub->sd->driver->get_bitmaps(sub->sd, sub->ahead_dim,
+                                                      sub->ahead_format, pts);
+        sub->ahead_done = true;
+
+        // The next frame may have been queued while rendering.
+        apply_next_video_pts(sub);
+    }
+    pthread_mutex_unlock(&sub->lock);
+    return NULL;
+}
+
+// Called locked.
+static void start_render_ahead(struct dec_sub *sub, struct mp_osd_res dim,
+                               int format, double pts)
+{
+    if (!sub->ahead_thread_valid) {
+        if (pthread_create(&sub->ahead_thread, NULL, render_ahead_thread, sub))
+            return;
+        sub->ahead_thread_valid = true;
+    }
+
+    discard_ahead(sub);
+    sub->ahead_request = true;
+    sub->ahead_pts = pts;
+    sub->ahead_dim = dim;
+    sub->ahead_format = format;
+    pthread_cond_signal(&sub->ahead_wakeup);
+}
+
+// Called locked. Return the subtitle PTS of the frame queued to the VO, if it
+// is after the last rendered frame.
+static double get_next_pts(struct dec_sub *sub)
+{
+    double pts = pts_to_subtitle(sub, atomic_load(&sub->next_video_pts));
+    if (pts == MP_NOPTS_VALUE || sub->prev_render_pts == MP_NOPTS_VALUE ||
+        pts < sub->prev_render_pts + AHEAD_PTS_TOLERANCE)
+        return MP_NOPTS_VALUE;
+    return pts;
+}
+
+// Called locked. Restart rendering ahead if the queued frame is not what is
+// being rendered ahead.
+static void apply_next_video_pts(struct dec_sub *sub)
+{
+    double pts = get_next_pts(sub);
+    if (pts == MP_NOPTS_VALUE || !sub->opts->sub_render_ahead ||
+        !sub->sd->driver->can_render_ahead)
+        return;
+    if ((sub->ahead_request || sub->ahead_done) &&
+        fabs(sub->ahead_pts - pts) < AHEAD_PTS_TOLERANCE)
+        return;
+    start_render_ahead(sub, sub->vo_dim, sub->vo_format, pts);
+}
+
+// Called locked. Queue rendering the next frame. Its PTS is known if it was
+// already queued to the VO, otherwise it's predicted from the interval to the
+// previous frame.
+static void request_render_ahead(struct dec_sub *sub, struct mp_osd_res dim,
+                                 int format, double pts)
+{
+    double prev = sub->prev_render_pts;
+    sub->prev_render_pts = pts;
+    sub->vo_dim = dim;
+    sub->vo_format = format;
+
+    if (!sub->opts->sub_render_ahead || !sub->sd->driver->can_render_ahead ||
+        pts == MP_NOPTS_VALUE || prev == MP_NOPTS_VALUE)
+        return;
+
+    double next = get_next_pts(sub);
+    if (next != MP_NOPTS_VALUE) {
+        start_render_ahead(sub, dim, format, next);
+        return;
+    }
+
+    double frametime = pts - prev;
+    if (!(frametime > 0 && frametime < 1))
+        return;
+
+    start_render_ahead(sub, dim, format, pts + frametime);
+}
+
+// Tell the renderer which video frame the VO is going to draw next, so it can
+// render ahead for exactly that PTS instead of guessing it. Doesn't wait if a
+// render is in progress; the render ahead thread picks it up when done.
+void sub_set_next_video_pts(struct dec_sub *sub, double video_pts)
+{
+    atomic_store(&sub->next_video_pts, video_pts);
+    if (pthread_mutex_trylock(&sub->lock) == 0) {
+        apply_next_video_pts(sub);
+        pthread_mutex_unlock(&sub->lock);
+    }
+}
+
 static void update_subtitle_speed(struct dec_sub *sub)
 {
     struct mp_subtitle_opts *opts = sub->opts;
@@ -121,11 +278,19 @@ void sub_destroy(struct dec_sub *sub)
     if (!sub)
         return;
     demux_set_stream_wakeup_cb(sub->sh, NULL, NULL);
+    if (sub->ahead_thread_valid) {
+        pthread_mutex_lock(&sub->lock);
+        sub->ahead_terminate = true;
+        pthread_cond_signal(&sub->ahead_wakeup);
+        pthread_mutex_unlock(&sub->lock);
+        pthread_join(sub->ahead_thread, NULL);
+    }
     if (sub->sd) {
         sub_reset(sub);
         sub->sd->driver->uninit(sub->sd);
     }
     talloc_free(sub->sd);
+    pthread_cond_destroy(&sub->ahead_wakeup);
     pthread_mutex_destroy(&sub->lock);
     talloc_free(sub);
 }
@@ -180,9 +345,13 @@ struct dec_sub *sub_create(struct mpv_global *global, struct sh_stream *sh,
         .last_vo_pts = MP_NOPTS_VALUE,
         .start = MP_NOPTS_VALUE,
         .end = MP_NOPTS_VALUE,
+        .prev_render_pts = MP_NOPTS_VALUE,
+        .next_video_pts = MP_NOPTS_VALUE,
     };
     sub->opts = sub->opts_cache->opts;
+    sub->stats = stats_ctx_create(sub, global, "sub");
     mpthread_mutex_init_recursive(&sub->lock);
+    pthread_cond_init(&sub->ahead_wakeup, NULL);
 
     sub->sd = init_decoder(sub);
     if (sub->sd) {
@@ -203,6 +372,8 @@ static void update_segment(struct dec_sub *sub)
         MP_VERBOSE(sub, "Switch segment: %f at %f\n", sub->new_segment->start,
                    sub->last_vo_pts);
 
+        discard_ahead(sub);
+
         sub->codec = sub->new_segment->codec;
         sub->start = sub->new_segment->start;
         sub->end = sub->new_segment->end;
@@ -258,6 +429,8 @@ void sub_preload(struct dec_sub *sub)
     demux_set_stream_wakeup_cb(sub->sh, NULL, NULL);
     talloc_free(demux_waiter);
 
+    discard_ahead(sub);
+
     pthread_mutex_unlock(&sub->lock);
 }
 
@@ -319,8 +492,10 @@ bool sub_read_packets(struct dec_sub *sub, double video_pts)
             break;
         }
 
-        if (!(sub->preload_attempted && sub->sd->preload_ok))
+        if (!(sub->preload_attempted && sub->sd->preload_ok)) {
             sub->sd->driver->decode(sub->sd, pkt);
+            discard_ahead(sub);
+        }
 
         talloc_free(pkt);
     }
@@ -341,9 +516,32 @@ struct sub_bitmaps *sub_get_bitmaps(struct dec_sub *sub, struct mp_osd_res dim,
 
     struct sub_bitmaps *res = NULL;
 
-    if (!(sub->end != MP_NOPTS_VALUE && pts >= sub->end) &&
-        sub->sd->driver->get_bitmaps)
-        res = sub->sd->driver->get_bitmaps(sub->sd, dim, format, pts);
+    if (sub->ahead_done && fabs(sub->ahead_pts - pts) < AHEAD_PTS_TOLERANCE &&
+        osd_res_equals(sub->ahead_dim, dim) && sub->ahead_format == format)
+    {
+        stats_event(sub->stats, "render-ahead-hit");
+        res = sub->ahead_res;
+        sub->ahead_res = NULL;
+        sub->ahead_done = false;
+    } else {
+        if (sub->ahead_done)
+            stats_event(sub->stats, "render-ahead-miss");
+        discard_ahead(sub);
+
+        if (!(sub->end != MP_NOPTS_VALUE && pts >= sub->end) &&
+            sub->sd->driver->get_bitmaps)
+        {
+            stats_time_start(sub->stats, "render");
+            res = sub->sd->driver->get_bitmaps(sub->sd, dim, format, pts);
+            stats_time_end(sub->stats, "render");
+        }
+    }
+
+    if (res && sub->ahead_discarded)
+        res->change_id += 1;
+    sub->ahead_discarded = false;
+
+    request_render_ahead(sub, dim, format, pts);
 
     pthread_mutex_unlock(&sub->lock);
     return res;
@@ -388,8 +586,11 @@ void sub_reset(struct dec_sub *sub)
     pthread_mutex_lock(&sub->lock);
     if (sub->sd->driver->reset)
         sub->sd->driver->reset(sub->sd);
+    discard_ahead(sub);
     sub->last_pkt_pts = MP_NOPTS_VALUE;
     sub->last_vo_pts = MP_NOPTS_VALUE;
+    sub->prev_render_pts = MP_NOPTS_VALUE;
+    atomic_store(&sub->next_video_pts, MP_NOPTS_VALUE);
     talloc_free(sub->new_segment);
     sub->new_segment = NULL;
     pthread_mutex_unlock(&sub->lock);
@@ -400,6 +601,7 @@ void sub_select(struct dec_sub *sub, bool selected)
     pthread_mutex_lock(&sub->lock);
     if (sub->sd->driver->select)
         sub->sd->driver->select(sub->sd, selected);
+    discard_ahead(sub);
     pthread_mutex_unlock(&sub->lock);
 }
 
@@ -408,7 +610,16 @@ int sub_control(struct dec_sub *sub, enum sd_ctrl cmd, void *arg)
     int r = CONTROL_UNKNOWN;
     pthread_mutex_lock(&sub->lock);
     bool propagate = false;
+    bool changed = true;
     switch (cmd) {
+    case SD_CTRL_SET_VIDEO_PARAMS: {
+        // This is set on every playloop iteration.
+        struct mp_image_params *params = arg;
+        changed = !mp_image_params_equal(&sub->video_params, params);
+        sub->video_params = *params;
+        propagate = true;
+        break;
+    }
     case SD_CTRL_SET_VIDEO_DEF_FPS:
         sub->video_fps = *(double *)arg;
         update_subtitle_speed(sub);
@@ -433,6 +644,8 @@ int sub_control(struct dec_sub *sub, enum sd_ctrl cmd, void *arg)
     }
     if (propagate && sub->sd->driver->control)
         r = sub->sd->driver->control(sub->sd, cmd, arg);
+    if (changed)
+        discard_ahead(sub);
     pthread_mutex_unlock(&sub->lock);
     return r;
 }
@@ -448,6 +661,7 @@ void sub_set_play_dir(struct dec_sub *sub, int dir)
 {
     pthread_mutex_lock(&sub->lock);
     sub->play_dir = dir;
+    discard_ahead(sub);
     pthread_mutex_unlock(&sub->lock);
 }
 
@@ -20,10 +20,16 @@
 #include <assert.h>
 #include <math.h>
 #include <inttypes.h>
+#include <limits.h>
 
+#include <libavutil/cpu.h>
+
+#include "config.h"
 #include "common/common.h"
 #include "draw_bmp.h"
 #include "img_convert.h"
+#include "misc/thread_pool.h"
+#include "misc/thread_tools.h"
 #include "video/mp_image.h"
 #include "video/repack.h"
 #include "video/sws_utils.h"
@@ -54,10 +60,37 @@ struct part {
 #define SCALE_IN_TILES 1
 #define TILE_H 4u
 
+// Compositing is split into horizontal bands, which are run in parallel. A
+// band is never smaller than this (except at the bottom). Aligned to TILE_H.
+#define MIN_BAND_H 64
+#define MAX_BANDS 16
+
 struct slice {
     uint16_t x0, x1;
 };
 
+// Per-thread state for converting and blending a range of lines. Everything
+// in here is stateful (buffers, scaler contexts), so each band needs its own.
+struct band {
+    struct mp_draw_sub_cache *p;
+    struct mp_image *dst;           // blend target
+    int y0, y1;                     // range of lines (aligned to TILE_H)
+    bool convert;                   // convert tiles to video_overlay first
+
+    struct mp_sws_context *rgba_to_overlay;
+    struct mp_sws_context *alpha_to_calpha;
+
+    struct mp_repack *overlay_to_f32;
+    struct mp_image *overlay_tmp;
+    struct mp_repack *calpha_to_f32;
+    struct mp_image *calpha_tmp;
+    struct mp_repack *video_to_f32;
+    struct mp_repack *video_from_f32;
+    struct mp_image *video_tmp;
+
+    struct mp_waiter thread_waiter;
+};
+
 struct mp_draw_sub_cache
 {
     struct mpv_global *global;
@@ -79,6 +112,7 @@ struct mp_draw_sub_cache
     unsigned s_w;                   // number of slices per line
     struct slice *slices;           // slices[y * s_w + x / SLICE_W]
     bool any_osd;
+    int dirty_y0, dirty_y1;         // range of lines with any slices marked
 
     struct mp_sws_context *rgba_to_overlay; // scaler for rgba -> video csp.
     struct mp_sws_context *alpha_to_calpha; // scaler for overlay -> calpha
@@ -100,6 +134,13 @@ struct mp_draw_sub_cache
     struct mp_sws_context *unpremul; // reverse
     struct mp_image *premul_tmp;
 
+    const struct mp_draw_sub_kernels *kernels;
+
+    int rflags;                     // REPACK_CREATE_* flags used for bands
+    struct band **bands;            // bands[0] references the fields above
+    int num_bands;
+    struct mp_thread_pool *tp;      // for bands[1..num_bands-1]
+
     // Function that works on the _f32 data.
     void (*blend_line)(void *dst, void *src, void *src_a, int w);
 
@@ -126,11 +167,11 @@ static void blend_line_u8(void *dst, void *src, void *src_a, int w)
         dst_i[x] = src_i[x] + dst_i[x] * (255u - src_a_i[x]) / 255u;
 }
 
-static void blend_slice(struct mp_draw_sub_cache *p)
+static void blend_slice(struct band *b)
 {
-    struct mp_image *ov = p->overlay_tmp;
-    struct mp_image *ca = p->calpha_tmp;
-    struct mp_image *vid = p->video_tmp;
+    struct mp_image *ov = b->overlay_tmp;
+    struct mp_image *ca = b->calpha_tmp;
+    struct mp_image *vid = b->video_tmp;
 
     for (int plane = 0; plane < vid->num_planes; plane++) {
         int xs = vid->fmt.xs[plane];
@@ -138,27 +179,29 @@ static void blend_slice(struct mp_draw_sub_cache *p)
         int h = (1 << vid->fmt.chroma_ys) - (1 << ys) + 1;
         int cw = mp_chroma_div_up(vid->w, xs);
         for (int y = 0; y < h; y++) {
-            p->blend_line(mp_image_pixel_ptr_ny(vid, plane, 0, y),
-                          mp_image_pixel_ptr_ny(ov, plane, 0, y),
-                          xs || ys ? mp_image_pixel_ptr_ny(ca, 0, 0, y)
-                            : mp_image_pixel_ptr_ny(ov, ov->num_planes - 1, 0, y),
-                          cw);
+            b->p->blend_line(mp_image_pixel_ptr_ny(vid, plane, 0, y),
+                             mp_image_pixel_ptr_ny(ov, plane, 0, y),
+                             xs || ys ? mp_image_pixel_ptr_ny(ca, 0, 0, y)
+                               : mp_image_pixel_ptr_ny(ov, ov->num_planes - 1, 0, y),
+                             cw);
         }
     }
 }
 
-static bool blend_overlay_with_video(struct mp_draw_sub_cache *p,
-                                     struct mp_image *dst)
+static bool blend_overlay_with_video(struct band *b)
 {
-    if (!repack_config_buffers(p->video_to_f32, 0, p->video_tmp, 0, dst, NULL))
+    struct mp_draw_sub_cache *p = b->p;
+    struct mp_image *dst = b->dst;
+
+    if (!repack_config_buffers(b->video_to_f32, 0, b->video_tmp, 0, dst, NULL))
         return false;
-    if (!repack_config_buffers(p->video_from_f32, 0, dst, 0, p->video_tmp, NULL))
+    if (!repack_config_buffers(b->video_from_f32, 0, dst, 0, b->video_tmp, NULL))
         return false;
 
     int xs = dst->fmt.chroma_xs;
     int ys = dst->fmt.chroma_ys;
 
-    for (int y = 0; y < dst->h; y += p->align_y) {
+    for (int y = b->y0; y < MPMIN(b->y1, dst->h); y += p->align_y) {
         struct slice *line = &p->slices[y * p->s_w];
 
         for (int sx = 0; sx < p->s_w; sx++) {
@@ -173,14 +216,14 @@ static bool blend_overlay_with_video(struct mp_draw_sub_cache *p,
             assert(MP_IS_ALIGNED(w, p->align_x));
             assert(x + w <= p->w);
 
-            repack_line(p->overlay_to_f32, 0, 0, x, y, w);
-            repack_line(p->video_to_f32, 0, 0, x, y, w);
-            if (p->calpha_to_f32)
-                repack_line(p->calpha_to_f32, 0, 0, x >> xs, y >> ys, w >> xs);
+            repack_line(b->overlay_to_f32, 0, 0, x, y, w);
+            repack_line(b->video_to_f32, 0, 0, x, y, w);
+            if (b->calpha_to_f32)
+                repack_line(b->calpha_to_f32, 0, 0, x >> xs, y >> ys, w >> xs);
 
-            blend_slice(p);
+            blend_slice(b);
 
-            repack_line(p->video_from_f32, x, y, 0, 0, w);
+            repack_line(b->video_from_f32, x, y, 0, 0, w);
         }
     }
 
@@ -188,6 +231,8 @@ static bool blend_overlay_with_video(struct mp_draw_sub_cache *p,
 }
 
 static bool convert_overlay_part(struct mp_draw_sub_cache *p,
+                                 struct mp_sws_context *rgba_to_overlay,
+                                 struct mp_sws_context *alpha_to_calpha,
                                  int x0, int y0, int w, int h)
 {
     struct mp_image src = *p->rgba_overlay;
@@ -196,7 +241,7 @@ static bool convert_overlay_part(struct mp_draw_sub_cache *p,
     mp_image_crop(&src, x0, y0, x0 + w, y0 + h);
     mp_image_crop(&dst, x0, y0, x0 + w, y0 + h);
 
-    if (mp_sws_scale(p->rgba_to_overlay, &dst, &src) < 0)
+    if (mp_sws_scale(rgba_to_overlay, &dst, &src) < 0)
         return false;
 
     if (p->calpha_overlay) {
@@ -208,46 +253,106 @@ static bool convert_overlay_part(struct mp_draw_sub_cache *p,
         mp_image_crop(&src, x0, y0, x0 + w, y0 + h);
         mp_image_crop(&dst, x0 >> xs, y0 >> ys, (x0 + w) >> xs, (y0 + h) >> ys);
 
-        if (mp_sws_scale(p->alpha_to_calpha, &dst, &src) < 0)
+        if (mp_sws_scale(alpha_to_calpha, &dst, &src) < 0)
             return false;
     }
 
     return true;
 }
 
-static bool convert_to_video_overlay(struct mp_draw_sub_cache *p)
+// Convert the tiles within the band's lines (only if scale_in_tiles is set).
+static bool convert_tiles(struct band *b)
 {
-    if (!p->video_overlay)
-        return true;
+    struct mp_draw_sub_cache *p = b->p;
 
-    if (p->scale_in_tiles) {
-        int t_h = p->rgba_overlay->h / TILE_H;
-        for (int ty = 0; ty < t_h; ty++) {
-            for (int sx = 0; sx < p->s_w; sx++) {
-                struct slice *s = &p->slices[ty * TILE_H * p->s_w + sx];
-                bool pixels_set = false;
-                for (int y = 0; y < TILE_H; y++) {
-                    if (s[0].x0 < s[0].x1) {
-                        pixels_set = true;
-                        break;
-                    }
-                    s += p->s_w;
+    int t_h = p->rgba_overlay->h / TILE_H;
+    for (int ty = b->y0 / TILE_H; ty < MPMIN(b->y1 / TILE_H, t_h); ty++) {
+        for (int sx = 0; sx < p->s_w; sx++) {
+            struct slice *s = &p->slices[ty * TILE_H * p->s_w + sx];
+            bool pixels_set = false;
+            for (int y = 0; y < TILE_H; y++) {
+                if (s[0].x0 < s[0].x1) {
+                    pixels_set = true;
+                    break;
                 }
-                if (!pixels_set)
-                    continue;
-                if (!convert_overlay_part(p, sx * SLICE_W, ty * TILE_H,
-                                          SLICE_W, TILE_H))
-                    return false;
+                s += p->s_w;
             }
+            if (!pixels_set)
+                continue;
+            if (!convert_overlay_part(p, b->rgba_to_overlay, b->alpha_to_calpha,
+                                      sx * SLICE_W, ty * TILE_H,
+                                      SLICE_W, TILE_H))
+                return false;
         }
-    } else {
-        if (!convert_overlay_part(p, 0, 0, p->rgba_overlay->w, p->rgba_overlay->h))
-            return false;
     }
 
     return true;
 }
 
+// Convert the entire overlay at once (if not scaling in tiles).
+static bool convert_to_video_overlay(struct mp_draw_sub_cache *p)
+{
+    if (!p->video_overlay || p->scale_in_tiles)
+        return true;
+
+    return convert_overlay_part(p, p->rgba_to_overlay, p->alpha_to_calpha, 0, 0,
+                                p->rgba_overlay->w, p->rgba_overlay->h);
+}
+
+static bool process_band(struct band *b)
+{
+    if (b->convert && !convert_tiles(b))
+        return false;
+    return blend_overlay_with_video(b);
+}
+
+static void process_band_thread(void *ptr)
+{
+    struct band *b = ptr;
+
+    mp_waiter_wakeup(&b->thread_waiter, process_band(b));
+}
+
+// Split the lines that have OSD into bands, and process them in parallel. The
+// calling thread processes the first band. Lines outside of the dirty range
+// are never touched.
+static bool process_bands(struct mp_draw_sub_cache *p, struct mp_image *dst,
+                          bool convert)
+{
+    int y0 = MP_ALIGN_DOWN(p->dirty_y0, TILE_H);
+    int y1 = MP_ALIGN_UP(p->dirty_y1, TILE_H);
+    if (y0 >= y1)
+        return true;
+
+    int lines = y1 - y0;
+    int num = MPCLAMP((lines + MIN_BAND_H - 1) / MIN_BAND_H, 1, p->num_bands);
+    int band_h = MP_ALIGN_UP((lines + num - 1) / num, TILE_H);
+    num = (lines + band_h - 1) / band_h;
+
+    for (int n = 0; n < num; n++) {
+        struct band *b = p->bands[n];
+        b->dst = dst;
+        b->y0 = y0 + n * band_h;
+        b->y1 = MPMIN(b->y0 + band_h, y1);
+        b->convert = convert;
+    }
+
+    for (int n = 1; n < num; n++) {
+        struct band *b = p->bands[n];
+        b->thread_waiter = (struct mp_waiter)MP_WAITER_INITIALIZER;
+        bool r = mp_thread_pool_queue(p->tp, process_band_thread, b);
+        // Can't fail, because the pool was created with all threads.
+        assert(r);
+    }
+
+    bool ok = process_band(p->bands[0]);
+
+    for (int n = 1; n < num; n++)
+        ok &= !!mp_waiter_wait(&p->bands[n]->thread_waiter);
+
+    return ok;
+}
+
 // Mark the given rectangle of pixels as possibly non-transparent.
 // The rectangle must have been pre-clipped.
 static void mark_rect(struct mp_draw_sub_cache *p, int x0, int y0, int x1, int y1)
@@ -285,6 +390,11 @@ static void mark_rect(struct mp_draw_sub_cache *p, int x0, int y0, int x1, int y
 
         p->any_osd = true;
     }
+
+    if (y0 < y1) {
+        p->dirty_y0 = MPMIN(p->dirty_y0, y0);
+        p->dirty_y1 = MPMAX(p->dirty_y1, y1);
+    }
 }
 
 static void draw_ass_rgba(uint8_t *dst, ptrdiff_t dst_stride,
@@ -324,9 +434,10 @@ static void render_ass(struct mp_draw_sub_cache *p, struct sub_bitmaps *sb)
     for (int i = 0; i < sb->num_parts; i++) {
         struct sub_bitmap *s = &sb->parts[i];
 
-        draw_ass_rgba(mp_image_pixel_ptr(p->rgba_overlay, 0, s->x, s->y),
-                      p->rgba_overlay->stride[0], s->bitmap, s->stride,
-                      s->w, s->h, s->libass.color);
+        p->kernels->draw_ass_rgba(
+            mp_image_pixel_ptr(p->rgba_overlay, 0, s->x, s->y),
+            p->rgba_overlay->stride[0], s->bitmap, s->stride,
+            s->w, s->h, s->libass.color);
 
         mark_rect(p, s->x, s->y, s->x + s->w, s->y + s->h);
     }
@@ -360,6 +471,213 @@ static void draw_rgba(uint8_t *dst, ptrdiff_t dst_stride,
     }
 }
 
+static const struct mp_draw_sub_kernels kernels_c = {
+    .name = "c",
+    .blend_line_f32 = blend_line_f32,
+    .blend_line_u8 = blend_line_u8,
+    .draw_ass_rgba = draw_ass_rgba,
+    .draw_rgba = draw_rgba,
+};
+
+// Vector versions of the functions above. They use exactly the same integer
+// and float operations, just on several pixels at once, so the results are
+// bit-identical (test/draw_bmp.c checks this). The generic code gets SSE2 on
+// x86-64 and NEON on aarch64; it's compiled once more for AVX2.
+
+// (__builtin_convertvector() needs GCC 9.)
+#if HAVE_VECTOR && (defined(__clang__) || __GNUC__ >= 9)
+
+typedef float v8sf __attribute__((vector_size(32), aligned(1)));
+typedef uint32_t v8su __attribute__((vector_size(32), aligned(1)));
+typedef int32_t v8si __attribute__((vector_size(32), aligned(1)));
+typedef uint16_t v16hu __attribute__((vector_size(32), aligned(1)));
+typedef uint8_t v16qu __attribute__((vector_size(16), aligned(1)));
+typedef uint8_t v8qu __attribute__((vector_size(8), aligned(1)));
+
+// Integer division by a constant is not natively vectorized by compilers for
+// all lane types, so it's done with exact equivalents:
+//  DIV255: x / 255 for x <= 255 * 255
+//  DIV65025: x / (255 * 255) for x <= 255 * 255 * 255; the float estimate is
+//            off by at most 1, and the remainder check corrects it.
+#define DIV255(x) (((x) + 1 + ((x) >> 8)) >> 8)
+
+#define DIV65025(out, x) do {                                               \
+    v8si n_ = (v8si)(x);                                                    \
+    v8sf f_ = __builtin_convertvector(n_, v8sf) * (1.0f / (255 * 255));     \
+    v8si q_ = __builtin_convertvector(f_, v8si);                            \
+    v8si r_ = n_ - q_ * (255 * 255);                                        \
+    (out) = (v8su)(q_ - (r_ >= 255 * 255) + (r_ < 0));                      \
+} while (0)
+
+#define DEFINE_BLEND_LINES(suffix, attr)                                    \
+attr static void blend_line_f32_##suffix(void *dst, void *src, void *src_a, \
+                                         int w)                             \
+{                                                                           \
+    float *dst_f = dst;                                                     \
+    float *src_f = src;                                                     \
+    float *src_a_f = src_a;                                                 \
+    int x = 0;                                                              \
+    for (; x + 8 <= w; x += 8) {                                            \
+        v8sf *d = (v8sf *)(dst_f + x);                                      \
+        *d = *(v8sf *)(src_f + x) + *d * (1.0f - *(v8sf *)(src_a_f + x));   \
+    }                                                                       \
+    blend_line_f32(dst_f + x, src_f + x, src_a_f + x, w - x);               \
+}                                                                           \
+                                                                            \
+attr static void blend_line_u8_##suffix(void *dst, void *src, void *src_a,  \
+                                        int w)                              \
+{                                                                           \
+    uint8_t *dst_i = dst;                                                   \
+    uint8_t *src_i = src;                                                   \
+    uint8_t *src_a_i = src_a;                                               \
+    int x = 0;                                                              \
+    for (; x + 16 <= w; x += 16) {                                          \
+        v16hu d = __builtin_convertvector(*(v16qu *)(dst_i + x), v16hu);    \
+        v16hu s = __builtin_convertvector(*(v16qu *)(src_i + x), v16hu);    \
+        v16hu a = __builtin_convertvector(*(v16qu *)(src_a_i + x), v16hu);  \
+        d = s + DIV255(d * (255 - a));                                      \
+        *(v16qu *)(dst_i + x) = __builtin_convertvector(d, v16qu);          \
+    }                                                                       \
+    blend_line_u8(dst_i + x, src_i + x, src_a_i + x, w - x);                \
+}
+
+#define DEFINE_DRAW_RGBA(suffix, attr)                                      \
+attr static void draw_ass_rgba_##suffix(uint8_t *dst, ptrdiff_t dst_stride, \
+                                        uint8_t *src, ptrdiff_t src_stride, \
+                                        int w, int h, uint32_t color)       \
+{                                                                           \
+    const uint32_t r = (color >> 24) & 0xff;                                \
+    const uint32_t g = (color >> 16) & 0xff;                                \
+    const uint32_t b = (color >>  8) & 0xff;                                \
+    const uint32_t a = 0xff - (color & 0xff);                               \
+    int wv = w & ~7;                                                        \
+                                                                            \
+    for (int y = 0; y < h; y++) {                                           \
+        for (int x = 0; x < wv; x += 8) {                                   \
+            v8su v = __builtin_convertvector(*(v8qu *)(src + x), v8su);     \
+            v8su *dstrow = (v8su *)(dst + x * 4);                           \
+            v8su aa = a * v;                                                \
+            v8su dstpix = *dstrow;                                          \
+            v8su dstb =  dstpix        & 0xFF;                              \
+            v8su dstg = (dstpix >>  8) & 0xFF;                              \
+            v8su dstr = (dstpix >> 16) & 0xFF;                              \
+            v8su dsta = (dstpix >> 24) & 0xFF;                              \
+            DIV65025(dstb, v * b * a + dstb * (255 * 255 - aa));            \
+            DIV65025(dstg, v * g * a + dstg * (255 * 255 - aa));            \
+            DIV65025(dstr, v * r * a + dstr * (255 * 255 - aa));            \
+            DIV65025(dsta, aa * 255  + dsta * (255 * 255 - aa));            \
+            *dstrow = dstb | (dstg << 8) | (dstr << 16) | (dsta << 24);     \
+        }                                                                   \
+        if (wv < w) {                                                       \
+            draw_ass_rgba(dst + wv * 4, dst_stride, src + wv, src_stride,   \
+                          w - wv, 1, color);                                \
+        }                                                                   \
+        dst += dst_stride;                                                  \
+        src += src_stride;                                                  \
+    }                                                                       \
+}                                                                           \
+                                                                            \
+attr static void draw_rgba_##suffix(uint8_t *dst, ptrdiff_t dst_stride,     \
+                                    uint8_t *src, ptrdiff_t src_stride,     \
+                                    int w, int h)                           \
+{                                                                           \
+    int wv = w & ~7;                                                        \
+                                                                            \
+    for (int y = 0; y < h; y++) {                                           \
+        for (int x = 0; x < wv; x += 8) {                                   \
+            v8su srcpix = *(v8su *)(src + x * 4);                           \
+            v8su *dstrow = (v8su *)(dst + x * 4);                           \
+            v8su dstpix = *dstrow;                                          \
+            v8su srcb =  srcpix        & 0xFF;                              \
+            v8su srcg = (srcpix >>  8) & 0xFF;                              \
+            v8su srcr = (srcpix >> 16) & 0xFF;                              \
+            v8su srca = (srcpix >> 24) & 0xFF;                              \
+            v8su dstb =  dstpix        & 0xFF;                              \
+            v8su dstg = (dstpix >>  8) & 0xFF;                              \
+            v8su dstr = (dstpix >> 16) & 0xFF;                              \
+            v8su dsta = (dstpix >> 24) & 0xFF;                              \
+            DIV65025(dstb, dstb * (255 * 255 - srca));                      \
+            DIV65025(dstg, dstg * (255 * 255 - srca));                      \
+            DIV65025(dstr, dstr * (255 * 255 - srca));                      \
+            DIV65025(dsta, dsta * (255 * 255 - srca));                      \
+            dstb += srcb;                                                   \
+            dstg += srcg;                                                   \
+            dstr += srcr;                                                   \
+            dsta += srca;                                                   \
+            *dstrow = dstb | (dstg << 8) | (dstr << 16) | (dsta << 24);     \
+        }                                                                   \
+        if (wv < w)                                                         \
+            draw_rgba(dst + wv * 4, dst_stride, src + wv * 4, src_stride,   \
+                      w - wv, 1);                                           \
+        dst += dst_stride;                                                  \
+        src += src_stride;                                                  \
+    }                                                                       \
+}
+
+#define HAVE_KERNELS_VECTOR 1
+DEFINE_BLEND_LINES(vector, )
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// SSE2 has no 32 bit multiply, so the C code is faster for the RGBA drawing.
+static const struct mp_draw_sub_kernels kernels_vector = {
+    .name = "sse2",
+    .blend_line_f32 = blend_line_f32_vector,
+    .blend_line_u8 = blend_line_u8_vector,
+    .draw_ass_rgba = draw_ass_rgba,
+    .draw_rgba = draw_rgba,
+};
+
+#define HAVE_KERNELS_AVX2 1
+DEFINE_BLEND_LINES(avx2, __attribute__((target("avx2"))))
+DEFINE_DRAW_RGBA(avx2, __attribute__((target("avx2"))))
+
+static const struct mp_draw_sub_kernels kernels_avx2 = {
+    .name = "avx2",
+    .blend_line_f32 = blend_line_f32_avx2,
+    .blend_line_u8 = blend_line_u8_avx2,
+    .draw_ass_rgba = draw_ass_rgba_avx2,
+    .draw_rgba = draw_rgba_avx2,
+};
+
+#else
+
+DEFINE_DRAW_RGBA(vector, )
+
+static const struct mp_draw_sub_kernels kernels_vector = {
+    .name = "vector",
+    .blend_line_f32 = blend_line_f32_vector,
+    .blend_line_u8 = blend_line_u8_vector,
+    .draw_ass_rgba = draw_ass_rgba_vector,
+    .draw_rgba = draw_rgba_vector,
+};
+
+#define HAVE_KERNELS_AVX2 0
+
+#endif
+
+#else
+
+#define HAVE_KERNELS_VECTOR 0
+#define HAVE_KERNELS_AVX2 0
+
+#endif
+
+const struct mp_draw_sub_kernels *mp_draw_sub_get_kernels(bool simd)
+{
+    if (!simd)
+        return &kernels_c;
+#if HAVE_KERNELS_AVX2
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2)
+        return &kernels_avx2;
+#endif
+#if HAVE_KERNELS_VECTOR
+    return &kernels_vector;
+#else
+    return &kernels_c;
+#endif
+}
+
 static bool render_rgba(struct mp_draw_sub_cache *p, struct part *part,
                         struct sub_bitmaps *sb)
 {
@@ -445,8 +763,9 @@ static bool render_rgba(struct mp_draw_sub_cache *p, struct part *part,
             s_ptr = scaled->planes[0];
         }
 
-        draw_rgba(mp_image_pixel_ptr(p->rgba_overlay, 0, x0, y0),
-                  p->rgba_overlay->stride[0], s_ptr, s_stride, dw, dh);
+        p->kernels->draw_rgba(mp_image_pixel_ptr(p->rgba_overlay, 0, x0, y0),
+                              p->rgba_overlay->stride[0], s_ptr, s_stride,
+                              dw, dh);
 
         mark_rect(p, x0, y0, x1, y1);
     }
@@ -490,6 +809,8 @@ static void clear_rgba_overlay(struct mp_draw_sub_cache *p)
     }
 
     p->any_osd = false;
+    p->dirty_y0 = INT_MAX;
+    p->dirty_y1 = 0;
 }
 
 static struct mp_sws_context *alloc_scaler(struct mp_draw_sub_cache *p)
@@ -511,6 +832,104 @@ static void init_general(struct mp_draw_sub_cache *p)
     clear_rgba_overlay(p);
 }
 
+// Create the repackers and temporary images for an additional band. This
+// mirrors what reinit_to_video() sets up for the first band.
+static bool init_band(struct mp_draw_sub_cache *p, struct band *b)
+{
+    struct mp_image *overlay = p->video_overlay ? p->video_overlay
+                                                : p->rgba_overlay;
+
+    if (p->scale_in_tiles && p->rgba_to_overlay) {
+        b->rgba_to_overlay = alloc_scaler(p);
+        b->rgba_to_overlay->allow_zimg = true;
+        if (p->alpha_to_calpha)
+            b->alpha_to_calpha = alloc_scaler(p);
+    }
+
+    b->video_to_f32 = mp_repack_create_planar(p->params.imgfmt, false, p->rflags);
+    talloc_steal(b, b->video_to_f32);
+    b->video_from_f32 = mp_repack_create_planar(p->params.imgfmt, true, p->rflags);
+    talloc_steal(b, b->video_from_f32);
+    b->overlay_to_f32 = mp_repack_create_planar(
+        mp_repack_get_format_src(p->overlay_to_f32), false, p->rflags);
+    talloc_steal(b, b->overlay_to_f32);
+    if (!b->video_to_f32 || !b->video_from_f32 || !b->overlay_to_f32)
+        return false;
+
+    b->overlay_tmp = talloc_steal(b, mp_image_alloc(p->overlay_tmp->imgfmt,
+                                                    SLICE_W, p->align_y));
+    b->video_tmp = talloc_steal(b, mp_image_alloc(p->video_tmp->imgfmt,
+                                                  SLICE_W, p->align_y));
+    if (!b->overlay_tmp || !b->video_tmp)
+        return false;
+
+    b->overlay_tmp->params.color = p->overlay_tmp->params.color;
+    b->video_tmp->params.color = p->video_tmp->params.color;
+
+    if (!repack_config_buffers(b->overlay_to_f32, 0, b->overlay_tmp,
+                               0, overlay, NULL))
+        return false;
+
+    if (p->calpha_to_f32) {
+        b->calpha_to_f32 = mp_repack_create_planar(
+            mp_repack_get_format_src(p->calpha_to_f32), false, p->rflags);
+        talloc_steal(b, b->calpha_to_f32);
+        if (!b->calpha_to_f32)
+            return false;
+
+        b->calpha_tmp = talloc_steal(b, mp_image_alloc(p->calpha_tmp->imgfmt,
+                                                       SLICE_W, 1));
+        if (!b->calpha_tmp)
+            return false;
+
+        if (!repack_config_buffers(b->calpha_to_f32, 0, b->calpha_tmp,
+                                   0, p->calpha_overlay, NULL))
+            return false;
+    }
+
+    return true;
+}
+
+static bool init_bands(struct mp_draw_sub_cache *p)
+{
+    struct band *b0 = talloc_zero(p, struct band);
+    *b0 = (struct band){
+        .p = p,
+        .rgba_to_overlay = p->rgba_to_overlay,
+        .alpha_to_calpha = p->alpha_to_calpha,
+        .overlay_to_f32 = p->overlay_to_f32,
+        .overlay_tmp = p->overlay_tmp,
+        .calpha_to_f32 = p->calpha_to_f32,
+        .calpha_tmp = p->calpha_tmp,
+        .video_to_f32 = p->video_to_f32,
+        .video_from_f32 = p->video_from_f32,
+        .video_tmp = p->video_tmp,
+    };
+    MP_TARRAY_APPEND(p, p->bands, p->num_bands, b0);
+
+    // No point in more bands than there are MIN_BAND_H line ranges.
+    int h = MP_ALIGN_UP(p->h, MIN_BAND_H);
+    int num = MPMIN(MPCLAMP(av_cpu_count(), 1, MAX_BANDS), h / MIN_BAND_H);
+    if (num < 2)
+        return true;
+
+    // Failing to create threads is not fatal; just run everything on the
+    // calling thread.
+    p->tp = mp_thread_pool_create(p, num - 1, num - 1, num - 1);
+    if (!p->tp)
+        return true;
+
+    for (int n = 1; n < num; n++) {
+        struct band *b = talloc_zero(p, struct band);
+        b->p = p;
+        if (!init_band(p, b))
+            return false;
+        MP_TARRAY_APPEND(p, p->bands, p->num_bands, b);
+    }
+
+    return true;
+}
+
 static bool reinit_to_video(struct mp_draw_sub_cache *p)
 {
     struct mp_image_params *params = &p->params;
@@ -542,7 +961,7 @@ static bool reinit_to_video(struct mp_draw_sub_cache *p)
 
         if (vfdesc.component_type == MP_COMPONENT_TYPE_UINT &&
             vfdesc.component_size == 1 && vfdesc.component_pad == 0)
-            p->blend_line = blend_line_u8;
+            p->blend_line = p->kernels->blend_line_u8;
     }
 
     // If no special blender is available, blend in float.
@@ -559,9 +978,10 @@ static bool reinit_to_video(struct mp_draw_sub_cache *p)
         mp_get_regular_imgfmt(&vfdesc, mp_repack_get_format_dst(p->video_to_f32));
         assert(vfdesc.component_type == MP_COMPONENT_TYPE_FLOAT);
 
-        p->blend_line = blend_line_f32;
+        p->blend_line = p->kernels->blend_line_f32;
     }
 
+    p->rflags = rflags;
     p->scale_in_tiles = SCALE_IN_TILES;
 
     int vid_f32_fmt = mp_repack_get_format_dst(p->video_to_f32);
@@ -745,6 +1165,9 @@ static bool reinit_to_video(struct mp_draw_sub_cache *p)
         }
     }
 
+    if (!init_bands(p))
+        return false;
+
     if (need_premul) {
         p->premul = alloc_scaler(p);
         p->unpremul = alloc_scaler(p);
@@ -803,10 +1226,13 @@ static bool check_reinit(struct mp_draw_sub_cache *p,
 {
     if (!mp_image_params_equal(&p->params, params) || !p->rgba_overlay) {
         talloc_free_children(p);
-        *p = (struct mp_draw_sub_cache){.global = p->global, .params = *params};
+        *p = (struct mp_draw_sub_cache){.global = p->global,
+                                        .kernels = p->kernels,
+                                        .params = *params};
         if (!(to_video ? reinit_to_video(p) : reinit_to_overlay(p))) {
             talloc_free_children(p);
-            *p = (struct mp_draw_sub_cache){.global = p->global};
+            *p = (struct mp_draw_sub_cache){.global = p->global,
+                                            .kernels = p->kernels};
             return false;
         }
     }
@@ -832,6 +1258,7 @@ struct mp_draw_sub_cache *mp_draw_sub_alloc(void *ta_parent, struct mpv_global *
 {
     struct mp_draw_sub_cache *c = talloc_zero(ta_parent, struct mp_draw_sub_cache);
     c->global = g;
+    c->kernels = mp_draw_sub_get_kernels(true);
     return c;
 }
 
@@ -839,6 +1266,7 @@ bool mp_draw_sub_bitmaps(struct mp_draw_sub_cache *p, struct mp_image *dst,
                          struct sub_bitmap_list *sbs_list)
 {
     bool ok = false;
+    bool convert = false;
 
     // dst must at least be as large as the bounding box, or you may get memory
     // corruption.
@@ -860,6 +1288,9 @@ bool mp_draw_sub_bitmaps(struct mp_draw_sub_cache *p, struct mp_image *dst,
 
         if (!convert_to_video_overlay(p))
             goto done;
+
+        // Tiles are converted by the bands, right before blending.
+        convert = p->video_overlay && p->scale_in_tiles;
     }
 
     if (p->any_osd) {
@@ -870,7 +1301,7 @@ bool mp_draw_sub_bitmaps(struct mp_draw_sub_cache *p, struct mp_image *dst,
             target = p->premul_tmp;
         }
 
-        if (!blend_overlay_with_video(p, target))
+        if (!process_bands(p, target, convert))
             goto done;
 
         if (target != dst) {
@@ -1014,4 +1445,18 @@ struct mp_image *mp_draw_sub_overlay(struct mp_draw_sub_cache *p,
     return &p->res_overlay;
 }
 
+void mp_draw_sub_get_bounds(struct mp_draw_sub_cache *p, struct mp_rect *rc)
+{
+    *rc = (struct mp_rect){0};
+
+    if (!p->slices || !p->any_osd)
+        return;
+
+    struct rc_grid gr;
+    init_rc_grid(&gr, p, rc, 1);
+    mark_rcs(p, &gr);
+    if (!return_rcs(&gr))
+        *rc = (struct mp_rect){0};
+}
+
 // vim: ts=4 sw=4 et tw=80
@@ -1,6 +1,9 @@
 #ifndef MPLAYER_DRAW_BMP_H
 #define MPLAYER_DRAW_BMP_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "osd.h"
 
 struct mp_rect;
@@ -22,6 +25,11 @@ struct mp_draw_sub_cache *mp_draw_sub_alloc(void *ta_parent, struct mpv_global *
 bool mp_draw_sub_bitmaps(struct mp_draw_sub_cache *cache, struct mp_image *dst,
                          struct sub_bitmap_list *sbs_list);
 
+// Set *rc to the bounding box of all pixels the last mp_draw_sub_bitmaps() call
+// on this cache touched (a 0-sized rect if none). The caller can use this to
+// restore or present only the region that was drawn to.
+void mp_draw_sub_get_bounds(struct mp_draw_sub_cache *cache, struct mp_rect *rc);
+
 char *mp_draw_sub_get_dbg_info(struct mp_draw_sub_cache *c);
 
 // Return a RGBA overlay with subtitles. The returned image uses IMGFMT_BGRA and
@@ -55,6 +63,25 @@ struct mp_image *mp_draw_sub_overlay(struct mp_draw_sub_cache *cache,
 
 extern const bool mp_draw_sub_formats[SUBBITMAP_COUNT];
 
+// The per-pixel blending functions. Exposed for tests only.
+struct mp_draw_sub_kernels {
+    const char *name;
+    // dst = src + dst * (1 - src_a), for one plane (premultiplied alpha)
+    void (*blend_line_f32)(void *dst, void *src, void *src_a, int w);
+    void (*blend_line_u8)(void *dst, void *src, void *src_a, int w);
+    // Draw a libass mask with the given RGBA color onto BGRA.
+    void (*draw_ass_rgba)(uint8_t *dst, ptrdiff_t dst_stride,
+                          uint8_t *src, ptrdiff_t src_stride,
+                          int w, int h, uint32_t color);
+    // Draw premultiplied BGRA onto BGRA.
+    void (*draw_rgba)(uint8_t *dst, ptrdiff_t dst_stride,
+                      uint8_t *src, ptrdiff_t src_stride, int w, int h);
+};
+
+// simd=false returns the plain C versions. All versions produce bit-identical
+// output.
+const struct mp_draw_sub_kernels *mp_draw_sub_get_kernels(bool simd);
+
 #endif /* MPLAYER_DRAW_BMP_H */
 
 // vim: ts=4 sw=4 et tw=80
@@ -59,6 +59,7 @@ struct priv {
     js_State *J;
     int num_regexes;
     int offset;
+    bool has_combined;          // global[num_regexes] has all as alternation
 };
 
 static void destruct_priv(void *p)
@@ -87,6 +88,10 @@ static bool jsre_init(struct sd_filter *ft)
     }
     talloc_set_destructor(p, destruct_priv);
 
+    // Most packets match none of the regexes, so test them all at once first.
+    char *combined = talloc_strdup(p, "");
+    bool combine = true;
+
     for (int n = 0; ft->opts->jsre_items[n]; n++) {
         char *item = ft->opts->jsre_items[n];
 
@@ -98,11 +103,23 @@ static bool jsre_init(struct sd_filter *ft)
         }
 
         p->num_regexes += 1;
+
+        combine &= sd_re_can_group(item);
+        combined = talloc_asprintf_append(combined, "%s(?:%s)",
+                                          p->num_regexes > 1 ? "|" : "", item);
     }
 
     if (!p->num_regexes)
         return false;
 
+    if (combine && p->num_regexes > 1) {
+        p->has_combined = !p_regcomp(p->J, p->num_regexes, combined,
+                                     JS_REGEXP_I | JS_REGEXP_M);
+        if (!p->has_combined)
+            js_pop(p->J, 1);
+    }
+    talloc_free(combined);
+
     p->offset = sd_ass_fmt_offset(ft->event_format);
     return true;
 }
@@ -117,6 +134,15 @@ static struct demux_packet *jsre_filter(struct sd_filter *ft,
     if (ft->opts->rf_plain)
         sd_ass_to_plaintext(text, strlen(text), text);
 
+    // On a match, find the regex that matched with the loop below.
+    if (p->has_combined) {
+        int found, err = p_regexec(p->J, p->num_regexes, text, &found);
+        if (err)
+            js_pop(p->J, 1);
+        if (!err && !found)
+            goto done;
+    }
+
     for (int n = 0; n < p->num_regexes; n++) {
         int found, err = p_regexec(p->J, n, text, &found);
         if (err == 0 && found) {
@@ -130,6 +156,7 @@ static struct demux_packet *jsre_filter(struct sd_filter *ft,
         }
     }
 
+done:
     talloc_free(text);
     return drop ? NULL : pkt;
 }
@@ -137,4 +164,5 @@ static struct demux_packet *jsre_filter(struct sd_filter *ft,
 const struct sd_filter_functions sd_filter_jsre = {
     .init   = jsre_init,
     .filter = jsre_filter,
+    .cache_by_pos = true,
 };
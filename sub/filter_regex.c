@@ -11,6 +11,8 @@ struct priv {
     int offset;
     regex_t *regexes;
     int num_regexes;
+    regex_t combined;           // all regexes as one alternation
+    bool has_combined;
 };
 
 static bool rf_init(struct sd_filter *ft)
@@ -24,6 +26,10 @@ static bool rf_init(struct sd_filter *ft)
     struct priv *p = talloc_zero(ft, struct priv);
     ft->priv = p;
 
+    // Most packets match none of the regexes, so test them all at once first.
+    char *combined = talloc_strdup(p, "");
+    bool combine = true;
+
     for (int n = 0; ft->opts->rf_items && ft->opts->rf_items[n]; n++) {
         char *item = ft->opts->rf_items[n];
 
@@ -39,11 +45,21 @@ static bool rf_init(struct sd_filter *ft)
         }
 
         p->num_regexes += 1;
+
+        combine &= sd_re_can_group(item);
+        combined = talloc_asprintf_append(combined, "%s(%s)",
+                                          p->num_regexes > 1 ? "|" : "", item);
     }
 
     if (!p->num_regexes)
         return false;
 
+    if (combine && p->num_regexes > 1) {
+        p->has_combined = !regcomp(&p->combined, combined,
+                    REG_ICASE | REG_EXTENDED | REG_NOSUB | REG_NEWLINE);
+    }
+    talloc_free(combined);
+
     p->offset = sd_ass_fmt_offset(ft->event_format);
     return true;
 }
@@ -54,6 +70,8 @@ static void rf_uninit(struct sd_filter *ft)
 
     for (int n = 0; n < p->num_regexes; n++)
         regfree(&p->regexes[n]);
+    if (p->has_combined)
+        regfree(&p->combined);
 }
 
 static struct demux_packet *rf_filter(struct sd_filter *ft,
@@ -66,6 +84,11 @@ static struct demux_packet *rf_filter(struct sd_filter *ft,
     if (ft->opts->rf_plain)
         sd_ass_to_plaintext(text, strlen(text), text);
 
+    // On a match, find the regex that matched with the loop below.
+    if (p->has_combined &&
+        regexec(&p->combined, text, 0, NULL, 0) == REG_NOMATCH)
+        goto done;
+
     for (int n = 0; n < p->num_regexes; n++) {
         int err = regexec(&p->regexes[n], text, 0, NULL, 0);
         if (err == 0) {
@@ -78,6 +101,7 @@ static struct demux_packet *rf_filter(struct sd_filter *ft,
         }
     }
 
+done:
     talloc_free(text);
     return drop ? NULL : pkt;
 }
@@ -86,4 +110,5 @@ const struct sd_filter_functions sd_filter_regex = {
     .init   = rf_init,
     .uninit = rf_uninit,
     .filter = rf_filter,
+    .cache_by_pos = true,
 };
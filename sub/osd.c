@@ -218,10 +218,33 @@ double osd_get_force_video_pts(struct osd_state *osd)
     return atomic_load(&osd->force_video_pts);
 }
 
+// Called when a video frame is queued to the VO, so that subtitles can be
+// rendered ahead for it (--sub-render-ahead). Doesn't block on rendering.
+void osd_set_next_video_pts(struct osd_state *osd, double video_pts)
+{
+    double force_video_pts = atomic_load(&osd->force_video_pts);
+    if (force_video_pts != MP_NOPTS_VALUE)
+        video_pts = force_video_pts;
+
+    pthread_mutex_lock(&osd->lock);
+    for (int n = 0; n < 2 && !osd->render_subs_in_filter; n++) {
+        struct osd_object *obj = osd->objs[OSDTYPE_SUB + n];
+        if (obj->sub)
+            sub_set_next_video_pts(obj->sub, video_pts);
+    }
+    pthread_mutex_unlock(&osd->lock);
+}
+
 void osd_set_progbar(struct osd_state *osd, struct osd_progbar_state *s)
 {
     pthread_mutex_lock(&osd->lock);
     struct osd_object *osd_obj = osd->objs[OSDTYPE_OSD];
+    struct osd_progbar_state *cur = &osd_obj->progbar_state;
+    if (cur->type == s->type && cur->value == s->value &&
+        cur->num_stops == s->num_stops &&
+        (!s->num_stops ||
+         memcmp(cur->stops, s->stops, sizeof(s->stops[0]) * s->num_stops) == 0))
+        goto done;
     osd_obj->progbar_state.type = s->type;
     osd_obj->progbar_state.value = s->value;
     osd_obj->progbar_state.num_stops = s->num_stops;
@@ -232,6 +255,7 @@ void osd_set_progbar(struct osd_state *osd, struct osd_progbar_state *s)
     }
     osd_obj->osd_changed = true;
     osd->want_redraw_notification = true;
+done:
     pthread_mutex_unlock(&osd->lock);
 }
 
@@ -405,19 +429,14 @@ void osd_draw(struct osd_state *osd, struct mp_osd_res res,
 
 // Calls mp_image_make_writeable() on the dest image if something is drawn.
 // draw_flags as in osd_render().
-void osd_draw_on_image(struct osd_state *osd, struct mp_osd_res res,
-                       double video_pts, int draw_flags, struct mp_image *dest)
+static void draw_on_image(struct osd_state *osd, struct mp_osd_res res,
+                          double video_pts, int draw_flags,
+                          struct mp_image_pool *pool, struct mp_image *dest,
+                          struct mp_rect *rc)
 {
-    osd_draw_on_image_p(osd, res, video_pts, draw_flags, NULL, dest);
-}
+    if (rc)
+        *rc = (struct mp_rect){0};
 
-// Like osd_draw_on_image(), but if dest needs to be copied to make it
-// writeable, allocate images from the given pool. (This is a minor
-// optimization to reduce "real" image sized memory allocations.)
-void osd_draw_on_image_p(struct osd_state *osd, struct mp_osd_res res,
-                         double video_pts, int draw_flags,
-                         struct mp_image_pool *pool, struct mp_image *dest)
-{
     struct sub_bitmap_list *list =
         osd_render(osd, res, video_pts, draw_flags, mp_draw_sub_formats);
 
@@ -437,10 +456,22 @@ void osd_draw_on_image_p(struct osd_state *osd, struct mp_osd_res res,
 
     stats_time_start(osd->stats, "draw-bmp");
 
-    if (!mp_draw_sub_bitmaps(osd->draw_cache, dest, list))
+    bool ok = mp_draw_sub_bitmaps(osd->draw_cache, dest, list);
+    if (!ok)
         MP_WARN(osd, "Failed rendering OSD.\n");
     talloc_steal(osd, osd->draw_cache);
 
+    if (rc) {
+        // On failure, dest could have been partially overwritten anywhere.
+        if (ok) {
+            mp_draw_sub_get_bounds(osd->draw_cache, rc);
+            rc->x1 = MPMIN(rc->x1, dest->w);
+            rc->y1 = MPMIN(rc->y1, dest->h);
+        } else {
+            *rc = (struct mp_rect){0, 0, dest->w, dest->h};
+        }
+    }
+
     stats_time_end(osd->stats, "draw-bmp");
 
     pthread_mutex_unlock(&osd->lock);
@@ -448,6 +479,32 @@ void osd_draw_on_image_p(struct osd_state *osd, struct mp_osd_res res,
     talloc_free(list);
 }
 
+void osd_draw_on_image(struct osd_state *osd, struct mp_osd_res res,
+                       double video_pts, int draw_flags, struct mp_image *dest)
+{
+    draw_on_image(osd, res, video_pts, draw_flags, NULL, dest, NULL);
+}
+
+// Like osd_draw_on_image(), but if dest needs to be copied to make it
+// writeable, allocate images from the given pool. (This is a minor
+// optimization to reduce "real" image sized memory allocations.)
+void osd_draw_on_image_p(struct osd_state *osd, struct mp_osd_res res,
+                         double video_pts, int draw_flags,
+                         struct mp_image_pool *pool, struct mp_image *dest)
+{
+    draw_on_image(osd, res, video_pts, draw_flags, pool, dest, NULL);
+}
+
+// Like osd_draw_on_image(), but set *rc to the bounding box of the pixels
+// that were changed in dest. If nothing was drawn, *rc is a 0-sized rect.
+// This lets a VO restore and present only the part covered by the OSD.
+void osd_draw_on_image_rc(struct osd_state *osd, struct mp_osd_res res,
+                          double video_pts, int draw_flags,
+                          struct mp_image *dest, struct mp_rect *rc)
+{
+    draw_on_image(osd, res, video_pts, draw_flags, NULL, dest, rc);
+}
+
 // Setup the OSD resolution to render into an image with the given parameters.
 // The interesting part about this is that OSD has to compensate the aspect
 // ratio if the image does not have a 1:1 pixel aspect ratio.
@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "common/common.h"
 #include "options/m_option.h"
 
 // NOTE: VOs must support at least SUBBITMAP_BGRA.
@@ -73,6 +74,14 @@ struct sub_bitmaps {
     // box. (The origin of the box is at (0,0).)
     int packed_w, packed_h;
 
+    // Optional support for incremental updates of packed. If packed_id is not
+    // 0, it uniquely identifies the current contents of packed. A VO that has
+    // uploaded the contents identified by packed_prev_id (if not 0) only needs
+    // to update the packed_dirty area (which may be empty). Otherwise, it has
+    // to upload the whole packed_w/packed_h area.
+    int64_t packed_id, packed_prev_id;
+    struct mp_rect packed_dirty;
+
     int change_id;  // Incremented on each change (0 is never used)
 };
 
@@ -180,6 +189,7 @@ bool osd_get_render_subs_in_filter(struct osd_state *osd);
 void osd_set_render_subs_in_filter(struct osd_state *osd, bool s);
 void osd_set_force_video_pts(struct osd_state *osd, double video_pts);
 double osd_get_force_video_pts(struct osd_state *osd);
+void osd_set_next_video_pts(struct osd_state *osd, double video_pts);
 
 struct osd_progbar_state {
     int type;           // <0: disabled, 1-255: symbol, else: no symbol
@@ -215,6 +225,10 @@ void osd_draw_on_image_p(struct osd_state *osd, struct mp_osd_res res,
                          double video_pts, int draw_flags,
                          struct mp_image_pool *pool, struct mp_image *dest);
 
+void osd_draw_on_image_rc(struct osd_state *osd, struct mp_osd_res res,
+                          double video_pts, int draw_flags,
+                          struct mp_image *dest, struct mp_rect *rc);
+
 void osd_resize(struct osd_state *osd, struct mp_osd_res res);
 
 struct mp_image_params;
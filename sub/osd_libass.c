@@ -68,6 +68,7 @@ static void create_ass_renderer(struct osd_state *osd, struct ass_state *ass)
 
 static void destroy_ass_renderer(struct ass_state *ass)
 {
+    ass->imgs_valid = false;
     if (ass->track)
         ass_free_track(ass->track);
     ass->track = NULL;
@@ -115,8 +116,10 @@ static void update_playres(struct ass_state *ass, struct mp_osd_res *vo_res)
 
     // Force libass to clear its internal cache - it doesn't check for
     // PlayRes changes itself.
-    if (old_res_x != track->PlayResX || old_res_y != track->PlayResY)
+    if (old_res_x != track->PlayResX || old_res_y != track->PlayResY) {
         ass_set_frame_size(ass->render, 1, 1);
+        ass->imgs_valid = false;
+    }
 }
 
 static void create_ass_track(struct osd_state *osd, struct osd_object *obj,
@@ -182,6 +185,7 @@ static ASS_Event *add_osd_ass_event(ASS_Track *track, const char *style,
 
 static void clear_ass(struct ass_state *ass)
 {
+    ass->imgs_valid = false;
     if (ass->track)
         ass_flush_events(ass->track);
 }
@@ -252,7 +256,10 @@ static ASS_Style *prepare_osd_ass(struct osd_state *osd, struct osd_object *obj)
         playresy *= 720.0 / obj->vo_res.h;
 
     ASS_Style *style = get_style(&obj->ass, "OSD");
+    ASS_Style old = *style;
     mp_ass_set_style(style, playresy, &font);
+    if (memcmp(&old, style, sizeof(old)) != 0)
+        obj->ass.imgs_valid = false;
     return style;
 }
 
@@ -497,6 +504,10 @@ static void update_osd(struct osd_state *osd, struct osd_object *obj)
     update_progbar(osd, obj);
 }
 
+// Each line of the overlay data is a separate ASS event. Events are retained
+// across updates, and only lines that differ from the previous data replace
+// their event, so e.g. an OSC update that changes only the time text does not
+// make libass re-parse all the shapes.
 static void update_external(struct osd_state *osd, struct osd_object *obj,
                             struct osd_external *ext)
 {
@@ -505,24 +516,48 @@ static void update_external(struct osd_state *osd, struct osd_object *obj,
     ext->ass.res_y = ext->ov.res_y;
     create_ass_track(osd, obj, &ext->ass);
 
-    clear_ass(&ext->ass);
+    ASS_Track *track = ext->ass.track;
+    ext->ass.imgs_valid = false;
 
-    int resy = ext->ass.track->PlayResY;
+    int resy = track->PlayResY;
     mp_ass_set_style(get_style(&ext->ass, "OSD"), resy, osd->opts->osd_style);
 
     // Some scripts will reference this style name with \r tags.
     const struct osd_style_opts *def = osd_style_conf.defaults;
     mp_ass_set_style(get_style(&ext->ass, "Default"), resy, def);
 
+    int num = 0;
     while (t.len) {
         bstr line;
         bstr_split_tok(t, "\n", &line, &t);
-        if (line.len) {
+        if (!line.len)
+            continue;
+        if (num < track->n_events) {
+            ASS_Event *event = &track->events[num];
+            if (!event->Text || !bstr_equals0(line, event->Text)) {
+                ass_free_event(track, num);
+                char *tmp = bstrdup0(NULL, line);
+                *event = (ASS_Event){
+                    .Start = 0,
+                    .Duration = 100,
+                    .Style = find_style(track, "OSD", 0),
+                    .ReadOrder = num,
+                    .Text = strdup(tmp),
+                };
+                talloc_free(tmp);
+            }
+        } else {
             char *tmp = bstrdup0(NULL, line);
-            add_osd_ass_event(ext->ass.track, "OSD", tmp);
+            add_osd_ass_event(track, "OSD", tmp);
             talloc_free(tmp);
         }
+        num++;
     }
+
+    // Drop events for lines that are gone.
+    for (int n = num; n < track->n_events; n++)
+        ass_free_event(track, n);
+    track->n_events = MPMIN(track->n_events, num);
 }
 
 static int cmp_zorder(const void *pa, const void *pb)
@@ -570,6 +605,14 @@ void osd_set_external(struct osd_state *osd, struct osd_external_ass *ov)
         goto done;
     }
 
+    // Scripts like the OSC often resend identical data.
+    bool same = entry->ov.format == ov->format && entry->ov.data &&
+                strcmp(entry->ov.data, ov->data) == 0 &&
+                entry->ov.res_x == ov->res_x && entry->ov.res_y == ov->res_y &&
+                entry->ov.z == ov->z && entry->ov.hidden == ov->hidden;
+    if (same)
+        goto get_rc;
+
     entry->ov.format = ov->format;
     if (!entry->ov.data)
         entry->ov.data = talloc_strdup(entry, "");
@@ -593,6 +636,7 @@ void osd_set_external(struct osd_state *osd, struct osd_external_ass *ov)
               cmp_zorder);
     }
 
+get_rc:
     if (ov->out_rc) {
         struct mp_osd_res vo_res = entry->ass.vo_res;
         // Defined fallback if VO has not drawn this yet
@@ -645,6 +689,16 @@ static void append_ass(struct ass_state *ass, struct mp_osd_res *res,
 
     update_playres(ass, res);
 
+    // The track is unchanged, so libass would return the same images.
+    if (ass->imgs_valid && osd_res_equals(*res, ass->imgs_res)) {
+        *img_list = ass->imgs;
+        if (changed) {
+            *changed |= ass->changed;
+            ass->changed = false;
+        }
+        return;
+    }
+
     ass_set_frame_size(ass->render, res->w, res->h);
     ass_set_pixel_aspect(ass->render, res->display_par);
 
@@ -652,6 +706,9 @@ static void append_ass(struct ass_state *ass, struct mp_osd_res *res,
     *img_list = ass_render_frame(ass->render, ass->track, 0, &ass_changed);
 
     ass->changed |= ass_changed;
+    ass->imgs = *img_list;
+    ass->imgs_res = *res;
+    ass->imgs_valid = true;
 
     if (changed) {
         *changed |= ass->changed;
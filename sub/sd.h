@@ -29,6 +29,8 @@ struct sd {
 struct sd_functions {
     const char *name;
     bool accept_packets_in_advance;
+    bool can_render_ahead;  // get_bitmaps() is expensive and tolerates being
+                            // called for future PTS (--sub-render-ahead)
     int  (*init)(struct sd *sd);
     void (*decode)(struct sd *sd, struct demux_packet *packet);
     void (*reset)(struct sd *sd);
@@ -83,6 +85,12 @@ struct sd_filter_functions {
     struct demux_packet *(*filter)(struct sd_filter *ft,
                                    struct demux_packet *pkt);
 
+    // If true, filter() only ever returns pkt or NULL, and the result depends
+    // on the packet data only. The caller can then remember the result by
+    // packet position, and skip filter() if the same packet is fed again
+    // (e.g. after seeking).
+    bool cache_by_pos;
+
     void (*uninit)(struct sd_filter *ft);
 };
 
@@ -106,4 +114,8 @@ bstr sd_ass_pkt_text(struct sd_filter *ft, struct demux_packet *pkt, int offset)
 // if there's room: out[result.len] is set to \0. out == in is allowed.
 bstr sd_ass_to_plaintext(char *out, size_t out_siz, const char *in);
 
+// whether the regex (posix extended or js) can be wrapped in a group without
+// changing its meaning, e.g. to combine several into one alternation.
+bool sd_re_can_group(const char *re);
+
 #endif
@@ -22,6 +22,7 @@
 #include <limits.h>
 
 #include <libavutil/common.h>
+#include <libavutil/intreadwrite.h>
 #include <ass/ass.h>
 
 #include "mpv_talloc.h"
@@ -38,6 +39,14 @@
 #include "ass_mp.h"
 #include "sd.h"
 
+// Hash table of entries identified by (non-negative) packet positions. The
+// position of an entry is entry >> shift; the lower bits can hold a value.
+struct pos_table {
+    int64_t *entries;           // -1 for unused entries
+    int size;                   // power of 2, or 0
+    int num;
+};
+
 struct sd_ass_priv {
     struct ass_library *ass_library;
     struct ass_renderer *ass_renderer;
@@ -54,9 +63,39 @@ struct sd_ass_priv {
     char last_text[500];
     struct mp_image_params video_params;
     struct mp_image_params last_params;
-    int64_t *seen_packets;
-    int num_seen_packets;
+    struct mp_csp_matrix_cache vs_matrix, rgb_matrix;
+    struct pos_table seen_packets;
+    struct pos_table *filter_cache; // per ctx->filters entry
     bool duration_unknown;
+    // Index of ass_track->events for lookups by timestamp.
+    struct event_ref *ev_sorted; // short events, sorted by start time
+    int num_ev_sorted;
+    struct event_ref *ev_long;  // events longer than LONG_EVENT_DURATION
+    int num_ev_long;
+    int ev_indexed;             // ass_track->events[0..ev_indexed-1] indexed
+    long long ev_max_duration;  // max. duration of ev_sorted events
+    int *ev_found;              // result of find_events()
+    int num_ev_found;
+    // Events and text type last_text was generated from.
+    int *text_ev;
+    int num_text_ev;
+    enum sd_text_type text_type;
+    bool text_valid;
+    // Embedded fonts not yet added to libass (--embeddedfonts-lazy).
+    void *lazy_fonts_ta;
+    struct embedded_font *lazy_fonts;
+    int num_lazy_fonts;
+};
+
+struct embedded_font {
+    struct demux_attachment *attachment;
+    bstr *names;                // family, full and PostScript names
+    int num_names;
+};
+
+struct event_ref {
+    long long start;
+    int index;                  // into ass_track->events
 };
 
 static void mangle_colors(struct sd *sd, struct sub_bitmaps *parts);
@@ -135,19 +174,182 @@ static bool attachment_is_font(struct mp_log *log, struct demux_attachment *f)
     return false;
 }
 
+static void add_name(void *ta_parent, struct embedded_font *font, bstr name)
+{
+    name = bstr_strip(name);
+    if (!name.len)
+        return;
+    for (int n = 0; n < font->num_names; n++) {
+        if (bstrcasecmp(font->names[n], name) == 0)
+            return;
+    }
+    MP_TARRAY_APPEND(ta_parent, font->names, font->num_names, name);
+}
+
+// Read the names libass/fontconfig can match the font by from a sfnt "name"
+// table.
+static void read_name_table(void *ta_parent, struct embedded_font *font,
+                            const uint8_t *d, size_t size)
+{
+    if (size < 6)
+        return;
+    int count = AV_RB16(d + 2);
+    size_t str_offset = AV_RB16(d + 4);
+    if (6 + count * 12 > size)
+        return;
+
+    for (int n = 0; n < count; n++) {
+        const uint8_t *r = d + 6 + n * 12;
+        int platform = AV_RB16(r);
+        int encoding = AV_RB16(r + 2);
+        int name_id = AV_RB16(r + 6);
+        size_t len = AV_RB16(r + 8);
+        size_t offset = str_offset + AV_RB16(r + 10);
+        if (name_id != 1 && name_id != 4 && name_id != 6)
+            continue;
+        if (offset > size || len > size - offset)
+            continue;
+        const uint8_t *str = d + offset;
+
+        bstr name = {0};
+        if (platform == 0 || platform == 3) {
+            // UTF-16BE
+            for (size_t i = 0; i + 1 < len; i += 2) {
+                uint32_t c = AV_RB16(str + i);
+                if (c >= 0xD800 && c < 0xDC00 && i + 3 < len) {
+                    uint32_t lo = AV_RB16(str + i + 2);
+                    if (lo >= 0xDC00 && lo < 0xE000) {
+                        c = 0x10000 + ((c - 0xD800) << 10) + (lo - 0xDC00);
+                        i += 2;
+                    }
+                }
+                mp_append_utf8_bstr(ta_parent, &name, c);
+            }
+        } else if (platform == 1 && encoding == 0) {
+            // Mac Roman; only use it if it's ASCII.
+            bool ascii = true;
+            for (size_t i = 0; i < len; i++)
+                ascii &= str[i] < 0x80;
+            if (ascii)
+                name = bstrdup(ta_parent, (bstr){(char *)str, len});
+        }
+        add_name(ta_parent, font, name);
+    }
+}
+
+static void read_sfnt_face(void *ta_parent, struct embedded_font *font,
+                           const uint8_t *d, size_t size, size_t offset)
+{
+    if (offset > size || size - offset < 12)
+        return;
+    int num_tables = AV_RB16(d + offset + 4);
+    if (size - offset - 12 < num_tables * 16)
+        return;
+
+    for (int n = 0; n < num_tables; n++) {
+        const uint8_t *rec = d + offset + 12 + n * 16;
+        if (AV_RB32(rec) != MKBETAG('n', 'a', 'm', 'e'))
+            continue;
+        size_t t_offset = AV_RB32(rec + 8);
+        size_t t_size = AV_RB32(rec + 12);
+        if (t_offset <= size && t_size <= size - t_offset)
+            read_name_table(ta_parent, font, d + t_offset, t_size);
+        return;
+    }
+}
+
+// Read the font names from a TrueType/OpenType font or font collection. Leaves
+// the name list empty if the font is not understood.
+static void read_font_names(void *ta_parent, struct embedded_font *font)
+{
+    const uint8_t *d = font->attachment->data;
+    size_t size = font->attachment->data_size;
+
+    if (size >= 12 && AV_RB32(d) == MKBETAG('t', 't', 'c', 'f')) {
+        uint32_t num_fonts = AV_RB32(d + 8);
+        if (num_fonts > (size - 12) / 4)
+            return;
+        for (uint32_t n = 0; n < num_fonts; n++)
+            read_sfnt_face(ta_parent, font, d, size, AV_RB32(d + 12 + n * 4));
+    } else {
+        read_sfnt_face(ta_parent, font, d, size, 0);
+    }
+}
+
 static void add_subtitle_fonts(struct sd *sd)
 {
     struct sd_ass_priv *ctx = sd->priv;
     struct mp_subtitle_opts *opts = sd->opts;
+    TA_FREEP(&ctx->lazy_fonts_ta);
+    ctx->lazy_fonts = NULL;
+    ctx->num_lazy_fonts = 0;
     if (!opts->ass_enabled || !opts->use_embedded_fonts || !sd->attachments)
         return;
+    ctx->lazy_fonts_ta = talloc_new(ctx);
     for (int i = 0; i < sd->attachments->num_entries; i++) {
         struct demux_attachment *f = &sd->attachments->entries[i];
-        if (attachment_is_font(sd->log, f))
-            ass_add_font(ctx->ass_library, f->name, f->data, f->data_size);
+        if (!attachment_is_font(sd->log, f))
+            continue;
+        if (opts->embedded_fonts_lazy) {
+            struct embedded_font font = {.attachment = f};
+            read_font_names(ctx->lazy_fonts_ta, &font);
+            // Can't know when it's needed if there are no names.
+            if (font.num_names) {
+                MP_TARRAY_APPEND(ctx->lazy_fonts_ta, ctx->lazy_fonts,
+                                 ctx->num_lazy_fonts, font);
+                continue;
+            }
+        }
+        ass_add_font(ctx->ass_library, f->name, f->data, f->data_size);
+    }
+}
+
+// Add the lazily loaded embedded fonts with the given name.
+static void load_fonts_by_name(struct sd *sd, bstr name)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+
+    name = bstr_strip(name);
+    bstr_eatstart0(&name, "@"); // vertical variant of the font
+    if (!name.len)
+        return;
+
+    for (int n = ctx->num_lazy_fonts - 1; n >= 0; n--) {
+        struct embedded_font *font = &ctx->lazy_fonts[n];
+        for (int i = 0; i < font->num_names; i++) {
+            if (bstrcasecmp(font->names[i], name) == 0) {
+                struct demux_attachment *f = font->attachment;
+                MP_VERBOSE(sd, "Loading embedded font '%s'.\n", f->name);
+                ass_add_font(ctx->ass_library, f->name, f->data, f->data_size);
+                MP_TARRAY_REMOVE_AT(ctx->lazy_fonts, ctx->num_lazy_fonts, n);
+                break;
+            }
+        }
+    }
+}
+
+// Add the lazily loaded embedded fonts referenced by \fn tags in the text.
+static void load_fonts_for_text(struct sd *sd, bstr text)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+
+    while (ctx->num_lazy_fonts) {
+        int pos = bstr_find0(text, "\\fn");
+        if (pos < 0)
+            break;
+        text = bstr_cut(text, pos + 3);
+        load_fonts_by_name(sd, bstr_splice(text, 0, bstrcspn(text, "\\}")));
     }
 }
 
+static void load_fonts_for_track(struct sd *sd, ASS_Track *track)
+{
+    for (int n = 0; n < track->n_styles; n++)
+        load_fonts_by_name(sd, bstr0(track->styles[n].FontName));
+    for (int n = 0; n < track->n_events; n++)
+        load_fonts_for_text(sd, bstr0(track->events[n].Text));
+}
+
 static void filters_destroy(struct sd *sd)
 {
     struct sd_ass_priv *ctx = sd->priv;
@@ -159,6 +361,7 @@ static void filters_destroy(struct sd *sd)
         talloc_free(ft);
     }
     ctx->num_filters = 0;
+    TA_FREEP(&ctx->filter_cache);
 }
 
 static void filters_init(struct sd *sd)
@@ -183,6 +386,8 @@ static void filters_init(struct sd *sd)
             talloc_free(ft);
         }
     }
+
+    ctx->filter_cache = talloc_zero_array(ctx, struct pos_table, ctx->num_filters);
 }
 
 static void enable_output(struct sd *sd, bool enable)
@@ -233,6 +438,9 @@ static void assobjects_init(struct sd *sd)
 
     mp_ass_add_default_styles(ctx->ass_track, opts);
 
+    load_fonts_for_track(sd, ctx->ass_track);
+    load_fonts_for_track(sd, ctx->shadow_track);
+
 #if LIBASS_VERSION >= 0x01302000
     ass_set_check_readorder(ctx->ass_track, sd->opts->sub_clear_on_seek ? 0 : 1);
 #endif
@@ -287,7 +495,23 @@ static void filter_and_add(struct sd *sd, struct demux_packet *pkt)
 
     for (int n = 0; n < ctx->num_filters; n++) {
         struct sd_filter *ft = ctx->filters[n];
+        struct pos_table *cache = &ctx->filter_cache[n];
+        int64_t *cached = NULL;
+        if (ft->driver->cache_by_pos && pkt->pos >= 0) {
+            // The entry's lowest bit is set if the packet was dropped.
+            cached = pos_table_get(ctx->filter_cache, cache, pkt->pos, 1);
+            if (*cached >= 0) {
+                if (*cached & 1)
+                    goto drop;
+                continue;
+            }
+        }
         struct demux_packet *npkt = ft->driver->filter(ft, pkt);
+        if (cached) {
+            assert(npkt == pkt || !npkt);
+            *cached = (pkt->pos << 1) | !npkt;
+            cache->num++;
+        }
         if (pkt != npkt && pkt != orig_pkt)
             talloc_free(pkt);
         pkt = npkt;
@@ -295,12 +519,62 @@ static void filter_and_add(struct sd *sd, struct demux_packet *pkt)
             return;
     }
 
+    load_fonts_for_text(sd, (bstr){pkt->buffer, pkt->len});
+
     ass_process_chunk(ctx->ass_track, pkt->buffer, pkt->len,
                       llrint(pkt->pts * 1000),
                       llrint(pkt->duration * 1000));
 
     if (pkt != orig_pkt)
         talloc_free(pkt);
+    return;
+
+drop:
+    if (pkt != orig_pkt)
+        talloc_free(pkt);
+}
+
+static void pos_table_reset(struct pos_table *t)
+{
+    if (t->num)
+        memset(t->entries, -1, t->size * sizeof(t->entries[0]));
+    t->num = 0;
+}
+
+static unsigned int hash_packet_pos(int64_t pos, int size)
+{
+    return ((uint64_t)pos * 0x9E3779B97F4A7C15ULL >> 32) & (size - 1);
+}
+
+// Return the entry for the given position. If it's not in the table, return an
+// unused entry (-1); the caller must set it, and increment t->num.
+static int64_t *pos_table_get(void *ta_parent, struct pos_table *t,
+                              int64_t pos, int shift)
+{
+    assert(pos >= 0);
+
+    // Keep the table at most half full.
+    if ((t->num + 1) * 2 > t->size) {
+        int64_t *old = t->entries;
+        int old_size = t->size;
+        t->size = MPMAX(old_size * 2, 256);
+        t->entries = talloc_array(ta_parent, int64_t, t->size);
+        memset(t->entries, -1, t->size * sizeof(t->entries[0]));
+        for (int n = 0; n < old_size; n++) {
+            if (old[n] < 0)
+                continue;
+            unsigned int i = hash_packet_pos(old[n] >> shift, t->size);
+            while (t->entries[i] >= 0)
+                i = (i + 1) & (t->size - 1);
+            t->entries[i] = old[n];
+        }
+        talloc_free(old);
+    }
+
+    unsigned int i = hash_packet_pos(pos, t->size);
+    while (t->entries[i] >= 0 && (t->entries[i] >> shift) != pos)
+        i = (i + 1) & (t->size - 1);
+    return &t->entries[i];
 }
 
 // Test if the packet with the given file position (used as unique ID) was
@@ -309,20 +583,11 @@ static void filter_and_add(struct sd *sd, struct demux_packet *pkt)
 static bool check_packet_seen(struct sd *sd, int64_t pos)
 {
     struct sd_ass_priv *priv = sd->priv;
-    int a = 0;
-    int b = priv->num_seen_packets;
-    while (a < b) {
-        int mid = a + (b - a) / 2;
-        int64_t val = priv->seen_packets[mid];
-        if (pos == val)
-            return true;
-        if (pos > val) {
-            a = mid + 1;
-        } else {
-            b = mid;
-        }
-    }
-    MP_TARRAY_INSERT_AT(priv, priv->seen_packets, priv->num_seen_packets, a, pos);
+    int64_t *entry = pos_table_get(priv, &priv->seen_packets, pos, 0);
+    if (*entry >= 0)
+        return true;
+    *entry = pos;
+    priv->seen_packets.num++;
     return false;
 }
 
@@ -351,6 +616,7 @@ static void decode(struct sd *sd, struct demux_packet *packet)
 
         for (int n = 0; r && r[n]; n++) {
             struct demux_packet pkt2 = {
+                .pos = -1, // not unique per converted event
                 .pts = sub_pts,
                 .duration = sub_duration,
                 .buffer = r[n],
@@ -454,6 +720,138 @@ static bool has_overrides(char *s)
 
 #define END(ev) ((ev)->Start + (ev)->Duration)
 
+// Events longer than this (in ms) are not part of the sorted index, because
+// they would make every lookup scan a large part of it.
+#define LONG_EVENT_DURATION (60 * 1000)
+
+static void reset_event_index(struct sd *sd)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+    ctx->num_ev_sorted = 0;
+    ctx->num_ev_long = 0;
+    ctx->ev_indexed = 0;
+    ctx->ev_max_duration = 0;
+    ctx->text_valid = false;
+}
+
+static int cmp_event_ref(const void *a, const void *b)
+{
+    const struct event_ref *ea = a, *eb = b;
+    if (ea->start != eb->start)
+        return ea->start < eb->start ? -1 : 1;
+    return ea->index - eb->index;
+}
+
+// Add events appended to the track since the last call to the index. Events
+// are only ever appended, or the whole track is flushed (which must be paired
+// with reset_event_index()).
+static void update_event_index(struct sd *sd)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+    ASS_Track *track = ctx->ass_track;
+
+    if (track->n_events < ctx->ev_indexed)
+        reset_event_index(sd);
+    if (track->n_events == ctx->ev_indexed)
+        return;
+
+    int first = ctx->num_ev_sorted;
+    for (int n = ctx->ev_indexed; n < track->n_events; n++) {
+        ASS_Event *event = &track->events[n];
+        struct event_ref ref = {event->Start, n};
+        if (event->Duration > LONG_EVENT_DURATION) {
+            MP_TARRAY_APPEND(ctx, ctx->ev_long, ctx->num_ev_long, ref);
+        } else {
+            MP_TARRAY_APPEND(ctx, ctx->ev_sorted, ctx->num_ev_sorted, ref);
+            ctx->ev_max_duration = MPMAX(ctx->ev_max_duration, event->Duration);
+        }
+    }
+    ctx->ev_indexed = track->n_events;
+
+    // Usually, new events come in order, and are simply appended. Otherwise,
+    // sort the new ones and merge them with the existing ones.
+    struct event_ref *ev = ctx->ev_sorted;
+    int num_new = ctx->num_ev_sorted - first;
+    bool sorted = true;
+    for (int n = MPMAX(first, 1); n < ctx->num_ev_sorted; n++)
+        sorted &= cmp_event_ref(&ev[n - 1], &ev[n]) <= 0;
+    if (sorted)
+        return;
+
+    qsort(ev + first, num_new, sizeof(ev[0]), cmp_event_ref);
+    if (!first || cmp_event_ref(&ev[first - 1], &ev[first]) <= 0)
+        return;
+
+    struct event_ref *tmp = talloc_memdup(NULL, ev + first,
+                                          num_new * sizeof(ev[0]));
+    int a = first - 1, b = num_new - 1, dst = ctx->num_ev_sorted - 1;
+    while (b >= 0) {
+        if (a >= 0 && cmp_event_ref(&ev[a], &tmp[b]) > 0) {
+            ev[dst--] = ev[a--];
+        } else {
+            ev[dst--] = tmp[b--];
+        }
+    }
+    talloc_free(tmp);
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+static void check_found_event(struct sd_ass_priv *ctx, int index,
+                              long long lo, long long hi)
+{
+    ASS_Event *event = &ctx->ass_track->events[index];
+    if (event->Start <= hi && END(event) > lo)
+        MP_TARRAY_APPEND(ctx, ctx->ev_found, ctx->num_ev_found, index);
+}
+
+// Set ctx->ev_found to the indexes of all events with Start <= hi and
+// END(event) > lo, in track order.
+static void find_events(struct sd *sd, long long lo, long long hi)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+    ASS_Track *track = ctx->ass_track;
+
+    ctx->num_ev_found = 0;
+
+    // Durations are rewritten after the fact, and the track is small anyway.
+    if (ctx->duration_unknown) {
+        for (int n = 0; n < track->n_events; n++)
+            check_found_event(ctx, n, lo, hi);
+        return;
+    }
+
+    update_event_index(sd);
+
+    // First event that could still overlap with lo.
+    long long min_start = lo - ctx->ev_max_duration;
+    int a = 0, b = ctx->num_ev_sorted;
+    while (a < b) {
+        int mid = a + (b - a) / 2;
+        if (ctx->ev_sorted[mid].start < min_start) {
+            a = mid + 1;
+        } else {
+            b = mid;
+        }
+    }
+
+    for (int n = a; n < ctx->num_ev_sorted; n++) {
+        if (ctx->ev_sorted[n].start > hi)
+            break;
+        check_found_event(ctx, ctx->ev_sorted[n].index, lo, hi);
+    }
+    for (int n = 0; n < ctx->num_ev_long; n++)
+        check_found_event(ctx, ctx->ev_long[n].index, lo, hi);
+
+    if (ctx->num_ev_found > 1) {
+        qsort(ctx->ev_found, ctx->num_ev_found, sizeof(ctx->ev_found[0]),
+              cmp_int);
+    }
+}
+
 static long long find_timestamp(struct sd *sd, double pts)
 {
     struct sd_ass_priv *priv = sd->priv;
@@ -473,13 +871,11 @@ static long long find_timestamp(struct sd *sd, double pts)
     // Find the "current" event.
     ASS_Event *ev[2] = {0};
     int n_ev = 0;
-    for (int n = 0; n < track->n_events; n++) {
-        ASS_Event *event = &track->events[n];
-        if (ts >= event->Start - threshold && ts <= END(event) + threshold) {
-            if (n_ev >= MP_ARRAY_SIZE(ev))
-                return ts; // multiple overlaps - give up (probably complex subs)
-            ev[n_ev++] = event;
-        }
+    find_events(sd, ts - threshold - 1, ts + threshold);
+    for (int n = 0; n < priv->num_ev_found; n++) {
+        if (n_ev >= MP_ARRAY_SIZE(ev))
+            return ts; // multiple overlaps - give up (probably complex subs)
+        ev[n_ev++] = &track->events[priv->ev_found[n]];
     }
 
     if (n_ev != 2)
@@ -561,7 +957,8 @@ static struct sub_bitmaps *get_bitmaps(struct sd *sd, struct mp_osd_res dim,
     long long ts = find_timestamp(sd, pts);
     if (ctx->duration_unknown && pts != MP_NOPTS_VALUE) {
         mp_ass_flush_old_events(track, ts);
-        ctx->num_seen_packets = 0;
+        reset_event_index(sd);
+        pos_table_reset(&ctx->seen_packets);
         sd->preload_ok = false;
     }
 
@@ -663,25 +1060,43 @@ static char *get_text_buf(struct sd *sd, double pts, enum sd_text_type type)
         return NULL;
     long long ipts = find_timestamp(sd, pts);
 
+    find_events(sd, ipts, ipts);
+
+    // Events are never changed after being added (until they are flushed), so
+    // the text is the same as long as the same events are visible.
+    if (ctx->text_valid && ctx->text_type == type &&
+        ctx->num_text_ev == ctx->num_ev_found &&
+        (!ctx->num_ev_found ||
+         memcmp(ctx->text_ev, ctx->ev_found,
+                ctx->num_ev_found * sizeof(ctx->ev_found[0])) == 0))
+        return ctx->last_text;
+
+    MP_RESIZE_ARRAY(ctx, ctx->text_ev, ctx->num_ev_found);
+    if (ctx->num_ev_found) {
+        memcpy(ctx->text_ev, ctx->ev_found,
+               ctx->num_ev_found * sizeof(ctx->ev_found[0]));
+    }
+    ctx->num_text_ev = ctx->num_ev_found;
+    ctx->text_type = type;
+    ctx->text_valid = true;
+
     struct buf b = {ctx->last_text, sizeof(ctx->last_text) - 1};
 
-    for (int i = 0; i < track->n_events; ++i) {
-        ASS_Event *event = track->events + i;
-        if (ipts >= event->Start && ipts < event->Start + event->Duration) {
-            if (event->Text) {
-                int start = b.len;
-                if (type == SD_TEXT_TYPE_PLAIN) {
-                    ass_to_plaintext(&b, event->Text);
-                } else {
-                    char *t = event->Text;
-                    while (*t)
-                        append(&b, *t++);
-                }
-                if (is_whitespace_only(&b.start[start], b.len - start)) {
-                    b.len = start;
-                } else {
-                    append(&b, '\n');
-                }
+    for (int i = 0; i < ctx->num_ev_found; ++i) {
+        ASS_Event *event = track->events + ctx->ev_found[i];
+        if (event->Text) {
+            int start = b.len;
+            if (type == SD_TEXT_TYPE_PLAIN) {
+                ass_to_plaintext(&b, event->Text);
+            } else {
+                char *t = event->Text;
+                while (*t)
+                    append(&b, *t++);
+            }
+            if (is_whitespace_only(&b.start[start], b.len - start)) {
+                b.len = start;
+            } else {
+                append(&b, '\n');
             }
         }
     }
@@ -710,19 +1125,18 @@ static struct sd_times get_times(struct sd *sd, double pts)
 
     long long ipts = find_timestamp(sd, pts);
 
-    for (int i = 0; i < track->n_events; ++i) {
-        ASS_Event *event = track->events + i;
-        if (ipts >= event->Start && ipts < event->Start + event->Duration) {
-            double start = event->Start / 1000.0;
-            double end = event->Duration == UNKNOWN_DURATION ?
-                MP_NOPTS_VALUE : (event->Start + event->Duration) / 1000.0;
+    find_events(sd, ipts, ipts);
+    for (int i = 0; i < ctx->num_ev_found; ++i) {
+        ASS_Event *event = track->events + ctx->ev_found[i];
+        double start = event->Start / 1000.0;
+        double end = event->Duration == UNKNOWN_DURATION ?
+            MP_NOPTS_VALUE : (event->Start + event->Duration) / 1000.0;
 
-            if (res.start == MP_NOPTS_VALUE || res.start > start)
-                res.start = start;
+        if (res.start == MP_NOPTS_VALUE || res.start > start)
+            res.start = start;
 
-            if (res.end == MP_NOPTS_VALUE || res.end < end)
-                res.end = end;
-        }
+        if (res.end == MP_NOPTS_VALUE || res.end < end)
+            res.end = end;
     }
 
     return res;
@@ -772,7 +1186,8 @@ static void reset(struct sd *sd)
     struct sd_ass_priv *ctx = sd->priv;
     if (sd->opts->sub_clear_on_seek || ctx->duration_unknown || ctx->clear_once) {
         ass_flush_events(ctx->ass_track);
-        ctx->num_seen_packets = 0;
+        reset_event_index(sd);
+        pos_table_reset(&ctx->seen_packets);
         sd->preload_ok = false;
         ctx->clear_once = false;
     }
@@ -820,6 +1235,7 @@ static int control(struct sd *sd, enum sd_ctrl cmd, void *arg)
         if (flags & UPDATE_SUB_HARD) {
             assobjects_destroy(sd);
             assobjects_init(sd);
+            reset_event_index(sd);
         }
         return CONTROL_OK;
     }
@@ -831,6 +1247,7 @@ static int control(struct sd *sd, enum sd_ctrl cmd, void *arg)
 const struct sd_functions sd_ass = {
     .name = "ass",
     .accept_packets_in_advance = true,
+    .can_render_ahead = true,
     .init = init,
     .decode = decode,
     .get_bitmaps = get_bitmaps,
@@ -926,14 +1343,14 @@ static void mangle_colors(struct sd *sd, struct sub_bitmaps *parts)
     vs_params.color.space = csp;
     vs_params.color.levels = levels;
     struct mp_cmat vs_yuv2rgb, vs_rgb2yuv;
-    mp_get_csp_matrix(&vs_params, &vs_yuv2rgb);
+    mp_get_csp_matrix_cached(&ctx->vs_matrix, &vs_params, &vs_yuv2rgb);
     mp_invert_cmat(&vs_rgb2yuv, &vs_yuv2rgb);
 
     // Proper conversion to RGB
     struct mp_csp_params rgb_params = MP_CSP_PARAMS_DEFAULTS;
     rgb_params.color = params.color;
     struct mp_cmat vs2rgb;
-    mp_get_csp_matrix(&rgb_params, &vs2rgb);
+    mp_get_csp_matrix_cached(&ctx->rgb_matrix, &rgb_params, &vs2rgb);
 
     for (int n = 0; n < parts->num_parts; n++) {
         struct sub_bitmap *sb = &parts->parts[n];
@@ -982,3 +1399,16 @@ bstr sd_ass_to_plaintext(char *out, size_t out_siz, const char *in)
         out[b.len] = 0;
     return (bstr){out, b.len};
 }
+
+bool sd_re_can_group(const char *re)
+{
+    // Backreferences would refer to the wrong group.
+    for (; *re; re++) {
+        if (re[0] == '\\' && re[1]) {
+            if (re[1] >= '0' && re[1] <= '9')
+                return false;
+            re++;
+        }
+    }
+    return true;
+}
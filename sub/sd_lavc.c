@@ -50,6 +50,10 @@ struct sub {
     double pts;
     double endpts;
     int64_t id;
+    // Options the bitmaps were converted with.
+    float conv_gauss;
+    int conv_gray;
+    int conv_forced_only;
 };
 
 struct seekpoint {
@@ -218,7 +222,12 @@ static void read_sub_bitmaps(struct sd *sd, struct sub *sub)
     sub->bound_w = bb[1].x;
     sub->bound_h = bb[1].y;
 
-    if (!sub->data || sub->data->w < sub->bound_w || sub->data->h < sub->bound_h) {
+    // All used parts of the image are rewritten, so if the old image is still
+    // referenced (e.g. by the VO, or shared with another sub), allocate a new
+    // one instead of letting mp_image_make_writeable() copy the old contents.
+    if (!sub->data || sub->data->w < sub->bound_w || sub->data->h < sub->bound_h ||
+        !mp_image_is_writeable(sub->data))
+    {
         talloc_free(sub->data);
         sub->data = mp_image_alloc(IMGFMT_BGRA, priv->packer->w, priv->packer->h);
         if (!sub->data) {
@@ -228,11 +237,6 @@ static void read_sub_bitmaps(struct sd *sd, struct sub *sub)
         talloc_steal(priv, sub->data);
     }
 
-    if (!mp_image_make_writeable(sub->data)) {
-        sub->count = 0;
-        return;
-    }
-
     for (int i = 0; i < sub->count; i++) {
         struct sub_bitmap *b = &sub->inbitmaps[i];
         struct pos pos = priv->packer->result[i];
@@ -289,6 +293,63 @@ static void read_sub_bitmaps(struct sd *sd, struct sub *sub)
     }
 }
 
+static bool same_rects(AVSubtitle *a, AVSubtitle *b)
+{
+    if (a->num_rects != b->num_rects)
+        return false;
+
+    for (int i = 0; i < a->num_rects; i++) {
+        struct AVSubtitleRect *ra = a->rects[i], *rb = b->rects[i];
+        if (ra->type != rb->type || ra->flags != rb->flags ||
+            ra->x != rb->x || ra->y != rb->y || ra->w != rb->w ||
+            ra->h != rb->h || ra->nb_colors != rb->nb_colors)
+            return false;
+        if (ra->type != SUBTITLE_BITMAP || ra->w <= 0 || ra->h <= 0)
+            continue;
+        if (memcmp(ra->data[1], rb->data[1], ra->nb_colors * 4))
+            return false;
+        for (int y = 0; y < ra->h; y++) {
+            if (memcmp(ra->data[0] + y * ra->linesize[0],
+                       rb->data[0] + y * rb->linesize[0], ra->w))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+// Many bitmap subs repeat the same content in consecutive events (e.g. PGS
+// acquisition points, which refresh the current display set). If sub has the
+// same content as prev, reuse prev's converted bitmaps and ID, which also
+// avoids making the VO re-render it.
+static bool reuse_sub_bitmaps(struct sd *sd, struct sub *sub, struct sub *prev)
+{
+    struct mp_subtitle_opts *opts = sd->opts;
+    struct sd_lavc_priv *priv = sd->priv;
+
+    if (!prev->valid || !prev->count || prev->conv_gauss != opts->sub_gauss ||
+        prev->conv_gray != opts->sub_gray ||
+        prev->conv_forced_only != opts->forced_subs_only_current ||
+        !same_rects(&sub->avsub, &prev->avsub))
+        return false;
+
+    struct mp_image *data = mp_image_new_ref(prev->data);
+    if (!data)
+        return false;
+    talloc_free(sub->data);
+    sub->data = talloc_steal(priv, data);
+
+    MP_TARRAY_GROW(priv, sub->inbitmaps, prev->count);
+    memcpy(sub->inbitmaps, prev->inbitmaps, prev->count * sizeof(sub->inbitmaps[0]));
+    sub->count = prev->count;
+    sub->bound_w = prev->bound_w;
+    sub->bound_h = prev->bound_h;
+    sub->src_w = prev->src_w;
+    sub->src_h = prev->src_h;
+    sub->id = prev->id;
+    return true;
+}
+
 static void decode(struct sd *sd, struct demux_packet *packet)
 {
     struct mp_subtitle_opts *opts = sd->opts;
@@ -369,8 +430,12 @@ static void decode(struct sd *sd, struct demux_packet *packet)
     current->pts = pts;
     current->endpts = endpts;
     current->avsub = sub;
+    current->conv_gauss = opts->sub_gauss;
+    current->conv_gray = opts->sub_gray;
+    current->conv_forced_only = opts->forced_subs_only_current;
 
-    read_sub_bitmaps(sd, current);
+    if (!reuse_sub_bitmaps(sd, current, &priv->subs[1]))
+        read_sub_bitmaps(sd, current);
 
     if (pts != MP_NOPTS_VALUE) {
         for (int n = 0; n < priv->num_seekpoints; n++) {
@@ -20,6 +20,7 @@
 
 #define TA_NO_WRAPPERS
 #include "ta.h"
+#include "osdep/atomic.h"
 
 // Note: the actual minimum alignment is dictated by malloc(). It doesn't
 //       make sense to set this value higher than malloc's alignment.
@@ -34,7 +35,7 @@
 #endif
 
 struct ta_header {
-    size_t size;                // size of the user allocation
+    size_t size;                // size of the user allocation (| SIZE_FLAGS)
     // Invariant: parent!=NULL => prev==NULL
     struct ta_header *prev;     // siblings list (by destructor order)
     struct ta_header *next;
@@ -65,7 +66,42 @@ union aligned_header {
 #define PTR_TO_HEADER(ptr) (&((union aligned_header *)(ptr) - 1)->ta)
 #define PTR_FROM_HEADER(h) ((void *)((union aligned_header *)(h) + 1))
 
-#define MAX_ALLOC (((size_t)-1) - sizeof(union aligned_header))
+// Flags stored in the upper bits of ta_header.size.
+#define ARENA_BLOCK   ((size_t)1 << (sizeof(size_t) * 8 - 1)) // from a chunk
+#define ARENA_CONTEXT ((size_t)1 << (sizeof(size_t) * 8 - 2)) // ta_new_arena()
+#define SIZE_FLAGS (ARENA_BLOCK | ARENA_CONTEXT)
+
+// Memory allocations for the children of an arena context are bump-allocated
+// from chunks. Each block references its chunk, and the chunk is freed once
+// all blocks allocated from it are freed (and the arena stopped using it).
+// So arena blocks behave exactly like normal blocks, and can be reparented
+// and freed individually; only the memory is released later.
+struct ta_chunk {
+    atomic_int refs;    // live blocks, +1 while it's the arena's current chunk
+    size_t used, size;
+};
+
+union chunk_header {
+    struct ta_chunk c;
+    char align_min[(sizeof(struct ta_chunk) + MIN_ALIGN - 1) & ~(MIN_ALIGN - 1)];
+};
+
+// Stored before the ta_header of ARENA_BLOCK allocations.
+union arena_prefix {
+    struct ta_chunk *chunk;
+    char align_min[MIN_ALIGN];
+};
+
+// User data of an ARENA_CONTEXT allocation (its user size is 0).
+struct ta_arena {
+    struct ta_chunk *cur;
+    size_t chunk_size;
+};
+
+#define DEFAULT_CHUNK_SIZE (16 * 1024)
+
+#define MAX_ALLOC ((((size_t)-1) & ~SIZE_FLAGS) - sizeof(union aligned_header) \
+                   - sizeof(union arena_prefix))
 
 static void ta_dbg_add(struct ta_header *h);
 static void ta_dbg_check_header(struct ta_header *h);
@@ -78,6 +114,76 @@ static struct ta_header *get_header(void *ptr)
     return h;
 }
 
+static struct ta_chunk *get_chunk(struct ta_header *h)
+{
+    return ((union arena_prefix *)h - 1)->chunk;
+}
+
+static void chunk_unref(struct ta_chunk *c)
+{
+    if (atomic_fetch_add(&c->refs, -1) == 1)
+        free(c);
+}
+
+// Return NULL if the allocation should use malloc() instead.
+static struct ta_header *arena_alloc(struct ta_arena *arena, size_t size)
+{
+    size_t need = sizeof(union arena_prefix) + sizeof(union aligned_header) +
+                  ((size + MIN_ALIGN - 1) & ~(size_t)(MIN_ALIGN - 1));
+    if (need > arena->chunk_size / 4)
+        return NULL;
+
+    struct ta_chunk *c = arena->cur;
+    // Reuse the chunk if everything allocated from it was freed.
+    if (c && atomic_load(&c->refs) == 1)
+        c->used = 0;
+    if (!c || c->size - c->used < need) {
+        struct ta_chunk *nc = malloc(sizeof(union chunk_header) + arena->chunk_size);
+        if (!nc)
+            return NULL;
+        nc->used = 0;
+        nc->size = arena->chunk_size;
+        atomic_store(&nc->refs, 1);
+        if (c)
+            chunk_unref(c);
+        arena->cur = c = nc;
+    }
+
+    char *p = (char *)((union chunk_header *)c + 1) + c->used;
+    c->used += need;
+    atomic_fetch_add(&c->refs, 1);
+    ((union arena_prefix *)p)->chunk = c;
+    return (struct ta_header *)(p + sizeof(union arena_prefix));
+}
+
+static struct ta_header *alloc_header(void *ta_parent, size_t size, bool zero)
+{
+    struct ta_header *parent = get_header(ta_parent);
+    if (parent && (parent->size & ARENA_CONTEXT)) {
+        struct ta_header *h = arena_alloc(PTR_FROM_HEADER(parent), size);
+        if (h) {
+            if (zero)
+                memset(h, 0, sizeof(union aligned_header) + size);
+            *h = (struct ta_header) {.size = size | ARENA_BLOCK};
+            return h;
+        }
+    }
+    size_t full = sizeof(union aligned_header) + size;
+    struct ta_header *h = zero ? calloc(1, full) : malloc(full);
+    if (h)
+        *h = (struct ta_header) {.size = size};
+    return h;
+}
+
+static void free_header(struct ta_header *h)
+{
+    if (h->size & ARENA_BLOCK) {
+        chunk_unref(get_chunk(h));
+    } else {
+        free(h);
+    }
+}
+
 /* Set the parent allocation of ptr. If parent==NULL, remove the parent.
  * Setting parent==NULL (with ptr!=NULL) unsets the parent of ptr.
  * With ptr==NULL, the function does nothing.
@@ -138,10 +244,9 @@ void *ta_alloc_size(void *ta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
-    struct ta_header *h = malloc(sizeof(union aligned_header) + size);
+    struct ta_header *h = alloc_header(ta_parent, size, false);
     if (!h)
         return NULL;
-    *h = (struct ta_header) {.size = size};
     ta_dbg_add(h);
     void *ptr = PTR_FROM_HEADER(h);
     ta_set_parent(ptr, ta_parent);
@@ -155,10 +260,9 @@ void *ta_zalloc_size(void *ta_parent, size_t size)
 {
     if (size >= MAX_ALLOC)
         return NULL;
-    struct ta_header *h = calloc(1, sizeof(union aligned_header) + size);
+    struct ta_header *h = alloc_header(ta_parent, size, true);
     if (!h)
         return NULL;
-    *h = (struct ta_header) {.size = size};
     ta_dbg_add(h);
     void *ptr = PTR_FROM_HEADER(h);
     ta_set_parent(ptr, ta_parent);
@@ -189,14 +293,27 @@ void *ta_realloc_size(void *ta_parent, void *ptr, size_t size)
         return ta_alloc_size(ta_parent, size);
     struct ta_header *h = get_header(ptr);
     struct ta_header *old_h = h;
-    if (h->size == size)
+    assert(!(h->size & ARENA_CONTEXT));
+    if ((h->size & ~SIZE_FLAGS) == size)
         return ptr;
     ta_dbg_remove(h);
-    h = realloc(h, sizeof(union aligned_header) + size);
+    if (h->size & ARENA_BLOCK) {
+        // Move it out of the chunk.
+        h = malloc(sizeof(union aligned_header) + size);
+        if (h) {
+            size_t old_size = old_h->size & ~SIZE_FLAGS;
+            memcpy(h, old_h, sizeof(union aligned_header) +
+                             (old_size < size ? old_size : size));
+            chunk_unref(get_chunk(old_h));
+        }
+    } else {
+        h = realloc(h, sizeof(union aligned_header) + size);
+    }
+    if (h)
+        h->size = size;
     ta_dbg_add(h ? h : old_h);
     if (!h)
         return NULL;
-    h->size = size;
     if (h != old_h) {
         // Relink parent
         if (h->parent)
@@ -220,7 +337,7 @@ void *ta_realloc_size(void *ta_parent, void *ptr, size_t size)
 size_t ta_get_size(void *ptr)
 {
     struct ta_header *h = get_header(ptr);
-    return h ? h->size : 0;
+    return h ? h->size & ~SIZE_FLAGS : 0;
 }
 
 /* Free all allocations that (recursively) have ptr as parent allocation, but
@@ -245,7 +362,36 @@ void ta_free(void *ptr)
     ta_free_children(ptr);
     ta_set_parent(ptr, NULL);
     ta_dbg_remove(h);
-    free(h);
+    if (h->size & ARENA_CONTEXT) {
+        struct ta_arena *arena = ptr;
+        if (arena->cur)
+            chunk_unref(arena->cur);
+    }
+    free_header(h);
+}
+
+/* Create an empty allocation like ta_new_context(), whose direct children are
+ * allocated from larger chunks of memory (of chunk_size bytes, 0 for the
+ * default), instead of calling malloc() for each of them. This is meant for
+ * many small allocations that are freed together. The children behave like
+ * normal allocations (they can be reallocated, reparented, and freed one by
+ * one), but the memory of a chunk is only released when all allocations from
+ * it are gone. Allocations larger than a quarter chunk use malloc() as usual.
+ */
+void *ta_new_arena(void *ta_parent, size_t chunk_size)
+{
+    struct ta_header *h = malloc(sizeof(union aligned_header) +
+                                 sizeof(struct ta_arena));
+    if (!h)
+        return NULL;
+    *h = (struct ta_header) {.size = ARENA_CONTEXT};
+    ta_dbg_add(h);
+    void *ptr = PTR_FROM_HEADER(h);
+    *(struct ta_arena *)ptr = (struct ta_arena) {
+        .chunk_size = chunk_size ? chunk_size : DEFAULT_CHUNK_SIZE,
+    };
+    ta_set_parent(ptr, ta_parent);
+    return ptr;
 }
 
 /* Set a destructor that is to be called when the given allocation is freed.
@@ -271,9 +417,69 @@ void ta_set_destructor(void *ptr, void (*destructor)(void *))
 
 static pthread_mutex_t ta_dbg_mutex = PTHREAD_MUTEX_INITIALIZER;
 static bool enable_leak_check; // pretty much constant
+static bool enable_profile; // pretty much constant
+static bool leak_report_registered;
 static struct ta_header leak_node;
 static char allocation_is_string;
 
+// Allocation profile: open addressing hash table, keyed by the name pointer
+// (normally a static TA_LOC string). Only allocations in the leak list (i.e.
+// made after profiling was enabled) are accounted. Protected by ta_dbg_mutex.
+static struct ta_alloc_stat *prof_locs;
+static size_t prof_size; // power of 2, or 0
+static size_t prof_num;
+
+static struct ta_alloc_stat *prof_get(const char *name)
+{
+    if (prof_num * 2 >= prof_size) {
+        size_t new_size = prof_size ? prof_size * 2 : 1024;
+        struct ta_alloc_stat *new_locs = calloc(new_size, sizeof(new_locs[0]));
+        if (!new_locs)
+            return NULL;
+        for (size_t n = 0; n < prof_size; n++) {
+            struct ta_alloc_stat *e = &prof_locs[n];
+            if (!e->loc)
+                continue;
+            size_t i = ((uintptr_t)e->loc >> 4) & (new_size - 1);
+            while (new_locs[i].loc)
+                i = (i + 1) & (new_size - 1);
+            new_locs[i] = *e;
+        }
+        free(prof_locs);
+        prof_locs = new_locs;
+        prof_size = new_size;
+    }
+    if (!name)
+        name = "unknown";
+    size_t i = ((uintptr_t)name >> 4) & (prof_size - 1);
+    while (prof_locs[i].loc && prof_locs[i].loc != name)
+        i = (i + 1) & (prof_size - 1);
+    if (!prof_locs[i].loc) {
+        prof_locs[i].loc = name;
+        prof_num++;
+    }
+    return &prof_locs[i];
+}
+
+// Add (add=true) or remove the allocation to/from the profile. If allocs is
+// not 0, add it to the allocation counter too.
+static void prof_account(struct ta_header *h, bool add, int allocs)
+{
+    const char *name = h->name == &allocation_is_string ? "string" : h->name;
+    struct ta_alloc_stat *e = prof_get(name);
+    if (!e)
+        return;
+    size_t size = h->size & ~SIZE_FLAGS;
+    if (add) {
+        e->live_bytes += size;
+        e->live_blocks += 1;
+    } else {
+        e->live_bytes -= size;
+        e->live_blocks -= 1;
+    }
+    e->allocs += allocs;
+}
+
 static void ta_dbg_add(struct ta_header *h)
 {
     h->canary = CANARY;
@@ -283,6 +489,8 @@ static void ta_dbg_add(struct ta_header *h)
         h->leak_prev = leak_node.leak_prev;
         leak_node.leak_prev->leak_next = h;
         leak_node.leak_prev = h;
+        if (enable_profile)
+            prof_account(h, true, 1);
         pthread_mutex_unlock(&ta_dbg_mutex);
     }
 }
@@ -303,6 +511,8 @@ static void ta_dbg_remove(struct ta_header *h)
     ta_dbg_check_header(h);
     if (h->leak_next) { // assume checking for !=NULL invariant ok without lock
         pthread_mutex_lock(&ta_dbg_mutex);
+        if (enable_profile)
+            prof_account(h, false, 0);
         h->leak_next->leak_prev = h->leak_prev;
         h->leak_prev->leak_next = h->leak_next;
         pthread_mutex_unlock(&ta_dbg_mutex);
@@ -315,7 +525,7 @@ static size_t get_children_size(struct ta_header *h)
 {
     size_t size = 0;
     for (struct ta_header *s = h->child; s; s = s->next)
-        size += s->size + get_children_size(s);
+        size += (s->size & ~SIZE_FLAGS) + get_children_size(s);
     return size;
 }
 
@@ -338,16 +548,17 @@ static void print_leak_report(void)
                     snprintf(name, sizeof(name), "%s", cur->name);
                 if (cur->name == &allocation_is_string) {
                     snprintf(name, sizeof(name), "'%.*s'",
-                             (int)cur->size, (char *)PTR_FROM_HEADER(cur));
+                             (int)(cur->size & ~SIZE_FLAGS),
+                             (char *)PTR_FROM_HEADER(cur));
                 }
                 for (int n = 0; n < sizeof(name); n++) {
                     if (name[n] && name[n] < 0x20)
                         name[n] = '.';
                 }
                 fprintf(stderr, "  %-20p %10zu %10zu  %s\n",
-                        cur, cur->size, c_size, name);
+                        cur, cur->size & ~SIZE_FLAGS, c_size, name);
             }
-            size += cur->size;
+            size += cur->size & ~SIZE_FLAGS;
             num_blocks += 1;
             // Unlink, and don't confuse valgrind by leaving live pointers.
             cur->leak_next->leak_prev = cur->leak_prev;
@@ -359,18 +570,59 @@ static void print_leak_report(void)
     pthread_mutex_unlock(&ta_dbg_mutex);
 }
 
-void ta_enable_leak_report(void)
+static void init_leak_list(void)
 {
-    pthread_mutex_lock(&ta_dbg_mutex);
     enable_leak_check = true;
     if (!leak_node.leak_prev && !leak_node.leak_next) {
         leak_node.leak_prev = &leak_node;
         leak_node.leak_next = &leak_node;
+    }
+}
+
+void ta_enable_leak_report(void)
+{
+    pthread_mutex_lock(&ta_dbg_mutex);
+    init_leak_list();
+    if (!leak_report_registered) {
+        leak_report_registered = true;
         atexit(print_leak_report);
     }
     pthread_mutex_unlock(&ta_dbg_mutex);
 }
 
+/* Start accounting live memory per allocation name (see ta_dbg_set_loc()).
+ * Allocations made before this call are not included. This makes every
+ * allocation take a global lock, so it's for debugging only.
+ * Returns false if this was compiled without TA_MEMORY_DEBUGGING.
+ */
+bool ta_enable_alloc_profile(void)
+{
+    pthread_mutex_lock(&ta_dbg_mutex);
+    init_leak_list();
+    enable_profile = true;
+    pthread_mutex_unlock(&ta_dbg_mutex);
+    return true;
+}
+
+/* Return a snapshot of the allocation profile, sorted by name address (i.e.
+ * in no meaningful order). *out is allocated with malloc(), and must be
+ * free()d by the caller. Returns the number of entries in *out.
+ */
+size_t ta_get_alloc_profile(struct ta_alloc_stat **out)
+{
+    pthread_mutex_lock(&ta_dbg_mutex);
+    size_t num = 0;
+    *out = prof_num ? malloc(prof_num * sizeof((*out)[0])) : NULL;
+    if (*out) {
+        for (size_t n = 0; n < prof_size; n++) {
+            if (prof_locs[n].loc)
+                (*out)[num++] = prof_locs[n];
+        }
+    }
+    pthread_mutex_unlock(&ta_dbg_mutex);
+    return num;
+}
+
 /* Set a (static) string that will be printed if the memory allocation in ptr
  * shows up on the leak report. The string must stay valid until ptr is freed.
  * Calling it on ptr==NULL does nothing.
@@ -380,8 +632,18 @@ void ta_enable_leak_report(void)
 void *ta_dbg_set_loc(void *ptr, const char *loc)
 {
     struct ta_header *h = get_header(ptr);
-    if (h)
-        h->name = loc;
+    if (h) {
+        if (enable_profile && h->leak_next) {
+            pthread_mutex_lock(&ta_dbg_mutex);
+            // (Normally called right after allocation; move it to the name.)
+            prof_account(h, false, -1);
+            h->name = loc;
+            prof_account(h, true, 1);
+            pthread_mutex_unlock(&ta_dbg_mutex);
+        } else {
+            h->name = loc;
+        }
+    }
     return ptr;
 }
 
@@ -400,6 +662,8 @@ static void ta_dbg_check_header(struct ta_header *h){}
 static void ta_dbg_remove(struct ta_header *h){}
 
 void ta_enable_leak_report(void){}
+bool ta_enable_alloc_profile(void){return false;}
+size_t ta_get_alloc_profile(struct ta_alloc_stat **out){*out = NULL; return 0;}
 void *ta_dbg_set_loc(void *ptr, const char *loc){return ptr;}
 void *ta_dbg_mark_as_string(void *ptr){return ptr;}
 
@@ -17,6 +17,7 @@
 #define TA_H_
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include <stdarg.h>
 
@@ -53,6 +54,7 @@ void ta_free_children(void *ptr);
 void ta_set_destructor(void *ptr, void (*destructor)(void *));
 void ta_set_parent(void *ptr, void *ta_parent);
 void *ta_get_parent(void *ptr);
+void *ta_new_arena(void *ta_parent, size_t chunk_size);
 
 // Utility functions
 size_t ta_calc_array_size(size_t element_size, size_t count);
@@ -107,6 +109,7 @@ bool ta_vasprintf_append_buffer(char **str, const char *fmt, va_list ap) TA_PRF(
 #define ta_xalloc_size(...)             ta_oom_p(ta_alloc_size(__VA_ARGS__))
 #define ta_xzalloc_size(...)            ta_oom_p(ta_zalloc_size(__VA_ARGS__))
 #define ta_xnew_context(...)            ta_oom_p(ta_new_context(__VA_ARGS__))
+#define ta_xnew_arena(...)              ta_oom_p(ta_new_arena(__VA_ARGS__))
 #define ta_xstrdup_append(...)          ta_oom_b(ta_strdup_append(__VA_ARGS__))
 #define ta_xstrdup_append_buffer(...)   ta_oom_b(ta_strdup_append_buffer(__VA_ARGS__))
 #define ta_xstrndup_append(...)         ta_oom_b(ta_strndup_append(__VA_ARGS__))
@@ -151,6 +154,16 @@ void *ta_oom_p(void *p);
 #define ta_oom_g(ptr) (TA_TYPEOF(ptr))ta_oom_p(ptr)
 
 void ta_enable_leak_report(void);
+
+struct ta_alloc_stat {
+    const char *loc;        // ta_dbg_set_loc() name, or "unknown"/"string"
+    size_t live_bytes;      // user size of live allocations
+    size_t live_blocks;     // number of live allocations
+    uint64_t allocs;        // number of allocations/reallocations so far
+};
+
+bool ta_enable_alloc_profile(void);
+size_t ta_get_alloc_profile(struct ta_alloc_stat **out);
 void *ta_dbg_set_loc(void *ptr, const char *name);
 void *ta_dbg_mark_as_string(void *ptr);
 
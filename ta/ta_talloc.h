@@ -37,6 +37,7 @@
 #define talloc_steal                    ta_steal
 #define talloc_realloc_size             ta_xrealloc_size
 #define talloc_new                      ta_xnew_context
+#define talloc_new_arena(ctx)           ta_xnew_arena(ctx, 0)
 #define talloc_set_destructor           ta_set_destructor
 #define talloc_enable_leak_report       ta_enable_leak_report
 #define talloc_size                     ta_xalloc_size
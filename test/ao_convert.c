@@ -0,0 +1,95 @@
+#include "audio/format.h"
+#include "audio/out/internal.h"
+#include "common/msg.h"
+#include "osdep/endian.h"
+#include "osdep/timer.h"
+#include "tests.h"
+
+// The LSB is always ignored.
+#if BYTE_ORDER == BIG_ENDIAN
+#define SHIFT24(x) ((3-(x))*8)
+#else
+#define SHIFT24(x) (((x)+1)*8)
+#endif
+
+// Plain byte-wise conversion, as reference.
+static void convert_ref(int bytes, uint32_t *src, uint8_t *dst, int num_samples)
+{
+    for (int s = 0; s < num_samples; s++) {
+        uint8_t *ptr = dst + s * bytes;
+        ptr[0] = src[s] >> SHIFT24(0);
+        ptr[1] = src[s] >> SHIFT24(1);
+        ptr[2] = src[s] >> SHIFT24(2);
+        if (bytes == 4)
+            ptr[3] = 0;
+    }
+}
+
+static void fill(uint32_t *data, int num_samples)
+{
+    uint32_t seed = 1;
+    for (int n = 0; n < num_samples; n++) {
+        seed = seed * 1664525 + 1013904223;
+        data[n] = seed;
+    }
+}
+
+static void run(struct test_ctx *ctx)
+{
+    struct ao_convert_fmt fmts[] = {
+        {.src_fmt = AF_FORMAT_S32, .channels = 2, .dst_bits = 24},
+        {.src_fmt = AF_FORMAT_S32, .channels = 2, .dst_bits = 32, .pad_msb = 8},
+    };
+
+    for (int i = 0; i < MP_ARRAY_SIZE(fmts); i++) {
+        struct ao_convert_fmt *fmt = &fmts[i];
+        int bytes = fmt->dst_bits / 8;
+
+        // All remainder lengths; the sample count is per channel.
+        for (int samples = 0; samples < 40; samples++) {
+            int num = samples * fmt->channels;
+            uint32_t *data = talloc_array(NULL, uint32_t, num + 1);
+            uint32_t *src = talloc_array(NULL, uint32_t, num + 1);
+            uint8_t *ref = talloc_array(NULL, uint8_t, num * 4 + 1);
+            fill(data, num);
+            memcpy(src, data, num * 4);
+
+            ao_convert_inplace(fmt, (void **)&data, samples);
+            convert_ref(bytes, src, ref, num);
+            assert_memcmp(data, ref, num * bytes);
+
+            talloc_free(data);
+            talloc_free(src);
+            talloc_free(ref);
+        }
+
+        // 1 second of 32 channel 192 kHz audio.
+        struct ao_convert_fmt bench_fmt = *fmt;
+        bench_fmt.channels = 32;
+        int samples = 192000;
+        int num = samples * bench_fmt.channels;
+        uint32_t *data = talloc_array(NULL, uint32_t, num);
+        uint8_t *ref = talloc_array(NULL, uint8_t, num * 4);
+
+        fill(data, num);
+        int64_t start = mp_time_us();
+        convert_ref(bytes, data, ref, num);
+        int64_t time_ref = mp_time_us() - start;
+
+        start = mp_time_us();
+        ao_convert_inplace(&bench_fmt, (void **)&data, samples);
+        int64_t time = mp_time_us() - start;
+
+        assert_memcmp(data, ref, num * bytes);
+        MP_INFO(ctx, "s32 -> %d bits: bytewise %6.2f ms, converted %6.2f ms\n",
+                bench_fmt.dst_bits, time_ref / 1000.0, time / 1000.0);
+
+        talloc_free(data);
+        talloc_free(ref);
+    }
+}
+
+const struct unittest test_ao_convert = {
+    .name = "ao_convert",
+    .run = run,
+};
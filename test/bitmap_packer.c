@@ -0,0 +1,174 @@
+#include <stdio.h>
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "osdep/timer.h"
+#include "video/out/bitmap_packer.h"
+#include "tests.h"
+
+// Deterministic sizes roughly like those of libass glyph bitmaps: mostly small,
+// some wide (whole lines/borders), a few large (drawings, blur).
+static struct pos random_size(uint32_t *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    uint32_t r = *state >> 8;
+    int w = 4 + r % 48, h = 8 + (r >> 6) % 40;
+    if (r % 32 == 0)
+        w = 200 + (r >> 12) % 800;
+    if (r % 256 == 1) {
+        w = 100 + (r >> 10) % 400;
+        h = 100 + (r >> 14) % 300;
+    }
+    return (struct pos){w, h};
+}
+
+// Check that all rectangles are inside the surface and don't overlap.
+static void check_packing(struct bitmap_packer *packer, struct pos *sizes)
+{
+    assert_true(packer->w > 0 && !(packer->w & (packer->w - 1)));
+    assert_true(packer->h > 0 && !(packer->h & (packer->h - 1)));
+    assert_true(packer->used_width <= packer->w);
+    assert_true(packer->used_height <= packer->h);
+
+    uint8_t *used = talloc_zero_size(NULL, packer->w * (size_t)packer->h);
+    for (int n = 0; n < packer->count; n++) {
+        struct pos p = packer->result[n];
+        struct pos s = sizes[n];
+        assert_true(p.x >= packer->padding && p.y >= packer->padding);
+        assert_true(p.x + s.x + packer->padding <= packer->used_width);
+        assert_true(p.y + s.y + packer->padding <= packer->used_height);
+        for (int y = p.y - packer->padding; y < p.y + s.y + packer->padding; y++) {
+            for (int x = p.x - packer->padding; x < p.x + s.x + packer->padding; x++) {
+                uint8_t *u = &used[y * (size_t)packer->w + x];
+                assert_true(!*u);
+                *u = 1;
+            }
+        }
+    }
+    talloc_free(used);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    static const int counts[] = {1, 2, 17, 300, 5000};
+    uint32_t state = 1;
+
+    for (int padding = 0; padding <= 1; padding++) {
+        for (int c = 0; c < MP_ARRAY_SIZE(counts); c++) {
+            struct bitmap_packer *packer = talloc_zero(NULL, struct bitmap_packer);
+            packer->padding = padding;
+            // Pack twice, the second time with the size from the first.
+            for (int i = 0; i < 2; i++) {
+                packer_set_size(packer, counts[c]);
+                struct pos *sizes = talloc_array(NULL, struct pos, counts[c]);
+                for (int n = 0; n < counts[c]; n++)
+                    packer->in[n] = sizes[n] = random_size(&state);
+                assert_true(packer_pack(packer) >= 0);
+                check_packing(packer, sizes);
+                talloc_free(sizes);
+            }
+            talloc_free(packer);
+        }
+    }
+
+    // Doesn't fit into the maximum size.
+    struct bitmap_packer *packer = talloc_zero(NULL, struct bitmap_packer);
+    packer->w_max = packer->h_max = 64;
+    packer_set_size(packer, 2);
+    packer->in[0] = (struct pos){64, 40};
+    packer->in[1] = (struct pos){64, 40};
+    assert_int_equal(packer_pack(packer), -1);
+    talloc_free(packer);
+}
+
+const struct unittest test_bitmap_packer = {
+    .name = "bitmap-packer",
+    .run = run,
+};
+
+// Frames to benchmark are read from text files with one line per frame, which
+// lists the bitmap sizes as "WxH" separated by spaces (e.g. collected from
+// ASS_Image lists returned by ass_render_frame()). Without files, synthetic
+// frames are used.
+static void bench_frame(struct bitmap_packer *packer, struct pos *sizes,
+                        int num, int64_t *time, int64_t *area)
+{
+    // Start from scratch as a new packer would, like on the first frame.
+    packer->w = packer->h = 0;
+    packer_set_size(packer, num);
+    for (int n = 0; n < num; n++) {
+        packer->in[n] = sizes[n];
+        *area += sizes[n].x * (int64_t)sizes[n].y;
+    }
+    int64_t start = mp_time_us();
+    int r = packer_pack(packer);
+    *time += mp_time_us() - start;
+    assert_true(r >= 0);
+}
+
+static void bench_report(struct test_ctx *ctx, const char *name, int frames,
+                         int parts, int64_t time, int64_t area,
+                         int64_t surface)
+{
+    MP_INFO(ctx, "%s: %d frames, %d bitmaps, %.3f ms/frame, %.1f%% used\n",
+            name, frames, parts, time / 1e3 / MPMAX(frames, 1),
+            surface ? area * 100.0 / surface : 0);
+}
+
+static void run_bench(struct test_ctx *ctx)
+{
+    struct bitmap_packer *packer = talloc_zero(NULL, struct bitmap_packer);
+
+    if (!ctx->num_files) {
+        uint32_t state = 1;
+        int frames = 200, num = 3000;
+        struct pos *sizes = talloc_array(NULL, struct pos, num);
+        int64_t time = 0, area = 0, surface = 0;
+        for (int f = 0; f < frames; f++) {
+            for (int n = 0; n < num; n++)
+                sizes[n] = random_size(&state);
+            bench_frame(packer, sizes, num, &time, &area);
+            surface += packer->w * (int64_t)packer->h;
+        }
+        bench_report(ctx, "synthetic", frames, frames * num, time, area, surface);
+        talloc_free(sizes);
+    }
+
+    for (int i = 0; i < ctx->num_files; i++) {
+        FILE *f = fopen(ctx->files[i], "r");
+        if (!f) {
+            MP_ERR(ctx, "%s: could not open file.\n", ctx->files[i]);
+            continue;
+        }
+        struct pos *sizes = NULL;
+        int num = 0, frames = 0, parts = 0;
+        int64_t time = 0, area = 0, surface = 0;
+        char line[64 * 1024];
+        while (fgets(line, sizeof(line), f)) {
+            num = 0;
+            char *cur = line;
+            int w, h, len;
+            while (sscanf(cur, " %dx%d%n", &w, &h, &len) == 2) {
+                MP_TARRAY_APPEND(NULL, sizes, num, (struct pos){w, h});
+                cur += len;
+            }
+            if (!num)
+                continue;
+            bench_frame(packer, sizes, num, &time, &area);
+            surface += packer->w * (int64_t)packer->h;
+            frames++;
+            parts += num;
+        }
+        fclose(f);
+        bench_report(ctx, ctx->files[i], frames, parts, time, area, surface);
+        talloc_free(sizes);
+    }
+
+    talloc_free(packer);
+}
+
+const struct unittest test_bitmap_packer_bench = {
+    .name = "bitmap-packer-bench",
+    .is_complex = true,
+    .run = run_bench,
+};
@@ -0,0 +1,80 @@
+#include "common/common.h"
+#include "common/msg.h"
+#include "demux/demux.h"
+#include "demux/packet.h"
+#include "misc/thread_tools.h"
+#include "osdep/timer.h"
+#include "tests.h"
+
+// Read all packets of all streams as fast as possible, without decoding.
+static void bench_file(struct test_ctx *ctx, const char *url)
+{
+    struct mp_cancel *cancel = mp_cancel_new(NULL);
+    struct demuxer_params params = {0};
+
+    int64_t start = mp_time_us();
+    struct demuxer *demuxer = demux_open_url(url, &params, cancel, ctx->global);
+    if (!demuxer) {
+        MP_ERR(ctx, "%s: could not open file.\n", url);
+        talloc_free(cancel);
+        return;
+    }
+    int64_t opened = mp_time_us();
+
+    for (int n = 0; n < demux_get_num_stream(demuxer); n++) {
+        struct sh_stream *sh = demux_get_stream(demuxer, n);
+        demuxer_select_track(demuxer, sh, MP_NOPTS_VALUE, true);
+    }
+
+    struct demux_reader_state s;
+    uint64_t num_packets = 0, num_bytes = 0;
+    int64_t peak_bytes = 0;
+    struct demux_packet *pkt;
+    while ((pkt = demux_read_any_packet(demuxer))) {
+        num_packets++;
+        num_bytes += pkt->len;
+        talloc_free(pkt);
+        // (Querying the state locks the demuxer, so don't do it every time.)
+        if (num_packets % 256 == 0) {
+            demux_get_reader_state(demuxer, &s);
+            peak_bytes = MPMAX(peak_bytes, s.total_bytes);
+        }
+    }
+    int64_t end = mp_time_us();
+
+    demux_get_reader_state(demuxer, &s);
+    peak_bytes = MPMAX(peak_bytes, s.total_bytes);
+
+    double secs = MPMAX(end - opened, 1) / 1e6;
+    MP_INFO(ctx, "%s (%s):\n", url, demuxer->desc->name);
+    MP_INFO(ctx, "  open:          %.3f s\n", (opened - start) / 1e6);
+    MP_INFO(ctx, "  read:          %.3f s\n", secs);
+    MP_INFO(ctx, "  packets:       %"PRIu64" (%.0f/s)\n", num_packets,
+            num_packets / secs);
+    MP_INFO(ctx, "  data:          %.2f MiB (%.2f MiB/s)\n",
+            num_bytes / (1024.0 * 1024), num_bytes / (1024.0 * 1024) / secs);
+    MP_INFO(ctx, "  stream reads:  %.3f s\n", s.stream_read_time / 1e6);
+    MP_INFO(ctx, "  index entries: %"PRId64" (%"PRId64" bytes)\n",
+            s.index_entries, s.index_bytes);
+    MP_INFO(ctx, "  peak cache:    %"PRId64" bytes\n", peak_bytes);
+
+    demux_free(demuxer);
+    talloc_free(cancel);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    if (!ctx->num_files) {
+        MP_FATAL(ctx, "Usage: mpv --unittest=demux-bench <files...>\n");
+        abort();
+    }
+
+    for (int n = 0; n < ctx->num_files; n++)
+        bench_file(ctx, ctx->files[n]);
+}
+
+const struct unittest test_demux_bench = {
+    .name = "demux-bench",
+    .is_complex = true,
+    .run = run,
+};
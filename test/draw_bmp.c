@@ -0,0 +1,101 @@
+#include "common/common.h"
+#include "common/msg.h"
+#include "osdep/timer.h"
+#include "sub/draw_bmp.h"
+#include "tests.h"
+
+// 4K width, plus some odd pixels to hit the remainder code.
+#define W 3847
+#define H 32
+
+static void fill(uint8_t *data, size_t size, uint32_t seed)
+{
+    for (size_t n = 0; n < size; n++) {
+        seed = seed * 1664525 + 1013904223;
+        data[n] = seed >> 24;
+    }
+}
+
+// Make BGRA premultiplied, so the results are in range like with real OSD.
+static void premultiply(uint8_t *data, size_t pixels)
+{
+    for (size_t n = 0; n < pixels; n++) {
+        uint8_t *p = data + n * 4;
+        for (int c = 0; c < 3; c++)
+            p[c] = p[c] * p[3] / 255;
+    }
+}
+
+static void run(struct test_ctx *ctx)
+{
+    const struct mp_draw_sub_kernels *k[2] = {
+        mp_draw_sub_get_kernels(false),
+        mp_draw_sub_get_kernels(true),
+    };
+
+    size_t stride = W * 4;
+    uint8_t *src = talloc_size(NULL, stride * H);
+    uint8_t *mask = talloc_size(NULL, W * H);
+    uint8_t *dst[2];
+    float *dst_f[2];
+    float *src_f = talloc_array(NULL, float, W);
+    float *src_a_f = talloc_array(NULL, float, W);
+    int64_t time[2];
+
+    fill(src, stride * H, 1);
+    premultiply(src, W * H);
+    fill(mask, W * H, 2);
+    for (int x = 0; x < W; x++) {
+        src_a_f[x] = mask[x] / 255.0f;
+        src_f[x] = src_a_f[x] * (src[x] / 255.0f);
+    }
+
+    for (int n = 0; n < 2; n++) {
+        dst[n] = talloc_size(NULL, stride * H);
+        dst_f[n] = talloc_array(NULL, float, W);
+        fill(dst[n], stride * H, 3);
+        premultiply(dst[n], W * H);
+        for (int x = 0; x < W; x++)
+            dst_f[n][x] = dst[n][x] / 255.0f;
+
+        int64_t start = mp_time_us();
+        for (int i = 0; i < 10; i++) {
+            // All widths up to 40 at different offsets.
+            for (int w = 0; w < 40; w++) {
+                k[n]->draw_ass_rgba(dst[n] + w * 4, stride, mask + w, W,
+                                    w, 1, 0x12345600u | i);
+                k[n]->draw_rgba(dst[n] + w * 4, stride, src + w * 4, stride,
+                                w, 1);
+            }
+            k[n]->draw_ass_rgba(dst[n], stride, mask, W, W, H,
+                                0xFF802000u + i * 23);
+            k[n]->draw_rgba(dst[n], stride, src, stride, W, H);
+            for (int y = 0; y < H; y++) {
+                k[n]->blend_line_u8(dst[n] + y * stride, src + y * stride,
+                                    mask + y * W, W);
+            }
+            k[n]->blend_line_f32(dst_f[n], src_f, src_a_f, W);
+        }
+        time[n] = mp_time_us() - start;
+    }
+
+    assert_memcmp(dst[0], dst[1], stride * H);
+    assert_memcmp(dst_f[0], dst_f[1], W * sizeof(float));
+
+    MP_INFO(ctx, "blend %dx%d: c %6.2f ms, %s %6.2f ms\n", W, H,
+            time[0] / 1000.0, k[1]->name, time[1] / 1000.0);
+
+    for (int n = 0; n < 2; n++) {
+        talloc_free(dst[n]);
+        talloc_free(dst_f[n]);
+    }
+    talloc_free(src);
+    talloc_free(mask);
+    talloc_free(src_f);
+    talloc_free(src_a_f);
+}
+
+const struct unittest test_draw_bmp = {
+    .name = "draw_bmp",
+    .run = run,
+};
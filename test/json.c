@@ -1,6 +1,8 @@
 #include "common/common.h"
+#include "common/msg.h"
 #include "misc/json.h"
 #include "misc/node.h"
+#include "osdep/timer.h"
 #include "tests.h"
 
 struct entry {
@@ -62,10 +64,71 @@ static const struct entry entries[] = {
         NODE_MAP(L("a"), L(NODE_STR("b")))},
     { TEXT({_a12="b"}), TEXT({"_a12":"b"}),
         NODE_MAP(L("_a12"), L(NODE_STR("b")))},
+
+    // numbers which strtoll() only parses partially
+    { "[1e3,0.5,-2]", "[1000.000000,0.500000,-2]",
+        NODE_ARRAY(NODE_FLOAT(1e3), NODE_FLOAT(0.5), NODE_INT64(-2))},
+    { "-9223372036854775808", "-9223372036854775808", NODE_INT64(INT64_MIN)},
+
+    // escapes and unterminated strings
+    { TEXT("\"\\\t\u0001"), TEXT("\"\\\t\u0001"),
+        NODE_STR("\"\\\t\001")},
+    { "\"abc", .expect_fail = true},
+    { "\"abc\\", .expect_fail = true},
 };
 
 #define MAX_DEPTH 10
 
+// Something like the track-list property of a file with many tracks.
+static void benchmark(struct test_ctx *ctx)
+{
+    void *tmp = talloc_new(NULL);
+    struct mpv_node list;
+    node_init(&list, MPV_FORMAT_NODE_ARRAY, NULL);
+    for (int n = 0; n < 200; n++) {
+        struct mpv_node *t = node_array_add(&list, MPV_FORMAT_NODE_MAP);
+        node_map_add_int64(t, "id", n + 1);
+        node_map_add_string(t, "type", "sub");
+        node_map_add_string(t, "title", "Some \"quoted\" title\twith escapes");
+        node_map_add_string(t, "lang", "eng");
+        node_map_add_flag(t, "default", n == 0);
+        node_map_add_flag(t, "selected", false);
+        node_map_add_double(t, "demux-fps", 23.976);
+        node_map_add_string(t, "codec", "subrip");
+        node_map_add_string(t, "external-filename",
+                            "/some/long/path/to/a/subtitle/file.srt");
+    }
+
+    const int runs = 100;
+    char *text = NULL;
+    int64_t start = mp_time_us();
+    for (int i = 0; i < runs; i++) {
+        talloc_free(text);
+        text = talloc_strdup(tmp, "");
+        assert_true(json_write(&text, &list) >= 0);
+    }
+    int64_t write_time = mp_time_us() - start;
+
+    struct mpv_node res;
+    start = mp_time_us();
+    for (int i = 0; i < runs; i++) {
+        void *tmp2 = talloc_new(tmp);
+        char *s = talloc_strdup(tmp2, text);
+        assert_true(json_parse(tmp2, &res, &s, MAX_DEPTH) >= 0);
+        if (i == runs - 1) {
+            assert_true(equal_mpv_node(&list, &res));
+        }
+        talloc_free(tmp2);
+    }
+    int64_t parse_time = mp_time_us() - start;
+
+    MP_INFO(ctx, "%zu bytes: write %6.3f ms, parse %6.3f ms\n", strlen(text),
+            write_time / 1000.0 / runs, parse_time / 1000.0 / runs);
+
+    talloc_free(list.u.list);
+    talloc_free(tmp);
+}
+
 static void run(struct test_ctx *ctx)
 {
     for (int n = 0; n < MP_ARRAY_SIZE(entries); n++) {
@@ -92,3 +155,9 @@ const struct unittest test_json = {
     .name = "json",
     .run = run,
 };
+
+const struct unittest test_json_bench = {
+    .name = "json-bench",
+    .is_complex = true,
+    .run = benchmark,
+};
@@ -0,0 +1,125 @@
+#include "common/common.h"
+#include "misc/msgpack.h"
+#include "misc/node.h"
+#include "tests.h"
+
+struct entry {
+    const char *data;   // encoded form
+    int len;
+    struct mpv_node node;
+    bool expect_fail;
+    bool decode_only;   // not the encoding the writer produces
+};
+
+#define BIN(...) .data = (const char[]){__VA_ARGS__}, \
+                 .len = sizeof((const char[]){__VA_ARGS__})
+
+#define VAL_LIST(...) (struct mpv_node[]){__VA_ARGS__}
+
+#define L(...) __VA_ARGS__
+
+#define NODE_INT64(v) {.format = MPV_FORMAT_INT64,  .u = { .int64 = (v) }}
+#define NODE_STR(v)   {.format = MPV_FORMAT_STRING, .u = { .string = (v) }}
+#define NODE_BOOL(v)  {.format = MPV_FORMAT_FLAG,   .u = { .flag = (bool)(v) }}
+#define NODE_FLOAT(v) {.format = MPV_FORMAT_DOUBLE, .u = { .double_ = (v) }}
+#define NODE_NONE()   {.format = MPV_FORMAT_NONE }
+#define NODE_ARRAY(...) {.format = MPV_FORMAT_NODE_ARRAY, .u = { .list =    \
+    &(struct mpv_node_list) {                                               \
+        .num = sizeof(VAL_LIST(__VA_ARGS__)) / sizeof(struct mpv_node),     \
+        .values = VAL_LIST(__VA_ARGS__)}}}
+#define NODE_MAP(k, v) {.format = MPV_FORMAT_NODE_MAP, .u = { .list =       \
+    &(struct mpv_node_list) {                                               \
+        .num = sizeof(VAL_LIST(v)) / sizeof(struct mpv_node),               \
+        .values = VAL_LIST(v),                                              \
+        .keys = (char**)(const char *[]){k}}}}
+
+static const struct entry entries[] = {
+    { BIN(0xc0), NODE_NONE()},
+    { BIN(0xc3), NODE_BOOL(true)},
+    { BIN(0xc2), NODE_BOOL(false)},
+    { BIN(0x00), NODE_INT64(0)},
+    { BIN(0x7f), NODE_INT64(127)},
+    { BIN(0xff), NODE_INT64(-1)},
+    { BIN(0xe0), NODE_INT64(-32)},
+    { BIN(0xd0, 0xdf), NODE_INT64(-33)},
+    { BIN(0xd1, 0x01, 0x00), NODE_INT64(256)},
+    { BIN(0xd2, 0xff, 0xff, 0x7f, 0xff), NODE_INT64(-32769)},
+    { BIN(0xd3, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00),
+        NODE_INT64(1LL << 32)},
+    { BIN(0xcc, 0xff), NODE_INT64(255), .decode_only = true},
+    { BIN(0xcf, 0x80, 0, 0, 0, 0, 0, 0, 0), .expect_fail = true},
+    { BIN(0xcb, 0x40, 0x5e, 0xd0, 0x00, 0x00, 0x00, 0x00, 0x00),
+        NODE_FLOAT(123.25)},
+    { BIN(0xca, 0x42, 0xf6, 0x80, 0x00), NODE_FLOAT(123.25),
+        .decode_only = true},
+    { BIN(0xa3, 'a', 'b', 'c'), NODE_STR("abc")},
+    { BIN(0xd9, 0x01, 'a'), NODE_STR("a"), .decode_only = true},
+    { BIN(0xa2, 'a', 0), .expect_fail = true},
+    { BIN(0xa3, 'a', 'b'), .expect_fail = true},
+    { BIN(0x93, 0x01, 0x02, 0x03),
+        NODE_ARRAY(NODE_INT64(1), NODE_INT64(2), NODE_INT64(3))},
+    { BIN(0x90), NODE_ARRAY()},
+    { BIN(0xdc, 0x00, 0x01, 0xc0), NODE_ARRAY(NODE_NONE()),
+        .decode_only = true},
+    { BIN(0xdd, 0xff, 0xff, 0xff, 0xff), .expect_fail = true},
+    { BIN(0x82, 0xa1, 'a', 0x01, 0xa1, 'b', 0x02),
+        NODE_MAP(L("a", "b"), L(NODE_INT64(1), NODE_INT64(2)))},
+    { BIN(0x80), NODE_MAP(L(), L())},
+    { BIN(0x81, 0x01, 0x01), .expect_fail = true},
+    { BIN(0xc1), .expect_fail = true},
+    { BIN(0xd4, 0x01, 0x00), .expect_fail = true},
+};
+
+#define MAX_DEPTH 10
+
+static void run(struct test_ctx *ctx)
+{
+    for (int n = 0; n < MP_ARRAY_SIZE(entries); n++) {
+        const struct entry *e = &entries[n];
+        void *tmp = talloc_new(NULL);
+        bstr src = {(char *)e->data, e->len};
+        struct mpv_node res;
+        bool ok = msgpack_parse(tmp, &res, &src, MAX_DEPTH) >= 0;
+        assert_true(ok != e->expect_fail);
+        if (!ok) {
+            talloc_free(tmp);
+            continue;
+        }
+        assert_int_equal(src.len, 0);
+        assert_true(equal_mpv_node(&e->node, &res));
+        if (!e->decode_only) {
+            bstr d = {0};
+            assert_true(msgpack_write(tmp, &d, &res) >= 0);
+            assert_int_equal(d.len, e->len);
+            assert_memcmp(d.start, e->data, e->len);
+        }
+        talloc_free(tmp);
+    }
+
+    // Sizes that need the longer encodings.
+    void *tmp = talloc_new(NULL);
+    struct mpv_node list;
+    node_init(&list, MPV_FORMAT_NODE_ARRAY, NULL);
+    char *str = talloc_zero_size(tmp, 70000);
+    memset(str, 'x', 69999);
+    for (int n = 0; n < 70000; n++)
+        node_array_add(&list, MPV_FORMAT_INT64)->u.int64 = n - 35000;
+    node_array_add(&list, MPV_FORMAT_NONE);
+    list.u.list->values[list.u.list->num - 1] =
+        (struct mpv_node){.format = MPV_FORMAT_STRING, .u.string = str};
+    bstr d = {0};
+    assert_true(msgpack_write(tmp, &d, &list) >= 0);
+    assert_int_equal((unsigned char)d.start[0], 0xdd);
+    struct mpv_node res;
+    bstr src = d;
+    assert_true(msgpack_parse(tmp, &res, &src, MAX_DEPTH) >= 0);
+    assert_int_equal(src.len, 0);
+    assert_true(equal_mpv_node(&list, &res));
+    talloc_free(list.u.list);
+    talloc_free(tmp);
+}
+
+const struct unittest test_msgpack = {
+    .name = "msgpack",
+    .run = run,
+};
@@ -0,0 +1,339 @@
+#include <libplacebo/vulkan.h>
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "misc/json.h"
+#include "misc/node.h"
+#include "options/m_config_frontend.h"
+#include "options/m_option.h"
+#include "osdep/timer.h"
+#include "tests.h"
+#include "video/mp_image.h"
+#include "video/out/gpu/context.h"
+#include "video/out/gpu/video.h"
+#include "video/out/placebo/ra_pl.h"
+#include "video/out/placebo/utils.h"
+#include "video/out/vo.h"
+
+// Render canned frames with gl_video on an offscreen Vulkan device, using a
+// number of preset option sets, and write the GPU time of each pass to
+// test/out/render-bench.json.
+
+#define SRC_W 1920
+#define SRC_H 1080
+#define DST_W 3840
+#define DST_H 2160
+
+#define NUM_IMAGES 4 // distinct frames in the (looping) source queue
+#define WARMUP_FRAMES 20
+#define BENCH_FRAMES 200
+
+struct preset {
+    const char *name;
+    const char *opts[8];
+    bool hdr;
+    bool user_shader;
+};
+
+static const struct preset presets[] = {
+    {"default"},
+    {"fast", {"scale=bilinear", "cscale=bilinear", "dscale=bilinear",
+              "dither-depth=no", "sigmoid-upscaling=no",
+              "linear-downscaling=no", "correct-downscaling=no"}},
+    {"high-quality", {"scale=ewa_lanczossharp", "cscale=ewa_lanczossharp",
+                      "dscale=mitchell", "sigmoid-upscaling=yes",
+                      "linear-downscaling=yes", "correct-downscaling=yes"}},
+    {"interpolation", {"interpolation=yes", "tscale=oversample"}},
+    {"deband", {"deband=yes"}},
+    {"hdr", {"hdr-compute-peak=yes", "tone-mapping=bt.2390"}, .hdr = true},
+    {"user-shaders", .user_shader = true},
+};
+
+static const char user_shader[] =
+    "//!HOOK MAIN\n"
+    "//!BIND HOOKED\n"
+    "//!DESC render-bench sharpen\n"
+    "vec4 hook() {\n"
+    "    vec4 c = HOOKED_tex(HOOKED_pos);\n"
+    "    vec4 b = HOOKED_texOff(vec2(-1, 0)) + HOOKED_texOff(vec2(1, 0)) +\n"
+    "             HOOKED_texOff(vec2(0, -1)) + HOOKED_texOff(vec2(0, 1));\n"
+    "    return c + 0.5 * (c - 0.25 * b);\n"
+    "}\n";
+
+struct bench {
+    struct test_ctx *ctx;
+    struct mp_log *log;
+    pl_log pllog;
+    pl_vk_inst vkinst;
+    pl_vulkan vulkan;
+    struct ra *ra;
+    struct ra_tex *target;
+    struct mp_image *images[NUM_IMAGES];
+};
+
+static bool init_gpu(struct bench *b)
+{
+    b->log = mp_log_new(NULL, b->ctx->log, "libplacebo");
+    b->pllog = mppl_log_create(b->log);
+    if (!b->pllog)
+        return false;
+
+    b->vkinst = pl_vk_inst_create(b->pllog, &(struct pl_vk_inst_params) {0});
+    if (!b->vkinst)
+        return false;
+
+    // No surface: the device is only used for offscreen rendering.
+    b->vulkan = pl_vulkan_create(b->pllog, &(struct pl_vulkan_params) {
+        .instance = b->vkinst->instance,
+        .get_proc_addr = b->vkinst->get_proc_addr,
+        .async_transfer = true,
+        .async_compute = true,
+        .queue_count = 1,
+    });
+    if (!b->vulkan)
+        return false;
+
+    b->ra = ra_create_pl(b->vulkan->gpu, b->ctx->log);
+    if (!b->ra)
+        return false;
+
+    const struct ra_format *fmt = ra_find_unorm_format(b->ra, 1, 4);
+    if (!fmt || !fmt->renderable)
+        return false;
+
+    b->target = ra_tex_create(b->ra, &(struct ra_tex_params) {
+        .dimensions = 2,
+        .w = DST_W,
+        .h = DST_H,
+        .d = 1,
+        .format = fmt,
+        .render_dst = true,
+    });
+    return !!b->target;
+}
+
+static void uninit_gpu(struct bench *b)
+{
+    if (b->ra)
+        ra_tex_free(b->ra, &b->target);
+    ra_free(&b->ra);
+    pl_vulkan_destroy(&b->vulkan);
+    pl_vk_inst_destroy(&b->vkinst);
+    pl_log_destroy(&b->pllog);
+    TA_FREEP(&b->log);
+}
+
+// Moving gradients, so that consecutive frames differ.
+static void init_images(struct bench *b)
+{
+    for (int i = 0; i < NUM_IMAGES; i++) {
+        struct mp_image *img = mp_image_alloc(IMGFMT_420P, SRC_W, SRC_H);
+        assert(img);
+        for (int p = 0; p < img->num_planes; p++) {
+            int w = mp_image_plane_w(img, p), h = mp_image_plane_h(img, p);
+            for (int y = 0; y < h; y++) {
+                uint8_t *line = img->planes[p] + y * img->stride[p];
+                for (int x = 0; x < w; x++)
+                    line[x] = (x * (p + 1) + y + i * 16) & 0xFF;
+            }
+        }
+        b->images[i] = img;
+    }
+}
+
+static void set_image_params(struct mp_image *img, bool hdr)
+{
+    img->params.color = (struct mp_colorspace) {
+        .space = hdr ? MP_CSP_BT_2020_NC : MP_CSP_BT_709,
+        .levels = MP_CSP_LEVELS_TV,
+        .primaries = hdr ? MP_CSP_PRIM_BT_2020 : MP_CSP_PRIM_BT_709,
+        .gamma = hdr ? MP_CSP_TRC_PQ : MP_CSP_TRC_BT_1886,
+        .sig_peak = hdr ? 1000.0 / MP_REF_WHITE : 0,
+    };
+    mp_image_params_guess_csp(&img->params);
+}
+
+static void add_perf(struct mpv_node *dst, struct mp_frame_perf *perf)
+{
+    struct mpv_node *passes = node_map_add(dst, "passes", MPV_FORMAT_NODE_ARRAY);
+    for (int n = 0; n < perf->count; n++) {
+        struct mpv_node *pass = node_array_add(passes, MPV_FORMAT_NODE_MAP);
+        node_map_add_string(pass, "desc", perf->desc[n]);
+        node_map_add_int64(pass, "last_ns", perf->perf[n].last);
+        node_map_add_int64(pass, "avg_ns", perf->perf[n].avg);
+        node_map_add_int64(pass, "peak_ns", perf->perf[n].peak);
+    }
+}
+
+static bool preset_selected(struct test_ctx *ctx, const struct preset *pr)
+{
+    if (!ctx->num_files)
+        return true;
+    for (int n = 0; n < ctx->num_files; n++) {
+        if (strcmp(ctx->files[n], pr->name) == 0)
+            return true;
+    }
+    return false;
+}
+
+static void bench_preset(struct bench *b, const struct preset *pr,
+                         const char *shader_path, struct mpv_node *res)
+{
+    struct test_ctx *ctx = b->ctx;
+    void *tmp = talloc_new(NULL);
+
+    // Apply the preset, remembering the previous values.
+    char *opts[MP_ARRAY_SIZE(pr->opts) + 1] = {0};
+    for (int n = 0; n < MP_ARRAY_SIZE(pr->opts) && pr->opts[n]; n++)
+        opts[n] = talloc_strdup(tmp, pr->opts[n]);
+    if (pr->user_shader) {
+        opts[MP_ARRAY_SIZE(pr->opts)] =
+            talloc_asprintf(tmp, "glsl-shaders=%s", shader_path);
+    }
+
+    char *restore[MP_ARRAY_SIZE(opts)] = {0};
+    for (int n = 0; n < MP_ARRAY_SIZE(opts); n++) {
+        if (!opts[n])
+            continue;
+        bstr name, val;
+        bstr_split_tok(bstr0(opts[n]), "=", &name, &val);
+        struct m_config_option *co = m_config_get_co(ctx->mconfig, name);
+        assert(co);
+        char *old = m_option_print(co->opt, co->data);
+        restore[n] = talloc_asprintf(tmp, "%.*s=%s", BSTR_P(name), old ? old : "");
+        talloc_free(old);
+        int r = m_config_set_option_cli(ctx->mconfig, name, val, 0);
+        assert(r >= 0);
+    }
+
+    struct gl_video *p = gl_video_init(b->ra, ctx->log, ctx->global);
+
+    struct mp_image *imgs[NUM_IMAGES];
+    for (int i = 0; i < NUM_IMAGES; i++) {
+        imgs[i] = mp_image_new_ref(b->images[i]);
+        set_image_params(imgs[i], pr->hdr);
+    }
+    gl_video_config(p, &imgs[0]->params);
+
+    struct mp_rect src = {0, 0, SRC_W, SRC_H};
+    struct mp_rect dst = {0, 0, DST_W, DST_H};
+    struct mp_osd_res osd = {.w = DST_W, .h = DST_H, .display_par = 1};
+    gl_video_resize(p, &src, &dst, &osd);
+
+    struct ra_fbo fbo = {.tex = b->target};
+    const double vsync = 1e6 / 60, frame_duration = 1e6 / 24;
+    int64_t start = 0;
+    for (int n = 0; n < WARMUP_FRAMES + BENCH_FRAMES; n++) {
+        if (n == WARMUP_FRAMES)
+            start = mp_time_us();
+
+        // Each source frame is shown for 2 or 3 vsyncs, as with 24 fps on a
+        // 60 Hz display.
+        int64_t vsyncs = n;
+        int64_t cur = vsyncs * vsync / frame_duration;
+        struct vo_frame frame = {
+            .pts = 0,
+            .duration = frame_duration,
+            .vsync_interval = vsync,
+            .vsync_offset = vsyncs * vsync - cur * frame_duration,
+            .ideal_frame_duration = frame_duration,
+            .num_vsyncs = 1,
+            .display_synced = true,
+            .num_frames = 2,
+            .frame_id = cur + 1,
+        };
+        for (int i = 0; i < frame.num_frames; i++) {
+            struct mp_image *img = imgs[(cur + i) % NUM_IMAGES];
+            img->pts = (cur + i) * frame_duration / 1e6;
+            frame.frames[i] = img;
+        }
+        frame.current = frame.frames[0];
+        frame.repeat = n > 0 &&
+            (int64_t)((vsyncs - 1) * vsync / frame_duration) == cur;
+
+        gl_video_render_frame(p, &frame, fbo, 0);
+        pl_gpu_finish(b->vulkan->gpu);
+    }
+    double frame_us = (mp_time_us() - start) / (double)BENCH_FRAMES;
+
+    struct voctrl_performance_data perf = {0};
+    gl_video_perfdata(p, &perf);
+
+    struct mpv_node *entry = node_array_add(res, MPV_FORMAT_NODE_MAP);
+    node_map_add_string(entry, "name", pr->name);
+    node_map_add_double(entry, "wall_us_per_frame", frame_us);
+    struct mpv_node *fresh = node_map_add(entry, "fresh", MPV_FORMAT_NODE_MAP);
+    add_perf(fresh, &perf.fresh);
+    struct mpv_node *redraw = node_map_add(entry, "redraw", MPV_FORMAT_NODE_MAP);
+    add_perf(redraw, &perf.redraw);
+
+    MP_INFO(ctx, "%s: %.3f ms per frame\n", pr->name, frame_us / 1e3);
+    for (int n = 0; n < perf.fresh.count; n++) {
+        MP_INFO(ctx, "  %-40s %8.3f ms\n", perf.fresh.desc[n],
+                perf.fresh.perf[n].avg / 1e6);
+    }
+
+    gl_video_uninit(p);
+    for (int i = 0; i < NUM_IMAGES; i++)
+        talloc_free(imgs[i]);
+
+    for (int n = 0; n < MP_ARRAY_SIZE(restore); n++) {
+        if (!restore[n])
+            continue;
+        bstr name, val;
+        bstr_split_tok(bstr0(restore[n]), "=", &name, &val);
+        m_config_set_option_cli(ctx->mconfig, name, val, 0);
+    }
+    talloc_free(tmp);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    struct bench b = {.ctx = ctx};
+    if (!init_gpu(&b)) {
+        MP_FATAL(ctx, "Could not create an offscreen Vulkan device.\n");
+        abort();
+    }
+    init_images(&b);
+
+    char *shader_path = talloc_asprintf(NULL, "%s/render-bench.glsl",
+                                        ctx->out_path);
+    FILE *f = test_open_out(ctx, "render-bench.glsl");
+    fputs(user_shader, f);
+    fclose(f);
+
+    struct mpv_node root;
+    node_init(&root, MPV_FORMAT_NODE_MAP, NULL);
+    node_map_add_string(&root, "gpu_api", "vulkan");
+    node_map_add_int64(&root, "src_w", SRC_W);
+    node_map_add_int64(&root, "src_h", SRC_H);
+    node_map_add_int64(&root, "dst_w", DST_W);
+    node_map_add_int64(&root, "dst_h", DST_H);
+    node_map_add_int64(&root, "frames", BENCH_FRAMES);
+    struct mpv_node *res = node_map_add(&root, "presets", MPV_FORMAT_NODE_ARRAY);
+
+    for (int n = 0; n < MP_ARRAY_SIZE(presets); n++) {
+        if (preset_selected(ctx, &presets[n]))
+            bench_preset(&b, &presets[n], shader_path, res);
+    }
+
+    char *s = talloc_strdup(NULL, "");
+    json_write_pretty(&s, &root);
+    f = test_open_out(ctx, "render-bench.json");
+    fprintf(f, "%s\n", s);
+    fclose(f);
+    MP_INFO(ctx, "Results written to %s/render-bench.json\n", ctx->out_path);
+
+    talloc_free(s);
+    talloc_free(root.u.list);
+    talloc_free(shader_path);
+    for (int i = 0; i < NUM_IMAGES; i++)
+        talloc_free(b.images[i]);
+    uninit_gpu(&b);
+}
+
+const struct unittest test_render_bench = {
+    .name = "render-bench",
+    .is_complex = true,
+    .run = run,
+};
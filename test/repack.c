@@ -1,12 +1,15 @@
 #include <libavutil/pixfmt.h>
 
 #include "common/common.h"
+#include "common/msg.h"
+#include "osdep/timer.h"
 #include "sub/draw_bmp.h"
 #include "sub/osd.h"
 #include "tests.h"
 #include "video/fmt-conversion.h"
 #include "video/img_format.h"
 #include "video/repack.h"
+#include "video/repack_simd.h"
 #include "video/sws_utils.h"
 #include "video/zimg.h"
 
@@ -418,6 +421,87 @@ static void check_float_repack(int imgfmt, enum mp_csp csp,
     talloc_free(from_f);
 }
 
+static void fill_test_image(struct mp_image *img)
+{
+    struct mp_regular_imgfmt desc = {0};
+    mp_get_regular_imgfmt(&desc, img->imgfmt);
+    bool is_float = desc.component_type == MP_COMPONENT_TYPE_FLOAT;
+
+    for (int p = 0; p < img->num_planes; p++) {
+        int bytes = mp_image_plane_w(img, p) * img->fmt.bpp[p] / 8;
+        for (int y = 0; y < mp_image_plane_h(img, p); y++) {
+            uint8_t *line = img->planes[p] + img->stride[p] * (ptrdiff_t)y;
+            for (int x = 0; x < bytes; x++)
+                line[x] = (x * 131 + y * 17 + p * 7) & 0xFF;
+            // Keep float values in a sane range; the conversion of infinite
+            // or huge values to integers is not well-defined.
+            for (int x = 0; is_float && x < bytes / 4; x++)
+                ((float *)line)[x] = ((x * 13 + y * 7 + p) % 2048) / 1024.0f - 0.5f;
+        }
+    }
+}
+
+// Check that the optimized repackers produce the same output as the C code,
+// and print timings for both.
+static void check_simd_repack(struct test_ctx *ctx, int imgfmt, int flags)
+{
+    imgfmt = UNFUCK(imgfmt);
+
+    for (int pack = 0; pack < 2; pack++) {
+        struct mp_repack *rp[2] = {
+            mp_repack_create_planar(imgfmt, pack, flags | REPACK_CREATE_NO_SIMD),
+            mp_repack_create_planar(imgfmt, pack, flags),
+        };
+        assert(rp[0] && rp[1]);
+
+        int w = MP_ALIGN_UP(1925, mp_repack_get_align_x(rp[0]));
+        int h = MP_ALIGN_UP(256, mp_repack_get_align_y(rp[0]));
+
+        struct mp_image *src =
+            mp_image_alloc(mp_repack_get_format_src(rp[0]), w, h);
+        assert(src);
+        fill_test_image(src);
+        mp_image_params_guess_csp(&src->params);
+
+        struct mp_image *dst[2];
+        int64_t time[2];
+        for (int n = 0; n < 2; n++) {
+            dst[n] = mp_image_alloc(mp_repack_get_format_dst(rp[n]), w, h);
+            assert(dst[n]);
+            dst[n]->params.color = src->params.color;
+            assert(repack_config_buffers(rp[n], 0, dst[n], 0, src, NULL));
+
+            int64_t start = mp_time_us();
+            for (int i = 0; i < 10; i++) {
+                for (int y = 0; y < h; y += mp_repack_get_align_y(rp[n]))
+                    repack_line(rp[n], 0, y, 0, y, w);
+            }
+            time[n] = mp_time_us() - start;
+        }
+
+        for (int p = 0; p < dst[0]->num_planes; p++) {
+            int bytes = mp_image_plane_w(dst[0], p) * dst[0]->fmt.bpp[p] / 8;
+            for (int y = 0; y < mp_image_plane_h(dst[0], p); y++) {
+                assert_memcmp(dst[0]->planes[p] + dst[0]->stride[p] * (ptrdiff_t)y,
+                              dst[1]->planes[p] + dst[1]->stride[p] * (ptrdiff_t)y,
+                              bytes);
+            }
+        }
+
+        MP_INFO(ctx, "%-12s %s%s: C %6.2f ms, %s %6.2f ms\n",
+                mp_imgfmt_to_name(imgfmt), pack ? "pack  " : "unpack",
+                flags & REPACK_CREATE_PLANAR_F32 ? " (f32)" : "      ",
+                time[0] / 1000.0, repack_get_simd_fns()->name,
+                time[1] / 1000.0);
+
+        talloc_free(src);
+        for (int n = 0; n < 2; n++) {
+            talloc_free(dst[n]);
+            talloc_free(rp[n]);
+        }
+    }
+}
+
 static bool try_draw_bmp(struct mpv_global *g, FILE *f, int imgfmt)
 {
     bool ok = false;
@@ -496,6 +580,13 @@ static void run(struct test_ctx *ctx)
     check_float_repack(-AV_PIX_FMT_YUVA444P16, MP_CSP_BT_709, MP_CSP_LEVELS_PC);
     check_float_repack(-AV_PIX_FMT_YUVA444P16, MP_CSP_BT_709, MP_CSP_LEVELS_TV);
 
+    check_simd_repack(ctx, IMGFMT_NV12, 0);
+    check_simd_repack(ctx, IMGFMT_P010, 0);
+    check_simd_repack(ctx, IMGFMT_RGB24, 0);
+    check_simd_repack(ctx, IMGFMT_BGRA, 0);
+    check_simd_repack(ctx, -AV_PIX_FMT_YUVA444P16, REPACK_CREATE_PLANAR_F32);
+    check_simd_repack(ctx, IMGFMT_P010, REPACK_CREATE_PLANAR_F32);
+
     // Determine the list of possible draw_bmp input formats. Do this here
     // because it mostly depends on repack and imgformat stuff.
     f = test_open_out(ctx, "draw_bmp.txt");
@@ -0,0 +1,273 @@
+// Measure the speed of the software image conversion paths (repack, libswscale
+// and zimg) for all formats. Results are written to test/out/scale-bench.txt.
+// If a previous result file is passed as argument, it is used as baseline,
+// and conversions which got slower are reported.
+
+#include <libavutil/pixfmt.h>
+
+#include "config.h"
+
+#include "common/common.h"
+#include "common/msg.h"
+#include "osdep/timer.h"
+#include "tests.h"
+#include "video/fmt-conversion.h"
+#include "video/img_format.h"
+#include "video/mp_image.h"
+#include "video/repack.h"
+#include "video/sws_utils.h"
+#if HAVE_ZIMG
+#include "video/zimg.h"
+#endif
+
+#define W 1920
+#define H 1080
+
+// Each conversion is repeated until it took at least this long (in us).
+#define MIN_TIME 20000
+#define MIN_RUNS 3
+
+// Baseline entries which are this much faster are reported as regressions.
+#define REGRESSION_FACTOR 1.1
+
+struct result {
+    char *key;  // "<backend> <src> <dst>"
+    double mpix;
+};
+
+struct bench {
+    struct test_ctx *ctx;
+    FILE *out;
+    struct result *baseline;
+    int num_baseline;
+    int num_results, num_regressions;
+    struct mp_sws_context *sws;
+#if HAVE_ZIMG
+    struct mp_zimg_context *zimg;
+#endif
+};
+
+typedef bool (*convert_fn)(struct bench *b, struct mp_image *dst,
+                           struct mp_image *src);
+
+static void load_baseline(struct bench *b, const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        MP_FATAL(b->ctx, "%s: could not open file.\n", path);
+        abort();
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char backend[32], src[64], dst[64];
+        double mpix;
+        if (sscanf(line, "%31s %63s %63s %lf", backend, src, dst, &mpix) != 4)
+            continue;
+        struct result r = {
+            .key = talloc_asprintf(b, "%s %s %s", backend, src, dst),
+            .mpix = mpix,
+        };
+        MP_TARRAY_APPEND(b, b->baseline, b->num_baseline, r);
+    }
+    fclose(f);
+}
+
+static void report(struct bench *b, const char *backend, int imgfmt_src,
+                   int imgfmt_dst, double mpix)
+{
+    char *key = talloc_asprintf(NULL, "%s %s %s", backend,
+                                mp_imgfmt_to_name(imgfmt_src),
+                                mp_imgfmt_to_name(imgfmt_dst));
+    fprintf(b->out, "%s %.2f\n", key, mpix);
+    b->num_results++;
+
+    for (int n = 0; n < b->num_baseline; n++) {
+        struct result *r = &b->baseline[n];
+        if (strcmp(r->key, key) == 0) {
+            if (r->mpix > mpix * REGRESSION_FACTOR) {
+                MP_WARN(b->ctx, "%-40s %8.2f MPix/s (baseline %.2f, %+.0f%%)\n",
+                        key, mpix, r->mpix, (mpix / r->mpix - 1) * 100);
+                b->num_regressions++;
+            }
+            break;
+        }
+    }
+
+    MP_VERBOSE(b->ctx, "%-40s %8.2f MPix/s\n", key, mpix);
+    talloc_free(key);
+}
+
+static void fill_image(struct mp_image *img)
+{
+    for (int p = 0; p < img->num_planes; p++) {
+        int bytes = mp_image_plane_w(img, p) * img->fmt.bpp[p] / 8;
+        for (int y = 0; y < mp_image_plane_h(img, p); y++) {
+            uint8_t *line = img->planes[p] + img->stride[p] * (ptrdiff_t)y;
+            for (int x = 0; x < bytes; x++)
+                line[x] = (x * 131 + y * 17 + p * 7) & 0xFF;
+        }
+    }
+}
+
+// Run fn until MIN_TIME is reached, and return the MPix/s (or -1 on failure).
+static double time_convert(struct bench *b, convert_fn fn, int imgfmt_dst,
+                           int imgfmt_src)
+{
+    double res = -1;
+    struct mp_image *src = mp_image_alloc(imgfmt_src, W, H);
+    struct mp_image *dst = mp_image_alloc(imgfmt_dst, W, H);
+    if (!src || !dst)
+        goto done;
+    fill_image(src);
+    mp_image_params_guess_csp(&src->params);
+    mp_image_params_guess_csp(&dst->params);
+
+    // The first run may include setup costs, which are not measured.
+    if (!fn(b, dst, src))
+        goto done;
+
+    int runs = 0;
+    int64_t start = mp_time_us(), now = start;
+    while (runs < MIN_RUNS || now - start < MIN_TIME) {
+        if (!fn(b, dst, src))
+            goto done;
+        runs++;
+        now = mp_time_us();
+    }
+    res = (double)W * H * runs / MPMAX(now - start, 1);
+
+done:
+    talloc_free(src);
+    talloc_free(dst);
+    return res;
+}
+
+static bool convert_sws(struct bench *b, struct mp_image *dst,
+                        struct mp_image *src)
+{
+    return mp_sws_scale(b->sws, dst, src) >= 0;
+}
+
+#if HAVE_ZIMG
+static bool convert_zimg(struct bench *b, struct mp_image *dst,
+                         struct mp_image *src)
+{
+    return mp_zimg_convert(b->zimg, dst, src);
+}
+#endif
+
+// The repacker converts between a format and its planar equivalent, line by
+// line, without any colorspace conversion.
+static void bench_repack(struct bench *b, int imgfmt)
+{
+    for (int pack = 0; pack < 2; pack++) {
+        struct mp_repack *rp = mp_repack_create_planar(imgfmt, pack, 0);
+        if (!rp)
+            continue;
+
+        int w = MP_ALIGN_UP(W, mp_repack_get_align_x(rp));
+        int h = MP_ALIGN_UP(H, mp_repack_get_align_y(rp));
+        int fmt_src = mp_repack_get_format_src(rp);
+        int fmt_dst = mp_repack_get_format_dst(rp);
+        struct mp_image *src = mp_image_alloc(fmt_src, w, h);
+        struct mp_image *dst = mp_image_alloc(fmt_dst, w, h);
+        if (src && dst) {
+            fill_image(src);
+            mp_image_params_guess_csp(&src->params);
+            dst->params.color = src->params.color;
+        }
+        if (src && dst && repack_config_buffers(rp, 0, dst, 0, src, NULL)) {
+            int runs = 0;
+            int64_t start = mp_time_us(), now = start;
+            while (runs < MIN_RUNS || now - start < MIN_TIME) {
+                for (int y = 0; y < h; y += mp_repack_get_align_y(rp))
+                    repack_line(rp, 0, y, 0, y, w);
+                runs++;
+                now = mp_time_us();
+            }
+            double mpix = (double)w * h * runs / MPMAX(now - start, 1);
+            report(b, "repack", fmt_src, fmt_dst, mpix);
+        }
+
+        talloc_free(src);
+        talloc_free(dst);
+        talloc_free(rp);
+    }
+}
+
+static void bench_pair(struct bench *b, const char *backend, convert_fn fn,
+                       int imgfmt_dst, int imgfmt_src)
+{
+    double mpix = time_convert(b, fn, imgfmt_dst, imgfmt_src);
+    if (mpix >= 0)
+        report(b, backend, imgfmt_src, imgfmt_dst, mpix);
+}
+
+// Convert each format from and to a planar reference format with the same
+// color model (so no colorspace conversion is involved, unless the scaler
+// insists on it).
+static void bench_format(struct bench *b, int imgfmt)
+{
+    struct mp_imgfmt_desc desc = mp_imgfmt_get_desc(imgfmt);
+    if (desc.flags & MP_IMGFLAG_HWACCEL)
+        return;
+
+    bool rgb = desc.flags & MP_IMGFLAG_RGB;
+    int ref = rgb ? pixfmt2imgfmt(AV_PIX_FMT_GBRP) : IMGFMT_444P;
+
+    if (imgfmt != ref) {
+        if (mp_sws_supports_formats(b->sws, imgfmt, ref))
+            bench_pair(b, "sws", convert_sws, imgfmt, ref);
+        if (mp_sws_supports_formats(b->sws, ref, imgfmt))
+            bench_pair(b, "sws", convert_sws, ref, imgfmt);
+#if HAVE_ZIMG
+        if (mp_zimg_supports_in_format(ref) && mp_zimg_supports_out_format(imgfmt))
+            bench_pair(b, "zimg", convert_zimg, imgfmt, ref);
+        if (mp_zimg_supports_in_format(imgfmt) && mp_zimg_supports_out_format(ref))
+            bench_pair(b, "zimg", convert_zimg, ref, imgfmt);
+#endif
+    }
+
+    bench_repack(b, imgfmt);
+}
+
+static void run(struct test_ctx *ctx)
+{
+    struct bench *b = talloc_zero(NULL, struct bench);
+    b->ctx = ctx;
+    b->sws = mp_sws_alloc(b);
+#if HAVE_ZIMG
+    b->zimg = mp_zimg_alloc();
+    talloc_steal(b, b->zimg);
+#endif
+
+    if (ctx->num_files > 1) {
+        MP_FATAL(ctx, "Usage: mpv --unittest=scale-bench [baseline]\n");
+        abort();
+    }
+    if (ctx->num_files)
+        load_baseline(b, ctx->files[0]);
+
+    b->out = test_open_out(ctx, "scale-bench.txt");
+
+    init_imgfmts_list();
+    for (int n = 0; n < num_imgfmts; n++)
+        bench_format(b, imgfmts[n]);
+
+    fclose(b->out);
+
+    MP_INFO(ctx, "%d conversions measured, results written to "
+            "%s/scale-bench.txt.\n", b->num_results, ctx->out_path);
+    if (b->num_baseline) {
+        MP_INFO(ctx, "%d conversions slower than the baseline.\n",
+                b->num_regressions);
+    }
+
+    talloc_free(b);
+}
+
+const struct unittest test_scale_bench = {
+    .name = "scale-bench",
+    .is_complex = true,
+    .run = run,
+};
@@ -21,6 +21,66 @@ static const struct scale_test_fns fns = {
     .supports_fmts = supports_fmts,
 };
 
+static void fill_pattern(struct mp_image *img)
+{
+    for (int p = 0; p < img->num_planes; p++) {
+        int bytes = mp_image_plane_w(img, p) * img->fmt.bpp[p] / 8;
+        for (int y = 0; y < mp_image_plane_h(img, p); y++) {
+            uint8_t *line = img->planes[p] + img->stride[p] * (ptrdiff_t)y;
+            for (int x = 0; x < bytes; x++)
+                line[x] = (x * 3 + y * 7 + p * 51) & 0xFF;
+        }
+    }
+}
+
+static void assert_images_equal(struct mp_image *a, struct mp_image *b)
+{
+    for (int p = 0; p < a->num_planes; p++) {
+        int bytes = mp_image_plane_w(a, p) * a->fmt.bpp[p] / 8;
+        for (int y = 0; y < mp_image_plane_h(a, p); y++) {
+            assert_memcmp(a->planes[p] + a->stride[p] * (ptrdiff_t)y,
+                          b->planes[p] + b->stride[p] * (ptrdiff_t)y, bytes);
+        }
+    }
+}
+
+// Switch back and forth between 2 conversions (which reuses cached graphs),
+// and check that the async API produces the same output as the sync one.
+static void test_cache_async(void)
+{
+    struct mp_zimg_context *zimg = mp_zimg_alloc();
+    zimg->opts.threads = 2;
+
+    struct mp_image *src = mp_image_alloc(IMGFMT_420P, 320, 256);
+    assert_true(src);
+    fill_pattern(src);
+
+    int fmts[2][3] = {{IMGFMT_RGBA, 320, 256}, {IMGFMT_444P, 160, 128}};
+    struct mp_image *ref[2], *out[2];
+    for (int n = 0; n < 2; n++) {
+        ref[n] = mp_image_alloc(fmts[n][0], fmts[n][1], fmts[n][2]);
+        out[n] = mp_image_alloc(fmts[n][0], fmts[n][1], fmts[n][2]);
+        assert_true(ref[n] && out[n]);
+        assert_true(mp_zimg_convert(zimg, ref[n], src));
+    }
+
+    for (int i = 0; i < 4; i++) {
+        int n = i % 2;
+        assert_true(mp_zimg_convert_async(zimg, out[n], src));
+        mp_zimg_convert_wait(zimg);
+        assert_images_equal(ref[n], out[n]);
+    }
+
+    assert_int_equal(zimg->num_graphs, 1);
+
+    for (int n = 0; n < 2; n++) {
+        talloc_free(ref[n]);
+        talloc_free(out[n]);
+    }
+    talloc_free(src);
+    talloc_free(zimg);
+}
+
 static void run(struct test_ctx *ctx)
 {
     struct mp_zimg_context *zimg = mp_zimg_alloc();
@@ -52,6 +112,8 @@ static void run(struct test_ctx *ctx)
 
     talloc_free(stest);
     talloc_free(zimg);
+
+    test_cache_async();
 }
 
 const struct unittest test_repack_zimg = {
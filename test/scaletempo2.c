@@ -0,0 +1,122 @@
+#include "audio/filter/af_scaletempo2_internals.h"
+#include "osdep/timer.h"
+#include "tests.h"
+
+#define CHANNELS 8
+#define RATE 48000
+#define CHUNK 1024
+
+static float **make_input(int frames)
+{
+    float **in = talloc_array(NULL, float *, CHANNELS);
+    uint32_t seed = 1;
+    for (int c = 0; c < CHANNELS; c++) {
+        in[c] = talloc_array(in, float, frames);
+        for (int n = 0; n < frames; n++) {
+            seed = seed * 1664525 + 1013904223;
+            float noise = (seed >> 8) / (float)(1 << 24) - 0.5f;
+            in[c][n] = 0.5f * sinf(n * (c + 1) * 0.01f) + 0.1f * noise;
+        }
+    }
+    return in;
+}
+
+// Run the whole WSOLA loop with the given kernel, and return the output
+// (interleaved per hop) as talloc'ed array.
+static float *process(float **in, int frames, float speed,
+                      mp_scaletempo2_dot_fn dot, int *out_frames,
+                      int64_t *time)
+{
+    struct mp_scaletempo2_opts opts = {
+        .min_playback_rate = 0.25,
+        .max_playback_rate = 4.0,
+        .ola_window_size_ms = 20,
+        .wsola_search_interval_ms = 30,
+    };
+    struct mp_scaletempo2 st = {.opts = &opts};
+    mp_scaletempo2_init(&st, CHANNELS, RATE);
+    st.dot_product = dot;
+
+    float *out = NULL;
+    int num_out = 0;
+    float *hop[CHANNELS];
+    for (int c = 0; c < CHANNELS; c++)
+        hop[c] = talloc_array(NULL, float, st.ola_hop_size);
+
+    int64_t start = mp_time_us();
+    int pos = 0;
+    while (pos + CHUNK <= frames) {
+        uint8_t *planes[CHANNELS];
+        for (int c = 0; c < CHANNELS; c++)
+            planes[c] = (uint8_t *)(in[c] + pos);
+        int read = mp_scaletempo2_fill_input_buffer(&st, planes, CHUNK, false);
+        pos += read;
+
+        int got = 0;
+        while (mp_scaletempo2_frames_available(&st)) {
+            got = mp_scaletempo2_fill_buffer(&st, hop, st.ola_hop_size, speed);
+            if (!got)
+                break;
+            MP_TARRAY_GROW(NULL, out, num_out + got * CHANNELS);
+            for (int c = 0; c < CHANNELS; c++) {
+                memcpy(out + num_out, hop[c], got * sizeof(float));
+                num_out += got;
+            }
+        }
+        if (!read && !got)
+            break;
+    }
+    *time = mp_time_us() - start;
+
+    for (int c = 0; c < CHANNELS; c++)
+        talloc_free(hop[c]);
+    mp_scaletempo2_destroy(&st);
+    *out_frames = num_out;
+    return out;
+}
+
+static void run(struct test_ctx *ctx)
+{
+    const char *name;
+    mp_scaletempo2_dot_fn fns[2] = {
+        mp_scaletempo2_get_dot_product(false, NULL),
+        mp_scaletempo2_get_dot_product(true, &name),
+    };
+
+    // The kernels themselves, for all remainder lengths and misalignments.
+    float **in = make_input(RATE * 5);
+    for (int len = 0; len < 300; len++) {
+        for (int offset = 0; offset < 8; offset++) {
+            float a = fns[0](in[0] + offset, in[1], len);
+            float b = fns[1](in[0] + offset, in[1], len);
+            assert_memcmp(&a, &b, sizeof(a));
+        }
+    }
+
+    // Entire filter at various speeds.
+    float speeds[] = {0.5, 1.5, 4.0};
+    for (int i = 0; i < MP_ARRAY_SIZE(speeds); i++) {
+        float *out[2];
+        int num_out[2];
+        int64_t time[2];
+        for (int n = 0; n < 2; n++) {
+            out[n] = process(in, RATE * 5, speeds[i], fns[n], &num_out[n],
+                             &time[n]);
+        }
+        assert_int_equal(num_out[0], num_out[1]);
+        assert_memcmp(out[0], out[1], num_out[0] * sizeof(float));
+
+        MP_INFO(ctx, "speed %.1f: c %6.2f ms, %s %6.2f ms\n", speeds[i],
+                time[0] / 1000.0, name, time[1] / 1000.0);
+
+        talloc_free(out[0]);
+        talloc_free(out[1]);
+    }
+
+    talloc_free(in);
+}
+
+const struct unittest test_scaletempo2 = {
+    .name = "scaletempo2",
+    .run = run,
+};
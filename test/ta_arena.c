@@ -0,0 +1,59 @@
+#include "common/common.h"
+#include "tests.h"
+
+static int destructor_calls;
+
+static void destructor(void *p)
+{
+    destructor_calls++;
+}
+
+static void run(struct test_ctx *ctx)
+{
+    void *arena = talloc_new_arena(NULL);
+    void *other = talloc_new(NULL);
+    assert_int_equal(talloc_get_size(arena), 0);
+
+    // Blocks outlive the arena if they're moved elsewhere.
+    char *kept = NULL;
+    for (int n = 0; n < 10000; n++) {
+        char *s = talloc_asprintf(arena, "item %d", n);
+        if (n == 5000)
+            kept = talloc_steal(other, s);
+    }
+
+    // Growing a block moves it out of the chunk.
+    int *arr = talloc_zero_array(arena, int, 1);
+    for (int n = 0; n < 10000; n++) {
+        arr = talloc_realloc(arena, arr, int, n + 1);
+        arr[n] = n;
+    }
+    for (int n = 0; n < 10000; n++)
+        assert_int_equal(arr[n], n);
+    assert_int_equal(talloc_get_size(arr), 10000 * sizeof(int));
+
+    void *sub = talloc_new(arena);
+    talloc_set_destructor(sub, destructor);
+    talloc_strdup(sub, "nested");
+
+    char *big = talloc_zero_size(arena, 1 << 20);
+    assert_int_equal(big[(1 << 20) - 1], 0);
+
+    // Freeing everything allocated from a chunk lets the arena reuse it.
+    for (int n = 0; n < 1000; n++) {
+        talloc_free_children(arena);
+        for (int i = 0; i < 10; i++)
+            assert_string_equal(talloc_strdup(arena, "abc"), "abc");
+    }
+    assert_int_equal(destructor_calls, 1);
+
+    talloc_free(arena);
+
+    assert_string_equal(kept, "item 5000");
+    talloc_free(other);
+}
+
+const struct unittest test_ta_arena = {
+    .name = "ta_arena",
+    .run = run,
+};
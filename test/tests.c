@@ -1,19 +1,33 @@
+#include "common/playlist.h"
 #include "options/path.h"
 #include "osdep/subprocess.h"
 #include "player/core.h"
 #include "tests.h"
 
 static const struct unittest *unittests[] = {
+    &test_ao_convert,
+    &test_bitmap_packer,
+    &test_bitmap_packer_bench,
     &test_chmap,
+    &test_demux_bench,
+    &test_draw_bmp,
     &test_gl_video,
     &test_img_format,
     &test_json,
+    &test_json_bench,
     &test_linked_list,
+    &test_msgpack,
     &test_paths,
     &test_repack_sws,
+    &test_scale_bench,
+    &test_scaletempo2,
+    &test_ta_arena,
 #if HAVE_ZIMG
     &test_repack, // zimg only due to cross-checking with zimg.c
     &test_repack_zimg,
+#endif
+#if HAVE_VULKAN
+    &test_render_bench,
 #endif
     NULL
 };
@@ -36,8 +50,15 @@ bool run_tests(struct MPContext *mpctx)
         .log = mpctx->log,
         .ref_path = "test/ref",
         .out_path = "test/out",
+        .mconfig = mpctx->mconfig,
     };
 
+    struct playlist *pl = mpctx->playlist;
+    for (int n = 0; n < pl->num_entries; n++) {
+        MP_TARRAY_APPEND(mpctx, ctx.files, ctx.num_files,
+                         pl->entries[n]->filename);
+    }
+
     if (!mp_path_isdir(ctx.ref_path)) {
         MP_FATAL(mpctx, "Must be run from git repo root dir.\n");
         abort();
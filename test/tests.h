@@ -7,6 +7,7 @@
 #include "common/common.h"
 
 struct MPContext;
+struct m_config;
 
 bool run_tests(struct MPContext *mpctx);
 
@@ -19,6 +20,13 @@ struct test_ctx {
 
     // Path for result files, without trailing "/".
     const char *out_path;
+
+    // Files passed on the command line (for complex tests).
+    char **files;
+    int num_files;
+
+    // For tests which need to change options.
+    struct m_config *mconfig;
 };
 
 struct unittest {
@@ -36,15 +44,26 @@ struct unittest {
     void (*run)(struct test_ctx *ctx);
 };
 
+extern const struct unittest test_ao_convert;
+extern const struct unittest test_bitmap_packer;
+extern const struct unittest test_bitmap_packer_bench;
 extern const struct unittest test_chmap;
+extern const struct unittest test_demux_bench;
+extern const struct unittest test_draw_bmp;
 extern const struct unittest test_gl_video;
 extern const struct unittest test_img_format;
 extern const struct unittest test_json;
+extern const struct unittest test_json_bench;
 extern const struct unittest test_linked_list;
+extern const struct unittest test_msgpack;
 extern const struct unittest test_repack_sws;
 extern const struct unittest test_repack_zimg;
 extern const struct unittest test_repack;
 extern const struct unittest test_paths;
+extern const struct unittest test_render_bench;
+extern const struct unittest test_scale_bench;
+extern const struct unittest test_scaletempo2;
+extern const struct unittest test_ta_arena;
 
 #define assert_true(x) assert(x)
 #define assert_false(x) assert(!(x))
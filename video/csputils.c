@@ -858,6 +858,33 @@ void mp_get_csp_matrix(struct mp_csp_params *params, struct mp_cmat *m)
     }
 }
 
+bool mp_csp_params_equal(const struct mp_csp_params *a,
+                         const struct mp_csp_params *b)
+{
+    return mp_colorspace_equal(a->color, b->color) &&
+           a->levels_out == b->levels_out &&
+           a->brightness == b->brightness &&
+           a->contrast == b->contrast &&
+           a->hue == b->hue &&
+           a->saturation == b->saturation &&
+           a->gamma == b->gamma &&
+           a->gray == b->gray &&
+           a->is_float == b->is_float &&
+           a->texture_bits == b->texture_bits &&
+           a->input_bits == b->input_bits;
+}
+
+void mp_get_csp_matrix_cached(struct mp_csp_matrix_cache *cache,
+                              struct mp_csp_params *params, struct mp_cmat *out)
+{
+    if (!cache->valid || !mp_csp_params_equal(&cache->params, params)) {
+        mp_get_csp_matrix(params, &cache->m);
+        cache->params = *params;
+        cache->valid = true;
+    }
+    *out = cache->m;
+}
+
 // Set colorspace related fields in p from f. Don't touch other fields.
 void mp_csp_set_image_params(struct mp_csp_params *params,
                              const struct mp_image_params *imgparams)
@@ -295,6 +295,19 @@ void mp_get_csp_uint_mul(enum mp_csp csp, enum mp_csp_levels levels,
                          int bits, int component, double *out_m, double *out_o);
 void mp_get_csp_matrix(struct mp_csp_params *params, struct mp_cmat *out);
 
+// Remembers the result of the last mp_get_csp_matrix() call, for callers that
+// need the same matrix on every frame. Zero-initialize before first use.
+struct mp_csp_matrix_cache {
+    bool valid;
+    struct mp_csp_params params;
+    struct mp_cmat m;
+};
+
+bool mp_csp_params_equal(const struct mp_csp_params *a,
+                         const struct mp_csp_params *b);
+void mp_get_csp_matrix_cached(struct mp_csp_matrix_cache *cache,
+                              struct mp_csp_params *params, struct mp_cmat *out);
+
 void mp_invert_matrix3x3(float m[3][3]);
 void mp_invert_cmat(struct mp_cmat *out, struct mp_cmat *in);
 void mp_map_fixp_color(struct mp_cmat *matrix, int ibits, int in[3],
@@ -34,9 +34,12 @@
 #include "mpv_talloc.h"
 #include "common/global.h"
 #include "common/msg.h"
+#include "common/stats.h"
 #include "options/m_config.h"
 #include "options/options.h"
 #include "misc/bstr.h"
+#include "osdep/threads.h"
+#include "osdep/timer.h"
 #include "common/av_common.h"
 #include "common/codecs.h"
 
@@ -59,6 +62,9 @@
 
 static void init_avctx(struct mp_filter *vd);
 static void uninit_avctx(struct mp_filter *vd);
+static bool par_init(struct mp_filter *vd, const AVCodec *codec);
+static void par_flush(struct mp_filter *vd);
+static void par_destroy(struct mp_filter *vd);
 
 static int get_buffer2_direct(AVCodecContext *avctx, AVFrame *pic, int flags);
 static enum AVPixelFormat get_format_hwdec(struct AVCodecContext *avctx,
@@ -78,7 +84,9 @@ struct vd_lavc_params {
     int skip_idct;
     int skip_frame;
     int framedrop;
+    int adaptive_drop;
     int threads;
+    int intra_parallel;
     int bitexact;
     int old_x264;
     int check_hw_profile;
@@ -89,6 +97,7 @@ struct vd_lavc_params {
     char *hwdec_codecs;
     int hwdec_image_format;
     int hwdec_extra_frames;
+    int hwdec_warm_pool;
 };
 
 static const struct m_opt_choice_alternatives discard_names[] = {
@@ -112,7 +121,9 @@ const struct m_sub_options vd_lavc_conf = {
         {"vd-lavc-skipidct", OPT_DISCARD(skip_idct)},
         {"vd-lavc-skipframe", OPT_DISCARD(skip_frame)},
         {"vd-lavc-framedrop", OPT_DISCARD(framedrop)},
+        {"vd-lavc-adaptive-drop", OPT_FLAG(adaptive_drop)},
         {"vd-lavc-threads", OPT_INT(threads), M_RANGE(0, DBL_MAX)},
+        {"vd-lavc-intra-parallel", OPT_INT(intra_parallel), M_RANGE(0, 64)},
         {"vd-lavc-bitexact", OPT_FLAG(bitexact)},
         {"vd-lavc-assume-old-x264", OPT_FLAG(old_x264)},
         {"vd-lavc-check-hw-profile", OPT_FLAG(check_hw_profile)},
@@ -126,6 +137,7 @@ const struct m_sub_options vd_lavc_conf = {
         {"hwdec-codecs", OPT_STRING(hwdec_codecs)},
         {"hwdec-image-format", OPT_IMAGEFORMAT(hwdec_image_format)},
         {"hwdec-extra-frames", OPT_INT(hwdec_extra_frames), M_RANGE(0, 256)},
+        {"hwdec-warm-pool", OPT_INT(hwdec_warm_pool), M_RANGE(0, 16)},
         {0}
     },
     .size = sizeof(struct vd_lavc_params),
@@ -165,6 +177,40 @@ struct hwdec_info {
     int rank;
 };
 
+// --vd-lavc-adaptive-drop state
+struct drop_policy {
+    int64_t busy;           // time spent in libavcodec since last frame (us)
+    double last_pts;
+    double budget;          // time between output frames
+    double cost;            // average decode time per output frame
+    double type_cost[4];    // same, indexed by pict_type (0 = unknown)
+    int level;              // DROP_LEVEL_*
+    int over, under;        // consecutive frames over/well below budget
+};
+
+enum {
+    PAR_IDLE,
+    PAR_QUEUED,     // packet set, or being decoded
+    PAR_DONE,       // result set
+};
+
+// --vd-lavc-intra-parallel: an independent decoder with its own thread.
+struct par_instance {
+    struct mp_filter *vd;
+    AVCodecContext *avctx;
+    AVFrame *pic;
+    pthread_t thread;
+    bool thread_valid;
+
+    // --- The following fields are protected by lavc_ctx.par_lock.
+    int state;                  // PAR_*
+    bool terminate;
+    struct demux_packet *pkt;   // packet to decode (cleared when started)
+    enum AVDiscard skip_frame;
+    struct mp_image *res;       // decoded frame (can be NULL)
+    int err;                    // libavcodec error code
+};
+
 typedef struct lavc_ctx {
     struct mp_log *log;
     struct m_config_cache *opts_cache;
@@ -184,6 +230,10 @@ typedef struct lavc_ctx {
 
     bool intra_only;
     int framedrop_flags;
+    double skip_pts;    // VDCTRL_SET_SKIP_PTS
+    enum AVDiscard skip_loop_filter;
+
+    struct drop_policy drop;
 
     bool hw_probing;
     struct demux_packet **sent_packets;
@@ -196,6 +246,16 @@ typedef struct lavc_ctx {
     int num_delay_queue;
     int max_delay_queue;
 
+    // --vd-lavc-intra-parallel: packets are fed to the instances round-robin,
+    // and the frames are read back in the same order. avctx is not used for
+    // decoding then.
+    struct par_instance *par;
+    int num_par;
+    int par_in, par_out;        // next instance to feed / to read from
+    bool par_eof;               // EOF packet received, not returned yet
+    pthread_mutex_t par_lock;
+    pthread_cond_t par_wakeup;
+
     // From VO
     struct vo *vo;
     struct mp_hwdec_devices *hwdec_devs;
@@ -224,6 +284,24 @@ enum {
     HWDEC_FLAG_WHITELIST    = (1 << 1), // whitelist for auto-safe
 };
 
+// Levels of --vd-lavc-adaptive-drop. Each level includes the previous ones.
+enum {
+    DROP_LEVEL_NONE,
+    DROP_LEVEL_LOOPFILTER_NONREF,   // skip_loop_filter=nonref
+    DROP_LEVEL_FRAME_NONREF,        // skip_frame=nonref
+    DROP_LEVEL_LOOPFILTER_ALL,      // skip_loop_filter=all
+    DROP_LEVEL_COUNT
+};
+
+static const char *const drop_level_names[DROP_LEVEL_COUNT] = {
+    "none", "loopfilter-nonref", "frame-nonref", "loopfilter-all",
+};
+
+#define DROP_COST_WEIGHT 0.1    // weight of the newest frame in cost averages
+#define DROP_RAISE_FRAMES 8     // frames over budget before raising the level
+#define DROP_LOWER_FRAMES 60    // frames well below budget before lowering it
+#define DROP_LOWER_RATIO 0.6
+
 struct autoprobe_info {
     const char *method_name;
     unsigned int flags;         // HWDEC_FLAG_*
@@ -422,6 +500,12 @@ static AVBufferRef *hwdec_create_dev(struct mp_filter *vd,
     assert(hwdec->lavc_device);
 
     if (hwdec->copying) {
+        AVBufferRef *ref = hwdec_warm_pool_get_device(vd->global,
+                                                      hwdec->lavc_device);
+        if (ref) {
+            MP_VERBOSE(vd, "Reusing cached device.\n");
+            return ref;
+        }
         const struct hwcontext_fns *fns =
             hwdec_get_hwcontext_fns(hwdec->lavc_device);
         if (fns && fns->create_dev) {
@@ -595,12 +679,16 @@ static void reinit(struct mp_filter *vd)
 
     uninit_avctx(vd);
 
+    stats_startup_begin(vd->global, "decoder-init");
+    stats_startup_begin(vd->global, "hwdec-select");
     select_and_set_hwdec(vd);
+    stats_startup_end(vd->global, "hwdec-select");
 
     bool use_hwdec = ctx->use_hwdec;
     init_avctx(vd);
     if (!ctx->avctx && use_hwdec)
         force_fallback(vd);
+    stats_startup_end(vd->global, "decoder-init");
 }
 
 static void init_avctx(struct mp_filter *vd)
@@ -611,6 +699,11 @@ static void init_avctx(struct mp_filter *vd)
 
     m_config_cache_update(ctx->opts_cache);
 
+    struct mp_vo_opts *vo_opts = mp_get_config_group(NULL, vd->global,
+                                                     &vo_sub_opts);
+    bool low_latency = vo_opts->latency_mode;
+    talloc_free(vo_opts);
+
     assert(!ctx->avctx);
 
     const AVCodec *lavc_codec = NULL;
@@ -626,6 +719,11 @@ static void init_avctx(struct mp_filter *vd)
     const AVCodecDescriptor *desc = avcodec_descriptor_get(lavc_codec->id);
     ctx->intra_only = desc && (desc->props & AV_CODEC_PROP_INTRA_ONLY);
 
+    // Independent instances work only if each packet is decoded on its own.
+    bool use_par = !ctx->use_hwdec && ctx->intra_only && !low_latency &&
+                   lavc_param->intra_parallel > 1 &&
+                   !(lavc_codec->capabilities & AV_CODEC_CAP_DELAY);
+
     ctx->codec_timebase = mp_get_codec_timebase(ctx->codec);
 
     // This decoder does not read pkt_timebase correctly yet.
@@ -668,13 +766,21 @@ static void init_avctx(struct mp_filter *vd)
             avctx->get_format = get_format_hwdec;
 
         // Some APIs benefit from this, for others it's additional bloat.
-        if (ctx->hwdec.copying)
+        if (ctx->hwdec.copying && !low_latency)
             ctx->max_delay_queue = HWDEC_DELAY_QUEUE_COUNT;
         ctx->hw_probing = true;
+    } else if (use_par) {
+        avctx->thread_count = 1; // the instances are the threads
     } else {
         mp_set_avcodec_threads(vd->log, avctx, lavc_param->threads);
+        // Frame threading delays output by 1 frame per thread.
+        if (low_latency)
+            avctx->thread_type = FF_THREAD_SLICE;
     }
 
+    if (low_latency)
+        avctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+
     if (!ctx->use_hwdec && ctx->vo && lavc_param->dr) {
         avctx->opaque = vd;
         avctx->get_buffer2 = get_buffer2_direct;
@@ -732,6 +838,9 @@ static void init_avctx(struct mp_filter *vd)
 
     // Do this after the above avopt handling in case it changes values
     ctx->skip_frame = avctx->skip_frame;
+    ctx->skip_loop_filter = avctx->skip_loop_filter;
+
+    ctx->drop = (struct drop_policy){.last_pts = MP_NOPTS_VALUE};
 
     if (mp_set_avctx_codec_headers(avctx, c) < 0) {
         MP_ERR(vd, "Could not set codec parameters.\n");
@@ -755,6 +864,9 @@ static void init_avctx(struct mp_filter *vd)
         avcodec_flush_buffers(ctx->avctx);
     }
 
+    if (use_par && !par_init(vd, lavc_codec))
+        MP_WARN(vd, "Could not create parallel decoder instances.\n");
+
     return;
 
 error:
@@ -788,6 +900,7 @@ static void flush_all(struct mp_filter *vd)
         talloc_free(ctx->requeue_packets[n]);
     ctx->num_requeue_packets = 0;
 
+    par_flush(vd);
     reset_avctx(vd);
 }
 
@@ -796,11 +909,17 @@ static void uninit_avctx(struct mp_filter *vd)
     vd_ffmpeg_ctx *ctx = vd->priv;
 
     flush_all(vd);
+    par_destroy(vd);
     av_frame_free(&ctx->pic);
-    av_buffer_unref(&ctx->cached_hw_frames_ctx);
 
     avcodec_free_context(&ctx->avctx);
 
+    // Devices obtained from the VO persist anyway, so only copy-mode devices
+    // are worth keeping; frames pools are kept for both.
+    int warm_pool = ctx->opts->hwdec_warm_pool;
+    hwdec_warm_pool_put_frames(vd->global, warm_pool, &ctx->cached_hw_frames_ctx);
+    if (ctx->hwdec.copying)
+        hwdec_warm_pool_put_device(vd->global, warm_pool, &ctx->hwdec_dev);
     av_buffer_unref(&ctx->hwdec_dev);
 
     ctx->hwdec_failed = false;
@@ -856,7 +975,18 @@ static int init_generic_hwaccel(struct mp_filter *vd, enum AVPixelFormat hw_fmt)
             new_fctx->width             != old_fctx->width ||
             new_fctx->height            != old_fctx->height ||
             new_fctx->initial_pool_size != old_fctx->initial_pool_size)
-            av_buffer_unref(&ctx->cached_hw_frames_ctx);
+        {
+            hwdec_warm_pool_put_frames(vd->global, ctx->opts->hwdec_warm_pool,
+                                       &ctx->cached_hw_frames_ctx);
+        }
+    }
+
+    // Or one left over by a previous decoder instance.
+    if (!ctx->cached_hw_frames_ctx) {
+        ctx->cached_hw_frames_ctx =
+            hwdec_warm_pool_get_frames(vd->global, new_frames_ctx);
+        if (ctx->cached_hw_frames_ctx)
+            MP_VERBOSE(ctx, "Reusing cached hw frames pool.\n");
     }
 
     if (!ctx->cached_hw_frames_ctx) {
@@ -1020,14 +1150,89 @@ static void prepare_decoding(struct mp_filter *vd)
         // Can be much more aggressive for true intra codecs.
         if (ctx->intra_only)
             avctx->skip_frame = AVDISCARD_ALL;
+    } else if (drop == 3) {
+        avctx->skip_frame = AVDISCARD_NONKEY;   // scrubbing
     } else {
         avctx->skip_frame = ctx->skip_frame;    // normal playback
+        if (ctx->drop.level >= DROP_LEVEL_FRAME_NONREF)
+            avctx->skip_frame = MPMAX(avctx->skip_frame, AVDISCARD_NONREF);
+    }
+
+    avctx->skip_loop_filter = ctx->skip_loop_filter;
+    if (ctx->drop.level >= DROP_LEVEL_LOOPFILTER_ALL) {
+        avctx->skip_loop_filter = AVDISCARD_ALL;
+    } else if (ctx->drop.level >= DROP_LEVEL_LOOPFILTER_NONREF) {
+        avctx->skip_loop_filter = MPMAX(avctx->skip_loop_filter,
+                                        AVDISCARD_NONREF);
     }
 
     if (ctx->hwdec_request_reinit)
         reset_avctx(vd);
 }
 
+static void update_avg(double *avg, double val)
+{
+    *avg = *avg > 0 ? *avg + (val - *avg) * DROP_COST_WEIGHT : val;
+}
+
+static int next_drop_level(struct drop_policy *d, int dir)
+{
+    int level = d->level + dir;
+    // Dropping non-reference frames is useless if there are none (no B-frames
+    // seen yet). Those are also the only frames predicted as cheap to drop.
+    if (level == DROP_LEVEL_FRAME_NONREF && !d->type_cost[3])
+        level += dir;
+    return MPCLAMP(level, 0, DROP_LEVEL_COUNT - 1);
+}
+
+// Called for each decoded frame. Estimate decoding cost from the time spent in
+// libavcodec, and raise or lower the drop level if the decoder can't keep up
+// with the frame rate, or has plenty of headroom again.
+static void update_drop_policy(struct mp_filter *vd, struct mp_image *mpi)
+{
+    vd_ffmpeg_ctx *ctx = vd->priv;
+    struct drop_policy *d = &ctx->drop;
+
+    double cost = d->busy / 1e6;
+    d->busy = 0;
+
+    // Frame rate as output, so frames dropped by skip_frame are accounted.
+    double budget = 0;
+    if (mpi->pts != MP_NOPTS_VALUE && d->last_pts != MP_NOPTS_VALUE)
+        budget = mpi->pts - d->last_pts;
+    d->last_pts = mpi->pts;
+    if (budget <= 0 || budget > 1)
+        budget = mpi->pkt_duration > 0 ? mpi->pkt_duration : d->budget;
+    d->budget = budget;
+
+    int type = mpi->pict_type >= 1 && mpi->pict_type <= 3 ? mpi->pict_type : 0;
+    update_avg(&d->type_cost[type], cost);
+    update_avg(&d->cost, cost);
+
+    // Not useful with hwdec, and other framedrop modes take precedence.
+    if (!ctx->opts->adaptive_drop || ctx->use_hwdec || ctx->framedrop_flags ||
+        budget <= 0)
+        return;
+
+    d->over = d->cost > budget ? d->over + 1 : 0;
+    d->under = d->cost < budget * DROP_LOWER_RATIO ? d->under + 1 : 0;
+
+    int level = d->level;
+    if (d->over >= DROP_RAISE_FRAMES)
+        level = next_drop_level(d, 1);
+    if (d->under >= DROP_LOWER_FRAMES)
+        level = next_drop_level(d, -1);
+    if (level != d->level) {
+        MP_VERBOSE(vd, "Adaptive framedrop: %s (decoding %.1fms/frame, "
+                   "budget %.1fms)\n", drop_level_names[level], d->cost * 1e3,
+                   budget * 1e3);
+        d->level = level;
+        // Measure the effect of the new level from scratch.
+        d->cost = 0;
+        d->over = d->under = 0;
+    }
+}
+
 static void handle_err(struct mp_filter *vd)
 {
     vd_ffmpeg_ctx *ctx = vd->priv;
@@ -1065,7 +1270,9 @@ static int send_packet(struct mp_filter *vd, struct demux_packet *pkt)
     AVPacket avpkt;
     mp_set_av_packet(&avpkt, pkt, &ctx->codec_timebase);
 
+    int64_t start = mp_time_us();
     int ret = avcodec_send_packet(avctx, pkt ? &avpkt : NULL);
+    ctx->drop.busy += mp_time_us() - start;
     if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
         return ret;
 
@@ -1109,7 +1316,9 @@ static int decode_frame(struct mp_filter *vd)
     if (ctx->num_requeue_packets)
         send_queued_packet(vd);
 
+    int64_t start = mp_time_us();
     int ret = avcodec_receive_frame(avctx, ctx->pic);
+    ctx->drop.busy += mp_time_us() - start;
     if (ret < 0) {
         if (ret == AVERROR_EOF) {
             // If flushing was initialized earlier and has ended now, make it
@@ -1153,6 +1362,8 @@ static int decode_frame(struct mp_filter *vd)
 
     av_frame_unref(ctx->pic);
 
+    update_drop_policy(vd, mpi);
+
     MP_TARRAY_APPEND(ctx, ctx->delay_queue, ctx->num_delay_queue, mpi);
     return ret;
 }
@@ -1194,6 +1405,17 @@ static int receive_frame(struct mp_filter *vd, struct mp_frame *out_frame)
     if (!res)
         return AVERROR_UNKNOWN;
 
+    // Frames before the hr-seek target are discarded, so don't copy them back.
+    // A later frame must exist, because the last frame before EOF is shown if
+    // the target is past EOF.
+    if (ctx->use_hwdec && ctx->hwdec.copying && res->hwctx &&
+        ctx->num_delay_queue && ctx->skip_pts != MP_NOPTS_VALUE &&
+        res->pts != MP_NOPTS_VALUE && res->pts < ctx->skip_pts - .005)
+    {
+        talloc_free(res);
+        return 0; // force retry
+    }
+
     if (ctx->use_hwdec && ctx->hwdec.copying && res->hwctx) {
         struct mp_image *sw = mp_image_hw_download(res, ctx->hwdec_swpool);
         mp_image_unrefp(&res);
@@ -1234,6 +1456,9 @@ static int control(struct mp_filter *vd, enum dec_ctrl cmd, void *arg)
     case VDCTRL_SET_FRAMEDROP:
         ctx->framedrop_flags = *(int *)arg;
         return CONTROL_TRUE;
+    case VDCTRL_SET_SKIP_PTS:
+        ctx->skip_pts = *(double *)arg;
+        return CONTROL_TRUE;
     case VDCTRL_GET_BFRAMES: {
         AVCodecContext *avctx = ctx->avctx;
         if (!avctx)
@@ -1256,14 +1481,257 @@ static int control(struct mp_filter *vd, enum dec_ctrl cmd, void *arg)
     case VDCTRL_REINIT:
         reinit(vd);
         return CONTROL_TRUE;
+    case VDCTRL_GET_DROP_POLICY: {
+        if (!ctx->opts->adaptive_drop || !ctx->avctx)
+            break;
+        struct drop_policy *d = &ctx->drop;
+        struct vd_drop_policy_info *info = arg;
+        *info = (struct vd_drop_policy_info){
+            .level = drop_level_names[d->level],
+            .active = !ctx->use_hwdec,
+            .budget = d->budget,
+            .cost = d->cost,
+        };
+        for (int n = 0; n < 4; n++)
+            info->type_cost[n] = d->type_cost[n];
+        return CONTROL_TRUE;
+    }
     }
     return CONTROL_UNKNOWN;
 }
 
+static void *par_thread(void *arg)
+{
+    struct par_instance *inst = arg;
+    vd_ffmpeg_ctx *ctx = inst->vd->priv;
+    mpthread_set_name("vd-lavc");
+
+    pthread_mutex_lock(&ctx->par_lock);
+    while (!inst->terminate) {
+        if (inst->state != PAR_QUEUED || !inst->pkt) {
+            pthread_cond_wait(&ctx->par_wakeup, &ctx->par_lock);
+            continue;
+        }
+        struct demux_packet *pkt = inst->pkt;
+        inst->pkt = NULL;
+        inst->avctx->skip_frame = inst->skip_frame;
+        pthread_mutex_unlock(&ctx->par_lock);
+
+        struct mp_image *res = NULL;
+        AVPacket avpkt;
+        mp_set_av_packet(&avpkt, pkt, &ctx->codec_timebase);
+        int ret = avcodec_send_packet(inst->avctx, &avpkt);
+        if (ret >= 0)
+            ret = avcodec_receive_frame(inst->avctx, inst->pic);
+        if (ret >= 0) {
+            res = mp_image_from_av_frame(inst->pic);
+            if (res) {
+                res->pts = mp_pts_from_av(inst->pic->pts, &ctx->codec_timebase);
+                res->dts = mp_pts_from_av(inst->pic->pkt_dts,
+                                          &ctx->codec_timebase);
+                res->pkt_duration = mp_pts_from_av(inst->pic->pkt_duration,
+                                                   &ctx->codec_timebase);
+            }
+            av_frame_unref(inst->pic);
+        }
+        talloc_free(pkt);
+
+        pthread_mutex_lock(&ctx->par_lock);
+        inst->res = res;
+        inst->err = ret;
+        inst->state = PAR_DONE;
+        pthread_cond_broadcast(&ctx->par_wakeup);
+        pthread_mutex_unlock(&ctx->par_lock);
+
+        mp_filter_wakeup(inst->vd);
+
+        pthread_mutex_lock(&ctx->par_lock);
+    }
+    pthread_mutex_unlock(&ctx->par_lock);
+    return NULL;
+}
+
+static void par_free_instance(struct par_instance *inst)
+{
+    avcodec_free_context(&inst->avctx);
+    av_frame_free(&inst->pic);
+}
+
+// Create --vd-lavc-intra-parallel instances, configured like ctx->avctx.
+static bool par_init(struct mp_filter *vd, const AVCodec *codec)
+{
+    vd_ffmpeg_ctx *ctx = vd->priv;
+    int num = ctx->opts->intra_parallel;
+
+    ctx->par = talloc_zero_array(ctx, struct par_instance, num);
+    for (int n = 0; n < num; n++) {
+        struct par_instance *inst = &ctx->par[n];
+        inst->vd = vd;
+        inst->avctx = avcodec_alloc_context3(codec);
+        inst->pic = av_frame_alloc();
+        AVCodecContext *avctx = inst->avctx;
+        if (!avctx || !inst->pic)
+            goto error;
+
+        avctx->codec_type = AVMEDIA_TYPE_VIDEO;
+        avctx->codec_id = codec->id;
+        avctx->pkt_timebase = ctx->codec_timebase;
+        avctx->thread_count = 1;
+        avctx->flags = ctx->avctx->flags;
+        avctx->flags2 = ctx->avctx->flags2;
+        avctx->skip_loop_filter = ctx->avctx->skip_loop_filter;
+        avctx->skip_idct = ctx->avctx->skip_idct;
+        avctx->export_side_data = ctx->avctx->export_side_data;
+        // (get_buffer2_direct() is thread-safe.)
+        avctx->opaque = ctx->avctx->opaque;
+        avctx->get_buffer2 = ctx->avctx->get_buffer2;
+        mp_set_avopts(vd->log, avctx, ctx->opts->avopts);
+
+        if (mp_set_avctx_codec_headers(avctx, ctx->codec) < 0 ||
+            avcodec_open2(avctx, codec, NULL) < 0)
+            goto error;
+
+        if (pthread_create(&inst->thread, NULL, par_thread, inst))
+            goto error;
+        inst->thread_valid = true;
+        ctx->num_par = n + 1;
+    }
+
+    MP_VERBOSE(vd, "Using %d parallel decoder instances.\n", ctx->num_par);
+    return true;
+
+error:
+    par_free_instance(&ctx->par[ctx->num_par]);
+    par_destroy(vd);
+    return false;
+}
+
+// Discard all queued packets and decoded frames.
+static void par_flush(struct mp_filter *vd)
+{
+    vd_ffmpeg_ctx *ctx = vd->priv;
+
+    pthread_mutex_lock(&ctx->par_lock);
+    for (int n = 0; n < ctx->num_par; n++) {
+        struct par_instance *inst = &ctx->par[n];
+        if (inst->pkt) {
+            // Not started yet.
+            TA_FREEP(&inst->pkt);
+        } else {
+            // Possibly being decoded; wait until it's done.
+            while (inst->state == PAR_QUEUED)
+                pthread_cond_wait(&ctx->par_wakeup, &ctx->par_lock);
+        }
+        TA_FREEP(&inst->res);
+        inst->state = PAR_IDLE;
+        avcodec_flush_buffers(inst->avctx);
+    }
+    ctx->par_in = ctx->par_out = 0;
+    ctx->par_eof = false;
+    pthread_mutex_unlock(&ctx->par_lock);
+}
+
+static void par_destroy(struct mp_filter *vd)
+{
+    vd_ffmpeg_ctx *ctx = vd->priv;
+
+    par_flush(vd);
+
+    pthread_mutex_lock(&ctx->par_lock);
+    for (int n = 0; n < ctx->num_par; n++)
+        ctx->par[n].terminate = true;
+    pthread_cond_broadcast(&ctx->par_wakeup);
+    pthread_mutex_unlock(&ctx->par_lock);
+
+    for (int n = 0; n < ctx->num_par; n++) {
+        struct par_instance *inst = &ctx->par[n];
+        if (inst->thread_valid)
+            pthread_join(inst->thread, NULL);
+        par_free_instance(inst);
+    }
+
+    TA_FREEP(&ctx->par);
+    ctx->num_par = 0;
+}
+
+static void par_process(struct mp_filter *vd)
+{
+    vd_ffmpeg_ctx *ctx = vd->priv;
+
+    pthread_mutex_lock(&ctx->par_lock);
+
+    // Keep all instances busy, even if no output is needed yet.
+    while (!ctx->par_eof && ctx->par[ctx->par_in].state == PAR_IDLE) {
+        struct mp_frame frame = mp_pin_out_read(vd->ppins[0]);
+        if (frame.type == MP_FRAME_EOF) {
+            ctx->par_eof = true;
+            break;
+        }
+        if (frame.type != MP_FRAME_PACKET) {
+            if (frame.type) {
+                MP_ERR(vd, "unexpected frame type\n");
+                mp_frame_unref(&frame);
+                mp_filter_internal_mark_failed(vd);
+            }
+            break;
+        }
+
+        prepare_decoding(vd);
+        if (ctx->avctx->skip_frame == AVDISCARD_ALL) {
+            talloc_free(frame.data);
+            continue;
+        }
+
+        struct par_instance *inst = &ctx->par[ctx->par_in];
+        inst->pkt = frame.data;
+        inst->skip_frame = ctx->avctx->skip_frame;
+        inst->state = PAR_QUEUED;
+        ctx->par_in = (ctx->par_in + 1) % ctx->num_par;
+        pthread_cond_broadcast(&ctx->par_wakeup);
+    }
+
+    struct par_instance *inst = &ctx->par[ctx->par_out];
+    struct mp_frame out = {0};
+    int err = 0;
+    if (!mp_pin_in_needs_data(vd->ppins[1])) {
+        // nothing to do
+    } else if (inst->state == PAR_DONE) {
+        out = MAKE_FRAME(MP_FRAME_VIDEO, inst->res);
+        err = inst->err;
+        inst->res = NULL;
+        inst->state = PAR_IDLE;
+        ctx->par_out = (ctx->par_out + 1) % ctx->num_par;
+        // Feed the instance again.
+        mp_filter_internal_mark_progress(vd);
+    } else if (inst->state == PAR_IDLE && ctx->par_eof) {
+        // (The oldest instance is idle, so all are drained.)
+        out = MP_EOF_FRAME;
+        ctx->par_eof = false;
+    }
+
+    pthread_mutex_unlock(&ctx->par_lock);
+
+    if (err < 0 && err != AVERROR(EAGAIN))
+        handle_err(vd);
+
+    if (out.type == MP_FRAME_VIDEO) {
+        out.data = out.data ? mp_img_swap_to_native(out.data) : NULL;
+        if (!out.data)
+            out.type = MP_FRAME_NONE;
+    }
+    if (out.type)
+        mp_pin_in_write(vd->ppins[1], out);
+}
+
 static void process(struct mp_filter *vd)
 {
     vd_ffmpeg_ctx *ctx = vd->priv;
 
+    if (ctx->num_par) {
+        par_process(vd);
+        return;
+    }
+
     lavc_process(vd, &ctx->state, send_packet, receive_frame);
 }
 
@@ -1275,6 +1743,11 @@ static void reset(struct mp_filter *vd)
 
     ctx->state = (struct lavc_state){0};
     ctx->framedrop_flags = 0;
+    ctx->skip_pts = MP_NOPTS_VALUE;
+    // Keep the level and cost estimates across seeks.
+    ctx->drop.busy = 0;
+    ctx->drop.last_pts = MP_NOPTS_VALUE;
+    ctx->drop.over = ctx->drop.under = 0;
 }
 
 static void destroy(struct mp_filter *vd)
@@ -1284,6 +1757,8 @@ static void destroy(struct mp_filter *vd)
     uninit_avctx(vd);
 
     pthread_mutex_destroy(&ctx->dr_lock);
+    pthread_mutex_destroy(&ctx->par_lock);
+    pthread_cond_destroy(&ctx->par_wakeup);
 }
 
 static const struct mp_filter_info vd_lavc_filter = {
@@ -1315,11 +1790,14 @@ static struct mp_decoder *create(struct mp_filter *parent,
     ctx->decoder = talloc_strdup(ctx, decoder);
     ctx->hwdec_swpool = mp_image_pool_new(ctx);
     ctx->dr_pool = mp_image_pool_new(ctx);
+    ctx->skip_pts = MP_NOPTS_VALUE;
 
     ctx->public.f = vd;
     ctx->public.control = control;
 
     pthread_mutex_init(&ctx->dr_lock, NULL);
+    pthread_mutex_init(&ctx->par_lock, NULL);
+    pthread_cond_init(&ctx->par_wakeup, NULL);
 
     // hwdec/DR
     struct mp_stream_info *info = mp_filter_find_stream_info(vd);
@@ -15,7 +15,11 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <inttypes.h>
 #include <math.h>
+#include <string.h>
+
+#include <libavutil/cpu.h>
 
 #include "common/common.h"
 #include "common/tags.h"
@@ -35,6 +39,8 @@ struct f_opts {
     int type;
     int clear;
     int print;
+    int area;
+    int batch;
 };
 
 const struct m_opt_choice_alternatives type_names[] = {
@@ -48,6 +54,8 @@ static const struct m_option f_opts_list[] = {
     {"type", OPT_CHOICE_C(type, type_names)},
     {"clear-on-query", OPT_FLAG(clear)},
     {"print", OPT_FLAG(print)},
+    {"area", OPT_FLAG(area)},
+    {"batch", OPT_INT(batch), M_RANGE(0, 100000)},
     {0}
 };
 
@@ -56,19 +64,21 @@ static const struct f_opts f_opts_def = {
     .clear = 1,
 };
 
-struct print_entry {
-    double pts;
-    char *print;
-};
-
 struct priv {
     struct f_opts *opts;
     struct mp_image *scaled;
     struct mp_sws_context *sws;
     struct mp_zimg_context *zimg;
-    struct print_entry entries[PRINT_ENTRY_NUM];
+    // Ring buffer of raw fingerprints (size * size bytes each).
+    uint8_t *prints;
+    double *pts;
+    int max_entries;
+    int first_entry;                // index of oldest entry
     int num_entries;
+    int64_t dropped;                // entries overwritten since last query
     bool fallback_warning;
+    uint32_t *sums;                 // area downscaler accumulators
+    uint32_t (*sum_u8)(const uint8_t *src, int w);
 };
 
 // (Other code internal to this filter also calls this to reset the frame list.)
@@ -76,9 +86,96 @@ static void f_reset(struct mp_filter *f)
 {
     struct priv *p = f->priv;
 
-    for (int n = 0; n < p->num_entries; n++)
-        talloc_free(p->entries[n].print);
+    p->first_entry = 0;
     p->num_entries = 0;
+    p->dropped = 0;
+}
+
+static uint32_t sum_u8_c(const uint8_t *src, int w)
+{
+    uint32_t sum = 0;
+    for (int x = 0; x < w; x++)
+        sum += src[x];
+    return sum;
+}
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_FP_SSE2 1
+#include <emmintrin.h>
+
+__attribute__((target("sse2")))
+static uint32_t sum_u8_sse2(const uint8_t *src, int w)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc = zero;
+    int x = 0;
+    // psadbw against 0 sums 8 bytes into each 64 bit half.
+    for (; x + 16 <= w; x += 16) {
+        __m128i v = _mm_loadu_si128((const void *)(src + x));
+        acc = _mm_add_epi64(acc, _mm_sad_epu8(v, zero));
+    }
+    uint32_t sum = _mm_cvtsi128_si32(acc) +
+                   _mm_cvtsi128_si32(_mm_srli_si128(acc, 8));
+    return sum + sum_u8_c(src + x, w - x);
+}
+#else
+#define HAVE_FP_SSE2 0
+#endif
+
+// Whether the luma plane of mpi can be read directly by area_downscale().
+static bool area_supported(struct priv *p, struct mp_image *mpi)
+{
+    int size = p->scaled->w;
+    return (mpi->fmt.flags & (MP_IMGFLAG_YUV_P | MP_IMGFLAG_YUV_NV)) &&
+           mpi->fmt.bpp[0] == 8 && mpi->w >= size && mpi->h >= size;
+}
+
+// Average the luma samples covered by each output pixel (a box filter). Cells
+// are from integer pixel boundaries, which makes the result independent of how
+// the image is walked, so the C and SIMD paths produce identical output.
+static void area_downscale(struct priv *p, struct mp_image *mpi)
+{
+    struct mp_image *dst = p->scaled;
+    int size = dst->w;
+    bool tv = mpi->params.color.levels != MP_CSP_LEVELS_PC;
+
+    for (int cy = 0; cy < size; cy++) {
+        int y0 = cy * mpi->h / size, y1 = (cy + 1) * mpi->h / size;
+        for (int cx = 0; cx < size; cx++)
+            p->sums[cx] = 0;
+        for (int y = y0; y < y1; y++) {
+            uint8_t *line = mpi->planes[0] + y * (ptrdiff_t)mpi->stride[0];
+            for (int cx = 0; cx < size; cx++) {
+                int x0 = cx * mpi->w / size, x1 = (cx + 1) * mpi->w / size;
+                p->sums[cx] += p->sum_u8(line + x0, x1 - x0);
+            }
+        }
+        uint8_t *out = dst->planes[0] + cy * (ptrdiff_t)dst->stride[0];
+        for (int cx = 0; cx < size; cx++) {
+            int x0 = cx * mpi->w / size, x1 = (cx + 1) * mpi->w / size;
+            uint64_t num = (uint64_t)(x1 - x0) * (y1 - y0);
+            int v = (p->sums[cx] + num / 2) / num;
+            // Expand to full range, as the zimg path does.
+            if (tv)
+                v = MPCLAMP(((v - 16) * 255 + 219 / 2) / 219, 0, 255);
+            out[cx] = v;
+        }
+    }
+}
+
+static void append_hex(char *dst, const uint8_t *src, int len)
+{
+    static const char hex[] = "0123456789abcdef";
+    for (int n = 0; n < len; n++) {
+        dst[n * 2 + 0] = hex[src[n] >> 4];
+        dst[n * 2 + 1] = hex[src[n] & 15];
+    }
+    dst[len * 2] = '\0';
+}
+
+static int entry_index(struct priv *p, int n)
+{
+    return (p->first_entry + n) % p->max_entries;
 }
 
 static void f_process(struct mp_filter *f)
@@ -106,7 +203,9 @@ static void f_process(struct mp_filter *f)
     // Make output always full range; no reason to lose precision.
     p->scaled->params.color.levels = MP_CSP_LEVELS_PC;
 
-    if (!mp_zimg_convert(p->zimg, p->scaled, mpi)) {
+    if (p->opts->area && area_supported(p, mpi)) {
+        area_downscale(p, mpi);
+    } else if (!mp_zimg_convert(p->zimg, p->scaled, mpi)) {
         if (!p->fallback_warning) {
             MP_WARN(f, "Falling back to libswscale.\n");
             p->fallback_warning = true;
@@ -115,27 +214,28 @@ static void f_process(struct mp_filter *f)
             goto error;
     }
 
-    if (p->num_entries >= PRINT_ENTRY_NUM) {
-        talloc_free(p->entries[0].print);
-        MP_TARRAY_REMOVE_AT(p->entries, p->num_entries, 0);
+    if (p->num_entries >= p->max_entries) {
+        p->first_entry = entry_index(p, 1);
+        p->num_entries--;
+        p->dropped++;
     }
 
     int size = p->scaled->w;
-
-    struct print_entry *e = &p->entries[p->num_entries++];
-    e->pts = mpi->pts;
-    e->print = talloc_array(p, char, size * size * 2 + 1);
+    int idx = entry_index(p, p->num_entries++);
+    uint8_t *print = &p->prints[idx * size * size];
+    p->pts[idx] = mpi->pts;
 
     for (int y = 0; y < size; y++) {
-        for (int x = 0; x < size; x++) {
-            char *offs = &e->print[(y * size + x) * 2];
-            uint8_t v = p->scaled->planes[0][y * p->scaled->stride[0] + x];
-            snprintf(offs, 3, "%02x", v);
-        }
+        memcpy(&print[y * size],
+               p->scaled->planes[0] + y * p->scaled->stride[0], size);
     }
 
-    if (p->opts->print)
-        MP_INFO(f, "%f: %s\n", e->pts, e->print);
+    if (p->opts->print) {
+        char *hex = talloc_array(NULL, char, size * size * 2 + 1);
+        append_hex(hex, print, size * size);
+        MP_INFO(f, "%f: %s\n", mpi->pts, hex);
+        talloc_free(hex);
+    }
 
     mp_pin_in_write(f->ppins[1], frame);
     return;
@@ -153,15 +253,45 @@ static bool f_command(struct mp_filter *f, struct mp_filter_command *cmd)
     switch (cmd->type) {
     case MP_FILTER_COMMAND_GET_META: {
         struct mp_tags *t = talloc_zero(NULL, struct mp_tags);
-
-        for (int n = 0; n < p->num_entries; n++) {
-            struct print_entry *e = &p->entries[n];
-
-            if (e->pts != MP_NOPTS_VALUE) {
-                mp_tags_set_str(t, mp_tprintf(80, "fp%d.pts", n),
-                                   mp_tprintf(80, "%f", e->pts));
+        int len = p->scaled->w * p->scaled->w;
+
+        if (p->opts->batch) {
+            // Everything in 3 strings, so a query costs the same for any
+            // number of frames.
+            char *pts = talloc_strdup(NULL, "");
+            char *hex = talloc_array(NULL, char, p->num_entries * len * 2 + 1);
+            hex[0] = '\0';
+            for (int n = 0; n < p->num_entries; n++) {
+                int idx = entry_index(p, n);
+                if (p->pts[idx] != MP_NOPTS_VALUE) {
+                    pts = talloc_asprintf_append_buffer(pts, "%s%f",
+                                                        n ? "," : "", p->pts[idx]);
+                } else {
+                    pts = talloc_asprintf_append_buffer(pts, "%snone",
+                                                        n ? "," : "");
+                }
+                append_hex(hex + n * len * 2, &p->prints[idx * len], len);
+            }
+            mp_tags_set_str(t, "batch.count", mp_tprintf(80, "%d", p->num_entries));
+            mp_tags_set_str(t, "batch.dropped",
+                            mp_tprintf(80, "%"PRId64, p->dropped));
+            mp_tags_set_str(t, "batch.pts", pts);
+            mp_tags_set_str(t, "batch.hex", hex);
+            talloc_free(pts);
+            talloc_free(hex);
+        } else {
+            char *hex = talloc_array(NULL, char, len * 2 + 1);
+            for (int n = 0; n < p->num_entries; n++) {
+                int idx = entry_index(p, n);
+
+                if (p->pts[idx] != MP_NOPTS_VALUE) {
+                    mp_tags_set_str(t, mp_tprintf(80, "fp%d.pts", n),
+                                       mp_tprintf(80, "%f", p->pts[idx]));
+                }
+                append_hex(hex, &p->prints[idx * len], len);
+                mp_tags_set_str(t, mp_tprintf(80, "fp%d.hex", n), hex);
             }
-            mp_tags_set_str(t, mp_tprintf(80, "fp%d.hex", n), e->print);
+            talloc_free(hex);
         }
 
         mp_tags_set_str(t, "type", m_opt_choice_str(type_names, p->opts->type));
@@ -202,6 +332,15 @@ static struct mp_filter *f_create(struct mp_filter *parent, void *options)
     p->scaled = mp_image_alloc(IMGFMT_Y8, size, size);
     MP_HANDLE_OOM(p->scaled);
     talloc_steal(p, p->scaled);
+    p->max_entries = p->opts->batch ? p->opts->batch : PRINT_ENTRY_NUM;
+    p->prints = talloc_array(p, uint8_t, p->max_entries * size * size);
+    p->pts = talloc_array(p, double, p->max_entries);
+    p->sums = talloc_array(p, uint32_t, size);
+    p->sum_u8 = sum_u8_c;
+#if HAVE_FP_SSE2
+    if (av_get_cpu_flags() & AV_CPU_FLAG_SSE2)
+        p->sum_u8 = sum_u8_sse2;
+#endif
     p->sws = mp_sws_alloc(p);
     MP_HANDLE_OOM(p->sws);
     p->zimg = mp_zimg_alloc();
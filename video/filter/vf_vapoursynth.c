@@ -569,6 +569,23 @@ static int num_requested(struct priv *p)
     return r;
 }
 
+// Set the number of concurrent requests, and grow the frame arrays if needed.
+// Must be called with p->lock held, or before the filter is used.
+static void set_max_requests(struct priv *p, int max_requests)
+{
+    int old = p->requested ? MP_TALLOC_AVAIL(p->requested) : 0;
+    if (max_requests > old) {
+        p->requested = talloc_realloc(p, p->requested, struct mp_image *,
+                                      max_requests);
+        for (int n = old; n < max_requests; n++)
+            p->requested[n] = NULL;
+    }
+    int maxbuffer = p->opts->maxbuffer * max_requests;
+    if (!p->buffered || maxbuffer > MP_TALLOC_AVAIL(p->buffered))
+        p->buffered = talloc_realloc(p, p->buffered, struct mp_image *, maxbuffer);
+    p->max_requests = max_requests;
+}
+
 static void destroy_vs(struct priv *p)
 {
     if (!p->out_node && !p->initializing)
@@ -689,6 +706,17 @@ static int reinit_vs(struct priv *p, struct mp_image *input)
     }
 
     pthread_mutex_lock(&p->lock);
+    // With "auto", match the VS thread pool (the script can change its size).
+    if (p->opts->maxrequests < 0) {
+        const VSCoreInfo *core_info = p->vsapi->getCoreInfo(p->vscore);
+        if (core_info && core_info->numThreads > 0 &&
+            core_info->numThreads != p->max_requests)
+        {
+            set_max_requests(p, core_info->numThreads);
+            MP_VERBOSE(p, "using %d concurrent requests (VS threads).\n",
+                       p->max_requests);
+        }
+    }
     p->initializing = false;
     pthread_mutex_unlock(&p->lock);
     MP_DBG(p, "initialized.\n");
@@ -761,13 +789,11 @@ static struct mp_filter *vf_vapoursynth_create(struct mp_filter *parent,
     }
     p->script_path = mp_get_user_path(p, f->global, p->opts->file);
 
-    p->max_requests = p->opts->maxrequests;
-    if (p->max_requests < 0)
-        p->max_requests = av_cpu_count();
+    int max_requests = p->opts->maxrequests;
+    if (max_requests < 0)
+        max_requests = av_cpu_count();
+    set_max_requests(p, max_requests);
     MP_VERBOSE(p, "using %d concurrent requests.\n", p->max_requests);
-    int maxbuffer = p->opts->maxbuffer * p->max_requests;
-    p->buffered = talloc_array(p, struct mp_image *, maxbuffer);
-    p->requested = talloc_zero_array(p, struct mp_image *, p->max_requests);
 
     struct mp_autoconvert *conv = mp_autoconvert_create(f);
     if (!conv)
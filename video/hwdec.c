@@ -18,6 +18,156 @@ struct mp_hwdec_devices {
     void *load_api_ctx;
 };
 
+struct warm_entry {
+    struct mpv_global *global;  // owner; entries are never shared across cores
+    AVBufferRef *ref;           // AVHWDeviceContext* or AVHWFramesContext*
+    bool is_frames;
+};
+
+// Process-wide, but logically partitioned by mpv_global. Entries are in
+// insertion order, so the oldest frames pool of a core is evicted first.
+static pthread_mutex_t warm_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct warm_entry *warm_entries;
+static int num_warm_entries;
+
+static AVHWDeviceContext *warm_entry_device(struct warm_entry *e)
+{
+    if (e->is_frames)
+        return ((AVHWFramesContext *)e->ref->data)->device_ctx;
+    return (void *)e->ref->data;
+}
+
+// Remove all entries owned by global (or any, if NULL) that are using the
+// given device (or any, if NULL).
+static void warm_pool_drop(struct mpv_global *global, void *device)
+{
+    AVBufferRef **unref = NULL;
+    int num_unref = 0;
+
+    pthread_mutex_lock(&warm_lock);
+    for (int n = num_warm_entries - 1; n >= 0; n--) {
+        struct warm_entry *e = &warm_entries[n];
+        if ((global && e->global != global) ||
+            (device && warm_entry_device(e) != device))
+            continue;
+        MP_TARRAY_APPEND(NULL, unref, num_unref, e->ref);
+        MP_TARRAY_REMOVE_AT(warm_entries, num_warm_entries, n);
+    }
+    if (!num_warm_entries)
+        TA_FREEP(&warm_entries);
+    pthread_mutex_unlock(&warm_lock);
+
+    // Freeing pools can call into the driver; don't hold the lock for it.
+    for (int n = 0; n < num_unref; n++)
+        av_buffer_unref(&unref[n]);
+    talloc_free(unref);
+}
+
+static void warm_pool_put(struct mpv_global *global, int max_pools,
+                          AVBufferRef **ref, bool is_frames)
+{
+    if (!*ref)
+        return;
+    if (max_pools <= 0) {
+        av_buffer_unref(ref);
+        return;
+    }
+
+    struct warm_entry new = {global, *ref, is_frames};
+    *ref = NULL;
+
+    pthread_mutex_lock(&warm_lock);
+    int count = 0, evict = -1;
+    for (int n = 0; n < num_warm_entries; n++) {
+        struct warm_entry *e = &warm_entries[n];
+        if (e->global != global || e->is_frames != is_frames)
+            continue;
+        if (is_frames) {
+            if (evict < 0)
+                evict = n;
+            count++;
+        } else if (warm_entry_device(e)->type == warm_entry_device(&new)->type) {
+            // Only one device per API is ever needed.
+            evict = n;
+            count = max_pools;
+            break;
+        }
+    }
+    AVBufferRef *evict_ref = NULL;
+    if (count >= max_pools && evict >= 0) {
+        evict_ref = warm_entries[evict].ref;
+        MP_TARRAY_REMOVE_AT(warm_entries, num_warm_entries, evict);
+    }
+    MP_TARRAY_APPEND(NULL, warm_entries, num_warm_entries, new);
+    pthread_mutex_unlock(&warm_lock);
+
+    av_buffer_unref(&evict_ref);
+}
+
+void hwdec_warm_pool_put_device(struct mpv_global *global, int max_pools,
+                                struct AVBufferRef **dev)
+{
+    warm_pool_put(global, max_pools, dev, false);
+}
+
+void hwdec_warm_pool_put_frames(struct mpv_global *global, int max_pools,
+                                struct AVBufferRef **frames)
+{
+    warm_pool_put(global, max_pools, frames, true);
+}
+
+struct AVBufferRef *hwdec_warm_pool_get_device(struct mpv_global *global,
+                                               int av_hwdevice_type)
+{
+    AVBufferRef *res = NULL;
+    pthread_mutex_lock(&warm_lock);
+    for (int n = 0; n < num_warm_entries; n++) {
+        struct warm_entry *e = &warm_entries[n];
+        if (e->global == global && !e->is_frames &&
+            warm_entry_device(e)->type == av_hwdevice_type)
+        {
+            res = e->ref;
+            MP_TARRAY_REMOVE_AT(warm_entries, num_warm_entries, n);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&warm_lock);
+    return res;
+}
+
+struct AVBufferRef *hwdec_warm_pool_get_frames(struct mpv_global *global,
+                                               struct AVBufferRef *params)
+{
+    AVHWFramesContext *p = (void *)params->data;
+    AVBufferRef *res = NULL;
+    pthread_mutex_lock(&warm_lock);
+    // Prefer the most recently used pool.
+    for (int n = num_warm_entries - 1; n >= 0; n--) {
+        struct warm_entry *e = &warm_entries[n];
+        if (e->global != global || !e->is_frames)
+            continue;
+        AVHWFramesContext *f = (void *)e->ref->data;
+        if (f->device_ctx        == p->device_ctx &&
+            f->format            == p->format &&
+            f->sw_format         == p->sw_format &&
+            f->width             == p->width &&
+            f->height            == p->height &&
+            f->initial_pool_size == p->initial_pool_size)
+        {
+            res = e->ref;
+            MP_TARRAY_REMOVE_AT(warm_entries, num_warm_entries, n);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&warm_lock);
+    return res;
+}
+
+void hwdec_warm_pool_flush(struct mpv_global *global)
+{
+    warm_pool_drop(global, NULL);
+}
+
 struct mp_hwdec_devices *hwdec_devices_create(void)
 {
     struct mp_hwdec_devices *devs = talloc_zero(NULL, struct mp_hwdec_devices);
@@ -93,6 +243,10 @@ void hwdec_devices_remove(struct mp_hwdec_devices *devs, struct mp_hwdec_ctx *ct
         }
     }
     pthread_mutex_unlock(&devs->lock);
+
+    // The VO is going to destroy the device; cached pools must not outlive it.
+    if (ctx->av_device_ref)
+        warm_pool_drop(NULL, ctx->av_device_ref->data);
 }
 
 void hwdec_devices_set_loader(struct mp_hwdec_devices *devs,
@@ -75,6 +75,33 @@ char *hwdec_devices_get_names(struct mp_hwdec_devices *devs);
 struct mp_image;
 struct mpv_global;
 
+// The warm pool keeps hwdec devices created for copy-mode decoding, and
+// initialized AVHWFramesContexts, alive after the decoder is destroyed, so
+// that the next decoder (e.g. after loadfile) can start without recreating
+// them. Entries are private to the given mpv_global. The get functions
+// transfer ownership of the returned reference to the caller.
+
+// Move the reference to the pool (the argument is set to NULL). max_pools is
+// the maximum number of frames pools kept per core, the oldest being evicted
+// first. At most 1 device per device type is kept. If max_pools is 0, the
+// reference is simply unreferenced.
+void hwdec_warm_pool_put_device(struct mpv_global *global, int max_pools,
+                                struct AVBufferRef **dev);
+void hwdec_warm_pool_put_frames(struct mpv_global *global, int max_pools,
+                                struct AVBufferRef **frames);
+
+// Return a cached device of the given AV_HWDEVICE_TYPE_*, or NULL.
+struct AVBufferRef *hwdec_warm_pool_get_device(struct mpv_global *global,
+                                               int av_hwdevice_type);
+
+// Return an initialized frames pool matching the device and parameters of the
+// given (not yet initialized) AVHWFramesContext, or NULL.
+struct AVBufferRef *hwdec_warm_pool_get_frames(struct mpv_global *global,
+                                               struct AVBufferRef *params);
+
+// Unref all entries of the given core.
+void hwdec_warm_pool_flush(struct mpv_global *global);
+
 struct hwcontext_create_dev_params {
     bool probing;   // if true, don't log errors if unavailable
 };
@@ -0,0 +1,158 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <pthread.h>
+#include <string.h>
+
+#include "common/common.h"
+#include "common/memory.h"
+#include "demux/packet.h"
+#include "image_cache.h"
+#include "mp_image.h"
+
+// Maximum number of images kept. Consecutive playlist entries usually share
+// at most one picture, so this mostly helps with going back and forth.
+#define MAX_ENTRIES 4
+
+struct entry {
+    uint64_t hash;
+    struct demux_packet *pkt;
+    struct mp_image *img;
+    int64_t size;
+};
+
+struct mp_image_cache {
+    pthread_mutex_t lock;
+    struct mp_memory_user *mem;
+    // Least recently used first.
+    struct entry entries[MAX_ENTRIES];
+    int num_entries;
+    int64_t total_size;
+};
+
+static void drop_entry(struct mp_image_cache *cache, int idx)
+{
+    struct entry *e = &cache->entries[idx];
+    cache->total_size -= e->size;
+    free_demux_packet(e->pkt);
+    talloc_free(e->img);
+    MP_TARRAY_REMOVE_AT(cache->entries, cache->num_entries, idx);
+}
+
+static void destroy(void *p)
+{
+    struct mp_image_cache *cache = p;
+    while (cache->num_entries)
+        drop_entry(cache, 0);
+    pthread_mutex_destroy(&cache->lock);
+}
+
+struct mp_image_cache *mp_image_cache_create(void *ta_parent,
+                                             struct mpv_global *global)
+{
+    struct mp_image_cache *cache = talloc_zero(ta_parent, struct mp_image_cache);
+    talloc_set_destructor(cache, destroy);
+    pthread_mutex_init(&cache->lock, NULL);
+    cache->mem = mp_memory_user_create(cache, global, "image-cache");
+    return cache;
+}
+
+// FNV-1a
+static uint64_t hash_data(const uint8_t *data, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t n = 0; n < len; n++)
+        h = (h ^ data[n]) * 0x100000001b3ULL;
+    return h;
+}
+
+// Must be called locked.
+static int find_entry(struct mp_image_cache *cache, uint64_t hash,
+                      struct demux_packet *pkt)
+{
+    for (int n = 0; n < cache->num_entries; n++) {
+        struct entry *e = &cache->entries[n];
+        if (e->hash == hash && e->pkt->len == pkt->len &&
+            memcmp(e->pkt->buffer, pkt->buffer, pkt->len) == 0)
+            return n;
+    }
+    return -1;
+}
+
+struct mp_image *mp_image_cache_get(struct mp_image_cache *cache,
+                                    struct demux_packet *pkt)
+{
+    uint64_t hash = hash_data(pkt->buffer, pkt->len);
+    struct mp_image *res = NULL;
+
+    pthread_mutex_lock(&cache->lock);
+    int idx = find_entry(cache, hash, pkt);
+    if (idx >= 0) {
+        struct entry e = cache->entries[idx];
+        res = mp_image_new_ref(e.img);
+        // Move to the end (most recently used).
+        MP_TARRAY_REMOVE_AT(cache->entries, cache->num_entries, idx);
+        cache->entries[cache->num_entries++] = e;
+    }
+    pthread_mutex_unlock(&cache->lock);
+
+    return res;
+}
+
+void mp_image_cache_add(struct mp_image_cache *cache, struct demux_packet *pkt,
+                        struct mp_image *img)
+{
+    if (img->hwctx)
+        return;
+
+    uint64_t hash = hash_data(pkt->buffer, pkt->len);
+
+    // Don't keep a reference to the decoder's buffer, which might be owned by
+    // a pool of the VO (direct rendering).
+    struct entry e = {
+        .hash = hash,
+        .pkt = demux_copy_packet(pkt),
+        .img = mp_image_new_copy(img),
+    };
+    if (!e.pkt || !e.img) {
+        free_demux_packet(e.pkt);
+        talloc_free(e.img);
+        return;
+    }
+    e.size = mp_image_approx_byte_size(e.img) + pkt->len;
+
+    pthread_mutex_lock(&cache->lock);
+    int idx = find_entry(cache, hash, pkt);
+    if (idx >= 0)
+        drop_entry(cache, idx);
+    if (cache->num_entries == MAX_ENTRIES)
+        drop_entry(cache, 0);
+    int64_t allowance = mp_memory_get_allowance(cache->mem);
+    while (cache->num_entries && cache->total_size + e.size > allowance)
+        drop_entry(cache, 0);
+    if (e.size <= allowance) {
+        cache->entries[cache->num_entries++] = e;
+        cache->total_size += e.size;
+        e = (struct entry){0};
+    }
+    mp_memory_report(cache->mem, cache->total_size);
+    pthread_mutex_unlock(&cache->lock);
+
+    free_demux_packet(e.pkt);
+    talloc_free(e.img);
+}
@@ -0,0 +1,26 @@
+#ifndef MP_IMAGE_CACHE_H
+#define MP_IMAGE_CACHE_H
+
+struct demux_packet;
+struct mp_image;
+struct mp_image_cache;
+struct mpv_global;
+
+// Cache of decoded still images (cover art), keyed by the contents of the
+// packet they were decoded from, so that e.g. tracks of an album sharing the
+// same embedded picture don't decode it again on each playlist entry. Only a
+// few images are kept, and the memory is accounted under --memory-budget.
+// All functions are thread-safe.
+struct mp_image_cache *mp_image_cache_create(void *ta_parent,
+                                             struct mpv_global *global);
+
+// Return a new reference to the image decoded from pkt, or NULL if not cached.
+struct mp_image *mp_image_cache_get(struct mp_image_cache *cache,
+                                    struct demux_packet *pkt);
+
+// Add the image decoded from pkt. Neither is taken over. Hardware images are
+// not cached.
+void mp_image_cache_add(struct mp_image_cache *cache, struct demux_packet *pkt,
+                        struct mp_image *img);
+
+#endif
@@ -16,6 +16,7 @@
  */
 
 #include <assert.h>
+#include <limits.h>
 #include <string.h>
 
 #include <libavcodec/avcodec.h>
@@ -816,6 +817,54 @@ int mp_imgfmt_select_best(int dst1, int dst2, int src)
     return pixfmt2imgfmt(avcodec_find_best_pix_fmt_of_list(dstlist, srcpxf, 1, 0));
 }
 
+// Estimated cost of converting src to dst in software; lower is better.
+// Precision loss dominates, then the CPU cost of the conversion, and then the
+// memory bandwidth of the result. Returns INT_MAX if either format is unknown.
+int mp_imgfmt_conversion_cost(int dst, int src)
+{
+    if (dst == src)
+        return 0;
+
+    enum AVPixelFormat dstpxf = imgfmt2pixfmt(dst);
+    enum AVPixelFormat srcpxf = imgfmt2pixfmt(src);
+    const AVPixFmtDescriptor *ddesc = av_pix_fmt_desc_get(dstpxf);
+    const AVPixFmtDescriptor *sdesc = av_pix_fmt_desc_get(srcpxf);
+    if (!ddesc || !sdesc)
+        return INT_MAX;
+
+    int cost = 0;
+
+    // Precision loss.
+    int loss = av_get_pix_fmt_loss(dstpxf, srcpxf, 1);
+    if (loss & FF_LOSS_RESOLUTION)
+        cost += 100000;
+    if (loss & FF_LOSS_COLORQUANT)
+        cost += 50000;
+    if (loss & FF_LOSS_DEPTH)
+        cost += 20000;
+    if (loss & FF_LOSS_CHROMA)
+        cost += 10000;
+    if (loss & FF_LOSS_ALPHA)
+        cost += 5000;
+    if (loss & FF_LOSS_COLORSPACE)
+        cost += 2000;
+
+    // CPU cost: YUV<->RGB requires a matrix multiplication per pixel, chroma
+    // resampling and depth changes need actual scaling instead of repacking.
+    if ((ddesc->flags & AV_PIX_FMT_FLAG_RGB) != (sdesc->flags & AV_PIX_FMT_FLAG_RGB))
+        cost += 500;
+    if (ddesc->log2_chroma_w != sdesc->log2_chroma_w ||
+        ddesc->log2_chroma_h != sdesc->log2_chroma_h)
+        cost += 200;
+    if (ddesc->comp[0].depth != sdesc->comp[0].depth)
+        cost += 100;
+
+    // Bandwidth of the converted image.
+    cost += av_get_padded_bits_per_pixel(ddesc);
+
+    return cost;
+}
+
 // Same as mp_imgfmt_select_best(), but with a list of dst formats.
 int mp_imgfmt_select_best_list(int *dst, int num_dst, int src)
 {
@@ -36,6 +36,7 @@
 #include "common/common.h"
 #include "hwdec.h"
 #include "mp_image.h"
+#include "mp_image_pool.h"
 #include "sws_utils.h"
 #include "fmt-conversion.h"
 
@@ -173,7 +174,7 @@ static bool mp_image_alloc_planes(struct mp_image *mpi)
         return false;
 
     // Note: mp_image_pool assumes this creates only 1 AVBufferRef.
-    mpi->bufs[0] = av_buffer_alloc(size + align);
+    mpi->bufs[0] = mp_image_buffer_alloc(size + align);
     if (!mpi->bufs[0])
         return false;
 
@@ -699,6 +700,19 @@ void mp_image_clear_rc_inv(struct mp_image *mpi, struct mp_rect rc)
         mp_image_clear_rc(mpi, clr[n]);
 }
 
+// Copy the area rc from src to dst. Both images must have the same format and
+// be large enough to contain rc. Does nothing if rc is empty.
+void mp_image_copy_rc(struct mp_image *dst, struct mp_image *src,
+                      struct mp_rect rc)
+{
+    if (rc.x0 >= rc.x1 || rc.y0 >= rc.y1)
+        return;
+    struct mp_image d = *dst, s = *src;
+    mp_image_crop_rc(&d, rc);
+    mp_image_crop_rc(&s, rc);
+    mp_image_copy(&d, &s);
+}
+
 void mp_image_vflip(struct mp_image *img)
 {
     for (int p = 0; p < img->num_planes; p++) {
@@ -22,13 +22,31 @@
 #include <pthread.h>
 #include <assert.h>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#define HAVE_HUGEPAGES 1
+#else
+#define HAVE_HUGEPAGES 0
+#endif
+
 #include <libavutil/buffer.h>
+#include <libavutil/cpu.h>
 #include <libavutil/hwcontext.h>
 #include <libavutil/mem.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <smmintrin.h>
+#define HAVE_STREAM_LOAD 1
+#else
+#define HAVE_STREAM_LOAD 0
+#endif
+
 #include "mpv_talloc.h"
 
 #include "common/common.h"
+#include "common/memory.h"
+#include "common/stats.h"
+#include "misc/linked_list.h"
 
 #include "fmt-conversion.h"
 #include "mp_image.h"
@@ -38,6 +56,267 @@ static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
 #define pool_lock() pthread_mutex_lock(&pool_mutex)
 #define pool_unlock() pthread_mutex_unlock(&pool_mutex)
 
+// Process-wide cache of image data buffers. mp_image_alloc() (and thus all
+// mp_image_pools, unless they use a custom allocator) gets its memory from
+// here, and freed buffers are kept for reuse as long as they fit into the
+// memory budget. Buffers are grouped into size classes (4 per power of 2), so
+// an allocation can reuse a buffer that was freed by a completely different
+// component with a slightly different image size. Least recently freed
+// buffers are evicted first.
+// Buffers are released from arbitrary threads, so all of this is locked.
+// Large buffers can be backed by huge pages (Linux only), which reduces TLB
+// misses when processing big frames.
+
+#define BUF_CACHE_MIN_SHIFT 14 // class 0 is (4 << 14) = 64 KiB
+#define BUF_CACHE_CLASSES 60   // keeps class sizes within int
+
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+struct cached_buf {
+    // Stored at the start of the (unused) buffer memory itself.
+    int cls;
+    bool huge;                  // mmap()ed for huge pages
+    struct {
+        struct cached_buf *prev, *next;
+    } lru, bucket;
+};
+
+struct cached_buf_list {
+    struct cached_buf *head, *tail;
+};
+
+static struct {
+    pthread_mutex_t lock;
+    struct mpv_global *global;  // owner of stats (for uninit)
+    struct stats_ctx *stats;
+    struct mp_memory_user *mem;
+    int64_t budget;
+    int64_t cached_bytes;
+    int hugepages;              // MP_HUGEPAGES_*
+    int64_t hugepage_threshold;
+    int live_huge;              // referenced huge page buffers
+    struct cached_buf_list lru; // oldest first
+    struct cached_buf_list buckets[BUF_CACHE_CLASSES];
+} buf_cache = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static int64_t buf_class_size(int cls)
+{
+    return (int64_t)(4 + (cls & 3)) << ((cls >> 2) + BUF_CACHE_MIN_SHIFT);
+}
+
+// Return the smallest class that fits size, or -1 if not cached.
+static int buf_size_to_class(int64_t size)
+{
+    if (size < buf_class_size(0))
+        return -1; // small allocations are not worth it
+    for (int cls = 0; cls < BUF_CACHE_CLASSES; cls++) {
+        if (buf_class_size(cls) >= size)
+            return cls;
+    }
+    return -1;
+}
+
+static uint8_t *buf_alloc_huge(int64_t size, int mode)
+{
+#if HAVE_HUGEPAGES
+    size_t len = MP_ALIGN_UP(size, HUGEPAGE_SIZE);
+    void *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    // Needs preallocated huge pages (vm.nr_hugepages), so this can fail.
+    if (mode == MP_HUGEPAGES_EXPLICIT) {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (p == MAP_FAILED) {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            return NULL;
+#ifdef MADV_HUGEPAGE
+        madvise(p, len, MADV_HUGEPAGE);
+#endif
+    }
+    return p;
+#else
+    return NULL;
+#endif
+}
+
+static void buf_free(uint8_t *data, int cls, bool huge)
+{
+#if HAVE_HUGEPAGES
+    if (huge) {
+        munmap(data, MP_ALIGN_UP(buf_class_size(cls), HUGEPAGE_SIZE));
+        return;
+    }
+#endif
+    av_free(data);
+}
+
+// Caller holds buf_cache.lock.
+static void buf_cache_update_stats(void)
+{
+    if (buf_cache.mem)
+        mp_memory_report(buf_cache.mem, buf_cache.cached_bytes);
+    if (!buf_cache.stats)
+        return;
+    stats_size_value(buf_cache.stats, "cached", buf_cache.cached_bytes);
+    stats_value(buf_cache.stats, "hugepage-frames", buf_cache.live_huge);
+}
+
+// Caller holds buf_cache.lock.
+static void buf_cache_remove(struct cached_buf *b)
+{
+    LL_REMOVE(lru, &buf_cache.lru, b);
+    LL_REMOVE(bucket, &buf_cache.buckets[b->cls], b);
+    buf_cache.cached_bytes -= buf_class_size(b->cls);
+}
+
+// Caller holds buf_cache.lock.
+static void buf_cache_evict(int64_t budget)
+{
+    while (buf_cache.cached_bytes > budget) {
+        struct cached_buf *b = buf_cache.lru.head;
+        buf_cache_remove(b);
+        buf_free((uint8_t *)b, b->cls, b->huge);
+    }
+    buf_cache_update_stats();
+}
+
+// opaque = (cls << 1) | huge
+static void buf_cache_release(void *opaque, uint8_t *data)
+{
+    int cls = (intptr_t)opaque >> 1;
+    bool huge = (intptr_t)opaque & 1;
+
+    pthread_mutex_lock(&buf_cache.lock);
+    if (huge)
+        buf_cache.live_huge--;
+    // Shrink the cache if other memory users leave no room in the global
+    // --memory-budget.
+    int64_t budget = buf_cache.budget;
+    if (buf_cache.mem)
+        budget = MPMIN(budget, mp_memory_get_allowance(buf_cache.mem));
+    if (buf_class_size(cls) <= budget) {
+        struct cached_buf *b = (void *)data;
+        b->cls = cls;
+        b->huge = huge;
+        LL_APPEND(lru, &buf_cache.lru, b);
+        LL_APPEND(bucket, &buf_cache.buckets[cls], b);
+        buf_cache.cached_bytes += buf_class_size(cls);
+        buf_cache_evict(budget);
+    } else if (buf_cache.cached_bytes > budget) {
+        buf_cache_evict(budget);
+        data = NULL;
+    } else {
+        buf_cache_update_stats();
+    }
+    pthread_mutex_unlock(&buf_cache.lock);
+
+    if (data)
+        buf_free(data, cls, huge);
+}
+
+// Allocate a buffer of at least the given size, possibly reusing memory from
+// the process-wide buffer cache. Like av_buffer_alloc(), the memory is
+// uninitialized, and the returned buffer can be larger than requested.
+struct AVBufferRef *mp_image_buffer_alloc(int size)
+{
+    int cls = buf_size_to_class(size);
+    if (cls < 0)
+        return av_buffer_alloc(size);
+
+    struct cached_buf *b = NULL;
+    bool huge = false;
+    pthread_mutex_lock(&buf_cache.lock);
+    // Also accept the next larger class, which wastes at most ~40%.
+    for (int c = cls; c < MPMIN(cls + 2, BUF_CACHE_CLASSES); c++) {
+        // Most recently released buffer, which is most likely still cached.
+        b = buf_cache.buckets[c].tail;
+        if (b) {
+            buf_cache_remove(b);
+            cls = c;
+            huge = b->huge;
+            break;
+        }
+    }
+    int hugepages = buf_cache.hugepages;
+    bool want_huge = hugepages != MP_HUGEPAGES_NO &&
+                     size >= buf_cache.hugepage_threshold;
+    if (buf_cache.stats)
+        stats_event(buf_cache.stats, b ? "hit" : "miss");
+    pthread_mutex_unlock(&buf_cache.lock);
+
+    int64_t alloc_size = buf_class_size(cls);
+    uint8_t *data = (uint8_t *)b;
+    if (!data && want_huge) {
+        data = buf_alloc_huge(alloc_size, hugepages);
+        huge = !!data;
+    }
+    if (!data)
+        data = av_malloc(alloc_size);
+    if (!data)
+        return NULL;
+
+    struct AVBufferRef *ref =
+        av_buffer_create(data, alloc_size, buf_cache_release,
+                         (void *)(intptr_t)((cls << 1) | huge), 0);
+    if (!ref) {
+        buf_free(data, cls, huge);
+        return NULL;
+    }
+
+    if (huge || b) {
+        pthread_mutex_lock(&buf_cache.lock);
+        buf_cache.live_huge += huge;
+        buf_cache_update_stats();
+        pthread_mutex_unlock(&buf_cache.lock);
+    }
+    return ref;
+}
+
+// Set the memory budget of the buffer cache, and report statistics to the
+// given mpv instance. The cache is process-wide, so with multiple instances
+// the last call wins. A budget of 0 disables caching (the default).
+// hugepages is one of MP_HUGEPAGES_*, and applies to new allocations of at
+// least hugepage_threshold bytes.
+void mp_image_buffer_cache_configure(struct mpv_global *global, int64_t budget,
+                                     int hugepages, int64_t hugepage_threshold)
+{
+    pthread_mutex_lock(&buf_cache.lock);
+    if (buf_cache.global != global) {
+        TA_FREEP(&buf_cache.stats);
+        TA_FREEP(&buf_cache.mem);
+        buf_cache.global = global;
+        buf_cache.stats = stats_ctx_create(NULL, global, "image-buffers");
+        buf_cache.mem = mp_memory_user_create(NULL, global, "image-buffers");
+    }
+    buf_cache.budget = budget;
+    buf_cache.hugepages = hugepages;
+    buf_cache.hugepage_threshold = hugepage_threshold;
+    buf_cache_evict(budget);
+    pthread_mutex_unlock(&buf_cache.lock);
+}
+
+// Undo mp_image_buffer_cache_configure() if it was last called with global.
+// This also frees all cached buffers.
+void mp_image_buffer_cache_uninit(struct mpv_global *global)
+{
+    pthread_mutex_lock(&buf_cache.lock);
+    if (buf_cache.global == global) {
+        TA_FREEP(&buf_cache.stats);
+        TA_FREEP(&buf_cache.mem);
+        buf_cache.global = NULL;
+        buf_cache.budget = 0;
+        buf_cache.hugepages = MP_HUGEPAGES_NO;
+        buf_cache_evict(0);
+    }
+    pthread_mutex_unlock(&buf_cache.lock);
+}
+
 // Thread-safety: the pool itself is not thread-safe, but pool-allocated images
 // can be referenced and unreferenced from other threads. (As long as the image
 // destructors are thread-safe.)
@@ -281,6 +560,90 @@ int mp_image_hw_download_get_sw_format(struct mp_image *src)
 // src must be a hw surface with a AVHWFramesContext attached.
 // The returned image is cropped as needed.
 // Returns NULL on failure.
+#if HAVE_STREAM_LOAD
+// Copy with non-temporal (streaming) loads, which are much faster than normal
+// loads when reading from uncached write-combining (USWC) memory, as used by
+// mapped GPU surfaces. Compiled for SSE4.1 via attribute.
+__attribute__((target("sse4.1")))
+static void memcpy_pic_stream_load(void *dst, const void *src, int bytes,
+                                   int height, int dst_stride, int src_stride)
+{
+    _mm_mfence();
+    for (int y = 0; y < height; y++) {
+        uint8_t *d = (uint8_t *)dst + y * (ptrdiff_t)dst_stride;
+        uint8_t *s = (uint8_t *)src + y * (ptrdiff_t)src_stride;
+        int x = MPMIN((16 - ((uintptr_t)s & 15)) & 15, bytes);
+        memcpy(d, s, x);
+        for (; x + 64 <= bytes; x += 64) {
+            __m128i a = _mm_stream_load_si128((void *)(s + x));
+            __m128i b = _mm_stream_load_si128((void *)(s + x + 16));
+            __m128i c = _mm_stream_load_si128((void *)(s + x + 32));
+            __m128i e = _mm_stream_load_si128((void *)(s + x + 48));
+            _mm_storeu_si128((void *)(d + x), a);
+            _mm_storeu_si128((void *)(d + x + 16), b);
+            _mm_storeu_si128((void *)(d + x + 32), c);
+            _mm_storeu_si128((void *)(d + x + 48), e);
+        }
+        for (; x + 16 <= bytes; x += 16)
+            _mm_storeu_si128((void *)(d + x),
+                             _mm_stream_load_si128((void *)(s + x)));
+        memcpy(d + x, s + x, bytes - x);
+    }
+}
+#endif
+
+static void copy_from_mapped(struct mp_image *dst, struct mp_image *src)
+{
+#if HAVE_STREAM_LOAD
+    bool stream = av_get_cpu_flags() & AV_CPU_FLAG_SSE4;
+#endif
+    for (int n = 0; n < dst->num_planes; n++) {
+        int line_bytes = (mp_image_plane_w(dst, n) * dst->fmt.bpp[n] + 7) / 8;
+        int plane_h = mp_image_plane_h(dst, n);
+#if HAVE_STREAM_LOAD
+        if (stream) {
+            memcpy_pic_stream_load(dst->planes[n], src->planes[n], line_bytes,
+                                   plane_h, dst->stride[n], src->stride[n]);
+            continue;
+        }
+#endif
+        memcpy_pic(dst->planes[n], src->planes[n], line_bytes, plane_h,
+                   dst->stride[n], src->stride[n]);
+    }
+}
+
+// Download by mapping the surface and copying from it. Unlike
+// av_hwframe_transfer_data(), this can use a copy suited for reading from
+// uncached memory. Fails if the API does not support mapping.
+static bool hw_download_mapped(struct mp_image *dst, struct mp_image *src)
+{
+    bool ok = false;
+    struct mp_image *map = NULL;
+    AVFrame *srcav = mp_image_to_av_frame(src);
+    AVFrame *mapav = av_frame_alloc();
+    if (!srcav || !mapav)
+        goto done;
+
+    mapav->format = imgfmt2pixfmt(dst->imgfmt);
+    if (av_hwframe_map(mapav, srcav, AV_HWFRAME_MAP_READ) < 0)
+        goto done;
+
+    map = mp_image_from_av_frame(mapav);
+    if (!map || map->imgfmt != dst->imgfmt || map->w < src->w ||
+        map->h < src->h || !mp_image_make_writeable(dst))
+        goto done;
+
+    mp_image_set_size(dst, src->w, src->h);
+    copy_from_mapped(dst, map);
+    ok = true;
+
+done:
+    talloc_free(map);
+    av_frame_free(&mapav);
+    av_frame_free(&srcav);
+    return ok;
+}
+
 struct mp_image *mp_image_hw_download(struct mp_image *src,
                                       struct mp_image_pool *swpool)
 {
@@ -296,6 +659,11 @@ struct mp_image *mp_image_hw_download(struct mp_image *src,
     if (!dst)
         return NULL;
 
+    if (hw_download_mapped(dst, src)) {
+        mp_image_copy_attributes(dst, src);
+        return dst;
+    }
+
     // Target image must be writable, so unref it.
     AVFrame *dstav = mp_image_to_av_frame_and_unref(dst);
     if (!dstav)
@@ -2,8 +2,22 @@
 #define MPV_MP_IMAGE_POOL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 struct mp_image_pool;
+struct mpv_global;
+struct AVBufferRef;
+
+enum {
+    MP_HUGEPAGES_NO,
+    MP_HUGEPAGES_TRANSPARENT,   // madvise(MADV_HUGEPAGE)
+    MP_HUGEPAGES_EXPLICIT,      // MAP_HUGETLB, fallback to transparent
+};
+
+struct AVBufferRef *mp_image_buffer_alloc(int size);
+void mp_image_buffer_cache_configure(struct mpv_global *global, int64_t budget,
+                                     int hugepages, int64_t hugepage_threshold);
+void mp_image_buffer_cache_uninit(struct mpv_global *global);
 
 struct mp_image_pool *mp_image_pool_new(void *tparent);
 struct mp_image *mp_image_pool_get(struct mp_image_pool *pool, int fmt,
@@ -33,7 +47,6 @@ int mp_image_hw_download_get_sw_format(struct mp_image *img);
 
 bool mp_image_hw_upload(struct mp_image *hw_img, struct mp_image *src);
 
-struct AVBufferRef;
 bool mp_update_av_hw_frames_pool(struct AVBufferRef **hw_frames_ctx,
                                  struct AVBufferRef *hw_device_ctx,
                                  int imgfmt, int sw_imgfmt, int w, int h);
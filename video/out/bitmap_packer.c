@@ -124,6 +124,20 @@ static int pack_rectangles(struct pos *in, struct pos *out, int num_rects,
     return num_rects ? -1 : y;
 }
 
+static bool grow(struct bitmap_packer *packer)
+{
+    int w_max = packer->w_max > 0 ? packer->w_max : INT_MAX;
+    int h_max = packer->h_max > 0 ? packer->h_max : INT_MAX;
+    if (packer->w <= packer->h && packer->w != w_max) {
+        packer->w = MPMIN(packer->w * 2, w_max);
+    } else if (packer->h != h_max) {
+        packer->h = MPMIN(packer->h * 2, h_max);
+    } else {
+        return false;
+    }
+    return true;
+}
+
 int packer_pack(struct bitmap_packer *packer)
 {
     if (packer->count == 0)
@@ -131,6 +145,7 @@ int packer_pack(struct bitmap_packer *packer)
     int w_orig = packer->w, h_orig = packer->h;
     struct pos *in = packer->in;
     int xmax = 0, ymax = 0;
+    int64_t area = 0;
     for (int i = 0; i < packer->count; i++) {
         if (in[i].x <= 0 || in[i].y <= 0) {
             in[i] = (struct pos){0, 0};
@@ -144,11 +159,17 @@ int packer_pack(struct bitmap_packer *packer)
         }
         xmax = MPMAX(xmax, in[i].x);
         ymax = MPMAX(ymax, in[i].y);
+        area += in[i].x * (int64_t)in[i].y;
     }
     if (xmax > packer->w)
         packer->w = 1 << (mp_log2(xmax - 1) + 1);
     if (ymax > packer->h)
         packer->h = 1 << (mp_log2(ymax - 1) + 1);
+    // Start with a size that is likely to fit, instead of packing again after
+    // each doubling. The packer rarely wastes more than 1/8 of the area (not
+    // counting the unused part of the power-of-2 surface).
+    area += area / 8;
+    while (packer->w * (int64_t)packer->h < area && grow(packer)) {}
     while (1) {
         int used_width = 0;
         int y = pack_rectangles(in, packer->result, packer->count,
@@ -167,13 +188,7 @@ int packer_pack(struct bitmap_packer *packer)
             }
             return packer->w != w_orig || packer->h != h_orig;
         }
-        int w_max = packer->w_max > 0 ? packer->w_max : INT_MAX;
-        int h_max = packer->h_max > 0 ? packer->h_max : INT_MAX;
-        if (packer->w <= packer->h && packer->w != w_max)
-            packer->w = MPMIN(packer->w * 2, w_max);
-        else if (packer->h != h_max)
-            packer->h = MPMIN(packer->h * 2, h_max);
-        else {
+        if (!grow(packer)) {
             packer->w = w_orig;
             packer->h = h_orig;
             return -1;
@@ -19,6 +19,8 @@
 #include <d3d11.h>
 #include <d3d11_1.h>
 
+#include <libavutil/pixfmt.h>
+
 #include "config.h"
 
 #include "common/common.h"
@@ -26,6 +28,7 @@
 #include "osdep/windows_utils.h"
 #include "video/hwdec.h"
 #include "video/d3d.h"
+#include "video/fmt-conversion.h"
 #include "video/out/d3d11/ra_d3d11.h"
 #include "video/out/gpu/hwdec.h"
 
@@ -51,6 +54,7 @@ struct priv_owner {
     struct mp_hwdec_ctx hwctx;
     ID3D11Device *device;
     ID3D11Device1 *device1;
+    int subfmts[4];
 };
 
 struct priv {
@@ -61,8 +65,25 @@ struct priv {
     // zero-copy path
     int num_planes;
     const struct ra_format *fmt[4];
+    // Views of the decoder texture array, indexed by array slice. Decoders
+    // allocate all surfaces from one array, so these can be reused for each
+    // frame instead of creating new shader resource views on every map.
+    ID3D11Texture2D *view_array; // not referenced (the views hold refs)
+    int num_view_slices;
+    struct ra_tex *(*views)[4];
 };
 
+static DXGI_FORMAT get_copy_format(int imgfmt)
+{
+    switch (imgfmt) {
+    case IMGFMT_NV12: return DXGI_FORMAT_NV12;
+    case IMGFMT_P010: return DXGI_FORMAT_P010;
+    }
+    if (imgfmt && imgfmt == pixfmt2imgfmt(AV_PIX_FMT_P016))
+        return DXGI_FORMAT_P016;
+    return DXGI_FORMAT_UNKNOWN;
+}
+
 static void uninit(struct ra_hwdec *hw)
 {
     struct priv_owner *p = hw->priv;
@@ -104,20 +125,40 @@ static int init(struct ra_hwdec *hw)
     ID3D10Multithread_SetMultithreadProtected(multithread, TRUE);
     ID3D10Multithread_Release(multithread);
 
-    static const int subfmts[] = {IMGFMT_NV12, IMGFMT_P010, 0};
+    int num_subfmts = 0;
+    p->subfmts[num_subfmts++] = IMGFMT_NV12;
+    p->subfmts[num_subfmts++] = IMGFMT_P010;
+    int p016 = pixfmt2imgfmt(AV_PIX_FMT_P016);
+    if (p016)
+        p->subfmts[num_subfmts++] = p016;
+    p->subfmts[num_subfmts] = 0;
+
     p->hwctx = (struct mp_hwdec_ctx){
         .driver_name = hw->driver->name,
         .av_device_ref = d3d11_wrap_device_ref(p->device),
-        .supported_formats = subfmts,
+        .supported_formats = p->subfmts,
         .hw_imgfmt = IMGFMT_D3D11,
     };
     hwdec_devices_add(hw->devs, &p->hwctx);
     return 0;
 }
 
+static void flush_views(struct ra_hwdec_mapper *mapper)
+{
+    struct priv *p = mapper->priv;
+    for (int n = 0; n < p->num_view_slices; n++) {
+        for (int i = 0; i < 4; i++)
+            ra_tex_free(mapper->ra, &p->views[n][i]);
+    }
+    TA_FREEP(&p->views);
+    p->num_view_slices = 0;
+    p->view_array = NULL;
+}
+
 static void mapper_uninit(struct ra_hwdec_mapper *mapper)
 {
     struct priv *p = mapper->priv;
+    flush_views(mapper);
     for (int i = 0; i < 4; i++)
         ra_tex_free(mapper->ra, &mapper->tex[i]);
     SAFE_RELEASE(p->copy_tex);
@@ -149,12 +190,9 @@ static int mapper_init(struct ra_hwdec_mapper *mapper)
         struct mp_image layout = {0};
         mp_image_set_params(&layout, &mapper->dst_params);
 
-        DXGI_FORMAT copy_fmt;
-        switch (mapper->dst_params.imgfmt) {
-        case IMGFMT_NV12: copy_fmt = DXGI_FORMAT_NV12; break;
-        case IMGFMT_P010: copy_fmt = DXGI_FORMAT_P010; break;
-        default: return -1;
-        }
+        DXGI_FORMAT copy_fmt = get_copy_format(mapper->dst_params.imgfmt);
+        if (copy_fmt == DXGI_FORMAT_UNKNOWN)
+            return -1;
 
         D3D11_TEXTURE2D_DESC copy_desc = {
             .Width = mapper->dst_params.w,
@@ -213,17 +251,32 @@ static int mapper_map(struct ra_hwdec_mapper *mapper)
         D3D11_TEXTURE2D_DESC desc2d;
         ID3D11Texture2D_GetDesc(tex, &desc2d);
 
+        // A new decoder texture array (e.g. after decoder reinit) makes all
+        // views of the old one useless.
+        if (tex != p->view_array || subresource >= p->num_view_slices) {
+            flush_views(mapper);
+            p->view_array = tex;
+            p->num_view_slices = MPMAX(desc2d.ArraySize, subresource + 1);
+            p->views = talloc_zero_array(p, struct ra_tex *[4],
+                                         p->num_view_slices);
+        }
+
+        struct ra_tex **views = p->views[subresource];
         for (int i = 0; i < p->num_planes; i++) {
-            // The video decode texture may include padding, so the size of the
-            // ra_tex needs to be determined by the actual size of the Tex2D
-            bool chroma = i >= 1;
-            int w = desc2d.Width / (chroma ? 2 : 1);
-            int h = desc2d.Height / (chroma ? 2 : 1);
-
-            mapper->tex[i] = ra_d3d11_wrap_tex_video(mapper->ra, tex,
-                w, h, subresource, p->fmt[i]);
-            if (!mapper->tex[i])
-                return -1;
+            if (!views[i]) {
+                // The video decode texture may include padding, so the size of
+                // the ra_tex needs to be determined by the actual size of the
+                // Tex2D
+                bool chroma = i >= 1;
+                int w = desc2d.Width / (chroma ? 2 : 1);
+                int h = desc2d.Height / (chroma ? 2 : 1);
+
+                views[i] = ra_d3d11_wrap_tex_video(mapper->ra, tex,
+                    w, h, subresource, p->fmt[i]);
+                if (!views[i])
+                    return -1;
+            }
+            mapper->tex[i] = views[i];
         }
     }
 
@@ -235,8 +288,9 @@ static void mapper_unmap(struct ra_hwdec_mapper *mapper)
     struct priv *p = mapper->priv;
     if (p->copy_tex)
         return;
+    // The textures are owned by the view cache.
     for (int i = 0; i < 4; i++)
-        ra_tex_free(mapper->ra, &mapper->tex[i]);
+        mapper->tex[i] = NULL;
 }
 
 const struct ra_hwdec_driver ra_hwdec_d3d11va = {
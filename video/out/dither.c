@@ -27,6 +27,7 @@
 #include <string.h>
 #include <assert.h>
 #include <math.h>
+#include <pthread.h>
 
 #include <libavutil/lfg.h>
 
@@ -148,18 +149,34 @@ static void makeuniform(struct ctx *k)
     }
 }
 
+// Generated matrices, indexed by size. Generating a large matrix takes a
+// noticeable amount of time, and the VO does it on every reinit, so keep them
+// around for the lifetime of the process. (At most ~350 KB for all sizes.)
+static pthread_mutex_t fruit_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static float *fruit_cache[MAX_SIZEB + 1];
+
 // out_matrix is a reactangular tsize * tsize array, where tsize = (1 << size).
 void mp_make_fruit_dither_matrix(float *out_matrix, int size)
 {
-    struct ctx *k = talloc_zero(NULL, struct ctx);
-    makegauss(k, size);
-    makeuniform(k);
-    float invscale = k->size2;
-    for(unsigned int y = 0; y < k->size; y++) {
-        for(unsigned int x = 0; x < k->size; x++)
-            out_matrix[x + y * k->size] = k->unimat[XY(k, x, y)] / invscale;
+    assert(size >= 1 && size <= MAX_SIZEB);
+    unsigned int size2 = 1u << (2 * size);
+
+    pthread_mutex_lock(&fruit_cache_lock);
+    if (!fruit_cache[size]) {
+        struct ctx *k = talloc_zero(NULL, struct ctx);
+        makegauss(k, size);
+        makeuniform(k);
+        float *m = talloc_array(NULL, float, size2);
+        float invscale = k->size2;
+        for(unsigned int y = 0; y < k->size; y++) {
+            for(unsigned int x = 0; x < k->size; x++)
+                m[x + y * k->size] = k->unimat[XY(k, x, y)] / invscale;
+        }
+        talloc_free(k);
+        fruit_cache[size] = m;
     }
-    talloc_free(k);
+    memcpy(out_matrix, fruit_cache[size], size2 * sizeof(float));
+    pthread_mutex_unlock(&fruit_cache_lock);
 }
 
 void mp_make_ordered_dither_matrix(unsigned char *m, int size)
@@ -58,24 +58,39 @@ const struct error_diffusion_kernel *mp_find_error_diffusion_kernel(const char *
     return NULL;
 }
 
+// Compute the number of rows each workgroup processes (rows, including the
+// warm-up rows), and the number of output rows it writes (out_rows). The
+// workgroup size is rows.
+void mp_ef_stripe_layout(int height, int max_threads, int *rows, int *out_rows)
+{
+    int limit = MPMIN(EF_STRIPE_ROWS, max_threads);
+    if (height <= limit) {
+        *rows = *out_rows = height;
+    } else {
+        *rows = limit;
+        *out_rows = limit - EF_WARMUP_ROWS;
+    }
+}
+
 int mp_ef_compute_shared_memory_size(const struct error_diffusion_kernel *k,
-                                     int height)
+                                     int rows)
 {
     // We add EF_MAX_DELTA_Y empty lines on the bottom to handle errors
     // propagated out from bottom side.
-    int rows = height + EF_MAX_DELTA_Y;
+    int ring_rows = rows + EF_MAX_DELTA_Y;
     int shifted_columns = compute_rightmost_shifted_column(k) + 1;
 
-    // The shared memory is an array of size rows*shifted_columns. Each element
-    // is a single uint for three RGB component.
-    return rows * shifted_columns * 4;
+    // The shared memory is an array of size ring_rows*shifted_columns. Each
+    // element is a single uint for three RGB component.
+    return ring_rows * shifted_columns * 4;
 }
 
 void pass_error_diffusion(struct gl_shader_cache *sc,
                           const struct error_diffusion_kernel *k,
-                          int tex, int width, int height, int depth, int block_size)
+                          int tex, int width, int height, int depth,
+                          int rows, int out_rows)
 {
-    assert(block_size <= height);
+    assert(rows <= height);
 
     // The parallel error diffusion works by applying the shift mapping first.
     // Taking the Floyd and Steinberg algorithm for example. After applying
@@ -85,22 +100,28 @@ void pass_error_diffusion(struct gl_shader_cache *sc,
     //
     //           X    7/16                X    7/16
     //    3/16  5/16  1/16   ==>    0     0    3/16  5/16  1/16
+    //
+    // Each workgroup does this for its own stripe of |rows| rows, starting
+    // |rows - out_rows| warm-up rows above the |out_rows| rows it writes.
+    // Stripes are independent, so all of them run in parallel.
 
     // Figuring out the size of rectangle containing all shifted pixels.
     // The rectangle height is not changed.
-    int shifted_width = width + (height - 1) * k->shift;
+    int shifted_width = width + (rows - 1) * k->shift;
 
     // We process all pixels from the shifted rectangles column by column, with
-    // a single global work group of size |block_size|.
-    // Figuring out how many block are required to process all pixels. We need
-    // this explicitly to make the number of barrier() calls match.
-    int blocks = (height * shifted_width + block_size - 1) / block_size;
+    // one work group of size |rows| per stripe, so each column is a single
+    // block. We need the number of blocks explicitly to make the number of
+    // barrier() calls match.
+    int block_size = rows;
+    int blocks = shifted_width;
+    int warmup = rows - out_rows;
 
     // If we figure out how many of the next columns will be affected while the
     // current columns is being processed. We can store errors of only a few
     // columns in the shared memory. Using a ring buffer will further save the
     // cost while iterating to next column.
-    int ring_buffer_rows = height + EF_MAX_DELTA_Y;
+    int ring_buffer_rows = rows + EF_MAX_DELTA_Y;
     int ring_buffer_columns = compute_rightmost_shifted_column(k) + 1;
     int ring_buffer_size = ring_buffer_rows * ring_buffer_columns;
 
@@ -122,17 +143,18 @@ void pass_error_diffusion(struct gl_shader_cache *sc,
     // Compute the coordinate of the pixel we are currently processing, both
     // before and after the shift mapping.
     GLSL("int id = int(gl_LocalInvocationIndex) + block_id * %d;\n", block_size);
-    GLSL("int y = id %% %d, x_shifted = id / %d;\n", height, height);
+    GLSL("int y = id %% %d, x_shifted = id / %d;\n", rows, rows);
     GLSL("int x = x_shifted - y * %d;\n", k->shift);
+    GLSL("int y_img = y + int(gl_WorkGroupID.y) * %d - %d;\n", out_rows, warmup);
 
     // Proceed only if we are processing a valid pixel.
-    GLSL("if (0 <= x && x < %d) {\n", width);
+    GLSL("if (0 <= x && x < %d && 0 <= y_img && y_img < %d) {\n", width, height);
 
     // The index that the current pixel have on the ring buffer.
     GLSL("int idx = (x_shifted * %d + y) %% %d;\n", ring_buffer_rows, ring_buffer_size);
 
     // Fetch the current pixel.
-    GLSL("vec3 pix = texelFetch(texture%d, ivec2(x, y), 0).rgb;\n", tex);
+    GLSL("vec3 pix = texelFetch(texture%d, ivec2(x, y_img), 0).rgb;\n", tex);
 
     // The dithering will quantize pixel value into multiples of 1/dither_quant.
     int dither_quant = (1 << depth) - 1;
@@ -172,9 +194,11 @@ void pass_error_diffusion(struct gl_shader_cache *sc,
          ") / %d.0;\n", dither_quant, bitshift_r, bitshift_g, uint8_mul);
     GLSL("err_rgb8[idx] = 0u;\n");
 
-    // Write the dithered pixel.
+    // Write the dithered pixel, unless it's a warm-up row (which belongs to
+    // the previous stripe).
     GLSL("vec3 dithered = round(pix);\n");
-    GLSL("imageStore(out_image, ivec2(x, y), vec4(dithered / %d.0, 0.0));\n",
+    GLSL("if (y >= %d) ", warmup);
+    GLSL("imageStore(out_image, ivec2(x, y_img), vec4(dithered / %d.0, 0.0));\n",
          dither_quant);
 
     GLSL("vec3 err_divided = (pix - dithered) * %d.0 / %d.0;\n",
@@ -221,7 +245,7 @@ void pass_error_diffusion(struct gl_shader_cache *sc,
         }
     }
 
-    GLSL("}\n"); // if (0 <= x && x < width)
+    GLSL("}\n"); // if (0 <= x && x < width && 0 <= y_img && y_img < height)
 
     GLSL("}\n"); // block_id
 }
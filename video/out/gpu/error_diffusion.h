@@ -25,6 +25,13 @@
 #define EF_MAX_DELTA_X  (2)
 #define EF_MAX_DELTA_Y  (2)
 
+// Tall outputs are split into horizontal stripes of at most EF_STRIPE_ROWS
+// rows, each processed by its own workgroup. Every stripe but the first also
+// processes EF_WARMUP_ROWS rows above it (without writing them), so the errors
+// propagated into its first row are close to those of a single pass.
+#define EF_STRIPE_ROWS 256
+#define EF_WARMUP_ROWS 16
+
 struct error_diffusion_kernel {
     const char *name;
 
@@ -40,9 +47,11 @@ struct error_diffusion_kernel {
 extern const struct error_diffusion_kernel mp_error_diffusion_kernels[];
 
 const struct error_diffusion_kernel *mp_find_error_diffusion_kernel(const char *name);
-int mp_ef_compute_shared_memory_size(const struct error_diffusion_kernel *k, int height);
+void mp_ef_stripe_layout(int height, int max_threads, int *rows, int *out_rows);
+int mp_ef_compute_shared_memory_size(const struct error_diffusion_kernel *k, int rows);
 void pass_error_diffusion(struct gl_shader_cache *sc,
                           const struct error_diffusion_kernel *k,
-                          int tex, int width, int height, int depth, int block_size);
+                          int tex, int width, int height, int depth,
+                          int rows, int out_rows);
 
 #endif /* MP_GL_ERROR_DIFFUSION */
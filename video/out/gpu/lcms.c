@@ -17,6 +17,7 @@
 
 #include <string.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "mpv_talloc.h"
 
@@ -29,16 +30,47 @@
 #include "options/m_option.h"
 #include "options/path.h"
 #include "video/csputils.h"
+#include "misc/thread_pool.h"
+#include "osdep/atomic.h"
+#include "osdep/timer.h"
 #include "lcms.h"
+#include "shader_cache.h"
 
 #include "osdep/io.h"
 
 #if HAVE_LCMS2
 
 #include <lcms2.h>
+#include <libavutil/cpu.h>
 #include <libavutil/sha.h>
 #include <libavutil/mem.h>
 
+// Maximum number of threads a single LUT is computed with.
+#define MAX_SLICES 16
+
+// Everything needed to compute a LUT, copied from gl_lcms at request time, so
+// that the worker thread doesn't access any state owned by the VO thread.
+struct lut3d_job {
+    struct gl_lcms *owner;
+    struct mp_log *log;
+    struct mpv_global *global;
+    void *icc_data;
+    size_t icc_size;
+    struct AVBufferRef *vid_profile;
+    bool use_embedded;
+    int intent;
+    int contrast;
+    int size[3];
+    enum mp_csp_prim prim;
+    enum mp_csp_trc trc;
+    char *cache_file;       // write the result here (or NULL)
+    atomic_bool cancel;     // result is not needed anymore
+
+    // -- protected by owner->lock
+    bool done;
+    struct lut3d *result;   // NULL on failure
+};
+
 struct gl_lcms {
     void *icc_data;
     size_t icc_size;
@@ -52,6 +84,14 @@ struct gl_lcms {
     struct mp_log *log;
     struct mpv_global *global;
     struct mp_icc_opts *opts;
+
+    struct mp_thread_pool *pool;    // runs lut3d_job
+    void (*wakeup_cb)(void *ctx);
+    void *wakeup_ctx;
+
+    pthread_mutex_t lock;
+    // -- protected by lock
+    struct lut3d_job *job;          // latest request, until collected
 };
 
 static int validate_3dlut_size_opt(struct mp_log *log, const m_option_t *opt,
@@ -71,6 +111,8 @@ const struct m_sub_options mp_icc_conf = {
         {"icc-profile", OPT_STRING(profile), .flags = M_OPT_FILE},
         {"icc-profile-auto", OPT_FLAG(profile_auto)},
         {"icc-cache-dir", OPT_STRING(cache_dir), .flags = M_OPT_FILE},
+        {"icc-cache-size", OPT_BYTE_SIZE(cache_size),
+            M_RANGE(0, M_MAX_MEM_BYTES)},
         {"icc-intent", OPT_INT(intent)},
         {"icc-force-contrast", OPT_CHOICE(contrast, {"no", 0}, {"inf", -1}),
             M_RANGE(0, 1000000)},
@@ -83,6 +125,7 @@ const struct m_sub_options mp_icc_conf = {
     .size = sizeof(struct mp_icc_opts),
     .defaults = &(const struct mp_icc_opts) {
         .size_str = "64x64x64",
+        .cache_size = 256 * 1024 * 1024,
         .intent = INTENT_RELATIVE_COLORIMETRIC,
         .use_embedded = true,
     },
@@ -91,8 +134,8 @@ const struct m_sub_options mp_icc_conf = {
 static void lcms2_error_handler(cmsContext ctx, cmsUInt32Number code,
                                 const char *msg)
 {
-    struct gl_lcms *p = cmsGetContextUserData(ctx);
-    MP_ERR(p, "lcms2: %s\n", msg);
+    struct lut3d_job *job = cmsGetContextUserData(ctx);
+    MP_ERR(job, "lcms2: %s\n", msg);
 }
 
 static void load_profile(struct gl_lcms *p)
@@ -122,10 +165,44 @@ static void load_profile(struct gl_lcms *p)
     p->current_profile = talloc_strdup(p, p->opts->profile);
 }
 
+static void free_job(struct lut3d_job *job)
+{
+    if (!job)
+        return;
+    av_buffer_unref(&job->vid_profile);
+    talloc_free(job->result);
+    talloc_free(job);
+}
+
 static void gl_lcms_destructor(void *ptr)
 {
     struct gl_lcms *p = ptr;
+
+    pthread_mutex_lock(&p->lock);
+    if (p->job)
+        atomic_store(&p->job->cancel, true);
+    p->wakeup_cb = NULL;
+    pthread_mutex_unlock(&p->lock);
+
+    // Waits for all jobs; stale ones free themselves.
+    talloc_free(p->pool);
+    free_job(p->job);
+
     av_buffer_unref(&p->vid_profile);
+    pthread_mutex_destroy(&p->lock);
+}
+
+struct trim_job {
+    struct mp_log *log;
+    char *dir;
+    int64_t max_bytes;
+};
+
+static void run_trim(void *ptr)
+{
+    struct trim_job *job = ptr;
+    gl_sc_trim_cache_dir(job->log, job->dir, job->max_bytes);
+    talloc_free(job);
 }
 
 struct gl_lcms *gl_lcms_init(void *talloc_ctx, struct mp_log *log,
@@ -139,10 +216,33 @@ struct gl_lcms *gl_lcms_init(void *talloc_ctx, struct mp_log *log,
         .log = log,
         .opts = opts,
     };
+    pthread_mutex_init(&p->lock, NULL);
+    p->pool = mp_thread_pool_create(NULL, 0, 0, 1);
     gl_lcms_update_options(p);
+
+    if (opts->cache_dir && opts->cache_dir[0] && opts->cache_size > 0) {
+        struct trim_job *job = talloc_ptrtype(NULL, job);
+        *job = (struct trim_job){
+            .log = log,
+            .dir = mp_get_user_path(job, global, opts->cache_dir),
+            .max_bytes = opts->cache_size,
+        };
+        if (!mp_thread_pool_queue(p->pool, run_trim, job))
+            talloc_free(job);
+    }
     return p;
 }
 
+// cb is called from a worker thread when a LUT requested with
+// gl_lcms_request_lut3d() is ready (or failed).
+void gl_lcms_set_wakeup_cb(struct gl_lcms *p, void (*cb)(void *ctx), void *ctx)
+{
+    pthread_mutex_lock(&p->lock);
+    p->wakeup_cb = cb;
+    p->wakeup_ctx = ctx;
+    pthread_mutex_unlock(&p->lock);
+}
+
 void gl_lcms_update_options(struct gl_lcms *p)
 {
     if ((p->using_memory_profile && !p->opts->profile_auto) ||
@@ -195,7 +295,7 @@ static bool vid_profile_eq(struct AVBufferRef *a, struct AVBufferRef *b)
 }
 
 // Return whether the profile or config has changed since the last time it was
-// retrieved. If it has changed, gl_lcms_get_lut3d() should be called.
+// retrieved. If it has changed, gl_lcms_request_lut3d() should be called.
 bool gl_lcms_has_changed(struct gl_lcms *p, enum mp_csp_prim prim,
                          enum mp_csp_trc trc, struct AVBufferRef *vid_profile)
 {
@@ -205,28 +305,29 @@ bool gl_lcms_has_changed(struct gl_lcms *p, enum mp_csp_prim prim,
     return !vid_profile_eq(p->vid_profile, vid_profile);
 }
 
-// Whether a profile is set. (gl_lcms_get_lut3d() is expected to return a lut,
-// but it could still fail due to runtime errors, such as invalid icc data.)
+// Whether a profile is set. (gl_lcms_request_lut3d() is expected to produce a
+// lut, but it could still fail due to runtime errors, such as invalid icc
+// data.)
 bool gl_lcms_has_profile(struct gl_lcms *p)
 {
     return p->icc_size > 0;
 }
 
-static cmsHPROFILE get_vid_profile(struct gl_lcms *p, cmsContext cms,
+static cmsHPROFILE get_vid_profile(struct lut3d_job *job, cmsContext cms,
                                    cmsHPROFILE disp_profile,
                                    enum mp_csp_prim prim, enum mp_csp_trc trc)
 {
-    if (p->opts->use_embedded && p->vid_profile) {
+    if (job->use_embedded && job->vid_profile) {
         // Try using the embedded ICC profile
-        cmsHPROFILE prof = cmsOpenProfileFromMemTHR(cms, p->vid_profile->data,
-                                                    p->vid_profile->size);
+        cmsHPROFILE prof = cmsOpenProfileFromMemTHR(cms, job->vid_profile->data,
+                                                    job->vid_profile->size);
         if (prof) {
-            MP_VERBOSE(p, "Successfully opened embedded ICC profile\n");
+            MP_VERBOSE(job, "Successfully opened embedded ICC profile\n");
             return prof;
         }
 
         // Otherwise, warn the user and generate the profile as usual
-        MP_WARN(p, "Video contained an invalid ICC profile! Ignoring...\n");
+        MP_WARN(job, "Video contained an invalid ICC profile! Ignoring...\n");
     }
 
     // The input profile for the transformation is dependent on the video
@@ -262,14 +363,14 @@ static cmsHPROFILE get_vid_profile(struct gl_lcms *p, cmsContext cms,
 
     case MP_CSP_TRC_BT_1886: {
         double src_black[3];
-        if (p->opts->contrast < 0) {
+        if (job->contrast < 0) {
             // User requested infinite contrast, return 2.4 profile
             tonecurve[0] = cmsBuildGamma(cms, 2.4);
             break;
-        } else if (p->opts->contrast > 0) {
-            MP_VERBOSE(p, "Using specified contrast: %d\n", p->opts->contrast);
+        } else if (job->contrast > 0) {
+            MP_VERBOSE(job, "Using specified contrast: %d\n", job->contrast);
             for (int i = 0; i < 3; i++)
-                src_black[i] = 1.0 / p->opts->contrast;
+                src_black[i] = 1.0 / job->contrast;
         } else {
             // To build an appropriate BT.1886 transformation we need access to
             // the display's black point, so we use LittleCMS' detection
@@ -300,7 +401,7 @@ static cmsHPROFILE get_vid_profile(struct gl_lcms *p, cmsContext cms,
             cmsDeleteTransform(xyz2src);
 
             double contrast = 3.0 / (src_black[0] + src_black[1] + src_black[2]);
-            MP_VERBOSE(p, "Detected ICC profile contrast: %f\n", contrast);
+            MP_VERBOSE(job, "Detected ICC profile contrast: %f\n", contrast);
         }
 
         // Build the parametric BT.1886 transfer curve, one per channel
@@ -333,12 +434,162 @@ static cmsHPROFILE get_vid_profile(struct gl_lcms *p, cmsContext cms,
     return vid_profile;
 }
 
-bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
-                       enum mp_csp_prim prim, enum mp_csp_trc trc,
-                       struct AVBufferRef *vid_profile)
+struct lut3d_slice {
+    struct lut3d_job *job;
+    cmsHTRANSFORM trafo;
+    uint16_t *output;
+    int b0, b1;             // range of the blue axis to compute
+};
+
+// Transform a part of the (s_r)x(s_g)x(s_b) cube, with 3 components per
+// channel. Transforms created with cmsFLAGS_NOCACHE can be shared between
+// threads.
+static void compute_slice(void *ptr, int index)
+{
+    struct lut3d_slice *sl = &((struct lut3d_slice *)ptr)[index];
+    int s_r = sl->job->size[0], s_g = sl->job->size[1], s_b = sl->job->size[2];
+    uint16_t *input = talloc_array(NULL, uint16_t, s_r * 3);
+    for (int b = sl->b0; b < sl->b1; b++) {
+        if (atomic_load(&sl->job->cancel))
+            break;
+        for (int g = 0; g < s_g; g++) {
+            for (int r = 0; r < s_r; r++) {
+                input[r * 3 + 0] = r * 65535 / (s_r - 1);
+                input[r * 3 + 1] = g * 65535 / (s_g - 1);
+                input[r * 3 + 2] = b * 65535 / (s_b - 1);
+            }
+            size_t base = (b * s_r * s_g + g * s_r) * 4;
+            cmsDoTransform(sl->trafo, input, sl->output + base, s_r);
+        }
+    }
+    talloc_free(input);
+}
+
+static struct lut3d *alloc_lut3d(struct lut3d_job *job)
+{
+    struct lut3d *lut = talloc_ptrtype(NULL, lut);
+    *lut = (struct lut3d) {
+        .data = talloc_array(lut, uint16_t,
+                             job->size[0] * job->size[1] * job->size[2] * 4),
+        .size = {job->size[0], job->size[1], job->size[2]},
+        .prim = job->prim,
+        .trc = job->trc,
+    };
+    return lut;
+}
+
+static struct lut3d *compute_lut3d(struct lut3d_job *job)
+{
+    struct lut3d *lut = NULL;
+    int64_t start = mp_time_us();
+
+    cmsContext cms = cmsCreateContext(NULL, job);
+    if (!cms)
+        goto error_exit;
+    cmsSetLogErrorHandlerTHR(cms, lcms2_error_handler);
+
+    cmsHPROFILE profile =
+        cmsOpenProfileFromMemTHR(cms, job->icc_data, job->icc_size);
+    if (!profile)
+        goto error_exit;
+
+    cmsHPROFILE vid_hprofile = get_vid_profile(job, cms, profile, job->prim,
+                                               job->trc);
+    if (!vid_hprofile) {
+        cmsCloseProfile(profile);
+        goto error_exit;
+    }
+
+    cmsHTRANSFORM trafo = cmsCreateTransformTHR(cms, vid_hprofile, TYPE_RGB_16,
+                                                profile, TYPE_RGBA_16,
+                                                job->intent,
+                                                cmsFLAGS_NOCACHE |
+                                                cmsFLAGS_NOOPTIMIZE |
+                                                cmsFLAGS_BLACKPOINTCOMPENSATION);
+    cmsCloseProfile(profile);
+    cmsCloseProfile(vid_hprofile);
+
+    if (!trafo)
+        goto error_exit;
+
+    lut = alloc_lut3d(job);
+
+    // Split the cube along the blue axis. This thread computes slices too.
+    int num_slices = MPCLAMP(MPMIN(av_cpu_count(), job->size[2]), 1, MAX_SLICES);
+    struct lut3d_slice slices[MAX_SLICES];
+    for (int n = 0; n < num_slices; n++) {
+        slices[n] = (struct lut3d_slice){
+            .job = job,
+            .trafo = trafo,
+            .output = lut->data,
+            .b0 = job->size[2] * n / num_slices,
+            .b1 = job->size[2] * (n + 1) / num_slices,
+        };
+    }
+    struct mp_thread_pool *pool =
+        mp_thread_pool_create(NULL, 0, 0, MPMAX(num_slices - 1, 1));
+    mp_thread_pool_parallel_for(pool, num_slices, compute_slice, slices);
+    talloc_free(pool);
+
+    cmsDeleteTransform(trafo);
+
+    if (atomic_load(&job->cancel)) {
+        TA_FREEP(&lut);
+        goto error_exit;
+    }
+
+    MP_VERBOSE(job, "Computed %dx%dx%d 3D LUT with %d threads in %.3f s.\n",
+               job->size[0], job->size[1], job->size[2], num_slices,
+               (mp_time_us() - start) / 1e6);
+
+    if (job->cache_file) {
+        FILE *out = fopen(job->cache_file, "wb");
+        if (out) {
+            fwrite(lut->data, talloc_get_size(lut->data), 1, out);
+            fclose(out);
+        }
+    }
+
+error_exit:
+
+    if (cms)
+        cmsDeleteContext(cms);
+
+    if (!lut && !atomic_load(&job->cancel))
+        MP_FATAL(job, "Error loading ICC profile.\n");
+
+    return lut;
+}
+
+static void run_job(void *ptr)
+{
+    struct lut3d_job *job = ptr;
+    struct gl_lcms *p = job->owner;
+
+    struct lut3d *lut = atomic_load(&job->cancel) ? NULL : compute_lut3d(job);
+
+    pthread_mutex_lock(&p->lock);
+    job->result = lut;
+    job->done = true;
+    bool stale = p->job != job;
+    if (!stale && p->wakeup_cb)
+        p->wakeup_cb(p->wakeup_ctx);
+    pthread_mutex_unlock(&p->lock);
+
+    if (stale)
+        free_job(job);
+}
+
+// Start computing the 3D LUT for the given parameters, and cancel any request
+// still in progress. If the LUT is in the cache, it's loaded immediately, and
+// *result_lut3d is set. The caller gets ownership of the returned LUT.
+bool gl_lcms_request_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
+                           enum mp_csp_prim prim, enum mp_csp_trc trc,
+                           struct AVBufferRef *vid_profile)
 {
     int s_r, s_g, s_b;
-    bool result = false;
+
+    *result_lut3d = NULL;
 
     p->changed = false;
     p->current_prim = prim;
@@ -355,23 +606,46 @@ bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
             abort();
     }
 
+    pthread_mutex_lock(&p->lock);
+    if (p->job && !p->job->done) {
+        atomic_store(&p->job->cancel, true);
+    } else {
+        free_job(p->job);
+    }
+    p->job = NULL;
+    pthread_mutex_unlock(&p->lock);
+
     if (!gl_parse_3dlut_size(p->opts->size_str, &s_r, &s_g, &s_b))
         return false;
 
     if (!gl_lcms_has_profile(p))
         return false;
 
-    void *tmp = talloc_new(NULL);
-    uint16_t *output = talloc_array(tmp, uint16_t, s_r * s_g * s_b * 4);
-    struct lut3d *lut = NULL;
-    cmsContext cms = NULL;
+    struct lut3d_job *job = talloc_ptrtype(NULL, job);
+    *job = (struct lut3d_job){
+        .owner = p,
+        .log = p->log,
+        .global = p->global,
+        .icc_data = talloc_memdup(job, p->icc_data, p->icc_size),
+        .icc_size = p->icc_size,
+        .use_embedded = p->opts->use_embedded,
+        .intent = p->opts->intent,
+        .contrast = p->opts->contrast,
+        .size = {s_r, s_g, s_b},
+        .prim = prim,
+        .trc = trc,
+    };
+    if (p->vid_profile) {
+        job->vid_profile = av_buffer_ref(p->vid_profile);
+        if (!job->vid_profile)
+            abort();
+    }
 
-    char *cache_file = NULL;
     if (p->opts->cache_dir && p->opts->cache_dir[0]) {
         // Gamma is included in the header to help uniquely identify it,
         // because we may change the parameter in the future or make it
         // customizable, same for the primaries.
-        char *cache_info = talloc_asprintf(tmp,
+        char *cache_info = talloc_asprintf(job,
                 "ver=1.4, intent=%d, size=%dx%dx%d, prim=%d, trc=%d, "
                 "contrast=%d\n",
                 p->opts->intent, s_r, s_g, s_b, prim, trc, p->opts->contrast);
@@ -388,101 +662,85 @@ bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
         av_sha_final(sha, hash);
         av_free(sha);
 
-        char *cache_dir = mp_get_user_path(tmp, p->global, p->opts->cache_dir);
-        cache_file = talloc_strdup(tmp, "");
+        char *cache_dir = mp_get_user_path(job, p->global, p->opts->cache_dir);
+        char *cache_file = talloc_strdup(job, "");
         for (int i = 0; i < sizeof(hash); i++)
             cache_file = talloc_asprintf_append(cache_file, "%02X", hash[i]);
-        cache_file = mp_path_join(tmp, cache_dir, cache_file);
+        job->cache_file = mp_path_join(job, cache_dir, cache_file);
 
         mp_mkdirp(cache_dir);
     }
 
     // check cache
-    if (cache_file && stat(cache_file, &(struct stat){0}) == 0) {
-        MP_VERBOSE(p, "Opening 3D LUT cache in file '%s'.\n", cache_file);
-        struct bstr cachedata = stream_read_file(cache_file, tmp, p->global,
-                                                 1000000000); // 1 GB
-        if (cachedata.len == talloc_get_size(output)) {
-            memcpy(output, cachedata.start, cachedata.len);
-            goto done;
-        } else {
-            MP_WARN(p, "3D LUT cache invalid!\n");
+    if (job->cache_file && stat(job->cache_file, &(struct stat){0}) == 0) {
+        MP_VERBOSE(p, "Opening 3D LUT cache in file '%s'.\n", job->cache_file);
+        struct lut3d *lut = alloc_lut3d(job);
+        struct bstr cachedata = stream_read_file(job->cache_file, job,
+                                                 p->global, 1000000000); // 1 GB
+        if (cachedata.len == talloc_get_size(lut->data)) {
+            memcpy(lut->data, cachedata.start, cachedata.len);
+            gl_sc_touch_cache_file(job->cache_file);
+            *result_lut3d = lut;
+            free_job(job);
+            return true;
         }
+        MP_WARN(p, "3D LUT cache invalid!\n");
+        talloc_free(lut);
     }
 
-    cms = cmsCreateContext(NULL, p);
-    if (!cms)
-        goto error_exit;
-    cmsSetLogErrorHandlerTHR(cms, lcms2_error_handler);
-
-    cmsHPROFILE profile =
-        cmsOpenProfileFromMemTHR(cms, p->icc_data, p->icc_size);
-    if (!profile)
-        goto error_exit;
-
-    cmsHPROFILE vid_hprofile = get_vid_profile(p, cms, profile, prim, trc);
-    if (!vid_hprofile) {
-        cmsCloseProfile(profile);
-        goto error_exit;
+    MP_VERBOSE(p, "Computing 3D LUT in the background.\n");
+    pthread_mutex_lock(&p->lock);
+    p->job = job;
+    pthread_mutex_unlock(&p->lock);
+    if (!mp_thread_pool_queue(p->pool, run_job, job)) {
+        pthread_mutex_lock(&p->lock);
+        p->job = NULL;
+        pthread_mutex_unlock(&p->lock);
+        free_job(job);
+        return false;
     }
+    return true;
+}
 
-    cmsHTRANSFORM trafo = cmsCreateTransformTHR(cms, vid_hprofile, TYPE_RGB_16,
-                                                profile, TYPE_RGBA_16,
-                                                p->opts->intent,
-                                                cmsFLAGS_NOCACHE |
-                                                cmsFLAGS_NOOPTIMIZE |
-                                                cmsFLAGS_BLACKPOINTCOMPENSATION);
-    cmsCloseProfile(profile);
-    cmsCloseProfile(vid_hprofile);
-
-    if (!trafo)
-        goto error_exit;
+// Whether gl_lcms_poll_lut3d() would return GL_LCMS_LUT_DONE.
+bool gl_lcms_lut3d_ready(struct gl_lcms *p)
+{
+    pthread_mutex_lock(&p->lock);
+    bool res = p->job && p->job->done;
+    pthread_mutex_unlock(&p->lock);
+    return res;
+}
 
-    // transform a (s_r)x(s_g)x(s_b) cube, with 3 components per channel
-    uint16_t *input = talloc_array(tmp, uint16_t, s_r * 3);
-    for (int b = 0; b < s_b; b++) {
-        for (int g = 0; g < s_g; g++) {
-            for (int r = 0; r < s_r; r++) {
-                input[r * 3 + 0] = r * 65535 / (s_r - 1);
-                input[r * 3 + 1] = g * 65535 / (s_g - 1);
-                input[r * 3 + 2] = b * 65535 / (s_b - 1);
-            }
-            size_t base = (b * s_r * s_g + g * s_r) * 4;
-            cmsDoTransform(trafo, input, output + base, s_r);
+// Return the result of the last gl_lcms_request_lut3d() call, if it took the
+// asynchronous path:
+//  GL_LCMS_LUT_NONE:    there is no request in progress or finished
+//  GL_LCMS_LUT_PENDING: the LUT is still being computed
+//  GL_LCMS_LUT_DONE:    *result_lut3d is set (the caller gets ownership), or
+//                       NULL if computing the LUT failed
+int gl_lcms_poll_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d)
+{
+    int res = GL_LCMS_LUT_NONE;
+    struct lut3d_job *job = NULL;
+
+    *result_lut3d = NULL;
+
+    pthread_mutex_lock(&p->lock);
+    if (p->job) {
+        res = GL_LCMS_LUT_PENDING;
+        if (p->job->done) {
+            res = GL_LCMS_LUT_DONE;
+            job = p->job;
+            p->job = NULL;
         }
     }
+    pthread_mutex_unlock(&p->lock);
 
-    cmsDeleteTransform(trafo);
-
-    if (cache_file) {
-        FILE *out = fopen(cache_file, "wb");
-        if (out) {
-            fwrite(output, talloc_get_size(output), 1, out);
-            fclose(out);
-        }
+    if (job) {
+        *result_lut3d = job->result;
+        job->result = NULL;
+        free_job(job);
     }
-
-done: ;
-
-    lut = talloc_ptrtype(NULL, lut);
-    *lut = (struct lut3d) {
-        .data = talloc_steal(lut, output),
-        .size = {s_r, s_g, s_b},
-    };
-
-    *result_lut3d = lut;
-    result = true;
-
-error_exit:
-
-    if (cms)
-        cmsDeleteContext(cms);
-
-    if (!lut)
-        MP_FATAL(p, "Error loading ICC profile.\n");
-
-    talloc_free(tmp);
-    return result;
+    return res;
 }
 
 #else /* HAVE_LCMS2 */
@@ -514,11 +772,27 @@ bool gl_lcms_has_profile(struct gl_lcms *p)
     return false;
 }
 
-bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
-                       enum mp_csp_prim prim, enum mp_csp_trc trc,
-                       struct AVBufferRef *vid_profile)
+void gl_lcms_set_wakeup_cb(struct gl_lcms *p, void (*cb)(void *ctx), void *ctx)
+{
+}
+
+bool gl_lcms_request_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d,
+                           enum mp_csp_prim prim, enum mp_csp_trc trc,
+                           struct AVBufferRef *vid_profile)
+{
+    *result_lut3d = NULL;
+    return false;
+}
+
+bool gl_lcms_lut3d_ready(struct gl_lcms *p)
 {
     return false;
 }
 
+int gl_lcms_poll_lut3d(struct gl_lcms *p, struct lut3d **result_lut3d)
+{
+    *result_lut3d = NULL;
+    return GL_LCMS_LUT_NONE;
+}
+
 #endif
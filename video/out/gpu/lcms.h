@@ -14,6 +14,7 @@ struct mp_icc_opts {
     char *profile;
     int profile_auto;
     char *cache_dir;
+    int64_t cache_size;
     char *size_str;
     int intent;
     int contrast;
@@ -22,6 +23,14 @@ struct mp_icc_opts {
 struct lut3d {
     uint16_t *data;
     int size[3];
+    enum mp_csp_prim prim;  // source space the LUT was generated for
+    enum mp_csp_trc trc;
+};
+
+enum {
+    GL_LCMS_LUT_NONE,
+    GL_LCMS_LUT_PENDING,
+    GL_LCMS_LUT_DONE,
 };
 
 struct mp_log;
@@ -34,9 +43,12 @@ struct gl_lcms *gl_lcms_init(void *talloc_ctx, struct mp_log *log,
 void gl_lcms_update_options(struct gl_lcms *p);
 bool gl_lcms_set_memory_profile(struct gl_lcms *p, bstr profile);
 bool gl_lcms_has_profile(struct gl_lcms *p);
-bool gl_lcms_get_lut3d(struct gl_lcms *p, struct lut3d **,
-                       enum mp_csp_prim prim, enum mp_csp_trc trc,
-                       struct AVBufferRef *vid_profile);
+void gl_lcms_set_wakeup_cb(struct gl_lcms *p, void (*cb)(void *ctx), void *ctx);
+bool gl_lcms_request_lut3d(struct gl_lcms *p, struct lut3d **,
+                           enum mp_csp_prim prim, enum mp_csp_trc trc,
+                           struct AVBufferRef *vid_profile);
+bool gl_lcms_lut3d_ready(struct gl_lcms *p);
+int gl_lcms_poll_lut3d(struct gl_lcms *p, struct lut3d **);
 bool gl_lcms_has_changed(struct gl_lcms *p, enum mp_csp_prim prim,
                          enum mp_csp_trc trc, struct AVBufferRef *vid_profile);
 
@@ -8,6 +8,9 @@
 static const struct libmpv_gpu_context_fns *context_backends[] = {
 #if HAVE_GL
     &libmpv_gpu_context_gl,
+#endif
+#if HAVE_VULKAN
+    &libmpv_gpu_context_vk,
 #endif
     NULL
 };
@@ -139,6 +142,7 @@ static void update_external(struct render_backend *ctx, struct vo *vo)
     struct priv *p = ctx->priv;
 
     gl_video_set_osd_source(p->renderer, vo ? vo->osd : NULL);
+    gl_video_set_redraw_vo(p->renderer, vo);
     if (vo)
         gl_video_configure_queue(p->renderer, vo);
 }
@@ -186,7 +190,7 @@ static int render(struct render_backend *ctx, mpv_render_param *params,
 
     struct ra_fbo target = {.tex = tex, .flip = flip};
     gl_video_render_frame(p->renderer, frame, target, RENDER_FRAME_DEF);
-    p->context->fns->done_frame(p->context, frame->display_synced);
+    p->context->fns->done_frame(p->context, params, frame->display_synced);
 
     return 0;
 }
@@ -31,10 +31,13 @@ struct libmpv_gpu_context_fns {
                     struct ra_tex **out);
     // Signal that the ra_tex object obtained with wrap_fbo is no longer used.
     // For certain backends, this might also be used to signal the end of
-    // rendering (like OpenGL doing weird crap).
-    void (*done_frame)(struct libmpv_gpu_context *ctx, bool ds);
+    // rendering (like OpenGL doing weird crap). params is the same array as
+    // passed to wrap_fbo(), for backend-specific output parameters.
+    void (*done_frame)(struct libmpv_gpu_context *ctx, mpv_render_param *params,
+                       bool ds);
     // Free all data in ctx->priv.
     void (*destroy)(struct libmpv_gpu_context *ctx);
 };
 
 extern const struct libmpv_gpu_context_fns libmpv_gpu_context_gl;
+extern const struct libmpv_gpu_context_fns libmpv_gpu_context_vk;
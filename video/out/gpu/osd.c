@@ -51,6 +51,7 @@ struct mpgl_osd_part {
     enum sub_bitmap_format format;
     int change_id;
     struct ra_tex *texture;
+    int64_t packed_id; // sub_bitmaps.packed_id of the texture contents
     int w, h;
     int num_subparts;
     int prev_num_subparts;
@@ -67,6 +68,7 @@ struct mpgl_osd {
     const struct ra_format *fmt_table[SUBBITMAP_COUNT];
     bool formats[SUBBITMAP_COUNT];
     bool change_flag; // for reporting to API user only
+    int64_t change_id; // of the bitmaps selected by the last generate call
     // temporary
     int stereo_mode;
     struct mp_osd_res osd_res;
@@ -161,19 +163,40 @@ static bool upload_osd(struct mpgl_osd *ctx, struct mpgl_osd_part *osd,
             .host_mutable = true,
         };
         osd->texture = ra_tex_create(ra, &params);
+        osd->packed_id = 0;
         if (!osd->texture)
             goto done;
     }
 
-    struct ra_tex_upload_params params = {
-        .tex = osd->texture,
-        .src = imgs->packed->planes[0],
-        .invalidate = true,
-        .rc = &(struct mp_rect){0, 0, imgs->packed_w, imgs->packed_h},
-        .stride = imgs->packed->stride[0],
-    };
-
-    ok = ra->fns->tex_upload(ra, &params);
+    // Only upload what changed since the texture contents, if possible.
+    struct mp_rect rc = {0, 0, imgs->packed_w, imgs->packed_h};
+    bool full = true;
+    if (imgs->packed_id && osd->packed_id) {
+        if (imgs->packed_id == osd->packed_id) {
+            rc = (struct mp_rect){0};
+            full = false;
+        } else if (imgs->packed_prev_id == osd->packed_id) {
+            rc = imgs->packed_dirty;
+            full = false;
+        }
+    }
+    osd->packed_id = 0;
+
+    ok = true;
+    if (rc.x1 > rc.x0 && rc.y1 > rc.y0) {
+        int bpp = imgs->format == SUBBITMAP_BGRA ? 4 : 1;
+        struct ra_tex_upload_params params = {
+            .tex = osd->texture,
+            .src = imgs->packed->planes[0] + rc.y0 * imgs->packed->stride[0] +
+                   rc.x0 * bpp,
+            .invalidate = full,
+            .rc = &rc,
+            .stride = imgs->packed->stride[0],
+        };
+        ok = ra->fns->tex_upload(ra, &params);
+    }
+    if (ok)
+        osd->packed_id = imgs->packed_id;
 
 done:
     return ok;
@@ -334,7 +357,12 @@ void mpgl_osd_generate(struct mpgl_osd *ctx, struct mp_osd_res res, double pts,
 
     set_res(ctx, res, stereo_mode);
 
-    osd_draw(ctx->osd, ctx->osd_res, pts, draw_flags, ctx->formats, gen_osd_cb, ctx);
+    struct sub_bitmap_list *list =
+        osd_render(ctx->osd, ctx->osd_res, pts, draw_flags, ctx->formats);
+    for (int n = 0; n < list->num_items; n++)
+        gen_osd_cb(ctx, list->items[n]);
+    ctx->change_id = list->change_id;
+    talloc_free(list);
     ctx->stereo_mode = stereo_mode;
 
     // Parts going away does not necessarily result in gen_osd_cb() being called
@@ -361,3 +389,11 @@ bool mpgl_osd_check_change(struct mpgl_osd *ctx, struct mp_osd_res *res,
     mpgl_osd_generate(ctx, *res, pts, 0, 0);
     return ctx->change_flag;
 }
+
+// Returns the combined change ID of the OSD/subtitle objects selected by the
+// draw_flags of the last mpgl_osd_generate() call. If the ID is the same after
+// two calls with the same parameters, the same bitmaps would be drawn.
+int64_t mpgl_osd_get_change_id(struct mpgl_osd *ctx)
+{
+    return ctx->change_id;
+}
@@ -21,5 +21,6 @@ void mpgl_osd_draw_finish(struct mpgl_osd *ctx, int index,
                           struct gl_shader_cache *sc, struct ra_fbo fbo);
 bool mpgl_osd_check_change(struct mpgl_osd *ctx, struct mp_osd_res *res,
                            double pts);
+int64_t mpgl_osd_get_change_id(struct mpgl_osd *ctx);
 
 #endif
@@ -1,9 +1,14 @@
+#include <dirent.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
 #include <assert.h>
+#include <unistd.h>
+#include <utime.h>
 
 #include <libavutil/sha.h>
 #include <libavutil/mem.h>
@@ -11,6 +16,8 @@
 #include "osdep/io.h"
 
 #include "common/common.h"
+#include "common/stats.h"
+#include "misc/thread_pool.h"
 #include "options/path.h"
 #include "stream/stream.h"
 #include "shader_cache.h"
@@ -19,6 +26,11 @@
 // Force cache flush if more than this number of shaders is created.
 #define SC_MAX_ENTRIES 256
 
+// Don't preload more than this many bytes of disk cache files into memory.
+#define SC_PRELOAD_MAX_BYTES (64 * 1024 * 1024)
+
+static const char sc_cache_header[] = "mpv shader cache v1\n";
+
 union uniform_val {
     float f[9];         // RA_VARTYPE_FLOAT
     int i[4];           // RA_VARTYPE_INT
@@ -106,8 +118,267 @@ struct gl_shader_cache {
     // For the disk-cache.
     char *cache_dir;
     struct mpv_global *global; // can be NULL
+    int64_t cache_size;
+    struct sc_disk_cache *disk;
+    struct stats_ctx *stats;
+    int hits, misses;
+};
+
+struct sc_disk_file {
+    char *name;     // hash string, as used for the filename
+    bstr data;      // contents after the header
+};
+
+// Cache files preloaded by a background thread, and written back by it. This
+// keeps file I/O out of the render loop when a new pass is created.
+struct sc_disk_cache {
+    struct mpv_global *global;
+    struct mp_log *log;
+    char *dir;      // expanded path
+    int64_t max_bytes; // for gl_sc_trim_cache_dir() before preloading
+    struct mp_thread_pool *thread; // 1 thread, does preload and writes
+
+    pthread_mutex_t lock;
+    // -- protected by lock
+    bool preloading;
+    struct sc_disk_file *files;
+    int num_files;
+};
+
+struct sc_write_job {
+    struct sc_disk_cache *disk;
+    char *name;
+    bstr data;      // if empty, only update the file's modification time
+};
+
+// Files that gl_sc_trim_cache_dir() is allowed to delete: the hex hashes used
+// by the shader and 3D LUT caches, and the files written by vo_gpu_next.
+static bool is_cache_file(const char *name)
+{
+    if (strcmp(name, "libplacebo.cache") == 0)
+        return true;
+    size_t len = strlen(name);
+    return (len == 16 || len == 256 / 8 * 2) &&
+           strspn(name, "0123456789ABCDEFabcdef") == len;
+}
+
+struct cache_file {
+    char *path;
+    int64_t size;
+    time_t mtime;
 };
 
+static int compare_mtime(const void *pa, const void *pb)
+{
+    const struct cache_file *a = pa, *b = pb;
+    return a->mtime < b->mtime ? -1 : (a->mtime > b->mtime);
+}
+
+char *gl_sc_cache_path(void *ta_ctx, struct mpv_global *global,
+                       const char *dir, const char *name)
+{
+    if (!dir || !dir[0])
+        return NULL;
+    char *path = mp_get_user_path(NULL, global, dir);
+    mp_mkdirp(path);
+    char *file = mp_path_join(ta_ctx, path, name);
+    talloc_free(path);
+    return file;
+}
+
+void gl_sc_touch_cache_file(const char *path)
+{
+    utime(path, NULL);
+}
+
+void gl_sc_trim_cache_dir(struct mp_log *log, const char *dir,
+                          int64_t max_bytes)
+{
+    if (max_bytes <= 0)
+        return;
+
+    void *tmp = talloc_new(NULL);
+    struct cache_file *files = NULL;
+    int num_files = 0;
+    int64_t total = 0;
+
+    DIR *d = opendir(dir);
+    struct dirent *de;
+    while (d && (de = readdir(d))) {
+        if (!is_cache_file(de->d_name))
+            continue;
+        char *path = mp_path_join(tmp, dir, de->d_name);
+        struct stat st;
+        if (stat(path, &st) || !S_ISREG(st.st_mode))
+            continue;
+        struct cache_file f = {path, st.st_size, st.st_mtime};
+        MP_TARRAY_APPEND(tmp, files, num_files, f);
+        total += f.size;
+    }
+    if (d)
+        closedir(d);
+
+    // Files are touched when they're used, so the oldest ones go first.
+    qsort(files, num_files, sizeof(files[0]), compare_mtime);
+    int removed = 0;
+    int64_t removed_bytes = 0;
+    for (int n = 0; n < num_files && total > max_bytes; n++) {
+        if (unlink(files[n].path))
+            continue;
+        total -= files[n].size;
+        removed_bytes += files[n].size;
+        removed++;
+    }
+    if (removed) {
+        mp_verbose(log, "Removed %d least recently used cache files "
+                   "(%"PRId64" bytes) from %s.\n", removed, removed_bytes, dir);
+    }
+    talloc_free(tmp);
+}
+
+static void disk_cache_add(struct sc_disk_cache *disk, const char *name,
+                           bstr data)
+{
+    pthread_mutex_lock(&disk->lock);
+    struct sc_disk_file f = {
+        .name = talloc_strdup(disk, name),
+        .data = bstrdup(disk, data),
+    };
+    MP_TARRAY_APPEND(disk, disk->files, disk->num_files, f);
+    pthread_mutex_unlock(&disk->lock);
+}
+
+static void disk_cache_preload(void *p)
+{
+    struct sc_disk_cache *disk = p;
+    void *tmp = talloc_new(NULL);
+    int64_t total = 0;
+    int num = 0;
+
+    gl_sc_trim_cache_dir(disk->log, disk->dir, disk->max_bytes);
+
+    DIR *d = opendir(disk->dir);
+    struct dirent *de;
+    while (d && (de = readdir(d)) && total < SC_PRELOAD_MAX_BYTES) {
+        // Cache files are named by the hex SHA-256 of the shader.
+        if (strlen(de->d_name) != 256 / 8 * 2)
+            continue;
+        char *filename = mp_path_join(tmp, disk->dir, de->d_name);
+        bstr data = stream_read_file(filename, tmp, disk->global,
+                                     SC_PRELOAD_MAX_BYTES);
+        if (bstr_eatstart0(&data, sc_cache_header)) {
+            disk_cache_add(disk, de->d_name, data);
+            total += data.len;
+            num++;
+        }
+    }
+    if (d)
+        closedir(d);
+
+    MP_VERBOSE(disk, "Preloaded %d cached shaders (%"PRId64" bytes).\n",
+               num, total);
+
+    pthread_mutex_lock(&disk->lock);
+    disk->preloading = false;
+    pthread_mutex_unlock(&disk->lock);
+    talloc_free(tmp);
+}
+
+static void disk_cache_write(void *p)
+{
+    struct sc_write_job *job = p;
+    struct sc_disk_cache *disk = job->disk;
+
+    char *filename = mp_path_join(job, disk->dir, job->name);
+    if (!job->data.len) {
+        gl_sc_touch_cache_file(filename);
+        talloc_free(job);
+        return;
+    }
+
+    mp_mkdirp(disk->dir);
+    MP_DBG(disk, "Writing shader cache file: %s\n", filename);
+    FILE *out = fopen(filename, "wb");
+    if (out) {
+        fwrite(sc_cache_header, strlen(sc_cache_header), 1, out);
+        fwrite(job->data.start, job->data.len, 1, out);
+        fclose(out);
+    }
+    talloc_free(job);
+}
+
+static void disk_cache_destroy(struct sc_disk_cache *disk)
+{
+    if (!disk)
+        return;
+    talloc_free(disk->thread); // waits for pending preload/writes
+    pthread_mutex_destroy(&disk->lock);
+    talloc_free(disk);
+}
+
+static struct sc_disk_cache *disk_cache_create(struct gl_shader_cache *sc,
+                                               const char *dir)
+{
+    struct sc_disk_cache *disk = talloc_zero(NULL, struct sc_disk_cache);
+    disk->global = sc->global;
+    disk->log = sc->log;
+    disk->dir = mp_get_user_path(disk, sc->global, dir);
+    disk->max_bytes = sc->cache_size;
+    disk->thread = mp_thread_pool_create(disk, 0, 0, 1);
+    pthread_mutex_init(&disk->lock, NULL);
+    disk->preloading = true;
+    if (!mp_thread_pool_queue(disk->thread, disk_cache_preload, disk))
+        disk->preloading = false;
+    return disk;
+}
+
+// Return the cached program, or an empty bstr. The data is owned by disk, or
+// by ta_ctx if it had to be read synchronously.
+static bstr disk_cache_get(struct sc_disk_cache *disk, void *ta_ctx,
+                           const char *name)
+{
+    bstr res = {0};
+    pthread_mutex_lock(&disk->lock);
+    for (int n = 0; n < disk->num_files; n++) {
+        if (strcmp(disk->files[n].name, name) == 0) {
+            res = disk->files[n].data;
+            break;
+        }
+    }
+    bool preloading = disk->preloading;
+    pthread_mutex_unlock(&disk->lock);
+
+    // Not found, or not loaded yet (preloading or too many files).
+    if (!res.len) {
+        char *filename = mp_path_join(ta_ctx, disk->dir, name);
+        if (stat(filename, &(struct stat){0}) == 0) {
+            MP_DBG(disk, "Trying to load shader from disk%s...\n",
+                   preloading ? " (preload still running)" : "");
+            res = stream_read_file(filename, ta_ctx, disk->global, 1000000000);
+            if (!bstr_eatstart0(&res, sc_cache_header))
+                res = (bstr){0};
+        }
+    }
+    return res;
+}
+
+// Write the file (or if data is empty, mark it as recently used).
+static void disk_cache_put(struct sc_disk_cache *disk, const char *name,
+                           bstr data)
+{
+    if (data.len)
+        disk_cache_add(disk, name, data);
+
+    struct sc_write_job *job = talloc_ptrtype(NULL, job);
+    *job = (struct sc_write_job){
+        .disk = disk,
+        .name = talloc_strdup(job, name),
+        .data = bstrdup(job, data),
+    };
+    if (!mp_thread_pool_queue(disk->thread, disk_cache_write, job))
+        disk_cache_write(job);
+}
+
 struct gl_shader_cache *gl_sc_create(struct ra *ra, struct mpv_global *global,
                                      struct mp_log *log)
 {
@@ -117,6 +388,8 @@ struct gl_shader_cache *gl_sc_create(struct ra *ra, struct mpv_global *global,
         .global = global,
         .log = log,
     };
+    if (global)
+        sc->stats = stats_ctx_create(sc, global, "shader-cache");
     gl_sc_reset(sc);
     return sc;
 }
@@ -163,6 +436,11 @@ void gl_sc_destroy(struct gl_shader_cache *sc)
         return;
     gl_sc_reset(sc);
     sc_flush_cache(sc);
+    if (sc->disk) {
+        MP_VERBOSE(sc, "Disk cache: %d hits, %d misses.\n",
+                   sc->hits, sc->misses);
+    }
+    disk_cache_destroy(sc->disk);
     talloc_free(sc);
 }
 
@@ -557,10 +835,24 @@ static void update_uniform(struct gl_shader_cache *sc, struct sc_entry *e,
     }
 }
 
-void gl_sc_set_cache_dir(struct gl_shader_cache *sc, const char *dir)
+void gl_sc_set_cache_dir(struct gl_shader_cache *sc, const char *dir,
+                         int64_t max_bytes)
 {
+    if (dir && !dir[0])
+        dir = NULL;
+    if (((!dir && !sc->cache_dir) ||
+         (dir && sc->cache_dir && strcmp(dir, sc->cache_dir) == 0)) &&
+        max_bytes == sc->cache_size)
+        return;
+
     talloc_free(sc->cache_dir);
     sc->cache_dir = talloc_strdup(sc, dir);
+    sc->cache_size = max_bytes;
+
+    // Start reading the cache files now (normally at VO init), so that the
+    // passes created on the first frames only need to look them up.
+    disk_cache_destroy(sc->disk);
+    sc->disk = sc->cache_dir ? disk_cache_create(sc, sc->cache_dir) : NULL;
 }
 
 static bool create_pass(struct gl_shader_cache *sc, struct sc_entry *entry)
@@ -570,14 +862,10 @@ static bool create_pass(struct gl_shader_cache *sc, struct sc_entry *entry)
     void *tmp = talloc_new(NULL);
     struct ra_renderpass_params params = sc->params;
 
-    const char *cache_header = "mpv shader cache v1\n";
-    char *cache_filename = NULL;
-    char *cache_dir = NULL;
+    char *cache_name = NULL;
 
-    if (sc->cache_dir && sc->cache_dir[0]) {
+    if (sc->disk) {
         // Try to load it from a disk cache.
-        cache_dir = mp_get_user_path(tmp, sc->global, sc->cache_dir);
-
         struct AVSHA *sha = av_sha_alloc();
         if (!sha)
             abort();
@@ -592,14 +880,8 @@ static bool create_pass(struct gl_shader_cache *sc, struct sc_entry *entry)
         for (int n = 0; n < 256 / 8; n++)
             snprintf(hashstr + n * 2, sizeof(hashstr) - n * 2, "%02X", hash[n]);
 
-        cache_filename = mp_path_join(tmp, cache_dir, hashstr);
-        if (stat(cache_filename, &(struct stat){0}) == 0) {
-            MP_DBG(sc, "Trying to load shader from disk...\n");
-            struct bstr cachedata =
-                stream_read_file(cache_filename, tmp, sc->global, 1000000000);
-            if (bstr_eatstart0(&cachedata, cache_header))
-                params.cached_program = cachedata;
-        }
+        cache_name = talloc_strdup(tmp, hashstr);
+        params.cached_program = disk_cache_get(sc->disk, tmp, cache_name);
     }
 
     // If using a UBO, also make sure to add it as an input value so the RA
@@ -635,22 +917,36 @@ static bool create_pass(struct gl_shader_cache *sc, struct sc_entry *entry)
         }
     }
 
+    if (sc->stats)
+        stats_time_start(sc->stats, "create-pass");
+    if (sc->global)
+        stats_startup_begin(sc->global, "shader-compile");
     entry->pass = sc->ra->fns->renderpass_create(sc->ra, &params);
+    if (sc->global)
+        stats_startup_end(sc->global, "shader-compile");
+    if (sc->stats)
+        stats_time_end(sc->stats, "create-pass");
     if (!entry->pass)
         goto error;
 
-    if (entry->pass && cache_filename) {
+    if (cache_name) {
+        // The RA returns the same program data if it could use the cached
+        // one. (Backends without support never return any.)
         bstr nc = entry->pass->params.cached_program;
-        if (nc.len && !bstr_equals(params.cached_program, nc)) {
-            mp_mkdirp(cache_dir);
-
-            MP_DBG(sc, "Writing shader cache file: %s\n", cache_filename);
-            FILE *out = fopen(cache_filename, "wb");
-            if (out) {
-                fwrite(cache_header, strlen(cache_header), 1, out);
-                fwrite(nc.start, nc.len, 1, out);
-                fclose(out);
-            }
+        bool hit = params.cached_program.len &&
+                   bstr_equals(params.cached_program, nc);
+        if (hit) {
+            sc->hits++;
+            disk_cache_put(sc->disk, cache_name, (bstr){0});
+        } else {
+            sc->misses++;
+            MP_DBG(sc, "Shader not in disk cache.\n");
+            if (nc.len)
+                disk_cache_put(sc->disk, cache_name, nc);
+        }
+        if (sc->stats) {
+            stats_value(sc->stats, "disk-hits", sc->hits);
+            stats_value(sc->stats, "disk-misses", sc->misses);
         }
     }
 
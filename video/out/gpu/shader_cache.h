@@ -63,4 +63,21 @@ struct mp_pass_perf gl_sc_dispatch_compute(struct gl_shader_cache *sc,
 // The application can call this on errors, to reset the current shader. This
 // is normally done implicitly by gl_sc_dispatch_*
 void gl_sc_reset(struct gl_shader_cache *sc);
-void gl_sc_set_cache_dir(struct gl_shader_cache *sc, const char *dir);
+// Enable the disk cache in dir (or disable it if dir is NULL or ""). If
+// max_bytes > 0, least recently used files are deleted on init to stay below it.
+void gl_sc_set_cache_dir(struct gl_shader_cache *sc, const char *dir,
+                         int64_t max_bytes);
+
+// Helpers for other on-disk GPU caches (vo_gpu_next, ICC 3D LUTs), so they use
+// the same directory handling and cleanup as the shader cache.
+// Return the path of the file name in dir (which is created if needed), or
+// NULL if dir is NULL or "".
+char *gl_sc_cache_path(void *ta_ctx, struct mpv_global *global,
+                       const char *dir, const char *name);
+// Mark a cache file as recently used (for gl_sc_trim_cache_dir()).
+void gl_sc_touch_cache_file(const char *path);
+// Delete the least recently used cache files in dir (an expanded path) until
+// they take at most max_bytes. Does nothing if max_bytes <= 0. Only files
+// with names as used by the mpv GPU caches are considered.
+void gl_sc_trim_cache_dir(struct mp_log *log, const char *dir,
+                          int64_t max_bytes);
@@ -17,11 +17,88 @@
 
 #include <assert.h>
 #include <math.h>
+#include <string.h>
 
 #include "common/msg.h"
 #include "misc/ctype.h"
 #include "user_shaders.h"
 
+static float szexp_op1(enum szexp_op op, float op1)
+{
+    switch (op) {
+    case SZEXP_OP_NOT: return !op1;
+    default: abort();
+    }
+}
+
+static float szexp_op2(enum szexp_op op, float op1, float op2)
+{
+    switch (op) {
+    case SZEXP_OP_ADD: return op1 + op2;
+    case SZEXP_OP_SUB: return op1 - op2;
+    case SZEXP_OP_MUL: return op1 * op2;
+    case SZEXP_OP_DIV: return op1 / op2;
+    case SZEXP_OP_MOD: return fmodf(op1, op2);
+    case SZEXP_OP_GT:  return op1 > op2;
+    case SZEXP_OP_LT:  return op1 < op2;
+    case SZEXP_OP_EQ:  return op1 == op2;
+    default: abort();
+    }
+}
+
+// Replace all operations on constants with their result, so that expressions
+// which don't depend on any texture size are a single constant. Anything that
+// would fail to evaluate is left alone, so it still fails at runtime.
+static void fold_szexpr(struct szexp expr[MAX_SZEXP_SIZE])
+{
+    struct szexp out[MAX_SZEXP_SIZE] = {0};
+    bool is_const[MAX_SZEXP_SIZE]; // per stack element
+    int num_out = 0, idx = 0;
+
+    for (int i = 0; i < MAX_SZEXP_SIZE && expr[i].tag != SZEXP_END; i++) {
+        struct szexp e = expr[i];
+        switch (e.tag) {
+        case SZEXP_CONST:
+        case SZEXP_VAR_W:
+        case SZEXP_VAR_H:
+            is_const[idx++] = e.tag == SZEXP_CONST;
+            break;
+        case SZEXP_OP1:
+            if (idx < 1)
+                return;
+            // A constant stack element is always the last output token.
+            if (is_const[idx - 1]) {
+                out[num_out - 1].val.cval =
+                    szexp_op1(e.val.op, out[num_out - 1].val.cval);
+                continue;
+            }
+            is_const[idx - 1] = false;
+            break;
+        case SZEXP_OP2:
+            if (idx < 2)
+                return;
+            if (is_const[idx - 1] && is_const[idx - 2]) {
+                float res = szexp_op2(e.val.op, out[num_out - 2].val.cval,
+                                      out[num_out - 1].val.cval);
+                if (isfinite(res)) {
+                    out[--num_out] = (struct szexp){0};
+                    out[num_out - 1].val.cval = res;
+                    idx -= 1;
+                    continue;
+                }
+            }
+            idx -= 1;
+            is_const[idx - 1] = false;
+            break;
+        default:
+            return;
+        }
+        out[num_out++] = e;
+    }
+
+    memcpy(expr, out, sizeof(out));
+}
+
 static bool parse_rpn_szexpr(struct bstr line, struct szexp out[MAX_SZEXP_SIZE])
 {
     int pos = 0;
@@ -71,9 +148,28 @@ static bool parse_rpn_szexpr(struct bstr line, struct szexp out[MAX_SZEXP_SIZE])
         return false;
     }
 
+    fold_szexpr(out);
     return true;
 }
 
+bool szexpr_is_const(struct szexp expr[MAX_SZEXP_SIZE], float *result)
+{
+    if (expr[0].tag != SZEXP_CONST || expr[1].tag != SZEXP_END)
+        return false;
+    *result = expr[0].val.cval;
+    return true;
+}
+
+bool szexpr_uses_var(struct szexp expr[MAX_SZEXP_SIZE], const char *name)
+{
+    for (int i = 0; i < MAX_SZEXP_SIZE && expr[i].tag != SZEXP_END; i++) {
+        if ((expr[i].tag == SZEXP_VAR_W || expr[i].tag == SZEXP_VAR_H) &&
+            bstr_equals0(expr[i].val.varname, name))
+            return true;
+    }
+    return false;
+}
+
 // Returns whether successful. 'result' is left untouched on failure
 bool eval_szexpr(struct mp_log *log, void *priv,
                  bool (*lookup)(void *priv, struct bstr var, float size[2]),
@@ -100,10 +196,7 @@ bool eval_szexpr(struct mp_log *log, void *priv,
                 return false;
             }
 
-            switch (expr[i].val.op) {
-            case SZEXP_OP_NOT: stack[idx-1] = !stack[idx-1]; break;
-            default: abort();
-            }
+            stack[idx-1] = szexp_op1(expr[i].val.op, stack[idx-1]);
             continue;
 
         case SZEXP_OP2:
@@ -115,18 +208,7 @@ bool eval_szexpr(struct mp_log *log, void *priv,
             // Pop the operands in reverse order
             float op2 = stack[--idx];
             float op1 = stack[--idx];
-            float res = 0.0;
-            switch (expr[i].val.op) {
-            case SZEXP_OP_ADD: res = op1 + op2; break;
-            case SZEXP_OP_SUB: res = op1 - op2; break;
-            case SZEXP_OP_MUL: res = op1 * op2; break;
-            case SZEXP_OP_DIV: res = op1 / op2; break;
-            case SZEXP_OP_MOD: res = fmodf(op1, op2); break;
-            case SZEXP_OP_GT:  res = op1 > op2; break;
-            case SZEXP_OP_LT:  res = op1 < op2; break;
-            case SZEXP_OP_EQ:  res = op1 == op2; break;
-            default: abort();
-            }
+            float res = szexp_op2(expr[i].val.op, op1, op2);
 
             if (!isfinite(res)) {
                 mp_warn(log, "Illegal operation in RPN expression!\n");
@@ -96,4 +96,11 @@ bool eval_szexpr(struct mp_log *log, void *priv,
                  bool (*lookup)(void *priv, struct bstr var, float size[2]),
                  struct szexp expr[MAX_SZEXP_SIZE], float *result);
 
+// Whether the szexp doesn't depend on any variables. (Expressions are
+// constant-folded when parsed.) Sets *result to the value if so.
+bool szexpr_is_const(struct szexp expr[MAX_SZEXP_SIZE], float *result);
+
+// Whether the szexp references the size of the named texture.
+bool szexpr_uses_var(struct szexp expr[MAX_SZEXP_SIZE], const char *name);
+
 #endif
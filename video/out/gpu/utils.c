@@ -1,3 +1,6 @@
+#include <inttypes.h>
+#include <string.h>
+
 #include "common/msg.h"
 #include "video/out/vo.h"
 #include "utils.h"
@@ -41,11 +44,20 @@ void gl_transform_ortho_fbo(struct gl_transform *t, struct ra_fbo fbo)
 
 void ra_buf_pool_uninit(struct ra *ra, struct ra_buf_pool *pool)
 {
+    if (pool->num_gets) {
+        MP_VERBOSE(ra, "Buffer pool of type %u: %d buffers, %"PRIu64" uses, "
+                   "%"PRIu64" times the next buffer was still busy.\n",
+                   pool->current_params.type, pool->num_buffers,
+                   pool->num_gets, pool->num_busy);
+    }
+
     for (int i = 0; i < pool->num_buffers; i++)
         ra_buf_free(ra, &pool->buffers[i]);
 
     talloc_free(pool->buffers);
-    *pool = (struct ra_buf_pool){0};
+    *pool = (struct ra_buf_pool){
+        .no_host_mapped = pool->no_host_mapped,
+    };
 }
 
 static bool ra_buf_params_compatible(const struct ra_buf_params *new,
@@ -84,14 +96,15 @@ struct ra_buf *ra_buf_pool_get(struct ra *ra, struct ra_buf_pool *pool,
         return NULL;
 
     // Make sure the next buffer is available for use
-    if (!ra->fns->buf_poll(ra, pool->buffers[pool->index]) &&
-        !ra_buf_pool_grow(ra, pool))
-    {
-        return NULL;
+    if (!ra->fns->buf_poll(ra, pool->buffers[pool->index])) {
+        pool->num_busy++;
+        if (!ra_buf_pool_grow(ra, pool))
+            return NULL;
     }
 
     struct ra_buf *buf = pool->buffers[pool->index++];
     pool->index %= pool->num_buffers;
+    pool->num_gets++;
 
     return buf;
 }
@@ -110,17 +123,31 @@ bool ra_tex_upload_pbo(struct ra *ra, struct ra_buf_pool *pbo,
     if (tex->params.dimensions == 2 && params->rc)
         height = mp_rect_h(*params->rc);
 
+    // Prefer persistently mapped buffers: the data is written straight into
+    // memory the GPU reads from, instead of going through buf_update (which
+    // makes the driver copy it to a staging area first).
     struct ra_buf_params bufparams = {
         .type = RA_BUF_TYPE_TEX_UPLOAD,
         .size = row_size * height * tex->params.d,
         .host_mutable = true,
+        .host_mapped = !pbo->no_host_mapped,
     };
 
     struct ra_buf *buf = ra_buf_pool_get(ra, pbo, &bufparams);
+    if (!buf && bufparams.host_mapped && !pbo->num_buffers) {
+        MP_VERBOSE(ra, "Persistently mapped upload buffers not available.\n");
+        pbo->no_host_mapped = true;
+        bufparams.host_mapped = false;
+        buf = ra_buf_pool_get(ra, pbo, &bufparams);
+    }
     if (!buf)
         return false;
 
-    ra->fns->buf_update(ra, buf, 0, params->src, bufparams.size);
+    if (buf->data) {
+        memcpy(buf->data, params->src, bufparams.size);
+    } else {
+        ra->fns->buf_update(ra, buf, 0, params->src, bufparams.size);
+    }
 
     struct ra_tex_upload_params newparams = *params;
     newparams.buf = buf;
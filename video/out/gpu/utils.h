@@ -65,12 +65,19 @@ void gl_transform_trans(struct gl_transform t, struct gl_transform *x);
 
 void gl_transform_ortho_fbo(struct gl_transform *t, struct ra_fbo fbo);
 
-// A pool of buffers, which can grow as needed
+// A pool of buffers, which can grow as needed. Buffers are handed out in
+// ring order, and a buffer is reused once the GPU is done with it (as
+// reported by ra_fns.buf_poll, e.g. via a fence).
 struct ra_buf_pool {
     struct ra_buf_params current_params;
     struct ra_buf **buffers;
     int num_buffers;
     int index;
+    // statistics
+    uint64_t num_gets;      // buffers handed out
+    uint64_t num_busy;      // next buffer was still in use, had to grow
+    // ra_tex_upload_pbo(): creating persistently mapped buffers failed
+    bool no_host_mapped;
 };
 
 void ra_buf_pool_uninit(struct ra *ra, struct ra_buf_pool *pool);
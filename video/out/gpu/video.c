@@ -129,8 +129,15 @@ struct tex_hook {
     void (*hook)(struct gl_video *p, struct image img, // generates GLSL
                  struct gl_transform *trans, void *priv);
     bool (*cond)(struct gl_video *p, struct image img, void *priv);
+
+    // Set by compile_hooks()
+    int bind_type[SHADER_MAX_BINDS]; // BIND_* or index into user_textures
+    bool dead; // the hook never runs, or its output is never used
 };
 
+#define BIND_SAVED (-1)  // look up a saved image by name
+#define BIND_HOOKED (-2) // the hooked image
+
 struct surface {
     struct ra_tex *tex;
     uint64_t id;
@@ -139,6 +146,9 @@ struct surface {
 
 #define SURFACES_MAX 10
 
+// Number of scaler LUT textures kept around for reuse (see get_scaler_lut()).
+#define LUT_CACHE_SIZE 16
+
 struct cached_file {
     char *path;
     struct bstr body;
@@ -156,6 +166,17 @@ struct dr_buffer {
     struct mp_image *mpi;
 };
 
+// A weight LUT texture, and the kernel state it was computed from.
+struct lut_cache_entry {
+    struct filter_kernel kernel; // after mp_init_filter()
+    int lut_size, stride;
+    bool use_1d;
+    const struct ra_format *fmt;
+    struct ra_tex *lut;         // owned by the cache
+    double radius_cutoff;       // set by mp_compute_lut()
+    uint64_t last_used;
+};
+
 struct gl_video {
     struct ra *ra;
 
@@ -177,7 +198,10 @@ struct gl_video {
 
     struct ra_tex *lut_3d_texture;
     bool use_lut_3d;
+    bool lut_3d_pending;            // new LUT is being computed
     int lut_3d_size[3];
+    enum mp_csp_prim lut_3d_prim;   // source space of lut_3d_texture
+    enum mp_csp_trc lut_3d_trc;
 
     struct ra_tex *dither_texture;
 
@@ -215,13 +239,16 @@ struct gl_video {
     struct ra_tex *indirect_tex;
     struct ra_tex *blend_subs_tex;
     struct ra_tex *error_diffusion_tex[2];
+    uint64_t error_diffusion_time; // GPU time of the last pass (ns), or 0
+    int error_diffusion_slow;      // consecutive frames over the budget
     struct ra_tex *screen_tex;
     struct ra_tex *output_tex;
     struct ra_tex **hook_textures;
     int num_hook_textures;
     int idx_hook_textures;
 
-    struct ra_buf *hdr_peak_ssbo;
+    struct ra_buf *hdr_peak_ssbo[2];
+    int hdr_peak_idx; // buffer written by the current frame
     struct surface surfaces[SURFACES_MAX];
 
     // user pass descriptions and textures
@@ -236,10 +263,26 @@ struct gl_video {
     bool is_interpolated;
     bool output_tex_valid;
 
+    // subtitles blended into the frame in output_tex
+    struct mp_osd_res output_subs_res;
+    double output_subs_pts;
+    int output_subs_flags;
+    int64_t output_subs_id; // 0 if none were blended
+
+    // --gpu-auto-quality state
+    int quality_tier;       // 0 (as configured) to AUTO_QUALITY_MAX_TIER
+    int aq_over, aq_under;  // consecutive frames over/under the budget
+    int aq_settle;          // frames to skip after a tier change
+    int aq_up_frames;       // frames under budget required to step up
+    bool aq_last_up;        // last tier change was a step up
+
     // state for configured scalers
     struct scaler scaler[SCALER_COUNT];
+    struct lut_cache_entry lut_cache[LUT_CACHE_SIZE];
+    uint64_t lut_cache_age;
 
     struct mp_csp_equalizer_state *video_eq;
+    struct mp_csp_matrix_cache csp_matrix;
 
     struct mp_rect src_rect;    // displayed part of the source video
     struct mp_rect dst_rect;    // video rectangle on output window
@@ -326,9 +369,12 @@ static const struct gl_video_opts gl_video_opts_def = {
         .decay_rate = 100.0,
         .scene_threshold_low = 5.5,
         .scene_threshold_high = 10.0,
+        .peak_block_size = 8,
     },
     .early_flush = -1,
     .hwdec_interop = "auto",
+    .shader_cache_size = 128 * 1024 * 1024,
+    .auto_quality_budget = 0.8,
 };
 
 static int validate_scaler_opt(struct mp_log *log, const m_option_t *opt,
@@ -411,6 +457,9 @@ const struct m_sub_options gl_video_conf = {
             M_RANGE(0, 20.0)},
         {"hdr-scene-threshold-high", OPT_FLOAT(tone_map.scene_threshold_high),
             M_RANGE(0, 20.0)},
+        {"hdr-peak-pipelined", OPT_FLAG(tone_map.peak_pipelined)},
+        {"hdr-peak-block-size", OPT_INT(tone_map.peak_block_size),
+            M_RANGE(4, 32)},
         {"opengl-pbo", OPT_FLAG(pbo)},
         SCALER_OPTS("scale",  SCALER_SCALE),
         SCALER_OPTS("dscale", SCALER_DSCALE),
@@ -460,8 +509,13 @@ const struct m_sub_options gl_video_conf = {
         {"gpu-tex-pad-y", OPT_INT(tex_pad_y), M_RANGE(0, 4096)},
         {"", OPT_SUBSTRUCT(icc_opts, mp_icc_conf)},
         {"gpu-shader-cache-dir", OPT_STRING(shader_cache_dir), .flags = M_OPT_FILE},
+        {"gpu-shader-cache-size", OPT_BYTE_SIZE(shader_cache_size),
+            M_RANGE(0, M_MAX_MEM_BYTES)},
         {"gpu-hwdec-interop",
             OPT_STRING_VALIDATE(hwdec_interop, ra_hwdec_validate_opt)},
+        {"gpu-auto-quality", OPT_FLAG(auto_quality)},
+        {"gpu-auto-quality-budget", OPT_FLOAT(auto_quality_budget),
+            M_RANGE(0.1, 1.0)},
         {"opengl-hwdec-interop", OPT_REPLACED("gpu-hwdec-interop")},
         {"hwdec-preload", OPT_REPLACED("opengl-hwdec-interop")},
         {"hdr-tone-mapping", OPT_REPLACED("tone-mapping")},
@@ -485,6 +539,8 @@ const struct m_sub_options gl_video_conf = {
     .defaults = &gl_video_opts_def,
 };
 
+#define AUTO_QUALITY_MAX_TIER 3
+
 static void uninit_rendering(struct gl_video *p);
 static void uninit_scaler(struct gl_video *p, struct scaler *scaler);
 static void check_gl_features(struct gl_video *p);
@@ -627,6 +683,18 @@ bool gl_video_icc_auto_enabled(struct gl_video *p)
     return p->opts.icc_opts ? p->opts.icc_opts->profile_auto : false;
 }
 
+static void lut3d_ready_cb(void *ctx)
+{
+    vo_redraw(ctx);
+}
+
+// Redraw vo (which can be NULL) when a 3D LUT computed in the background is
+// ready. Until then, rendering uses the previous LUT.
+void gl_video_set_redraw_vo(struct gl_video *p, struct vo *vo)
+{
+    gl_lcms_set_wakeup_cb(p->cms, vo ? lut3d_ready_cb : NULL, vo);
+}
+
 static bool gl_video_get_lut3d(struct gl_video *p, enum mp_csp_prim prim,
                                enum mp_csp_trc trc)
 {
@@ -637,7 +705,8 @@ static bool gl_video_get_lut3d(struct gl_video *p, enum mp_csp_prim prim,
     if (p->image.mpi)
         icc = p->image.mpi->icc_profile;
 
-    if (p->lut_3d_texture && !gl_lcms_has_changed(p->cms, prim, trc, icc))
+    if (!p->lut_3d_pending && p->lut_3d_texture &&
+        !gl_lcms_has_changed(p->cms, prim, trc, icc))
         return true;
 
     // GLES3 doesn't provide filtered 16 bit integer textures
@@ -650,9 +719,24 @@ static bool gl_video_get_lut3d(struct gl_video *p, enum mp_csp_prim prim,
     }
 
     struct lut3d *lut3d = NULL;
-    if (!fmt || !gl_lcms_get_lut3d(p->cms, &lut3d, prim, trc, icc) || !lut3d) {
-        p->use_lut_3d = false;
-        return false;
+    if (!p->lut_3d_pending || gl_lcms_has_changed(p->cms, prim, trc, icc)) {
+        if (!gl_lcms_request_lut3d(p->cms, &lut3d, prim, trc, icc)) {
+            p->lut_3d_pending = false;
+            p->use_lut_3d = false;
+            return false;
+        }
+        p->lut_3d_pending = !lut3d;
+    }
+
+    if (p->lut_3d_pending) {
+        // Keep using the old LUT (if any) until the new one is done.
+        if (gl_lcms_poll_lut3d(p->cms, &lut3d) == GL_LCMS_LUT_PENDING)
+            return !!p->lut_3d_texture;
+        p->lut_3d_pending = false;
+        if (!lut3d) {
+            p->use_lut_3d = false;
+            return false;
+        }
     }
 
     ra_tex_free(p->ra, &p->lut_3d_texture);
@@ -673,6 +757,8 @@ static bool gl_video_get_lut3d(struct gl_video *p, enum mp_csp_prim prim,
 
     for (int i = 0; i < 3; i++)
         p->lut_3d_size[i] = lut3d->size[i];
+    p->lut_3d_prim = lut3d->prim;
+    p->lut_3d_trc = lut3d->trc;
 
     talloc_free(lut3d);
 
@@ -1368,7 +1454,7 @@ static void skip_unused(struct gl_video *p, int num_components)
 static void uninit_scaler(struct gl_video *p, struct scaler *scaler)
 {
     ra_tex_free(p->ra, &scaler->sep_fbo);
-    ra_tex_free(p->ra, &scaler->lut);
+    scaler->lut = NULL; // owned by p->lut_cache
     scaler->kernel = NULL;
     scaler->initialized = false;
 }
@@ -1463,7 +1549,7 @@ static bool pass_hook_setup_binds(struct gl_video *p, const char *name,
             continue;
 
         // This is a special name that means "currently hooked texture"
-        if (strcmp(bind_name, "HOOKED") == 0) {
+        if (hook->bind_type[t] == BIND_HOOKED) {
             int id = pass_bind(p, img);
             hook_prelude(p, "HOOKED", id, img);
             hook_prelude(p, name, id, img);
@@ -1473,12 +1559,11 @@ static bool pass_hook_setup_binds(struct gl_video *p, const char *name,
         // BIND can also be used to load user-defined textures, in which
         // case we will directly load them as a uniform instead of
         // generating the hook_prelude boilerplate
-        for (int u = 0; u < p->num_user_textures; u++) {
-            struct gl_user_shader_tex *utex = &p->user_textures[u];
-            if (bstr_equals0(utex->name, bind_name)) {
-                gl_sc_uniform_texture(p->sc, bind_name, utex->tex);
-                goto next_bind;
-            }
+        if (hook->bind_type[t] >= 0) {
+            struct gl_user_shader_tex *utex =
+                &p->user_textures[hook->bind_type[t]];
+            gl_sc_uniform_texture(p->sc, bind_name, utex->tex);
+            continue;
         }
 
         struct image bind_img;
@@ -1491,8 +1576,6 @@ static bool pass_hook_setup_binds(struct gl_video *p, const char *name,
         }
 
         hook_prelude(p, bind_name, pass_bind(p, bind_img), bind_img);
-
-next_bind: ;
     }
 
     return true;
@@ -1519,6 +1602,8 @@ static struct image pass_hook(struct gl_video *p, const char *name,
     MP_TRACE(p, "Running hooks for %s\n", name);
     for (int i = 0; i < p->num_tex_hooks; i++) {
         struct tex_hook *hook = &p->tex_hooks[i];
+        if (hook->dead)
+            continue;
 
         // Figure out if this pass hooks this texture
         for (int h = 0; h < SHADER_MAX_HOOKS; h++) {
@@ -1618,6 +1703,8 @@ static void pass_opt_hook_point(struct gl_video *p, const char *name,
 
     for (int i = 0; i < p->num_tex_hooks; i++) {
         struct tex_hook *hook = &p->tex_hooks[i];
+        if (hook->dead)
+            continue;
 
         for (int h = 0; h < SHADER_MAX_HOOKS; h++) {
             if (hook->hook_tex[h] && strcmp(hook->hook_tex[h], name) == 0)
@@ -1695,11 +1782,116 @@ static bool scaler_conf_eq(struct scaler_config a, struct scaler_config b)
            a.clamp == b.clamp;
 }
 
+static bool filter_window_eq(const struct filter_window *a,
+                             const struct filter_window *b)
+{
+    return a->weight == b->weight &&
+           a->radius == b->radius &&
+           double_seq(a->params[0], b->params[0]) &&
+           double_seq(a->params[1], b->params[1]) &&
+           a->blur == b->blur &&
+           a->taper == b->taper;
+}
+
+// Whether a and b (both initialized with mp_init_filter()) produce the same
+// LUT. Doesn't compare radius_cutoff, which is an output of mp_compute_lut().
+static bool filter_kernel_lut_eq(const struct filter_kernel *a,
+                                 const struct filter_kernel *b)
+{
+    return filter_window_eq(&a->f, &b->f) &&
+           filter_window_eq(&a->w, &b->w) &&
+           a->clamp == b->clamp &&
+           double_seq(a->value_cutoff, b->value_cutoff) &&
+           a->polar == b->polar &&
+           a->size == b->size &&
+           a->filter_scale == b->filter_scale;
+}
+
+static void uninit_lut_cache(struct gl_video *p)
+{
+    for (int n = 0; n < LUT_CACHE_SIZE; n++) {
+        ra_tex_free(p->ra, &p->lut_cache[n].lut);
+        p->lut_cache[n] = (struct lut_cache_entry){0};
+    }
+}
+
+// Return the weight LUT texture for the given kernel, which must have been
+// initialized with mp_init_filter(). Computing the LUT and uploading it is
+// expensive, and happens on every change of the scale factor (i.e. on each
+// step of a window resize or zoom), so the textures are cached and reused,
+// which also covers switching between scalers. The texture is owned by the
+// cache. Sets kernel->radius_cutoff like mp_compute_lut().
+static struct ra_tex *get_scaler_lut(struct gl_video *p,
+                                     struct filter_kernel *kernel,
+                                     int lut_size, int stride, bool use_1d,
+                                     const struct ra_format *fmt)
+{
+    struct lut_cache_entry *e = NULL;
+    for (int n = 0; n < LUT_CACHE_SIZE; n++) {
+        struct lut_cache_entry *c = &p->lut_cache[n];
+        if (c->lut && c->lut_size == lut_size && c->stride == stride &&
+            c->use_1d == use_1d && c->fmt == fmt &&
+            filter_kernel_lut_eq(&c->kernel, kernel))
+        {
+            c->last_used = ++p->lut_cache_age;
+            kernel->radius_cutoff = c->radius_cutoff;
+            return c->lut;
+        }
+        // Evict the least recently used entry not in use by any scaler.
+        bool in_use = false;
+        for (int i = 0; i < SCALER_COUNT; i++)
+            in_use |= c->lut && p->scaler[i].lut == c->lut;
+        if (!in_use && (!e || (e->lut && (!c->lut || c->last_used < e->last_used))))
+            e = c;
+    }
+    assert(e); // LUT_CACHE_SIZE > SCALER_COUNT
+
+    ra_tex_free(p->ra, &e->lut);
+
+    float *weights = talloc_array(NULL, float, lut_size * stride);
+    mp_compute_lut(kernel, lut_size, stride, weights);
+
+    struct ra_tex_params lut_params = {
+        .dimensions = use_1d ? 1 : 2,
+        .w = use_1d ? lut_size : stride / fmt->num_components,
+        .h = use_1d ? 1 : lut_size,
+        .d = 1,
+        .format = fmt,
+        .render_src = true,
+        .src_linear = true,
+        .initial_data = weights,
+    };
+    struct ra_tex *lut = ra_tex_create(p->ra, &lut_params);
+
+    talloc_free(weights);
+
+    if (lut) {
+        *e = (struct lut_cache_entry){
+            .kernel = *kernel,
+            .lut_size = lut_size,
+            .stride = stride,
+            .use_1d = use_1d,
+            .fmt = fmt,
+            .lut = lut,
+            .radius_cutoff = kernel->radius_cutoff,
+            .last_used = ++p->lut_cache_age,
+        };
+    }
+    return lut;
+}
+
 static void reinit_scaler(struct gl_video *p, struct scaler *scaler,
                           const struct scaler_config *conf,
                           double scale_factor,
                           int sizes[])
 {
+    // Downscaling widens the kernel by the scale factor. Round it to 1/32
+    // octave (a ~1% wider or narrower kernel at most), so that resizing the
+    // window or zooming doesn't regenerate the LUT and shaders on every step
+    // and can reuse cached LUTs.
+    if (scale_factor > 1.0)
+        scale_factor = exp2(round(log2(scale_factor) * 32) / 32);
+
     if (scaler_conf_eq(scaler->conf, *conf) &&
         scaler->scale_factor == scale_factor &&
         scaler->initialized)
@@ -1773,30 +1965,84 @@ static void reinit_scaler(struct gl_video *p, struct scaler *scaler,
     assert(size <= stride);
 
     scaler->lut_size = 1 << p->opts.scaler_lut_size;
+    bool use_1d = scaler->kernel->polar && (p->ra->caps & RA_CAP_TEX_1D);
+    scaler->lut = get_scaler_lut(p, scaler->kernel, scaler->lut_size, stride,
+                                 use_1d, fmt);
 
-    float *weights = talloc_array(NULL, float, scaler->lut_size * stride);
-    mp_compute_lut(scaler->kernel, scaler->lut_size, stride, weights);
+    debug_check_gl(p, "after initializing scaler");
+}
 
-    bool use_1d = scaler->kernel->polar && (p->ra->caps & RA_CAP_TEX_1D);
+// Special helper for sampling from two separated stages
+// Block sizes for the tiled compute scalers, in order of preference. For
+// performance we want to load at least as many pixels horizontally as there
+// are threads in a warp (32 for nvidia), as well as enough to take advantage
+// of shmem parallelism; smaller blocks only serve to fit the GPU's limits.
+static const int compute_blocks[][2] = {
+    {32, 8}, {16, 16}, {32, 4}, {16, 8}, {8, 8},
+};
 
-    struct ra_tex_params lut_params = {
-        .dimensions = use_1d ? 1 : 2,
-        .w = use_1d ? scaler->lut_size : width,
-        .h = use_1d ? 1 : scaler->lut_size,
-        .d = 1,
-        .format = fmt,
-        .render_src = true,
-        .src_linear = true,
-        .initial_data = weights,
-    };
-    scaler->lut = ra_tex_create(p->ra, &lut_params);
+// Pick the block size for a tiled compute scaler from the work group and
+// shared memory limits reported by the GPU. ratiox/ratioy are the scale
+// factors, pad_x/pad_y the number of extra texels the kernel needs around the
+// block. Returns the block size in *bw/*bh and the input tile size in *iw/*ih,
+// or false if the shader can't run as compute shader.
+static bool pick_compute_block(struct gl_video *p, float ratiox, float ratioy,
+                               int pad_x, int pad_y, int components,
+                               int *bw, int *bh, int *iw, int *ih)
+{
+    if (!(p->ra->caps & RA_CAP_COMPUTE) || !p->fbo_format->storable)
+        return false;
 
-    talloc_free(weights);
+    size_t max_threads = p->ra->max_compute_group_threads;
+    for (int n = 0; n < MP_ARRAY_SIZE(compute_blocks); n++) {
+        int w = compute_blocks[n][0], h = compute_blocks[n][1];
+        if (max_threads && w * h > max_threads)
+            continue;
 
-    debug_check_gl(p, "after initializing scaler");
+        // We need to sample everything from base_min to base_max, so make
+        // sure we have enough room in shmem
+        int tw = (int)ceil(w / ratiox) + pad_x + 1,
+            th = (int)ceil(h / ratioy) + pad_y + 1;
+        if (tw * th * components * sizeof(float) > p->ra->max_shmem)
+            continue;
+
+        *bw = w;
+        *bh = h;
+        *iw = tw;
+        *ih = th;
+        return true;
+    }
+
+    return false;
+}
+
+// One direction of separated scaling, with the prelude already set up. w/h is
+// the size written by this pass.
+static void pass_dispatch_sample_separated(struct gl_video *p,
+                                           struct scaler *scaler,
+                                           struct image img, int d_x, int d_y,
+                                           int w, int h)
+{
+    // Tiling relies on the other axis being neither scaled nor rotated.
+    bool axis_aligned = img.transform.m[0][1] == 0 &&
+                        img.transform.m[1][0] == 0;
+
+    int bw, bh, iw, ih;
+    int pad = scaler->kernel->size - 1;
+    if (axis_aligned &&
+        pick_compute_block(p, d_x ? (float)w / img.w : 1.0,
+                           d_y ? (float)h / img.h : 1.0, d_x ? pad : 0,
+                           d_y ? pad : 0, img.components, &bw, &bh, &iw, &ih))
+    {
+        pass_is_compute(p, bw, bh, false);
+        pass_compute_separated(p->sc, scaler, img.components, d_x, d_y,
+                               bw, bh, iw, ih);
+        return;
+    }
+
+    pass_sample_separated_gen(p->sc, scaler, d_x, d_y);
 }
 
-// Special helper for sampling from two separated stages
 static void pass_sample_separated(struct gl_video *p, struct image src,
                                   struct scaler *scaler, int w, int h)
 {
@@ -1814,7 +2060,7 @@ static void pass_sample_separated(struct gl_video *p, struct image src,
     src.transform = t_y;
     sampler_prelude(p->sc, pass_bind(p, src));
     GLSLF("// first pass\n");
-    pass_sample_separated_gen(p->sc, scaler, 0, 1);
+    pass_dispatch_sample_separated(p, scaler, src, 0, 1, src.w, h);
     GLSLF("color *= %f;\n", src.multiplier);
     finish_pass_tex(p, &scaler->sep_fbo, src.w, h);
 
@@ -1823,7 +2069,7 @@ static void pass_sample_separated(struct gl_video *p, struct image src,
     src.transform = t_x;
     pass_describe(p, "%s second pass", scaler->conf.kernel.name);
     sampler_prelude(p->sc, pass_bind(p, src));
-    pass_sample_separated_gen(p->sc, scaler, 1, 0);
+    pass_dispatch_sample_separated(p, scaler, src, 1, 0, w, h);
 }
 
 // Picks either the compute shader version or the regular sampler version
@@ -1831,10 +2077,6 @@ static void pass_sample_separated(struct gl_video *p, struct image src,
 static void pass_dispatch_sample_polar(struct gl_video *p, struct scaler *scaler,
                                        struct image img, int w, int h)
 {
-    uint64_t reqs = RA_CAP_COMPUTE;
-    if ((p->ra->caps & reqs) != reqs)
-        goto fallback;
-
     int bound = ceil(scaler->kernel->radius_cutoff);
     int offset = bound - 1; // padding top/left
     int padding = offset + bound; // total padding
@@ -1842,20 +2084,9 @@ static void pass_dispatch_sample_polar(struct gl_video *p, struct scaler *scaler
     float ratiox = (float)w / img.w,
           ratioy = (float)h / img.h;
 
-    // For performance we want to load at least as many pixels
-    // horizontally as there are threads in a warp (32 for nvidia), as
-    // well as enough to take advantage of shmem parallelism
-    const int warp_size = 32, threads = 256;
-    int bw = warp_size;
-    int bh = threads / bw;
-
-    // We need to sample everything from base_min to base_max, so make sure
-    // we have enough room in shmem
-    int iw = (int)ceil(bw / ratiox) + padding + 1,
-        ih = (int)ceil(bh / ratioy) + padding + 1;
-
-    int shmem_req = iw * ih * img.components * sizeof(float);
-    if (shmem_req > p->ra->max_shmem)
+    int bw, bh, iw, ih;
+    if (!pick_compute_block(p, ratiox, ratioy, padding, padding, img.components,
+                            &bw, &bh, &iw, &ih))
         goto fallback;
 
     pass_is_compute(p, bw, bh, false);
@@ -1864,7 +2095,7 @@ static void pass_dispatch_sample_polar(struct gl_video *p, struct scaler *scaler
 
 fallback:
     // Fall back to regular polar shader when compute shaders are unsupported
-    // or the kernel is too big for shmem
+    // or the kernel is too big for shmem, even with the smallest block size
     pass_sample_polar(p->sc, scaler, img.components,
                       p->ra->caps & RA_CAP_GATHER);
 }
@@ -2084,6 +2315,95 @@ static void load_user_shaders(struct gl_video *p, char **shaders)
     }
 }
 
+static bool hook_is_overwrite(struct tex_hook *hook)
+{
+    if (!hook->save_tex)
+        return true;
+    for (int h = 0; h < SHADER_MAX_HOOKS; h++) {
+        if (hook->hook_tex[h] && strcmp(hook->hook_tex[h], hook->save_tex) == 0)
+            return true;
+    }
+    return false;
+}
+
+// Whether any live hook binds the named texture or uses its size.
+static bool hook_output_used(struct gl_video *p, const char *name)
+{
+    for (int i = 0; i < p->num_tex_hooks; i++) {
+        struct tex_hook *hook = &p->tex_hooks[i];
+        if (hook->dead)
+            continue;
+
+        for (int b = 0; b < SHADER_MAX_BINDS; b++) {
+            if (hook->bind_tex[b] && strcmp(hook->bind_tex[b], name) == 0)
+                return true;
+        }
+
+        if (hook->hook == user_hook) {
+            struct gl_user_shader_hook *shader = hook->priv;
+            if (szexpr_uses_var(shader->width, name) ||
+                szexpr_uses_var(shader->height, name) ||
+                szexpr_uses_var(shader->cond, name))
+                return true;
+        }
+    }
+    return false;
+}
+
+// Resolve the texture bindings of all hooks, and mark hooks that never run
+// (constant false WHEN), or which only save textures nothing uses. This is
+// done once per configuration, so pass_hook() has less to do per frame.
+static void compile_hooks(struct gl_video *p)
+{
+    for (int i = 0; i < p->num_tex_hooks; i++) {
+        struct tex_hook *hook = &p->tex_hooks[i];
+
+        for (int b = 0; b < SHADER_MAX_BINDS; b++) {
+            const char *name = hook->bind_tex[b];
+            hook->bind_type[b] = BIND_SAVED;
+            if (!name)
+                continue;
+            if (strcmp(name, "HOOKED") == 0) {
+                hook->bind_type[b] = BIND_HOOKED;
+                continue;
+            }
+            for (int u = 0; u < p->num_user_textures; u++) {
+                if (bstr_equals0(p->user_textures[u].name, name)) {
+                    hook->bind_type[b] = u;
+                    break;
+                }
+            }
+        }
+
+        float cond;
+        hook->dead = false;
+        if (hook->hook == user_hook) {
+            struct gl_user_shader_hook *shader = hook->priv;
+            if (szexpr_is_const(shader->cond, &cond) && !cond) {
+                MP_VERBOSE(p, "Skipping user shader pass '%.*s': never "
+                           "enabled.\n", BSTR_P(shader->pass_desc));
+                hook->dead = true;
+            }
+        }
+    }
+
+    // Removing a pass can make the passes it consumes unused.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < p->num_tex_hooks; i++) {
+            struct tex_hook *hook = &p->tex_hooks[i];
+            if (hook->dead || hook_is_overwrite(hook) ||
+                hook_output_used(p, hook->save_tex))
+                continue;
+            MP_VERBOSE(p, "Skipping hook pass saving %s: never used.\n",
+                       hook->save_tex);
+            hook->dead = true;
+            changed = true;
+        }
+    }
+}
+
 static void gl_video_setup_hooks(struct gl_video *p)
 {
     gl_video_reset_hooks(p);
@@ -2105,6 +2425,7 @@ static void gl_video_setup_hooks(struct gl_video *p)
     }
 
     load_user_shaders(p, p->opts.user_shaders);
+    compile_hooks(p);
 }
 
 // sample from video textures, set "color" variable to yuv value
@@ -2336,7 +2657,7 @@ static void pass_convert_yuv(struct gl_video *p)
     // Conversion to RGB. For RGB itself, this still applies e.g. brightness
     // and contrast controls, or expansion of e.g. LSB-packed 10 bit data.
     struct mp_cmat m = {{{0}}};
-    mp_get_csp_matrix(&cparams, &m);
+    mp_get_csp_matrix_cached(&p->csp_matrix, &cparams, &m);
     gl_sc_uniform_mat3(sc, "colormatrix", true, &m.m[0][0]);
     gl_sc_uniform_vec3(sc, "colormatrix_c", m.c);
 
@@ -2579,9 +2900,11 @@ static void pass_colormanage(struct gl_video *p, struct mp_colorspace src,
         if (mp_trc_is_hdr(trc_orig))
             trc_orig = MP_CSP_TRC_GAMMA22;
 
+        // While a new LUT is computed, this can be the previous one, which
+        // was generated for a different source space.
         if (gl_video_get_lut3d(p, prim_orig, trc_orig)) {
-            dst.primaries = prim_orig;
-            dst.gamma = trc_orig;
+            dst.primaries = p->lut_3d_prim;
+            dst.gamma = p->lut_3d_trc;
             assert(dst.primaries && dst.gamma);
         }
     }
@@ -2670,7 +2993,13 @@ static void pass_colormanage(struct gl_video *p, struct mp_colorspace src,
     bool detect_peak = tone_map.compute_peak >= 0 && mp_trc_is_hdr(src.gamma)
                        && src.sig_peak > dst.sig_peak;
 
-    if (detect_peak && !p->hdr_peak_ssbo) {
+    // In pipelined mode, each frame accumulates into one buffer, while tone
+    // mapping reads the result of the previous frame from the other one.
+    int num_bufs = tone_map.peak_pipelined ? 2 : 1;
+    for (int n = 0; detect_peak && n < num_bufs; n++) {
+        if (p->hdr_peak_ssbo[n])
+            continue;
+
         struct {
             float average[2];
             int32_t frame_sum;
@@ -2684,8 +3013,8 @@ static void pass_colormanage(struct gl_video *p, struct mp_colorspace src,
             .initial_data = &peak_ssbo,
         };
 
-        p->hdr_peak_ssbo = ra_buf_create(ra, &params);
-        if (!p->hdr_peak_ssbo) {
+        p->hdr_peak_ssbo[n] = ra_buf_create(ra, &params);
+        if (!p->hdr_peak_ssbo[n]) {
             MP_WARN(p, "Failed to create HDR peak detection SSBO, disabling.\n");
             tone_map.compute_peak = p->opts.tone_map.compute_peak = -1;
             detect_peak = false;
@@ -2694,8 +3023,20 @@ static void pass_colormanage(struct gl_video *p, struct mp_colorspace src,
 
     if (detect_peak) {
         pass_describe(p, "detect HDR peak");
-        pass_is_compute(p, 8, 8, true); // 8x8 is good for performance
-        gl_sc_ssbo(p->sc, "PeakDetect", p->hdr_peak_ssbo,
+        // 8x8 (the default) is good for performance on most GPUs
+        int bs = tone_map.peak_block_size;
+        while (bs > 1 && bs * bs > ra->max_compute_group_threads)
+            bs /= 2;
+        pass_is_compute(p, bs, bs, true);
+        if (tone_map.peak_pipelined) {
+            p->hdr_peak_idx = !p->hdr_peak_idx;
+            gl_sc_ssbo(p->sc, "PeakPrev", p->hdr_peak_ssbo[!p->hdr_peak_idx],
+                "vec2 prev_average;"
+            );
+        } else {
+            p->hdr_peak_idx = 0;
+        }
+        gl_sc_ssbo(p->sc, "PeakDetect", p->hdr_peak_ssbo[p->hdr_peak_idx],
             "vec2 average;"
             "int frame_sum;"
             "uint frame_max;"
@@ -2738,7 +3079,11 @@ static void pass_dither(struct gl_video *p)
         int o_w = p->dst_rect.x1 - p->dst_rect.x0,
             o_h = p->dst_rect.y1 - p->dst_rect.y0;
 
-        int shmem_req = mp_ef_compute_shared_memory_size(kernel, o_h);
+        int rows, out_rows;
+        mp_ef_stripe_layout(o_h, p->ra->max_compute_group_threads,
+                            &rows, &out_rows);
+
+        int shmem_req = mp_ef_compute_shared_memory_size(kernel, rows);
         if (shmem_req > p->ra->max_shmem) {
             MP_WARN(p, "Fallback to dither=fruit because there is no enough "
                        "shared memory (%d/%d).\n",
@@ -2749,26 +3094,27 @@ static void pass_dither(struct gl_video *p)
 
             struct image img = image_wrap(p->error_diffusion_tex[0], PLANE_RGB, p->components);
 
-            // Ensure the block size doesn't exceed the maximum of the
-            // implementation.
-            int block_size = MPMIN(p->ra->max_compute_group_threads, o_h);
-
             pass_describe(p, "dither=error-diffusion (kernel=%s, depth=%d)",
                              kernel->name, dst_depth);
 
+            // One workgroup per stripe.
             p->pass_compute = (struct compute_info) {
                 .active = true,
-                .threads_w = block_size,
+                .threads_w = rows,
                 .threads_h = 1,
+                .block_h = out_rows,
                 .directly_writes = true
             };
 
             int tex_id = pass_bind(p, img);
 
             pass_error_diffusion(p->sc, kernel, tex_id, o_w, o_h,
-                                 dst_depth, block_size);
+                                 dst_depth, rows, out_rows);
 
+            int pass_idx = p->pass_idx;
             finish_pass_tex(p, &p->error_diffusion_tex[1], o_w, o_h);
+            if (p->pass && p->pass_idx > pass_idx)
+                p->error_diffusion_time = p->pass[pass_idx].perf.avg;
 
             img = image_wrap(p->error_diffusion_tex[1], PLANE_RGB, p->components);
             copy_image(p, &(int){0}, img);
@@ -2954,6 +3300,35 @@ static void pass_render_frame_dumb(struct gl_video *p)
     pass_convert_yuv(p);
 }
 
+// Record what pass_draw_osd() blended into the video, so that redraws of the
+// cached frame can check whether the subtitles changed since.
+static void remember_blended_subs(struct gl_video *p, struct mp_osd_res rect,
+                                  double pts, int flags)
+{
+    p->output_subs_res = rect;
+    p->output_subs_pts = pts;
+    p->output_subs_flags = flags & (RENDER_FRAME_SUBS | RENDER_FRAME_VF_SUBS);
+    p->output_subs_id = mpgl_osd_get_change_id(p->osd);
+}
+
+// Whether rendering the current frame with the given flags would blend
+// different subtitles than the frame cached in output_tex.
+static bool blended_subs_changed(struct gl_video *p, int flags)
+{
+    if (!p->osd || !(flags & RENDER_FRAME_SUBS))
+        return p->output_subs_id != 0;
+    if (!p->output_subs_id ||
+        p->output_subs_flags != (flags & (RENDER_FRAME_SUBS | RENDER_FRAME_VF_SUBS)))
+        return true;
+
+    int osd_flags = OSD_DRAW_SUB_ONLY;
+    if (flags & RENDER_FRAME_VF_SUBS)
+        osd_flags |= OSD_DRAW_SUB_FILTER;
+    mpgl_osd_generate(p->osd, p->output_subs_res, p->output_subs_pts,
+                      p->image_params.stereo3d, osd_flags);
+    return mpgl_osd_get_change_id(p->osd) != p->output_subs_id;
+}
+
 // The main rendering function, takes care of everything up to and including
 // upscaling. p->image is rendered.
 // flags: bit set of RENDER_FRAME_* flags
@@ -2968,6 +3343,7 @@ static bool pass_render_frame(struct gl_video *p, struct mp_image *mpi,
     p->num_saved_imgs = 0;
     p->idx_hook_textures = 0;
     p->use_linear = false;
+    p->output_subs_id = 0;
 
     // try uploading the frame
     if (!pass_upload_image(p, mpi, id))
@@ -3001,6 +3377,7 @@ static bool pass_render_frame(struct gl_video *p, struct mp_image *mpi,
         finish_pass_tex(p, &p->blend_subs_tex, rect.w, rect.h);
         struct ra_fbo fbo = { p->blend_subs_tex };
         pass_draw_osd(p, OSD_DRAW_SUB_ONLY, flags, vpts, rect, fbo, false);
+        remember_blended_subs(p, rect, vpts, flags);
         pass_read_tex(p, p->blend_subs_tex);
         pass_describe(p, "blend subs video");
     }
@@ -3033,6 +3410,7 @@ static bool pass_render_frame(struct gl_video *p, struct mp_image *mpi,
         finish_pass_tex(p, &p->blend_subs_tex, p->texture_w, p->texture_h);
         struct ra_fbo fbo = { p->blend_subs_tex };
         pass_draw_osd(p, OSD_DRAW_SUB_ONLY, flags, vpts, rect, fbo, false);
+        remember_blended_subs(p, rect, vpts, flags);
         pass_read_tex(p, p->blend_subs_tex);
         pass_describe(p, "blend subs");
     }
@@ -3291,6 +3669,95 @@ static void gl_video_interpolate_frame(struct gl_video *p, struct vo_frame *t,
     p->frames_drawn += 1;
 }
 
+// Frames the GPU time has to stay over (or under half of) the budget before
+// the quality tier is changed. Stepping up is much more conservative, and
+// the delay is doubled each time a step up had to be reverted.
+#define AQ_DOWN_FRAMES 10
+#define AQ_UP_FRAMES 300
+#define AQ_UP_FRAMES_MAX (AQ_UP_FRAMES * 16)
+// Frames to skip after a tier change, so the timers can measure the new
+// shaders.
+#define AQ_SETTLE_FRAMES 30
+
+static void update_auto_quality(struct gl_video *p, struct vo_frame *frame)
+{
+    if (!p->opts.auto_quality || frame->vsync_interval <= 0)
+        return;
+
+    if (p->aq_settle > 0) {
+        p->aq_settle--;
+        return;
+    }
+
+    uint64_t total = 0;
+    for (int n = 0; n < VO_PASS_PERF_MAX; n++) {
+        if (p->pass_fresh[n].desc.len)
+            total += p->pass_fresh[n].perf.avg;
+    }
+    if (!total)
+        return; // no GPU timers
+
+    double budget = frame->vsync_interval * 1e3 * p->opts.auto_quality_budget;
+    if (!p->aq_up_frames)
+        p->aq_up_frames = AQ_UP_FRAMES;
+
+    int tier = p->quality_tier;
+    if (total > budget) {
+        p->aq_under = 0;
+        if (++p->aq_over >= AQ_DOWN_FRAMES && tier < AUTO_QUALITY_MAX_TIER) {
+            tier++;
+            if (p->aq_last_up)
+                p->aq_up_frames = MPMIN(p->aq_up_frames * 2, AQ_UP_FRAMES_MAX);
+        }
+    } else if (total < budget / 2) {
+        p->aq_over = 0;
+        if (++p->aq_under >= p->aq_up_frames && tier > 0)
+            tier--;
+    } else {
+        p->aq_over = p->aq_under = 0;
+    }
+
+    if (tier == p->quality_tier)
+        return;
+
+    MP_VERBOSE(p, "Switching to quality tier %d (GPU time %.2f ms, "
+               "budget %.2f ms).\n", tier, total / 1e6, budget / 1e6);
+    p->aq_last_up = tier < p->quality_tier;
+    p->quality_tier = tier;
+    p->aq_over = p->aq_under = 0;
+    p->aq_settle = AQ_SETTLE_FRAMES;
+    reinit_from_options(p);
+}
+
+// Error diffusion falls back to fruit dithering (an ordered dither matrix) if
+// the pass takes more than this fraction of the frame time for a number of
+// consecutive frames.
+#define EF_MAX_FRAME_FRACTION 0.5
+#define EF_SLOW_FRAMES 10
+
+static void check_error_diffusion_time(struct gl_video *p,
+                                       struct vo_frame *frame)
+{
+    uint64_t time = p->error_diffusion_time;
+    p->error_diffusion_time = 0;
+    if (p->opts.dither_algo != DITHER_ERROR_DIFFUSION || !time ||
+        frame->vsync_interval <= 0)
+        return;
+
+    double budget = frame->vsync_interval * 1e3 * EF_MAX_FRAME_FRACTION;
+    if (time <= budget) {
+        p->error_diffusion_slow = 0;
+        return;
+    }
+    if (++p->error_diffusion_slow < EF_SLOW_FRAMES)
+        return;
+
+    MP_WARN(p, "Fallback to dither=fruit because error diffusion is too slow "
+               "(%.2f ms, budget %.2f ms).\n", time / 1e6, budget / 1e6);
+    p->opts.dither_algo = DITHER_FRUIT;
+    p->error_diffusion_slow = 0;
+}
+
 void gl_video_render_frame(struct gl_video *p, struct vo_frame *frame,
                            struct ra_fbo fbo, int flags)
 {
@@ -3300,6 +3767,10 @@ void gl_video_render_frame(struct gl_video *p, struct vo_frame *frame,
 
     p->broken_frame = false;
 
+    // A LUT computed in the background changes the output of cached frames.
+    if (p->lut_3d_pending && gl_lcms_lut3d_ready(p->cms))
+        p->output_tex_valid = false;
+
     bool has_frame = !!frame->current;
 
     struct m_color c = p->clear_color;
@@ -3337,9 +3808,10 @@ void gl_video_render_frame(struct gl_video *p, struct vo_frame *frame,
         } else {
             bool is_new = frame->frame_id != p->image.id;
 
-            // Redrawing a frame might update subtitles.
-            if (frame->still && p->opts.blend_subs)
-                is_new = true;
+            // Redrawing a frame might update subtitles. Only render it again
+            // if they actually changed; OSD-only redraws reuse the cache.
+            if (frame->still && p->opts.blend_subs && p->output_tex_valid)
+                is_new |= blended_subs_changed(p, flags);
 
             if (is_new || !p->output_tex_valid) {
                 p->output_tex_valid = false;
@@ -3352,9 +3824,7 @@ void gl_video_render_frame(struct gl_video *p, struct vo_frame *frame,
                 // texture to speed up subsequent re-draws (if any exist)
                 struct ra_fbo dest_fbo = fbo;
                 bool repeats = frame->num_vsyncs > 1 && frame->display_synced;
-                if ((repeats || frame->still) && !p->dumb_mode &&
-                    (p->ra->caps & RA_CAP_BLIT) && fbo.tex->params.blit_dst)
-                {
+                if ((repeats || frame->still) && !p->dumb_mode) {
                     // Attempt to use the same format as the destination FBO
                     // if possible. Some RAs use a wrapped dummy format here,
                     // so fall back to the fbo_format in that case.
@@ -3374,19 +3844,32 @@ void gl_video_render_frame(struct gl_video *p, struct vo_frame *frame,
             }
 
             // "output tex valid" and "output tex needed" are equivalent
-            if (p->output_tex_valid && fbo.tex->params.blit_dst) {
+            if (p->output_tex_valid) {
                 pass_info_reset(p, true);
                 pass_describe(p, "redraw cached frame");
-                struct mp_rect src = p->dst_rect;
-                struct mp_rect dst = src;
-                if (fbo.flip) {
-                    dst.y0 = fbo.tex->params.h - src.y0;
-                    dst.y1 = fbo.tex->params.h - src.y1;
+                if ((p->ra->caps & RA_CAP_BLIT) && fbo.tex->params.blit_dst) {
+                    struct mp_rect src = p->dst_rect;
+                    struct mp_rect dst = src;
+                    if (fbo.flip) {
+                        dst.y0 = fbo.tex->params.h - src.y0;
+                        dst.y1 = fbo.tex->params.h - src.y1;
+                    }
+                    timer_pool_start(p->blit_timer);
+                    p->ra->fns->blit(p->ra, fbo.tex, p->output_tex, &dst, &src);
+                    timer_pool_stop(p->blit_timer);
+                    pass_record(p, timer_pool_measure(p->blit_timer));
+                } else {
+                    // No blitting (e.g. GLES2, or a wrapped FBO): copy the
+                    // video rectangle with a trivial shader pass instead.
+                    struct image img = image_wrap(p->output_tex, PLANE_RGB,
+                                    p->output_tex->params.format->num_components);
+                    img.w = mp_rect_w(p->dst_rect);
+                    img.h = mp_rect_h(p->dst_rect);
+                    img.transform.t[0] = p->dst_rect.x0;
+                    img.transform.t[1] = p->dst_rect.y0;
+                    copy_image(p, &(int){0}, img);
+                    finish_pass_fbo(p, fbo, false, &p->dst_rect);
                 }
-                timer_pool_start(p->blit_timer);
-                p->ra->fns->blit(p->ra, fbo.tex, p->output_tex, &dst, &src);
-                timer_pool_stop(p->blit_timer);
-                pass_record(p, timer_pool_measure(p->blit_timer));
             }
         }
     }
@@ -3422,6 +3905,11 @@ done:
 
     p->frames_rendered++;
     pass_report_performance(p);
+
+    if (has_frame && !frame->still && p->pass == p->pass_fresh) {
+        check_error_diffusion_time(p, frame);
+        update_auto_quality(p, frame);
+    }
 }
 
 void gl_video_screenshot(struct gl_video *p, struct vo_frame *frame,
@@ -3576,6 +4064,8 @@ void gl_video_perfdata(struct gl_video *p, struct voctrl_performance_data *out)
     *out = (struct voctrl_performance_data){0};
     frame_perf_data(p->pass_fresh,  &out->fresh);
     frame_perf_data(p->pass_redraw, &out->redraw);
+    out->auto_quality = p->opts.auto_quality;
+    out->quality_tier = p->quality_tier;
 }
 
 // Returns false on failure.
@@ -3920,11 +4410,13 @@ void gl_video_uninit(struct gl_video *p)
         return;
 
     uninit_video(p);
+    uninit_lut_cache(p);
     ra_hwdec_ctx_uninit(&p->hwdec_ctx);
     gl_sc_destroy(p->sc);
 
     ra_tex_free(p->ra, &p->lut_3d_texture);
-    ra_buf_free(p->ra, &p->hdr_peak_ssbo);
+    for (int n = 0; n < 2; n++)
+        ra_buf_free(p->ra, &p->hdr_peak_ssbo[n]);
 
     timer_pool_destroy(p->upload_timer);
     timer_pool_destroy(p->blit_timer);
@@ -4070,6 +4562,47 @@ static void gl_video_update_options(struct gl_video *p)
         p->output_tex_valid = false;
 }
 
+// Replace a convolution scaler (anything not in the fixed filter lists) with
+// the given cheaper one.
+static void limit_scaler(struct gl_video_opts *opts, int unit, const char *name)
+{
+    struct scaler_config *conf = &opts->scaler[unit];
+    const char *cur = conf->kernel.name;
+    if (unit == SCALER_DSCALE && !cur)
+        cur = opts->scaler[SCALER_SCALE].kernel.name;
+    if (cur && !mp_find_filter_kernel(cur))
+        return;
+    conf->kernel.name = (char *)name;
+}
+
+// Degrade p->opts according to the --gpu-auto-quality tier. Each tier
+// includes the previous ones.
+static void apply_quality_tier(struct gl_video *p)
+{
+    struct gl_video_opts *o = &p->opts;
+
+    if (!o->auto_quality)
+        p->quality_tier = 0;
+
+    if (p->quality_tier >= 1) {
+        o->deband = 0;
+        o->correct_downscaling = 0;
+        o->linear_downscaling = 0;
+        o->linear_upscaling = 0;
+        o->sigmoid_upscaling = 0;
+        limit_scaler(o, SCALER_TSCALE, "oversample");
+    }
+    if (p->quality_tier >= 2) {
+        limit_scaler(o, SCALER_DSCALE, "bilinear");
+        limit_scaler(o, SCALER_CSCALE, "bilinear");
+        limit_scaler(o, SCALER_SCALE, "bicubic_fast");
+    }
+    if (p->quality_tier >= 3) {
+        o->user_shaders = NULL;
+        o->scaler[SCALER_SCALE].kernel.name = "bilinear";
+    }
+}
+
 static void reinit_from_options(struct gl_video *p)
 {
     p->use_lut_3d = gl_lcms_has_profile(p->cms);
@@ -4078,13 +4611,15 @@ static void reinit_from_options(struct gl_video *p)
     // This works only for the fields themselves of course, not for any memory
     // referenced by them.
     p->opts = *(struct gl_video_opts *)p->opts_cache->opts;
+    apply_quality_tier(p);
 
     if (!p->force_clear_color)
         p->clear_color = p->opts.background;
 
     check_gl_features(p);
     uninit_rendering(p);
-    gl_sc_set_cache_dir(p->sc, p->opts.shader_cache_dir);
+    gl_sc_set_cache_dir(p->sc, p->opts.shader_cache_dir,
+                        p->opts.shader_cache_size);
     p->ra->use_pbo = p->opts.pbo;
     gl_video_setup_hooks(p);
     reinit_osd(p);
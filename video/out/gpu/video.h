@@ -127,6 +127,8 @@ struct gl_tone_map_opts {
     float decay_rate;
     float scene_threshold_low;
     float scene_threshold_high;
+    int peak_pipelined;
+    int peak_block_size;
     int gamut_mode;
 };
 
@@ -169,7 +171,10 @@ struct gl_video_opts {
     struct mp_icc_opts *icc_opts;
     int early_flush;
     char *shader_cache_dir;
+    int64_t shader_cache_size;
     char *hwdec_interop;
+    int auto_quality;
+    float auto_quality_budget;
 };
 
 extern const struct m_sub_options gl_video_conf;
@@ -211,6 +216,7 @@ float gl_video_scale_ambient_lux(float lmin, float lmax,
 void gl_video_set_ambient_lux(struct gl_video *p, int lux);
 void gl_video_set_icc_profile(struct gl_video *p, bstr icc_data);
 bool gl_video_icc_auto_enabled(struct gl_video *p);
+void gl_video_set_redraw_vo(struct gl_video *p, struct vo *vo);
 bool gl_video_gamma_auto_enabled(struct gl_video *p);
 struct mp_colorspace gl_video_get_output_colorspace(struct gl_video *p);
 
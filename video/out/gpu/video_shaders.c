@@ -249,6 +249,68 @@ void pass_compute_polar(struct gl_shader_cache *sc, struct scaler *scaler,
     GLSLF("}\n");
 }
 
+// Compute shader version of pass_sample_separated_gen(). The texels needed by
+// the whole work group are loaded into shmem once, instead of every pixel
+// fetching all of its (mostly shared) taps from the texture. (d_x, d_y) is the
+// scaling direction; the other axis must map 1:1 to the output.
+// bw/bh: block size
+// iw/ih: input size (pre-calculated to fit all required texels)
+void pass_compute_separated(struct gl_shader_cache *sc, struct scaler *scaler,
+                            int components, int d_x, int d_y,
+                            int bw, int bh, int iw, int ih)
+{
+    int N = scaler->kernel->size;
+    int offset = N / 2 - 1; // padding before the first tap
+    bool use_ar = scaler->conf.antiring > 0;
+
+    GLSL(color = vec4(0.0);)
+    GLSLF("{\n");
+    GLSLF("vec2 dir = vec2(%d.0, %d.0);\n", d_x, d_y);
+    GLSL(vec2 wpos = texmap(gl_WorkGroupID * gl_WorkGroupSize);)
+    GLSL(vec2 wbase = wpos - dir * pt * fract(wpos * size - vec2(0.5));)
+    GLSL(float fcoord = dot(fract(pos * size - vec2(0.5)), dir);)
+    GLSL(vec2 base = pos - dir * pt * fract(pos * size - vec2(0.5));)
+    GLSL(ivec2 rel = ivec2(round((base - wbase) * size));)
+    GLSL(int idx;)
+
+    // Load all relevant texels into shmem
+    for (int c = 0; c < components; c++)
+        GLSLHF("shared float in%d[%d];\n", c, ih * iw);
+
+    GLSL(vec4 c;)
+    GLSLF("for (int y = int(gl_LocalInvocationID.y); y < %d; y += %d) {\n", ih, bh);
+    GLSLF("for (int x = int(gl_LocalInvocationID.x); x < %d; x += %d) {\n", iw, bw);
+    GLSLF("c = texture(tex, wbase + pt * (vec2(x, y) - dir * vec2(%d.0)));\n",
+          offset);
+    for (int c = 0; c < components; c++)
+        GLSLF("in%d[%d * y + x] = c[%d];\n", c, iw, c);
+    GLSLF("}}\n");
+    GLSL(groupMemoryBarrier();)
+    GLSL(barrier();)
+
+    if (use_ar) {
+        GLSL(vec4 hi = vec4(0.0);)
+        GLSL(vec4 lo = vec4(1.0);)
+    }
+    pass_sample_separated_get_weights(sc, scaler);
+    GLSL(c = vec4(0.0);)
+    GLSLF("// scaler samples\n");
+    for (int n = 0; n < N; n++) {
+        GLSLF("idx = %d * (rel.y + %d) + rel.x + %d;\n", iw, n * d_y, n * d_x);
+        for (int i = 0; i < components; i++)
+            GLSLF("c[%d] = in%d[idx];\n", i, i);
+        GLSLF("color += vec4(weights[%d]) * c;\n", n);
+        if (use_ar && (n == N/2-1 || n == N/2)) {
+            GLSL(lo = min(lo, c);)
+            GLSL(hi = max(hi, c);)
+        }
+    }
+    if (use_ar)
+        GLSLF("color = mix(color, clamp(color, lo, hi), %f);\n",
+              scaler->conf.antiring);
+    GLSLF("}\n");
+}
+
 static void bicubic_calcweights(struct gl_shader_cache *sc, const char *t, const char *s)
 {
     // Explanation of how bicubic scaling with only 4 texel fetches is done:
@@ -596,10 +658,12 @@ static const float sdr_avg = 0.25;
 static void hdr_update_peak(struct gl_shader_cache *sc,
                             const struct gl_tone_map_opts *opts)
 {
-    // Update the sig_peak/sig_avg from the old SSBO state
-    GLSL(if (average.y > 0.0) {)
-    GLSL(    sig_avg  = max(1e-3, average.x);)
-    GLSL(    sig_peak = max(1.00, average.y);)
+    // Update the sig_peak/sig_avg from the old SSBO state. In pipelined mode,
+    // this is the previous frame's buffer, which this dispatch never writes.
+    const char *avg = opts->peak_pipelined ? "prev_average" : "average";
+    GLSLF("if (%s.y > 0.0) {\n", avg);
+    GLSLF("    sig_avg  = max(1e-3, %s.x);\n", avg);
+    GLSLF("    sig_peak = max(1.00, %s.y);\n", avg);
     GLSL(})
 
     // Chosen to avoid overflowing on an 8K buffer
@@ -633,6 +697,8 @@ static void hdr_update_peak(struct gl_shader_cache *sc,
     GLSL(    vec2 cur = vec2(float(frame_sum) / float(num_wg), frame_max);)
     GLSLF("  cur *= vec2(1.0/%f, 1.0/%f);\n", log_scale, sig_scale);
     GLSL(    cur.x = exp(cur.x);)
+    if (opts->peak_pipelined)
+        GLSL(    average = prev_average;)
     GLSL(    if (average.y == 0.0))
     GLSL(        average = cur;)
 
@@ -40,6 +40,9 @@ void pass_sample_polar(struct gl_shader_cache *sc, struct scaler *scaler,
                        int components, bool sup_gather);
 void pass_compute_polar(struct gl_shader_cache *sc, struct scaler *scaler,
                         int components, int bw, int bh, int iw, int ih);
+void pass_compute_separated(struct gl_shader_cache *sc, struct scaler *scaler,
+                            int components, int d_x, int d_y,
+                            int bw, int bh, int iw, int ih);
 void pass_sample_bicubic_fast(struct gl_shader_cache *sc);
 void pass_sample_oversample(struct gl_shader_cache *sc, struct scaler *scaler,
                             int w, int h);
@@ -17,11 +17,22 @@
 
 #pragma once
 
+#include <libavutil/buffer.h>
 #include <libavutil/hwcontext_drm.h>
 
 #include "config.h"
 #include "video/out/gpu/hwdec.h"
 
+// Decoders cycle through a fixed pool of surfaces, so imported surfaces are
+// kept by the interop and reused when the same surface is mapped again.
+#define DMABUF_INTEROP_CACHE_SIZE 32
+
+// Identifies a surface for the import cache. pool==NULL disables caching.
+struct dmabuf_interop_key {
+    const void *pool;
+    uint64_t id[2];
+};
+
 struct dmabuf_interop {
     bool use_modifiers;
 
@@ -33,6 +44,13 @@ struct dmabuf_interop {
                         struct dmabuf_interop *dmabuf_interop,
                         bool probing);
     void (*interop_unmap)(struct ra_hwdec_mapper *mapper);
+
+    // Optional. Map the surface identified by dmabuf_interop_priv.key from
+    // an earlier import. Returns false if it is not cached; the caller then
+    // has to set up desc and call interop_map, which adds it to the cache.
+    bool (*interop_map_cached)(struct ra_hwdec_mapper *mapper);
+    // Optional. Drop all cached imports.
+    void (*interop_flush)(struct ra_hwdec_mapper *mapper);
 };
 
 struct dmabuf_interop_priv {
@@ -43,6 +61,10 @@ struct dmabuf_interop_priv {
     AVDRMFrameDescriptor desc;
     bool surface_acquired;
 
+    struct dmabuf_interop_key key;
+    AVBufferRef *pool_ref; // keeps key.pool alive, if needed
+    bool swap_uv;          // VAAPI YV12: swap the chroma planes after mapping
+
     void *interop_mapper_priv;
 };
 
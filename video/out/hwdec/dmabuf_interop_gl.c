@@ -52,9 +52,22 @@ typedef void *EGLImageKHR;
 #define EGL_DMA_BUF_PLANE3_MODIFIER_LO_EXT 0x3449
 #define EGL_DMA_BUF_PLANE3_MODIFIER_HI_EXT 0x344A
 
-struct vaapi_gl_mapper_priv {
+// An imported surface. Each has its own textures, so switching between cached
+// surfaces needs no GL calls.
+struct surface {
+    struct dmabuf_interop_key key;
     GLuint gl_textures[4];
     EGLImageKHR images[4];
+    struct ra_tex *tex[4];
+    uint64_t last_use;
+};
+
+struct vaapi_gl_mapper_priv {
+    struct ra_imgfmt_desc desc;
+    // Used for surfaces which are not cached.
+    struct surface scratch;
+    struct surface cache[DMABUF_INTEROP_CACHE_SIZE];
+    uint64_t use_counter;
 
     EGLImageKHR (EGLAPIENTRY *CreateImageKHR)(EGLDisplay, EGLContext,
                                               EGLenum, EGLClientBuffer,
@@ -63,30 +76,15 @@ struct vaapi_gl_mapper_priv {
     void (EGLAPIENTRY *EGLImageTargetTexture2DOES)(GLenum, GLeglImageOES);
 };
 
-static bool vaapi_gl_mapper_init(struct ra_hwdec_mapper *mapper,
-                                 const struct ra_imgfmt_desc *desc)
+static bool create_textures(struct ra_hwdec_mapper *mapper, struct surface *s)
 {
     struct dmabuf_interop_priv *p_mapper = mapper->priv;
-    struct vaapi_gl_mapper_priv *p = talloc_ptrtype(NULL, p);
-    p_mapper->interop_mapper_priv = p;
-
-    *p = (struct vaapi_gl_mapper_priv) {
-        // EGL_KHR_image_base
-        .CreateImageKHR = (void *)eglGetProcAddress("eglCreateImageKHR"),
-        .DestroyImageKHR = (void *)eglGetProcAddress("eglDestroyImageKHR"),
-        // GL_OES_EGL_image
-        .EGLImageTargetTexture2DOES =
-            (void *)eglGetProcAddress("glEGLImageTargetTexture2DOES"),
-    };
-
-    if (!p->CreateImageKHR || !p->DestroyImageKHR ||
-        !p->EGLImageTargetTexture2DOES)
-        return false;
+    struct vaapi_gl_mapper_priv *p = p_mapper->interop_mapper_priv;
 
     GL *gl = ra_gl_get(mapper->ra);
-    gl->GenTextures(4, p->gl_textures);
-    for (int n = 0; n < desc->num_planes; n++) {
-        gl->BindTexture(GL_TEXTURE_2D, p->gl_textures[n]);
+    gl->GenTextures(4, s->gl_textures);
+    for (int n = 0; n < p->desc.num_planes; n++) {
+        gl->BindTexture(GL_TEXTURE_2D, s->gl_textures[n]);
         gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
         gl->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -98,7 +96,7 @@ static bool vaapi_gl_mapper_init(struct ra_hwdec_mapper *mapper,
             .w = mp_image_plane_w(&p_mapper->layout, n),
             .h = mp_image_plane_h(&p_mapper->layout, n),
             .d = 1,
-            .format = desc->planes[n],
+            .format = p->desc.planes[n],
             .render_src = true,
             .src_linear = true,
         };
@@ -106,32 +104,142 @@ static bool vaapi_gl_mapper_init(struct ra_hwdec_mapper *mapper,
         if (params.format->ctype != RA_CTYPE_UNORM)
             return false;
 
-        p_mapper->tex[n] = ra_create_wrapped_tex(mapper->ra, &params,
-                                                 p->gl_textures[n]);
-        if (!p_mapper->tex[n])
+        s->tex[n] = ra_create_wrapped_tex(mapper->ra, &params,
+                                          s->gl_textures[n]);
+        if (!s->tex[n])
             return false;
     }
 
     return true;
 }
 
+static void destroy_images(struct vaapi_gl_mapper_priv *p, struct surface *s)
+{
+    for (int n = 0; n < 4; n++) {
+        if (s->images[n])
+            p->DestroyImageKHR(eglGetCurrentDisplay(), s->images[n]);
+        s->images[n] = 0;
+    }
+}
+
+static void destroy_surface(const struct ra_hwdec_mapper *mapper,
+                            struct surface *s)
+{
+    struct dmabuf_interop_priv *p_mapper = mapper->priv;
+    struct vaapi_gl_mapper_priv *p = p_mapper->interop_mapper_priv;
+
+    destroy_images(p, s);
+    GL *gl = ra_gl_get(mapper->ra);
+    gl->DeleteTextures(4, s->gl_textures);
+    for (int n = 0; n < 4; n++) {
+        s->gl_textures[n] = 0;
+        ra_tex_free(mapper->ra, &s->tex[n]);
+    }
+    s->key = (struct dmabuf_interop_key){0};
+}
+
+static bool vaapi_gl_mapper_init(struct ra_hwdec_mapper *mapper,
+                                 const struct ra_imgfmt_desc *desc)
+{
+    struct dmabuf_interop_priv *p_mapper = mapper->priv;
+    struct vaapi_gl_mapper_priv *p = talloc_ptrtype(NULL, p);
+    p_mapper->interop_mapper_priv = p;
+
+    *p = (struct vaapi_gl_mapper_priv) {
+        .desc = *desc,
+        // EGL_KHR_image_base
+        .CreateImageKHR = (void *)eglGetProcAddress("eglCreateImageKHR"),
+        .DestroyImageKHR = (void *)eglGetProcAddress("eglDestroyImageKHR"),
+        // GL_OES_EGL_image
+        .EGLImageTargetTexture2DOES =
+            (void *)eglGetProcAddress("glEGLImageTargetTexture2DOES"),
+    };
+
+    if (!p->CreateImageKHR || !p->DestroyImageKHR ||
+        !p->EGLImageTargetTexture2DOES)
+        return false;
+
+    return create_textures(mapper, &p->scratch);
+}
+
 static void vaapi_gl_mapper_uninit(const struct ra_hwdec_mapper *mapper)
 {
     struct dmabuf_interop_priv *p_mapper = mapper->priv;
     struct vaapi_gl_mapper_priv *p = p_mapper->interop_mapper_priv;
 
     if (p) {
-        GL *gl = ra_gl_get(mapper->ra);
-        gl->DeleteTextures(4, p->gl_textures);
-        for (int n = 0; n < 4; n++) {
-            p->gl_textures[n] = 0;
-            ra_tex_free(mapper->ra, &p_mapper->tex[n]);
-        }
+        destroy_surface(mapper, &p->scratch);
+        for (int n = 0; n < DMABUF_INTEROP_CACHE_SIZE; n++)
+            destroy_surface(mapper, &p->cache[n]);
         talloc_free(p);
         p_mapper->interop_mapper_priv = NULL;
     }
 }
 
+static bool key_equals(struct dmabuf_interop_key a, struct dmabuf_interop_key b)
+{
+    return a.pool == b.pool && a.id[0] == b.id[0] && a.id[1] == b.id[1];
+}
+
+static void set_mapped(struct ra_hwdec_mapper *mapper, struct surface *s)
+{
+    struct dmabuf_interop_priv *p_mapper = mapper->priv;
+    struct vaapi_gl_mapper_priv *p = p_mapper->interop_mapper_priv;
+
+    for (int n = 0; n < p->desc.num_planes; n++)
+        mapper->tex[n] = s->tex[n];
+    s->last_use = ++p->use_counter;
+}
+
+static bool vaapi_gl_map_cached(struct ra_hwdec_mapper *mapper)
+{
+    struct dmabuf_interop_priv *p_mapper = mapper->priv;
+    struct vaapi_gl_mapper_priv *p = p_mapper->interop_mapper_priv;
+
+    if (!p_mapper->key.pool)
+        return false;
+
+    for (int n = 0; n < DMABUF_INTEROP_CACHE_SIZE; n++) {
+        struct surface *s = &p->cache[n];
+        if (s->key.pool && key_equals(s->key, p_mapper->key)) {
+            set_mapped(mapper, s);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void vaapi_gl_flush(struct ra_hwdec_mapper *mapper)
+{
+    struct dmabuf_interop_priv *p_mapper = mapper->priv;
+    struct vaapi_gl_mapper_priv *p = p_mapper->interop_mapper_priv;
+
+    for (int n = 0; n < DMABUF_INTEROP_CACHE_SIZE; n++) {
+        destroy_images(p, &p->cache[n]);
+        p->cache[n].key = (struct dmabuf_interop_key){0};
+    }
+}
+
+// Return an unused cache entry, or evict the least recently used one.
+static struct surface *get_cache_entry(struct ra_hwdec_mapper *mapper)
+{
+    struct dmabuf_interop_priv *p_mapper = mapper->priv;
+    struct vaapi_gl_mapper_priv *p = p_mapper->interop_mapper_priv;
+
+    struct surface *s = &p->cache[0];
+    for (int n = 0; n < DMABUF_INTEROP_CACHE_SIZE; n++) {
+        if (!p->cache[n].key.pool) {
+            s = &p->cache[n];
+            break;
+        }
+        if (p->cache[n].last_use < s->last_use)
+            s = &p->cache[n];
+    }
+    destroy_images(p, s);
+    s->key = (struct dmabuf_interop_key){0};
+    return s;
+}
+
 #define ADD_ATTRIB(name, value)                         \
     do {                                                \
     assert(num_attribs + 3 < MP_ARRAY_SIZE(attribs));   \
@@ -154,9 +262,9 @@ static void vaapi_gl_mapper_uninit(const struct ra_hwdec_mapper *mapper)
             }                               \
         } while (0)
 
-static bool vaapi_gl_map(struct ra_hwdec_mapper *mapper,
-                         struct dmabuf_interop *dmabuf_interop,
-                         bool probing)
+static bool import_surface(struct ra_hwdec_mapper *mapper,
+                           struct dmabuf_interop *dmabuf_interop,
+                           bool probing, struct surface *s)
 {
     struct dmabuf_interop_priv *p_mapper = mapper->priv;
     struct vaapi_gl_mapper_priv *p = p_mapper->interop_mapper_priv;
@@ -197,22 +305,20 @@ static bool vaapi_gl_map(struct ra_hwdec_mapper *mapper,
             int num_attribs = 0;
 
             ADD_ATTRIB(EGL_LINUX_DRM_FOURCC_EXT, format[j]);
-            ADD_ATTRIB(EGL_WIDTH,  p_mapper->tex[n]->params.w);
-            ADD_ATTRIB(EGL_HEIGHT, p_mapper->tex[n]->params.h);
+            ADD_ATTRIB(EGL_WIDTH,  s->tex[n]->params.w);
+            ADD_ATTRIB(EGL_HEIGHT, s->tex[n]->params.h);
             ADD_PLANE_ATTRIBS(0);
 
-            p->images[n] = p->CreateImageKHR(eglGetCurrentDisplay(),
+            s->images[n] = p->CreateImageKHR(eglGetCurrentDisplay(),
                 EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, NULL, attribs);
-            if (!p->images[n]) {
+            if (!s->images[n]) {
                 mp_msg(mapper->log, probing ? MSGL_DEBUG : MSGL_ERR,
                     "Failed to import surface in EGL: %u\n", eglGetError());
                 return false;
             }
 
-            gl->BindTexture(GL_TEXTURE_2D, p->gl_textures[n]);
-            p->EGLImageTargetTexture2DOES(GL_TEXTURE_2D, p->images[n]);
-
-            mapper->tex[n] = p_mapper->tex[n];
+            gl->BindTexture(GL_TEXTURE_2D, s->gl_textures[n]);
+            p->EGLImageTargetTexture2DOES(GL_TEXTURE_2D, s->images[n]);
         }
     }
 
@@ -220,18 +326,39 @@ static bool vaapi_gl_map(struct ra_hwdec_mapper *mapper,
     return true;
 }
 
-static void vaapi_gl_unmap(struct ra_hwdec_mapper *mapper)
+static bool vaapi_gl_map(struct ra_hwdec_mapper *mapper,
+                         struct dmabuf_interop *dmabuf_interop,
+                         bool probing)
 {
     struct dmabuf_interop_priv *p_mapper = mapper->priv;
     struct vaapi_gl_mapper_priv *p = p_mapper->interop_mapper_priv;
 
-    if (p) {
-        for (int n = 0; n < 4; n++) {
-            if (p->images[n])
-                p->DestroyImageKHR(eglGetCurrentDisplay(), p->images[n]);
-            p->images[n] = 0;
-        }
+    struct surface *s = &p->scratch;
+    if (p_mapper->key.pool) {
+        s = get_cache_entry(mapper);
+        if (!s->tex[0] && !create_textures(mapper, s))
+            return false;
     }
+
+    if (!import_surface(mapper, dmabuf_interop, probing, s)) {
+        destroy_images(p, s);
+        return false;
+    }
+
+    if (s != &p->scratch)
+        s->key = p_mapper->key;
+    set_mapped(mapper, s);
+    return true;
+}
+
+static void vaapi_gl_unmap(struct ra_hwdec_mapper *mapper)
+{
+    struct dmabuf_interop_priv *p_mapper = mapper->priv;
+    struct vaapi_gl_mapper_priv *p = p_mapper->interop_mapper_priv;
+
+    // Cached surfaces stay imported until they are evicted or flushed.
+    if (p)
+        destroy_images(p, &p->scratch);
 }
 
 bool dmabuf_interop_gl_init(const struct ra_hwdec *hw,
@@ -265,6 +392,8 @@ bool dmabuf_interop_gl_init(const struct ra_hwdec *hw,
     dmabuf_interop->interop_uninit = vaapi_gl_mapper_uninit;
     dmabuf_interop->interop_map = vaapi_gl_map;
     dmabuf_interop->interop_unmap = vaapi_gl_unmap;
+    dmabuf_interop->interop_map_cached = vaapi_gl_map_cached;
+    dmabuf_interop->interop_flush = vaapi_gl_flush;
 
     return true;
 }
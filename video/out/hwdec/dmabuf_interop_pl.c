@@ -23,9 +23,112 @@
 #include "video/out/placebo/ra_pl.h"
 #include "video/out/placebo/utils.h"
 
-static bool vaapi_pl_map(struct ra_hwdec_mapper *mapper,
-                         struct dmabuf_interop *dmabuf_interop,
-                         bool probing)
+// An imported surface.
+struct surface {
+    struct dmabuf_interop_key key;
+    struct ra_tex *tex[4];
+    uint64_t last_use;
+};
+
+struct vaapi_pl_mapper_priv {
+    struct surface cache[DMABUF_INTEROP_CACHE_SIZE];
+    uint64_t use_counter;
+    // mapper->tex is owned by a cache entry.
+    bool mapped_cached;
+};
+
+static bool vaapi_pl_mapper_init(struct ra_hwdec_mapper *mapper,
+                                 const struct ra_imgfmt_desc *desc)
+{
+    struct dmabuf_interop_priv *p = mapper->priv;
+    p->interop_mapper_priv = talloc_zero(NULL, struct vaapi_pl_mapper_priv);
+    return true;
+}
+
+static void free_surface(const struct ra_hwdec_mapper *mapper, struct surface *s)
+{
+    for (int n = 0; n < 4; n++)
+        ra_tex_free(mapper->ra, &s->tex[n]);
+    s->key = (struct dmabuf_interop_key){0};
+}
+
+static void vaapi_pl_mapper_uninit(const struct ra_hwdec_mapper *mapper)
+{
+    struct dmabuf_interop_priv *p = mapper->priv;
+    struct vaapi_pl_mapper_priv *pl = p->interop_mapper_priv;
+
+    if (pl) {
+        for (int n = 0; n < DMABUF_INTEROP_CACHE_SIZE; n++)
+            free_surface(mapper, &pl->cache[n]);
+        talloc_free(pl);
+        p->interop_mapper_priv = NULL;
+    }
+}
+
+static bool key_equals(struct dmabuf_interop_key a, struct dmabuf_interop_key b)
+{
+    return a.pool == b.pool && a.id[0] == b.id[0] && a.id[1] == b.id[1];
+}
+
+static void set_mapped(struct ra_hwdec_mapper *mapper, struct surface *s)
+{
+    struct dmabuf_interop_priv *p = mapper->priv;
+    struct vaapi_pl_mapper_priv *pl = p->interop_mapper_priv;
+
+    for (int n = 0; n < 4; n++)
+        mapper->tex[n] = s->tex[n];
+    s->last_use = ++pl->use_counter;
+    pl->mapped_cached = true;
+}
+
+static bool vaapi_pl_map_cached(struct ra_hwdec_mapper *mapper)
+{
+    struct dmabuf_interop_priv *p = mapper->priv;
+    struct vaapi_pl_mapper_priv *pl = p->interop_mapper_priv;
+
+    if (!p->key.pool)
+        return false;
+
+    for (int n = 0; n < DMABUF_INTEROP_CACHE_SIZE; n++) {
+        struct surface *s = &pl->cache[n];
+        if (s->key.pool && key_equals(s->key, p->key)) {
+            set_mapped(mapper, s);
+            return true;
+        }
+    }
+    return false;
+}
+
+static void vaapi_pl_flush(struct ra_hwdec_mapper *mapper)
+{
+    struct dmabuf_interop_priv *p = mapper->priv;
+    struct vaapi_pl_mapper_priv *pl = p->interop_mapper_priv;
+
+    for (int n = 0; n < DMABUF_INTEROP_CACHE_SIZE; n++)
+        free_surface(mapper, &pl->cache[n]);
+}
+
+// Return an unused cache entry, or evict the least recently used one.
+static struct surface *get_cache_entry(struct ra_hwdec_mapper *mapper)
+{
+    struct dmabuf_interop_priv *p = mapper->priv;
+    struct vaapi_pl_mapper_priv *pl = p->interop_mapper_priv;
+
+    struct surface *s = &pl->cache[0];
+    for (int n = 0; n < DMABUF_INTEROP_CACHE_SIZE; n++) {
+        if (!pl->cache[n].key.pool) {
+            s = &pl->cache[n];
+            break;
+        }
+        if (pl->cache[n].last_use < s->last_use)
+            s = &pl->cache[n];
+    }
+    free_surface(mapper, s);
+    return s;
+}
+
+static bool import_surface(struct ra_hwdec_mapper *mapper, bool probing,
+                           struct ra_tex *tex[4])
 {
     struct dmabuf_interop_priv *p = mapper->priv;
     pl_gpu gpu = ra_pl_get(mapper->ra);
@@ -95,7 +198,7 @@ static bool vaapi_pl_map(struct ra_hwdec_mapper *mapper,
             talloc_free(ratex);
             return false;
         }
-        mapper->tex[n] = ratex;
+        tex[n] = ratex;
 
         MP_TRACE(mapper, "Object %d with fd %d imported as %p\n",
                 id, fd, ratex);
@@ -109,8 +212,38 @@ static bool vaapi_pl_map(struct ra_hwdec_mapper *mapper,
     return true;
 }
 
+static bool vaapi_pl_map(struct ra_hwdec_mapper *mapper,
+                         struct dmabuf_interop *dmabuf_interop,
+                         bool probing)
+{
+    struct dmabuf_interop_priv *p = mapper->priv;
+
+    if (!p->key.pool)
+        return import_surface(mapper, probing, mapper->tex);
+
+    struct surface *s = get_cache_entry(mapper);
+    if (!import_surface(mapper, probing, s->tex)) {
+        free_surface(mapper, s);
+        return false;
+    }
+    s->key = p->key;
+    set_mapped(mapper, s);
+    return true;
+}
+
 static void vaapi_pl_unmap(struct ra_hwdec_mapper *mapper)
 {
+    struct dmabuf_interop_priv *p = mapper->priv;
+    struct vaapi_pl_mapper_priv *pl = p->interop_mapper_priv;
+
+    // Cached surfaces stay imported until they are evicted or flushed.
+    if (pl && pl->mapped_cached) {
+        for (int n = 0; n < 4; n++)
+            mapper->tex[n] = NULL;
+        pl->mapped_cached = false;
+        return;
+    }
+
     for (int n = 0; n < 4; n++)
         ra_tex_free(mapper->ra, &mapper->tex[n]);
 }
@@ -132,8 +265,12 @@ bool dmabuf_interop_pl_init(const struct ra_hwdec *hw,
 
     MP_VERBOSE(hw, "using libplacebo dmabuf interop\n");
 
+    dmabuf_interop->interop_init = vaapi_pl_mapper_init;
+    dmabuf_interop->interop_uninit = vaapi_pl_mapper_uninit;
     dmabuf_interop->interop_map = vaapi_pl_map;
     dmabuf_interop->interop_unmap = vaapi_pl_unmap;
+    dmabuf_interop->interop_map_cached = vaapi_pl_map_cached;
+    dmabuf_interop->interop_flush = vaapi_pl_flush;
 
     return true;
 }
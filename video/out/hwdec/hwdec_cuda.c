@@ -31,6 +31,9 @@
 #include <libavutil/hwcontext.h>
 #include <libavutil/hwcontext_cuda.h>
 
+#include "common/stats.h"
+#include "osdep/timer.h"
+
 int check_cu(const struct ra_hwdec *hw, CUresult err, const char *func)
 {
     const char *err_name;
@@ -176,10 +179,19 @@ static int mapper_init(struct ra_hwdec_mapper *mapper)
         return -1;
     }
 
+    p->stats = stats_ctx_create(mapper, mapper->owner->global, "hwdec/cuda");
+
     ret = CHECK_CU(cu->cuCtxPushCurrent(p->display_ctx));
     if (ret < 0)
         return ret;
 
+    // Not CU_STREAM_NON_BLOCKING: the decoder writes frames on the legacy
+    // default stream, and the copy must be ordered against it, both before
+    // (frame complete) and after (surface reused once we drop the reference).
+    ret = CHECK_CU(cu->cuStreamCreate(&p->stream, CU_STREAM_DEFAULT));
+    if (ret < 0)
+        goto error;
+
     for (int n = 0; n < desc.num_planes; n++) {
         if (!p_owner->ext_init(mapper, desc.planes[n], n))
             goto error;
@@ -202,6 +214,12 @@ static void mapper_uninit(struct ra_hwdec_mapper *mapper)
 
     // Don't bail if any CUDA calls fail. This is all best effort.
     CHECK_CU(cu->cuCtxPushCurrent(p->display_ctx));
+    if (p->stream) {
+        // Also waits for pending copy_done() callbacks.
+        CHECK_CU(cu->cuStreamSynchronize(p->stream));
+        CHECK_CU(cu->cuStreamDestroy(p->stream));
+        p->stream = NULL;
+    }
     for (int n = 0; n < 4; n++) {
         p_owner->ext_uninit(mapper, n);
         ra_tex_free(mapper->ra, &mapper->tex[n]);
@@ -213,6 +231,16 @@ static void mapper_unmap(struct ra_hwdec_mapper *mapper)
 {
 }
 
+// Runs on a CUDA driver thread once the copies of a frame have completed.
+static void CUDAAPI copy_done(CUstream stream, CUresult status, void *ctx)
+{
+    struct cuda_mapper_priv *p = ctx;
+    if (status == CUDA_SUCCESS) {
+        stats_value(p->stats, "copy-latency",
+                    (mp_time_us() - atomic_load(&p->copy_start)) / 1e6);
+    }
+}
+
 static int mapper_map(struct ra_hwdec_mapper *mapper)
 {
     struct cuda_mapper_priv *p = mapper->priv;
@@ -225,6 +253,8 @@ static int mapper_map(struct ra_hwdec_mapper *mapper)
     if (ret < 0)
         return ret;
 
+    atomic_store(&p->copy_start, mp_time_us());
+
     for (int n = 0; n < p->layout.num_planes; n++) {
         if (p_owner->ext_wait) {
             if (!p_owner->ext_wait(mapper, n))
@@ -243,7 +273,7 @@ static int mapper_map(struct ra_hwdec_mapper *mapper)
             .Height        = mp_image_plane_h(&p->layout, n),
         };
 
-        ret = CHECK_CU(cu->cuMemcpy2DAsync(&cpy, 0));
+        ret = CHECK_CU(cu->cuMemcpy2DAsync(&cpy, p->stream));
         if (ret < 0)
             goto error;
 
@@ -252,8 +282,10 @@ static int mapper_map(struct ra_hwdec_mapper *mapper)
                 goto error;
         }
     }
+    CHECK_CU(cu->cuStreamAddCallback(p->stream, copy_done, p, 0));
+
     if (p_owner->do_full_sync)
-        CHECK_CU(cu->cuStreamSynchronize(0));
+        CHECK_CU(cu->cuStreamSynchronize(p->stream));
 
     // fall through
  error:
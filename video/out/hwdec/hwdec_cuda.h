@@ -21,6 +21,7 @@
 
 #include <ffnvcodec/dynlink_loader.h>
 
+#include "osdep/atomic.h"
 #include "video/out/gpu/hwdec.h"
 
 struct cuda_hw_priv {
@@ -39,7 +40,8 @@ struct cuda_hw_priv {
                      const struct ra_format *format, int n);
     void (*ext_uninit)(const struct ra_hwdec_mapper *mapper, int n);
 
-    // These are only necessary if the gpu api requires synchronisation
+    // These are only necessary if the gpu api requires synchronisation.
+    // They must be ordered on cuda_mapper_priv.stream.
     bool (*ext_wait)(const struct ra_hwdec_mapper *mapper, int n);
     bool (*ext_signal)(const struct ra_hwdec_mapper *mapper, int n);
 };
@@ -50,6 +52,13 @@ struct cuda_mapper_priv {
 
     CUcontext display_ctx;
 
+    // All copies and interop synchronization are issued on this stream.
+    CUstream stream;
+
+    struct stats_ctx *stats;
+    // Time the copies of the last frame were issued, for the latency stat.
+    mp_atomic_int64 copy_start;
+
     void *ext[4];
 };
 
@@ -244,7 +244,7 @@ static bool cuda_ext_vk_wait(const struct ra_hwdec_mapper *mapper, int n)
 
     CUDA_EXTERNAL_SEMAPHORE_WAIT_PARAMS wp = { 0, };
     ret = CHECK_CU(cu->cuWaitExternalSemaphoresAsync(&evk->ws,
-                                                     &wp, 1, 0));
+                                                     &wp, 1, p->stream));
     return ret == 0;
 }
 
@@ -258,7 +258,7 @@ static bool cuda_ext_vk_signal(const struct ra_hwdec_mapper *mapper, int n)
 
     CUDA_EXTERNAL_SEMAPHORE_SIGNAL_PARAMS sp = { 0, };
     ret = CHECK_CU(cu->cuSignalExternalSemaphoresAsync(&evk->ss,
-                                                       &sp, 1, 0));
+                                                       &sp, 1, p->stream));
     return ret == 0;
 }
 
@@ -20,6 +20,7 @@
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include <libavutil/hwcontext.h>
 #include <libavutil/hwcontext_drm.h>
@@ -187,18 +188,45 @@ static int mapper_init(struct ra_hwdec_mapper *mapper)
     return 0;
 }
 
+// dmabufs have unique inode numbers, and the cached import keeps the buffer
+// alive, so the inode can't be reused for a different buffer while cached.
+// The offset distinguishes frames that are sub-allocated from one buffer.
+static void update_cache_key(struct ra_hwdec_mapper *mapper,
+                             const AVDRMFrameDescriptor *desc)
+{
+    struct priv_owner *p_owner = mapper->owner->priv;
+    struct dmabuf_interop_priv *p = mapper->priv;
+
+    p->key = (struct dmabuf_interop_key){0};
+    if (!p_owner->dmabuf_interop.interop_map_cached || desc->nb_objects < 1 ||
+        desc->nb_layers < 1 || desc->layers[0].nb_planes < 1)
+        return;
+
+    struct stat st;
+    if (fstat(desc->objects[0].fd, &st))
+        return;
+
+    p->key.pool = mapper->owner;
+    p->key.id[0] = st.st_ino;
+    p->key.id[1] = desc->layers[0].planes[0].offset;
+}
+
 static int mapper_map(struct ra_hwdec_mapper *mapper)
 {
     struct priv_owner *p_owner = mapper->owner->priv;
     struct dmabuf_interop_priv *p = mapper->priv;
 
+    const AVDRMFrameDescriptor *desc = (AVDRMFrameDescriptor *)mapper->src->planes[0];
+    update_cache_key(mapper, desc);
+    if (p->key.pool && p_owner->dmabuf_interop.interop_map_cached(mapper))
+        return 0;
+
     /*
      * Although we use the same AVDRMFrameDescriptor to hold the dmabuf
      * properties, we additionally need to dup the fds to ensure the
      * frame doesn't disappear out from under us. And then for clarity,
      * we copy all the individual fields.
      */
-    const AVDRMFrameDescriptor *desc = (AVDRMFrameDescriptor *)mapper->src->planes[0];
     p->desc.nb_layers = desc->nb_layers;
     p->desc.nb_objects = desc->nb_objects;
     for (int i = 0; i < desc->nb_layers; i++) {
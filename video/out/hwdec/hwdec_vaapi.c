@@ -191,9 +191,11 @@ static void mapper_unmap(struct ra_hwdec_mapper *mapper)
 static void mapper_uninit(struct ra_hwdec_mapper *mapper)
 {
     struct priv_owner *p_owner = mapper->owner->priv;
+    struct dmabuf_interop_priv *p = mapper->priv;
     if (p_owner->dmabuf_interop.interop_uninit) {
         p_owner->dmabuf_interop.interop_uninit(mapper);
     }
+    av_buffer_unref(&p->pool_ref);
 }
 
 static bool check_fmt(struct ra_hwdec_mapper *mapper, int fmt)
@@ -237,6 +239,32 @@ static int mapper_init(struct ra_hwdec_mapper *mapper)
     return 0;
 }
 
+// Surfaces are identified by their ID within the hw frames context. A reference
+// to the context is kept, so it can't be recreated at the same address while
+// surfaces of the old one are still cached.
+static void update_cache_key(struct ra_hwdec_mapper *mapper)
+{
+    struct priv_owner *p_owner = mapper->owner->priv;
+    struct dmabuf_interop_priv *p = mapper->priv;
+    AVBufferRef *frames = mapper->src->hwctx;
+
+    p->key = (struct dmabuf_interop_key){0};
+    if (!p_owner->dmabuf_interop.interop_map_cached || !frames ||
+        p_owner->probing_formats)
+        return;
+
+    if (!p->pool_ref || p->pool_ref->data != frames->data) {
+        p_owner->dmabuf_interop.interop_flush(mapper);
+        av_buffer_unref(&p->pool_ref);
+        p->pool_ref = av_buffer_ref(frames);
+        if (!p->pool_ref)
+            return;
+    }
+
+    p->key.pool = p->pool_ref->data;
+    p->key.id[0] = va_surface_id(mapper->src);
+}
+
 static int mapper_map(struct ra_hwdec_mapper *mapper)
 {
     struct priv_owner *p_owner = mapper->owner->priv;
@@ -245,6 +273,13 @@ static int mapper_map(struct ra_hwdec_mapper *mapper)
     VADisplay *display = p_owner->display;
     VADRMPRIMESurfaceDescriptor desc;
 
+    update_cache_key(mapper);
+    if (p->key.pool && p_owner->dmabuf_interop.interop_map_cached(mapper)) {
+        status = vaSyncSurface(display, va_surface_id(mapper->src));
+        CHECK_VA_STATUS(mapper, "vaSyncSurface()");
+        goto done;
+    }
+
     status = vaExportSurfaceHandle(display, va_surface_id(mapper->src),
                                    VA_SURFACE_ATTRIB_MEM_TYPE_DRM_PRIME_2,
                                    VA_EXPORT_SURFACE_READ_ONLY |
@@ -299,7 +334,15 @@ static int mapper_map(struct ra_hwdec_mapper *mapper)
                                              p_owner->probing_formats))
         goto err;
 
-    if (desc.fourcc == VA_FOURCC_YV12)
+    p->swap_uv = desc.fourcc == VA_FOURCC_YV12;
+
+    // The import doesn't need the exported fds anymore.
+    for (int n = 0; n < p->desc.nb_objects; n++)
+        close(p->desc.objects[n].fd);
+    p->surface_acquired = false;
+
+done:
+    if (p->swap_uv)
         MPSWAP(struct ra_tex*, mapper->tex[1], mapper->tex[2]);
 
     return 0;
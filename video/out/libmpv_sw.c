@@ -14,6 +14,17 @@ struct priv {
     struct mp_rect src_rc, dst_rc;
     struct mp_osd_res osd_rc;
     bool anything_changed;
+    bool passthrough;           // video can be copied instead of converted
+
+    // What the previous render() call left in the target surface (only used
+    // with MPV_RENDER_PARAM_SW_DAMAGE).
+    bool target_valid;
+    void *last_ptr;
+    size_t last_stride;
+    bool last_had_video;
+    uint64_t last_frame_id;
+    void *last_video_data;
+    struct mp_rect last_osd_rc;
 };
 
 static int init(struct render_backend *ctx, mpv_render_param *params)
@@ -146,9 +157,18 @@ static int render(struct render_backend *ctx, mpv_render_param *params,
 
             if (mp_sws_reinit(p->sws) < 0)
                 return MPV_ERROR_UNSUPPORTED; // probably
+
+            // Unscaled, same format and color encoding: a plain copy does
+            // the same as the scaler.
+            p->passthrough = p->sws->src.imgfmt == p->sws->dst.imgfmt &&
+                p->sws->src.w == p->sws->dst.w &&
+                p->sws->src.h == p->sws->dst.h &&
+                p->sws->src.color.space == p->sws->dst.color.space &&
+                p->sws->src.color.levels == p->sws->dst.color.levels;
         }
 
         p->anything_changed = false;
+        p->target_valid = false;
     }
 
     struct mp_image wrap_img = {0};
@@ -161,31 +181,79 @@ static int render(struct render_backend *ctx, mpv_render_param *params,
     wrap_img.planes[0] = ptr;
     wrap_img.stride[0] = *stride;
 
+    int *damage = get_mpv_render_param(params, MPV_RENDER_PARAM_SW_DAMAGE, NULL);
+
+    // With damage reporting, the user guarantees the surface still contains
+    // what we rendered last time, so parts that didn't change can be skipped.
+    bool same_target = damage && p->target_valid && p->last_ptr == ptr &&
+                       p->last_stride == *stride;
     struct mp_image *img = frame->current;
+    bool same_video = same_target && p->last_had_video == !!img &&
+        (!img || (p->last_frame_id == frame->frame_id &&
+                  p->last_video_data == img->planes[0]));
+    bool had_osd = mp_rect_w(p->last_osd_rc) > 0 && mp_rect_h(p->last_osd_rc) > 0;
+
+    struct mp_rect full_rc = {0, 0, wrap_img.w, wrap_img.h};
+    struct mp_rect rc = {0};
+    p->target_valid = false;
+
     if (img) {
         assert(p->src_params.imgfmt);
 
-        mp_image_clear_rc_inv(&wrap_img, p->dst_rc);
-
-        struct mp_image src = *img;
-        struct mp_rect src_rc = p->src_rc;
-        src_rc.x0 = MP_ALIGN_DOWN(src_rc.x0, src.fmt.align_x);
-        src_rc.y0 = MP_ALIGN_DOWN(src_rc.y0, src.fmt.align_y);
-        mp_image_crop_rc(&src, src_rc);
+        struct mp_rect osd_rc = p->last_osd_rc;
+        bool osd_in_video = !had_osd ||
+            (mp_rect_intersection(&osd_rc, &p->dst_rc) &&
+             mp_rect_equals(&osd_rc, &p->last_osd_rc));
 
-        struct mp_image dst = wrap_img;
-        mp_image_crop_rc(&dst, p->dst_rc);
+        if (!same_video || !osd_in_video) {
+            mp_image_clear_rc_inv(&wrap_img, p->dst_rc);
+            rc = full_rc;
+        }
 
-        if (mp_sws_scale(p->sws, &dst, &src) < 0) {
-            mp_image_clear(&wrap_img, 0, 0, wrap_img.w, wrap_img.h);
-            return MPV_ERROR_GENERIC;
+        if (!same_video || had_osd) {
+            struct mp_image src = *img;
+            struct mp_rect src_rc = p->src_rc;
+            src_rc.x0 = MP_ALIGN_DOWN(src_rc.x0, src.fmt.align_x);
+            src_rc.y0 = MP_ALIGN_DOWN(src_rc.y0, src.fmt.align_y);
+            mp_image_crop_rc(&src, src_rc);
+
+            struct mp_image dst = wrap_img;
+            mp_image_crop_rc(&dst, p->dst_rc);
+
+            if (p->passthrough && src.w == dst.w && src.h == dst.h) {
+                mp_image_copy(&dst, &src);
+            } else if (mp_sws_scale(p->sws, &dst, &src) < 0) {
+                mp_image_clear(&wrap_img, 0, 0, wrap_img.w, wrap_img.h);
+                return MPV_ERROR_GENERIC;
+            }
+            mp_rect_extend(&rc, &p->dst_rc);
         }
-    } else {
+    } else if (!same_video || had_osd) {
         mp_image_clear(&wrap_img, 0, 0, wrap_img.w, wrap_img.h);
+        rc = full_rc;
+    }
+
+    struct mp_rect osd_rc = {0};
+    if (p->osd) {
+        osd_draw_on_image_rc(p->osd, p->osd_rc, img ? img->pts : 0, 0,
+                             &wrap_img, &osd_rc);
+        mp_rect_extend(&rc, &osd_rc);
+    }
+
+    if (damage) {
+        damage[0] = rc.x0;
+        damage[1] = rc.y0;
+        damage[2] = rc.x1;
+        damage[3] = rc.y1;
     }
 
-    if (p->osd)
-        osd_draw_on_image(p->osd, p->osd_rc, img ? img->pts : 0, 0, &wrap_img);
+    p->target_valid = true;
+    p->last_ptr = ptr;
+    p->last_stride = *stride;
+    p->last_had_video = !!img;
+    p->last_frame_id = img ? frame->frame_id : 0;
+    p->last_video_data = img ? img->planes[0] : NULL;
+    p->last_osd_rc = osd_rc;
 
     return 0;
 }
@@ -669,7 +669,7 @@ static void drm_egl_swap_buffers(struct ra_swapchain *sw)
     enqueue_bo(ctx, new_bo);
     new_fence(ctx);
 
-    while (drain || p->gbm.num_bos > ctx->vo->opts->swapchain_depth ||
+    while (drain || p->gbm.num_bos > vo_get_swapchain_depth(ctx->vo) ||
            !gbm_surface_has_free_buffers(p->gbm.surface)) {
         if (p->waiting_for_flip) {
             wait_on_flip(ctx);
@@ -89,13 +89,26 @@ static int wrap_fbo(struct libmpv_gpu_context *ctx, mpv_render_param *params,
     return 0;
 }
 
-static void done_frame(struct libmpv_gpu_context *ctx, bool ds)
+static void done_frame(struct libmpv_gpu_context *ctx, mpv_render_param *params,
+                       bool ds)
 {
     struct priv *p = ctx->priv;
+    GL *gl = p->gl;
 
     struct ra_swapchain *sw = p->ra_ctx->swapchain;
     struct vo_frame dummy = {.display_synced = ds};
     ra_gl_ctx_submit_frame(sw, &dummy);
+
+    void **fence = get_mpv_render_param(params, MPV_RENDER_PARAM_OPENGL_FENCE,
+                                        NULL);
+    if (fence) {
+        *fence = NULL;
+        if (gl->FenceSync) {
+            *fence = gl->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            // The fence is not guaranteed to signal unless it was flushed.
+            gl->Flush();
+        }
+    }
 }
 
 static void destroy(struct libmpv_gpu_context *ctx)
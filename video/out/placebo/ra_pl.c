@@ -7,8 +7,13 @@
 struct ra_pl {
     pl_gpu gpu;
     struct ra_timer_pl *active_timer;
+    bool async_upload;
+    bool rendering; // rendering commands recorded since the last flush
 };
 
+// Uploads smaller than this are not worth an extra queue submission.
+#define ASYNC_UPLOAD_MIN_SIZE (1 << 20)
+
 static inline pl_gpu get_gpu(const struct ra *ra)
 {
     struct ra_pl *p = ra->priv;
@@ -112,6 +117,12 @@ struct ra *ra_create_pl(pl_gpu gpu, struct mp_log *log)
     return ra;
 }
 
+void ra_pl_set_async_upload(struct ra *ra, bool enable)
+{
+    struct ra_pl *p = ra->priv;
+    p->async_upload = enable;
+}
+
 static void destroy_ra_pl(struct ra *ra)
 {
     talloc_free(ra);
@@ -252,6 +263,20 @@ static bool tex_upload_pl(struct ra *ra, const struct ra_tex_upload_params *para
 #endif
     }
 
+    // libplacebo appends uploads to the currently open command buffer, which
+    // is on the graphics queue if anything was rendered since the last flush.
+    // Submit it first, so the upload can go to the transfer queue and overlap
+    // with rendering. libplacebo synchronizes the queues on the texture's
+    // next use.
+    struct ra_pl *p = ra->priv;
+    int lines = params->rc ? params->rc->y1 - params->rc->y0
+                           : params->tex->params.h;
+    size_t size = (size_t)params->stride * MPMAX(lines, 1);
+    if (p->async_upload && p->rendering && size >= ASYNC_UPLOAD_MIN_SIZE) {
+        pl_gpu_flush(gpu);
+        p->rendering = false;
+    }
+
     bool ok = pl_tex_upload(gpu, &pl_params);
     pl_buf_destroy(gpu, &staging);
     return ok;
@@ -343,6 +368,8 @@ static void clear_pl(struct ra *ra, struct ra_tex *dst, float color[4],
                      struct mp_rect *scissor)
 {
     // TODO: implement scissor clearing by bltting a 1x1 tex instead
+    struct ra_pl *p = ra->priv;
+    p->rendering = true;
     pl_tex_clear(get_gpu(ra), dst->priv, color);
 }
 
@@ -364,6 +391,8 @@ static void blit_pl(struct ra *ra, struct ra_tex *dst, struct ra_tex *src,
         pldst.y1 = MPMIN(MPMAX(dst_rc->y1, 0), dst->params.h);
     }
 
+    struct ra_pl *p = ra->priv;
+    p->rendering = true;
     pl_tex_blit(get_gpu(ra), &(struct pl_tex_blit_params) {
         .src = src->priv,
         .dst = dst->priv,
@@ -644,6 +673,8 @@ static void renderpass_run_pl(struct ra *ra,
             pl_params.compute_groups[i] = params->compute_groups[i];
     }
 
+    struct ra_pl *p = ra->priv;
+    p->rendering = true;
     pl_pass_run(get_gpu(ra), &pl_params);
 }
 
@@ -7,6 +7,10 @@ struct ra *ra_create_pl(pl_gpu gpu, struct mp_log *log);
 
 pl_gpu ra_pl_get(const struct ra *ra);
 
+// Submit pending rendering before large texture uploads, so that they can run
+// on an async transfer queue. Only useful if the pl_gpu has one.
+void ra_pl_set_async_upload(struct ra *ra, bool enable);
+
 static inline pl_fmt ra_pl_fmt_get(const struct ra_format *format)
 {
     return format->priv;
@@ -63,18 +63,28 @@ void present_sync_swap(struct mp_present *present)
     int64_t msc_passed = msc ? msc - present->last_msc: 0;
     present->last_msc = msc;
 
-    if (msc_passed && ust_passed)
+    if (present->refresh_duration > 0) {
+        present->vsync_duration = present->refresh_duration;
+    } else if (msc_passed && ust_passed) {
         present->vsync_duration = ust_passed / msc_passed;
+    }
 
     struct timespec ts;
     if (clock_gettime(CLOCK_MONOTONIC, &ts)) {
         return;
     }
 
-    uint64_t now_monotonic = ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
-    uint64_t ust_mp_time = mp_time_us() - (now_monotonic - ust);
+    int64_t now_monotonic = ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+
+    // ust is the time the last frame was presented, which is in the past. The
+    // frame that was just queued will be shown at a later vsync, at the
+    // earliest at the next one.
+    int64_t display_ust = ust;
+    int64_t vsync = present->vsync_duration;
+    if (vsync > 0 && now_monotonic >= ust)
+        display_ust += ((now_monotonic - ust) / vsync + 1) * vsync;
 
-    present->last_queue_display_time = ust_mp_time;
+    present->last_queue_display_time = mp_time_us() - (now_monotonic - display_ust);
 }
 
 void present_update_sync_values(struct mp_present *present, int64_t ust,
@@ -83,3 +93,8 @@ void present_update_sync_values(struct mp_present *present, int64_t ust,
     present->current_ust = ust;
     present->current_msc = msc;
 }
+
+void present_update_refresh(struct mp_present *present, int64_t refresh)
+{
+    present->refresh_duration = refresh;
+}
@@ -33,6 +33,8 @@ struct mp_present {
     int64_t vsync_duration;
     int64_t last_skipped_vsyncs;
     int64_t last_queue_display_time;
+    // Refresh interval reported by the backend (0 if unknown).
+    int64_t refresh_duration;
 };
 
 // Used during the get_vsync call to deliver the presentation statistics to the VO.
@@ -45,4 +47,8 @@ void present_sync_swap(struct mp_present *present);
 void present_update_sync_values(struct mp_present *present, int64_t ust,
                                 int64_t msc);
 
+// Called if the backend reports the exact refresh interval (in us, 0 if
+// unknown). This is preferred over the interval derived from ust/msc.
+void present_update_refresh(struct mp_present *present, int64_t refresh);
+
 #endif /* MP_PRESENT_SYNC_H */
@@ -171,6 +171,9 @@ struct vo_internal {
 
     bool rendering;                 // true if an image is being rendered
     struct vo_frame *frame_queued;  // should be drawn next
+    int64_t frame_queued_time;      // mp_time_us() when frame_queued was set
+    int64_t current_frame_time;     // same for current_frame, 0 once shown
+    double display_latency;         // smoothed queue-to-display time (us)
     int req_frames;                 // VO's requested value of num_frames
     uint64_t current_frame_id;
 
@@ -382,6 +385,28 @@ done:
     return vo;
 }
 
+// Whether init_best_video_out() can only create headless VOs (as with
+// --vo=null). Unknown driver names are not considered headless.
+bool vo_list_is_headless(struct mpv_global *global)
+{
+    struct mp_vo_opts *opts = mp_get_config_group(NULL, global, &vo_sub_opts);
+    struct m_obj_settings *vo_list = opts->video_driver_list;
+    bool headless = vo_list && vo_list[0].name;
+    for (int n = 0; headless && vo_list[n].name; n++) {
+        bool found = false;
+        for (int i = 0; video_out_drivers[i]; i++) {
+            const struct vo_driver *driver = video_out_drivers[i];
+            if (strcmp(driver->name, vo_list[n].name) == 0) {
+                found = driver->headless;
+                break;
+            }
+        }
+        headless = found; // also false for "" (autoprobe)
+    }
+    talloc_free(opts);
+    return headless;
+}
+
 static void terminate_vo(void *p)
 {
     struct vo *vo = p;
@@ -539,6 +564,27 @@ static void update_vsync_timing_after_swap(struct vo *vo,
     MP_STATS(vo, "value %f vsync-diff", in->vsync_samples[0] / 1e6);
 }
 
+// Always called locked. Measure how long it took from the frame being queued
+// until it was first displayed (according to presentation feedback).
+static void update_display_latency(struct vo *vo, struct vo_vsync_info *vsync)
+{
+    struct vo_internal *in = vo->in;
+
+    if (!in->current_frame_time || in->dropped_frame)
+        return;
+
+    double latency = MPMAX(vsync->last_queue_display_time -
+                           in->current_frame_time, 0);
+    in->current_frame_time = 0;
+
+    if (in->display_latency > 0) {
+        in->display_latency += (latency - in->display_latency) / 16;
+    } else {
+        in->display_latency = latency;
+    }
+    MP_STATS(vo, "value %f display-latency", latency / 1e6);
+}
+
 // to be called from VO thread only
 static void update_display_fps(struct vo *vo)
 {
@@ -844,10 +890,18 @@ void vo_queue_frame(struct vo *vo, struct vo_frame *frame)
     in->hasframe = true;
     frame->frame_id = ++(in->current_frame_id);
     in->frame_queued = frame;
+    in->frame_queued_time = mp_time_us();
+    if (vo->driver->queue_frame)
+        vo->driver->queue_frame(vo, frame);
     in->wakeup_pts = frame->display_synced
                    ? 0 : frame->pts + MPMAX(frame->duration, 0);
+    double pts = frame->pts;
     wakeup_locked(vo);
     pthread_mutex_unlock(&in->lock);
+
+    // Outside of the lock, as the VO may be rendering subtitles right now.
+    if (vo->osd)
+        osd_set_next_video_pts(vo->osd, pts);
 }
 
 // If a frame is currently being rendered (or queued), wait until it's done.
@@ -890,6 +944,7 @@ static bool render_frame(struct vo *vo)
     if (in->frame_queued) {
         talloc_free(in->current_frame);
         in->current_frame = in->frame_queued;
+        in->current_frame_time = in->frame_queued_time;
         in->frame_queued = NULL;
     } else if (in->paused || !in->current_frame || !in->hasframe ||
                (in->current_frame->display_synced && in->current_frame->num_vsyncs < 1) ||
@@ -993,6 +1048,7 @@ static bool render_frame(struct vo *vo)
         in->rendering = false;
 
         update_vsync_timing_after_swap(vo, &vsync);
+        update_display_latency(vo, &vsync);
     }
 
     if (vo->driver->caps & VO_CAP_NORETAIN) {
@@ -1079,6 +1135,7 @@ static void *vo_thread(void *ptr)
     bool vo_paused = false;
 
     mpthread_set_name("vo");
+    mpthread_set_class(vo->global, vo->log, "video");
 
     if (vo->driver->get_image) {
         in->dr_helper = dr_helper_create(in->dispatch, get_image_vo, vo);
@@ -1343,6 +1400,24 @@ int64_t vo_get_delayed_count(struct vo *vo)
     return res;
 }
 
+// Smoothed time in seconds between vo_queue_frame() and the frame becoming
+// visible, or 0 if unknown.
+double vo_get_display_latency(struct vo *vo)
+{
+    struct vo_internal *in = vo->in;
+    pthread_mutex_lock(&in->lock);
+    double res = in->display_latency / 1e6;
+    pthread_mutex_unlock(&in->lock);
+    return res;
+}
+
+// Number of frames the VO may render ahead, taking --latency-mode into
+// account. Backends should use this instead of opts->swapchain_depth.
+int vo_get_swapchain_depth(struct vo *vo)
+{
+    return vo->opts->latency_mode ? 1 : vo->opts->swapchain_depth;
+}
+
 double vo_get_display_fps(struct vo *vo)
 {
     struct vo_internal *in = vo->in;
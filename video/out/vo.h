@@ -166,6 +166,9 @@ struct mp_frame_perf {
 
 struct voctrl_performance_data {
     struct mp_frame_perf fresh, redraw;
+    // Current --gpu-auto-quality tier (only valid if auto_quality is set)
+    bool auto_quality;
+    int quality_tier;
 };
 
 struct voctrl_screenshot {
@@ -295,6 +298,9 @@ struct vo_driver {
     // Disable video timing, push frames as quickly as possible, never redraw.
     bool untimed;
 
+    // Nothing is displayed, and there is no user interaction.
+    bool headless;
+
     const char *name;
     const char *description;
 
@@ -385,6 +391,16 @@ struct vo_driver {
      */
     void (*draw_frame)(struct vo *vo, struct vo_frame *frame);
 
+    /*
+     * Optional. Called by vo_queue_frame() with each new frame (with
+     * frame_id set), before it is rendered with draw_frame(). It runs on the
+     * caller's thread with internal VO locks held, so it must return quickly,
+     * and must not call any vo_* functions. The callee must not modify frame,
+     * but can take new references to the images in it, e.g. to start
+     * uploading them on a separate thread.
+     */
+    void (*queue_frame)(struct vo *vo, struct vo_frame *frame);
+
     /*
      * Blit/Flip buffer to the screen. Must be called after each frame!
      */
@@ -483,6 +499,7 @@ struct vo {
 
 struct mpv_global;
 struct vo *init_best_video_out(struct mpv_global *global, struct vo_extra *ex);
+bool vo_list_is_headless(struct mpv_global *global);
 int vo_reconfig(struct vo *vo, struct mp_image_params *p);
 int vo_reconfig2(struct vo *vo, struct mp_image *img);
 
@@ -509,6 +526,8 @@ struct mp_image *vo_get_current_frame(struct vo *vo);
 void vo_set_queue_params(struct vo *vo, int64_t offset_us, int num_req_frames);
 int vo_get_num_req_frames(struct vo *vo);
 int64_t vo_get_vsync_interval(struct vo *vo);
+double vo_get_display_latency(struct vo *vo);
+int vo_get_swapchain_depth(struct vo *vo);
 double vo_get_estimated_vsync_interval(struct vo *vo);
 double vo_get_estimated_vsync_jitter(struct vo *vo);
 double vo_get_display_fps(struct vo *vo);
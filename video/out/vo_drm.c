@@ -24,14 +24,20 @@
 #include <unistd.h>
 
 #include <drm_fourcc.h>
+#include <libavutil/buffer.h>
+#include <libavutil/hwcontext.h>
+#include <libavutil/hwcontext_drm.h>
 #include <libswscale/swscale.h>
 
 #include "drm_common.h"
+#include "drm_prime.h"
 
 #include "common/msg.h"
 #include "osdep/timer.h"
+#include "sub/draw_bmp.h"
 #include "sub/osd.h"
 #include "video/fmt-conversion.h"
+#include "video/hwdec.h"
 #include "video/mp_image.h"
 #include "video/sws_utils.h"
 #include "vo.h"
@@ -54,11 +60,17 @@ struct framebuffer {
     uint32_t handle;
     uint8_t *map;
     uint32_t fb;
+    // If clean_id==priv.clean_id, this contains priv.clean plus OSD in osd_rc.
+    uint64_t clean_id;
+    struct mp_rect osd_rc;
 };
 
 struct kms_frame {
-    struct framebuffer *fb;
+    struct framebuffer *fb;     // for prime frames: the OSD buffer
     struct drm_vsync_tuple vsync;
+    struct mp_image *dr_image;  // reference to the scanned out DR/prime frame
+    bool prime;                 // commit with atomic modesetting (see below)
+    struct drm_prime_framebuffer prime_fb;
 };
 
 struct priv {
@@ -92,12 +104,40 @@ struct priv {
     int32_t screen_h;
     struct mp_image *last_input;
     struct mp_image *cur_frame;
-    struct mp_image *cur_frame_cropped;
     struct mp_rect src;
     struct mp_rect dst;
     struct mp_osd_res osd;
     struct mp_sws_context *sws;
 
+    // Still redraws of the same frame (OSD changes while paused) restore
+    // cur_frame from clean (the scaled video without OSD), and copy only the
+    // area covered by the OSD to framebuffers that had the same clean frame.
+    struct mp_image *clean;
+    uint64_t clean_frame_id;
+    uint64_t clean_id;              // incremented on each clean update
+    bool clean_valid;
+    bool cur_clean;                 // cur_frame is clean plus OSD in cur_osd_rc
+    struct mp_rect cur_osd_rc;
+
+    // Dumb buffers allocated by get_image(). Frames decoded into them are
+    // scanned out directly if no conversion or OSD is needed.
+    struct framebuffer **dr_bufs;
+    int num_dr_bufs;
+    struct mp_image *cur_dr_image;  // last drawn frame, if scanned out as is
+    struct framebuffer *cur_dr_fb;
+
+    // IMGFMT_DRMPRIME frames from the DRM hwdec device are scanned out as
+    // they are on the drmprime video plane (needs atomic modesetting). The OSD
+    // is rendered with the draw_bmp overlay API into ARGB buffers shown on the
+    // draw plane, so no conversion, copy or GPU compositing of the video.
+    struct mp_hwdec_ctx hwctx;
+    struct drm_prime_handle_refs handle_refs;
+    bool prime;                     // current video params are IMGFMT_DRMPRIME
+    bool planes_used;               // the atomic planes were set up by us
+    struct framebuffer *osd_bufs;   // buf_count entries, or NULL
+    int osd_buf;                    // index of the most recently updated one
+    struct mp_draw_sub_cache *osd_cache;
+
     struct drm_vsync_tuple vsync;
     struct vo_vsync_info vsync_info;
 };
@@ -118,10 +158,9 @@ static void fb_destroy(int fd, struct framebuffer *buf)
     }
 }
 
-static bool fb_setup_single(struct vo *vo, int fd, struct framebuffer *buf)
+static bool fb_setup_single(struct vo *vo, int fd, struct framebuffer *buf,
+                            uint32_t format)
 {
-    struct priv *p = vo->priv;
-
     buf->handle = 0;
 
     // create dumb buffer
@@ -140,7 +179,7 @@ static bool fb_setup_single(struct vo *vo, int fd, struct framebuffer *buf)
 
     // create framebuffer object for the dumb-buffer
     int ret = drmModeAddFB2(fd, buf->width, buf->height,
-                            p->drm_format,
+                            format,
                             (uint32_t[4]){buf->handle, 0, 0, 0},
                             (uint32_t[4]){buf->stride, 0, 0, 0},
                             (uint32_t[4]){0, 0, 0, 0},
@@ -188,7 +227,7 @@ static bool fb_setup_buffers(struct vo *vo)
     }
 
     for (unsigned int i = 0; i < p->buf_count; i++) {
-        if (!fb_setup_single(vo, p->kms->fd, &p->bufs[i])) {
+        if (!fb_setup_single(vo, p->kms->fd, &p->bufs[i], p->drm_format)) {
             MP_ERR(vo, "Cannot create framebuffer\n");
             for (unsigned int j = 0; j < i; j++) {
                 fb_destroy(p->kms->fd, &p->bufs[j]);
@@ -222,6 +261,33 @@ static bool crtc_setup(struct vo *vo)
     return ret == 0;
 }
 
+// Turn off the planes used for prime frames, except for a primary draw plane,
+// which is reset by the next legacy modeset or page flip.
+static void disable_prime_planes(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+    struct drm_atomic_context *ctx = p->kms->atomic_context;
+
+    if (!p->planes_used)
+        return;
+    p->planes_used = false;
+
+    drmModeAtomicReq *request = drmModeAtomicAlloc();
+    if (!request)
+        return;
+    drm_object_set_property(request, ctx->drmprime_video_plane, "FB_ID", 0);
+    drm_object_set_property(request, ctx->drmprime_video_plane, "CRTC_ID", 0);
+    uint64_t type = 0;
+    drm_object_get_property(ctx->draw_plane, "TYPE", &type);
+    if (type != DRM_PLANE_TYPE_PRIMARY) {
+        drm_object_set_property(request, ctx->draw_plane, "FB_ID", 0);
+        drm_object_set_property(request, ctx->draw_plane, "CRTC_ID", 0);
+    }
+    if (drmModeAtomicCommit(p->kms->fd, request, 0, NULL))
+        MP_ERR(vo, "Failed to disable planes: %s\n", mp_strerror(errno));
+    drmModeAtomicFree(request);
+}
+
 static void crtc_release(struct vo *vo)
 {
     struct priv *p = vo->priv;
@@ -239,6 +305,8 @@ static void crtc_release(struct vo *vo)
         }
     }
 
+    disable_prime_planes(vo);
+
     if (p->old_crtc) {
         drmModeSetCrtc(p->kms->fd, p->old_crtc->crtc_id,
                        p->old_crtc->buffer_id,
@@ -291,6 +359,28 @@ static void wakeup(struct vo *vo)
         vt_switcher_interrupt_poll(&p->vt_switcher);
 }
 
+static bool osd_setup_buffers(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+
+    p->osd_bufs = talloc_zero_array(p, struct framebuffer, p->buf_count);
+    for (unsigned int i = 0; i < p->buf_count; i++) {
+        struct framebuffer *buf = &p->osd_bufs[i];
+        buf->width = p->screen_w;
+        buf->height = p->screen_h;
+        // Premultiplied alpha, BGRA in memory, which is what draw_bmp outputs.
+        if (!fb_setup_single(vo, p->kms->fd, buf, DRM_FORMAT_ARGB8888)) {
+            MP_ERR(vo, "Cannot create OSD framebuffer\n");
+            for (unsigned int j = 0; j < i; j++)
+                fb_destroy(p->kms->fd, &p->osd_bufs[j]);
+            TA_FREEP(&p->osd_bufs);
+            return false;
+        }
+    }
+    p->osd_buf = 0;
+    return true;
+}
+
 static int reconfig(struct vo *vo, struct mp_image_params *params)
 {
     struct priv *p = vo->priv;
@@ -299,6 +389,14 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     vo->dheight = p->screen_h;
     vo_get_src_dst_rects(vo, &p->src, &p->dst, &p->osd);
 
+    p->prime = params->imgfmt == IMGFMT_DRMPRIME;
+    if (p->prime) {
+        if (!p->osd_bufs && !osd_setup_buffers(vo))
+            return -1;
+        vo->want_redraw = true;
+        return 0;
+    }
+
     int w = p->dst.x1 - p->dst.x0;
     int h = p->dst.y1 - p->dst.y0;
 
@@ -317,9 +415,9 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     mp_image_set_params(p->cur_frame, &p->sws->dst);
     mp_image_set_size(p->cur_frame, p->screen_w, p->screen_h);
 
-    talloc_free(p->cur_frame_cropped);
-    p->cur_frame_cropped = mp_image_new_dummy_ref(p->cur_frame);
-    mp_image_crop_rc(p->cur_frame_cropped, p->dst);
+    TA_FREEP(&p->clean);
+    p->clean_valid = false;
+    p->cur_clean = false;
 
     talloc_free(p->last_input);
     p->last_input = NULL;
@@ -364,59 +462,101 @@ static struct framebuffer *get_new_fb(struct vo *vo)
     return &p->bufs[p->front_buf];
 }
 
-static void draw_image(struct vo *vo, mp_image_t *mpi, struct framebuffer *front_buf)
+static void render_frame(struct priv *p, struct mp_image *img,
+                         struct mp_image *mpi)
+{
+    struct mp_image src = *mpi;
+    struct mp_rect src_rc = p->src;
+    src_rc.x0 = MP_ALIGN_DOWN(src_rc.x0, mpi->fmt.align_x);
+    src_rc.y0 = MP_ALIGN_DOWN(src_rc.y0, mpi->fmt.align_y);
+    mp_image_crop_rc(&src, src_rc);
+
+    mp_image_clear(img, 0, 0, img->w, p->dst.y0);
+    mp_image_clear(img, 0, p->dst.y1, img->w, img->h);
+    mp_image_clear(img, 0, p->dst.y0, p->dst.x0, p->dst.y1);
+    mp_image_clear(img, p->dst.x1, p->dst.y0, img->w, p->dst.y1);
+
+    struct mp_image dst = *img;
+    mp_image_crop_rc(&dst, p->dst);
+    mp_sws_scale(p->sws, &dst, &src);
+}
+
+// Copy the rc part of cur_frame to the framebuffer.
+static void copy_to_fb(struct priv *p, struct framebuffer *fb, struct mp_rect rc)
+{
+    struct mp_image *img = p->cur_frame;
+
+    if (rc.x0 >= rc.x1 || rc.y0 >= rc.y1)
+        return;
+
+    if (p->drm_format == DRM_FORMAT_XRGB2101010) {
+        // Pack GBRP10 image into XRGB2101010 for DRM
+        for (int y = rc.y0; y < rc.y1; y++) {
+            uint16_t *g_ptr = mp_image_pixel_ptr(img, 0, rc.x0, y);
+            uint16_t *b_ptr = mp_image_pixel_ptr(img, 1, rc.x0, y);
+            uint16_t *r_ptr = mp_image_pixel_ptr(img, 2, rc.x0, y);
+            uint32_t *fbuf_ptr =
+                (uint32_t *)(fb->map + y * fb->stride) + rc.x0;
+            for (int x = rc.x0; x < rc.x1; x++)
+                *fbuf_ptr++ = (*r_ptr++ << 20) | (*g_ptr++ << 10) | (*b_ptr++);
+        }
+    } else { // p->drm_format == DRM_FORMAT_XRGB8888
+        memcpy_pic(fb->map + rc.y0 * fb->stride + rc.x0 * BYTES_PER_PIXEL,
+                   mp_image_pixel_ptr(img, 0, rc.x0, rc.y0),
+                   mp_rect_w(rc) * BYTES_PER_PIXEL, mp_rect_h(rc),
+                   fb->stride, img->stride[0]);
+    }
+}
+
+static void draw_image(struct vo *vo, mp_image_t *mpi, struct framebuffer *front_buf,
+                       struct vo_frame *frame)
 {
     struct priv *p = vo->priv;
 
     if (p->active && front_buf != NULL) {
-        if (mpi) {
-            struct mp_image src = *mpi;
-            struct mp_rect src_rc = p->src;
-            src_rc.x0 = MP_ALIGN_DOWN(src_rc.x0, mpi->fmt.align_x);
-            src_rc.y0 = MP_ALIGN_DOWN(src_rc.y0, mpi->fmt.align_y);
-            mp_image_crop_rc(&src, src_rc);
-
-            mp_image_clear(p->cur_frame, 0, 0, p->cur_frame->w, p->dst.y0);
-            mp_image_clear(p->cur_frame, 0, p->dst.y1, p->cur_frame->w, p->cur_frame->h);
-            mp_image_clear(p->cur_frame, 0, p->dst.y0, p->dst.x0, p->dst.y1);
-            mp_image_clear(p->cur_frame, p->dst.x1, p->dst.y0, p->cur_frame->w, p->dst.y1);
-
-            mp_sws_scale(p->sws, p->cur_frame_cropped, &src);
-            osd_draw_on_image(vo->osd, p->osd, src.pts, 0, p->cur_frame);
+        struct mp_image *img = p->cur_frame;
+        struct mp_rect full = {0, 0, img->w, img->h};
+
+        if (!mpi || p->clean_frame_id != frame->frame_id)
+            p->clean_valid = false;
+        if (mpi && !p->clean_valid && frame->redraw && frame->still) {
+            if (!p->clean) {
+                p->clean = mp_image_alloc(img->imgfmt, img->w, img->h);
+                if (p->clean)
+                    mp_image_set_params(p->clean, &img->params);
+            }
+            if (p->clean) {
+                render_frame(p, p->clean, mpi);
+                p->clean_valid = true;
+                p->clean_frame_id = frame->frame_id;
+                p->clean_id++;
+                p->cur_clean = false;
+            }
+        }
+
+        if (p->clean_valid) {
+            mp_image_copy_rc(img, p->clean, p->cur_clean ? p->cur_osd_rc : full);
+        } else if (mpi) {
+            render_frame(p, img, mpi);
         } else {
-            mp_image_clear(p->cur_frame, 0, 0, p->cur_frame->w, p->cur_frame->h);
-            osd_draw_on_image(vo->osd, p->osd, 0, 0, p->cur_frame);
+            mp_image_clear(img, 0, 0, img->w, img->h);
         }
 
-        if (p->drm_format == DRM_FORMAT_XRGB2101010) {
-            // Pack GBRP10 image into XRGB2101010 for DRM
-            const int w = p->cur_frame->w;
-            const int h = p->cur_frame->h;
-
-            const int g_padding = p->cur_frame->stride[0]/sizeof(uint16_t) - w;
-            const int b_padding = p->cur_frame->stride[1]/sizeof(uint16_t) - w;
-            const int r_padding = p->cur_frame->stride[2]/sizeof(uint16_t) - w;
-            const int fbuf_padding = front_buf->stride/sizeof(uint32_t) - w;
-
-            uint16_t *g_ptr = (uint16_t*)p->cur_frame->planes[0];
-            uint16_t *b_ptr = (uint16_t*)p->cur_frame->planes[1];
-            uint16_t *r_ptr = (uint16_t*)p->cur_frame->planes[2];
-            uint32_t *fbuf_ptr = (uint32_t*)front_buf->map;
-            for (unsigned y = 0; y < h; ++y) {
-                for (unsigned x = 0; x < w; ++x) {
-                    *fbuf_ptr++ = (*r_ptr++ << 20) | (*g_ptr++ << 10) | (*b_ptr++);
-                }
-                g_ptr += g_padding;
-                b_ptr += b_padding;
-                r_ptr += r_padding;
-                fbuf_ptr += fbuf_padding;
-            }
-        } else { // p->drm_format == DRM_FORMAT_XRGB8888
-            memcpy_pic(front_buf->map, p->cur_frame->planes[0],
-                       p->cur_frame->w * BYTES_PER_PIXEL, p->cur_frame->h,
-                       front_buf->stride,
-                       p->cur_frame->stride[0]);
+        struct mp_rect rc;
+        osd_draw_on_image_rc(vo->osd, p->osd, mpi ? mpi->pts : 0, 0, img, &rc);
+        mp_rect_intersection(&rc, &full);
+        p->cur_clean = p->clean_valid;
+        p->cur_osd_rc = rc;
+
+        // With the same clean frame, the fb differs only where either has OSD.
+        struct mp_rect damage = full;
+        if (p->clean_valid && front_buf->clean_id == p->clean_id) {
+            damage = front_buf->osd_rc;
+            mp_rect_extend(&damage, &rc);
         }
+        copy_to_fb(p, front_buf, damage);
+        front_buf->clean_id = p->clean_valid ? p->clean_id : 0;
+        front_buf->osd_rc = rc;
     }
 
     if (mpi != p->last_input) {
@@ -425,21 +565,28 @@ static void draw_image(struct vo *vo, mp_image_t *mpi, struct framebuffer *front
     }
 }
 
-static void enqueue_frame(struct vo *vo, struct framebuffer *fb)
+static struct kms_frame *enqueue_frame(struct vo *vo, struct framebuffer *fb,
+                                       struct mp_image *dr_image)
 {
     struct priv *p = vo->priv;
 
     p->vsync.sbc++;
-    struct kms_frame *new_frame = talloc(p, struct kms_frame);
+    struct kms_frame *new_frame = talloc_zero(p, struct kms_frame);
     new_frame->fb = fb;
     new_frame->vsync = p->vsync;
+    // Keep the DR frame alive until the next page flip has finished.
+    new_frame->dr_image = dr_image ? mp_image_new_ref(dr_image) : NULL;
     MP_TARRAY_APPEND(p, p->fb_queue, p->fb_queue_len, new_frame);
+    return new_frame;
 }
 
 static void dequeue_frame(struct vo *vo)
 {
     struct priv *p = vo->priv;
 
+    drm_prime_destroy_framebuffer(vo->log, p->kms->fd,
+                                  &p->fb_queue[0]->prime_fb, &p->handle_refs);
+    talloc_free(p->fb_queue[0]->dr_image);
     talloc_free(p->fb_queue[0]);
     MP_TARRAY_REMOVE_AT(p->fb_queue, p->fb_queue_len, 0);
 }
@@ -453,6 +600,89 @@ static void swapchain_step(struct vo *vo)
     }
 }
 
+// Return the DR buffer mpi was decoded to, if it can be scanned out as is.
+static struct framebuffer *get_dr_fb(struct vo *vo, struct mp_image *mpi)
+{
+    struct priv *p = vo->priv;
+
+    if (!mpi || mpi->imgfmt != p->imgfmt ||
+        mpi->w != p->screen_w || mpi->h != p->screen_h)
+        return NULL;
+
+    struct mp_rect full = {0, 0, p->screen_w, p->screen_h};
+    if (!mp_rect_equals(&p->src, &full) || !mp_rect_equals(&p->dst, &full))
+        return NULL;
+
+    for (int n = 0; n < p->num_dr_bufs; n++) {
+        struct framebuffer *buf = p->dr_bufs[n];
+        if (buf->map == mpi->planes[0] && buf->stride == mpi->stride[0])
+            return buf;
+    }
+    return NULL;
+}
+
+// Render the OSD into the next OSD buffer, if it changed.
+static void update_osd(struct vo *vo, double pts)
+{
+    struct priv *p = vo->priv;
+
+    if (!p->osd_cache)
+        p->osd_cache = mp_draw_sub_alloc(p, vo->global);
+
+    struct sub_bitmap_list *sbs =
+        osd_render(vo->osd, p->osd, pts, 0, mp_draw_sub_formats);
+    struct mp_rect act_rc, mod_rc;
+    int num_act_rc = 0, num_mod_rc = 0;
+    struct mp_image *osd = mp_draw_sub_overlay(p->osd_cache, sbs,
+                                               &act_rc, 1, &num_act_rc,
+                                               &mod_rc, 1, &num_mod_rc);
+    talloc_free(sbs);
+    if (!osd || !num_mod_rc)
+        return;
+
+    p->osd_buf = (p->osd_buf + 1) % p->buf_count;
+    struct framebuffer *buf = &p->osd_bufs[p->osd_buf];
+
+    // The overlay is transparent outside of act_rc, so copying the union with
+    // the area this buffer had OSD in last time makes it equal to the overlay.
+    struct mp_rect rc = buf->osd_rc;
+    if (num_act_rc)
+        mp_rect_extend(&rc, &act_rc);
+    struct mp_rect full = {0, 0, MPMIN(osd->w, buf->width),
+                           MPMIN(osd->h, buf->height)};
+    if (mp_rect_intersection(&rc, &full)) {
+        memcpy_pic(buf->map + rc.y0 * buf->stride + rc.x0 * 4,
+                   mp_image_pixel_ptr(osd, 0, rc.x0, rc.y0),
+                   mp_rect_w(rc) * 4, mp_rect_h(rc),
+                   buf->stride, osd->stride[0]);
+    }
+    buf->osd_rc = num_act_rc ? act_rc : (struct mp_rect){0};
+}
+
+static void draw_prime_frame(struct vo *vo, struct vo_frame *frame)
+{
+    struct priv *p = vo->priv;
+    struct mp_image *mpi = frame->current;
+
+    if (!frame->repeat || frame->redraw)
+        update_osd(vo, mpi ? mpi->pts : 0);
+
+    if (mpi && mpi->imgfmt != IMGFMT_DRMPRIME)
+        mpi = NULL;
+
+    // Each queued frame gets its own DRM framebuffer for the dmabuf, even for
+    // repeats, so that the lifetime is the same as for other queue entries.
+    struct kms_frame *kf = enqueue_frame(vo, &p->osd_bufs[p->osd_buf], mpi);
+    kf->prime = true;
+    if (mpi) {
+        AVDRMFrameDescriptor *desc = (AVDRMFrameDescriptor *)mpi->planes[0];
+        if (drm_prime_create_framebuffer(vo->log, p->kms->fd, desc,
+                                         mpi->w, mpi->h, &kf->prime_fb,
+                                         &p->handle_refs))
+            MP_ERR(vo, "Failed to create framebuffer for the video frame.\n");
+    }
+}
+
 static void draw_frame(struct vo *vo, struct vo_frame *frame)
 {
     struct priv *p = vo->priv;
@@ -462,16 +692,104 @@ static void draw_frame(struct vo *vo, struct vo_frame *frame)
 
     p->still = frame->still;
 
+    if (p->prime) {
+        draw_prime_frame(vo, frame);
+        return;
+    }
+
     // we redraw the entire image when OSD needs to be redrawn
     const bool repeat = frame->repeat && !frame->redraw;
 
     struct framebuffer *fb =  &p->bufs[p->front_buf];
+    if (repeat && p->cur_dr_image)
+        fb = p->cur_dr_fb;
     if (!repeat) {
-        fb = get_new_fb(vo);
-        draw_image(vo, mp_image_new_ref(frame->current), fb);
+        TA_FREEP(&p->cur_dr_image);
+        p->cur_dr_fb = NULL;
+
+        struct framebuffer *dr_fb = get_dr_fb(vo, frame->current);
+        if (dr_fb) {
+            // The decoder still references the frame, so this draws into a
+            // copy if the OSD is visible. Then use the normal path.
+            struct mp_image *mpi = mp_image_new_ref(frame->current);
+            osd_draw_on_image(vo->osd, p->osd, mpi->pts, 0, mpi);
+            if (mpi->planes[0] == dr_fb->map) {
+                p->cur_dr_image = mpi;
+                p->cur_dr_fb = fb = dr_fb;
+            } else {
+                talloc_free(mpi);
+            }
+        }
+
+        if (!p->cur_dr_image) {
+            fb = get_new_fb(vo);
+            draw_image(vo, mp_image_new_ref(frame->current), fb, frame);
+        }
+    }
+
+    enqueue_frame(vo, fb, p->cur_dr_image);
+}
+
+// Show the prime video frame and the OSD buffer with one atomic commit.
+static int commit_prime_frame(struct vo *vo, struct kms_frame *frame, void *data)
+{
+    struct priv *p = vo->priv;
+    struct drm_atomic_context *ctx = p->kms->atomic_context;
+    struct drm_object *video = ctx->drmprime_video_plane;
+    struct drm_object *draw = ctx->draw_plane;
+
+    drmModeAtomicReq *request = drmModeAtomicAlloc();
+    if (!request)
+        return -ENOMEM;
+
+    if (frame->prime_fb.fb_id) {
+        struct mp_image *mpi = frame->dr_image;
+        struct mp_rect src = p->src, dst = p->dst;
+        // Some hardware can't handle odd plane positions/sizes.
+        dst.x0 = MP_ALIGN_DOWN(dst.x0, 2);
+        dst.y0 = MP_ALIGN_DOWN(dst.y0, 2);
+        int dstw = MP_ALIGN_UP(mp_rect_w(dst), 2);
+        int dsth = MP_ALIGN_UP(mp_rect_h(dst), 2);
+        src.x1 = MPMIN(src.x1, mpi->w);
+        src.y1 = MPMIN(src.y1, mpi->h);
+        drm_object_set_property(request, video, "FB_ID", frame->prime_fb.fb_id);
+        drm_object_set_property(request, video, "CRTC_ID", ctx->crtc->id);
+        drm_object_set_property(request, video, "SRC_X", (uint64_t)src.x0 << 16);
+        drm_object_set_property(request, video, "SRC_Y", (uint64_t)src.y0 << 16);
+        drm_object_set_property(request, video, "SRC_W",
+                                (uint64_t)mp_rect_w(src) << 16);
+        drm_object_set_property(request, video, "SRC_H",
+                                (uint64_t)mp_rect_h(src) << 16);
+        drm_object_set_property(request, video, "CRTC_X", dst.x0);
+        drm_object_set_property(request, video, "CRTC_Y", dst.y0);
+        drm_object_set_property(request, video, "CRTC_W", dstw);
+        drm_object_set_property(request, video, "CRTC_H", dsth);
+        drm_object_set_property(request, video, "ZPOS", 0);
+    } else {
+        drm_object_set_property(request, video, "FB_ID", 0);
+        drm_object_set_property(request, video, "CRTC_ID", 0);
     }
 
-    enqueue_frame(vo, fb);
+    struct framebuffer *osd = frame->fb;
+    drm_object_set_property(request, draw, "FB_ID", osd->fb);
+    drm_object_set_property(request, draw, "CRTC_ID", ctx->crtc->id);
+    drm_object_set_property(request, draw, "SRC_X", 0);
+    drm_object_set_property(request, draw, "SRC_Y", 0);
+    drm_object_set_property(request, draw, "SRC_W", (uint64_t)osd->width << 16);
+    drm_object_set_property(request, draw, "SRC_H", (uint64_t)osd->height << 16);
+    drm_object_set_property(request, draw, "CRTC_X", 0);
+    drm_object_set_property(request, draw, "CRTC_Y", 0);
+    drm_object_set_property(request, draw, "CRTC_W", p->screen_w);
+    drm_object_set_property(request, draw, "CRTC_H", p->screen_h);
+    drm_object_set_property(request, draw, "ZPOS", 1);
+
+    int ret = drmModeAtomicCommit(p->kms->fd, request,
+                                  DRM_MODE_ATOMIC_NONBLOCK |
+                                  DRM_MODE_PAGE_FLIP_EVENT, data);
+    drmModeAtomicFree(request);
+    if (!ret)
+        p->planes_used = true;
+    return ret;
 }
 
 static void queue_flip(struct vo *vo, struct kms_frame *frame)
@@ -479,7 +797,9 @@ static void queue_flip(struct vo *vo, struct kms_frame *frame)
     int ret = 0;
     struct priv *p = vo->priv;
 
-    p->cur_fb = frame->fb;
+    // Prime frames never touch the legacy buffer (used by crtc_setup()).
+    if (!frame->prime)
+        p->cur_fb = frame->fb;
 
     // Alloc and fill the data struct for the page flip callback
     struct drm_pflip_cb_closure *data = talloc(p, struct drm_pflip_cb_closure);
@@ -489,11 +809,17 @@ static void queue_flip(struct vo *vo, struct kms_frame *frame)
     data->waiting_for_flip = &p->waiting_for_flip;
     data->log = vo->log;
 
-    ret = drmModePageFlip(p->kms->fd, p->kms->crtc_id,
-                          p->cur_fb->fb,
-                          DRM_MODE_PAGE_FLIP_EVENT, data);
+    if (frame->prime) {
+        ret = commit_prime_frame(vo, frame, data);
+    } else {
+        disable_prime_planes(vo);
+        ret = drmModePageFlip(p->kms->fd, p->kms->crtc_id,
+                              p->cur_fb->fb,
+                              DRM_MODE_PAGE_FLIP_EVENT, data);
+    }
     if (ret) {
         MP_WARN(vo, "Failed to queue page flip: %s\n", mp_strerror(errno));
+        talloc_free(data);
     } else {
         p->waiting_for_flip = true;
     }
@@ -533,9 +859,21 @@ static void uninit(struct vo *vo)
         swapchain_step(vo);
     }
 
+    TA_FREEP(&p->cur_dr_image);
+    assert(!p->num_dr_bufs);
+
+    if (vo->hwdec_devs) {
+        hwdec_devices_remove(vo->hwdec_devs, &p->hwctx);
+        hwdec_devices_destroy(vo->hwdec_devs);
+        vo->hwdec_devs = NULL;
+    }
+    av_buffer_unref(&p->hwctx.av_device_ref);
+
     if (p->kms) {
         for (unsigned int i = 0; i < p->buf_count; i++)
             fb_destroy(p->kms->fd, &p->bufs[i]);
+        for (unsigned int i = 0; p->osd_bufs && i < p->buf_count; i++)
+            fb_destroy(p->kms->fd, &p->osd_bufs[i]);
         kms_destroy(p->kms);
         p->kms = NULL;
     }
@@ -545,7 +883,38 @@ static void uninit(struct vo *vo)
 
     talloc_free(p->last_input);
     talloc_free(p->cur_frame);
-    talloc_free(p->cur_frame_cropped);
+    talloc_free(p->clean);
+}
+
+// Provide a DRM hwdec device if prime frames can be put on a plane.
+static void setup_prime(struct vo *vo)
+{
+    struct priv *p = vo->priv;
+    struct drm_atomic_context *ctx = p->kms->atomic_context;
+
+    if (!ctx || !ctx->drmprime_video_plane || !ctx->draw_plane)
+        return;
+
+    uint64_t has_prime = 0;
+    if (drmGetCap(p->kms->fd, DRM_CAP_PRIME, &has_prime) < 0 || !has_prime)
+        return;
+    drm_prime_init_handle_ref_count(p, &p->handle_refs);
+
+    char *path = drmGetDeviceNameFromFd2(p->kms->fd);
+    int ret = av_hwdevice_ctx_create(&p->hwctx.av_device_ref,
+                                     AV_HWDEVICE_TYPE_DRM, path, NULL, 0);
+    free(path);
+    if (ret < 0) {
+        MP_VERBOSE(vo, "Failed to create DRM hwdevice_ctx.\n");
+        return;
+    }
+
+    p->hwctx.driver_name = "drm";
+    p->hwctx.hw_imgfmt = IMGFMT_DRMPRIME;
+    vo->hwdec_devs = hwdec_devices_create();
+    hwdec_devices_add(vo->hwdec_devs, &p->hwctx);
+    MP_VERBOSE(vo, "Prime frames are scanned out on plane %d.\n",
+               ctx->drmprime_video_plane->id);
 }
 
 static int preinit(struct vo *vo)
@@ -565,11 +934,22 @@ static int preinit(struct vo *vo)
         MP_WARN(vo, "Failed to set up VT switcher. Terminal switching will be unavailable.\n");
     }
 
+    struct drm_opts *drm_opts = vo->opts->drm_opts;
     p->kms = kms_create(vo->log,
-                        vo->opts->drm_opts->drm_device_path,
-                        vo->opts->drm_opts->drm_connector_spec,
-                        vo->opts->drm_opts->drm_mode_spec,
-                        0, 0, false);
+                        drm_opts->drm_device_path,
+                        drm_opts->drm_connector_spec,
+                        drm_opts->drm_mode_spec,
+                        drm_opts->drm_draw_plane,
+                        drm_opts->drm_drmprime_video_plane,
+                        drm_opts->drm_atomic);
+    if (!p->kms && drm_opts->drm_atomic) {
+        MP_VERBOSE(vo, "Retrying with legacy modesetting.\n");
+        p->kms = kms_create(vo->log,
+                            drm_opts->drm_device_path,
+                            drm_opts->drm_connector_spec,
+                            drm_opts->drm_mode_spec,
+                            0, 0, false);
+    }
     if (!p->kms) {
         MP_ERR(vo, "Failed to create KMS.\n");
         goto err;
@@ -583,7 +963,7 @@ static int preinit(struct vo *vo)
         p->imgfmt = IMGFMT_XRGB8888;
     }
 
-    p->swapchain_depth = vo->opts->swapchain_depth;
+    p->swapchain_depth = vo_get_swapchain_depth(vo);
     p->buf_count = p->swapchain_depth + 1;
     if (!fb_setup_buffers(vo)) {
         MP_ERR(vo, "Failed to set up buffers.\n");
@@ -618,6 +998,8 @@ static int preinit(struct vo *vo)
     p->vsync_info.skipped_vsyncs = -1;
     p->vsync_info.last_queue_display_time = -1;
 
+    setup_prime(vo);
+
     return 0;
 
 err:
@@ -627,15 +1009,83 @@ err:
 
 static int query_format(struct vo *vo, int format)
 {
+    struct priv *p = vo->priv;
+    if (format == IMGFMT_DRMPRIME)
+        return !!p->hwctx.av_device_ref;
     return sws_isSupportedInput(imgfmt2pixfmt(format));
 }
 
+static void dr_free(void *opaque, uint8_t *data)
+{
+    struct vo *vo = opaque;
+    struct priv *p = vo->priv;
+
+    for (int n = 0; n < p->num_dr_bufs; n++) {
+        struct framebuffer *buf = p->dr_bufs[n];
+        if (buf->map == data) {
+            fb_destroy(p->kms->fd, buf);
+            talloc_free(buf);
+            MP_TARRAY_REMOVE_AT(p->dr_bufs, p->num_dr_bufs, n);
+            return;
+        }
+    }
+    // not found - must not happen
+    MP_ASSERT_UNREACHABLE();
+}
+
+static struct mp_image *get_image(struct vo *vo, int imgfmt, int w, int h,
+                                  int stride_align)
+{
+    struct priv *p = vo->priv;
+
+    // Only frames in the scanout format can avoid the copy. (GBRP10 is
+    // repacked to XRGB2101010 anyway.)
+    if (imgfmt != p->imgfmt || p->drm_format != DRM_FORMAT_XRGB8888)
+        return NULL;
+
+    struct framebuffer *buf = talloc_zero(NULL, struct framebuffer);
+    buf->width = w;
+    buf->height = h;
+    if (!fb_setup_single(vo, p->kms->fd, buf, p->drm_format)) {
+        talloc_free(buf);
+        return NULL;
+    }
+
+    struct mp_image *mpi = NULL;
+    if (buf->stride % stride_align)
+        goto fail;
+
+    mpi = mp_image_new_dummy_ref(NULL);
+    mp_image_setfmt(mpi, imgfmt);
+    mp_image_set_size(mpi, w, h);
+    mpi->planes[0] = buf->map;
+    mpi->stride[0] = buf->stride;
+    mpi->bufs[0] = av_buffer_create(buf->map, buf->size, dr_free, vo, 0);
+    if (!mpi->bufs[0])
+        goto fail;
+
+    MP_TARRAY_APPEND(p, p->dr_bufs, p->num_dr_bufs, buf);
+    return mpi;
+
+fail:
+    talloc_free(mpi);
+    fb_destroy(p->kms->fd, buf);
+    talloc_free(buf);
+    return NULL;
+}
+
 static int control(struct vo *vo, uint32_t request, void *arg)
 {
     struct priv *p = vo->priv;
     switch (request) {
     case VOCTRL_SCREENSHOT_WIN:
-        *(struct mp_image**)arg = mp_image_new_copy(p->cur_frame);
+        // The video is not available in system memory; let the player use
+        // the decoded frame instead.
+        if (p->prime)
+            return VO_NOTIMPL;
+        *(struct mp_image**)arg = mp_image_new_copy(p->cur_dr_image ?
+                                                    p->cur_dr_image :
+                                                    p->cur_frame);
         return VO_TRUE;
     case VOCTRL_SET_PANSCAN:
         if (vo->config_ok)
@@ -679,6 +1129,7 @@ const struct vo_driver video_out_drm = {
     .control = control,
     .draw_frame = draw_frame,
     .flip_page = flip_page,
+    .get_image = get_image,
     .get_vsync = get_vsync,
     .uninit = uninit,
     .wait_events = wait_events,
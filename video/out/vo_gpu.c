@@ -304,6 +304,7 @@ static int preinit(struct vo *vo)
     p->renderer = gl_video_init(p->ctx->ra, vo->log, vo->global);
     gl_video_set_osd_source(p->renderer, vo->osd);
     gl_video_configure_queue(p->renderer, vo);
+    gl_video_set_redraw_vo(p->renderer, vo);
 
     get_and_update_icc_profile(p);
 
@@ -29,9 +29,11 @@
 
 #include "config.h"
 #include "common/common.h"
+#include "common/stats.h"
 #include "options/m_config.h"
 #include "options/path.h"
 #include "osdep/io.h"
+#include "osdep/threads.h"
 #include "stream/stream.h"
 #include "video/fmt-conversion.h"
 #include "video/mp_image.h"
@@ -57,6 +59,7 @@
 
 struct osd_entry {
     pl_tex tex;
+    int64_t packed_id; // sub_bitmaps.packed_id of the tex contents
     struct pl_overlay_part *parts;
     int num_parts;
 };
@@ -84,6 +87,19 @@ struct user_lut {
     struct pl_custom_lut *lut;
 };
 
+// A software frame uploaded in advance on the upload thread.
+struct prefetch {
+    uint64_t id;
+    struct mp_image *mpi;
+    pl_tex tex[4];                  // kept when recycled
+    struct pl_plane planes[4];
+    struct pl_bit_encoding bits;
+    int num_planes;
+    bool busy;                      // being uploaded right now
+    bool done;                      // upload finished (see ok)
+    bool ok;
+};
+
 struct priv {
     struct mp_log *log;
     struct mpv_global *global;
@@ -97,6 +113,21 @@ struct priv {
     pl_buf *dr_buffers;
     int num_dr_buffers;
 
+    // Upload thread, if the pl_gpu is thread-safe. Software frames are uploaded
+    // as soon as vo_queue_frame() receives them, so draw_frame() only has to
+    // render them.
+    pthread_t upload_thread;
+    bool upload_thread_valid;
+    pthread_mutex_t upload_lock;
+    pthread_cond_t upload_wakeup;
+    // -- protected by upload_lock
+    bool upload_terminate;
+    struct prefetch **prefetch;     // queued frames, sorted by id
+    int num_prefetch;
+    struct prefetch **free_prefetch; // for reuse
+    int num_free_prefetch;
+    uint64_t last_prefetch_id;
+
     pl_log pllog;
     pl_gpu gpu;
     pl_renderer rr;
@@ -133,8 +164,12 @@ struct priv {
     struct pl_icc_params icc;
     struct pl_icc_profile icc_profile;
     char *icc_path;
+    int icc_cache_hits, icc_cache_misses;
 #endif
 
+    bstr pl_cache;          // libplacebo.cache contents as loaded at init
+    struct stats_ctx *stats;
+
     struct user_lut image_lut;
     struct user_lut target_lut;
     struct user_lut lut;
@@ -243,8 +278,13 @@ static void update_overlays(struct vo *vo, struct mp_osd_res res, double pts,
             continue;
         struct osd_entry *entry = &state->entries[item->render_index];
         pl_fmt tex_fmt = p->osd_fmt[item->format];
-        if (!entry->tex)
+        if (!entry->tex) {
             MP_TARRAY_POP(p->sub_tex, p->num_sub_tex, &entry->tex);
+            entry->packed_id = 0;
+        }
+        pl_tex old_tex = entry->tex;
+        struct pl_tex_params old_params = old_tex ? old_tex->params
+                                                  : (struct pl_tex_params){0};
         bool ok = pl_tex_recreate(p->gpu, &entry->tex, &(struct pl_tex_params) {
             .format = tex_fmt,
             .w = MPMAX(item->packed_w, entry->tex ? entry->tex->params.w : 0),
@@ -256,16 +296,38 @@ static void update_overlays(struct vo *vo, struct mp_osd_res res, double pts,
             MP_ERR(vo, "Failed recreating OSD texture!\n");
             break;
         }
-        ok = pl_tex_upload(p->gpu, &(struct pl_tex_transfer_params) {
-            .tex        = entry->tex,
-            .rc         = { .x1 = item->packed_w, .y1 = item->packed_h, },
-            .stride_w   = item->packed->stride[0] / tex_fmt->texel_size,
-            .ptr        = item->packed->planes[0],
-        });
+        if (entry->tex != old_tex || old_params.format != tex_fmt ||
+            old_params.w != entry->tex->params.w ||
+            old_params.h != entry->tex->params.h)
+            entry->packed_id = 0;
+
+        // Only upload what changed since the texture contents, if possible.
+        pl_rect3d rc = { .x1 = item->packed_w, .y1 = item->packed_h };
+        if (item->packed_id && entry->packed_id) {
+            if (item->packed_id == entry->packed_id) {
+                rc = (pl_rect3d){0};
+            } else if (item->packed_prev_id == entry->packed_id) {
+                struct mp_rect d = item->packed_dirty;
+                rc = (pl_rect3d){ .x0 = d.x0, .y0 = d.y0,
+                                  .x1 = d.x1, .y1 = d.y1 };
+            }
+        }
+        entry->packed_id = 0;
+        if (rc.x1 > rc.x0 && rc.y1 > rc.y0) {
+            ok = pl_tex_upload(p->gpu, &(struct pl_tex_transfer_params) {
+                .tex        = entry->tex,
+                .rc         = rc,
+                .stride_w   = item->packed->stride[0] / tex_fmt->texel_size,
+                .ptr        = item->packed->planes[0] +
+                              rc.y0 * item->packed->stride[0] +
+                              rc.x0 * tex_fmt->texel_size,
+            });
+        }
         if (!ok) {
             MP_ERR(vo, "Failed uploading OSD texture!\n");
             break;
         }
+        entry->packed_id = item->packed_id;
 
         entry->num_parts = 0;
         for (int i = 0; i < item->num_parts; i++) {
@@ -321,6 +383,7 @@ struct frame_priv {
     struct osd_state subs;
     uint64_t osd_sync;
     struct ra_hwdec *hwdec;
+    struct prefetch *pf;
 };
 
 static int plane_data_from_imgfmt(struct pl_plane_data out_data[4],
@@ -552,6 +615,157 @@ static void hwdec_release(pl_gpu gpu, struct pl_frame *frame)
     ra_hwdec_mapper_unmap(p->hwdec_mapper);
 }
 
+static bool upload_planes(struct priv *p, struct mp_image *mpi, pl_tex *tex,
+                          struct pl_plane planes[4], int *num_planes,
+                          struct pl_bit_encoding *bits)
+{
+    pl_gpu gpu = p->gpu;
+    struct pl_plane_data data[4] = {0};
+    *num_planes = plane_data_from_imgfmt(data, bits, mpi->imgfmt);
+    for (int n = 0; n < *num_planes; n++) {
+        struct pl_plane *plane = &planes[n];
+        data[n].width = mp_image_plane_w(mpi, n);
+        data[n].height = mp_image_plane_h(mpi, n);
+        if (mpi->stride[n] < 0) {
+            data[n].pixels = mpi->planes[n] + (data[n].height - 1) * mpi->stride[n];
+            data[n].row_stride = -mpi->stride[n];
+            plane->flipped = true;
+        } else {
+            data[n].pixels = mpi->planes[n];
+            data[n].row_stride = mpi->stride[n];
+        }
+
+        pl_buf buf = get_dr_buf(p, data[n].pixels);
+        if (buf) {
+            data[n].buf = buf;
+            data[n].buf_offset = (uint8_t *) data[n].pixels - buf->data;
+            data[n].pixels = NULL;
+        } else if (gpu->limits.callbacks) {
+            data[n].callback = talloc_free;
+            data[n].priv = mp_image_new_ref(mpi);
+        }
+
+        if (!pl_upload_plane(gpu, plane, &tex[n], &data[n])) {
+            MP_ERR(p, "Failed uploading frame!\n");
+            talloc_free(data[n].priv);
+            return false;
+        }
+    }
+    return true;
+}
+
+static void *upload_thread(void *ctx)
+{
+    struct priv *p = ctx;
+    mpthread_set_name("vo-upload");
+
+    pthread_mutex_lock(&p->upload_lock);
+    while (!p->upload_terminate) {
+        struct prefetch *pf = NULL;
+        for (int n = 0; n < p->num_prefetch; n++) {
+            if (!p->prefetch[n]->done && !p->prefetch[n]->busy) {
+                pf = p->prefetch[n];
+                break;
+            }
+        }
+        if (!pf) {
+            pthread_cond_wait(&p->upload_wakeup, &p->upload_lock);
+            continue;
+        }
+        pf->busy = true;
+        pthread_mutex_unlock(&p->upload_lock);
+
+        memset(pf->planes, 0, sizeof(pf->planes));
+        bool ok = upload_planes(p, pf->mpi, pf->tex, pf->planes,
+                                &pf->num_planes, &pf->bits);
+
+        pthread_mutex_lock(&p->upload_lock);
+        pf->ok = ok;
+        pf->done = true;
+        pf->busy = false;
+        pthread_cond_broadcast(&p->upload_wakeup);
+    }
+    pthread_mutex_unlock(&p->upload_lock);
+    return NULL;
+}
+
+// Wait until pf is uploaded. Returns success.
+static bool wait_prefetch(struct priv *p, struct prefetch *pf)
+{
+    pthread_mutex_lock(&p->upload_lock);
+    while (!pf->done)
+        pthread_cond_wait(&p->upload_wakeup, &p->upload_lock);
+    pthread_mutex_unlock(&p->upload_lock);
+    return pf->ok;
+}
+
+// Put pf on the free list. Must be called with upload_lock held.
+static void recycle_prefetch_locked(struct priv *p, struct prefetch *pf)
+{
+    while (pf->busy)
+        pthread_cond_wait(&p->upload_wakeup, &p->upload_lock);
+    TA_FREEP(&pf->mpi);
+    MP_TARRAY_APPEND(p, p->free_prefetch, p->num_free_prefetch, pf);
+}
+
+static void release_prefetch(struct priv *p, struct prefetch *pf)
+{
+    if (!pf)
+        return;
+    pthread_mutex_lock(&p->upload_lock);
+    recycle_prefetch_locked(p, pf);
+    pthread_mutex_unlock(&p->upload_lock);
+}
+
+// Return the prefetched upload for the given frame, if any. The caller owns
+// it (see release_prefetch()). Unclaimed older frames are dropped.
+static struct prefetch *claim_prefetch(struct priv *p, uint64_t id)
+{
+    struct prefetch *res = NULL;
+    pthread_mutex_lock(&p->upload_lock);
+    while (p->num_prefetch && p->prefetch[0]->id <= id) {
+        struct prefetch *pf = p->prefetch[0];
+        MP_TARRAY_REMOVE_AT(p->prefetch, p->num_prefetch, 0);
+        // If the upload didn't start yet, it's faster to do it directly.
+        if (pf->id == id && (pf->busy || pf->done)) {
+            res = pf;
+            break;
+        }
+        recycle_prefetch_locked(p, pf);
+    }
+    pthread_mutex_unlock(&p->upload_lock);
+    return res;
+}
+
+static void queue_frame(struct vo *vo, struct vo_frame *frame)
+{
+    struct priv *p = vo->priv;
+    if (!p->upload_thread_valid)
+        return;
+
+    pthread_mutex_lock(&p->upload_lock);
+    for (int n = 0; n < frame->num_frames; n++) {
+        uint64_t id = frame->frame_id + n;
+        struct mp_image *mpi = frame->frames[n];
+        if (id <= p->last_prefetch_id || (mpi->fmt.flags & MP_IMGFLAG_HWACCEL))
+            continue;
+
+        struct prefetch *pf;
+        if (p->num_free_prefetch) {
+            pf = p->free_prefetch[--p->num_free_prefetch];
+        } else {
+            pf = talloc_zero(p, struct prefetch);
+        }
+        pf->id = id;
+        pf->mpi = mp_image_new_ref(mpi);
+        pf->done = pf->ok = false;
+        MP_TARRAY_APPEND(p, p->prefetch, p->num_prefetch, pf);
+        p->last_prefetch_id = id;
+    }
+    pthread_cond_broadcast(&p->upload_wakeup);
+    pthread_mutex_unlock(&p->upload_lock);
+}
+
 static bool map_frame(pl_gpu gpu, pl_tex *tex, const struct pl_source_frame *src,
                       struct pl_frame *frame)
 {
@@ -631,39 +845,21 @@ static bool map_frame(pl_gpu gpu, pl_tex *tex, const struct pl_source_frame *src
             }
         }
 
-    } else { // swdec
+    } else if (fp->pf && wait_prefetch(p, fp->pf)) { // swdec, uploaded
 
-        struct pl_plane_data data[4] = {0};
-        frame->num_planes = plane_data_from_imgfmt(data, &frame->repr.bits, mpi->imgfmt);
-        for (int n = 0; n < frame->num_planes; n++) {
-            struct pl_plane *plane = &frame->planes[n];
-            data[n].width = mp_image_plane_w(mpi, n);
-            data[n].height = mp_image_plane_h(mpi, n);
-            if (mpi->stride[n] < 0) {
-                data[n].pixels = mpi->planes[n] + (data[n].height - 1) * mpi->stride[n];
-                data[n].row_stride = -mpi->stride[n];
-                plane->flipped = true;
-            } else {
-                data[n].pixels = mpi->planes[n];
-                data[n].row_stride = mpi->stride[n];
-            }
+        frame->num_planes = fp->pf->num_planes;
+        frame->repr.bits = fp->pf->bits;
+        for (int n = 0; n < frame->num_planes; n++)
+            frame->planes[n] = fp->pf->planes[n];
 
-            pl_buf buf = get_dr_buf(p, data[n].pixels);
-            if (buf) {
-                data[n].buf = buf;
-                data[n].buf_offset = (uint8_t *) data[n].pixels - buf->data;
-                data[n].pixels = NULL;
-            } else if (gpu->limits.callbacks) {
-                data[n].callback = talloc_free;
-                data[n].priv = mp_image_new_ref(mpi);
-            }
+    } else { // swdec
 
-            if (!pl_upload_plane(gpu, plane, &tex[n], &data[n])) {
-                MP_ERR(vo, "Failed uploading frame!\n");
-                talloc_free(data[n].priv);
-                talloc_free(mpi);
-                return false;
-            }
+        if (!upload_planes(p, mpi, tex, frame->planes, &frame->num_planes,
+                           &frame->repr.bits))
+        {
+            release_prefetch(p, fp->pf);
+            talloc_free(mpi);
+            return false;
         }
 
     }
@@ -717,12 +913,15 @@ static void unmap_frame(pl_gpu gpu, struct pl_frame *frame,
         if (tex)
             MP_TARRAY_APPEND(p, p->sub_tex, p->num_sub_tex, tex);
     }
+    release_prefetch(p, fp->pf);
     talloc_free(mpi);
 }
 
 static void discard_frame(const struct pl_source_frame *src)
 {
     struct mp_image *mpi = src->frame_data;
+    struct frame_priv *fp = mpi->priv;
+    release_prefetch(fp->vo->priv, fp->pf);
     talloc_free(mpi);
 }
 
@@ -856,6 +1055,8 @@ static void draw_frame(struct vo *vo, struct vo_frame *frame)
         struct frame_priv *fp = talloc_zero(mpi, struct frame_priv);
         mpi->priv = fp;
         fp->vo = vo;
+        if (p->upload_thread_valid)
+            fp->pf = claim_prefetch(p, id);
 
         pl_queue_push(p->queue, &(struct pl_source_frame) {
             .pts = mpi->pts,
@@ -1289,20 +1490,77 @@ static void wait_events(struct vo *vo, int64_t until_time_us)
 static char *get_cache_file(struct priv *p)
 {
     struct gl_video_opts *opts = p->opts_cache->opts;
-    if (!opts->shader_cache_dir || !opts->shader_cache_dir[0])
-        return NULL;
+    return gl_sc_cache_path(NULL, p->global, opts->shader_cache_dir,
+                            "libplacebo.cache");
+}
 
-    char *dir = mp_get_user_path(NULL, p->global, opts->shader_cache_dir);
-    char *file = mp_path_join(NULL, dir, "libplacebo.cache");
-    mp_mkdirp(dir);
-    talloc_free(dir);
-    return file;
+static void save_cache(struct priv *p)
+{
+    struct gl_video_opts *opts = p->opts_cache->opts;
+    char *cache_file = get_cache_file(p);
+    if (cache_file) {
+        size_t size = pl_renderer_save(p->rr, NULL);
+        uint8_t *buf = talloc_size(NULL, size);
+        pl_renderer_save(p->rr, buf);
+
+        // Nothing new was compiled: avoid rewriting the file on every exit.
+        if (bstr_equals((bstr){buf, size}, p->pl_cache)) {
+            MP_VERBOSE(p, "libplacebo cache unchanged (%zu bytes).\n", size);
+            gl_sc_touch_cache_file(cache_file);
+        } else {
+            MP_VERBOSE(p, "Saving libplacebo cache (%zu bytes, was %zu).\n",
+                       size, p->pl_cache.len);
+            FILE *cache = fopen(cache_file, "wb");
+            if (cache) {
+                fwrite(buf, size, 1, cache);
+                fclose(cache);
+            }
+        }
+        talloc_free(buf);
+        talloc_free(cache_file);
+
+        char *dir = mp_get_user_path(NULL, p->global, opts->shader_cache_dir);
+        gl_sc_trim_cache_dir(p->log, dir, opts->shader_cache_size);
+        talloc_free(dir);
+    }
+
+#ifdef PL_HAVE_LCMS
+    if (p->icc_cache_hits || p->icc_cache_misses) {
+        MP_VERBOSE(p, "ICC cache: %d hits, %d misses.\n",
+                   p->icc_cache_hits, p->icc_cache_misses);
+    }
+    const struct mp_icc_opts *icc_opts = opts->icc_opts;
+    if (icc_opts && icc_opts->cache_dir && icc_opts->cache_dir[0]) {
+        char *dir = mp_get_user_path(NULL, p->global, icc_opts->cache_dir);
+        gl_sc_trim_cache_dir(p->log, dir, icc_opts->cache_size);
+        talloc_free(dir);
+    }
+#endif
 }
 
 static void uninit(struct vo *vo)
 {
     struct priv *p = vo->priv;
     pl_queue_destroy(&p->queue); // destroy this first
+
+    if (p->upload_thread_valid) {
+        pthread_mutex_lock(&p->upload_lock);
+        p->upload_terminate = true;
+        pthread_cond_broadcast(&p->upload_wakeup);
+        pthread_mutex_unlock(&p->upload_lock);
+        pthread_join(p->upload_thread, NULL);
+        p->upload_thread_valid = false;
+    }
+    for (int n = 0; n < p->num_prefetch; n++)
+        MP_TARRAY_APPEND(p, p->free_prefetch, p->num_free_prefetch, p->prefetch[n]);
+    p->num_prefetch = 0;
+    for (int n = 0; n < p->num_free_prefetch; n++) {
+        struct prefetch *pf = p->free_prefetch[n];
+        for (int i = 0; i < MP_ARRAY_SIZE(pf->tex); i++)
+            pl_tex_destroy(p->gpu, &pf->tex[i]);
+        talloc_free(pf->mpi);
+    }
+    p->num_free_prefetch = 0;
     for (int i = 0; i < MP_ARRAY_SIZE(p->osd_state.entries); i++)
         pl_tex_destroy(p->gpu, &p->osd_state.entries[i].tex);
     for (int i = 0; i < p->num_sub_tex; i++)
@@ -1319,20 +1577,11 @@ static void uninit(struct vo *vo)
 
     assert(p->num_dr_buffers == 0);
     pthread_mutex_destroy(&p->dr_lock);
+    pthread_mutex_destroy(&p->upload_lock);
+    pthread_cond_destroy(&p->upload_wakeup);
 
-    char *cache_file = get_cache_file(p);
-    if (cache_file) {
-        FILE *cache = fopen(cache_file, "wb");
-        if (cache) {
-            size_t size = pl_renderer_save(p->rr, NULL);
-            uint8_t *buf = talloc_size(NULL, size);
-            pl_renderer_save(p->rr, buf);
-            fwrite(buf, size, 1, cache);
-            talloc_free(buf);
-            fclose(cache);
-        }
-        talloc_free(cache_file);
-    }
+    if (p->rr)
+        save_cache(p);
 
     pl_renderer_destroy(&p->rr);
 
@@ -1375,6 +1624,13 @@ static int preinit(struct vo *vo)
     hwdec_devices_set_loader(vo->hwdec_devs, load_hwdec_api, vo);
     ra_hwdec_ctx_init(&p->hwdec_ctx, vo->hwdec_devs, gl_opts->hwdec_interop, false);
     pthread_mutex_init(&p->dr_lock, NULL);
+    pthread_mutex_init(&p->upload_lock, NULL);
+    pthread_cond_init(&p->upload_wakeup, NULL);
+
+    if (p->gpu->limits.thread_safe) {
+        p->upload_thread_valid =
+            !pthread_create(&p->upload_thread, NULL, upload_thread, p);
+    }
 
     p->rr = pl_renderer_create(p->pllog, p->gpu);
     p->queue = pl_queue_create(p->gpu);
@@ -1382,13 +1638,18 @@ static int preinit(struct vo *vo)
     p->osd_fmt[SUBBITMAP_BGRA] = pl_find_named_fmt(p->gpu, "bgra8");
     p->osd_sync = 1;
 
+    p->stats = stats_ctx_create(p, vo->global, "shader-cache");
+
     char *cache_file = get_cache_file(p);
     if (cache_file) {
         if (stat(cache_file, &(struct stat){0}) == 0) {
-            bstr c = stream_read_file(cache_file, p, vo->global, 1000000000);
-            pl_renderer_load(p->rr, c.start);
-            talloc_free(c.start);
+            p->pl_cache = stream_read_file(cache_file, p, vo->global, 1000000000);
+            if (p->pl_cache.len)
+                pl_renderer_load(p->rr, p->pl_cache.start);
+            MP_VERBOSE(p, "Loaded libplacebo cache (%zu bytes).\n",
+                       p->pl_cache.len);
         }
+        stats_size_value(p->stats, "libplacebo-cache", p->pl_cache.len);
         talloc_free(cache_file);
     }
 
@@ -1511,6 +1772,68 @@ static const struct pl_hook *load_hook(struct priv *p, const char *path)
     return hook;
 }
 
+#ifdef PL_HAVE_LCMS
+
+static char *get_icc_cache_file(struct priv *p, uint64_t sig)
+{
+    const struct gl_video_opts *opts = p->opts_cache->opts;
+    if (!opts->icc_opts)
+        return NULL;
+    char name[16 + 1];
+    snprintf(name, sizeof(name), "%016"PRIX64, sig);
+    return gl_sc_cache_path(NULL, p->global, opts->icc_opts->cache_dir, name);
+}
+
+static void icc_save(void *priv, uint64_t sig, const uint8_t *cache,
+                     size_t size)
+{
+    struct priv *p = priv;
+    char *cache_file = get_icc_cache_file(p, sig);
+    if (!cache_file)
+        return;
+    MP_VERBOSE(p, "Saving 3D LUT cache in file '%s'.\n", cache_file);
+    FILE *f = fopen(cache_file, "wb");
+    if (f) {
+        fwrite(cache, size, 1, f);
+        fclose(f);
+    }
+    talloc_free(cache_file);
+}
+
+static bool icc_load(void *priv, uint64_t sig, uint8_t *cache, size_t size)
+{
+    struct priv *p = priv;
+    char *cache_file = get_icc_cache_file(p, sig);
+    if (!cache_file)
+        return false;
+
+    bool ok = false;
+    if (stat(cache_file, &(struct stat){0}) == 0) {
+        MP_VERBOSE(p, "Opening 3D LUT cache in file '%s'.\n", cache_file);
+        bstr data = stream_read_file(cache_file, NULL, p->global, 1000000000);
+        if (data.len == size) {
+            memcpy(cache, data.start, size);
+            gl_sc_touch_cache_file(cache_file);
+            ok = true;
+        } else if (data.len) {
+            MP_WARN(p, "3D LUT cache invalid!\n");
+        }
+        talloc_free(data.start);
+    }
+    talloc_free(cache_file);
+
+    if (ok) {
+        p->icc_cache_hits++;
+    } else {
+        p->icc_cache_misses++;
+    }
+    stats_value(p->stats, "icc-hits", p->icc_cache_hits);
+    stats_value(p->stats, "icc-misses", p->icc_cache_misses);
+    return ok;
+}
+
+#endif // PL_HAVE_LCMS
+
 static void update_icc_opts(struct priv *p, const struct mp_icc_opts *opts)
 {
     if (!opts)
@@ -1532,6 +1855,9 @@ static void update_icc_opts(struct priv *p, const struct mp_icc_opts *opts)
     p->icc.size_r = s_r;
     p->icc.size_g = s_g;
     p->icc.size_b = s_b;
+    p->icc.cache_priv = p;
+    p->icc.cache_save = icc_save;
+    p->icc.cache_load = icc_load;
 
     if (!opts->profile || !opts->profile[0]) {
         // No profile enabled, un-load any existing profiles
@@ -1734,6 +2060,7 @@ const struct vo_driver video_out_gpu_next = {
     .control = control,
     .get_image_ts = get_image,
     .draw_frame = draw_frame,
+    .queue_frame = queue_frame,
     .flip_page = flip_page,
     .get_vsync = get_vsync,
     .wait_events = wait_events,
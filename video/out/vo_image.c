@@ -159,6 +159,7 @@ const struct vo_driver video_out_image =
     .description = "Write video frames to image files",
     .name = "image",
     .untimed = true,
+    .headless = true,
     .priv_size = sizeof(struct priv),
     .preinit = preinit,
     .query_format = query_format,
@@ -23,10 +23,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <libavutil/hwcontext.h>
+
 #include "config.h"
 #include "common/common.h"
 #include "options/options.h"
 #include "video/fmt-conversion.h"
+#include "video/hwdec.h"
 #include "video/mp_image.h"
 #include "mpv_talloc.h"
 #include "vo.h"
@@ -38,9 +41,55 @@
 struct priv {
     struct encoder_context *enc;
 
+    // Device for encoders taking hw frames (e.g. h264_vaapi, hevc_nvenc),
+    // exported to the decoder and filters, so that frames decoded with
+    // hwdec can be passed to the encoder without a download/upload.
+    struct mp_hwdec_ctx hwctx;
+
     bool shutdown;
 };
 
+// Create a device for the encoder's hw frames input, if it has one.
+static void init_hwdec(struct vo *vo)
+{
+    struct priv *vc = vo->priv;
+    const AVCodec *codec = vc->enc->encoder->codec;
+
+    const AVCodecHWConfig *cfg = NULL;
+    for (int n = 0; ; n++) {
+        cfg = avcodec_get_hw_config(codec, n);
+        if (!cfg || (cfg->methods & AV_CODEC_HW_CONFIG_METHOD_HW_FRAMES_CTX))
+            break;
+    }
+    if (!cfg)
+        return;
+
+    AVBufferRef *ref = NULL;
+    const struct hwcontext_fns *fns = hwdec_get_hwcontext_fns(cfg->device_type);
+    if (fns && fns->create_dev) {
+        ref = fns->create_dev(vo->global, vo->log,
+                              &(struct hwcontext_create_dev_params){0});
+    } else {
+        av_hwdevice_ctx_create(&ref, cfg->device_type, NULL, NULL, 0);
+    }
+    if (!ref) {
+        MP_VERBOSE(vo, "Could not create %s device for the encoder; hw frames "
+                   "will be downloaded.\n",
+                   av_hwdevice_get_type_name(cfg->device_type));
+        return;
+    }
+
+    vc->hwctx = (struct mp_hwdec_ctx){
+        .driver_name = av_hwdevice_get_type_name(cfg->device_type),
+        .av_device_ref = ref,
+        .hw_imgfmt = pixfmt2imgfmt(cfg->pix_fmt),
+    };
+    vo->hwdec_devs = hwdec_devices_create();
+    hwdec_devices_add(vo->hwdec_devs, &vc->hwctx);
+    MP_VERBOSE(vo, "Accepting %s frames for encoding.\n",
+               mp_imgfmt_to_name(vc->hwctx.hw_imgfmt));
+}
+
 static int preinit(struct vo *vo)
 {
     struct priv *vc = vo->priv;
@@ -48,6 +97,7 @@ static int preinit(struct vo *vo)
     if (!vc->enc)
         return -1;
     talloc_steal(vc, vc->enc);
+    init_hwdec(vo);
     return 0;
 }
 
@@ -58,6 +108,13 @@ static void uninit(struct vo *vo)
 
     if (!vc->shutdown)
         encoder_encode(enc, NULL); // finish encoding
+
+    if (vo->hwdec_devs) {
+        hwdec_devices_remove(vo->hwdec_devs, &vc->hwctx);
+        hwdec_devices_destroy(vo->hwdec_devs);
+        vo->hwdec_devs = NULL;
+    }
+    av_buffer_unref(&vc->hwctx.av_device_ref);
 }
 
 static void on_ready(void *ptr)
@@ -113,6 +170,16 @@ static int reconfig2(struct vo *vo, struct mp_image *img)
     encoder->width = width;
     encoder->height = height;
     encoder->pix_fmt = pix_fmt;
+    if (params->hw_subfmt) {
+        if (!img->hwctx) {
+            MP_FATAL(vo, "Hardware frame without frames context.\n");
+            goto error;
+        }
+        encoder->hw_frames_ctx = av_buffer_ref(img->hwctx);
+        if (!encoder->hw_frames_ctx)
+            goto error;
+        encoder->sw_pix_fmt = imgfmt2pixfmt(params->hw_subfmt);
+    }
     encoder->colorspace = mp_csp_to_avcol_spc(params->color.space);
     encoder->color_range = mp_csp_levels_to_avcol_range(params->color.levels);
 
@@ -148,6 +215,10 @@ static int query_format(struct vo *vo, int format)
 {
     struct priv *vc = vo->priv;
 
+    // Only accept frames on the device we created (see init_hwdec()).
+    if (IMGFMT_IS_HWACCEL(format) && format != vc->hwctx.hw_imgfmt)
+        return 0;
+
     enum AVPixelFormat pix_fmt = imgfmt2pixfmt(format);
     const enum AVPixelFormat *p = vc->enc->encoder->codec->pix_fmts;
 
@@ -175,8 +246,12 @@ static void draw_frame(struct vo *vo, struct vo_frame *voframe)
 
     struct mp_image *mpi = voframe->frames[0];
 
-    struct mp_osd_res dim = osd_res_from_image_params(vo->params);
-    osd_draw_on_image(vo->osd, dim, mpi->pts, OSD_DRAW_SUB_ONLY, mpi);
+    // Subtitles can't be burned into hw frames; use a copy hwdec mode or
+    // hwdownload in the filter chain for that.
+    if (!mpi->hwctx) {
+        struct mp_osd_res dim = osd_res_from_image_params(vo->params);
+        osd_draw_on_image(vo->osd, dim, mpi->pts, OSD_DRAW_SUB_ONLY, mpi);
+    }
 
     if (vc->shutdown)
         return;
@@ -242,6 +317,7 @@ const struct vo_driver video_out_lavc = {
     .name = "lavc",
     .initially_blocked = true,
     .untimed = true,
+    .headless = true,
     .priv_size = sizeof(struct priv),
     .preinit = preinit,
     .query_format = query_format,
@@ -70,8 +70,14 @@ struct priv {
     sixel_dither_t *dither;
     sixel_dither_t *testdither;
     uint8_t        *buffer;
+    uint8_t        *prev_buffer;  // last encoded image
+    bool            prev_valid;
     bool            skip_frame_draw;
 
+    // sixel_encode() output, written to the terminal at once
+    char           *out;
+    size_t          out_len;
+
     int left, top;  // image origin cell (1 based)
     int width, height;  // actual image px size - always reflects dst_rect.
     int num_cols, num_rows;  // terminal size in cells
@@ -124,6 +130,9 @@ static void dealloc_dithers_and_buffers(struct vo* vo)
         priv->buffer = NULL;
     }
 
+    TA_FREEP(&priv->prev_buffer);
+    priv->prev_valid = false;
+
     if (priv->frame) {
         talloc_free(priv->frame);
         priv->frame = NULL;
@@ -322,6 +331,8 @@ static int update_sixel_swscaler(struct vo *vo, struct mp_image_params *params)
 
     priv->buffer =
         talloc_array(NULL, uint8_t, depth * priv->width * priv->height);
+    priv->prev_buffer =
+        talloc_array(NULL, uint8_t, depth * priv->width * priv->height);
 
     return 0;
 }
@@ -337,6 +348,7 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
     }
 
     printf(ESC_CLEAR_SCREEN);
+    priv->prev_valid = false;
     vo->want_redraw = true;
 
     return ret;
@@ -366,6 +378,7 @@ static void draw_frame(struct vo *vo, struct vo_frame *frame)
         update_sixel_swscaler(vo, vo->params);
 
         printf(ESC_CLEAR_SCREEN);
+        priv->prev_valid = false;
         resized = true;
     }
 
@@ -403,6 +416,16 @@ static void draw_frame(struct vo *vo, struct vo_frame *frame)
     memcpy_pic(priv->buffer, priv->frame->planes[0], priv->width * depth,
                priv->height, priv->width * depth, priv->frame->stride[0]);
 
+    // Encoding is by far the most expensive part, so skip it if the image on
+    // the terminal is the same anyway (static content, unchanged OSD).
+    if (priv->prev_valid && !memcmp(priv->buffer, priv->prev_buffer,
+                                    depth * priv->width * priv->height))
+    {
+        priv->skip_frame_draw = true;
+        talloc_free(mpi);
+        return;
+    }
+
     // Even if either of these prepare palette functions fail, on re-running them
     // they should try to re-initialize the dithers, so it shouldn't dereference
     // any NULL pointers. flip_page also has a check to make sure dither is not
@@ -422,9 +445,14 @@ static void draw_frame(struct vo *vo, struct vo_frame *frame)
         talloc_free(mpi);
 }
 
-static int sixel_write(char *data, int size, void *priv)
+static int sixel_write(char *data, int size, void *ctx)
 {
-    return fwrite(data, 1, size, (FILE *)priv);
+    struct priv *priv = ctx;
+    // The buffer is kept across frames, so this rarely reallocates.
+    MP_TARRAY_GROW(priv, priv->out, priv->out_len + size);
+    memcpy(priv->out + priv->out_len, data, size);
+    priv->out_len += size;
+    return size;
 }
 
 static void flip_page(struct vo *vo)
@@ -441,25 +469,30 @@ static void flip_page(struct vo *vo)
     if (priv->buffer == NULL || priv->dither == NULL)
         return;
 
-    // Go to the offset row and column, then display the image
-    printf(ESC_GOTOXY, priv->top, priv->left);
+    priv->out_len = 0;
     sixel_encode(priv->buffer, priv->width, priv->height,
                  depth, priv->dither, priv->output);
+
+    // Go to the offset row and column, then display the image
+    printf(ESC_GOTOXY, priv->top, priv->left);
+    fwrite(priv->out, 1, priv->out_len, stdout);
     fflush(stdout);
+
+    MPSWAP(uint8_t *, priv->buffer, priv->prev_buffer);
+    priv->prev_valid = true;
 }
 
 static int preinit(struct vo *vo)
 {
     struct priv *priv = vo->priv;
     SIXELSTATUS status = SIXEL_FALSE;
-    FILE* sixel_output_file = stdout;
 
     // Parse opts set by CLI or conf
     priv->sws = mp_sws_alloc(vo);
     priv->sws->log = vo->log;
     mp_sws_enable_cmdline_opts(priv->sws, vo->global);
 
-    status = sixel_output_new(&priv->output, sixel_write, sixel_output_file, NULL);
+    status = sixel_output_new(&priv->output, sixel_write, priv, NULL);
     if (SIXEL_FAILED(status)) {
         MP_ERR(vo, "preinit: Failed to create output file: %s\n",
                sixel_helper_format_error(status));
@@ -23,10 +23,13 @@
 #include <sys/ioctl.h>
 #endif
 
+#include <libavutil/cpu.h>
 #include <libswscale/swscale.h>
 
 #include "options/m_config.h"
 #include "config.h"
+#include "misc/thread_pool.h"
+#include "misc/thread_tools.h"
 #include "osdep/terminal.h"
 #include "osdep/io.h"
 #include "vo.h"
@@ -50,6 +53,18 @@
 #define DEFAULT_WIDTH 80
 #define DEFAULT_HEIGHT 25
 
+// Upper bounds for the bytes written per cell: 2 true color sequences and the
+// UTF-8 half block, and a cursor movement in front of it.
+#define MAX_CELL_BYTES 43
+#define MAX_GOTO_BYTES 16
+
+// Maximum number of threads (including the VO thread) used to build rows.
+#define MAX_SLICES 16
+
+// Rewrite all cells after this many frames, in case other terminal output
+// overwrote parts of the image.
+#define FULL_REFRESH_FRAMES 120
+
 struct vo_tct_opts {
     int algo;
     int width;   // 0 -> default
@@ -79,16 +94,36 @@ struct lut_item {
     int width;
 };
 
+struct tct_slice {
+    struct priv *p;
+    int y0, y1;             // range of terminal rows
+    struct mp_waiter waiter;
+};
+
 struct priv {
     struct vo_tct_opts *opts;
     size_t buffer_size;
     int swidth;
     int sheight;
+    int tx, ty;                     // terminal position of the image
     struct mp_image *frame;
+    struct mp_image *prev_frame;    // what's on the terminal now
+    bool prev_valid;
+    int prev_age;                   // frames since prev_valid was set
+    bool frame_drawn;               // frame was updated since the last flip
     struct mp_rect src;
     struct mp_rect dst;
     struct mp_sws_context *sws;
     struct lut_item lut[256];
+
+    // Escape sequences for each terminal row, row_cap bytes apart.
+    char *rows;
+    int *row_len;
+    size_t row_cap;
+
+    struct mp_thread_pool *pool;    // MAX_SLICES - 1 threads at most
+    struct tct_slice slices[MAX_SLICES];
+    int num_slices;
 };
 
 // Convert RGB24 to xterm-256 8-bit value
@@ -120,96 +155,145 @@ static int rgb_to_x256(uint8_t r, uint8_t g, uint8_t b)
     return color_err <= gray_err ? 16 + color_index() : 232 + gray_index;
 }
 
-static void print_seq3(struct lut_item *lut, const char* prefix,
-                       uint8_t r, uint8_t g, uint8_t b)
+static char *put_str(char *dst, const char *s, int len)
 {
-// The fwrite implementation is about 25% faster than the printf code
-// (even if we use *.s with the lut values), however,
-// on windows we need to use printf in order to translate escape sequences and
-// UTF8 output for the console.
-#ifndef _WIN32
-    fputs(prefix, stdout);
-    fwrite(lut[r].str, lut[r].width, 1, stdout);
-    fwrite(lut[g].str, lut[g].width, 1, stdout);
-    fwrite(lut[b].str, lut[b].width, 1, stdout);
-    fputc('m', stdout);
-#else
-    printf("%s;%d;%d;%dm", prefix, (int)r, (int)g, (int)b);
-#endif
+    memcpy(dst, s, len);
+    return dst + len;
 }
 
-static void print_seq1(struct lut_item *lut, const char* prefix, uint8_t c)
+// Return a value that identifies the color written by put_color().
+static int color_key(bool term256, const uint8_t *bgr)
 {
-#ifndef _WIN32
-    fputs(prefix, stdout);
-    fwrite(lut[c].str, lut[c].width, 1, stdout);
-    fputc('m', stdout);
-#else
-    printf("%s;%dm", prefix, (int)c);
-#endif
+    if (term256)
+        return rgb_to_x256(bgr[2], bgr[1], bgr[0]);
+    return (bgr[2] << 16) | (bgr[1] << 8) | bgr[0];
 }
 
-
-static void write_plain(
-    const int dwidth, const int dheight,
-    const int swidth, const int sheight,
-    const unsigned char *source, const int source_stride,
-    bool term256, struct lut_item *lut)
+static char *put_color(char *dst, const struct lut_item *lut, bool term256,
+                       const char *prefix, int key)
 {
-    assert(source);
-    const int tx = (dwidth - swidth) / 2;
-    const int ty = (dheight - sheight) / 2;
-    for (int y = 0; y < sheight; y++) {
-        const unsigned char *row = source + y * source_stride;
-        printf(ESC_GOTOXY, ty + y, tx);
-        for (int x = 0; x < swidth; x++) {
-            unsigned char b = *row++;
-            unsigned char g = *row++;
-            unsigned char r = *row++;
-            if (term256) {
-                print_seq1(lut, ESC_COLOR256_BG, rgb_to_x256(r, g, b));
-            } else {
-                print_seq3(lut, ESC_COLOR_BG, r, g, b);
-            }
-            printf(" ");
+    dst = put_str(dst, prefix, strlen(prefix));
+    if (term256) {
+        dst = put_str(dst, lut[key].str, lut[key].width);
+    } else {
+        for (int shift = 16; shift >= 0; shift -= 8) {
+            const struct lut_item *c = &lut[(key >> shift) & 0xFF];
+            dst = put_str(dst, c->str, c->width);
         }
-        printf(ESC_CLEAR_COLORS);
     }
-    printf("\n");
+    *dst++ = 'm';
+    return dst;
 }
 
-static void write_half_blocks(
-    const int dwidth, const int dheight,
-    const int swidth, const int sheight,
-    unsigned char *source, int source_stride,
-    bool term256, struct lut_item *lut)
+// Build the escape sequences for terminal row y. Cells which are the same as
+// in prev_frame are skipped with a cursor movement, and colors are only set
+// if they differ from the previous cell.
+static void encode_row(struct priv *p, int y)
 {
-    assert(source);
-    const int tx = (dwidth - swidth) / 2;
-    const int ty = (dheight - sheight) / 2;
-    for (int y = 0; y < sheight * 2; y += 2) {
-        const unsigned char *row_up = source + y * source_stride;
-        const unsigned char *row_down = source + (y + 1) * source_stride;
-        printf(ESC_GOTOXY, ty + y / 2, tx);
-        for (int x = 0; x < swidth; x++) {
-            unsigned char b_up = *row_up++;
-            unsigned char g_up = *row_up++;
-            unsigned char r_up = *row_up++;
-            unsigned char b_down = *row_down++;
-            unsigned char g_down = *row_down++;
-            unsigned char r_down = *row_down++;
-            if (term256) {
-                print_seq1(lut, ESC_COLOR256_BG, rgb_to_x256(r_up, g_up, b_up));
-                print_seq1(lut, ESC_COLOR256_FG, rgb_to_x256(r_down, g_down, b_down));
-            } else {
-                print_seq3(lut, ESC_COLOR_BG, r_up, g_up, b_up);
-                print_seq3(lut, ESC_COLOR_FG, r_down, g_down, b_down);
+    const bool half_blocks = p->opts->algo != ALGO_PLAIN;
+    const bool term256 = p->opts->term256;
+    const int lines = half_blocks ? 2 : 1;
+
+    const int stride = p->frame->stride[0];
+    const uint8_t *cur = p->frame->planes[0] + y * lines * stride;
+    const uint8_t *prev = NULL;
+    if (p->prev_valid)
+        prev = p->prev_frame->planes[0] + y * lines * p->prev_frame->stride[0];
+    const int prev_stride = p->prev_valid ? p->prev_frame->stride[0] : 0;
+
+    char *start = p->rows + y * p->row_cap;
+    char *dst = start;
+    bool need_goto = true;
+    int bg = -1, fg = -1;
+
+    for (int x = 0; x < p->swidth; x++) {
+        const uint8_t *up = cur + x * 3;
+        const uint8_t *down = up + stride;
+        if (prev) {
+            const uint8_t *p_up = prev + x * 3;
+            bool same = !memcmp(up, p_up, 3);
+            if (half_blocks)
+                same &= !memcmp(down, p_up + prev_stride, 3);
+            if (same) {
+                need_goto = true;
+                continue;
             }
-            printf("\xe2\x96\x84");  // UTF8 bytes of U+2584 (lower half block)
         }
-        printf(ESC_CLEAR_COLORS);
+        if (need_goto) {
+            dst += sprintf(dst, ESC_GOTOXY, p->ty + y, p->tx + x);
+            need_goto = false;
+        }
+        int key = color_key(term256, up);
+        if (key != bg) {
+            dst = put_color(dst, p->lut, term256,
+                            term256 ? ESC_COLOR256_BG : ESC_COLOR_BG, key);
+            bg = key;
+        }
+        if (half_blocks) {
+            key = color_key(term256, down);
+            if (key != fg) {
+                dst = put_color(dst, p->lut, term256,
+                                term256 ? ESC_COLOR256_FG : ESC_COLOR_FG, key);
+                fg = key;
+            }
+            // UTF8 bytes of U+2584 (lower half block)
+            dst = put_str(dst, "\xe2\x96\x84", 3);
+        } else {
+            *dst++ = ' ';
+        }
+    }
+
+    if (dst != start)
+        dst = put_str(dst, ESC_CLEAR_COLORS, strlen(ESC_CLEAR_COLORS));
+
+    assert(dst - start <= p->row_cap);
+    p->row_len[y] = dst - start;
+}
+
+static void encode_slice(struct tct_slice *slice)
+{
+    for (int y = slice->y0; y < slice->y1; y++)
+        encode_row(slice->p, y);
+}
+
+static void encode_slice_thread(void *ptr)
+{
+    struct tct_slice *slice = ptr;
+    encode_slice(slice);
+    mp_waiter_wakeup(&slice->waiter, 0);
+}
+
+// Fill p->rows, with the rows distributed over the thread pool.
+static void encode_frame(struct priv *p)
+{
+    int num_slices = MPMAX(MPMIN(p->num_slices, p->sheight), 1);
+    for (int n = 0; n < num_slices; n++) {
+        p->slices[n] = (struct tct_slice){
+            .p = p,
+            .y0 = p->sheight * n / num_slices,
+            .y1 = p->sheight * (n + 1) / num_slices,
+            .waiter = MP_WAITER_INITIALIZER,
+        };
     }
-    printf("\n");
+    for (int n = 1; n < num_slices; n++) {
+        bool r = mp_thread_pool_run(p->pool, encode_slice_thread, &p->slices[n]);
+        // Guaranteed, because the pool has a thread for each slice.
+        assert(r);
+    }
+    encode_slice(&p->slices[0]);
+    for (int n = 1; n < num_slices; n++)
+        mp_waiter_wait(&p->slices[n].waiter);
+}
+
+static void write_buf(const char *buf, int len)
+{
+// On windows we need to use printf in order to translate escape sequences and
+// UTF8 output for the console.
+#ifndef _WIN32
+    fwrite(buf, len, 1, stdout);
+#else
+    printf("%.*s", len, buf);
+#endif
 }
 
 static void get_win_size(struct vo *vo, int *out_width, int *out_height) {
@@ -245,13 +329,27 @@ static int reconfig(struct vo *vo, struct mp_image_params *params)
         .p_h = 1,
     };
 
+    // (The terminal treats column 0 as 1.)
+    p->tx = MPMAX((vo->dwidth - p->swidth) / 2, 1);
+    p->ty = (vo->dheight - p->sheight) / 2;
+
     const int mul = (p->opts->algo == ALGO_PLAIN ? 1 : 2);
-    if (p->frame)
-        talloc_free(p->frame);
+    TA_FREEP(&p->frame);
+    TA_FREEP(&p->prev_frame);
+    p->prev_valid = false;
+    p->frame_drawn = false;
     p->frame = mp_image_alloc(IMGFMT, p->swidth, p->sheight * mul);
-    if (!p->frame)
+    p->prev_frame = mp_image_alloc(IMGFMT, p->swidth, p->sheight * mul);
+    if (!p->frame || !p->prev_frame)
         return -1;
 
+    p->row_cap = (size_t)p->swidth * (MAX_CELL_BYTES + MAX_GOTO_BYTES) +
+                 strlen(ESC_CLEAR_COLORS);
+    talloc_free(p->rows);
+    talloc_free(p->row_len);
+    p->rows = talloc_array(p, char, p->row_cap * MPMAX(p->sheight, 1));
+    p->row_len = talloc_zero_array(p, int, MPMAX(p->sheight, 1));
+
     if (mp_sws_reinit(p->sws) < 0)
         return -1;
 
@@ -267,6 +365,7 @@ static void draw_image(struct vo *vo, mp_image_t *mpi)
     struct mp_image src = *mpi;
     // XXX: pan, crop etc.
     mp_sws_scale(p->sws, p->frame, &src);
+    p->frame_drawn = true;
     talloc_free(mpi);
 }
 
@@ -280,18 +379,33 @@ static void flip_page(struct vo *vo)
     if (vo->dwidth != width || vo->dheight != height)
         reconfig(vo, vo->params);
 
-    if (p->opts->algo == ALGO_PLAIN) {
-        write_plain(
-            vo->dwidth, vo->dheight, p->swidth, p->sheight,
-            p->frame->planes[0], p->frame->stride[0],
-            p->opts->term256, p->lut);
-    } else {
-        write_half_blocks(
-            vo->dwidth, vo->dheight, p->swidth, p->sheight,
-            p->frame->planes[0], p->frame->stride[0],
-            p->opts->term256, p->lut);
+    // Nothing new to show (reconfig() requests a redraw).
+    if (!p->frame_drawn)
+        return;
+
+    if (p->prev_age >= FULL_REFRESH_FRAMES)
+        p->prev_valid = false;
+    if (!p->prev_valid)
+        p->prev_age = 0;
+    p->prev_age++;
+
+    encode_frame(p);
+
+    bool written = false;
+    for (int y = 0; y < p->sheight; y++) {
+        if (p->row_len[y]) {
+            write_buf(p->rows + y * p->row_cap, p->row_len[y]);
+            written = true;
+        }
+    }
+    if (written) {
+        printf("\n");
+        fflush(stdout);
     }
-    fflush(stdout);
+
+    MPSWAP(struct mp_image *, p->frame, p->prev_frame);
+    p->prev_valid = true;
+    p->frame_drawn = false;
 }
 
 static void uninit(struct vo *vo)
@@ -300,8 +414,10 @@ static void uninit(struct vo *vo)
     printf(ESC_CLEAR_SCREEN);
     printf(ESC_GOTOXY, 0, 0);
     struct priv *p = vo->priv;
-    if (p->frame)
-        talloc_free(p->frame);
+    talloc_free(p->frame);
+    talloc_free(p->prev_frame);
+    // Wait for the threads before the rest of priv goes away.
+    TA_FREEP(&p->pool);
 }
 
 static int preinit(struct vo *vo)
@@ -322,6 +438,14 @@ static int preinit(struct vo *vo)
         memcpy(p->lut[i].str, buff, 4); // some strings may not end on a null byte, but that's ok.
     }
 
+    p->num_slices = MPCLAMP(av_cpu_count(), 1, MAX_SLICES);
+    if (p->num_slices > 1) {
+        int threads = p->num_slices - 1;
+        p->pool = mp_thread_pool_create(vo, threads, threads, threads);
+        if (!p->pool)
+            p->num_slices = 1;
+    }
+
     return 0;
 }
 
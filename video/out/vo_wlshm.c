@@ -15,12 +15,14 @@
  * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <time.h>
 #include <unistd.h>
 
+#include <libavutil/buffer.h>
 #include <libswscale/swscale.h>
 
 #include "osdep/endian.h"
@@ -39,14 +41,34 @@ struct buffer {
     struct wl_buffer *buffer;
     struct mp_image mpi;
     struct buffer *next;
+    // For buffers allocated with get_image():
+    bool dr;
+    int dr_w, dr_h;             // size of buffer (created on first use)
+    struct mp_image *dr_image;  // reference while attached to the surface
+    // If clean_id==priv.clean_id, this contains priv.clean, plus OSD in osd_rc.
+    uint64_t clean_id;
+    struct mp_rect osd_rc;
 };
 
 struct priv {
     struct mp_sws_context *sws;
     struct buffer *free_buffers;
+    struct buffer **dr_buffers;
+    int num_dr_buffers;
     struct mp_rect src;
     struct mp_rect dst;
     struct mp_osd_res osd;
+
+    // For redraws of the same frame (e.g. OSD changes while paused), the
+    // scaled video without OSD is kept in clean, so only the area covered by
+    // the old and new OSD needs to be restored and damaged.
+    struct mp_image *clean;
+    uint64_t clean_frame_id;        // frame_id of the contents of clean
+    uint64_t clean_id;              // incremented on each clean update
+    bool clean_valid;
+    uint64_t surface_clean_id;      // same as buffer.clean_id for the surface
+    struct mp_rect surface_rc;
+    struct mp_rect damage;          // area to damage on the next flip
 };
 
 static void buffer_handle_release(void *data, struct wl_buffer *wl_buffer)
@@ -55,6 +77,14 @@ static void buffer_handle_release(void *data, struct wl_buffer *wl_buffer)
     struct vo *vo = buf->vo;
     struct priv *p = vo->priv;
 
+    if (buf->dr) {
+        // Frees buf if the decoder dropped the frame already.
+        struct mp_image *dr_image = buf->dr_image;
+        buf->dr_image = NULL;
+        talloc_free(dr_image);
+        return;
+    }
+
     if (buf->mpi.w == vo->dwidth && buf->mpi.h == vo->dheight) {
         buf->next = p->free_buffers;
         p->free_buffers = buf;
@@ -70,12 +100,16 @@ static const struct wl_buffer_listener buffer_listener = {
 static void buffer_destroy(void *p)
 {
     struct buffer *buf = p;
-    wl_buffer_destroy(buf->buffer);
+    if (buf->buffer)
+        wl_buffer_destroy(buf->buffer);
     wl_shm_pool_destroy(buf->pool);
     munmap(buf->mpi.planes[0], buf->size);
 }
 
-static struct buffer *buffer_create(struct vo *vo, int width, int height)
+// If dr_stride_align is set, create a DR buffer (see get_image()). These get
+// a wl_buffer only on first use, because the displayed size is known later.
+static struct buffer *buffer_create(struct vo *vo, int width, int height,
+                                    int dr_stride_align)
 {
     struct priv *p = vo->priv;
     struct vo_wayland_state *wl = vo->wl;
@@ -84,8 +118,9 @@ static struct buffer *buffer_create(struct vo *vo, int width, int height)
     size_t size;
     uint8_t *data;
     struct buffer *buf;
+    bool dr = dr_stride_align > 0;
 
-    stride = MP_ALIGN_UP(width * 4, 16);
+    stride = MP_ALIGN_UP(width * 4, MPMAX(dr_stride_align, 16));
     size = height * stride;
     fd = vo_wayland_allocate_memfd(vo, size);
     if (fd < 0)
@@ -98,18 +133,25 @@ static struct buffer *buffer_create(struct vo *vo, int width, int height)
         goto error2;
     buf->vo = vo;
     buf->size = size;
-    mp_image_set_params(&buf->mpi, &p->sws->dst);
+    buf->dr = dr;
+    if (dr) {
+        mp_image_setfmt(&buf->mpi, MP_SELECT_LE_BE(IMGFMT_BGR0, IMGFMT_0RGB));
+    } else {
+        mp_image_set_params(&buf->mpi, &p->sws->dst);
+    }
     mp_image_set_size(&buf->mpi, width, height);
     buf->mpi.planes[0] = data;
     buf->mpi.stride[0] = stride;
     buf->pool = wl_shm_create_pool(wl->shm, fd, size);
     if (!buf->pool)
         goto error3;
-    buf->buffer = wl_shm_pool_create_buffer(buf->pool, 0, width, height,
-                                            stride, WL_SHM_FORMAT_XRGB8888);
-    if (!buf->buffer)
-        goto error4;
-    wl_buffer_add_listener(buf->buffer, &buffer_listener, buf);
+    if (!dr) {
+        buf->buffer = wl_shm_pool_create_buffer(buf->pool, 0, width, height,
+                                                stride, WL_SHM_FORMAT_XRGB8888);
+        if (!buf->buffer)
+            goto error4;
+        wl_buffer_add_listener(buf->buffer, &buffer_listener, buf);
+    }
 
     close(fd);
     talloc_set_destructor(buf, buffer_destroy);
@@ -178,6 +220,9 @@ static int resize(struct vo *vo)
         .p_h = 1,
     };
     mp_image_params_guess_csp(&p->sws->dst);
+    TA_FREEP(&p->clean);
+    p->clean_valid = false;
+    p->surface_clean_id = 0;
     while (p->free_buffers) {
         buf = p->free_buffers;
         p->free_buffers = buf->next;
@@ -199,64 +244,221 @@ static int control(struct vo *vo, uint32_t request, void *data)
     return ret;
 }
 
+static void dr_free(void *opaque, uint8_t *data)
+{
+    struct buffer *buf = opaque;
+    struct priv *p = buf->vo->priv;
+
+    for (int n = 0; n < p->num_dr_buffers; n++) {
+        if (p->dr_buffers[n] == buf) {
+            MP_TARRAY_REMOVE_AT(p->dr_buffers, p->num_dr_buffers, n);
+            talloc_free(buf);
+            return;
+        }
+    }
+    // not found - must not happen
+    MP_ASSERT_UNREACHABLE();
+}
+
+static struct mp_image *get_image(struct vo *vo, int imgfmt, int w, int h,
+                                  int stride_align)
+{
+    struct priv *p = vo->priv;
+
+    // Only frames in the wl_shm format can be attached without conversion.
+    if (imgfmt != MP_SELECT_LE_BE(IMGFMT_BGR0, IMGFMT_0RGB))
+        return NULL;
+
+    struct buffer *buf = buffer_create(vo, w, h, stride_align);
+    if (!buf)
+        return NULL;
+
+    struct mp_image *mpi = mp_image_new_dummy_ref(&buf->mpi);
+    mpi->bufs[0] = av_buffer_create(buf->mpi.planes[0], buf->size, dr_free,
+                                    buf, 0);
+    if (!mpi->bufs[0]) {
+        talloc_free(mpi);
+        talloc_free(buf);
+        return NULL;
+    }
+
+    MP_TARRAY_APPEND(p, p->dr_buffers, p->num_dr_buffers, buf);
+    return mpi;
+}
+
+// If src was decoded to a DR buffer and needs no conversion, return a
+// wl_buffer showing it directly.
+static struct buffer *get_dr_buffer(struct vo *vo, struct mp_image *src)
+{
+    struct priv *p = vo->priv;
+
+    if (!src || src->imgfmt != MP_SELECT_LE_BE(IMGFMT_BGR0, IMGFMT_0RGB) ||
+        src->w != vo->dwidth || src->h != vo->dheight)
+        return NULL;
+
+    struct mp_rect full = {0, 0, vo->dwidth, vo->dheight};
+    if (!mp_rect_equals(&p->src, &full) || !mp_rect_equals(&p->dst, &full))
+        return NULL;
+
+    struct buffer *buf = NULL;
+    for (int n = 0; n < p->num_dr_buffers; n++) {
+        struct buffer *cur = p->dr_buffers[n];
+        if (cur->mpi.planes[0] == src->planes[0] &&
+            cur->mpi.stride[0] == src->stride[0])
+        {
+            buf = cur;
+            break;
+        }
+    }
+    // Still attached from a previous frame (e.g. repeated).
+    if (!buf || buf->dr_image)
+        return NULL;
+
+    // The decoder still references the frame, so this draws into a copy if
+    // the OSD is visible. Then use the normal path.
+    struct mp_image *mpi = mp_image_new_ref(src);
+    osd_draw_on_image(vo->osd, p->osd, mpi->pts, 0, mpi);
+    if (mpi->planes[0] != buf->mpi.planes[0]) {
+        talloc_free(mpi);
+        return NULL;
+    }
+
+    if (buf->buffer && (buf->dr_w != src->w || buf->dr_h != src->h)) {
+        wl_buffer_destroy(buf->buffer);
+        buf->buffer = NULL;
+    }
+    if (!buf->buffer) {
+        buf->dr_w = src->w;
+        buf->dr_h = src->h;
+        buf->buffer = wl_shm_pool_create_buffer(buf->pool, 0, src->w, src->h,
+                                                buf->mpi.stride[0],
+                                                WL_SHM_FORMAT_XRGB8888);
+        if (!buf->buffer) {
+            talloc_free(mpi);
+            return NULL;
+        }
+        wl_buffer_add_listener(buf->buffer, &buffer_listener, buf);
+    }
+    // The decoder may not reuse the buffer until the compositor releases it.
+    buf->dr_image = mpi;
+    return buf;
+}
+
+static void render_frame(struct priv *p, struct mp_image *img,
+                         struct mp_image *src)
+{
+    struct mp_image s = *src;
+    struct mp_image dst = *img;
+    struct mp_rect src_rc;
+    struct mp_rect dst_rc;
+    src_rc.x0 = MP_ALIGN_DOWN(p->src.x0, MPMAX(s.fmt.align_x, 4));
+    src_rc.y0 = MP_ALIGN_DOWN(p->src.y0, MPMAX(s.fmt.align_y, 4));
+    src_rc.x1 = p->src.x1 - (p->src.x0 - src_rc.x0);
+    src_rc.y1 = p->src.y1 - (p->src.y0 - src_rc.y0);
+    dst_rc.x0 = MP_ALIGN_DOWN(p->dst.x0, MPMAX(dst.fmt.align_x, 4));
+    dst_rc.y0 = MP_ALIGN_DOWN(p->dst.y0, MPMAX(dst.fmt.align_y, 4));
+    dst_rc.x1 = p->dst.x1 - (p->dst.x0 - dst_rc.x0);
+    dst_rc.y1 = p->dst.y1 - (p->dst.y0 - dst_rc.y0);
+    mp_image_crop_rc(&s, src_rc);
+    mp_image_crop_rc(&dst, dst_rc);
+    mp_sws_scale(p->sws, &dst, &s);
+    if (dst_rc.y0 > 0)
+        mp_image_clear(img, 0, 0, img->w, dst_rc.y0);
+    if (img->h > dst_rc.y1)
+        mp_image_clear(img, 0, dst_rc.y1, img->w, img->h);
+    if (dst_rc.x0 > 0)
+        mp_image_clear(img, 0, dst_rc.y0, dst_rc.x0, dst_rc.y1);
+    if (img->w > dst_rc.x1)
+        mp_image_clear(img, dst_rc.x1, dst_rc.y0, img->w, dst_rc.y1);
+}
+
 static void draw_frame(struct vo *vo, struct vo_frame *frame)
 {
     struct priv *p = vo->priv;
     struct vo_wayland_state *wl = vo->wl;
     struct mp_image *src = frame->current;
     struct buffer *buf;
+    struct mp_rect full = {0, 0, vo->dwidth, vo->dheight};
+
+    p->damage = full;
 
     bool render = vo_wayland_check_visible(vo);
     if (!render)
         return;
 
+    buf = get_dr_buffer(vo, src);
+    if (buf) {
+        wl_surface_attach(wl->surface, buf->buffer, 0, 0);
+        p->clean_valid = false;
+        p->surface_clean_id = 0;
+        return;
+    }
+
     buf = p->free_buffers;
     if (buf) {
         p->free_buffers = buf->next;
     } else {
-        buf = buffer_create(vo, vo->dwidth, vo->dheight);
+        buf = buffer_create(vo, vo->dwidth, vo->dheight, 0);
         if (!buf) {
             wl_surface_attach(wl->surface, NULL, 0, 0);
+            p->surface_clean_id = 0;
             return;
         }
     }
-    if (src) {
-        struct mp_image dst = buf->mpi;
-        struct mp_rect src_rc;
-        struct mp_rect dst_rc;
-        src_rc.x0 = MP_ALIGN_DOWN(p->src.x0, MPMAX(src->fmt.align_x, 4));
-        src_rc.y0 = MP_ALIGN_DOWN(p->src.y0, MPMAX(src->fmt.align_y, 4));
-        src_rc.x1 = p->src.x1 - (p->src.x0 - src_rc.x0);
-        src_rc.y1 = p->src.y1 - (p->src.y0 - src_rc.y0);
-        dst_rc.x0 = MP_ALIGN_DOWN(p->dst.x0, MPMAX(dst.fmt.align_x, 4));
-        dst_rc.y0 = MP_ALIGN_DOWN(p->dst.y0, MPMAX(dst.fmt.align_y, 4));
-        dst_rc.x1 = p->dst.x1 - (p->dst.x0 - dst_rc.x0);
-        dst_rc.y1 = p->dst.y1 - (p->dst.y0 - dst_rc.y0);
-        mp_image_crop_rc(src, src_rc);
-        mp_image_crop_rc(&dst, dst_rc);
-        mp_sws_scale(p->sws, &dst, src);
-        if (dst_rc.y0 > 0)
-            mp_image_clear(&buf->mpi, 0, 0, buf->mpi.w, dst_rc.y0);
-        if (buf->mpi.h > dst_rc.y1)
-            mp_image_clear(&buf->mpi, 0, dst_rc.y1, buf->mpi.w, buf->mpi.h);
-        if (dst_rc.x0 > 0)
-            mp_image_clear(&buf->mpi, 0, dst_rc.y0, dst_rc.x0, dst_rc.y1);
-        if (buf->mpi.w > dst_rc.x1)
-            mp_image_clear(&buf->mpi, dst_rc.x1, dst_rc.y0, buf->mpi.w, dst_rc.y1);
-        osd_draw_on_image(vo->osd, p->osd, src->pts, 0, &buf->mpi);
+
+    // Redrawing the same video frame: keep an unmodified copy around.
+    if (src && p->clean_valid && p->clean_frame_id != frame->frame_id)
+        p->clean_valid = false;
+    if (src && !p->clean_valid && frame->redraw && frame->still) {
+        if (!p->clean)
+            p->clean = mp_image_alloc(buf->mpi.imgfmt, vo->dwidth, vo->dheight);
+        if (p->clean) {
+            render_frame(p, p->clean, src);
+            p->clean_valid = true;
+            p->clean_frame_id = frame->frame_id;
+            p->clean_id++;
+        }
+    }
+    if (!src)
+        p->clean_valid = false;
+
+    if (p->clean_valid) {
+        mp_image_copy_rc(&buf->mpi, p->clean,
+                         buf->clean_id == p->clean_id ? buf->osd_rc : full);
+    } else if (src) {
+        render_frame(p, &buf->mpi, src);
     } else {
         mp_image_clear(&buf->mpi, 0, 0, buf->mpi.w, buf->mpi.h);
-        osd_draw_on_image(vo->osd, p->osd, 0, 0, &buf->mpi);
     }
+
+    struct mp_rect rc;
+    osd_draw_on_image_rc(vo->osd, p->osd, src ? src->pts : 0, 0, &buf->mpi, &rc);
+    mp_rect_intersection(&rc, &full);
+
+    buf->clean_id = p->clean_valid ? p->clean_id : 0;
+    buf->osd_rc = rc;
+
+    // The new and the attached buffer differ only where either has OSD.
+    if (buf->clean_id && buf->clean_id == p->surface_clean_id) {
+        p->damage = p->surface_rc;
+        mp_rect_extend(&p->damage, &rc);
+    }
+    p->surface_clean_id = buf->clean_id;
+    p->surface_rc = rc;
+
     wl_surface_attach(wl->surface, buf->buffer, 0, 0);
 }
 
 static void flip_page(struct vo *vo)
 {
+    struct priv *p = vo->priv;
     struct vo_wayland_state *wl = vo->wl;
+    struct mp_rect rc = p->damage;
 
-    wl_surface_damage_buffer(wl->surface, 0, 0, vo->dwidth,
-                             vo->dheight);
+    if (rc.x0 < rc.x1 && rc.y0 < rc.y1) {
+        wl_surface_damage_buffer(wl->surface, rc.x0, rc.y0,
+                                 mp_rect_w(rc), mp_rect_h(rc));
+    }
     wl_surface_commit(wl->surface);
 
     if (!wl->opts->disable_vsync)
@@ -283,6 +485,14 @@ static void uninit(struct vo *vo)
         p->free_buffers = buf->next;
         talloc_free(buf);
     }
+    // Buffers still attached; the decoder must have released them already.
+    for (int n = p->num_dr_buffers - 1; n >= 0; n--) {
+        struct mp_image *dr_image = p->dr_buffers[n]->dr_image;
+        p->dr_buffers[n]->dr_image = NULL;
+        talloc_free(dr_image);
+    }
+    assert(!p->num_dr_buffers);
+    talloc_free(p->clean);
     vo_wayland_uninit(vo);
 }
 
@@ -295,6 +505,7 @@ const struct vo_driver video_out_wlshm = {
     .control = control,
     .draw_frame = draw_frame,
     .flip_page = flip_page,
+    .get_image = get_image,
     .get_vsync = get_vsync,
     .wakeup = vo_wayland_wakeup,
     .wait_events = vo_wayland_wait_events,
@@ -57,6 +57,18 @@ struct priv {
 
     struct mp_image *original_image;
 
+    // Redraws of the same frame (OSD changes while paused) only restore and
+    // present the area the OSD covers. clean is original_image scaled to the
+    // window, without OSD. buf_clean[i] means mp_ximages[i] contains clean,
+    // plus OSD within osd_rc[i]; win_clean/win_rc is the same for the window.
+    struct mp_image *clean;
+    bool clean_valid;
+    bool buf_clean[2];
+    struct mp_rect osd_rc[2];
+    bool win_clean;
+    struct mp_rect win_rc;
+    struct mp_rect damage;          // area to put on the next flip
+
     XImage *myximage[2];
     struct mp_image mp_ximages[2];
     int depth;
@@ -253,6 +265,11 @@ static bool resize(struct vo *vo)
 
     vo_get_src_dst_rects(vo, &p->src, &p->dst, &p->osd);
 
+    TA_FREEP(&p->clean);
+    p->clean_valid = false;
+    p->buf_clean[0] = p->buf_clean[1] = false;
+    p->win_clean = false;
+
     if (vo->params) {
         p->sws->src = *vo->params;
         p->sws->src.w = mp_rect_w(p->src);
@@ -274,15 +291,20 @@ static void Display_Image(struct priv *p, XImage *myximage)
 {
     struct vo *vo = p->vo;
 
+    struct mp_rect rc = p->damage;
+    if (rc.x0 >= rc.x1 || rc.y0 >= rc.y1)
+        return;
+
     XImage *x_image = p->myximage[p->current_buf];
 
     if (p->Shmem_Flag) {
         XShmPutImage(vo->x11->display, vo->x11->window, p->gc, x_image,
-                     0, 0, 0, 0, vo->dwidth, vo->dheight, True);
+                     rc.x0, rc.y0, rc.x0, rc.y0,
+                     mp_rect_w(rc), mp_rect_h(rc), True);
         vo->x11->ShmCompletionWaitCount++;
     } else {
         XPutImage(vo->x11->display, vo->x11->window, p->gc, x_image,
-                  0, 0, 0, 0, vo->dwidth, vo->dheight);
+                  rc.x0, rc.y0, rc.x0, rc.y0, mp_rect_w(rc), mp_rect_h(rc));
     }
 }
 
@@ -307,6 +329,8 @@ static void flip_page(struct vo *vo)
 {
     struct priv *p = vo->priv;
     Display_Image(p, p->myximage[p->current_buf]);
+    p->win_clean = p->buf_clean[p->current_buf];
+    p->win_rc = p->osd_rc[p->current_buf];
     p->current_buf = (p->current_buf + 1) % 2;
     if (vo->x11->use_present) {
         vo_x11_present(vo);
@@ -321,36 +345,80 @@ static void get_vsync(struct vo *vo, struct vo_vsync_info *info)
         present_sync_get_info(x11->present, info);
 }
 
+static void render_frame(struct priv *p, struct mp_image *img,
+                         struct mp_image *mpi)
+{
+    mp_image_clear_rc_inv(img, p->dst);
+
+    struct mp_image src = *mpi;
+    struct mp_rect src_rc = p->src;
+    src_rc.x0 = MP_ALIGN_DOWN(src_rc.x0, src.fmt.align_x);
+    src_rc.y0 = MP_ALIGN_DOWN(src_rc.y0, src.fmt.align_y);
+    mp_image_crop_rc(&src, src_rc);
+
+    struct mp_image dst = *img;
+    mp_image_crop_rc(&dst, p->dst);
+
+    mp_sws_scale(p->sws, &dst, &src);
+}
+
 // Note: REDRAW_FRAME can call this with NULL.
 static void draw_image(struct vo *vo, mp_image_t *mpi)
 {
     struct priv *p = vo->priv;
+    int buf = p->current_buf;
+    struct mp_rect full = {0, 0, vo->dwidth, vo->dheight};
+
+    p->damage = full;
 
     wait_for_completion(vo, 1);
     bool render = vo_x11_check_visible(vo);
     if (!render)
         return;
 
-    struct mp_image *img = &p->mp_ximages[p->current_buf];
-
-    if (mpi) {
-        mp_image_clear_rc_inv(img, p->dst);
-
-        struct mp_image src = *mpi;
-        struct mp_rect src_rc = p->src;
-        src_rc.x0 = MP_ALIGN_DOWN(src_rc.x0, src.fmt.align_x);
-        src_rc.y0 = MP_ALIGN_DOWN(src_rc.y0, src.fmt.align_y);
-        mp_image_crop_rc(&src, src_rc);
-
-        struct mp_image dst = *img;
-        mp_image_crop_rc(&dst, p->dst);
+    struct mp_image *img = &p->mp_ximages[buf];
+
+    // Redraws pass a new reference to the same frame. Since original_image
+    // holds a reference, its data can't have been reused for another frame.
+    struct mp_image *prev = p->original_image;
+    if (mpi && prev && mpi->planes[0] == prev->planes[0] &&
+        mp_image_params_equal(&mpi->params, &prev->params))
+    {
+        // Redraw: the video didn't change, only the OSD may have.
+        if (!p->clean_valid) {
+            if (!p->clean)
+                p->clean = mp_image_alloc(img->imgfmt, vo->dwidth, vo->dheight);
+            if (p->clean) {
+                render_frame(p, p->clean, mpi);
+                p->clean_valid = true;
+                p->buf_clean[0] = p->buf_clean[1] = false;
+                p->win_clean = false;
+            }
+        }
+    } else {
+        p->clean_valid = false;
+    }
 
-        mp_sws_scale(p->sws, &dst, &src);
+    if (p->clean_valid) {
+        mp_image_copy_rc(img, p->clean, p->buf_clean[buf] ? p->osd_rc[buf] : full);
+    } else if (mpi) {
+        render_frame(p, img, mpi);
     } else {
         mp_image_clear(img, 0, 0, img->w, img->h);
     }
 
-    osd_draw_on_image(vo->osd, p->osd, mpi ? mpi->pts : 0, 0, img);
+    struct mp_rect rc;
+    osd_draw_on_image_rc(vo->osd, p->osd, mpi ? mpi->pts : 0, 0, img, &rc);
+    mp_rect_intersection(&rc, &full);
+
+    p->buf_clean[buf] = p->clean_valid;
+    p->osd_rc[buf] = rc;
+
+    // The window and this buffer differ only where either has OSD.
+    if (p->clean_valid && p->win_clean) {
+        p->damage = p->win_rc;
+        mp_rect_extend(&p->damage, &rc);
+    }
 
     if (mpi != p->original_image) {
         talloc_free(p->original_image);
@@ -377,6 +445,7 @@ static void uninit(struct vo *vo)
         XFreeGC(vo->x11->display, p->gc);
 
     talloc_free(p->original_image);
+    talloc_free(p->clean);
 
     vo_x11_uninit(vo);
 }
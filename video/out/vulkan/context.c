@@ -181,12 +181,13 @@ bool ra_vk_ctx_init(struct ra_ctx *ctx, struct mpvk_ctx *vk,
     ctx->ra = ra_create_pl(vk->gpu, ctx->log);
     if (!ctx->ra)
         goto error;
+    ra_pl_set_async_upload(ctx->ra, p->opts->async_transfer);
 
     // Create the swapchain
     struct pl_vulkan_swapchain_params pl_params = {
         .surface = vk->surface,
         .present_mode = preferred_mode,
-        .swapchain_depth = ctx->vo->opts->swapchain_depth,
+        .swapchain_depth = vo_get_swapchain_depth(ctx->vo),
         // mpv already handles resize events, so gracefully allow suboptimal
         // swapchains to exist in order to make resizing even smoother
         .allow_suboptimal = true,
@@ -0,0 +1,170 @@
+#include "common.h"
+#include "libmpv/render_vk.h"
+#include "video/out/gpu/libmpv_gpu.h"
+#include "video/out/placebo/ra_pl.h"
+#include "video/out/placebo/utils.h"
+
+struct priv {
+    pl_log pllog;
+    pl_vulkan vulkan;
+
+    // Currently wrapped target image, between wrap_fbo() and done_frame().
+    pl_tex tex;
+    struct ra_tex proxy_tex;
+    mpv_vulkan_fbo fbo;
+};
+
+static int init(struct libmpv_gpu_context *ctx, mpv_render_param *params)
+{
+    ctx->priv = talloc_zero(NULL, struct priv);
+    struct priv *p = ctx->priv;
+
+    mpv_vulkan_init_params *init_params =
+        get_mpv_render_param(params, MPV_RENDER_PARAM_VULKAN_INIT_PARAMS, NULL);
+    if (!init_params || !init_params->get_instance_proc_addr ||
+        init_params->queue_count < 1)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+#if PL_API_VER < 170
+    if (init_params->lock_queue || init_params->unlock_queue) {
+        MP_FATAL(ctx, "Queue lock callbacks require a newer libplacebo.\n");
+        return MPV_ERROR_UNSUPPORTED;
+    }
+#endif
+
+    p->pllog = mppl_log_create(ctx->log);
+    if (!p->pllog)
+        return MPV_ERROR_GENERIC;
+
+    p->vulkan = pl_vulkan_import(p->pllog, &(struct pl_vulkan_import_params) {
+        .instance = init_params->instance,
+        .get_proc_addr = init_params->get_instance_proc_addr,
+        .phys_device = init_params->physical_device,
+        .device = init_params->device,
+        .extensions = init_params->extensions,
+        .num_extensions = init_params->num_extensions,
+        .features = init_params->features,
+        .queue_graphics = {
+            .index = init_params->queue_family_index,
+            .count = init_params->queue_count,
+        },
+        .queue_compute = {
+            .index = init_params->queue_family_index,
+            .count = init_params->queue_count,
+        },
+#if PL_API_VER >= 170
+        .lock_queue = init_params->lock_queue,
+        .unlock_queue = init_params->unlock_queue,
+        .queue_ctx = init_params->queue_ctx,
+#endif
+    });
+    if (!p->vulkan) {
+        MP_FATAL(ctx, "Failed importing Vulkan device.\n");
+        return MPV_ERROR_UNSUPPORTED;
+    }
+
+    ctx->ra = ra_create_pl(p->vulkan->gpu, ctx->log);
+    if (!ctx->ra)
+        return MPV_ERROR_UNSUPPORTED;
+
+    return 0;
+}
+
+// Give up the currently wrapped image. If it was rendered to, hand it back to
+// the user and signal its semaphore.
+static void release_target(struct libmpv_gpu_context *ctx, bool rendered)
+{
+    struct priv *p = ctx->priv;
+    pl_gpu gpu = p->vulkan->gpu;
+
+    if (!p->tex)
+        return;
+
+    if (rendered) {
+        pl_vulkan_hold(gpu, p->tex, p->fbo.final_layout, (pl_vulkan_sem) {
+            .sem = p->fbo.signal_semaphore,
+            .value = p->fbo.signal_value,
+        });
+        pl_gpu_flush(gpu);
+    }
+
+    pl_tex_destroy(gpu, &p->tex);
+    p->proxy_tex = (struct ra_tex){0};
+}
+
+static int wrap_fbo(struct libmpv_gpu_context *ctx, mpv_render_param *params,
+                    struct ra_tex **out)
+{
+    struct priv *p = ctx->priv;
+    pl_gpu gpu = p->vulkan->gpu;
+
+    mpv_vulkan_fbo *fbo =
+        get_mpv_render_param(params, MPV_RENDER_PARAM_VULKAN_FBO, NULL);
+    if (!fbo || !fbo->image || !fbo->signal_semaphore || fbo->w < 1 || fbo->h < 1)
+        return MPV_ERROR_INVALID_PARAMETER;
+
+    // mpv_render_context_render() calls this twice for the same target (once
+    // to get the size, once to render), but the image can be acquired from
+    // the user only once.
+    if (p->tex && memcmp(&p->fbo, fbo, sizeof(*fbo)) == 0) {
+        *out = &p->proxy_tex;
+        return 0;
+    }
+    release_target(ctx, false);
+
+    p->tex = pl_vulkan_wrap(gpu, &(struct pl_vulkan_wrap_params) {
+        .image = fbo->image,
+        .width = fbo->w,
+        .height = fbo->h,
+        .format = fbo->format,
+        .usage = fbo->usage,
+    });
+    if (!p->tex) {
+        MP_ERR(ctx, "Failed wrapping VkImage.\n");
+        return MPV_ERROR_UNSUPPORTED;
+    }
+
+    pl_vulkan_release(gpu, p->tex, fbo->layout, (pl_vulkan_sem) {
+        .sem = fbo->wait_semaphore,
+        .value = fbo->wait_value,
+    });
+    p->fbo = *fbo;
+
+    if (!mppl_wrap_tex(ctx->ra, p->tex, &p->proxy_tex)) {
+        release_target(ctx, false);
+        return MPV_ERROR_UNSUPPORTED;
+    }
+
+    *out = &p->proxy_tex;
+    return 0;
+}
+
+static void done_frame(struct libmpv_gpu_context *ctx, mpv_render_param *params,
+                       bool ds)
+{
+    release_target(ctx, true);
+}
+
+static void destroy(struct libmpv_gpu_context *ctx)
+{
+    struct priv *p = ctx->priv;
+
+    if (p->vulkan) {
+        release_target(ctx, false);
+        pl_gpu_finish(p->vulkan->gpu);
+    }
+    if (ctx->ra) {
+        ctx->ra->fns->destroy(ctx->ra);
+        ctx->ra = NULL;
+    }
+    pl_vulkan_destroy(&p->vulkan);
+    pl_log_destroy(&p->pllog);
+}
+
+const struct libmpv_gpu_context_fns libmpv_gpu_context_vk = {
+    .api_name = MPV_RENDER_API_TYPE_VULKAN,
+    .init = init,
+    .wrap_fbo = wrap_fbo,
+    .done_frame = done_frame,
+    .destroy = destroy,
+};
@@ -990,6 +990,11 @@ static void feedback_presented(void *data, struct wp_presentation_feedback *fbac
     int64_t ust = sec * 1000000LL + (uint64_t) tv_nsec / 1000;
     int64_t msc = (uint64_t) seq_lo + ((uint64_t) seq_hi << 32);
     present_update_sync_values(wl->present, ust, msc);
+
+    // The reported refresh interval is only exact if the frame was presented
+    // in sync with the display's vblank (not e.g. with tearing presentation).
+    bool vsync = flags & WP_PRESENTATION_FEEDBACK_KIND_VSYNC;
+    present_update_refresh(wl->present, vsync ? wl->refresh_interval : 0);
 }
 
 static void feedback_discarded(void *data, struct wp_presentation_feedback *fback)
@@ -22,6 +22,7 @@
 
 #include "common/common.h"
 #include "repack.h"
+#include "repack_simd.h"
 #include "video/csputils.h"
 #include "video/fmt-conversion.h"
 #include "video/img_format.h"
@@ -76,6 +77,8 @@ struct mp_repack {
     int f32_comp_size;
     float f32_m[4], f32_o[4];
     uint32_t f32_pmax[4];
+    void (*f32_scanline)(void *a, float *b, int w, float fm, float fb,
+                         uint32_t max);
     enum mp_csp f32_csp_space;
     enum mp_csp_levels f32_csp_levels;
 
@@ -816,11 +819,8 @@ static void repack_float(struct mp_repack *rp,
                          struct mp_image *a, int a_x, int a_y,
                          struct mp_image *b, int b_x, int b_y, int w)
 {
-    assert(rp->f32_comp_size == 1 || rp->f32_comp_size == 2);
-
     void (*packer)(void *a, float *b, int w, float fm, float fb, uint32_t max)
-        = rp->pack ? (rp->f32_comp_size == 1 ? pa_f32_8 : pa_f32_16)
-                   : (rp->f32_comp_size == 1 ? un_f32_8 : un_f32_16);
+        = rp->f32_scanline;
 
     for (int p = 0; p < b->num_planes; p++) {
         int h = (1 << b->fmt.chroma_ys) - (1 << b->fmt.ys[p]) + 1;
@@ -986,6 +986,9 @@ static bool setup_format_ne(struct mp_repack *rp)
                 (desc.component_size != 1 && desc.component_size != 2))
                 return false;
             rp->f32_comp_size = desc.component_size;
+            rp->f32_scanline =
+                rp->pack ? (rp->f32_comp_size == 1 ? pa_f32_8 : pa_f32_16)
+                         : (rp->f32_comp_size == 1 ? un_f32_8 : un_f32_16);
             rp->f32_csp_space = MP_CSP_COUNT;
             rp->f32_csp_levels = MP_CSP_LEVELS_COUNT;
             rp->steps[rp->num_steps++] = (struct repack_step) {
@@ -1056,6 +1059,40 @@ static bool setup_format(struct mp_repack *rp)
     return rp->imgfmt_a && setup_format_ne(rp);
 }
 
+// Replace the C scanline functions with optimized ones, if available.
+static void setup_simd(struct mp_repack *rp)
+{
+    if (rp->flags & REPACK_CREATE_NO_SIMD)
+        return;
+
+    const struct repack_simd_fns *simd = repack_get_simd_fns();
+
+    struct {
+        void (*c)(void *a, void *b[], int w);
+        void (*opt)(void *a, void *b[], int w);
+    } scanline_map[] = {
+        {un_cc8,    simd->un_cc8},
+        {pa_cc8,    simd->pa_cc8},
+        {un_cc16,   simd->un_cc16},
+        {pa_cc16,   simd->pa_cc16},
+        {un_cccc8,  simd->un_cccc8},
+        {pa_cccc8,  simd->pa_cccc8},
+        {un_ccc8,   simd->un_ccc8},
+        {pa_ccc8,   simd->pa_ccc8},
+    };
+
+    for (int n = 0; n < MP_ARRAY_SIZE(scanline_map); n++) {
+        if (rp->packed_repack_scanline == scanline_map[n].c &&
+            scanline_map[n].opt)
+            rp->packed_repack_scanline = scanline_map[n].opt;
+    }
+
+    if (rp->f32_scanline == un_f32_16 && simd->un_f32_16)
+        rp->f32_scanline = simd->un_f32_16;
+    if (rp->f32_scanline == pa_f32_16 && simd->pa_f32_16)
+        rp->f32_scanline = simd->pa_f32_16;
+}
+
 struct mp_repack *mp_repack_create_planar(int imgfmt, bool pack, int flags)
 {
     struct mp_repack *rp = talloc_zero(NULL, struct mp_repack);
@@ -1068,6 +1105,8 @@ struct mp_repack *mp_repack_create_planar(int imgfmt, bool pack, int flags)
         return NULL;
     }
 
+    setup_simd(rp);
+
     return rp;
 }
 
@@ -0,0 +1,524 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <stdint.h>
+
+#include <libavutil/cpu.h>
+
+#include "common/common.h"
+#include "repack_simd.h"
+
+// All kernels must produce exactly the same output as the C versions in
+// repack.c (test/repack.c checks this). Like the C code, they assume little
+// endian. Loads and stores are unaligned; the leftover pixels at the end of
+// a line use plain C loops.
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define HAVE_REPACK_SSE4 1
+#else
+#define HAVE_REPACK_SSE4 0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define HAVE_REPACK_NEON 1
+#else
+#define HAVE_REPACK_NEON 0
+#endif
+
+#if HAVE_REPACK_SSE4
+
+#include <smmintrin.h>
+
+// Compiled for SSE4.1 via function attributes, so the rest of mpv does not
+// need to be built with it. Only used if the CPU reports support.
+#define SSE4 __attribute__((target("sse4.1")))
+
+// (NV12 chroma) c0 = low byte of each 16 bit word, c1 = high byte
+SSE4 static void un_cc8_sse4(void *src, void *dst[], int w)
+{
+    uint8_t *s = src, *d0 = dst[0], *d1 = dst[1];
+    const __m128i mask = _mm_set1_epi16(0xFF);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i a = _mm_loadu_si128((void *)(s + x * 2));
+        __m128i b = _mm_loadu_si128((void *)(s + x * 2 + 16));
+        __m128i c0 = _mm_packus_epi16(_mm_and_si128(a, mask),
+                                      _mm_and_si128(b, mask));
+        __m128i c1 = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+                                      _mm_srli_epi16(b, 8));
+        _mm_storeu_si128((void *)(d0 + x), c0);
+        _mm_storeu_si128((void *)(d1 + x), c1);
+    }
+    for (; x < w; x++) {
+        d0[x] = s[x * 2 + 0];
+        d1[x] = s[x * 2 + 1];
+    }
+}
+
+SSE4 static void pa_cc8_sse4(void *dst, void *src[], int w)
+{
+    uint8_t *d = dst, *s0 = src[0], *s1 = src[1];
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i c0 = _mm_loadu_si128((void *)(s0 + x));
+        __m128i c1 = _mm_loadu_si128((void *)(s1 + x));
+        _mm_storeu_si128((void *)(d + x * 2), _mm_unpacklo_epi8(c0, c1));
+        _mm_storeu_si128((void *)(d + x * 2 + 16), _mm_unpackhi_epi8(c0, c1));
+    }
+    for (; x < w; x++) {
+        d[x * 2 + 0] = s0[x];
+        d[x * 2 + 1] = s1[x];
+    }
+}
+
+// (P010/P016 chroma) same as above with 16 bit components
+SSE4 static void un_cc16_sse4(void *src, void *dst[], int w)
+{
+    uint16_t *s = src, *d0 = dst[0], *d1 = dst[1];
+    const __m128i mask = _mm_set1_epi32(0xFFFF);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        __m128i a = _mm_loadu_si128((void *)(s + x * 2));
+        __m128i b = _mm_loadu_si128((void *)(s + x * 2 + 8));
+        __m128i c0 = _mm_packus_epi32(_mm_and_si128(a, mask),
+                                      _mm_and_si128(b, mask));
+        __m128i c1 = _mm_packus_epi32(_mm_srli_epi32(a, 16),
+                                      _mm_srli_epi32(b, 16));
+        _mm_storeu_si128((void *)(d0 + x), c0);
+        _mm_storeu_si128((void *)(d1 + x), c1);
+    }
+    for (; x < w; x++) {
+        d0[x] = s[x * 2 + 0];
+        d1[x] = s[x * 2 + 1];
+    }
+}
+
+SSE4 static void pa_cc16_sse4(void *dst, void *src[], int w)
+{
+    uint16_t *d = dst, *s0 = src[0], *s1 = src[1];
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        __m128i c0 = _mm_loadu_si128((void *)(s0 + x));
+        __m128i c1 = _mm_loadu_si128((void *)(s1 + x));
+        _mm_storeu_si128((void *)(d + x * 2), _mm_unpacklo_epi16(c0, c1));
+        _mm_storeu_si128((void *)(d + x * 2 + 8), _mm_unpackhi_epi16(c0, c1));
+    }
+    for (; x < w; x++) {
+        d[x * 2 + 0] = s0[x];
+        d[x * 2 + 1] = s1[x];
+    }
+}
+
+// (RGBA/BGRA etc.) 4 components per 32 bit pixel
+SSE4 static void un_cccc8_sse4(void *src, void *dst[], int w)
+{
+    uint8_t *s = src;
+    uint8_t *d[4] = {dst[0], dst[1], dst[2], dst[3]};
+    // Group each component of 4 pixels into one 32 bit element.
+    const __m128i shuf = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13,
+                                       2, 6, 10, 14, 3, 7, 11, 15);
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i p[4];
+        for (int n = 0; n < 4; n++) {
+            p[n] = _mm_loadu_si128((void *)(s + x * 4 + n * 16));
+            p[n] = _mm_shuffle_epi8(p[n], shuf);
+        }
+        // 4x4 transpose of 32 bit elements.
+        __m128i t0 = _mm_unpacklo_epi32(p[0], p[1]);
+        __m128i t1 = _mm_unpacklo_epi32(p[2], p[3]);
+        __m128i t2 = _mm_unpackhi_epi32(p[0], p[1]);
+        __m128i t3 = _mm_unpackhi_epi32(p[2], p[3]);
+        _mm_storeu_si128((void *)(d[0] + x), _mm_unpacklo_epi64(t0, t1));
+        _mm_storeu_si128((void *)(d[1] + x), _mm_unpackhi_epi64(t0, t1));
+        _mm_storeu_si128((void *)(d[2] + x), _mm_unpacklo_epi64(t2, t3));
+        _mm_storeu_si128((void *)(d[3] + x), _mm_unpackhi_epi64(t2, t3));
+    }
+    for (; x < w; x++) {
+        for (int n = 0; n < 4; n++)
+            d[n][x] = s[x * 4 + n];
+    }
+}
+
+SSE4 static void pa_cccc8_sse4(void *dst, void *src[], int w)
+{
+    uint8_t *d = dst;
+    uint8_t *s[4] = {src[0], src[1], src[2], src[3]};
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i c0 = _mm_loadu_si128((void *)(s[0] + x));
+        __m128i c1 = _mm_loadu_si128((void *)(s[1] + x));
+        __m128i c2 = _mm_loadu_si128((void *)(s[2] + x));
+        __m128i c3 = _mm_loadu_si128((void *)(s[3] + x));
+        __m128i c01l = _mm_unpacklo_epi8(c0, c1);
+        __m128i c01h = _mm_unpackhi_epi8(c0, c1);
+        __m128i c23l = _mm_unpacklo_epi8(c2, c3);
+        __m128i c23h = _mm_unpackhi_epi8(c2, c3);
+        uint8_t *p = d + x * 4;
+        _mm_storeu_si128((void *)(p + 0),  _mm_unpacklo_epi16(c01l, c23l));
+        _mm_storeu_si128((void *)(p + 16), _mm_unpackhi_epi16(c01l, c23l));
+        _mm_storeu_si128((void *)(p + 32), _mm_unpacklo_epi16(c01h, c23h));
+        _mm_storeu_si128((void *)(p + 48), _mm_unpackhi_epi16(c01h, c23h));
+    }
+    for (; x < w; x++) {
+        for (int n = 0; n < 4; n++)
+            d[x * 4 + n] = s[n][x];
+    }
+}
+
+// (RGB24/BGR24) 16 pixels = 48 bytes = 3 registers. Each output register is
+// combined from 3 byte shuffles; -1 entries produce zero bytes.
+static const int8_t un_ccc8_shuf[3][3][16] = {
+    {{ 0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  1,  4,  7, 10, 13}},
+    {{ 1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  5,  8, 11, 14}},
+    {{ 2,  5,  8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1,  1,  4,  7, 10, 13, -1, -1, -1, -1, -1, -1},
+     {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  3,  6,  9, 12, 15}},
+};
+
+static const int8_t pa_ccc8_shuf[3][3][16] = {
+    {{ 0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1,  5},
+     {-1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1, -1},
+     {-1, -1,  0, -1, -1,  1, -1, -1,  2, -1, -1,  3, -1, -1,  4, -1}},
+    {{-1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10, -1},
+     { 5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1, 10},
+     {-1,  5, -1, -1,  6, -1, -1,  7, -1, -1,  8, -1, -1,  9, -1, -1}},
+    {{-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1},
+     {-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1},
+     {10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15}},
+};
+
+SSE4 static void un_ccc8_sse4(void *src, void *dst[], int w)
+{
+    uint8_t *s = src;
+    uint8_t *d[3] = {dst[0], dst[1], dst[2]};
+    __m128i shuf[3][3];
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++)
+            shuf[c][r] = _mm_loadu_si128((void *)un_ccc8_shuf[c][r]);
+    }
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i p[3];
+        for (int r = 0; r < 3; r++)
+            p[r] = _mm_loadu_si128((void *)(s + x * 3 + r * 16));
+        for (int c = 0; c < 3; c++) {
+            __m128i v = _mm_or_si128(
+                _mm_or_si128(_mm_shuffle_epi8(p[0], shuf[c][0]),
+                             _mm_shuffle_epi8(p[1], shuf[c][1])),
+                _mm_shuffle_epi8(p[2], shuf[c][2]));
+            _mm_storeu_si128((void *)(d[c] + x), v);
+        }
+    }
+    for (; x < w; x++) {
+        for (int c = 0; c < 3; c++)
+            d[c][x] = s[x * 3 + c];
+    }
+}
+
+SSE4 static void pa_ccc8_sse4(void *dst, void *src[], int w)
+{
+    uint8_t *d = dst;
+    uint8_t *s[3] = {src[0], src[1], src[2]};
+    __m128i shuf[3][3];
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 3; c++)
+            shuf[r][c] = _mm_loadu_si128((void *)pa_ccc8_shuf[r][c]);
+    }
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        __m128i c[3];
+        for (int n = 0; n < 3; n++)
+            c[n] = _mm_loadu_si128((void *)(s[n] + x));
+        for (int r = 0; r < 3; r++) {
+            __m128i v = _mm_or_si128(
+                _mm_or_si128(_mm_shuffle_epi8(c[0], shuf[r][0]),
+                             _mm_shuffle_epi8(c[1], shuf[r][1])),
+                _mm_shuffle_epi8(c[2], shuf[r][2]));
+            _mm_storeu_si128((void *)(d + x * 3 + r * 16), v);
+        }
+    }
+    for (; x < w; x++) {
+        for (int n = 0; n < 3; n++)
+            d[x * 3 + n] = s[n][x];
+    }
+}
+
+// The float conversions perform the same operations in the same order as the
+// C code, so the results are bit-identical. _mm_cvtps_epi32() rounds with the
+// current rounding mode, just like lrint().
+SSE4 static void un_f32_16_sse4(void *src, float *dst, int w, float m, float o,
+                                uint32_t unused)
+{
+    uint16_t *s = src;
+    const __m128 vm = _mm_set1_ps(m), vo = _mm_set1_ps(o);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        __m128i v = _mm_loadu_si128((void *)(s + x));
+        __m128 lo = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(v));
+        __m128 hi = _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_srli_si128(v, 8)));
+        _mm_storeu_ps(dst + x + 0, _mm_add_ps(_mm_mul_ps(lo, vm), vo));
+        _mm_storeu_ps(dst + x + 4, _mm_add_ps(_mm_mul_ps(hi, vm), vo));
+    }
+    for (; x < w; x++)
+        dst[x] = s[x] * m + o;
+}
+
+SSE4 static void pa_f32_16_sse4(void *dst, float *src, int w, float m, float o,
+                                uint32_t p_max)
+{
+    uint16_t *d = dst;
+    const __m128 vm = _mm_set1_ps(m), vo = _mm_set1_ps(o);
+    // Clamping before rounding is equivalent, since the bounds are integers.
+    // _mm_max_ps() returns the second operand for NaN, like the C code would.
+    const __m128 vmin = _mm_setzero_ps(), vmax = _mm_set1_ps(p_max);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        __m128 lo = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(src + x + 0), vo), vm);
+        __m128 hi = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(src + x + 4), vo), vm);
+        lo = _mm_min_ps(_mm_max_ps(lo, vmin), vmax);
+        hi = _mm_min_ps(_mm_max_ps(hi, vmin), vmax);
+        __m128i v = _mm_packus_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi));
+        _mm_storeu_si128((void *)(d + x), v);
+    }
+    for (; x < w; x++)
+        d[x] = MPCLAMP(lrint((src[x] + o) * m), 0, (uint16_t)p_max);
+}
+
+static const struct repack_simd_fns fns_sse4 = {
+    .name = "sse4.1",
+    .un_cc8 = un_cc8_sse4,
+    .pa_cc8 = pa_cc8_sse4,
+    .un_cc16 = un_cc16_sse4,
+    .pa_cc16 = pa_cc16_sse4,
+    .un_cccc8 = un_cccc8_sse4,
+    .pa_cccc8 = pa_cccc8_sse4,
+    .un_ccc8 = un_ccc8_sse4,
+    .pa_ccc8 = pa_ccc8_sse4,
+    .un_f32_16 = un_f32_16_sse4,
+    .pa_f32_16 = pa_f32_16_sse4,
+};
+
+#endif /* HAVE_REPACK_SSE4 */
+
+#if HAVE_REPACK_NEON
+
+#include <arm_neon.h>
+
+// NEON is mandatory on aarch64, and the structured loads/stores do all the
+// work here.
+
+static void un_cc8_neon(void *src, void *dst[], int w)
+{
+    uint8_t *s = src, *d0 = dst[0], *d1 = dst[1];
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        uint8x16x2_t v = vld2q_u8(s + x * 2);
+        vst1q_u8(d0 + x, v.val[0]);
+        vst1q_u8(d1 + x, v.val[1]);
+    }
+    for (; x < w; x++) {
+        d0[x] = s[x * 2 + 0];
+        d1[x] = s[x * 2 + 1];
+    }
+}
+
+static void pa_cc8_neon(void *dst, void *src[], int w)
+{
+    uint8_t *d = dst, *s0 = src[0], *s1 = src[1];
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        uint8x16x2_t v = {{vld1q_u8(s0 + x), vld1q_u8(s1 + x)}};
+        vst2q_u8(d + x * 2, v);
+    }
+    for (; x < w; x++) {
+        d[x * 2 + 0] = s0[x];
+        d[x * 2 + 1] = s1[x];
+    }
+}
+
+static void un_cc16_neon(void *src, void *dst[], int w)
+{
+    uint16_t *s = src, *d0 = dst[0], *d1 = dst[1];
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        uint16x8x2_t v = vld2q_u16(s + x * 2);
+        vst1q_u16(d0 + x, v.val[0]);
+        vst1q_u16(d1 + x, v.val[1]);
+    }
+    for (; x < w; x++) {
+        d0[x] = s[x * 2 + 0];
+        d1[x] = s[x * 2 + 1];
+    }
+}
+
+static void pa_cc16_neon(void *dst, void *src[], int w)
+{
+    uint16_t *d = dst, *s0 = src[0], *s1 = src[1];
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        uint16x8x2_t v = {{vld1q_u16(s0 + x), vld1q_u16(s1 + x)}};
+        vst2q_u16(d + x * 2, v);
+    }
+    for (; x < w; x++) {
+        d[x * 2 + 0] = s0[x];
+        d[x * 2 + 1] = s1[x];
+    }
+}
+
+static void un_cccc8_neon(void *src, void *dst[], int w)
+{
+    uint8_t *s = src;
+    uint8_t *d[4] = {dst[0], dst[1], dst[2], dst[3]};
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        uint8x16x4_t v = vld4q_u8(s + x * 4);
+        for (int n = 0; n < 4; n++)
+            vst1q_u8(d[n] + x, v.val[n]);
+    }
+    for (; x < w; x++) {
+        for (int n = 0; n < 4; n++)
+            d[n][x] = s[x * 4 + n];
+    }
+}
+
+static void pa_cccc8_neon(void *dst, void *src[], int w)
+{
+    uint8_t *d = dst;
+    uint8_t *s[4] = {src[0], src[1], src[2], src[3]};
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        uint8x16x4_t v;
+        for (int n = 0; n < 4; n++)
+            v.val[n] = vld1q_u8(s[n] + x);
+        vst4q_u8(d + x * 4, v);
+    }
+    for (; x < w; x++) {
+        for (int n = 0; n < 4; n++)
+            d[x * 4 + n] = s[n][x];
+    }
+}
+
+static void un_ccc8_neon(void *src, void *dst[], int w)
+{
+    uint8_t *s = src;
+    uint8_t *d[3] = {dst[0], dst[1], dst[2]};
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        uint8x16x3_t v = vld3q_u8(s + x * 3);
+        for (int n = 0; n < 3; n++)
+            vst1q_u8(d[n] + x, v.val[n]);
+    }
+    for (; x < w; x++) {
+        for (int n = 0; n < 3; n++)
+            d[n][x] = s[x * 3 + n];
+    }
+}
+
+static void pa_ccc8_neon(void *dst, void *src[], int w)
+{
+    uint8_t *d = dst;
+    uint8_t *s[3] = {src[0], src[1], src[2]};
+    int x = 0;
+    for (; x + 16 <= w; x += 16) {
+        uint8x16x3_t v;
+        for (int n = 0; n < 3; n++)
+            v.val[n] = vld1q_u8(s[n] + x);
+        vst3q_u8(d + x * 3, v);
+    }
+    for (; x < w; x++) {
+        for (int n = 0; n < 3; n++)
+            d[x * 3 + n] = s[n][x];
+    }
+}
+
+// See the SSE4 versions. vcvtnq_u32_f32() rounds to nearest with ties to
+// even, which is what lrint() does in the default rounding mode.
+static void un_f32_16_neon(void *src, float *dst, int w, float m, float o,
+                           uint32_t unused)
+{
+    uint16_t *s = src;
+    const float32x4_t vm = vdupq_n_f32(m), vo = vdupq_n_f32(o);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        uint16x8_t v = vld1q_u16(s + x);
+        float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(v)));
+        float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(v)));
+        vst1q_f32(dst + x + 0, vaddq_f32(vmulq_f32(lo, vm), vo));
+        vst1q_f32(dst + x + 4, vaddq_f32(vmulq_f32(hi, vm), vo));
+    }
+    for (; x < w; x++)
+        dst[x] = s[x] * m + o;
+}
+
+static void pa_f32_16_neon(void *dst, float *src, int w, float m, float o,
+                           uint32_t p_max)
+{
+    uint16_t *d = dst;
+    const float32x4_t vm = vdupq_n_f32(m), vo = vdupq_n_f32(o);
+    const float32x4_t vmin = vdupq_n_f32(0), vmax = vdupq_n_f32(p_max);
+    int x = 0;
+    for (; x + 8 <= w; x += 8) {
+        float32x4_t lo = vmulq_f32(vaddq_f32(vld1q_f32(src + x + 0), vo), vm);
+        float32x4_t hi = vmulq_f32(vaddq_f32(vld1q_f32(src + x + 4), vo), vm);
+        lo = vminq_f32(vmaxq_f32(lo, vmin), vmax);
+        hi = vminq_f32(vmaxq_f32(hi, vmin), vmax);
+        uint16x8_t v = vcombine_u16(vmovn_u32(vcvtnq_u32_f32(lo)),
+                                    vmovn_u32(vcvtnq_u32_f32(hi)));
+        vst1q_u16(d + x, v);
+    }
+    for (; x < w; x++)
+        d[x] = MPCLAMP(lrint((src[x] + o) * m), 0, (uint16_t)p_max);
+}
+
+static const struct repack_simd_fns fns_neon = {
+    .name = "neon",
+    .un_cc8 = un_cc8_neon,
+    .pa_cc8 = pa_cc8_neon,
+    .un_cc16 = un_cc16_neon,
+    .pa_cc16 = pa_cc16_neon,
+    .un_cccc8 = un_cccc8_neon,
+    .pa_cccc8 = pa_cccc8_neon,
+    .un_ccc8 = un_ccc8_neon,
+    .pa_ccc8 = pa_ccc8_neon,
+    .un_f32_16 = un_f32_16_neon,
+    .pa_f32_16 = pa_f32_16_neon,
+};
+
+#endif /* HAVE_REPACK_NEON */
+
+static const struct repack_simd_fns fns_none = {
+    .name = "none",
+};
+
+const struct repack_simd_fns *repack_get_simd_fns(void)
+{
+#if HAVE_REPACK_SSE4
+    if (av_get_cpu_flags() & AV_CPU_FLAG_SSE4)
+        return &fns_sse4;
+#endif
+#if HAVE_REPACK_NEON
+    if (av_get_cpu_flags() & AV_CPU_FLAG_NEON)
+        return &fns_neon;
+#endif
+    return &fns_none;
+}
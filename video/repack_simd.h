@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// Optimized scanline functions for the most common repack.c cases. Each has
+// the same signature and semantics as the C function with the same name in
+// repack.c. Entries are NULL if there is no optimized version.
+struct repack_simd_fns {
+    const char *name;
+    void (*un_cc8)(void *src, void *dst[], int w);
+    void (*pa_cc8)(void *dst, void *src[], int w);
+    void (*un_cc16)(void *src, void *dst[], int w);
+    void (*pa_cc16)(void *dst, void *src[], int w);
+    void (*un_cccc8)(void *src, void *dst[], int w);
+    void (*pa_cccc8)(void *dst, void *src[], int w);
+    void (*un_ccc8)(void *src, void *dst[], int w);
+    void (*pa_ccc8)(void *dst, void *src[], int w);
+    void (*un_f32_16)(void *src, float *dst, int w, float m, float o,
+                      uint32_t unused);
+    void (*pa_f32_16)(void *dst, float *src, int w, float m, float o,
+                      uint32_t p_max);
+};
+
+// Return the functions for the best instruction set the CPU supports, as
+// detected at runtime. Never returns NULL.
+const struct repack_simd_fns *repack_get_simd_fns(void);
@@ -20,6 +20,8 @@
 #include <libswscale/swscale.h>
 #include <libavcodec/avcodec.h>
 #include <libavutil/bswap.h>
+#include <libavutil/cpu.h>
+#include <libavutil/frame.h>
 #include <libavutil/opt.h>
 
 #include "config.h"
@@ -40,6 +42,10 @@
 #include "zimg.h"
 #endif
 
+// libswscale can split the output into slices and scale them on its own
+// worker threads, but only through the AVFrame based API.
+#define HAVE_SWS_THREADS (LIBSWSCALE_VERSION_INT >= AV_VERSION_INT(6, 1, 100))
+
 //global sws_flags from the command line
 struct sws_opts {
     int scaler;
@@ -52,6 +58,7 @@ struct sws_opts {
     int fast;
     int bitexact;
     int zimg;
+    int threads;
 };
 
 #define OPT_BASE_STRUCT struct sws_opts
@@ -78,6 +85,7 @@ const struct m_sub_options sws_conf = {
         {"fast", OPT_FLAG(fast)},
         {"bitexact", OPT_FLAG(bitexact)},
         {"allow-zimg", OPT_FLAG(zimg)},
+        {"threads", OPT_CHOICE(threads, {"auto", 0}), M_RANGE(1, 64)},
         {0}
     },
     .size = sizeof(struct sws_opts),
@@ -114,6 +122,11 @@ static void mp_sws_update_from_cmdline(struct mp_sws_context *ctx)
         ctx->flags |= SWS_BITEXACT;
 
     ctx->allow_zimg = opts->zimg;
+
+    ctx->threads = opts->threads;
+    if (ctx->threads < 1)
+        ctx->threads = av_cpu_count();
+    ctx->threads = MPCLAMP(ctx->threads, 1, 64);
 }
 
 bool mp_sws_supported_format(int imgfmt)
@@ -167,6 +180,7 @@ static bool cache_valid(struct mp_sws_context *ctx)
            mp_image_params_equal(&ctx->dst, &old->dst) &&
            ctx->flags == old->flags &&
            ctx->allow_zimg == old->allow_zimg &&
+           ctx->threads == old->threads &&
            ctx->force_scaler == old->force_scaler &&
            (!ctx->opts_cache || !m_config_cache_update(ctx->opts_cache));
 }
@@ -189,6 +203,7 @@ struct mp_sws_context *mp_sws_alloc(void *talloc_ctx)
     *ctx = (struct mp_sws_context) {
         .log = mp_null_log,
         .flags = SWS_BILINEAR,
+        .threads = 1,
         .force_reload = true,
         .params = {SWS_PARAM_DEFAULT, SWS_PARAM_DEFAULT},
         .cached = talloc_zero(ctx, struct mp_sws_context),
@@ -300,6 +315,20 @@ int mp_sws_reinit(struct mp_sws_context *ctx)
     av_opt_set_double(ctx->sws, "param0", ctx->params[0], 0);
     av_opt_set_double(ctx->sws, "param1", ctx->params[1], 0);
 
+    ctx->sws_threads = 1;
+#if HAVE_SWS_THREADS
+    // Very small images are not worth the synchronization overhead.
+    if (ctx->threads > 1 && dst.h >= 64 &&
+        av_opt_set_int(ctx->sws, "threads", ctx->threads, 0) >= 0)
+    {
+        ctx->sws_threads = ctx->threads;
+        MP_VERBOSE(ctx, "using up to %d threads for scaling\n", ctx->threads);
+    }
+#else
+    if (ctx->threads > 1)
+        MP_VERBOSE(ctx, "libswscale too old for threaded scaling.\n");
+#endif
+
     int cr_src = mp_chroma_location_to_av(src.chroma_location);
     int cr_dst = mp_chroma_location_to_av(dst.chroma_location);
     int cr_xpos, cr_ypos;
@@ -365,6 +394,43 @@ static struct mp_image *check_alignment(struct mp_log *log,
     return *alloc;
 }
 
+#if HAVE_SWS_THREADS
+static void dummy_free(void *opaque, uint8_t *data)
+{
+}
+
+// Point frame at the image data without copying or taking ownership. The
+// dummy buffer reference keeps libswscale from allocating a new destination
+// or duplicating the source (it av_frame_ref()s both).
+static bool wrap_frame(AVFrame *frame, struct mp_image *img, int flags)
+{
+    frame->format = imgfmt2pixfmt(img->imgfmt);
+    frame->width = img->w;
+    frame->height = img->h;
+    for (int p = 0; p < MP_MAX_PLANES; p++) {
+        frame->data[p] = p < img->num_planes ? img->planes[p] : NULL;
+        frame->linesize[p] = p < img->num_planes ? img->stride[p] : 0;
+    }
+    frame->buf[0] = av_buffer_create(img->planes[0], 1, dummy_free, NULL, flags);
+    return !!frame->buf[0];
+}
+
+// Let libswscale slice the output and scale the slices on its own threads.
+static int scale_threaded(struct mp_sws_context *ctx, struct mp_image *dst,
+                          struct mp_image *src)
+{
+    int r = -1;
+    AVFrame *f_src = av_frame_alloc();
+    AVFrame *f_dst = av_frame_alloc();
+    if (f_src && f_dst && wrap_frame(f_src, src, AV_BUFFER_FLAG_READONLY) &&
+        wrap_frame(f_dst, dst, 0))
+        r = sws_scale_frame(ctx->sws, f_dst, f_src);
+    av_frame_free(&f_src);
+    av_frame_free(&f_dst);
+    return r;
+}
+#endif
+
 // Scale from src to dst - if src/dst have different parameters from previous
 // calls, the context is reinitialized. Return error code. (It can fail if
 // reinitialization was necessary, and swscale returned an error.)
@@ -395,8 +461,18 @@ int mp_sws_scale(struct mp_sws_context *ctx, struct mp_image *dst,
     if (a_src != src)
         mp_image_copy(a_src, src);
 
-    sws_scale(ctx->sws, (const uint8_t *const *) a_src->planes, a_src->stride,
-              0, a_src->h, a_dst->planes, a_dst->stride);
+#if HAVE_SWS_THREADS
+    if (ctx->sws_threads > 1) {
+        if (scale_threaded(ctx, a_dst, a_src) < 0) {
+            MP_ERR(ctx, "libswscale scaling failed.\n");
+            return -1;
+        }
+    } else
+#endif
+    {
+        sws_scale(ctx->sws, (const uint8_t *const *) a_src->planes,
+                  a_src->stride, 0, a_src->h, a_dst->planes, a_dst->stride);
+    }
 
     if (a_dst != dst)
         mp_image_copy(dst, a_dst);
@@ -37,6 +37,9 @@ struct mp_sws_context {
     int flags;
     bool allow_zimg; // use zimg if available (ignores filters and all)
     bool force_reload;
+    // Maximum number of threads libswscale may use. 1 disables threading.
+    // Set from --sws-threads if cmdline opts are enabled.
+    int threads;
     // These are also implicitly set by mp_sws_scale(), and thus optional.
     // Setting them before that call makes sense when using mp_sws_reinit().
     struct mp_image_params src, dst;
@@ -57,6 +60,7 @@ struct mp_sws_context {
     // Cached context (if any)
     struct SwsContext *sws;
     bool supports_csp;
+    int sws_threads; // threads actually enabled on sws
 
     // Private.
     struct m_config_cache *opts_cache;
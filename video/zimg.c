@@ -187,24 +187,136 @@ static zimg_color_primaries_e mp_to_z_prim(enum mp_csp_prim prim)
     }
 }
 
-static void destroy_zimg(struct mp_zimg_context *ctx)
+// A set of slice states for specific parameters, kept around for reuse.
+struct mp_zimg_graph {
+    struct mp_image_params src, dst;
+    struct zimg_opts opts;
+    struct mp_zimg_state **states;
+    int num_states;
+};
+
+static void destroy_states(struct mp_zimg_state **states, int num_states)
 {
-    for (int n = 0; n < ctx->num_states; n++) {
-        struct mp_zimg_state *st = ctx->states[n];
+    for (int n = 0; n < num_states; n++) {
+        struct mp_zimg_state *st = states[n];
         talloc_free(st->tmp_alloc);
         zimg_filter_graph_free(st->graph);
         TA_FREEP(&st->src);
         TA_FREEP(&st->dst);
         talloc_free(st);
     }
+}
+
+static void free_graph(struct mp_zimg_graph *g)
+{
+    destroy_states(g->states, g->num_states);
+    talloc_free(g);
+}
+
+static void destroy_zimg(struct mp_zimg_context *ctx)
+{
+    mp_zimg_convert_wait(ctx);
+    destroy_states(ctx->states, ctx->num_states);
     ctx->num_states = 0;
 }
 
+static void flush_graphs(struct mp_zimg_context *ctx)
+{
+    for (int n = 0; n < ctx->num_graphs; n++)
+        free_graph(ctx->graphs[n]);
+    ctx->num_graphs = 0;
+}
+
+static bool opts_equal(struct zimg_opts *a, struct zimg_opts *b)
+{
+    return a->scaler == b->scaler &&
+           a->scaler_params[0] == b->scaler_params[0] &&
+           a->scaler_params[1] == b->scaler_params[1] &&
+           a->scaler_chroma == b->scaler_chroma &&
+           a->scaler_chroma_params[0] == b->scaler_chroma_params[0] &&
+           a->scaler_chroma_params[1] == b->scaler_chroma_params[1] &&
+           a->dither == b->dither &&
+           a->fast == b->fast &&
+           a->threads == b->threads;
+}
+
+// Move the current states (if any) to the graph cache. The least recently
+// used entry is evicted if the cache is full.
+static void stash_graph(struct mp_zimg_context *ctx)
+{
+    mp_zimg_convert_wait(ctx);
+    if (!ctx->num_states)
+        return;
+
+    if (ctx->num_graphs == MP_ZIMG_GRAPH_CACHE) {
+        free_graph(ctx->graphs[0]);
+        MP_TARRAY_REMOVE_AT(ctx->graphs, ctx->num_graphs, 0);
+    }
+
+    struct mp_zimg_graph *g = talloc_ptrtype(NULL, g);
+    *g = (struct mp_zimg_graph){
+        .src = ctx->states[0]->src->fmt,
+        .dst = ctx->states[0]->dst->fmt,
+        .opts = ctx->states_opts,
+        .states = talloc_steal(g, ctx->states),
+        .num_states = ctx->num_states,
+    };
+    MP_TARRAY_APPEND(ctx, ctx->graphs, ctx->num_graphs, g);
+
+    ctx->states = NULL;
+    ctx->num_states = 0;
+}
+
+// If a cached graph matches the current parameters, make it current again.
+static bool unstash_graph(struct mp_zimg_context *ctx)
+{
+    assert(!ctx->num_states);
+
+    for (int n = ctx->num_graphs - 1; n >= 0; n--) {
+        struct mp_zimg_graph *g = ctx->graphs[n];
+        if (mp_image_params_equal(&g->src, &ctx->src) &&
+            mp_image_params_equal(&g->dst, &ctx->dst) &&
+            opts_equal(&g->opts, &ctx->opts))
+        {
+            talloc_free(ctx->states);
+            ctx->states = talloc_steal(ctx, g->states);
+            ctx->num_states = g->num_states;
+            ctx->states_opts = g->opts;
+            g->num_states = 0;
+            free_graph(g);
+            MP_TARRAY_REMOVE_AT(ctx->graphs, ctx->num_graphs, n);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Make sure the thread pool can run at least the given number of slices
+// concurrently. It only ever grows, so switching between cached graphs with
+// different slice counts does not recreate the threads.
+static bool ensure_threads(struct mp_zimg_context *ctx, int threads)
+{
+    if (threads <= ctx->current_thread_count)
+        return true;
+
+    // Just destroy and recreate all - dumb and costly, but rarely happens.
+    TA_FREEP(&ctx->tp);
+    ctx->current_thread_count = 0;
+    MP_VERBOSE(ctx, "using %d threads for scaling\n", threads);
+    ctx->tp = mp_thread_pool_create(NULL, threads, threads, threads);
+    if (!ctx->tp)
+        return false;
+    ctx->current_thread_count = threads;
+    return true;
+}
+
 static void free_mp_zimg(void *p)
 {
     struct mp_zimg_context *ctx = p;
 
     destroy_zimg(ctx);
+    flush_graphs(ctx);
     TA_FREEP(&ctx->tp);
 }
 
@@ -227,6 +339,7 @@ void mp_zimg_enable_cmdline_opts(struct mp_zimg_context *ctx,
 
     ctx->opts_cache = m_config_cache_alloc(ctx, g, &zimg_conf);
     destroy_zimg(ctx); // force update
+    flush_graphs(ctx);
     mp_zimg_update_from_cmdline(ctx); // first update
 }
 
@@ -559,11 +672,16 @@ static bool mp_zimg_state_init(struct mp_zimg_context *ctx,
 
 bool mp_zimg_config(struct mp_zimg_context *ctx)
 {
-    destroy_zimg(ctx);
+    stash_graph(ctx);
 
     if (ctx->opts_cache)
         mp_zimg_update_from_cmdline(ctx);
 
+    if (unstash_graph(ctx)) {
+        MP_DBG(ctx, "reusing cached zimg graph\n");
+        return true;
+    }
+
     int slices = ctx->opts.threads;
     if (slices < 1)
         slices = av_cpu_count();
@@ -578,19 +696,8 @@ bool mp_zimg_config(struct mp_zimg_context *ctx)
     slice_h = MP_ALIGN_UP(slice_h, 64); // for dithering and minimum slice size
     slices = (full_h + slice_h - 1) / slice_h;
 
-    int threads = slices - 1;
-    if (threads != ctx->current_thread_count) {
-        // Just destroy and recreate all - dumb and costly, but rarely happens.
-        TA_FREEP(&ctx->tp);
-        ctx->current_thread_count = 0;
-        if (threads) {
-            MP_VERBOSE(ctx, "using %d threads for scaling\n", threads);
-            ctx->tp = mp_thread_pool_create(NULL, threads, threads, threads);
-            if (!ctx->tp)
-                goto fail;
-            ctx->current_thread_count = threads;
-        }
-    }
+    if (!ensure_threads(ctx, slices - 1))
+        goto fail;
 
     for (int n = 0; n < slices; n++) {
         struct mp_zimg_state *st = talloc_zero(NULL, struct mp_zimg_state);
@@ -601,6 +708,7 @@ bool mp_zimg_config(struct mp_zimg_context *ctx)
     }
 
     assert(ctx->num_states == slices);
+    ctx->states_opts = ctx->opts;
 
     return true;
 
@@ -651,9 +759,13 @@ static void do_convert_thread(void *ptr)
     mp_waiter_wakeup(&st->thread_waiter, 0);
 }
 
-bool mp_zimg_convert(struct mp_zimg_context *ctx, struct mp_image *dst,
-                     struct mp_image *src)
+// Configure for the given images, and start converting all slices starting
+// with first on the thread pool.
+static bool start_convert(struct mp_zimg_context *ctx, struct mp_image *dst,
+                          struct mp_image *src, int first)
 {
+    mp_zimg_convert_wait(ctx);
+
     ctx->src = src->params;
     ctx->dst = dst->params;
 
@@ -662,6 +774,11 @@ bool mp_zimg_convert(struct mp_zimg_context *ctx, struct mp_image *dst,
         return false;
     }
 
+    if (!ensure_threads(ctx, ctx->num_states - first)) {
+        MP_ERR(ctx, "zimg thread pool creation failed.\n");
+        return false;
+    }
+
     for (int n = 0; n < ctx->num_states; n++) {
         struct mp_zimg_state *st = ctx->states[n];
 
@@ -671,7 +788,7 @@ bool mp_zimg_convert(struct mp_zimg_context *ctx, struct mp_image *dst,
         }
     }
 
-    for (int n = 1; n < ctx->num_states; n++) {
+    for (int n = first; n < ctx->num_states; n++) {
         struct mp_zimg_state *st = ctx->states[n];
 
         st->thread_waiter = (struct mp_waiter)MP_WAITER_INITIALIZER;
@@ -681,15 +798,41 @@ bool mp_zimg_convert(struct mp_zimg_context *ctx, struct mp_image *dst,
         assert(r);
     }
 
+    ctx->pending_first = first;
+    ctx->convert_pending = true;
+    return true;
+}
+
+bool mp_zimg_convert(struct mp_zimg_context *ctx, struct mp_image *dst,
+                     struct mp_image *src)
+{
+    if (!start_convert(ctx, dst, src, 1))
+        return false;
+
     do_convert(ctx->states[0]);
 
-    for (int n = 1; n < ctx->num_states; n++) {
+    mp_zimg_convert_wait(ctx);
+    return true;
+}
+
+bool mp_zimg_convert_async(struct mp_zimg_context *ctx, struct mp_image *dst,
+                           struct mp_image *src)
+{
+    return start_convert(ctx, dst, src, 0);
+}
+
+void mp_zimg_convert_wait(struct mp_zimg_context *ctx)
+{
+    if (!ctx->convert_pending)
+        return;
+
+    for (int n = ctx->pending_first; n < ctx->num_states; n++) {
         struct mp_zimg_state *st = ctx->states[n];
 
         mp_waiter_wait(&st->thread_waiter);
     }
 
-    return true;
+    ctx->convert_pending = false;
 }
 
 static bool supports_format(int imgfmt, bool out)
@@ -8,6 +8,9 @@
 
 #define ZIMG_ALIGN 64
 
+// Number of filter graphs for previously used parameters kept for reuse.
+#define MP_ZIMG_GRAPH_CACHE 4
+
 struct mpv_global;
 
 bool mp_zimg_supports_in_format(int imgfmt);
@@ -31,7 +34,8 @@ struct mp_zimg_context {
 
     // User configuration. Note: changing these requires calling mp_zimg_config()
     // to update the filter graph. The first mp_zimg_convert() call (or if the
-    // image format changes) will do this automatically.
+    // image format changes) will do this automatically. Graphs for recently
+    // used parameters are cached, so switching back to them is cheap.
     struct zimg_opts opts;
 
     // Input/output parameters. Note: if these mismatch with the
@@ -45,6 +49,11 @@ struct mp_zimg_context {
     int num_states;
     struct mp_thread_pool *tp;
     int current_thread_count;
+    struct zimg_opts states_opts;       // opts the states were built with
+    struct mp_zimg_graph **graphs;      // LRU cache, most recent last
+    int num_graphs;
+    bool convert_pending;
+    int pending_first;
 };
 
 // Allocate a zimg context. Always succeeds. Returns a talloc pointer (use
@@ -71,3 +80,16 @@ bool mp_zimg_config_image_params(struct mp_zimg_context *ctx);
 // Convert/scale src to dst. On failure, the data in dst is not touched.
 bool mp_zimg_convert(struct mp_zimg_context *ctx, struct mp_image *dst,
                      struct mp_image *src);
+
+// Like mp_zimg_convert(), but run all slices on the thread pool and return
+// without waiting for them. The caller must not access src or dst, or call
+// any other function on ctx, until mp_zimg_convert_wait() returns. (Other
+// functions implicitly wait, but dst is not safe to use until then.)
+// This makes it possible to overlap the conversion of a frame with other
+// work on the same thread, such as encoding the previous frame.
+bool mp_zimg_convert_async(struct mp_zimg_context *ctx, struct mp_image *dst,
+                           struct mp_image *src);
+
+// Wait until a conversion started with mp_zimg_convert_async() is done. Does
+// nothing if none is pending.
+void mp_zimg_convert_wait(struct mp_zimg_context *ctx);
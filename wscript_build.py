@@ -274,6 +274,7 @@ def build(ctx):
         ( "common/codecs.c" ),
         ( "common/common.c" ),
         ( "common/encode_lavc.c" ),
+        ( "common/memory.c" ),
         ( "common/msg.c" ),
         ( "common/playlist.c" ),
         ( "common/recorder.c" ),
@@ -303,6 +304,7 @@ def build(ctx):
         ( "demux/timeline.c" ),
 
         ( "filters/f_async_queue.c" ),
+        ( "filters/f_audio_meter.c" ),
         ( "filters/f_autoconvert.c" ),
         ( "filters/f_auto_filters.c" ),
         ( "filters/f_decoder_wrapper.c" ),
@@ -312,6 +314,7 @@ def build(ctx):
         ( "filters/f_output_chain.c" ),
         ( "filters/f_swresample.c" ),
         ( "filters/f_swscale.c" ),
+        ( "filters/f_thread.c" ),
         ( "filters/f_utils.c" ),
         ( "filters/filter.c" ),
         ( "filters/frame.c" ),
@@ -329,9 +332,11 @@ def build(ctx):
         ## Misc
         ( "misc/bstr.c" ),
         ( "misc/charset_conv.c" ),
+        ( "misc/dir_cache.c" ),
         ( "misc/dispatch.c" ),
         ( "misc/jni.c",                          "android" ),
         ( "misc/json.c" ),
+        ( "misc/msgpack.c" ),
         ( "misc/natural_sort.c" ),
         ( "misc/node.c" ),
         ( "misc/rendezvous.c" ),
@@ -364,7 +369,10 @@ def build(ctx):
         ( "player/screenshot.c" ),
         ( "player/scripting.c" ),
         ( "player/sub.c" ),
+        ( "player/telemetry.c" ),
+        ( "player/thumbnail.c" ),
         ( "player/video.c" ),
+        ( "player/watch_later_store.c" ),
 
         ## Streams
         ( "stream/cookies.c" ),
@@ -385,6 +393,7 @@ def build(ctx):
         ( "stream/stream_memory.c" ),
         ( "stream/stream_mf.c" ),
         ( "stream/stream_null.c" ),
+        ( "stream/stream_shm.c",                 "stream-shm" ),
 
         ## Subtitles
         ( "sub/ass_mp.c" ),
@@ -401,16 +410,25 @@ def build(ctx):
         ( "sub/sd_lavc.c" ),
 
         ## Tests
+        ( "test/ao_convert.c",                   "tests" ),
+        ( "test/bitmap_packer.c",                "tests" ),
         ( "test/chmap.c",                        "tests" ),
+        ( "test/demux_bench.c",                  "tests" ),
+        ( "test/draw_bmp.c",                     "tests" ),
         ( "test/gl_video.c",                     "tests" ),
         ( "test/img_format.c",                   "tests" ),
         ( "test/json.c",                         "tests" ),
         ( "test/linked_list.c",                  "tests" ),
+        ( "test/msgpack.c",                      "tests" ),
         ( "test/paths.c",                        "tests" ),
+        ( "test/render_bench.c",                 "tests && vulkan" ),
         ( "test/repack.c",                       "tests && zimg" ),
+        ( "test/scale_bench.c",                  "tests" ),
         ( "test/scale_sws.c",                    "tests" ),
         ( "test/scale_test.c",                   "tests" ),
         ( "test/scale_zimg.c",                   "tests && zimg" ),
+        ( "test/scaletempo2.c",                  "tests" ),
+        ( "test/ta_arena.c",                     "tests" ),
         ( "test/tests.c",                        "tests" ),
 
         ## Video
@@ -430,6 +448,7 @@ def build(ctx):
         ( "video/filter/vf_vdpaupp.c",           "vdpau" ),
         ( "video/fmt-conversion.c" ),
         ( "video/hwdec.c" ),
+        ( "video/image_cache.c" ),
         ( "video/image_loader.c" ),
         ( "video/image_writer.c" ),
         ( "video/img_format.c" ),
@@ -532,6 +551,7 @@ def build(ctx):
         ( "video/out/vulkan/context_wayland.c",  "vulkan && wayland" ),
         ( "video/out/vulkan/context_win.c",      "vulkan && win32-desktop" ),
         ( "video/out/vulkan/context_xlib.c",     "vulkan && x11" ),
+        ( "video/out/vulkan/libmpv_vk.c",        "vulkan" ),
         ( "video/out/vulkan/utils.c",            "vulkan" ),
         ( "video/out/w32_common.c",              "win32-desktop" ),
         ( "generated/wayland/idle-inhibit-unstable-v1.c", "wayland" ),
@@ -546,6 +566,7 @@ def build(ctx):
         ( "video/out/win_state.c"),
         ( "video/out/x11_common.c",              "x11" ),
         ( "video/repack.c" ),
+        ( "video/repack_simd.c" ),
         ( "video/sws_utils.c" ),
         ( "video/zimg.c",                        "zimg" ),
         ( "video/vaapi.c",                       "vaapi" ),
@@ -732,7 +753,7 @@ def build(ctx):
         )
 
         headers = ["client.h", "render.h",
-                   "render_gl.h", "stream_cb.h"]
+                   "render_gl.h", "render_vk.h", "stream_cb.h"]
         for f in headers:
             ctx.install_as(ctx.env.INCLUDEDIR + '/mpv/' + f, 'libmpv/' + f)
 